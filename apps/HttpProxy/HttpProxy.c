@@ -51,11 +51,16 @@
 
 
 #define FetchBuffers 8
+#define FetchBuffersMax 32
 #define RobustMillis 200
 
+// default read size when the segment size is not (yet) known
 #define CCN_CHUNK_SIZE 4096
 
-#define BufferSize (4400*4)
+// room left in the buffer for rewriting a reply header for ranges
+#define RangeSlack 512
+
+#define BufferSize (64*1024)
 
 typedef struct RequestBaseStruct *RequestBase;
 
@@ -131,6 +136,8 @@ struct MainBaseStruct {
     ccn_fetch_flags ccn_flags;
 	int maxBusy;
 	int maxConn;
+	int fetchBuffers;       // initial fetch window for CCN streams
+	int fetchBuffersMax;    // limit for the adaptive fetch window
 	int nReady;
 	int requestCount;
 	int requestDone;
@@ -250,6 +257,8 @@ struct RequestBaseStruct {
 	string translate;
 	int port;
     int fetchOff;
+    int fetchWindow;           // current fetch window (CCN only)
+    int fetchStarved;          // non-zero while the fetch window is drained
 	void *buffer;
 	int bufferLen;
 	int bufferMax;
@@ -1543,26 +1552,48 @@ AcceptByteRange(RequestBase rb, string s, int len) {
         ssize_t rStart = 0;
         ssize_t rStop = -1;
         pos = SkipOverBlank(s, pos, len);
-        if (!IsNumeric(s[pos])) {
+        if (s[pos] == '-') {
+            // suffix range (bytes=-N), the last N bytes
+            // noted as a negative rangeStart, resolved in AdjustForRanges
+            pos++;
+            pos = SkipOverBlank(s, pos, len);
+            if (!IsNumeric(s[pos])) {
+                res = -__LINE__;
+                break;
+            }
+            for (;;) {
+                int c = IsNumeric(s[pos]);
+                if (c == 0) break;
+                rStart = rStart*10 + (c - '0');
+                pos++;
+            }
+            if (rStart <= 0) {
+                res = -__LINE__;
+                break;
+            }
+            rStart = -rStart;
+        } else if (!IsNumeric(s[pos])) {
             // a rangeStart number is required
             res = -__LINE__;
             break;
-        }
-        for (;;) {
+        } else for (;;) {
             int c = IsNumeric(s[pos]);
             if (c == 0) break;
             rStart = rStart*10 + (c - '0');
             pos++;
         }
         pos = SkipOverBlank(s, pos, len);
-        if (s[pos] != '-') {
+        if (rStart < 0) {
+            // suffix range already consumed the '-'
+        } else if (s[pos] != '-') {
             res = -__LINE__;
             break;
+        } else {
+            pos++;
+            pos = SkipOverBlank(s, pos, len);
         }
-        pos++;
-        pos = SkipOverBlank(s, pos, len);
         // a rangeStop number is optional
-        if (IsNumeric(s[pos])) {
+        if (rStart >= 0 && IsNumeric(s[pos])) {
             rStop = 0;
             for (;;) {
                 int c = IsNumeric(s[pos]);
@@ -2136,6 +2167,31 @@ WriteNotFoundReply(RequestBase rb) {
     return 0;
 }
 
+static int
+WriteRangeNotSatisfiable(RequestBase rb, int64_t contentLen) {
+    // replaces the reply header with a 416 reply for an impossible range
+    FILE *f = rb->mb->debug;
+    HttpInfo h = &rb->httpInfo;
+    string buf = (string) rb->buffer;
+    int max = rb->bufferMax;
+    int pos = 0;
+    pos += snprintf(buf+pos, max-pos, "HTTP/1.1 416 Requested Range Not Satisfiable\r\n");
+    pos += snprintf(buf+pos, max-pos, "Content-Range: bytes */%jd\r\n",
+                    (intmax_t) contentLen);
+    pos += snprintf(buf+pos, max-pos, "Content-Length: 0\r\n");
+    pos += snprintf(buf+pos, max-pos, "\r\n");
+    buf[pos] = 0;
+    rb->bufferLen = pos;
+    h->headerLen = pos;
+    rb->headerLenReply = pos;
+    SetMsgLen(rb, pos);
+    if (f != NULL) {
+        fprintf(f, "-- range not satisfiable, %u\n%s", pos, buf);
+        flushLog(f);
+    }
+    return 1;
+}
+
 static int
 WriteOptionsReply(RequestBase rb) {
     FILE *f = rb->mb->debug;
@@ -2490,7 +2546,7 @@ RequestBaseStart(RequestBase rb) {
 		struct ccn_fetch_stream * fs = ccn_fetch_open(mb->fetchBase, cb,
 													  rb->shortName,
 													  NULL,
-													  FetchBuffers,
+													  mb->fetchBuffers,
 													  mb->resolveFlags,
 													  1);
 		ccn_charbuf_destroy(&cb);
@@ -2506,6 +2562,7 @@ RequestBaseStart(RequestBase rb) {
                     rb->host, rb->shortName);
 			flushLog(f);
 			rb->fetchStream = fs;
+			rb->fetchWindow = ccn_fetch_get_window(fs);
 			rb->msgCount = 0;
 			
 			// dest socket is the src connection socket
@@ -2536,6 +2593,46 @@ RequestBaseStart(RequestBase rb) {
 	
 }
 
+static int
+FetchReadLen(RequestBase rb, int off) {
+	// determines how much to read from the fetch stream
+	// reads whole segments once the segment size is known,
+	// as many as will fit in the buffer
+	int room = rb->bufferMax - off - RangeSlack;
+	int ss = ccn_fetch_seg_size(rb->fetchStream);
+	if (ss <= 0) ss = CCN_CHUNK_SIZE;
+	if (room > ss) room = room - (room % ss);
+	return room;
+}
+
+static void
+AdaptFetchWindow(RequestBase rb, int starved) {
+	// grows the fetch window once each time the reader drains it
+	// when the network is the bottleneck this adds segments in flight
+	// when the client is the bottleneck the window stays as it is
+	MainBase mb = rb->mb;
+	FILE *f = mb->debug;
+	if (starved == 0) {
+		rb->fetchStarved = 0;
+		return;
+	}
+	if (rb->fetchStarved || rb->msgCount == 0)
+		// already noted, or still waiting for the first segment
+		return;
+	rb->fetchStarved = 1;
+	int w = rb->fetchWindow;
+	if (w >= mb->fetchBuffersMax) return;
+	w = w + (w+1)/2;
+	if (w > mb->fetchBuffersMax) w = mb->fetchBuffersMax;
+	w = ccn_fetch_set_window(rb->fetchStream, w);
+	if (w > 0) rb->fetchWindow = w;
+	if (f != NULL) {
+		PutRequestMark(rb, "fetch window");
+		fprintf(f, " %d\n", rb->fetchWindow);
+		flushLog(f);
+	}
+}
+
 static void
 NoteDone(RequestBase rb) {
 	MainBase mb = rb->mb;
@@ -2565,6 +2662,38 @@ AdjustForRanges(RequestBase rb) {
         && h->hasContentRange == 0
         && rb->msgCount == 0) {
         // first time through, need to rewrite the header
+        int64_t rStart = h->rangeList->rangeStart;
+        int64_t rStop = h->rangeList->rangeStop;
+        int64_t cLen = h->assertLength;
+        if (rStart < 0) {
+            // suffix range, needs the content length to resolve
+            if (cLen < 0) {
+                // can't resolve it, so ignore the range (RFC 2616, 14.35)
+                struct ByteRange *rl = h->rangeList;
+                while (rl != NULL) {
+                    struct ByteRange *next = rl->next;
+                    free(rl);
+                    rl = next;
+                }
+                h->rangeList = NULL;
+                return 1;
+            }
+            rStart = cLen + rStart;
+            if (rStart < 0) rStart = 0;
+            rStop = -1;
+            h->rangeList->rangeStart = rStart;
+        }
+        if (cLen >= 0) {
+            if (rStart >= cLen)
+                // nothing of the range is present
+                return WriteRangeNotSatisfiable(rb, cLen);
+            if (rStop >= cLen) {
+                // the range end may be past the content end
+                rStop = cLen-1;
+                h->rangeList->rangeStop = rStop;
+            }
+        }
+        int64_t rLen = rStop - rStart + 1;
         
         // rewrite header to use 206 code
         string buf = (string) rb->buffer;
@@ -2576,9 +2705,6 @@ AdjustForRanges(RequestBase rb) {
         // we probably changed the header length
         h->headerLen = h->headerLen + strlen(replace) - pos;
         
-        int64_t rStart = h->rangeList->rangeStart;
-        int64_t rStop = h->rangeList->rangeStop;
-        int64_t rLen = rStop - rStart + 1;
         int hLen = h->headerLen;
         
         while (pos < hLen) {
@@ -2609,11 +2735,11 @@ AdjustForRanges(RequestBase rb) {
                     h->rangeList->rangeStop = rStop;
                     rLen = rStop - rStart + 1;
                 }
-                tpos =+ snprintf(temp+tpos, sizeof(temp) - tpos,
+                tpos += snprintf(temp+tpos, sizeof(temp) - tpos,
                                  "Content-Length: %jd\r\n",
                                  (intmax_t) rLen
                                  );
-                tpos =+ snprintf(temp+tpos, sizeof(temp) - tpos,
+                tpos += snprintf(temp+tpos, sizeof(temp) - tpos,
                                  "Content-Range: bytes %ju-%ju/%ju\r\n",
                                  (intmax_t) rStart,
                                  (intmax_t) rStop,
@@ -2667,14 +2793,21 @@ AdjustForRanges(RequestBase rb) {
         } else {
             // we have the header, but no bytes
             // seek to the desired place and append what we can get
+            // (the seek maps directly onto the segment holding seekTo,
+            // so the segments in between are never fetched)
             int64_t seekTo = rb->headerLenInit+rStart;
+            int ss = ccn_fetch_seg_size(rb->fetchStream);
             if (f != NULL) {
-                fprintf(f, "-- seek to %jd: rStart %jd, rStop %jd\n", 
+                fprintf(f, "-- seek to %jd: rStart %jd, rStop %jd, seg %jd\n", 
                         (intmax_t) seekTo,
                         (intmax_t) rStart,
-                        (intmax_t) rStop);
+                        (intmax_t) rStop,
+                        (intmax_t) ((ss > 0) ? seekTo / ss : -1));
+            }
+            if (ccn_fetch_seek(rb->fetchStream, seekTo) < 0) {
+                SetRequestErr(rb, "range seek failed", 0);
+                return 0;
             }
-            ccn_fetch_seek(rb->fetchStream, seekTo);
             rb->bufferLen = off;
             rb->fetchOff = off;
             return 0;
@@ -2762,10 +2895,15 @@ RequestBaseStep(RequestBase rb) {
 				// we get this buffer through CCN
 				int off = rb->fetchOff;
                 string buf = (string) rb->buffer;
-                nb = ccn_fetch_read(rb->fetchStream, buf+off, CCN_CHUNK_SIZE);
-				if (nb < 0)
+                nb = ccn_fetch_read(rb->fetchStream, buf+off,
+                                    FetchReadLen(rb, off));
+				if (nb < 0) {
 					// nothing to do, no characters available
+					if (nb == CCN_FETCH_READ_NONE)
+						AdaptFetchWindow(rb, 1);
 					return 0;
+				}
+				AdaptFetchWindow(rb, 0);
 				if (nb > 0) {
 					mb->stats.replyReadsCCN++;
 					mb->stats.replyBytesCCN = mb->stats.replyBytesCCN + nb;
@@ -2808,7 +2946,8 @@ RequestBaseStep(RequestBase rb) {
                             nb, se->fd, dt, rb->host);
 				} else {
 					intmax_t pos = ccn_fetch_position(rb->fetchStream) - nb;
-					intmax_t seg = pos / CCN_CHUNK_SIZE;
+					int ss = ccn_fetch_seg_size(rb->fetchStream);
+					intmax_t seg = pos / ((ss > 0) ? ss : CCN_CHUNK_SIZE);
 					fprintf(f, " %jd bytes via CCN, seg %jd, dt %4.3f, %s\n",
                             nb, seg, dt, rb->host);
 				}
@@ -2831,6 +2970,7 @@ RequestBaseStep(RequestBase rb) {
 				if (ck == 0) {
 					// header not complete, go back and get another line
 					rb->recvOff = nb;
+					if (rb->fetchStream != NULL) rb->fetchOff = nb;
 					if (nb + 1000 > rb->bufferMax) {
 						SetRequestErr(rb, "Header too long", 0);
 						return -1;
@@ -3027,6 +3167,8 @@ NewMainBase(FILE *f, int maxBusy, struct ccn_fetch * fetchBase) {
 	mb->fetchBase = fetchBase;
 	mb->ccnFD = ccn_get_connection_fd(ccn_fetch_get_ccn(fetchBase));
 	mb->usePort = 8080;
+	mb->fetchBuffers = FetchBuffers;
+	mb->fetchBuffersMax = FetchBuffersMax;
 	mb->ccn_flags = (ccn_fetch_flags_NoteAll);
 	mb->debug = f;
     mb->custom = "./HttpProxy.list";
@@ -3452,11 +3594,34 @@ main(int argc, string *argv) {
                     break;
 				}
 				mb->maxConn = n;
+			} else if (strcasecmp(arg, "-fetchBuffers") == 0) {
+				i++;
+				int n = 0;
+				if (i <= argc) n = atoi(argv[i]);
+				if (n < 1 || n > CCN_FETCH_MAX_BUFS) {
+					fprintf(stdout, "** bad fetchBuffers: %d\n", n);
+                    res = -1;
+                    break;
+				}
+				mb->fetchBuffers = n;
+				if (mb->fetchBuffersMax < n) mb->fetchBuffersMax = n;
+			} else if (strcasecmp(arg, "-fetchBuffersMax") == 0) {
+				i++;
+				int n = 0;
+				if (i <= argc) n = atoi(argv[i]);
+				if (n < 1 || n > CCN_FETCH_MAX_BUFS) {
+					fprintf(stdout, "** bad fetchBuffersMax: %d\n", n);
+                    res = -1;
+                    break;
+				}
+				mb->fetchBuffersMax = n;
+				if (mb->fetchBuffers > n) mb->fetchBuffers = n;
 			} else {
 				fprintf(stdout, "** bad arg: %s\n", arg);
                 fprintf(stdout, "Usage: %s -remProxy -remHost -keepProxy -keepHost -noDebug -addTime\n"
                         "          -resolveHigh -resolveHighest -hostFromGet\n"
-                        "          -keepAlive <n> -timeoutSecs <n> -usePort <n> -custom <txt> -maxConn <n>\n",
+                        "          -keepAlive <n> -timeoutSecs <n> -usePort <n> -custom <txt> -maxConn <n>\n"
+                        "          -fetchBuffers <n> -fetchBuffersMax <n>\n",
                         argv[0]);
                 res = -1;
                 break;
@@ -21,6 +21,10 @@
  * Serves chunks of data to ccn from a file directory, with missing files
  * fetched using a simple HTTP protocol.
  *
+ * Segments are signed and published as soon as their bytes arrive from the
+ * HTTP stream, so pending interests are answered while the download is in
+ * progress.  Signed segments are kept in a bounded in-memory LRU cache, and
+ * the file directory is a bounded disk cache with LRU eviction of whole files.
  */
 
 #include "./ProxyUtil.h"
@@ -39,22 +43,22 @@
 #include <ccn/uri.h>
 #include <ccn/keystore.h>
 #include <ccn/signing.h>
-#include <sys/mman.h>
+#include <dirent.h>
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
 
 // TBD: the following constants should be more principled
-#define CCN_CHUNK_SIZE 4096
-#define CCN_MAP_SIZE (64*CCN_CHUNK_SIZE)
+#define CCN_CHUNK_SIZE 8192
+#define CCN_CHUNK_MAX (32*1024)
 #define MaxFileName 1024
 #define MainPollMillis 10
 #define KeepAliveDefault 115
 #define DefaultFreshness (-1)
 // default is not to go stale
-#define TempSegments 4
-
-#define UsePread 1
+#define MemCacheDefault (64*1024*1024)
+// default is no limit on the disk cache
+#define DiskCacheDefault 0
 
 typedef struct ccn_charbuf *MyCharbuf;
 typedef intmax_t seg_t;
@@ -143,14 +147,38 @@ typedef struct NetRequestStruct *NetRequest;
 typedef struct HttpInfoStruct *HttpInfo;
 
 
+typedef struct SegEntryStruct *SegEntry;
+typedef struct DiskEntryStruct *DiskEntry;
+
 struct StatsStruct {
 	uint64_t filesCreated;
+	uint64_t filesEvicted;
 	uint64_t fileBytes;
 	uint64_t interestsSeen;
 	uint64_t segmentsPut;
+	uint64_t segmentsSigned;
+	uint64_t cacheHits;
 	uint64_t bytesPut;
 };
 
+// a signed segment held in the memory cache
+struct SegEntryStruct {
+	SegEntry lruPrev;		// toward more recently used
+	SegEntry lruNext;		// toward less recently used
+	FileNode fn;
+	seg_t seg;
+	struct ccn_charbuf *cob;	// the signed ContentObject
+};
+
+// a file held in the disk cache
+struct DiskEntryStruct {
+	DiskEntry next;
+	char *fileName;
+	off_t size;
+	uint64_t lastUsed;
+	FileNode fn;			// != NULL while the file is open
+};
+
 struct MainDataStruct {
 	SockBase sockBase;
 	NetRequest requests;
@@ -159,7 +187,14 @@ struct MainDataStruct {
 	int nFiles;
 	struct ccn_keystore *keystore;
 	char *progname;
-	int64_t mapped;
+	int segSize;
+	SegEntry lruHead;
+	SegEntry lruTail;
+	int64_t cacheBytes;
+	int64_t cacheMax;
+	DiskEntry diskFiles;
+	int64_t diskBytes;
+	int64_t diskMax;
 	int debug;
 	int verbose;
 	int recentPort;
@@ -185,9 +220,6 @@ struct FileNodeStruct {
 	int fd;
 	int final;
 	int marked;
-	void *mapAddr;
-	off_t mapLen;
-	seg_t mapOff;
 	int create;
 	int fresh;
 	off_t fileSize;
@@ -202,11 +234,12 @@ struct FileNodeStruct {
 	uint64_t firstUsed;
 	uint64_t lastUsed;
 	uint64_t nSegsPut;
-	seg_t maxSegPut;
-	int nTemp;
-	void * *tempBufs;
-	seg_t *tempSegs;
-	int *tempLengths;
+	seg_t finalSeg;			// from the FinalBlockID template (-1 if unknown)
+	SegEntry *segCache;		// cached signed segments, indexed by seg
+	seg_t segCacheMax;
+	DiskEntry disk;
+	char *asmBuf;			// segment being assembled from the HTTP stream
+	int asmLen;
     struct ccn_signing_params signing_params; // must be per-file
 };
 
@@ -283,6 +316,7 @@ RemSegRequest(NetRequest nr, seg_t seg) {
 		if (each->seg == seg) {
 			if (lag == NULL) nr->segRequests = each->next;
 			else lag->next = each->next;
+			free(each);
 			return 1;
 		}
 		lag = each;
@@ -315,92 +349,195 @@ AddSegRequest(NetRequest nr, seg_t seg) {
 	return 0;
 }
 
-static int
-ExpandTempSegments(FileNode fn) {
-	int oTemp = fn->nTemp;
-	int nTemp = fn->nTemp+1;
-	void * *newBufs = ProxyUtil_Alloc(nTemp, void *);
-	seg_t *newSegs = ProxyUtil_Alloc(nTemp, seg_t);
-	int *newLengths = ProxyUtil_Alloc(nTemp, int);
-	int i = 0;
-	for (; i < fn->nTemp; i++) {
-		newBufs[i] = fn->tempBufs[i];
-		newSegs[i] = fn->tempSegs[i];
-		newLengths[i] = fn->tempLengths[i];
-	}
-	if (oTemp > 0) {
-		free(fn->tempBufs);
-		free(fn->tempSegs);
-		free(fn->tempLengths);
-	}
-	fn->tempBufs = newBufs;
-	fn->tempSegs = newSegs;
-	fn->tempLengths = newLengths;
-	fn->nTemp = nTemp;
-	newBufs[oTemp] = ProxyUtil_Alloc(CCN_CHUNK_SIZE, char);
-	newSegs[oTemp] = -1;
-	newLengths[oTemp] = 0;
-	return oTemp;
+////////////////////////////////
+// Segment cache support
+////////////////////////////////
+
+// The segment cache holds signed segments in memory, so that repeated
+// interests do not cause repeated signing.  All files share one LRU list
+// that is bounded by md->cacheMax bytes of ContentObjects.
+
+static void
+LruUnlink(MainData md, SegEntry e) {
+	SegEntry prev = e->lruPrev;
+	SegEntry next = e->lruNext;
+	if (prev == NULL) md->lruHead = next;
+	else prev->lruNext = next;
+	if (next == NULL) md->lruTail = prev;
+	else next->lruPrev = prev;
+	e->lruPrev = NULL;
+	e->lruNext = NULL;
 }
 
-static int
-FillTempSegments(FileNode fn, void *buf, int n) {
-	off_t fileSize = fn->fileSize;
-	seg_t seg = fileSize / CCN_CHUNK_SIZE;
-	int off = fileSize % CCN_CHUNK_SIZE;
-	// first, try to transfer bytes to the 
-	while (n > 0) {
-		int vic = -1;
-		int i = 0;
-		for (; i < fn->nTemp; i++) {
-			seg_t tSeg = fn->tempSegs[i];
-			if (seg == tSeg) {
-				vic = i;
-				break;
-			}
-			if (tSeg + TempSegments < seg) {
-				// old enough to retire, so make this entry available
-				tSeg = -1;
-				fn->tempSegs[i] = -1;
-				fn->tempLengths[i] = 0;
-			}
-			if (tSeg < 0) vic = i;
-		}
-		if (vic < 0) {
-			// not enough temp segments, so make more
-			vic = ExpandTempSegments(fn);
+static void
+LruPushFront(MainData md, SegEntry e) {
+	e->lruPrev = NULL;
+	e->lruNext = md->lruHead;
+	if (md->lruHead != NULL) md->lruHead->lruPrev = e;
+	md->lruHead = e;
+	if (md->lruTail == NULL) md->lruTail = e;
+}
+
+static void
+DropSegEntry(MainData md, SegEntry e) {
+	FileNode fn = e->fn;
+	LruUnlink(md, e);
+	if (fn != NULL && e->seg < fn->segCacheMax && fn->segCache[e->seg] == e)
+		fn->segCache[e->seg] = NULL;
+	md->cacheBytes = md->cacheBytes - e->cob->length;
+	ccn_charbuf_destroy(&e->cob);
+	free(e);
+}
+
+static SegEntry
+LookupSegEntry(FileNode fn, seg_t seg) {
+	// returns the cached signed segment (NULL if not present)
+	// a successful lookup makes the entry the most recently used
+	if (seg < 0 || seg >= fn->segCacheMax) return NULL;
+	SegEntry e = fn->segCache[seg];
+	if (e != NULL && e != fn->md->lruHead) {
+		LruUnlink(fn->md, e);
+		LruPushFront(fn->md, e);
+	}
+	return e;
+}
+
+static SegEntry
+StoreSegEntry(FileNode fn, seg_t seg, struct ccn_charbuf *cob) {
+	// stores a signed segment (the cache takes ownership of cob)
+	// evicts least recently used segments to stay within bounds
+	MainData md = fn->md;
+	if (seg < 0) return NULL;
+	if (seg >= fn->segCacheMax) {
+		seg_t nMax = fn->segCacheMax + fn->segCacheMax/2 + 16;
+		if (nMax <= seg) nMax = seg + 16;
+		SegEntry *nCache = ProxyUtil_Alloc(nMax, SegEntry);
+		if (fn->segCacheMax > 0) {
+			memcpy(nCache, fn->segCache, fn->segCacheMax * sizeof(SegEntry));
+			free(fn->segCache);
 		}
-		if (vic < 0)
-			return retErr("FillTempSegments bad state, vic < 0");
-		seg_t vSeg = fn->tempSegs[vic];
-		if (vSeg < 0) fn->tempSegs[vic] = seg;
-		// found a match, check for room
-		int pos = fn->tempLengths[vic];
-		if (pos != off) {
-			// we have stuff already written?
-			return retErr("FillTempSegments bad state");
+		fn->segCache = nCache;
+		fn->segCacheMax = nMax;
+	}
+	SegEntry e = fn->segCache[seg];
+	if (e != NULL) DropSegEntry(md, e);
+	e = ProxyUtil_StructAlloc(1, SegEntryStruct);
+	e->fn = fn;
+	e->seg = seg;
+	e->cob = cob;
+	fn->segCache[seg] = e;
+	LruPushFront(md, e);
+	md->cacheBytes = md->cacheBytes + cob->length;
+	while (md->cacheBytes > md->cacheMax
+		   && md->lruTail != NULL && md->lruTail != e) {
+		DropSegEntry(md, md->lruTail);
+	}
+	return e;
+}
+
+static void
+DropFileSegEntries(FileNode fn) {
+	MainData md = fn->md;
+	seg_t seg = 0;
+	for (; seg < fn->segCacheMax; seg++) {
+		SegEntry e = fn->segCache[seg];
+		if (e != NULL) DropSegEntry(md, e);
+	}
+	if (fn->segCache != NULL) free(fn->segCache);
+	fn->segCache = NULL;
+	fn->segCacheMax = 0;
+}
+
+////////////////////////////////
+// Disk cache support
+////////////////////////////////
+
+// The disk cache is the file directory under fsRoot.  When md->diskMax > 0
+// the total size of the files is bounded, and the least recently used files
+// that are not open are deleted to stay within the bound.
+
+static DiskEntry
+NoteDiskEntry(MainData md, char *fileName, off_t size, uint64_t lastUsed) {
+	// finds or adds the entry for the file
+	DiskEntry de = md->diskFiles;
+	for (; de != NULL; de = de->next) {
+		if (strcmp(fileName, de->fileName) == 0) {
+			md->diskBytes = md->diskBytes + (size - de->size);
+			de->size = size;
+			if (lastUsed > de->lastUsed) de->lastUsed = lastUsed;
+			return de;
 		}
-		int rem = CCN_CHUNK_SIZE - pos;
-		if (rem > 0) {
-			// non-zero to move
-			if (n < rem) rem = n;
-			string src = ((string) buf) + off;
-			string dst = ((string) fn->tempBufs[vic]) + off;
-			memcpy(dst, src, rem);
-			if (fn->md->debug) {
-				fprintf(stdout,
-						"-- FillTempSegments, fd %d, n %d, rem %d, vic %d, seg %jd, off %d\n",
-						fn->fd, n, rem, vic, seg, off);
-                
+	}
+	de = ProxyUtil_StructAlloc(1, DiskEntryStruct);
+	de->fileName = Concat(fileName, "");
+	de->size = size;
+	de->lastUsed = lastUsed;
+	de->next = md->diskFiles;
+	md->diskFiles = de;
+	md->diskBytes = md->diskBytes + size;
+	return de;
+}
+
+static void
+EvictDiskFiles(MainData md) {
+	if (md->diskMax <= 0) return;
+	while (md->diskBytes > md->diskMax) {
+		DiskEntry vic = NULL;
+		DiskEntry vicLag = NULL;
+		DiskEntry lag = NULL;
+		DiskEntry de = md->diskFiles;
+		for (; de != NULL; de = de->next) {
+			if (de->fn == NULL
+				&& (vic == NULL || de->lastUsed < vic->lastUsed)) {
+				vic = de;
+				vicLag = lag;
 			}
-			off = off + rem;
-			seg = seg + (off / CCN_CHUNK_SIZE);
-			off = off % CCN_CHUNK_SIZE;
-			n = n - rem;
-			fn->tempLengths[vic] = pos + rem;
+			lag = de;
 		}
+		if (vic == NULL)
+			// everything left is in use
+			break;
+		if (vicLag == NULL) md->diskFiles = vic->next;
+		else vicLag->next = vic->next;
+		md->diskBytes = md->diskBytes - vic->size;
+		md->stats.filesEvicted++;
+		if (unlink(vic->fileName) < 0 && errno != ENOENT)
+			retFail("EvictDiskFiles unlink");
+		if (md->debug) {
+			fprintf(stdout, "-- EvictDiskFiles, %s, %jd bytes, disk %jd\n",
+					vic->fileName, (intmax_t) vic->size,
+					(intmax_t) md->diskBytes);
+			flushLog();
+		}
+		vic->fileName = Freestr(vic->fileName);
+		free(vic);
+		md->changes++;
 	}
-	return 0;
+}
+
+static void
+ScanDiskCache(MainData md, char *dirName) {
+	// notes the files already present in the cache directory
+	DIR *dir = opendir(dirName);
+	if (dir == NULL) return;
+	for (;;) {
+		struct dirent *ent = readdir(dir);
+		if (ent == NULL) break;
+		if (ent->d_name[0] == '.') continue;
+		char path[MaxFileName];
+		struct stat ss;
+		int len = strlen(dirName);
+		char *sep = ((len > 0 && dirName[len-1] == '/') ? "" : "/");
+		snprintf(path, sizeof(path), "%s%s%s", dirName, sep, ent->d_name);
+		if (lstat(path, &ss) < 0) continue;
+		if (S_ISDIR(ss.st_mode)) {
+			ScanDiskCache(md, path);
+		} else if (S_ISREG(ss.st_mode)) {
+			uint64_t lastUsed = ((uint64_t) ss.st_mtime) * 1000000;
+			NoteDiskEntry(md, path, ss.st_size, lastUsed);
+		}
+	}
+	closedir(dir);
 }
 
 static int
@@ -529,48 +666,62 @@ NewSegBlob(seg_t seg) {
 
 static int
 HaveSegment(FileNode fn, seg_t seg) {
-	if (fn == NULL) return 0;
-	seg_t nSegs = fn->nSegs;
-	seg_t safeSeg = nSegs;
-	if (fn->final == 0) safeSeg--;
-	if (seg < 0 || seg >= safeSeg)
-		// not in the current valid range
-		return 0;
-	return 1;
+	// returns 1 if all of the bytes for the segment are present
+	if (fn == NULL || seg < 0) return 0;
+	if (fn->final) return (seg < fn->nSegs);
+	if (fn->finalSeg >= 0 && seg > fn->finalSeg) return 0;
+	off_t lim = (seg+1) * (off_t) fn->md->segSize;
+	if (fn->finalSeg >= 0)
+		// the final segment is known, so any complete segment is safe
+		return (lim <= fn->fileSize);
+	// the last complete segment might turn out to be the final one
+	return (lim < fn->fileSize);
 }
 
 static int
-AssertFinalSize(FileNode fn, off_t fileSize) {
+SetFinalBlock(FileNode fn, seg_t finalSeg) {
+	// sets up the template used to mark the final segment in all segments
+	// signed from now on
     struct ccn_charbuf *templ;
     struct ccn_charbuf *finalBlock;
     int res;
+	if (finalSeg < 0) finalSeg = 0;
+	if (fn->finalSeg == finalSeg) return 0;
+	fn->finalSeg = finalSeg;
+    templ = ccn_charbuf_create();
+    res = ccnb_element_begin(templ, CCN_DTAG_SignedInfo);
+    finalBlock = NewSegBlob(finalSeg);
+    ccnb_element_begin(templ, CCN_DTAG_FinalBlockID);
+    res |= ccn_charbuf_append_charbuf(templ, finalBlock);
+    res |= ccnb_element_end(templ);
+    res |= ccnb_element_end(templ);    /* </SignedInfo> */
+    ccn_charbuf_destroy(&fn->signing_params.template_ccnb);
+    fn->signing_params.sp_flags |= CCN_SP_TEMPL_FINAL_BLOCK_ID;
+    fn->signing_params.template_ccnb = templ;
+    ccn_charbuf_destroy(&finalBlock);
+	return (res);
+}
+
+static int
+AssertFinalSize(FileNode fn, off_t fileSize) {
 	// only to be used when the file size was not previously known
 	// once the final size is set it cannot be changed
 	if (fn->final == 1) return 0;
 	MainData md = fn->md;
+	int ss = md->segSize;
     // new file, so accum the new bytes
     fn->final = 1;
     fn->fileSize = fileSize;
     md->stats.fileBytes = md->stats.fileBytes + fileSize;
-	seg_t nSegs = (fileSize + CCN_CHUNK_SIZE - 1) / CCN_CHUNK_SIZE;
+	seg_t nSegs = (fileSize + ss - 1) / ss;
 	fn->nSegs = nSegs;
 	fn->lastUsed = GetCurrentTime();
-    templ = ccn_charbuf_create();
-    res = ccnb_element_begin(templ, CCN_DTAG_SignedInfo);
-    finalBlock = NewSegBlob(nSegs - 1);
-    ccnb_element_begin(templ, CCN_DTAG_FinalBlockID);
-    res |= ccn_charbuf_append_charbuf(templ, finalBlock);
-    res |= ccnb_element_end(templ);
-    res |= ccnb_element_end(templ);    /* </SignedInfo> */
-    fn->signing_params.sp_flags |= CCN_SP_TEMPL_FINAL_BLOCK_ID;
-    fn->signing_params.template_ccnb = templ;
 	if (md->debug) {
 		fprintf(stdout, "-- AssertFinalSize, %s, fileSize %jd, final %jd\n",
 				fn->id, (intmax_t) fileSize, (intmax_t) nSegs-1);
         flushLog();
 	};
-    ccn_charbuf_destroy(&finalBlock);
-	return (res);
+	return SetFinalBlock(fn, nSegs - 1);
 }
 
 static int
@@ -601,98 +752,6 @@ MakePath(char *dir, int pos) {
 	return count;
 }
 
-static int
-UnMapBig(FileNode fn) {
-	MainData md = fn->md;
-	int len = fn->mapLen;
-	void *addr = fn->mapAddr;
-	if (len > 0 && addr != NULL && addr != MAP_FAILED) {
-		// get rid of the big map address
-		int res = munmap(fn->mapAddr, len);
-		if (res < 0) retErr("UnMapBig - munmap");
-		md->mapped = md->mapped - len;
-		fn->mapAddr = NULL;
-		fn->mapLen = 0;
-		return res;
-	}
-	return 0;
-}
-
-static void *
-MapBig(FileNode fn, seg_t seg) {
-	MainData md = fn->md;
-	seg_t nSegs = fn->nSegs;
-	if (seg < 0 || seg >= nSegs) return NULL;
-	off_t off = seg * CCN_CHUNK_SIZE;
-	off_t lim = off + CCN_CHUNK_SIZE;
-	off_t mapLim = fn->mapOff + fn->mapLen;
-	off_t maxOff = nSegs * CCN_CHUNK_SIZE;
-	if (off >= maxOff || lim > maxOff) return NULL;
-	if (fn->mapLen > 0 && off >= fn->mapOff && off <= mapLim) {
-		// we have a valid mapping, maybe including this segment
-		if (lim <= mapLim) {
-			// current mapped region contains desired segment
-			char *s = (char *) fn->mapAddr;
-			return (void *) (s + (off - fn->mapOff));
-		}
-		// current mapped region only contains part of desired segment
-		// so don't claim that it can hold the whole thing
-	}
-	// we don't have the right stuff, so get rid of it
-	int umRes = UnMapBig(fn);
-	if (umRes < 0) {
-		string sysErr = strerror(errno);
-		char msg[256];
-		int pos = snprintf(msg, sizeof(msg), "UnMapBig, %s", sysErr);
-		msg[pos] = 0;
-		retErr(msg);
-	}
-	
-	seg_t mseg = seg;
-	seg_t dseg = seg - fn->maxSegPut;
-	if (dseg > 1 && dseg <= 8) {
-		// adjust to fit the gap
-		mseg = fn->maxSegPut + 1;
-		off = mseg * CCN_CHUNK_SIZE;
-		lim = off + CCN_CHUNK_SIZE;
-		dseg = seg - mseg;
-	}
-	
-	off_t d = fn->fileSize - off;
-	if (d < CCN_CHUNK_SIZE && fn->final == 0)
-		// we only have a partial, and the file is not final
-		return 0;
-	if (d > CCN_MAP_SIZE) d = CCN_MAP_SIZE;
-	void *addr = mmap(NULL,
-					  d,
-					  PROT_READ,
-#ifdef _DARWIN_C_SOURCE
-					  MAP_FILE | MAP_PRIVATE,
-#else
-					  MAP_PRIVATE,
-#endif
-					  fn->fd,
-					  off);
-	if (addr != NULL && addr != MAP_FAILED) {
-		// it's mapped
-		fn->mapOff = off;
-		fn->mapLen = d;
-		fn->mapAddr = addr;
-		md->mapped = md->mapped + d;
-		fprintf(stdout, "-- MapBig, seg %jd for %d bytes (mapped %jd)\n",
-				seg, (int) d, (intmax_t) md->mapped);
-		fflush(stdout);
-		if (mseg != seg)
-			// the returned address should be for the initially requested seg
-			addr = (void *) ((char *) addr + dseg*CCN_CHUNK_SIZE);
-		return addr;
-	}
-	fprintf(stdout, "** %s: MapBig, %jd\n", strerror(errno), seg);
-	fflush(stdout);
-	// we failed!
-	return NULL;
-}
-
 static FileNode
 OpenFileNode(MainData md, char *root, char *dir, char *shortName,
 			 int create, int fresh) {
@@ -765,7 +824,7 @@ OpenFileNode(MainData md, char *root, char *dir, char *shortName,
 		md->nFiles++;
 		md->stats.filesCreated++;
 		fn->fd = fd;
-		fn->maxSegPut = -1;
+		fn->finalSeg = -1;
 		fn->fresh = fresh;
 		fn->fileName = Concat(fileName, "");
 		fn->fileSize = fileSize;
@@ -781,9 +840,11 @@ OpenFileNode(MainData md, char *root, char *dir, char *shortName,
 		fn->unPercName = NewUnPercName(shortName);
 		fn->id = MakeId(dir, fn->unPercName);
 		fn->create = create;
+		fn->disk = NoteDiskEntry(md, fn->fileName, fileSize, fn->lastUsed);
+		fn->disk->fn = fn;
 		if (md->debug) {
 			double dt = DeltaTime(md->startTime, GetCurrentTime());
-            seg_t nSegs = (fileSize + CCN_CHUNK_SIZE - 1) / CCN_CHUNK_SIZE;
+            seg_t nSegs = (fileSize + md->segSize - 1) / md->segSize;
 			if (create)
 				fprintf(stdout, "@%4.3f, CreateFile %s\n",
 						dt, fn->id);
@@ -819,34 +880,30 @@ CloseFileNode(FileNode fn) {
 				if (lag == NULL) md->files = fn->next;
 				else lag->next = fn->next;
 				char *fileName = fn->fileName;
-				UnMapBig(fn);
+				DropFileSegEntries(fn);
 				md->nFiles--;
 				if (md->debug) {
 					double dt = DeltaTime(md->startTime, GetCurrentTime());
 					fprintf(stdout,
-							"@%4.3f, CloseFile %s, mapped %jd, files %d\n",
+							"@%4.3f, CloseFile %s, cached %jd, files %d\n",
 							dt,
 							fn->id,
-							(intmax_t) md->mapped,
+							(intmax_t) md->cacheBytes,
 							md->nFiles);
 					fflush(stdout);
 				}
+				if (fn->disk != NULL) {
+					// the file may now be evicted from the disk cache
+					fn->disk->lastUsed = fn->lastUsed;
+					fn->disk->fn = NULL;
+					fn->disk = NULL;
+				}
 				fn->root = Freestr(fn->root);
 				fn->dir = Freestr(fn->dir);
 				fn->shortName = Freestr(fn->shortName);
 				fn->unPercName = Freestr(fn->unPercName);
 				fn->id = Freestr(fn->id);
-				if (fn->nTemp > 0) {
-					// we have some temp bufs to handle
-					int i = 0;
-					for (; i < fn->nTemp; i++) {
-						void *buf = fn->tempBufs[i];
-						if (buf != NULL) free(buf);
-					}
-					free(fn->tempBufs);
-					free(fn->tempSegs);
-					free(fn->tempLengths);
-				}
+				if (fn->asmBuf != NULL) free(fn->asmBuf);
                 ccn_charbuf_destroy(&fn->signing_params.template_ccnb);
 				struct timeval tv[2];
 				tv[0].tv_sec = fn->modTime.tv_sec;
@@ -868,58 +925,6 @@ CloseFileNode(FileNode fn) {
 	return NULL;
 }
 
-static void *
-MapSeg(FileNode fn, seg_t seg) {
-	MainData md = fn->md;
-	seg_t nSegs = fn->nSegs;
-	if (seg < 0 || seg >= nSegs) return NULL;
-	if (CCN_CHUNK_SIZE == CCN_MAP_SIZE) {
-		off_t off = seg * CCN_CHUNK_SIZE;
-		
-		void *addr = mmap(NULL,
-						  CCN_CHUNK_SIZE,
-						  PROT_READ,
-#ifdef _DARWIN_C_SOURCE
-						  MAP_FILE | MAP_PRIVATE,
-#else
-						  MAP_PRIVATE,
-#endif
-						  fn->fd,
-						  off);
-		if (addr != NULL && addr != MAP_FAILED) {
-			// it's mapped
-			int len = CCN_CHUNK_SIZE;
-			fn->mapLen = len;
-			md->mapped = md->mapped + len;
-			return addr;
-		}
-		fprintf(stdout, "** %s: MapSeg\n", strerror(errno));
-		fflush(stdout);
-		// could not get it
-		return NULL;
-	} else {
-		return MapBig(fn, seg);
-	}
-}
-
-static int
-UnMapSeg(FileNode fn) {
-	if (CCN_CHUNK_SIZE == CCN_MAP_SIZE) {
-		void *addr = fn->mapAddr;
-		int len = fn->mapLen;
-		if (len > 0 && addr != NULL && addr != MAP_FAILED) {
-			MainData md = fn->md;
-			int res = munmap(addr, len);
-			if (res == 0) retErr("UnMapSeg - munmap");
-			md->mapped = md->mapped - len;
-			fn->mapAddr = NULL;
-			fn->mapLen = 0;
-			return res;
-		}
-	}
-	return 0;
-}
-
 static MainData
 NewMainData(struct ccn *h) {
 	MainData md = ProxyUtil_StructAlloc(1, MainDataStruct);
@@ -935,6 +940,13 @@ CloseMainData(MainData md) {
 	while (md->files != NULL) {
 		CloseFileNode(md->files);
 	}
+	// forget the disk cache entries (the files stay)
+	while (md->diskFiles != NULL) {
+		DiskEntry de = md->diskFiles;
+		md->diskFiles = de->next;
+		free(de->fileName);
+		free(de);
+	}
 	// finally, get rid of self
 	free(md);
 	return NULL;
@@ -1027,18 +1039,70 @@ SetNameCCN(struct ccn_charbuf *cb, char *ccnRoot, char *dir, char *name) {
 	return 0;
 }
 
+static int
+SegmentLength(FileNode fn, seg_t seg) {
+	int ss = fn->md->segSize;
+	if (fn->final && seg+1 == fn->nSegs) {
+		// last part may not be a complete segment
+		int mod = fn->fileSize % ss;
+		if (mod > 0) return mod;
+	}
+	return ss;
+}
+
+static struct ccn_charbuf *
+SignSegment(FileNode fn, char *ccnRoot, seg_t seg, const void *data, int segLen) {
+	// SignSegment signs the segment and stores it in the segment cache
+	// returns the signed ContentObject (owned by the cache), NULL on failure
+	MainData md = fn->md;
+    struct ccn_charbuf *cb = ccn_charbuf_create();
+	int res = SetNameCCN(cb, ccnRoot, fn->dir, fn->unPercName);
+	if (res < 0) {
+		// don't let this get farther
+		ccn_charbuf_destroy(&cb);
+		retErr("bad name?");
+		return NULL;
+	}
+	
+	// see ccn_versioning.c: ccn_create_version
+	ccn_create_version(md->ccn, cb, 0,
+					   fn->modTime.tv_sec, fn->modTime.tv_nsec);
+	ccn_name_append_numeric(cb, CCN_MARKER_SEQNUM, seg);
+	
+    struct ccn_signing_params sp = fn->signing_params;
+    // Only the first segment gets the key locator
+    if (seg > 0) sp.sp_flags |= CCN_SP_OMIT_KEY_LOCATOR;
+    struct ccn_charbuf *temp = ccn_charbuf_create();
+    res = ccn_sign_content(md->ccn, temp, cb, &sp, data, segLen);
+	ccn_charbuf_destroy(&cb);
+	if (res != 0) {
+		fprintf(stdout, "** ccn_sign_content failed (res == %d)\n", res);
+		flushLog();
+		ccn_charbuf_destroy(&temp);
+		return NULL;
+	}
+	md->stats.segmentsSigned++;
+	if (md->debug) {
+		fprintf(stdout, "-- SignSegment, %s, seg %jd, len %d\n",
+				fn->id, seg, segLen);
+		flushLog();
+	}
+	StoreSegEntry(fn, seg, temp);
+	return temp;
+}
+
 static int
 PutSegment(FileNode fn, char *ccnRoot, seg_t seg) {
-	// PutSegment takes the indicated segment from the file and stores it
-	// as a CCN segment
+	// PutSegment stores the indicated segment as a CCN segment
+	// the signed segment comes from the segment cache if present,
+	// otherwise it is read from the file and signed
 	// returns -1 on failure, 0 on success
 	MainData md = fn->md;
-	char *dir = fn->dir;
 	int ret = 0;
 	if (md->debug) {
 		if (fn->nSegsPut > 0) {
 			uint64_t now = GetCurrentTime();
-			double rate = ((fn->nSegsPut)*CCN_CHUNK_SIZE
+			double rate = ((fn->nSegsPut)*md->segSize
 						   / (1.0e6*DeltaTime(fn->firstUsed, now)));
 			fprintf(stdout, "-- PutSegment, %s, seg %jd, %4.3f MB/s\n",
 					fn->id, seg, rate);
@@ -1048,37 +1112,23 @@ PutSegment(FileNode fn, char *ccnRoot, seg_t seg) {
 		}
 		flushLog();
 	}
-	if (seg < 0 || seg >= fn->nSegs) {
+	if (HaveSegment(fn, seg) == 0) {
 		fprintf(stdout, "** PutSegment, %s, invalid seg %jd\n",
 				fn->id, seg);
 		
 		flushLog();
 		return -1;
 	}
-	int segLen = CCN_CHUNK_SIZE;
-	if (seg+1 == fn->nSegs) {
-		// last part may not be a complete segment
-		int mod = fn->fileSize % CCN_CHUNK_SIZE;
-		if (mod > 0) segLen = mod;
-	}
-	int usePRead = 0;
-	void *addr = NULL;
-	
-	if (fn->final == 0) {
-		// the last write might not have finished
-		seg_t safeSeg = fn->nSegs - 2;
-		if (seg > safeSeg) usePRead = 1;
-	}
-	if (usePRead) {
-		// this is the slower, but possibly safer, way to read near
-		// the end of the file as currently written
-		addr = ProxyUtil_Alloc(CCN_CHUNK_SIZE, char);
-		ssize_t nr = pread(fn->fd, addr, segLen, seg*CCN_CHUNK_SIZE);
-		if (md->debug) {
-			fprintf(stdout, "-- PutSegment, pread, seg %jd, nr %zd\n",
-					seg, nr);
-			flushLog();
-		}
+	struct ccn_charbuf *cob = NULL;
+	SegEntry e = LookupSegEntry(fn, seg);
+	if (e != NULL) {
+		// already signed
+		cob = e->cob;
+		md->stats.cacheHits++;
+	} else {
+		int segLen = SegmentLength(fn, seg);
+		char *addr = ProxyUtil_Alloc(segLen, char);
+		ssize_t nr = pread(fn->fd, addr, segLen, seg * (off_t) md->segSize);
 		if (nr < segLen) {
 			fprintf(stdout, "** can't read file %s, seg %jd\n",
 					fn->id, seg);
@@ -1086,67 +1136,73 @@ PutSegment(FileNode fn, char *ccnRoot, seg_t seg) {
 			free(addr);
 			return -1;
 		}
-	} else {
-		addr = MapSeg(fn, seg);
-		if (addr == NULL) {
-			fprintf(stdout, "** can't map file %s, seg %jd\n",
-					fn->id, seg);
-			flushLog();
-			return -1;
-		}
+		cob = SignSegment(fn, ccnRoot, seg, addr, segLen);
+		free(addr);
+		if (cob == NULL) return -1;
 	}
 	fn->lastUsed = GetCurrentTime();
 	
-	// serve up the segment
-    struct ccn_charbuf *cb = ccn_charbuf_create();
-	int res = SetNameCCN(cb, ccnRoot, dir, fn->unPercName);
-	if (res < 0) {
-		// don't let this get farther
-		ccn_charbuf_destroy(&cb);
-		return retErr("bad name?");
-	}
-	
-	// see ccn_versioning.c: ccn_create_version
-	ccn_create_version(md->ccn, cb, 0,
-					   fn->modTime.tv_sec, fn->modTime.tv_nsec);
-	ccn_name_append_numeric(cb, CCN_MARKER_SEQNUM, seg);
-	
-    struct ccn_charbuf *temp = ccn_charbuf_create();
-    ret = ccn_sign_content(md->ccn, temp, cb, &fn->signing_params, addr, segLen);
-	if (ret != 0) {
-		fprintf(stdout, "** ccn_sign_content failed (res == %d)\n",
-				ret);
+	// OK, try to put the data
+	ret = ccn_put(md->ccn, cob->buf, cob->length);
+	if (ret < 0) {
+		fprintf(stdout,
+				"** ccn_put failed (%s, %jd, res == %d)\n",
+				fn->id, seg, ret);
 		ret = -1;
 	} else {
-		// OK, try to put the data
-		ret = ccn_put(md->ccn, temp->buf, temp->length);
-		if (ret < 0) {
-			fprintf(stdout,
-					"** ccn_put failed (%s, %jd, res == %d)\n",
-					fn->id, seg, ret);
-			ret = -1;
-		} else {
-			fn->nSegsPut++;
-			if (seg > fn->maxSegPut) fn->maxSegPut = seg;
-		}
-	}
-    // Only the first segment gets the key locator
-    fn->signing_params.sp_flags |= CCN_SP_OMIT_KEY_LOCATOR;
-	// cleanup
-	if (usePRead) {
-		free(addr);
-	} else {
-		UnMapSeg(fn);
+		fn->nSegsPut++;
 	}
 	flushLog();
-	ccn_charbuf_destroy(&cb);
-	ccn_charbuf_destroy(&temp);
 	md->stats.segmentsPut++;
-	md->stats.bytesPut = md->stats.bytesPut + segLen;
+	md->stats.bytesPut = md->stats.bytesPut + SegmentLength(fn, seg);
 	md->changes++;
 	return ret;
 }
 
+static void
+AppendToSegments(NetRequest nr, FileNode fn, char *buf, int n) {
+	// AppendToSegments assembles segments from the HTTP stream, and signs
+	// each one as soon as it is complete, so it can be served from the
+	// segment cache without going back to the file
+	// must be called before fn->fileSize is advanced
+	MainData md = fn->md;
+	int ss = md->segSize;
+	seg_t seg = (fn->fileSize - fn->asmLen) / ss;
+	if (fn->asmBuf == NULL) fn->asmBuf = ProxyUtil_Alloc(ss, char);
+	while (n > 0) {
+		if (fn->asmLen == ss) {
+			// the held segment is not the final one after all
+			SignSegment(fn, nr->ccnRoot, seg, fn->asmBuf, ss);
+			fn->asmLen = 0;
+			seg++;
+		}
+		int rem = ss - fn->asmLen;
+		if (rem > n) rem = n;
+		memcpy(fn->asmBuf + fn->asmLen, buf, rem);
+		fn->asmLen = fn->asmLen + rem;
+		buf = buf + rem;
+		n = n - rem;
+	}
+	if (fn->asmLen == ss && fn->finalSeg >= 0) {
+		// the final segment is known, so there is no need to hold this one
+		SignSegment(fn, nr->ccnRoot, seg, fn->asmBuf, ss);
+		fn->asmLen = 0;
+	}
+}
+
+static void
+FlushSegments(NetRequest nr, FileNode fn) {
+	// signs the last (possibly partial) segment, once the size is final
+	int ss = fn->md->segSize;
+	if (fn->asmLen > 0) {
+		seg_t seg = (fn->fileSize - fn->asmLen) / ss;
+		SignSegment(fn, nr->ccnRoot, seg, fn->asmBuf, fn->asmLen);
+		fn->asmLen = 0;
+	}
+	if (fn->asmBuf != NULL) free(fn->asmBuf);
+	fn->asmBuf = NULL;
+}
+
 static seg_t
 GetSegmentNumber(struct ccn_upcall_info *info) {
 	// gets the current segment number for the info
@@ -1618,16 +1674,20 @@ EndNetRequest(NetRequest nr) {
 	if (fn != NULL && nr->error == 0) {
 		// we have completion
 		AssertFinalSize(nr->fn, fn->fileSize);
+		FlushSegments(nr, fn);
 		// process any pending segments
 		for (;;) {
 			SegList pending = nr->segRequests;
 			if (pending == NULL) break;
-			if (pending->seg < fn->nSegs)
-				PutSegment(fn, nr->ccnRoot, pending->seg);
-			RemSegRequest(nr, pending->seg);
+			seg_t seg = pending->seg;
+			if (seg < fn->nSegs)
+				PutSegment(fn, nr->ccnRoot, seg);
+			RemSegRequest(nr, seg);
 		}
 		nr->fn = NULL;
 	}
+	while (nr->segRequests != NULL)
+		RemSegRequest(nr, nr->segRequests->seg);
 	
 	UnlinkNetRequest(nr);
 	
@@ -1723,12 +1783,13 @@ ReadFromHttp(NetRequest nr) {
 			EndNetRequest(nr);
 			return retErr("ReadFromHttp could not create file");
 		}
+		if (h->totalLen > 0 && fn->create) {
+			// the size is known, so every segment can carry the FinalBlockID
+			SetFinalBlock(fn, (h->totalLen + md->segSize - 1) / md->segSize - 1);
+		}
 	}
 	if (fn->fd >= 0) {
-		// first, fill in any temp segments
-		FillTempSegments(fn, nr->buf, n);
-		
-		// now, append the buffer to the file
+		// append the buffer to the file
 		ssize_t nWrite = write(fn->fd, nr->buf, n);
 		if (md->debug) {
 			fprintf(stdout, "-- ReadFromHttp, %s, wrote %zd bytes",
@@ -1739,12 +1800,21 @@ ReadFromHttp(NetRequest nr) {
 			flushLog();
 		}
 		
-		fn->fileSize = fn->fileSize + nWrite;
-		fn->nSegs = (fn->fileSize + CCN_CHUNK_SIZE - 1) / CCN_CHUNK_SIZE;
-		
+		if (nWrite > 0) {
+			// sign the segments that this completes
+			AppendToSegments(nr, fn, nr->buf, nWrite);
+			fn->fileSize = fn->fileSize + nWrite;
+			fn->nSegs = (fn->fileSize + md->segSize - 1) / md->segSize;
+			if (fn->disk != NULL) {
+				fn->disk->size = fn->fileSize;
+				md->diskBytes = md->diskBytes + nWrite;
+				EvictDiskFiles(md);
+			}
+		}
 		
 		if (nWrite < n) {
 			// dreck, a write error!
+			nr->error = 1;
 			EndNetRequest(nr);
 			return retErr("ReadFromHttp write error");
 		}
@@ -1786,14 +1856,14 @@ ReadFromHttp(NetRequest nr) {
 		nr->endSeen = 1;
 	
 	// process any pending segments for the stable part of the file
-	for (;;) {
-		SegList pending = nr->segRequests;
-		if (pending == NULL) break;
+	SegList pending = nr->segRequests;
+	while (pending != NULL) {
 		seg_t seg = pending->seg;
+		pending = pending->next;
 		if (HaveSegment(fn, seg)) {
 			PutSegment(fn, nr->ccnRoot, seg);
 			RemSegRequest(nr, seg);
-		} else break;
+		}
 	}
 	
 	if (nr->endSeen) {
@@ -1878,10 +1948,7 @@ NoteInterest(struct ccn_closure *selfp,
 				AddSegRequest(nr, seg);
 			} else {
 				// there IS a file node
-				seg_t nSegs = fn->nSegs;
-				seg_t safeSeg = nSegs;
-				if (fn->final == 0) safeSeg--;
-				if (seg >= safeSeg && nr != NULL) {
+				if (HaveSegment(fn, seg) == 0 && nr != NULL) {
 					// file is not yet stable at tail end
 					// ignore this interest and hope that we get another
 					if (md->debug) {
@@ -1889,8 +1956,8 @@ NoteInterest(struct ccn_closure *selfp,
 						fprintf(stdout, fmt, host, us, seg);
 					}
 					AddSegRequest(nr, seg);
-				} else if (seg < nSegs) {
-					// we should have the segment in the file
+				} else if (HaveSegment(fn, seg)) {
+					// we should have the segment in the cache or the file
 					if (PutSegment(fn, iData->ccnRoot, seg) < 0) {
 						// should not happen
 						fprintf(stdout,
@@ -1960,6 +2027,15 @@ ShowStats(MainData md) {
 			(intmax_t) md->stats.segmentsPut);
 	fprintf(stdout, ", bytesPut %jd",
 			(intmax_t) md->stats.bytesPut);
+	fprintf(stdout, ", segmentsSigned %jd",
+			(intmax_t) md->stats.segmentsSigned);
+	fprintf(stdout, ", cacheHits %jd",
+			(intmax_t) md->stats.cacheHits);
+	fprintf(stdout, ", cacheBytes %jd",
+			(intmax_t) md->cacheBytes);
+	if (md->diskMax > 0)
+		fprintf(stdout, ", diskBytes %jd",
+				(intmax_t) md->diskBytes);
 	fprintf(stdout, "\n");
 	flushLog();
 }
@@ -2078,6 +2154,9 @@ main(int argc, char **argv) {
 	md->keepAliveDefault = KeepAliveDefault;
 	md->progname = progname;
 	md->ccnRoot = "TestCCN";
+	md->segSize = CCN_CHUNK_SIZE;
+	md->cacheMax = MemCacheDefault;
+	md->diskMax = DiskCacheDefault;
 	
 	int i = 1;
 	for (; i <= argc; i++) {
@@ -2106,9 +2185,36 @@ main(int argc, char **argv) {
 					return -1;
 				}
 				md->maxBusySameHost = n;
+			} else if (strcasecmp(arg, "-segSize") == 0) {
+				i++;
+				int n = 0;
+				if (i <= argc) n = atoi(argv[i]);
+				if (n < 1024 || n > 32*1024) {
+					fprintf(stdout, "** bad segSize: %d\n", n);
+					return -1;
+				}
+				md->segSize = n;
+			} else if (strcasecmp(arg, "-memCache") == 0) {
+				i++;
+				int n = -1;
+				if (i <= argc) n = atoi(argv[i]);
+				if (n < 0) {
+					fprintf(stdout, "** bad memCache: %d\n", n);
+					return -1;
+				}
+				md->cacheMax = n * (int64_t) (1024*1024);
+			} else if (strcasecmp(arg, "-diskCache") == 0) {
+				i++;
+				int n = -1;
+				if (i <= argc) n = atoi(argv[i]);
+				if (n < 0) {
+					fprintf(stdout, "** bad diskCache: %d\n", n);
+					return -1;
+				}
+				md->diskMax = n * (int64_t) (1024*1024);
 			} else {
 				fprintf(stdout, "** bad arg: %s\n", arg);
-                fprintf(stdout, "Usage: %s -fsRoot <root> -ccnRoot <uri> -noDebug -absTime -fanOut <n>\n", argv[0]);
+                fprintf(stdout, "Usage: %s -fsRoot <root> -ccnRoot <uri> -noDebug -absTime -fanOut <n> -segSize <n> -memCache <MB> -diskCache <MB>\n", argv[0]);
 				return -1;
 			}
 		}
@@ -2116,6 +2222,12 @@ main(int argc, char **argv) {
 	
 	signal(SIGPIPE, SIG_IGN);
 	
+	if (md->diskMax > 0 && md->fsRoot != NULL) {
+		// account for the files left by earlier runs
+		ScanDiskCache(md, md->fsRoot);
+		EvictDiskFiles(md);
+	}
+	
 	status = init_internal_keystore(md);
 	if (status >= 0)
 		status = MainLoop(md);
@@ -29,11 +29,13 @@
 #include <poll.h>
 #include <errno.h>
 
+#ifndef CCN_VLC_HARNESS
 #include <vlc_common.h>
 #include <vlc_plugin.h>
 #include <vlc_access.h>
 #include <vlc_url.h>
 #include <vlc_threads.h>
+#endif
 
 #include <ccn/ccn.h>
 #include <ccn/charbuf.h>
@@ -51,6 +53,10 @@
 #define CCN_VERSION_TIMEOUT 5000
 #define CCN_HEADER_TIMEOUT 1000
 #define CCN_DEFAULT_PREFETCH 12
+#define CCN_DEFAULT_PREFETCH_BYTES (8 * 1024 * 1024)
+#define CCN_DEFAULT_PREFETCH_TIME 3000
+#define CCN_RING_MAX 2048
+#define CCN_JITTER_WAIT 200
 
 #define CCN_PREFETCH_LIFETIME 1023
 #define CCN_DATA_LIFETIME 1024
@@ -58,6 +64,13 @@
 #define PREFETCH_LONGTEXT N_(                                          \
 "Number of content objects prefetched, "                       \
 "and offset from content object received for next interest.")
+#define PREFETCH_BYTES_TEXT N_("Prefetch limit (bytes)")
+#define PREFETCH_BYTES_LONGTEXT N_(                                    \
+"Maximum number of bytes requested ahead of the read position.")
+#define PREFETCH_TIME_TEXT N_("Prefetch time (ms)")
+#define PREFETCH_TIME_LONGTEXT N_(                                     \
+"Milliseconds of the stream, at the observed read rate, "             \
+"to keep requested ahead of the read position.")
 #define SEEKABLE_TEXT N_("CCN streams can seek")
 #define SEEKABLE_LONGTEXT N_(               \
 "Enable or disable seeking within a CCN stream.")
@@ -82,6 +95,7 @@ static int CCNSeek(access_t *, int64_t);
 #endif
 static int CCNControl(access_t *, int, va_list);
 
+#ifndef CCN_VLC_HARNESS
 vlc_module_begin();
 set_shortname(N_("CCNx"));
 set_description(N_("Access streams via CCNx"));
@@ -90,11 +104,19 @@ set_subcategory(SUBCAT_INPUT_ACCESS);
 #if (VLCPLUGINVER < 10200)
 add_integer("ccn-prefetch", CCN_DEFAULT_PREFETCH, NULL,
             PREFETCH_TEXT, PREFETCH_LONGTEXT, true);
+add_integer("ccn-prefetch-bytes", CCN_DEFAULT_PREFETCH_BYTES, NULL,
+            PREFETCH_BYTES_TEXT, PREFETCH_BYTES_LONGTEXT, true);
+add_integer("ccn-prefetch-time", CCN_DEFAULT_PREFETCH_TIME, NULL,
+            PREFETCH_TIME_TEXT, PREFETCH_TIME_LONGTEXT, true);
 add_bool("ccn-streams-seekable", true, NULL,
          SEEKABLE_TEXT, SEEKABLE_LONGTEXT, true )
 #else
 add_integer("ccn-prefetch", CCN_DEFAULT_PREFETCH,
             PREFETCH_TEXT, PREFETCH_LONGTEXT, true);
+add_integer("ccn-prefetch-bytes", CCN_DEFAULT_PREFETCH_BYTES,
+            PREFETCH_BYTES_TEXT, PREFETCH_BYTES_LONGTEXT, true);
+add_integer("ccn-prefetch-time", CCN_DEFAULT_PREFETCH_TIME,
+            PREFETCH_TIME_TEXT, PREFETCH_TIME_LONGTEXT, true);
 add_integer("ccn-version-timeout", CCN_VERSION_TIMEOUT,
             VERSION_TIMEOUT_TEXT, VERSION_TIMEOUT_LONGTEXT, true);
 add_integer("ccn-header-timeout", CCN_HEADER_TIMEOUT,
@@ -110,17 +132,36 @@ add_shortcut("ccn");
 add_shortcut("ccnx");
 set_callbacks(CCNOpen, CCNClose);
 vlc_module_end();
+#endif
 
 /*****************************************************************************
  * Local prototypes
  *****************************************************************************/
+struct ring_slot
+{
+    uintmax_t i_seq;        /**< segment number of the content object held */
+    bool b_valid;           /**< true if p_co holds segment i_seq */
+    struct ccn_charbuf *p_co;   /**< content object storage */
+};
+
 struct access_sys_t
 {
     int i_chunksize;        /**< size of CCN ContentObject data blocks */
-    int i_prefetch;         /**< offset for prefetching */
+    int i_prefetch;         /**< minimum number of segments prefetched */
+    int i_prefetch_bytes;   /**< maximum number of bytes prefetched */
+    int i_prefetch_time;    /**< milliseconds of stream to keep prefetched */
     int i_version_timeout;  /**< timeout in seconds for getting latest media version */
     int i_header_timeout;   /**< timeout in seconds for getting latest header version */
     int i_missed_co;        /**< number of content objects we missed in CCNBlock */
+    int i_ring_hits;        /**< number of content objects found in the ring */
+    int i_reexpressed;      /**< number of prefetch interests reexpressed */
+    int i_ring_size;        /**< number of slots in p_ring */
+    struct ring_slot *p_ring;   /**< prefetched segments, indexed by seq % i_ring_size */
+    uintmax_t i_window_base;    /**< first segment of the prefetch window */
+    uintmax_t i_window_next;    /**< next segment of the window to be requested */
+    int64_t i_rate;         /**< observed read rate, bytes per second */
+    int64_t i_rate_bytes;   /**< bytes read since i_rate_start */
+    mtime_t i_rate_start;   /**< start of the current rate sample */
     struct ccn *ccn;        /**< CCN handle */
     struct ccn *ccn_pf;     /**< CCN handle for prefetch thread */
     struct ccn_closure *prefetch;   /**< closure for handling prefetch content */
@@ -130,12 +171,15 @@ struct access_sys_t
     struct ccn_charbuf *p_content_object; /**< content object storage */
     struct ccn_indexbuf *p_compsbuf; /**< name components indexbuf scratch storage */
     vlc_thread_t thread;    /**< thread that is running prefetch ccn_run loop */
-    vlc_mutex_t lock;       /**< mutex protecting ccn_pf handle */
+    vlc_mutex_t lock;       /**< mutex protecting ccn_pf handle and the ring */
+    vlc_cond_t wait;        /**< signalled when a segment arrives in the ring */
 };
 
-static enum ccn_upcall_res discard_content(struct ccn_closure *selfp,
-                                           enum ccn_upcall_kind kind,
-                                           struct ccn_upcall_info *info);
+static enum ccn_upcall_res incoming_content(struct ccn_closure *selfp,
+                                            enum ccn_upcall_kind kind,
+                                            struct ccn_upcall_info *info);
+static struct ring_slot *ring_lookup(access_sys_t *p_sys, uintmax_t i_seq);
+static void fill_window(access_t *p_access);
 static void *ccn_prefetch_thread(void *p_this);
 static void sequenced_name(struct ccn_charbuf *name,
                            struct ccn_charbuf *basename, uintmax_t seq);
@@ -158,6 +202,14 @@ static void p_sys_clean(struct access_sys_t *p_sys) {
     ccn_charbuf_destroy(&p_sys->p_data_template);
     ccn_charbuf_destroy(&p_sys->p_content_object);
     ccn_indexbuf_destroy(&p_sys->p_compsbuf);
+    if (p_sys->p_ring != NULL) {
+        int i;
+        for (i = 0; i < p_sys->i_ring_size; i++)
+            ccn_charbuf_destroy(&p_sys->p_ring[i].p_co);
+        free(p_sys->p_ring);
+        p_sys->p_ring = NULL;
+    }
+    vlc_cond_destroy(&p_sys->wait);
     vlc_mutex_destroy(&p_sys->lock);
 }
 
@@ -177,6 +229,7 @@ CCNOpen(vlc_object_t *p_this)
     int i;
     struct ccn_charbuf *p_name = NULL;
     struct ccn_header *p_header = NULL;
+    struct ccn_parsed_ContentObject pcobuf = {0};
     bool b_tcp;
     
     /* Init p_access */
@@ -192,6 +245,8 @@ CCNOpen(vlc_object_t *p_this)
     p_sys->i_chunksize = -1;
     p_sys->i_missed_co = 0;
     p_sys->i_prefetch = var_CreateGetInteger(p_access, "ccn-prefetch");
+    p_sys->i_prefetch_bytes = var_CreateGetInteger(p_access, "ccn-prefetch-bytes");
+    p_sys->i_prefetch_time = var_CreateGetInteger(p_access, "ccn-prefetch-time");
     p_sys->i_version_timeout = var_CreateGetInteger(p_access, "ccn-version-timeout");
     p_sys->i_header_timeout = var_CreateGetInteger(p_access, "ccn-header-timeout");
     b_tcp = var_CreateGetBool(p_access, "ccn-tcp-connect");
@@ -210,8 +265,9 @@ CCNOpen(vlc_object_t *p_this)
     msg_Dbg(p_access, "CCNOpen %s", p_access->psz_path);
 #endif
     vlc_mutex_init(&p_sys->lock);
+    vlc_cond_init(&p_sys->wait);
     p_sys->prefetch->data = p_access; /* so CCN callbacks can find p_sys */
-    p_sys->prefetch->p = &discard_content; /* the CCN callback */
+    p_sys->prefetch->p = &incoming_content; /* the CCN callback */
     
     p_sys->ccn = ccn_create();
     if (p_sys->ccn == NULL || ccn_connect(p_sys->ccn, b_tcp ? "tcp" : NULL) == -1) {
@@ -263,27 +319,52 @@ CCNOpen(vlc_object_t *p_this)
     /* make sure we can get the first block, or fail early */
     p_name = ccn_charbuf_create();
     sequenced_name(p_name, p_sys->p_name, 0);
-    i_ret = ccn_get(p_sys->ccn, p_name, p_sys->p_data_template, 5000, p_sys->p_content_object, NULL, NULL, 0);
+    i_ret = ccn_get(p_sys->ccn, p_name, p_sys->p_data_template, 5000, p_sys->p_content_object, &pcobuf, NULL, 0);
     if (i_ret < 0) {
         ccn_charbuf_destroy(&p_name);
         msg_Err(p_access, "CCNOpen failed: unable to locate specified input");
         goto exit;
     }
+    ccn_charbuf_destroy(&p_name);
+    if (p_sys->i_chunksize <= 0) {
+        /* no header, so the first segment tells us the block size */
+        const unsigned char *data = NULL;
+        size_t data_size = 0;
+        ccn_content_get_value(p_sys->p_content_object->buf,
+                              p_sys->p_content_object->length,
+                              &pcobuf, &data, &data_size);
+        p_sys->i_chunksize = (data_size > 0) ? data_size : 4096;
+        msg_Dbg(p_access, "CCNOpen no header, block size %d", p_sys->i_chunksize);
+    }
+    /* the ring holds the prefetch window, and some of what was read before */
+    i = p_sys->i_prefetch_bytes / p_sys->i_chunksize;
+    if (i < p_sys->i_prefetch)
+        i = p_sys->i_prefetch;
+    i = 2 * i + 1;
+    if (i > CCN_RING_MAX)
+        i = CCN_RING_MAX;
+    p_sys->p_ring = calloc(i, sizeof(struct ring_slot));
+    CHECK_NOMEM(p_sys->p_ring, "CCNOpen failed: no memory for prefetch ring");
+    p_sys->i_ring_size = i;
+    for (i = 0; i < p_sys->i_ring_size; i++) {
+        p_sys->p_ring[i].p_co = ccn_charbuf_create();
+        CHECK_NOMEM(p_sys->p_ring[i].p_co, "CCNOpen failed: no memory for prefetch ring");
+    }
+    ccn_charbuf_append_charbuf(p_sys->p_ring[0].p_co, p_sys->p_content_object);
+    p_sys->p_ring[0].i_seq = 0;
+    p_sys->p_ring[0].b_valid = true;
+    p_sys->i_rate_start = mdate();
+    
     if (0 != vlc_clone(&(p_sys->thread), ccn_prefetch_thread, p_access, VLC_THREAD_PRIORITY_INPUT)) {
         msg_Err(p_access, "CCNOpen failed: unable to vlc_clone for CCN prefetch thread");
         goto exit;
     }
     /* start prefetches for some more, unless it's a short file */
     vlc_mutex_lock(&p_sys->lock);
-    for (i=1; i <= p_sys->i_prefetch; i++) {
-        if (i * p_sys->i_chunksize >= p_access->info.i_size)
-            break;
-        sequenced_name(p_name, p_sys->p_name, i);
-        i_ret = ccn_express_interest(p_sys->ccn_pf, p_name, p_sys->prefetch,
-                                     p_sys->p_prefetch_template);
-    }
+    p_sys->i_window_base = 0;
+    p_sys->i_window_next = 1;
+    fill_window(p_access);
     vlc_mutex_unlock(&p_sys->lock);
-    ccn_charbuf_destroy(&p_name);
     return (VLC_SUCCESS);
     
 exit:
@@ -303,7 +384,8 @@ CCNClose(vlc_object_t *p_this)
     access_t     *p_access = (access_t *)p_this;
     access_sys_t *p_sys = p_access->p_sys;
     
-    msg_Info(p_access, "CCNClose called, missed %d blocks", p_sys->i_missed_co);
+    msg_Info(p_access, "CCNClose called, missed %d blocks, %d from prefetch, %d reexpressed",
+             p_sys->i_missed_co, p_sys->i_ring_hits, p_sys->i_reexpressed);
     ccn_run(p_sys->ccn, 100);
     ccn_disconnect(p_sys->ccn);
     vlc_mutex_lock(&p_sys->lock);
@@ -326,10 +408,13 @@ CCNBlock(access_t *p_access)
     block_t *p_block = NULL;
     struct ccn_charbuf *p_name = NULL;
     struct ccn_parsed_ContentObject pcobuf = {0};
+    struct ring_slot *p_slot = NULL;
     const unsigned char *data = NULL;
     size_t data_size = 0;
     uint64_t start_offset = 0;
-    uint64_t i_nextpos;
+    uintmax_t i_seq;
+    mtime_t i_now;
+    mtime_t i_deadline;
     int i_ret;
     bool b_last = false;
     
@@ -338,13 +423,37 @@ CCNBlock(access_t *p_access)
         return NULL;
     }
     // start
-    p_name = ccn_charbuf_create();
-    sequenced_name(p_name, p_sys->p_name, p_access->info.i_pos / p_sys->i_chunksize);
-    i_ret = ccn_get(p_sys->ccn, p_name, p_sys->p_data_template, 250, p_sys->p_content_object, &pcobuf, p_sys->p_compsbuf, 0);
-    if (i_ret < 0) {
+    i_seq = p_access->info.i_pos / p_sys->i_chunksize;
+    vlc_mutex_lock(&p_sys->lock);
+    /* slide the window up to the read position, and keep it full */
+    p_sys->i_window_base = i_seq;
+    fill_window(p_access);
+    /* absorb jitter by waiting a little while for the prefetch to arrive */
+    i_deadline = mdate() + INT64_C(1000) * CCN_JITTER_WAIT;
+    while ((p_slot = ring_lookup(p_sys, i_seq)) == NULL) {
+        if (vlc_cond_timedwait(&p_sys->wait, &p_sys->lock, i_deadline) != 0)
+            break;
+    }
+    if (p_slot != NULL) {
+        ccn_charbuf_reset(p_sys->p_content_object);
+        ccn_charbuf_append_charbuf(p_sys->p_content_object, p_slot->p_co);
+        p_sys->i_ring_hits++;
+    }
+    vlc_mutex_unlock(&p_sys->lock);
+    if (p_slot != NULL) {
+        i_ret = ccn_parse_ContentObject(p_sys->p_content_object->buf,
+                                        p_sys->p_content_object->length,
+                                        &pcobuf, p_sys->p_compsbuf);
+    } else {
+        /* not prefetched in time, so ask for it directly */
+        p_sys->i_missed_co++;
+        p_name = ccn_charbuf_create();
+        sequenced_name(p_name, p_sys->p_name, i_seq);
+        i_ret = ccn_get(p_sys->ccn, p_name, p_sys->p_data_template, 250, p_sys->p_content_object, &pcobuf, p_sys->p_compsbuf, 0);
         ccn_charbuf_destroy(&p_name);
+    }
+    if (i_ret < 0) {
         msg_Dbg(p_access, "CCNBlock unable to retrieve requested content: retrying");
-        p_sys->i_missed_co++;
         return NULL;
     }
     i_ret = ccn_content_get_value(p_sys->p_content_object->buf, p_sys->p_content_object->length, &pcobuf, &data, &data_size);
@@ -352,17 +461,6 @@ CCNBlock(access_t *p_access)
         b_last = true;
     if (data_size > 0) {
         start_offset = p_access->info.i_pos % p_sys->i_chunksize;
-        /* Ask for next fragment as soon as possible */
-        if (!b_last) {
-            i_nextpos = p_access->info.i_pos + (data_size - start_offset);
-            /* prefetch a fragment if it's not past the end */
-            if (p_sys->i_prefetch * p_sys->i_chunksize <= p_access->info.i_size - i_nextpos) {
-                sequenced_name(p_name, p_sys->p_name, p_sys->i_prefetch + i_nextpos / p_sys->i_chunksize);
-                vlc_mutex_lock(&p_sys->lock);
-                i_ret = ccn_express_interest(p_sys->ccn_pf, p_name, p_sys->prefetch, p_sys->p_prefetch_template);
-                vlc_mutex_unlock(&p_sys->lock);
-            }
-        }
         if (start_offset > data_size) {
             msg_Err(p_access, "CCNBlock start_offset %"PRId64" > data_size %zu", start_offset, data_size);
         } else {
@@ -370,8 +468,16 @@ CCNBlock(access_t *p_access)
             memcpy(p_block->p_buffer, data + start_offset, data_size - start_offset);
         }
         p_access->info.i_pos += (data_size - start_offset);
+        /* track the read rate, to size the prefetch window in time */
+        p_sys->i_rate_bytes += (data_size - start_offset);
+        i_now = mdate();
+        if (i_now - p_sys->i_rate_start >= INT64_C(1000000)) {
+            int64_t i_sample = p_sys->i_rate_bytes * INT64_C(1000000) / (i_now - p_sys->i_rate_start);
+            p_sys->i_rate = (p_sys->i_rate == 0) ? i_sample : (p_sys->i_rate + i_sample) / 2;
+            p_sys->i_rate_bytes = 0;
+            p_sys->i_rate_start = i_now;
+        }
     }
-    ccn_charbuf_destroy(&p_name);
     
     // end
     if (b_last) {
@@ -384,11 +490,13 @@ CCNBlock(access_t *p_access)
 /*****************************************************************************
  * CCNSeek:
  *****************************************************************************/
-/* XXX - VLC behavior when playing an MP4 file is to seek back and forth for
- * the audio and video, which may be separated by many megabytes, so it is
- * a much better (and possibly required) that the code not discard all
- * previously buffered data when seeking, since the app is likely to seek back
- * close to where it was very quickly.
+/* VLC behavior when playing an MP4 file is to seek back and forth for
+ * the audio and video, which may be separated by many megabytes, so the
+ * ring does not discard previously buffered data when seeking: segments
+ * stay until their slot is reused, and the app is likely to seek back close
+ * to where it was very quickly.  The old window is cancelled by moving it;
+ * anything outstanding that falls outside the new window is dropped when it
+ * arrives, and is not reexpressed when it times out.
  */
 #if (VLCPLUGINVER < 10100)
 static int CCNSeek(access_t *p_access, int64_t i_pos)
@@ -397,8 +505,6 @@ static int CCNSeek(access_t *p_access, uint64_t i_pos)
 #endif
 {
     access_sys_t *p_sys = p_access->p_sys;
-    struct ccn_charbuf *p_name;
-    int i, i_prefetch, i_base;
     
 #if (VLCPLUGINVER < 10100)
     if (i_pos < 0) {
@@ -406,24 +512,14 @@ static int CCNSeek(access_t *p_access, uint64_t i_pos)
         i_pos = 0;
     }
 #endif
-    /* prefetch, but only do full amount if going forward */
-    if (i_pos > p_access->info.i_pos)
-        i_prefetch = p_sys->i_prefetch;
-    else
-        i_prefetch = p_sys->i_prefetch / 2;
-    i_base = i_pos / p_sys->i_chunksize;
-    p_name = ccn_charbuf_create();
-    for (i = 0; i <= i_prefetch; i++) {
-        sequenced_name(p_name, p_sys->p_name, i_base + i);
-        vlc_mutex_lock(&p_sys->lock);
-        ccn_express_interest(p_sys->ccn_pf, p_name, p_sys->prefetch,
-                             p_sys->p_prefetch_template);
-        vlc_mutex_unlock(&p_sys->lock);
-    }
-    ccn_charbuf_destroy(&p_name);        
-    
     p_access->info.i_pos = i_pos;
     p_access->info.b_eof = false;
+    
+    vlc_mutex_lock(&p_sys->lock);
+    p_sys->i_window_base = i_pos / p_sys->i_chunksize;
+    p_sys->i_window_next = p_sys->i_window_base;
+    fill_window(p_access);
+    vlc_mutex_unlock(&p_sys->lock);
     return (VLC_SUCCESS);
 }
 /*****************************************************************************
@@ -502,14 +598,129 @@ ccn_prefetch_thread(void *p_this)
     return NULL;
 }
 
+/*
+ * Extract the segment number from the last component of a name.
+ */
+static int
+seq_from_name(const unsigned char *ccnb, struct ccn_indexbuf *comps,
+              uintmax_t *p_seq)
+{
+    const unsigned char *comp = NULL;
+    size_t size = 0;
+    size_t i;
+    uintmax_t seq = 0;
+    
+    if (comps == NULL || comps->n < 2)
+        return (-1);
+    if (ccn_name_comp_get(ccnb, comps, comps->n - 2, &comp, &size) < 0)
+        return (-1);
+    if (size < 1 || size > 1 + sizeof(seq) || comp[0] != CCN_MARKER_SEQNUM)
+        return (-1);
+    for (i = 1; i < size; i++)
+        seq = (seq << 8) | comp[i];
+    *p_seq = seq;
+    return (0);
+}
+
+/*
+ * Called from ccn_run on the prefetch handle, so p_sys->lock is held.
+ */
 static enum ccn_upcall_res
-discard_content(struct ccn_closure *selfp,
-                enum ccn_upcall_kind kind,
-                struct ccn_upcall_info *info)
+incoming_content(struct ccn_closure *selfp,
+                 enum ccn_upcall_kind kind,
+                 struct ccn_upcall_info *info)
 {
+    access_t *p_access = (access_t *)selfp->data;
+    access_sys_t *p_sys;
+    struct ring_slot *p_slot;
+    uintmax_t i_seq;
+    
+    if (kind == CCN_UPCALL_FINAL || p_access == NULL)
+        return(CCN_UPCALL_RESULT_OK);
+    if (kind != CCN_UPCALL_CONTENT && kind != CCN_UPCALL_INTEREST_TIMED_OUT)
+        return(CCN_UPCALL_RESULT_OK);
+    p_sys = p_access->p_sys;
+    if (p_sys == NULL || p_sys->p_ring == NULL)
+        return(CCN_UPCALL_RESULT_OK);
+    if (seq_from_name(info->interest_ccnb, info->interest_comps, &i_seq) < 0)
+        return(CCN_UPCALL_RESULT_OK);
+    /* anything outside the window was cancelled by a seek, or already read */
+    if (i_seq < p_sys->i_window_base || i_seq >= p_sys->i_window_next)
+        return(CCN_UPCALL_RESULT_OK);
+    if (kind == CCN_UPCALL_INTEREST_TIMED_OUT) {
+        p_sys->i_reexpressed++;
+        return(CCN_UPCALL_RESULT_REEXPRESS);
+    }
+    p_slot = &p_sys->p_ring[i_seq % p_sys->i_ring_size];
+    ccn_charbuf_reset(p_slot->p_co);
+    ccn_charbuf_append(p_slot->p_co, info->content_ccnb,
+                       info->pco->offset[CCN_PCO_E]);
+    p_slot->i_seq = i_seq;
+    p_slot->b_valid = true;
+    vlc_cond_signal(&p_sys->wait);
     return(CCN_UPCALL_RESULT_OK);
 }
 
+/*
+ * Find a segment in the ring; p_sys->lock must be held.
+ */
+static struct ring_slot *
+ring_lookup(access_sys_t *p_sys, uintmax_t i_seq)
+{
+    struct ring_slot *p_slot = &p_sys->p_ring[i_seq % p_sys->i_ring_size];
+    
+    if (p_slot->b_valid && p_slot->i_seq == i_seq)
+        return (p_slot);
+    return (NULL);
+}
+
+/*
+ * Express interests for the part of the window not yet requested.
+ * The window is at least i_prefetch segments, grows to cover i_prefetch_time
+ * at the observed read rate, and is capped by i_prefetch_bytes and the ring.
+ * p_sys->lock must be held.
+ */
+static void
+fill_window(access_t *p_access)
+{
+    access_sys_t *p_sys = p_access->p_sys;
+    struct ccn_charbuf *p_name;
+    int64_t i_window = p_sys->i_prefetch;
+    int64_t i_max = p_sys->i_prefetch_bytes / p_sys->i_chunksize;
+    uintmax_t i_end;
+    uintmax_t i_last;
+    
+    if (p_sys->i_rate > 0 && p_sys->i_prefetch_time > 0) {
+        int64_t i_want = p_sys->i_rate * p_sys->i_prefetch_time / 1000 / p_sys->i_chunksize;
+        if (i_want > i_window)
+            i_window = i_want;
+    }
+    if (i_max < 1)
+        i_max = 1;
+    if (i_window > i_max)
+        i_window = i_max;
+    if (i_window > p_sys->i_ring_size / 2)
+        i_window = p_sys->i_ring_size / 2;
+    /* don't prefetch past the end */
+    i_end = p_sys->i_window_base + 1 + i_window;
+    i_last = (p_access->info.i_size - 1) / p_sys->i_chunksize;
+    if (i_end > i_last + 1)
+        i_end = i_last + 1;
+    if (p_sys->i_window_next < p_sys->i_window_base)
+        p_sys->i_window_next = p_sys->i_window_base;
+    if (p_sys->i_window_next >= i_end)
+        return;
+    p_name = ccn_charbuf_create();
+    for (; p_sys->i_window_next < i_end; p_sys->i_window_next++) {
+        if (ring_lookup(p_sys, p_sys->i_window_next) != NULL)
+            continue;
+        sequenced_name(p_name, p_sys->p_name, p_sys->i_window_next);
+        ccn_express_interest(p_sys->ccn_pf, p_name, p_sys->prefetch,
+                             p_sys->p_prefetch_template);
+    }
+    ccn_charbuf_destroy(&p_name);
+}
+
 static void
 sequenced_name(struct ccn_charbuf *name, struct ccn_charbuf *basename, uintmax_t seq)
 {
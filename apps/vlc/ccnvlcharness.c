@@ -0,0 +1,331 @@
+/**
+ * @file apps/vlc/ccnvlcharness.c
+ *
+ * Headless harness for the CCNx input module for vlc.
+ *
+ * Drives the access functions of ccn.c (open, block, seek, close) without
+ * vlc, against content published by a local producer, and reports read
+ * latency, stalls, and how much was served from the prefetch ring.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+/*
+ * Just enough of the vlc plugin API for ccn.c
+ */
+#define CCN_VLC_HARNESS 1
+#define VLCPLUGINVER 10200
+
+typedef int64_t mtime_t;
+typedef struct access_sys_t access_sys_t;
+typedef struct access_t access_t;
+typedef struct access_t vlc_object_t;
+typedef pthread_mutex_t vlc_mutex_t;
+typedef pthread_cond_t vlc_cond_t;
+typedef pthread_t vlc_thread_t;
+
+typedef struct block_t {
+    uint8_t *p_buffer;
+    size_t i_buffer;
+} block_t;
+
+struct access_t {
+    char *psz_location;
+    struct {
+        uint64_t i_pos;
+        int64_t i_size;
+        bool b_eof;
+    } info;
+    block_t *(*pf_block)(access_t *);
+    int (*pf_seek)(access_t *, uint64_t);
+    int (*pf_control)(access_t *, int, va_list);
+    access_sys_t *p_sys;
+};
+
+enum {
+    ACCESS_CAN_SEEK, ACCESS_CAN_FASTSEEK, ACCESS_CAN_PAUSE,
+    ACCESS_CAN_CONTROL_PACE, ACCESS_GET_PTS_DELAY, ACCESS_GET_TITLE_INFO,
+    ACCESS_GET_META, ACCESS_GET_CONTENT_TYPE, ACCESS_GET_PRIVATE_ID_STATE,
+    ACCESS_SET_PAUSE_STATE, ACCESS_SET_TITLE, ACCESS_SET_SEEKPOINT,
+    ACCESS_SET_PRIVATE_ID_STATE, ACCESS_SET_PRIVATE_ID_CA
+};
+
+#define VLC_SUCCESS 0
+#define VLC_EGENERIC (-666)
+#define VLC_ENOMEM (-1)
+#define VLC_THREAD_PRIORITY_INPUT 0
+
+static int verbose = 0;
+static int64_t harness_var(const char *psz_name);
+static void harness_msg(int level, const char *fmt, ...);
+
+#define msg_Err(o, ...) harness_msg(0, __VA_ARGS__)
+#define msg_Warn(o, ...) harness_msg(1, __VA_ARGS__)
+#define msg_Info(o, ...) harness_msg(1, __VA_ARGS__)
+#define msg_Dbg(o, ...) harness_msg(2, __VA_ARGS__)
+#define var_CreateGetInteger(o, name) harness_var(name)
+#define var_CreateGetBool(o, name) (harness_var(name) != 0)
+#define var_InheritInteger(o, name) harness_var(name)
+#define access_InitFields(a) memset(&(a)->info, 0, sizeof((a)->info))
+#define ACCESS_SET_CALLBACKS(read, block, control, seek) \
+    do { p_access->pf_block = block; p_access->pf_control = control; \
+         p_access->pf_seek = seek; } while (0)
+
+#define vlc_mutex_init(m) pthread_mutex_init(m, NULL)
+#define vlc_mutex_destroy(m) pthread_mutex_destroy(m)
+#define vlc_mutex_lock(m) pthread_mutex_lock(m)
+#define vlc_mutex_unlock(m) pthread_mutex_unlock(m)
+#define vlc_cond_init(c) pthread_cond_init(c, NULL)
+#define vlc_cond_destroy(c) pthread_cond_destroy(c)
+#define vlc_cond_signal(c) pthread_cond_signal(c)
+#define vlc_clone(t, f, d, prio) pthread_create(t, NULL, f, d)
+#define vlc_join(t, r) pthread_join(t, r)
+
+static mtime_t
+mdate(void)
+{
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return (INT64_C(1000000) * now.tv_sec + now.tv_usec);
+}
+
+static int
+vlc_cond_timedwait(vlc_cond_t *p_cond, vlc_mutex_t *p_mutex, mtime_t deadline)
+{
+    struct timespec ts;
+    ts.tv_sec = deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+    return (pthread_cond_timedwait(p_cond, p_mutex, &ts));
+}
+
+static block_t *
+block_New(access_t *p_access, size_t i_size)
+{
+    block_t *p_block = calloc(1, sizeof(*p_block) + i_size);
+    p_block->p_buffer = (uint8_t *)(p_block + 1);
+    p_block->i_buffer = i_size;
+    return (p_block);
+}
+
+static void
+block_Release(block_t *p_block)
+{
+    free(p_block);
+}
+
+#include "ccn.c"
+
+static struct {
+    const char *psz_name;
+    int64_t i_value;
+} vars[] = {
+    {"ccn-prefetch", CCN_DEFAULT_PREFETCH},
+    {"ccn-prefetch-bytes", CCN_DEFAULT_PREFETCH_BYTES},
+    {"ccn-prefetch-time", CCN_DEFAULT_PREFETCH_TIME},
+    {"ccn-version-timeout", CCN_VERSION_TIMEOUT},
+    {"ccn-header-timeout", CCN_HEADER_TIMEOUT},
+    {"ccn-streams-seekable", 1},
+    {"ccn-tcp-connect", 0},
+    {"network-caching", 300},
+    {NULL, 0}
+};
+
+static int64_t
+harness_var(const char *psz_name)
+{
+    int i;
+    for (i = 0; vars[i].psz_name != NULL; i++)
+        if (strcmp(vars[i].psz_name, psz_name) == 0)
+            return (vars[i].i_value);
+    return (0);
+}
+
+static void
+set_var(const char *psz_name, const char *psz_value)
+{
+    int i;
+    for (i = 0; vars[i].psz_name != NULL; i++)
+        if (strcmp(vars[i].psz_name, psz_name) == 0)
+            vars[i].i_value = strtoll(psz_value, NULL, 10);
+}
+
+static void
+harness_msg(int level, const char *fmt, ...)
+{
+    va_list ap;
+    if (level > verbose)
+        return;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fprintf(stderr, "\n");
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-h] [-v] [-p segments] [-b bytes] [-t ms] [-s seeks] [-f file] ccnx:/name\n"
+            " Reads the named stream through the vlc access functions, then\n"
+            " seeks to pseudo-random positions, and reports latency and stalls.\n"
+            " -p, -b, -t set ccn-prefetch, ccn-prefetch-bytes, ccn-prefetch-time\n"
+            " -s number of seeks to do after the sequential read (default 20)\n"
+            " -f local copy of the content, to check what is read\n"
+            " -v more messages (repeat for debug)\n",
+            progname);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    const char *psz_file = NULL;
+    FILE *p_file = NULL;
+    unsigned char *p_check = NULL;
+    access_t access = {0};
+    access_t *p_access = &access;
+    block_t *p_block;
+    int64_t i_size = -1;
+    int64_t i_bytes = 0;
+    mtime_t i_start, i_before, i_delta, i_max = 0;
+    int i_blocks = 0, i_stalls = 0, i_bad = 0;
+    int i_seeks = 20;
+    int i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hvp:b:t:s:f:")) != -1) {
+        switch (opt) {
+            case 'v':
+                verbose++;
+                break;
+            case 'p':
+                set_var("ccn-prefetch", optarg);
+                break;
+            case 'b':
+                set_var("ccn-prefetch-bytes", optarg);
+                break;
+            case 't':
+                set_var("ccn-prefetch-time", optarg);
+                break;
+            case 's':
+                i_seeks = atoi(optarg);
+                break;
+            case 'f':
+                psz_file = optarg;
+                break;
+            case 'h':
+            default:
+                usage(progname);
+        }
+    }
+    if (argv[optind] == NULL)
+        usage(progname);
+    access.psz_location = argv[optind];
+    if (psz_file != NULL) {
+        p_file = fopen(psz_file, "r");
+        if (p_file == NULL) {
+            perror(psz_file);
+            exit(1);
+        }
+    }
+
+    if (CCNOpen((vlc_object_t *)p_access) != VLC_SUCCESS) {
+        fprintf(stderr, "%s: open failed for %s\n", progname, access.psz_location);
+        exit(1);
+    }
+
+    /* the sequential read, as vlc would do it for playback */
+    i_start = mdate();
+    while (!access.info.b_eof) {
+        i_before = mdate();
+        p_block = access.pf_block(p_access);
+        i_delta = mdate() - i_before;
+        if (i_delta > i_max)
+            i_max = i_delta;
+        if (i_delta > 100000)
+            i_stalls++;
+        if (p_block == NULL)
+            continue;
+        if (p_file != NULL) {
+            p_check = realloc(p_check, p_block->i_buffer);
+            if (fread(p_check, 1, p_block->i_buffer, p_file) != p_block->i_buffer ||
+                memcmp(p_check, p_block->p_buffer, p_block->i_buffer) != 0)
+                i_bad++;
+        }
+        i_bytes += p_block->i_buffer;
+        i_blocks++;
+        block_Release(p_block);
+    }
+    i_delta = mdate() - i_start;
+    i_size = access.info.i_size;
+    printf("read %"PRId64" bytes in %d blocks, %.3f s, %.3f MB/s, "
+           "max block wait %.3f s, %d stalls > 0.1 s, %d mismatched\n",
+           i_bytes, i_blocks, i_delta / 1.0e6,
+           (i_delta > 0) ? i_bytes / (double)i_delta : 0.0,
+           i_max / 1.0e6, i_stalls, i_bad);
+
+    /* the seeks, as vlc would do them for interleaved audio and video */
+    i_max = 0;
+    i_stalls = 0;
+    i_bad = 0;
+    srandom(i_size);
+    i_start = mdate();
+    for (i = 0; i < i_seeks && i_size > 0; i++) {
+        uint64_t i_pos = ((uint64_t)random() << 16 ^ random()) % i_size;
+        i_before = mdate();
+        access.pf_seek(p_access, i_pos);
+        do {
+            p_block = access.pf_block(p_access);
+        } while (p_block == NULL && !access.info.b_eof);
+        i_delta = mdate() - i_before;
+        if (i_delta > i_max)
+            i_max = i_delta;
+        if (i_delta > 100000)
+            i_stalls++;
+        if (p_block == NULL)
+            continue;
+        if (p_file != NULL) {
+            p_check = realloc(p_check, p_block->i_buffer);
+            if (fseeko(p_file, i_pos, SEEK_SET) != 0 ||
+                fread(p_check, 1, p_block->i_buffer, p_file) != p_block->i_buffer ||
+                memcmp(p_check, p_block->p_buffer, p_block->i_buffer) != 0)
+                i_bad++;
+        }
+        block_Release(p_block);
+    }
+    i_delta = mdate() - i_start;
+    printf("%d seeks, %.3f s, max seek wait %.3f s, %d stalls > 0.1 s, %d mismatched\n",
+           i_seeks, i_delta / 1.0e6, i_max / 1.0e6, i_stalls, i_bad);
+    printf("%d blocks from prefetch, %d fetched directly, %d interests reexpressed\n",
+           access.p_sys->i_ring_hits, access.p_sys->i_missed_co,
+           access.p_sys->i_reexpressed);
+
+    CCNClose((vlc_object_t *)p_access);
+    if (p_file != NULL)
+        fclose(p_file);
+    free(p_check);
+    exit(0);
+}
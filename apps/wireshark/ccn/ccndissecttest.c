@@ -0,0 +1,427 @@
+/**
+ * @file apps/wireshark/ccn/ccndissecttest.c
+ *
+ * Standalone test driver for the core of the CCNx wireshark dissector.
+ *
+ * Runs the framing, parsing, and name formatting code of packet-ccn.c
+ * over a pcap capture (UDP datagrams, and TCP streams reassembled as
+ * wireshark would) or over a raw ccnb stream cut into segments,
+ * and reports the message rate.  Does not need wireshark or libpcap.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#define CCN_DISSECT_CORE_ONLY 1
+#include "packet-ccn.c"
+
+#define PCAP_MAGIC 0xa1b2c3d4
+#define PCAP_MAGIC_SWAPPED 0xd4c3b2a1
+#define DLT_NULL 0
+#define DLT_EN10MB 1
+#define DLT_RAW 12
+#define DLT_RAW_OPENBSD 101
+#define DLT_LOOP 108
+#define DLT_LINUX_SLL 113
+
+#define MAX_FLOWS 64
+
+/**
+ * A TCP flow, for reassembly.  Flows are identified by their 4-tuple;
+ * the table is small, and the oldest flow is recycled when it fills.
+ */
+struct flow {
+    unsigned char key[36];  /* addresses and ports */
+    int keylen;
+    unsigned long lastuse;
+    struct ccn_charbuf *pending;
+};
+
+struct stats {
+    unsigned long packets;
+    unsigned long messages;
+    unsigned long interests;
+    unsigned long contentobjects;
+    unsigned long bad;
+    unsigned long reassembled;
+    unsigned long long bytes;
+    unsigned long components;
+};
+
+static struct flow flows[MAX_FLOWS];
+static unsigned long flowclock = 0;
+static int do_tree = 0;
+static int verbose = 0;
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-h] [-t] [-v] [-r repeat] [-s segsize] [-c] file\n"
+            " Runs the core of the ccn dissector over a capture and reports its speed.\n"
+            " file is a pcap capture, or with -c a raw ccnb stream.\n"
+            " -c treat file as a raw ccnb stream, cut into segments as TCP would\n"
+            " -s segment size for -c (default 1448)\n"
+            " -r process the file this many times (default 1)\n"
+            " -t also format the name components, as for the protocol tree\n"
+            " -v print each message name\n",
+            progname);
+    exit(1);
+}
+
+static unsigned char *
+read_file(const char *filename, size_t *sizep)
+{
+    FILE *fp;
+    unsigned char *buf = NULL;
+    size_t size = 0;
+    size_t cap = 0;
+    size_t n;
+
+    fp = fopen(filename, "rb");
+    if (fp == NULL) {
+        perror(filename);
+        exit(1);
+    }
+    do {
+        if (size == cap) {
+            cap = cap ? 2 * cap : 1 << 20;
+            buf = realloc(buf, cap);
+            if (buf == NULL) {
+                perror("realloc");
+                exit(1);
+            }
+        }
+        n = fread(buf + size, 1, cap - size, fp);
+        size += n;
+    } while (n > 0);
+    fclose(fp);
+    *sizep = size;
+    return (buf);
+}
+
+static void
+note_message(struct stats *st, const unsigned char *p, size_t size,
+             int packet_type, int packet_type_length)
+{
+    struct ccn_msg_info msg_info;
+    struct ccn_msg_info *mi = &msg_info;
+    const unsigned char *comp;
+    size_t comp_size;
+    int i;
+
+    st->messages++;
+    st->bytes += size;
+    mi->packet_type = packet_type;
+    mi->packet_type_length = packet_type_length;
+    if (packet_type == CCN_DTAG_CCNProtocolDataUnit)
+        return;
+    if (ccn_msg_parse(p, size, mi) < 0) {
+        st->bad++;
+        return;
+    }
+    if (packet_type == CCN_DTAG_Interest)
+        st->interests++;
+    else
+        st->contentobjects++;
+    if (do_tree) {
+        for (i = 0; i + 1 < mi->comps->n; i++) {
+            ccn_name_comp_get(p, mi->comps, i, &comp, &comp_size);
+            if (ccn_component_string(comp, comp_size)[0] != 0)
+                st->components++;
+        }
+    }
+    if (verbose)
+        printf("%s %s\n", packet_type == CCN_DTAG_Interest ? "I" : "C", mi->uri);
+}
+
+/**
+ * Dissect the messages in one datagram, or in the reassembled stream
+ * of a flow.
+ * @returns the number of bytes consumed; any remainder is an incomplete
+ *          message (if stream is nonzero), or garbage.
+ */
+static size_t
+dissect_buffer(struct stats *st, const unsigned char *p, size_t n, int stream)
+{
+    size_t offset = 0;
+    ssize_t msg_size;
+    int packet_type = 0;
+    int packet_type_length = 0;
+
+    while (offset < n) {
+        msg_size = ccn_frame_message(p + offset, n - offset,
+                                     &packet_type, &packet_type_length);
+        if (msg_size == 0 && stream)
+            break;
+        if (msg_size <= 0) {
+            st->bad++;
+            return (n);
+        }
+        note_message(st, p + offset, msg_size, packet_type, packet_type_length);
+        offset += msg_size;
+    }
+    return (offset);
+}
+
+/**
+ * Hand a TCP segment to its flow, doing the reassembly that wireshark
+ * does for us when we set desegment_len.
+ */
+static void
+dissect_segment(struct stats *st, const unsigned char *key, int keylen,
+                const unsigned char *p, size_t n)
+{
+    struct flow *f = NULL;
+    struct flow *oldest = &flows[0];
+    size_t used;
+    int i;
+
+    for (i = 0; i < MAX_FLOWS; i++) {
+        if (flows[i].keylen == keylen && memcmp(flows[i].key, key, keylen) == 0) {
+            f = &flows[i];
+            break;
+        }
+        if (flows[i].lastuse < oldest->lastuse)
+            oldest = &flows[i];
+    }
+    if (f == NULL) {
+        f = oldest;
+        memcpy(f->key, key, keylen);
+        f->keylen = keylen;
+        if (f->pending == NULL)
+            f->pending = ccn_charbuf_create();
+        f->pending->length = 0;
+    }
+    f->lastuse = ++flowclock;
+    if (f->pending->length == 0) {
+        /* the common case - no copy unless a message is split */
+        used = dissect_buffer(st, p, n, 1);
+        if (used < n)
+            ccn_charbuf_append(f->pending, p + used, n - used);
+        return;
+    }
+    st->reassembled++;
+    ccn_charbuf_append(f->pending, p, n);
+    used = dissect_buffer(st, f->pending->buf, f->pending->length, 1);
+    if (used > 0) {
+        memmove(f->pending->buf, f->pending->buf + used, f->pending->length - used);
+        f->pending->length -= used;
+    }
+}
+
+static unsigned
+get16(const unsigned char *p)
+{
+    return ((p[0] << 8) | p[1]);
+}
+
+/**
+ * Strip the link, network, and transport headers from one captured frame.
+ */
+static void
+dissect_frame(struct stats *st, int linktype, const unsigned char *p, size_t n)
+{
+    unsigned char key[36];
+    size_t hlen;
+    int proto;
+    int keylen;
+
+    st->packets++;
+    switch (linktype) {
+        case DLT_NULL:
+        case DLT_LOOP:
+            hlen = 4;
+            break;
+        case DLT_EN10MB:
+            hlen = 14;
+            if (n >= 18 && get16(p + 12) == 0x8100)
+                hlen = 18;
+            break;
+        case DLT_LINUX_SLL:
+            hlen = 16;
+            break;
+        default:
+            hlen = 0;
+    }
+    if (n < hlen + 20)
+        return;
+    p += hlen;
+    n -= hlen;
+    if ((p[0] >> 4) == 4) {
+        hlen = (p[0] & 0xF) * 4;
+        if (get16(p + 2) < n)
+            n = get16(p + 2);
+        proto = p[9];
+        memcpy(key, p + 12, 8);
+        keylen = 8;
+    }
+    else if ((p[0] >> 4) == 6 && n >= 40) {
+        hlen = 40;
+        proto = p[6];
+        memcpy(key, p + 8, 32);
+        keylen = 32;
+    }
+    else
+        return;
+    if (n < hlen)
+        return;
+    p += hlen;
+    n -= hlen;
+    if (proto == 17 && n >= 8) {
+        dissect_buffer(st, p + 8, n - 8, 0);
+    }
+    else if (proto == 6 && n >= 20) {
+        hlen = (p[12] >> 4) * 4;
+        if (n <= hlen)
+            return;
+        memcpy(key + keylen, p, 4);
+        dissect_segment(st, key, keylen + 4, p + hlen, n - hlen);
+    }
+}
+
+static uint32_t
+get32(const unsigned char *p, int swapped)
+{
+    if (swapped)
+        return (p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24));
+    return (((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+static void
+dissect_pcap(struct stats *st, const unsigned char *buf, size_t size)
+{
+    size_t offset = 24;
+    uint32_t magic;
+    uint32_t caplen;
+    int swapped;
+    int linktype;
+
+    if (size < 24)
+        goto Bad;
+    magic = get32(buf, 0);
+    if (magic == PCAP_MAGIC_SWAPPED)
+        swapped = 1;
+    else if (magic == PCAP_MAGIC)
+        swapped = 0;
+    else
+        goto Bad;
+    linktype = get32(buf + 20, swapped);
+    if (linktype != DLT_NULL && linktype != DLT_EN10MB && linktype != DLT_RAW &&
+        linktype != DLT_RAW_OPENBSD && linktype != DLT_LOOP &&
+        linktype != DLT_LINUX_SLL) {
+        fprintf(stderr, "unsupported link type %d\n", linktype);
+        exit(1);
+    }
+    while (offset + 16 <= size) {
+        caplen = get32(buf + offset + 8, swapped);
+        offset += 16;
+        if (caplen > size - offset)
+            break;
+        dissect_frame(st, linktype, buf + offset, caplen);
+        offset += caplen;
+    }
+    return;
+Bad:
+    fprintf(stderr, "not a pcap file\n");
+    exit(1);
+}
+
+static void
+dissect_stream(struct stats *st, const unsigned char *buf, size_t size,
+               size_t segsize)
+{
+    static const unsigned char key[4] = {0};
+    size_t offset;
+    size_t n;
+
+    for (offset = 0; offset < size; offset += n) {
+        n = size - offset;
+        if (n > segsize)
+            n = segsize;
+        st->packets++;
+        dissect_segment(st, key, sizeof(key), buf + offset, n);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    struct stats st = {0};
+    struct timeval t0, t1;
+    unsigned char *buf;
+    size_t size;
+    size_t segsize = 1448;
+    int raw = 0;
+    int repeat = 1;
+    int i;
+    int opt;
+    double elapsed;
+
+    while ((opt = getopt(argc, argv, "hctvr:s:")) != -1) {
+        switch (opt) {
+            case 'c':
+                raw = 1;
+                break;
+            case 't':
+                do_tree = 1;
+                break;
+            case 'v':
+                verbose = 1;
+                break;
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 's':
+                segsize = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(progname);
+        }
+    }
+    if (argv[optind] == NULL || repeat <= 0 || segsize == 0)
+        usage(progname);
+    buf = read_file(argv[optind], &size);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < repeat; i++) {
+        if (raw)
+            dissect_stream(&st, buf, size, segsize);
+        else
+            dissect_pcap(&st, buf, size);
+    }
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    if (elapsed <= 0)
+        elapsed = 1e-6;
+    printf("%lu packets, %lu messages (%lu interests, %lu content objects, %lu bad), "
+           "%llu bytes, %lu reassembled\n",
+           st.packets, st.messages, st.interests, st.contentobjects, st.bad,
+           st.bytes, st.reassembled);
+    printf("%.3f s, %.0f packets/s, %.0f messages/s, %.1f MB/s\n",
+           elapsed, st.packets / elapsed, st.messages / elapsed,
+           st.bytes / elapsed / 1.0e6);
+    printf("name cache: %lu hits, %lu misses\n",
+           ccn_name_cache_hits, ccn_name_cache_misses);
+    free(buf);
+    exit(0);
+}
@@ -42,8 +42,10 @@
 # include "config.h"
 #endif
 
+#ifndef CCN_DISSECT_CORE_ONLY
 #include <epan/packet.h>
 #include <epan/prefs.h>
+#endif
 
 #include <stdlib.h>
 #include <string.h>
@@ -53,13 +55,169 @@
 #include <ccn/uri.h>
 
 #define CCN_MIN_PACKET_SIZE 5
+#define CCN_NAME_CACHE_SIZE 4096
+
+/*
+ * The core of the dissector: message framing, parsing, and name formatting.
+ * This part does not depend on wireshark, so that it may be exercised
+ * by a standalone test driver (see ccndissecttest.c).
+ */
+
+/**
+ * The result of parsing one ccnb message.
+ * The comps indexbuf and the uri string are owned by the core, and are
+ * only valid until the next message is parsed.
+ */
+struct ccn_msg_info {
+    int packet_type;            /**< CCN_DTAG_Interest, CCN_DTAG_ContentObject */
+    int packet_type_length;     /**< length of the initial tag */
+    struct ccn_parsed_interest pi;
+    struct ccn_parsed_ContentObject pco;
+    struct ccn_indexbuf *comps;
+    const char *uri;            /**< the Name, formatted as a ccnx: URI */
+};
+
+/**
+ * Direct-mapped cache of formatted names, keyed by the ccnb Name element.
+ * Busy captures repeat the same names many times over (an interest, the
+ * matching content, retransmissions), so this saves most of the formatting.
+ */
+struct ccn_name_cache_entry {
+    unsigned hash;
+    struct ccn_charbuf *name;   /**< ccnb-encoded Name */
+    struct ccn_charbuf *uri;    /**< formatted URI */
+};
+static struct ccn_name_cache_entry ccn_name_cache[CCN_NAME_CACHE_SIZE];
+static unsigned long ccn_name_cache_hits = 0;
+static unsigned long ccn_name_cache_misses = 0;
+static struct ccn_indexbuf *ccn_scratch_comps = NULL;
+static struct ccn_charbuf *ccn_scratch_charbuf = NULL;
+
+/**
+ * Find the extent of the ccnb message at the start of a buffer.
+ *
+ * A single pass of the skeleton decoder, pausing only after the first
+ * token to learn the message type.
+ * @returns the length of the message, 0 if the buffer ends before the
+ *          message does, or -1 if the buffer does not start with ccnb.
+ */
+static ssize_t
+ccn_frame_message(const unsigned char *p, size_t n,
+                  int *packet_type, int *packet_type_length)
+{
+    struct ccn_skeleton_decoder skel_decoder = {0};
+    struct ccn_skeleton_decoder *sd = &skel_decoder;
+    
+    if (n == 0 || p[0] == 0)
+        return (-1);
+    sd->state |= CCN_DSTATE_PAUSE;
+    ccn_skeleton_decode(sd, p, n);
+    if (sd->state < 0 || CCN_GET_TT_FROM_DSTATE(sd->state) != CCN_DTAG)
+        return (-1);
+    *packet_type = sd->numval;
+    *packet_type_length = sd->index;
+    sd->state &= ~CCN_DSTATE_PAUSE;
+    ccn_skeleton_decode(sd, p + sd->index, n - sd->index);
+    if (sd->state < 0)
+        return (-1);
+    if (!CCN_FINAL_DSTATE(sd->state) || sd->nest != 0)
+        return (0);
+    return (sd->index);
+}
+
+/**
+ * Format a ccnb Name element as a URI, consulting the cache first.
+ */
+static const char *
+ccn_name_uri(const unsigned char *name, size_t size)
+{
+    struct ccn_name_cache_entry *e;
+    unsigned hash = 2166136261U; /* FNV-1a */
+    size_t i;
+    
+    for (i = 0; i < size; i++)
+        hash = (hash ^ name[i]) * 16777619U;
+    e = &ccn_name_cache[hash % CCN_NAME_CACHE_SIZE];
+    if (e->name != NULL && e->hash == hash && e->name->length == size &&
+        memcmp(e->name->buf, name, size) == 0) {
+        ccn_name_cache_hits++;
+        return (ccn_charbuf_as_string(e->uri));
+    }
+    ccn_name_cache_misses++;
+    if (e->name == NULL) {
+        e->name = ccn_charbuf_create();
+        e->uri = ccn_charbuf_create();
+    }
+    e->hash = hash;
+    ccn_charbuf_reset(e->name);
+    ccn_charbuf_append(e->name, name, size);
+    ccn_charbuf_reset(e->uri);
+    if (ccn_uri_append(e->uri, name, size, 1) < 0) {
+        /* don't keep a bad entry */
+        e->name->length = 0;
+        ccn_charbuf_append_string(e->uri, "ccnx:?");
+    }
+    return (ccn_charbuf_as_string(e->uri));
+}
+
+/**
+ * Parse one framed message, filling in mi.
+ * @returns 0 for success, -1 if the message is not an Interest or
+ *          ContentObject, or does not parse.
+ */
+static int
+ccn_msg_parse(const unsigned char *ccnb, size_t size, struct ccn_msg_info *mi)
+{
+    size_t b, e;
+    int res;
+    
+    if (ccn_scratch_comps == NULL)
+        ccn_scratch_comps = ccn_indexbuf_create();
+    mi->comps = ccn_scratch_comps;
+    mi->uri = NULL;
+    switch (mi->packet_type) {
+        case CCN_DTAG_Interest:
+            res = ccn_parse_interest(ccnb, size, &mi->pi, mi->comps);
+            b = mi->pi.offset[CCN_PI_B_Name];
+            e = mi->pi.offset[CCN_PI_E_Name];
+            break;
+        case CCN_DTAG_ContentObject:
+            res = ccn_parse_ContentObject(ccnb, size, &mi->pco, mi->comps);
+            b = mi->pco.offset[CCN_PCO_B_Name];
+            e = mi->pco.offset[CCN_PCO_E_Name];
+            break;
+        default:
+            return (-1);
+    }
+    if (res < 0)
+        return (-1);
+    mi->uri = ccn_name_uri(ccnb + b, e - b);
+    return (0);
+}
+
+/**
+ * Format one name component, for the tree view.
+ * The result is only valid until the next call.
+ */
+static const char *
+ccn_component_string(const unsigned char *comp, size_t size)
+{
+    if (ccn_scratch_charbuf == NULL)
+        ccn_scratch_charbuf = ccn_charbuf_create();
+    ccn_charbuf_reset(ccn_scratch_charbuf);
+    ccn_uri_append_percentescaped(ccn_scratch_charbuf, comp, size);
+    return (ccn_charbuf_as_string(ccn_scratch_charbuf));
+}
+
+#ifndef CCN_DISSECT_CORE_ONLY
 
 /* forward reference */
 void proto_register_ccn();
 void proto_reg_handoff_ccn();
 static int dissect_ccn(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
-static int dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
-static int dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
+static int dissect_ccn_message(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
+static int dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
+static int dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
 static gboolean dissect_ccn_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree);
 
 static int proto_ccn = -1;
@@ -243,95 +401,104 @@ proto_reg_handoff_ccn(void)
  *	The amount of data in the protocol's PDU, if it was able to
  *	dissect all the data;
  *
- *	0, if the tvbuff doesn't contain a PDU for that protocol;
+ *	0, if the tvbuff doesn't contain a PDU for that protocol.
  *
- *	The negative of the amount of additional data needed, if
- *	we need more data (e.g., from subsequent TCP segments) to
- *	dissect the entire PDU.
+ * A TCP segment may hold several ccnb messages, and may end in the middle
+ * of one; in that case we ask TCP to reassemble, starting with the
+ * incomplete message, and dissect it when the rest has arrived.
  */
 static int
 dissect_ccn(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 {
     guint tvb_size = 0;
-    proto_tree *ccn_tree;
-    proto_item *ti = NULL;
+    guint offset = 0;
     const unsigned char *ccnb;
-    struct ccn_skeleton_decoder skel_decoder;
-    struct ccn_skeleton_decoder *sd;
-    struct ccn_charbuf *c;
-    int packet_type = 0;
-    int packet_type_length = 0;
+    struct ccn_msg_info msg_info;
+    struct ccn_msg_info *mi = &msg_info;
+    ssize_t msg_size;
+    int n_msgs = 0;
+    
     /* a couple of basic checks to rule out packets that are definitely not ours */
     tvb_size = tvb_length(tvb);
     if (tvb_size < CCN_MIN_PACKET_SIZE || tvb_get_guint8(tvb, 0) == 0)
         return (0);
+    /* no copy, unless the tvb is not contiguous already */
+    ccnb = tvb_get_ptr(tvb, 0, tvb_size);
     
-    sd = &skel_decoder;
-    memset(sd, 0, sizeof(*sd));
-    sd->state |= CCN_DSTATE_PAUSE;
-    ccnb = ep_tvb_memdup(tvb, 0, tvb_size);
-    ccn_skeleton_decode(sd, ccnb, tvb_size);
-    if (sd->state < 0)
-        return (0);
-    if (CCN_GET_TT_FROM_DSTATE(sd->state) == CCN_DTAG) {
-        packet_type = sd->numval;
-        packet_type_length = sd->index;
-    } else {
-        return (0);
-    }
-    memset(sd, 0, sizeof(*sd));
-    ccn_skeleton_decode(sd, ccnb, tvb_size);
-    if (!CCN_FINAL_DSTATE(sd->state)) {
-        pinfo->desegment_offset = 0;
-        pinfo->desegment_len = DESEGMENT_ONE_MORE_SEGMENT;
-        return (-1); /* what should this be? */
-    }
-    
-    /* Make it visible that we're taking this packet */
-    if (check_col(pinfo->cinfo, COL_PROTOCOL)) {
-        col_set_str(pinfo->cinfo, COL_PROTOCOL, "CCN");
-    }
-    
-    /* Clear out stuff in the info column */
-    if (check_col(pinfo->cinfo, COL_INFO)) {
-        col_clear(pinfo->cinfo, COL_INFO);
+    while (offset < tvb_size) {
+        msg_size = ccn_frame_message(ccnb + offset, tvb_size - offset,
+                                     &mi->packet_type, &mi->packet_type_length);
+        if (msg_size < 0)
+            break;
+        if (msg_size == 0) {
+            if (mi->packet_type != CCN_DTAG_Interest &&
+                mi->packet_type != CCN_DTAG_ContentObject &&
+                mi->packet_type != CCN_DTAG_CCNProtocolDataUnit)
+                break;
+            if (!pinfo->can_desegment)
+                break;
+            /* the rest of this message is in later segments */
+            pinfo->desegment_offset = offset;
+            pinfo->desegment_len = DESEGMENT_ONE_MORE_SEGMENT;
+            return (tvb_size);
+        }
+        if (n_msgs == 0) {
+            /* Make it visible that we're taking this packet */
+            col_set_str(pinfo->cinfo, COL_PROTOCOL, "CCN");
+            col_clear(pinfo->cinfo, COL_INFO);
+        }
+        if (dissect_ccn_message(ccnb + offset, msg_size, mi,
+                                tvb_new_subset(tvb, offset, msg_size, msg_size),
+                                pinfo, tree) < 0 && n_msgs == 0)
+            return (0);
+        n_msgs++;
+        offset += msg_size;
     }
+    return (offset);
+}
+
+/*
+ * Dissects one complete ccnb message.  The tvb starts with the message.
+ */
+static int
+dissect_ccn_message(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+{
+    proto_tree *ccn_tree;
+    proto_item *ti = NULL;
+    const char *type_str;
+    int res;
     
-    c = ccn_charbuf_create();
-    ccn_uri_append(c, ccnb, tvb_size, 1);
+    res = ccn_msg_parse(ccnb, ccnb_size, mi);
+    type_str = val_to_str(mi->packet_type, VALS(ccn_dtag_dict.dict), "Unknown (0x%02x");
     
     /* Add the packet type and CCN URI to the info column */
-    if (check_col(pinfo->cinfo, COL_INFO)) {
-        col_add_str(pinfo->cinfo, COL_INFO,
-                    val_to_str(packet_type, VALS(ccn_dtag_dict.dict), "Unknown (0x%02x"));
-        col_append_sep_str(pinfo->cinfo, COL_INFO, NULL, ccn_charbuf_as_string(c));
-    }
+    col_append_sep_str(pinfo->cinfo, COL_INFO, "; ", type_str);
+    if (mi->uri != NULL)
+        col_append_sep_str(pinfo->cinfo, COL_INFO, NULL, mi->uri);
     
-    if (tree == NULL) {
-        ccn_charbuf_destroy(&c);
-        return (sd->index);
-    }
+    if (tree == NULL && mi->packet_type != CCN_DTAG_Interest)
+        return (res);
     
-    ti = proto_tree_add_protocol_format(tree, proto_ccn, tvb, 0, -1,
-                                        "Content-centric Networking Protocol, %s, %s",
-                                        val_to_str(packet_type, VALS(ccn_dtag_dict.dict), "Unknown (0x%02x"),
-                                        ccn_charbuf_as_string(c));
-    ccn_tree = proto_item_add_subtree(ti, ett_ccn);
-    ccn_charbuf_destroy(&c);
-    ti = proto_tree_add_uint(ccn_tree, hf_ccn_type, tvb, 0, packet_type_length, packet_type);
+    if (tree != NULL) {
+        ti = proto_tree_add_protocol_format(tree, proto_ccn, tvb, 0, ccnb_size,
+                                            "Content-centric Networking Protocol, %s, %s",
+                                            type_str,
+                                            mi->uri != NULL ? mi->uri : "");
+        ccn_tree = proto_item_add_subtree(ti, ett_ccn);
+        ti = proto_tree_add_uint(ccn_tree, hf_ccn_type, tvb, 0, mi->packet_type_length, mi->packet_type);
+    }
+    else
+        ccn_tree = NULL;
+    if (res < 0)
+        return (res);
     
-    switch (packet_type) {
+    switch (mi->packet_type) {
         case CCN_DTAG_ContentObject:
-            if (0 > dissect_ccn_contentobject(ccnb, sd->index, tvb, pinfo, ccn_tree))
-                return (0);
-            break;
+            return (dissect_ccn_contentobject(ccnb, ccnb_size, mi, tvb, pinfo, ccn_tree));
         case CCN_DTAG_Interest:
-            if (0 > dissect_ccn_interest(ccnb, sd->index, tvb, pinfo, ccn_tree))
-                return (0);
-            break;
+            return (dissect_ccn_interest(ccnb, ccnb_size, mi, tvb, pinfo, ccn_tree));
     }
-    
-    return (sd->index);
+    return (0);
 }
 
 static gboolean
@@ -350,13 +517,12 @@ dissect_ccn_heur(tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 }
 
 static int
-dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 {
     proto_tree *name_tree;
     proto_tree *exclude_tree;
     proto_item *titem;
-    struct ccn_parsed_interest interest;
-    struct ccn_parsed_interest *pi = &interest;
+    struct ccn_parsed_interest *pi = &mi->pi;
     struct ccn_buf_decoder decoder;
     struct ccn_buf_decoder *d;
     const unsigned char *bloom;
@@ -372,27 +538,36 @@ dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb,
     double lifetime;
     int res;
     
-    comps = ccn_indexbuf_create();
-    res = ccn_parse_interest(ccnb, ccnb_size, pi, comps);
-    if (res < 0)
-        return (res);
+    comps = mi->comps;
+    
+    /* Nonce, which also goes in the info column */
+    l = pi->offset[CCN_PI_E_Nonce] - pi->offset[CCN_PI_B_Nonce];
+    if (l > 0) {
+        i = ccn_ref_tagged_BLOB(CCN_DTAG_Nonce, ccnb,
+                                pi->offset[CCN_PI_B_Nonce],
+                                pi->offset[CCN_PI_E_Nonce],
+                                &blob, &blob_size);
+        if (check_col(pinfo->cinfo, COL_INFO)) {
+            col_append_str(pinfo->cinfo, COL_INFO, ", <");
+            for (i = 0; i < blob_size; i++)
+                col_append_fstr(pinfo->cinfo, COL_INFO, "%02x", blob[i]);
+            col_append_str(pinfo->cinfo, COL_INFO, ">");
+        }
+    }
+    if (tree == NULL)
+        return (1);
     
     /* Name */
     l = pi->offset[CCN_PI_E_Name] - pi->offset[CCN_PI_B_Name];
-    c = ccn_charbuf_create();
-    ccn_uri_append(c, ccnb, ccnb_size, 1);
     titem = proto_tree_add_string(tree, hf_ccn_name, tvb,
                                   pi->offset[CCN_PI_B_Name], l,
-                                  ccn_charbuf_as_string(c));
+                                  mi->uri);
     name_tree = proto_item_add_subtree(titem, ett_name);
     
     for (i = 0; i < comps->n - 1; i++) {
-        ccn_charbuf_reset(c);
         res = ccn_name_comp_get(ccnb, comps, i, &comp, &comp_size);
-        ccn_uri_append_percentescaped(c, comp, comp_size);
-        titem = proto_tree_add_string(name_tree, hf_ccn_name_components, tvb, comp - ccnb, comp_size, ccn_charbuf_as_string(c));
+        titem = proto_tree_add_string(name_tree, hf_ccn_name_components, tvb, comp - ccnb, comp_size, ccn_component_string(comp, comp_size));
     }
-    ccn_charbuf_destroy(&c);
     
     /* MinSuffixComponents */
     l = pi->offset[CCN_PI_E_MinSuffixComponents] - pi->offset[CCN_PI_B_MinSuffixComponents];
@@ -504,12 +679,6 @@ dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb,
                                 pi->offset[CCN_PI_B_Nonce],
                                 pi->offset[CCN_PI_E_Nonce],
                                 &blob, &blob_size);
-        if (check_col(pinfo->cinfo, COL_INFO)) {
-            col_append_str(pinfo->cinfo, COL_INFO, ", <");
-            for (i = 0; i < blob_size; i++)
-                col_append_fstr(pinfo->cinfo, COL_INFO, "%02x", blob[i]);
-            col_append_str(pinfo->cinfo, COL_INFO, ">");
-        }
         titem = proto_tree_add_item(tree, hf_ccn_nonce, tvb,
                                     blob - ccnb, blob_size, FALSE);
     }
@@ -519,16 +688,14 @@ dissect_ccn_interest(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb,
 }
 
 static int
-dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
+dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, struct ccn_msg_info *mi, tvbuff_t *tvb, packet_info *pinfo, proto_tree *tree)
 {
     proto_tree *signature_tree;
     proto_tree *name_tree;
     proto_tree *signedinfo_tree;
     proto_tree *content_tree;
     proto_item *titem;
-    struct ccn_parsed_ContentObject co;
-    struct ccn_parsed_ContentObject *pco = &co;
-    struct ccn_charbuf *c;
+    struct ccn_parsed_ContentObject *pco = &mi->pco;
     struct ccn_indexbuf *comps;
     const unsigned char *comp;
     size_t comp_size;
@@ -540,9 +707,7 @@ dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t
     nstime_t timestamp;
     int res;
     
-    comps = ccn_indexbuf_create();
-    res = ccn_parse_ContentObject(ccnb, ccnb_size, pco, comps);
-    if (res < 0) return (-1);
+    comps = mi->comps;
     
     /* Signature */
     l = pco->offset[CCN_PCO_E_Signature] - pco->offset[CCN_PCO_B_Signature];
@@ -580,21 +745,16 @@ dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t
     
     /* Name */
     l = pco->offset[CCN_PCO_E_Name] - pco->offset[CCN_PCO_B_Name];
-    c = ccn_charbuf_create();
-    ccn_uri_append(c, ccnb, ccnb_size, 1);
     titem = proto_tree_add_string(tree, hf_ccn_name, tvb,
                                   pco->offset[CCN_PCO_B_Name], l,
-                                  ccn_charbuf_as_string(c));
+                                  mi->uri);
     name_tree = proto_item_add_subtree(titem, ett_name);
     
     /* Name Components */
     for (i = 0; i < comps->n - 1; i++) {
-        ccn_charbuf_reset(c);
         res = ccn_name_comp_get(ccnb, comps, i, &comp, &comp_size);
-        ccn_uri_append_percentescaped(c, comp, comp_size);
-        titem = proto_tree_add_string(name_tree, hf_ccn_name_components, tvb, comp - ccnb, comp_size, ccn_charbuf_as_string(c));
+        titem = proto_tree_add_string(name_tree, hf_ccn_name_components, tvb, comp - ccnb, comp_size, ccn_component_string(comp, comp_size));
     }
-    ccn_charbuf_destroy(&c);
 
     /* /Name */
     
@@ -695,3 +855,4 @@ dissect_ccn_contentobject(const unsigned char *ccnb, size_t ccnb_size, tvbuff_t
     
     return (ccnb_size);
 }
+#endif /* CCN_DISSECT_CORE_ONLY */
@@ -23,6 +23,7 @@ LOCAL_C_INCLUDES	+= $(LOCAL_PATH)/../include
 LOCAL_C_INCLUDES	+= $(LOCAL_PATH)/../../android/external/openssl-armv5/include
 
 CCNDOBJ := ccnd.o ccnd_msg.o ccnd_internal_client.o ccnd_stats.o \
+			ccnd_admission.o ccnd_expiry.o \
 			android_main.o
 CCNDSRC := $(CCNDOBJ:.o=.c)
 
@@ -68,6 +68,7 @@ enum ccn_strategy_op {
     CCNST_TIMER,    /* wakeup used by strategy */
     CCNST_SATISFIED, /* matching content has arrived, pit entry will go away */
     CCNST_TIMEOUT,  /* all downstreams timed out, pit entry will go away */
+    CCNST_NACKED,   /* an upstream has refused the interest */
 };
 
 static void cleanup_at_exit(void);
@@ -92,6 +93,8 @@ static void content_skiplist_insert(struct ccnd_handle *h,
                                     struct content_entry *content);
 static void content_skiplist_remove(struct ccnd_handle *h,
                                     struct content_entry *content);
+static struct content_entry *content_from_accession(struct ccnd_handle *h,
+                                                    ccn_accession_t accession);
 static void mark_stale(struct ccnd_handle *h,
                        struct content_entry *content);
 static ccn_accession_t content_skiplist_next(struct ccnd_handle *h,
@@ -149,6 +152,7 @@ pfi_seek(struct ccnd_handle *h, struct interest_entry *ie,
 static void strategy_callout(struct ccnd_handle *h,
                              struct interest_entry *ie,
                              enum ccn_strategy_op op);
+static unsigned long long expiry_now(struct ccnd_handle *h);
 
 /**
  * Frequency of wrapped timer
@@ -342,6 +346,33 @@ use_i:
     return (face->faceid);
 }
 
+/**
+ * Choose the listen-before-send pause for a multicast face.
+ *
+ * Until any responses have been seen on the segment, this is
+ * h->data_pause_microsec.  After that it follows the observed response
+ * times, so that a quiet LAN is not held back by a fixed pause, and a
+ * busy one gets a wider window for hearing another node answer first.
+ *
+ * Units are microseconds.
+ */
+unsigned
+ccnd_mcast_pause(struct ccnd_handle *h, struct face *face)
+{
+    unsigned lo = h->data_pause_microsec / 64;
+    unsigned hi = h->data_pause_microsec * 4;
+    unsigned micros;
+    
+    if (face->mcast_srtt == 0)
+        return(h->data_pause_microsec);
+    micros = face->mcast_srtt / 4 + face->mcast_rttvar;
+    if (micros < lo)
+        micros = lo;
+    if (micros > hi)
+        micros = hi;
+    return(micros < 1 ? 1 : micros);
+}
+
 /**
  * Decide how much to delay the content sent out on a face.
  *
@@ -357,7 +388,7 @@ choose_face_delay(struct ccnd_handle *h, struct face *face, enum cq_delay_class
         return(1);
     if ((face->flags & CCN_FACE_MCAST) != 0) {
         shift = (c == CCN_CQ_SLOW) ? 2 : 0;
-        micros = (h->data_pause_microsec) << shift;
+        micros = ccnd_mcast_pause(h, face) << shift;
         return(micros); /* multicast, delay more */
     }
     return(1);
@@ -388,6 +419,57 @@ content_queue_create(struct ccnd_handle *h, struct face *face, enum cq_delay_cla
     return(q);
 }
 
+/**
+ * Note how long a multicast segment took to answer an interest.
+ *
+ * The sample runs from when the interest was first sent or overheard on
+ * the face until the first copy of the content was heard there.  The
+ * smoothing is the same as for TCP round trip times, and the delays of
+ * the face's content queues are adjusted to match.
+ */
+static void
+mcast_note_response(struct ccnd_handle *h, struct face *face, unsigned usec)
+{
+    enum cq_delay_class c;
+    struct content_queue *q;
+    unsigned err;
+    
+    if (face->mcast_srtt == 0) {
+        face->mcast_srtt = usec > 0 ? usec : 1;
+        face->mcast_rttvar = usec / 2;
+    }
+    else {
+        err = (usec > face->mcast_srtt) ? usec - face->mcast_srtt :
+                                          face->mcast_srtt - usec;
+        face->mcast_rttvar += ((int)err - (int)face->mcast_rttvar) / 4;
+        face->mcast_srtt += ((int)usec - (int)face->mcast_srtt) / 8;
+        if (face->mcast_srtt == 0)
+            face->mcast_srtt = 1;
+    }
+    for (c = CCN_CQ_ASAP + 1; c < CCN_CQ_N; c++) {
+        q = face->q[c];
+        if (q != NULL) {
+            q->min_usec = choose_face_delay(h, face, c);
+            q->rand_usec = 2 * q->min_usec;
+        }
+    }
+    if (h->debug & 8)
+        ccnd_msg(h, "face %u mcast response %u usec, srtt %u rttvar %u",
+                 face->faceid, usec, face->mcast_srtt, face->mcast_rttvar);
+}
+
+/**
+ * Record that an interest has been sent or heard on a multicast face.
+ */
+static void
+mcast_note_interest(struct ccnd_handle *h, struct interest_entry *ie)
+{
+    if ((ie->flags & CCND_IE_MCAST) == 0) {
+        ie->mcast_usec = (unsigned)expiry_now(h);
+        ie->flags |= CCND_IE_MCAST;
+    }
+}
+
 /**
  * Destroy a queue.
  */
@@ -395,8 +477,15 @@ static void
 content_queue_destroy(struct ccnd_handle *h, struct content_queue **pq)
 {
     struct content_queue *q;
+    struct content_entry *content;
+    int i;
     if (*pq != NULL) {
         q = *pq;
+        for (i = 0; i < q->send_queue->n; i++) {
+            content = content_from_accession(h, q->send_queue->buf[i]);
+            if (content != NULL)
+                content->queued--;
+        }
         ccn_indexbuf_destroy(&q->send_queue);
         if (q->sender != NULL) {
             ccn_schedule_cancel(h->sched, q->sender);
@@ -633,6 +722,7 @@ finalize_face(struct hashtb_enumerator *e)
             ccnd_forget_face_guid(h, face);
         ccn_charbuf_destroy(&face->guid_cob);
         h->faces_by_faceid[i] = NULL;
+        ccnd_stats_face_closed(h, face->faceid);
         if ((face->flags & CCN_FACE_UNDECIDED) != 0 &&
               face->faceid == ((h->face_rover - 1) | h->face_gen)) {
             /* stream connection with no ccn traffic - safe to reuse */
@@ -905,7 +995,8 @@ content_skiplist_remove(struct ccnd_handle *h, struct content_entry *content)
     size_t start;
     size_t end;
     struct ccn_indexbuf *pred[CCN_SKIPLIST_MAX_DEPTH] = {NULL};
-    if (content->skiplinks == NULL) abort();
+    if (content->skiplinks == NULL)
+        return; /* never cached, see pass_content() */
     start = content->comps[0];
     end = content->comps[content->ncomps - 1];
     d = content_skiplist_findbefore(h,
@@ -981,6 +1072,84 @@ find_first_match_candidate(struct ccnd_handle *h,
     return(content_from_accession(h, pred[0]->buf[0]));
 }
 
+/**
+ * Find the upper limit given by an Exclude that ends with
+ * <Component/><Any/>, as a Name with that component appended.
+ *
+ * Content at or beyond the limit cannot match, so the scan of the
+ * candidates may stop there instead of running to the end of the prefix.
+ * @returns a new charbuf, or NULL if there is no such limit.
+ */
+static struct ccn_charbuf *
+exclude_upper_limit(const unsigned char *interest_msg,
+                    const struct ccn_parsed_interest *pi)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+    struct ccn_charbuf *namebuf = NULL;
+    size_t start = pi->offset[CCN_PI_B_Name];
+    size_t end = pi->offset[CCN_PI_E_Name];
+    size_t compstart = 0;
+    size_t compend = 0;
+    int last = 0; /* 1 after Component, 2 after Any following Component */
+
+    if (pi->offset[CCN_PI_B_Exclude] == pi->offset[CCN_PI_E_Exclude])
+        return(NULL);
+    d = ccn_buf_decoder_start(&decoder,
+                              interest_msg + pi->offset[CCN_PI_B_Exclude],
+                              pi->offset[CCN_PI_E_Exclude] -
+                              pi->offset[CCN_PI_B_Exclude]);
+    ccn_buf_advance(d);
+    while (d->decoder.state >= 0) {
+        if (ccn_buf_match_dtag(d, CCN_DTAG_Component)) {
+            compstart = d->decoder.token_index;
+            ccn_buf_advance_past_element(d);
+            compend = d->decoder.token_index;
+            last = 1;
+        }
+        else if (ccn_buf_match_dtag(d, CCN_DTAG_Any)) {
+            ccn_buf_advance(d);
+            ccn_buf_check_close(d);
+            last = (last == 1) ? 2 : 0;
+        }
+        else if (ccn_buf_match_dtag(d, CCN_DTAG_Bloom)) {
+            ccn_buf_advance_past_element(d);
+            last = 0;
+        }
+        else
+            break;
+    }
+    ccn_buf_check_close(d);
+    if (d->decoder.state < 0 || last != 2)
+        return(NULL);
+    compstart += pi->offset[CCN_PI_B_Exclude];
+    compend += pi->offset[CCN_PI_B_Exclude];
+    namebuf = ccn_charbuf_create();
+    ccn_charbuf_append(namebuf, interest_msg + start, end - start);
+    namebuf->length--;
+    ccn_charbuf_append(namebuf, interest_msg + compstart, compend - compstart);
+    ccn_charbuf_append_closer(namebuf);
+    return(namebuf);
+}
+
+/**
+ * Check whether content sorts at or beyond the limit
+ * from exclude_upper_limit().
+ */
+static int
+content_beyond_limit(struct content_entry *content,
+                     const struct ccn_charbuf *limit)
+{
+    size_t start;
+    size_t end;
+    if (limit == NULL)
+        return(0);
+    start = content->comps[0];
+    end = content->comps[content->ncomps - 1];
+    return(ccn_compare_names(content->key + start - 1, end - start + 2,
+                             limit->buf, limit->length) >= 0);
+}
+
 /**
  * Check for a prefix match.
  */
@@ -1604,6 +1773,7 @@ content_sender(struct ccn_schedule *sched,
         if (content == NULL)
             q->nrun = 0;
         else {
+            content->queued--;
             send_content(h, face, content);
             /* face may have vanished, bail out if it did */
             if (face_from_faceid(h, faceid) == NULL)
@@ -1663,6 +1833,7 @@ face_send_queue_insert(struct ccnd_handle *h,
 {
     int ans;
     int delay;
+    size_t n;
     enum cq_delay_class c;
     enum cq_delay_class k;
     struct content_queue *q;
@@ -1686,7 +1857,10 @@ face_send_queue_insert(struct ccnd_handle *h,
             }
         }
     }
+    n = q->send_queue->n;
     ans = ccn_indexbuf_set_insert(q->send_queue, content->accession);
+    if (q->send_queue->n > n)
+        content->queued++;
     if (q->sender == NULL) {
         delay = randomize_content_delay(h, q);
         q->ready = q->send_queue->n;
@@ -1729,7 +1903,8 @@ consume_matching_interests(struct ccnd_handle *h,
                            struct nameprefix_entry *npe,
                            struct content_entry *content,
                            struct ccn_parsed_ContentObject *pc,
-                           struct face *face)
+                           struct face *face,
+                           struct face *from_face)
 {
     int matches = 0;
     struct ielinks *head;
@@ -1757,6 +1932,10 @@ consume_matching_interests(struct ccnd_handle *h,
                     face_send_queue_insert(h, face_from_faceid(h, x->faceid),
                                            content);
             }
+            if (from_face != NULL && (p->flags & CCND_IE_MCAST) != 0 &&
+                (from_face->flags & CCN_FACE_MCAST) != 0)
+                mcast_note_response(h, from_face,
+                                    (unsigned)expiry_now(h) - p->mcast_usec);
             matches += 1;
             strategy_callout(h, p, CCNST_SATISFIED);
             consume_interest(h, p);
@@ -1865,7 +2044,8 @@ match_interests(struct ccnd_handle *h, struct content_entry *content,
         if (from_face != NULL && (npe->flags & CCN_FORW_LOCAL) != 0 &&
             (from_face->flags & CCN_FACE_GG) == 0)
             return(-1);
-        new_matches = consume_matching_interests(h, npe, content, pc, face);
+        new_matches = consume_matching_interests(h, npe, content, pc,
+                                                 face, from_face);
         if (from_face != NULL && (new_matches != 0 || ci + 1 == cm))
             note_content_from(h, npe, from_face->faceid, ci);
         if (new_matches != 0) {
@@ -3329,6 +3509,8 @@ ie_next_usec(struct ccnd_handle *h, struct interest_entry *ie,
         if (delta < mn)
             mn = delta;
     }
+    if (ie->pfl == NULL)
+        mn = horizon; /* nothing left to wait for */
     if (mn < horizon)
         mn = 0;
     else
@@ -3385,10 +3567,103 @@ send_interest(struct ccnd_handle *h, struct interest_entry *ie,
     p->pfi_flags |= CCND_PFI_UPENDING;
     p->pfi_flags &= ~(CCND_PFI_SENDUPST | CCND_PFI_UPHUNGRY);
     ccnd_meter_bump(h, face->meter[FM_INTO], 1);
+    if ((face->flags & CCN_FACE_MCAST) != 0)
+        mcast_note_interest(h, ie);
     stuff_and_send(h, face, ie->interest_msg, ie->size - 1, c->buf, c->length, (h->debug & 2) ? "interest_to" : NULL, __LINE__);
     return(p);
 }
 
+/**
+ * Send an InterestNack
+ *
+ * If nonce is NULL, msg is the refused Interest as it arrived.
+ * Otherwise msg is the interest_msg of a PIT entry (size bytes, ending
+ * with a spare byte for the closer), and the given nonce is put back in.
+ */
+static void
+send_nack(struct ccnd_handle *h, struct face *face, int reason,
+          const unsigned char *msg, size_t size,
+          const unsigned char *nonce, size_t noncesize)
+{
+    struct ccn_charbuf *c = charbuf_obtain(h);
+    struct ccn_charbuf *nack = charbuf_obtain(h);
+    
+    if (nonce != NULL) {
+        ccn_charbuf_append(c, msg, size - 1);
+        ccnb_append_tagged_blob(c, CCN_DTAG_Nonce, nonce, noncesize);
+        ccn_charbuf_append_closer(c);
+    }
+    else
+        ccn_charbuf_append(c, msg, size);
+    if (h->debug & 2)
+        ccnd_debug_ccnb(h, __LINE__, "nack_to", face, c->buf, c->length);
+    if (ccn_encode_InterestNack(nack, reason, c->buf, c->length) == 0) {
+        h->nacks_sent += 1;
+        stuff_and_send(h, face, nack->buf, nack->length, NULL, 0, NULL, 0);
+    }
+    charbuf_release(h, nack);
+    charbuf_release(h, c);
+}
+
+/**
+ * Refuse an interest that has just arrived, if it asked to be told.
+ */
+static void
+nack_interest(struct ccnd_handle *h, struct face *face,
+              const unsigned char *msg, struct ccn_parsed_interest *pi,
+              int reason)
+{
+    if ((pi->answerfrom & CCN_AOK_NACK) != 0)
+        send_nack(h, face, reason, msg, pi->offset[CCN_PI_E], NULL, 0);
+}
+
+/**
+ * Give up on a pit entry, telling the pending downstreams why.
+ *
+ * All of the face items are removed, so the next run of do_propagate
+ * retires the entry.
+ */
+static void
+refuse_interest(struct ccnd_handle *h, struct interest_entry *ie, int reason)
+{
+    struct pit_face_item *p = NULL;
+    struct pit_face_item *next = NULL;
+    struct face *face = NULL;
+    
+    for (p = ie->pfl; p != NULL; p = next) {
+        next = p->next;
+        if ((p->pfi_flags & CCND_PFI_PENDING) != 0) {
+            face = face_from_faceid(h, p->faceid);
+            if (face != NULL)
+                send_nack(h, face, reason, ie->interest_msg, ie->size,
+                          p->nonce, p->pfi_flags & CCND_PFI_NONCESZ);
+        }
+        pfi_destroy(h, ie, p);
+    }
+}
+
+/**
+ * True iff the entry has upstreams, and all of them are backed up.
+ */
+static int
+upstreams_congested(struct ccnd_handle *h, struct interest_entry *ie)
+{
+    struct pit_face_item *p = NULL;
+    struct face *face = NULL;
+    int n = 0;
+    
+    for (p = ie->pfl; p != NULL; p = p->next) {
+        if ((p->pfi_flags & CCND_PFI_UPSTREAM) == 0)
+            continue;
+        face = face_from_faceid(h, p->faceid);
+        if (face == NULL || face->outbuf == NULL ||
+            face->outbuf->length - face->outbufindex <= CCND_CONGESTED_BACKLOG)
+            return(0);
+        n++;
+    }
+    return(n > 0);
+}
+
 /**
  * Find the entry for the longest name prefix that contains forwarding info
  */
@@ -3482,6 +3757,11 @@ strategy_callout(struct ccnd_handle *h,
                                 ie->interest_msg, ie->size);
                 break;
             }
+            if ((ie->flags & CCND_IE_NACK) != 0 &&
+                upstreams_congested(h, ie)) {
+                refuse_interest(h, ie, CCN_NACK_CONGESTION);
+                break;
+            }
             if (best == CCN_NOFACEID || npe->usec > 150000) {
                 usefirst = 1;
                 randlow = 4000;
@@ -3538,9 +3818,50 @@ strategy_callout(struct ccnd_handle *h,
             break;
         case CCNST_TIMEOUT:
             break;
+        case CCNST_NACKED:
+            /*
+             * An upstream has refused the interest.  Hurry along any
+             * that have not been tried; if there are none left at all,
+             * pass the refusal downstream.
+             */
+            nleft = 0;
+            for (p = ie->pfl; p != NULL; p = p->next) {
+                if ((p->pfi_flags & CCND_PFI_UPSTREAM) != 0) {
+                    nleft++;
+                    if ((p->pfi_flags & CCND_PFI_UPENDING) == 0)
+                        pfi_set_expiry_from_micros(h, ie, p, 0);
+                }
+            }
+            if (nleft == 0 && (ie->flags & CCND_IE_NACK) != 0)
+                refuse_interest(h, ie, ie->strategy.nack);
+            break;
     }
 }
 
+/**
+ * Look for a copy of the interest heard on the same multicast face.
+ *
+ * @returns the pending downstream entry for upstream p's face, if
+ *          that is a multicast face, or NULL.
+ */
+static struct pit_face_item *
+mcast_overheard(struct interest_entry *ie, struct pit_face_item *p,
+                ccn_wrappedtime now)
+{
+    struct pit_face_item *x;
+    
+    if ((p->pfi_flags & CCND_PFI_MCWAIT) == 0)
+        return(NULL);
+    for (x = ie->pfl; x != NULL; x = x->next) {
+        if (x->faceid == p->faceid &&
+            (x->pfi_flags & CCND_PFI_DNSTREAM) != 0 &&
+            (x->pfi_flags & CCND_PFI_PENDING) != 0 &&
+            wt_compare(now + 1, x->expiry) < 0)
+            return(x);
+    }
+    return(NULL);
+}
+
 /**
  * Execute the next timed action on a propagating interest.
  */
@@ -3555,6 +3876,7 @@ do_propagate(struct ccn_schedule *sched,
     struct face *face = NULL;
     struct pit_face_item *p = NULL;
     struct pit_face_item *next = NULL;
+    struct pit_face_item *x = NULL;
     struct pit_face_item *d[3] = { NULL, NULL, NULL };
     ccn_wrappedtime now;
     int next_delay;
@@ -3620,6 +3942,13 @@ do_propagate(struct ccn_schedule *sched,
             p->expiry += (60 * WTHZ + 999) / 1000;
             p->pfi_flags |= CCND_PFI_DCFACE;
         }
+        if ((face->flags & CCN_FACE_MCAST) != 0 &&
+            (p->pfi_flags & (CCND_PFI_UPENDING | CCND_PFI_MCWAIT)) == 0) {
+            /* Listen a while before the first send, as for content */
+            p->expiry += nrand48(h->seed) %
+                         ((ccnd_mcast_pause(h, face) * WTHZ + 999999) / 1000000 + 1);
+            p->pfi_flags |= CCND_PFI_MCWAIT;
+        }
         if (wt_compare(now + 1, p->expiry) < 0) {
             /* Not expired yet */
             rem = p->expiry - now;
@@ -3628,6 +3957,23 @@ do_propagate(struct ccn_schedule *sched,
             upstreams++;
             continue;
         }
+        x = mcast_overheard(ie, p, now);
+        if (x != NULL) {
+            /* Somebody else's copy is out there; treat ours as sent */
+            p->pfi_flags |= CCND_PFI_UPENDING;
+            p->pfi_flags &= ~(CCND_PFI_SENDUPST | CCND_PFI_UPHUNGRY);
+            p->renewed = now;
+            p->expiry = x->expiry;
+            h->interests_suppressed += 1;
+            if (h->debug & 2)
+                ccnd_debug_ccnb(h, __LINE__, "interest_overheard", face,
+                                ie->interest_msg, ie->size);
+            upstreams++;
+            rem = p->expiry - now;
+            if (rem < mn)
+                mn = rem;
+            continue;
+        }
         for (i = 0; i < n; i++)
             if (d[i]->faceid != p->faceid)
                 break;
@@ -3920,6 +4266,22 @@ pfi_unique_nonce(struct ccnd_handle *h, struct interest_entry *ie,
     return(1);
 }
 
+/**
+ * Make sure that do_propagate runs when the next action on ie is due.
+ */
+static void
+ie_schedule(struct ccnd_handle *h, struct interest_entry *ie)
+{
+    ccn_wrappedtime expiry;
+    int usec;
+    
+    usec = ie_next_usec(h, ie, &expiry);
+    if (ie->ev != NULL && wt_compare(expiry + 2, ie->ev->evint) < 0)
+        ccn_schedule_cancel(h->sched, ie->ev);
+    if (ie->ev == NULL)
+        ie->ev = ccn_schedule_event(h->sched, usec, do_propagate, ie, expiry);
+}
+
 /**
  * Schedules the propagation of an Interest message.
  */
@@ -3937,15 +4299,29 @@ propagate_interest(struct ccnd_handle *h,
     struct ccn_indexbuf *outbound = NULL;
     const unsigned char *nonce;
     intmax_t lifetime;
-    ccn_wrappedtime expiry;
     unsigned char cb[TYPICAL_NONCE_SIZE];
     size_t noncesize;
     unsigned faceid;
     int i;
     int res;
-    int usec;
     
     faceid = face->faceid;
+    outbound = get_outbound_faces(h, face, msg, pi, npe);
+    if (outbound == NULL)
+        return(-1);
+    if (outbound->n == 0 && (pi->answerfrom & CCN_AOK_NACK) != 0) {
+        /* Refuse now, unless an earlier copy is still being forwarded */
+        ie = hashtb_lookup(h->interest_tab, msg,
+                           pi->offset[CCN_PI_B_InterestLifetime]);
+        for (p = (ie == NULL) ? NULL : ie->pfl; p != NULL; p = p->next)
+            if ((p->pfi_flags & CCND_PFI_UPSTREAM) != 0)
+                break;
+        if (p == NULL) {
+            nack_interest(h, face, msg, pi, CCN_NACK_NO_ROUTE);
+            ccn_indexbuf_destroy(&outbound);
+            return(-1);
+        }
+    }
     hashtb_start(h->interest_tab, e);
     res = hashtb_seek(e, msg, pi->offset[CCN_PI_B_InterestLifetime], 1);
     if (res < 0) goto Bail;
@@ -3966,10 +4342,10 @@ propagate_interest(struct ccnd_handle *h,
         ((unsigned char *)(intptr_t)ie->interest_msg)[ie->size - 1] = 0;
         xres = ccn_parse_interest(ie->interest_msg, ie->size, &xpi, NULL);
         if (xres < 0) abort();
+        if ((xpi.answerfrom & CCN_AOK_NACK) != 0)
+            ie->flags |= CCND_IE_NACK;
     }
     lifetime = ccn_interest_lifetime(msg, pi);
-    outbound = get_outbound_faces(h, face, msg, pi, npe);
-    if (outbound == NULL) goto Bail;
     nonce = msg + pi->offset[CCN_PI_B_Nonce];
     noncesize = pi->offset[CCN_PI_E_Nonce] - pi->offset[CCN_PI_B_Nonce];
     if (noncesize != 0)
@@ -3995,8 +4371,11 @@ propagate_interest(struct ccnd_handle *h,
     else {
         /* Nonce has been seen before; do not forward. */
         p->pfi_flags |= CCND_PFI_SUPDATA;
+        nack_interest(h, face, msg, pi, CCN_NACK_DUPLICATE);
     }
     pfi_set_expiry_from_lifetime(h, ie, p, lifetime);
+    if ((face->flags & CCN_FACE_MCAST) != 0)
+        mcast_note_interest(h, ie);
     for (i = 0; i < outbound->n; i++) {
         p = pfi_seek(h, ie, outbound->buf[i], CCND_PFI_UPSTREAM);
         if (wt_compare(p->expiry, h->wtnow) < 0) {
@@ -4006,11 +4385,7 @@ propagate_interest(struct ccnd_handle *h,
     }
     if (res == HT_NEW_ENTRY)
         strategy_callout(h, ie, CCNST_FIRST);
-    usec = ie_next_usec(h, ie, &expiry);
-    if (ie->ev != NULL && wt_compare(expiry + 2, ie->ev->evint) < 0)
-        ccn_schedule_cancel(h->sched, ie->ev);
-    if (ie->ev == NULL)
-        ie->ev = ccn_schedule_event(h->sched, usec, do_propagate, ie, expiry);
+    ie_schedule(h, ie);
 Bail:
     hashtb_end(e);
     ccn_indexbuf_destroy(&outbound);
@@ -4217,6 +4592,7 @@ process_incoming_interest(struct ccnd_handle *h, struct face *face,
     struct nameprefix_entry *npe = NULL;
     struct content_entry *content = NULL;
     struct content_entry *last_match = NULL;
+    struct ccn_charbuf *limit = NULL;
     struct ccn_indexbuf *comps = indexbuf_obtain(h);
     if (size > 65535)
         res = -__LINE__;
@@ -4253,8 +4629,10 @@ process_incoming_interest(struct ccnd_handle *h, struct face *face,
             indexbuf_release(h, comps);
             comps = NULL;
             npe = ie->ll.npe;
-            if (drop_nonlocal_interest(h, npe, face, msg, size))
+            if (drop_nonlocal_interest(h, npe, face, msg, size)) {
+                nack_interest(h, face, msg, pi, CCN_NACK_NO_ROUTE);
                 return;
+            }
             propagate_interest(h, face, msg, pi, npe);
             return;
         }
@@ -4274,18 +4652,25 @@ process_incoming_interest(struct ccnd_handle *h, struct face *face,
         hashtb_start(h->nameprefix_tab, e);
         res = nameprefix_seek(h, e, msg, comps, pi->prefix_comps);
         npe = e->data;
-        if (npe == NULL || drop_nonlocal_interest(h, npe, face, msg, size))
+        if (npe == NULL)
+            goto Bail;
+        if (drop_nonlocal_interest(h, npe, face, msg, size)) {
+            nack_interest(h, face, msg, pi, CCN_NACK_NO_ROUTE);
             goto Bail;
+        }
         if ((pi->answerfrom & CCN_AOK_CS) != 0) {
             last_match = NULL;
             content = find_first_match_candidate(h, msg, pi);
+            if (content != NULL)
+                limit = exclude_upper_limit(msg, pi);
             if (content != NULL && (h->debug & 8))
                 ccnd_debug_ccnb(h, __LINE__, "first_candidate", NULL,
                                 content->key,
                                 content->size);
             if (content != NULL &&
-                !content_matches_interest_prefix(h, content, msg, comps,
-                                                 pi->prefix_comps)) {
+                (!content_matches_interest_prefix(h, content, msg, comps,
+                                                  pi->prefix_comps) ||
+                 content_beyond_limit(content, limit))) {
                 if (h->debug & 8)
                     ccnd_debug_ccnb(h, __LINE__, "prefix_mismatch", NULL,
                                     msg, size);
@@ -4309,8 +4694,9 @@ process_incoming_interest(struct ccnd_handle *h, struct face *face,
                 content = content_from_accession(h, content_skiplist_next(h, content));
             check_next_prefix:
                 if (content != NULL &&
-                    !content_matches_interest_prefix(h, content, msg,
-                                                     comps, pi->prefix_comps)) {
+                    (!content_matches_interest_prefix(h, content, msg,
+                                                      comps, pi->prefix_comps) ||
+                     content_beyond_limit(content, limit))) {
                     if (h->debug & 8)
                         ccnd_debug_ccnb(h, __LINE__, "prefix_mismatch", NULL,
                                         content->key,
@@ -4318,6 +4704,7 @@ process_incoming_interest(struct ccnd_handle *h, struct face *face,
                     content = NULL;
                 }
             }
+            ccn_charbuf_destroy(&limit);
             if (last_match != NULL)
                 content = last_match;
             if (content != NULL) {
@@ -4369,37 +4756,68 @@ mark_stale(struct ccnd_handle *h, struct content_entry *content)
 }
 
 /**
- * Scheduled event that makes content stale when its FreshnessSeconds
- * has exported.
+ * How long to hold content that is not cached before checking whether
+ * it has made it through the send queues.
+ */
+static int
+transit_hold_usec(struct ccnd_handle *h)
+{
+    /* As for CCND_CAP=0, long enough to make it through the queues */
+    return(8 * h->data_pause_microsec + 10000);
+}
+
+/**
+ * Makes content stale when its FreshnessSeconds has expired.
  *
  * May actually remove the content if we are over quota.
+ * Content in transit is removed instead, once no face still
+ * has it queued to be sent.
  */
-static int
-expire_content(struct ccn_schedule *sched,
-               void *clienth,
-               struct ccn_scheduled_event *ev,
-               int flags)
+static void
+expire_content(void *data, ccn_accession_t accession)
 {
-    struct ccnd_handle *h = clienth;
-    ccn_accession_t accession = ev->evint;
+    struct ccnd_handle *h = data;
     struct content_entry *content = NULL;
     int res;
     unsigned n;
-    if ((flags & CCN_SCHEDULE_CANCEL) != 0)
-        return(0);
     content = content_from_accession(h, accession);
     if (content != NULL) {
+        if ((content->flags & CCN_CONTENT_ENTRY_TRANSIT) != 0) {
+            if (content->queued > 0)
+                ccnd_expiry_schedule(h->expiry, accession,
+                                     transit_hold_usec(h));
+            else
+                remove_content(h, content);
+            return;
+        }
         n = hashtb_n(h->content_tab);
         /* The fancy test here lets existing stale content go away, too. */
         if ((n - (n >> 3)) > h->capacity ||
             (n > h->capacity && h->min_stale > h->max_stale)) {
             res = remove_content(h, content);
             if (res == 0)
-                return(0);
+                return;
         }
         mark_stale(h, content);
     }
-    return(0);
+}
+
+/**
+ * Current time for content expiry, in microseconds since ccnd started.
+ */
+static unsigned long long
+expiry_now(struct ccnd_handle *h)
+{
+    return((unsigned long long)(h->sec - h->starttime) * 1000000U + h->usec);
+}
+
+/**
+ * Clock for the expiry wheel.
+ */
+static unsigned long long
+expiry_clock(void *data)
+{
+    return(expiry_now(data));
 }
 
 /**
@@ -4437,8 +4855,36 @@ set_content_timer(struct ccnd_handle *h, struct content_entry *content,
     }
     microseconds = seconds * 1000000;
 Finish:
-    ccn_schedule_event(h->sched, microseconds,
-                       &expire_content, NULL, content->accession);
+    ccnd_expiry_schedule(h->expiry, content->accession, microseconds);
+}
+
+/**
+ * Make newly arrived content available to answer interests.
+ */
+static void
+cache_content(struct ccnd_handle *h, struct content_entry *content,
+              struct ccn_parsed_ContentObject *pco)
+{
+    content_skiplist_insert(h, content);
+    set_content_timer(h, content, pco);
+    /* Mark public keys supplied at startup as precious. */
+    if (pco->type == CCN_CONTENT_KEY && content->accession <= (h->capacity + 7)/8)
+        content->flags |= CCN_CONTENT_ENTRY_PRECIOUS;
+}
+
+/**
+ * Hold newly arrived content only until it has been sent.
+ *
+ * It is kept out of the skiplist, so it never answers another interest,
+ * and it is removed rather than made stale when its time is up and no
+ * send queue still holds it.
+ */
+static void
+pass_content(struct ccnd_handle *h, struct content_entry *content)
+{
+    content->flags |= CCN_CONTENT_ENTRY_TRANSIT;
+    h->content_passed++;
+    ccnd_expiry_schedule(h->expiry, content->accession, transit_hold_usec(h));
 }
 
 /**
@@ -4454,7 +4900,8 @@ Finish:
  * Find the matching pending interests in the PIT and consume them,
  * queueing the ContentObject to be sent on the associated faces.
  * If no matches were found and the content object was new, discard remove it
- * from the store.
+ * from the store.  New content that did match is cached only if the
+ * admission policy lets it in; otherwise it just passes through.
  *
  * XXX - the change to staleness should also not happen if there was no
  * matching PIT entry.
@@ -4582,11 +5029,6 @@ process_incoming_content(struct ccnd_handle *h, struct face *face,
         content->key = e->key;
         for (i = 0; i < comps->n; i++)
             content->comps[i] = comps->buf[i];
-        content_skiplist_insert(h, content);
-        set_content_timer(h, content, &obj);
-        /* Mark public keys supplied at startup as precious. */
-        if (obj.type == CCN_CONTENT_KEY && content->accession <= (h->capacity + 7)/8)
-            content->flags |= CCN_CONTENT_ENTRY_PRECIOUS;
     }
     hashtb_end(e);
 Bail:
@@ -4607,6 +5049,11 @@ Bail:
                 content->flags |= CCN_CONTENT_ENTRY_SLOWSEND;
                 ccn_indexbuf_append_element(h->unsol, content->accession);
             }
+            /* Unsolicited content can only be used if we keep it */
+            if (n_matches == 0 || ccnd_admit_content(h, content, &obj))
+                cache_content(h, content, &obj);
+            else
+                pass_content(h, content);
         }
         // ZZZZ - review whether the following is actually needed
         for (c = 0; c < CCN_CQ_N; c++) {
@@ -4621,17 +5068,73 @@ Bail:
                     if (h->debug & 8)
                         ccnd_debug_ccnb(h, __LINE__, "content_nosend", face, msg, size);
                     q->send_queue->buf[i] = 0;
+                    content->queued--;
+                    /* On a multicast face, somebody else has sent it */
+                    if ((face->flags & CCN_FACE_MCAST) != 0)
+                        h->content_suppressed++;
                 }
             }
         }
     }
 }
 
+/**
+ * Process an incoming InterestNack.
+ *
+ * The refusal is only believed if it comes from a face that the
+ * interest was sent to, carrying the nonce that was sent there.
+ * That upstream is forgotten, and the strategy decides whether to
+ * wait for others or to pass the refusal on.
+ */
+static void
+process_incoming_nack(struct ccnd_handle *h, struct face *face,
+                      unsigned char *msg, size_t size)
+{
+    struct ccn_parsed_interest parsed_interest = {0};
+    struct ccn_parsed_interest *pi = &parsed_interest;
+    struct interest_entry *ie = NULL;
+    struct pit_face_item *p = NULL;
+    const unsigned char *interest = NULL;
+    const unsigned char *nonce = NULL;
+    size_t isize = 0;
+    size_t noncesize = 0;
+    int reason;
+    
+    reason = ccn_parse_InterestNack(msg, size, &interest, &isize);
+    if (reason < 0 || ccn_parse_interest(interest, isize, pi, NULL) < 0) {
+        ccnd_msg(h, "error parsing InterestNack - code %d", reason);
+        return;
+    }
+    h->nacks_received += 1;
+    if (h->debug & (16 | 8 | 2))
+        ccnd_debug_ccnb(h, __LINE__, "nack_from", face, interest, isize);
+    ie = hashtb_lookup(h->interest_tab, interest,
+                       pi->offset[CCN_PI_B_InterestLifetime]);
+    if (ie == NULL)
+        return;
+    ccn_ref_tagged_BLOB(CCN_DTAG_Nonce, interest,
+                        pi->offset[CCN_PI_B_Nonce],
+                        pi->offset[CCN_PI_E_Nonce],
+                        &nonce, &noncesize);
+    for (p = ie->pfl; p != NULL; p = p->next) {
+        if (p->faceid == face->faceid &&
+            (p->pfi_flags & CCND_PFI_UPENDING) != 0 &&
+            pfi_nonce_matches(p, nonce, noncesize))
+            break;
+    }
+    if (p == NULL)
+        return;
+    pfi_destroy(h, ie, p);
+    ie->strategy.nack = reason;
+    strategy_callout(h, ie, CCNST_NACKED);
+    ie_schedule(h, ie);
+}
+
 /**
  * Process an incoming message.
  *
  * This is where we decide whether we have an Interest message,
- * a ContentObject, or something else.
+ * a ContentObject, an InterestNack, or something else.
  */
 static void
 process_input_message(struct ccnd_handle *h, struct face *face,
@@ -4687,6 +5190,9 @@ process_input_message(struct ccnd_handle *h, struct face *face,
         case CCN_DTAG_ContentObject:
             process_incoming_content(h, face, msg, size);
             return;
+        case CCN_DTAG_InterestNack:
+            process_incoming_nack(h, face, msg, size);
+            return;
         case CCN_DTAG_SequenceNumber:
             process_incoming_link_message(h, face, dtag, msg, size);
             return;
@@ -4802,41 +5308,6 @@ get_dgram_source(struct ccnd_handle *h, struct face *face,
     return(source);
 }
 
-/**
- * Break up data in a face's input buffer buffer into individual messages,
- * and call process_input_message on each one.
- *
- * This is used to handle things originating from the internal client -
- * its output is input for face 0.
- */
-static void
-process_input_buffer(struct ccnd_handle *h, struct face *face)
-{
-    unsigned char *msg;
-    size_t size;
-    ssize_t dres;
-    struct ccn_skeleton_decoder *d;
-
-    if (face == NULL || face->inbuf == NULL)
-        return;
-    d = &face->decoder;
-    msg = face->inbuf->buf;
-    size = face->inbuf->length;
-    while (d->index < size) {
-        dres = ccn_skeleton_decode(d, msg + d->index, size - d->index);
-        if (d->state != 0)
-            break;
-        process_input_message(h, face, msg + d->index - dres, dres, 0);
-    }
-    if (d->index != size) {
-        ccnd_msg(h, "protocol error on face %u (state %d), discarding %d bytes",
-                     face->faceid, d->state, (int)(size - d->index));
-        // XXX - perhaps this should be a fatal error.
-    }
-    face->inbuf->length = 0;
-    memset(d, 0, sizeof(*d));
-}
-
 /**
  * Process the input from a socket.
  *
@@ -4949,23 +5420,113 @@ process_input(struct ccnd_handle *h, int fd)
     }
 }
 
+/**
+ * Queue a message from our internal client, taking ownership of it.
+ *
+ * It is processed by process_internal_client_buffer() once the internal
+ * client has returned.
+ */
+static void
+icq_append(struct ccnd_handle *h, struct ccn_charbuf *msg, int dtag)
+{
+    struct icq_item *icq = NULL;
+    unsigned limit;
+    
+    if (h->icq_n == h->icq_limit) {
+        limit = 2 * h->icq_limit + 8;
+        icq = realloc(h->icq, limit * sizeof(*icq));
+        if (icq == NULL) {
+            ccn_charbuf_destroy(&msg);
+            return;
+        }
+        h->icq = icq;
+        h->icq_limit = limit;
+    }
+    h->icq[h->icq_n].msg = msg;
+    h->icq[h->icq_n].dtag = dtag;
+    h->icq_n++;
+    ccnd_internal_client_has_somthing_to_say(h);
+}
+
+/**
+ * Accept a message from our internal client.
+ *
+ * This is installed as the output hook of the internal client's handle,
+ * so each message arrives here straight from ccn_put(), already checked
+ * for well-formedness.  The message belongs to the caller, so it has
+ * to be copied; replies that the internal client builds for itself come
+ * in through ccnd_internal_client_put() instead.
+ */
+void
+ccnd_internal_client_output(void *ccnd, const unsigned char *msg, size_t size)
+{
+    struct ccnd_handle *h = ccnd;
+    struct ccn_skeleton_decoder decoder = {0};
+    struct ccn_skeleton_decoder *d = &decoder;
+    struct ccn_charbuf *c = NULL;
+    int dtag = 0;
+    
+    d->state |= CCN_DSTATE_PAUSE;
+    ccn_skeleton_decode(d, msg, size);
+    if (CCN_GET_TT_FROM_DSTATE(d->state) == CCN_DTAG)
+        dtag = d->numval;
+    c = charbuf_obtain(h);
+    ccn_charbuf_append(c, msg, size);
+    icq_append(h, c, dtag);
+}
+
+/**
+ * Hand a signed ContentObject from our internal client to ccnd.
+ *
+ * This is used in place of ccn_put() for replies that the internal
+ * client has just signed.  The charbuf itself is queued, so the message
+ * is neither copied nor decoded again before it is processed.
+ * *pmsg is set to NULL.
+ */
+void
+ccnd_internal_client_put(struct ccnd_handle *h, struct ccn_charbuf **pmsg)
+{
+    struct ccn_charbuf *msg = *pmsg;
+    
+    *pmsg = NULL;
+    if (msg != NULL)
+        icq_append(h, msg, CCN_DTAG_ContentObject);
+}
+
 /**
  * Process messages from our internal client.
  *
- * The internal client's output is input to us.
+ * The internal client's output is input to us.  The messages were
+ * typed as they were queued, so they go directly to the interest or
+ * content processing without being decoded again here.
  */
 static void
 process_internal_client_buffer(struct ccnd_handle *h)
 {
     struct face *face = h->face0;
+    struct ccn_charbuf *msg = NULL;
+    unsigned i;
+    
     if (face == NULL)
         return;
-    face->inbuf = ccn_grab_buffered_output(h->internal_client);
-    if (face->inbuf == NULL)
-        return;
-    ccnd_meter_bump(h, face->meter[FM_BYTI], face->inbuf->length);
-    process_input_buffer(h, face);
-    ccn_charbuf_destroy(&(face->inbuf));
+    /* Processing may queue more, which is handled in this same pass */
+    for (i = 0; i < h->icq_n; i++) {
+        msg = h->icq[i].msg;
+        ccnd_meter_bump(h, face->meter[FM_BYTI], msg->length);
+        switch (h->icq[i].dtag) {
+            case CCN_DTAG_Interest:
+                process_incoming_interest(h, face, msg->buf, msg->length);
+                break;
+            case CCN_DTAG_ContentObject:
+                process_incoming_content(h, face, msg->buf, msg->length);
+                break;
+            default:
+                process_input_message(h, face, msg->buf, msg->length, 0);
+                break;
+        }
+        charbuf_release(h, msg);
+    }
+    h->icq_n = 0;
 }
 
 /**
@@ -4980,6 +5541,8 @@ process_icb_action(
 {
     struct ccnd_handle *h = clienth;
     
+    if (h->icq_event == ev)
+        h->icq_event = NULL;
     if ((flags & CCN_SCHEDULE_CANCEL) != 0)
         return(0);
     process_internal_client_buffer(h);
@@ -4991,11 +5554,13 @@ process_icb_action(
  *
  * This little dance keeps us from destroying an interest
  * entry while we are in the middle of processing it.
+ * One pending event covers everything queued before it runs.
  */
 void
 ccnd_internal_client_has_somthing_to_say(struct ccnd_handle *h)
 {
-    ccn_schedule_event(h->sched, 0, process_icb_action, NULL, 0);
+    if (h->icq_event == NULL)
+        h->icq_event = ccn_schedule_event(h->sched, 0, process_icb_action, NULL, 0);
 }
 
 /**
@@ -5087,7 +5652,6 @@ ccnd_send(struct ccnd_handle *h,
     if (face == h->face0) {
         ccnd_meter_bump(h, face->meter[FM_BYTO], size);
         ccn_dispatch_message(h->internal_client, (void *)data, size);
-        ccnd_internal_client_has_somthing_to_say(h);
         return;
     }
     if ((face->flags & CCN_FACE_DGRAM) == 0)
@@ -5653,8 +6217,14 @@ ccnd_create(const char *progname, ccnd_logger logger, void *loggerdata)
     const char *data_pause;
     const char *tts_default;
     const char *tts_limit;
+    const char *status_stale;
     const char *autoreg;
     const char *listen_on;
+    const char *cs_admit;
+    const char *cs_nocache;
+    const char *cs_maxsize;
+    struct ccn_charbuf *nocache = NULL;
+    long maxsize = 0;
     int fd;
     struct ccnd_handle *h;
     struct hashtb_param param = {0};
@@ -5695,6 +6265,7 @@ ccnd_create(const char *progname, ccnd_logger logger, void *loggerdata)
     h->ticktock.gettime = &ccnd_gettime;
     h->ticktock.data = h;
     h->sched = ccn_schedule_create(h, &h->ticktock);
+    h->expiry = ccnd_expiry_create(h->sched, &expiry_clock, &expire_content, h);
     h->starttime = h->sec;
     h->starttime_usec = h->usec;
     h->wtnow = 0xFFFF0000; /* provoke a rollover early on */
@@ -5758,6 +6329,33 @@ ccnd_create(const char *progname, ccnd_logger logger, void *loggerdata)
             h->tts_limit = (1U<<31) / 1000000;
         ccnd_msg(h, "CCND_MAX_TIME_TO_STALE=%d", h->tts_limit);
     }
+    h->status_stale_ms = 200;
+    status_stale = getenv("CCND_STATUS_STALE_MS");
+    if (status_stale != NULL && status_stale[0] != 0) {
+        h->status_stale_ms = atoi(status_stale);
+        if (h->status_stale_ms < 0)
+            h->status_stale_ms = 0;
+        if (h->status_stale_ms > 3600000)
+            h->status_stale_ms = 3600000;
+        ccnd_msg(h, "CCND_STATUS_STALE_MS=%d", h->status_stale_ms);
+    }
+    cs_admit = getenv("CCND_CS_ADMIT");
+    cs_nocache = getenv("CCND_CS_NOCACHE");
+    cs_maxsize = getenv("CCND_CS_MAXSIZE");
+    if (cs_nocache != NULL && cs_nocache[0] != 0) {
+        nocache = ccnd_parse_uri_list(h, "CCND_CS_NOCACHE", cs_nocache);
+        ccnd_msg(h, "CCND_CS_NOCACHE=%s", cs_nocache);
+    }
+    if (cs_maxsize != NULL && cs_maxsize[0] != 0) {
+        maxsize = atol(cs_maxsize);
+        if (maxsize < 0)
+            maxsize = 0;
+        ccnd_msg(h, "CCND_CS_MAXSIZE=%ld", maxsize);
+    }
+    h->admission = ccnd_admission_create(h, cs_admit, nocache, maxsize);
+    ccn_charbuf_destroy(&nocache);
+    if (cs_admit != NULL && cs_admit[0] != 0)
+        ccnd_msg(h, "CCND_CS_ADMIT=%s", ccnd_admission_policy(h->admission));
     listen_on = getenv("CCND_LISTEN_ON");
     autoreg = getenv("CCND_AUTOREG");
     
@@ -5823,6 +6421,8 @@ void
 ccnd_destroy(struct ccnd_handle **pccnd)
 {
     struct ccnd_handle *h = *pccnd;
+    unsigned i;
+    
     if (h == NULL)
         return;
     ccnd_shutdown_listeners(h);
@@ -5853,15 +6453,21 @@ ccnd_destroy(struct ccnd_handle **pccnd)
     ccn_charbuf_destroy(&h->send_interest_scratch);
     ccn_charbuf_destroy(&h->scratch_charbuf);
     ccn_charbuf_destroy(&h->autoreg);
+    ccnd_admission_destroy(&h->admission);
     ccn_indexbuf_destroy(&h->skiplinks);
     ccn_indexbuf_destroy(&h->scratch_indexbuf);
     ccn_indexbuf_destroy(&h->unsol);
+    for (i = 0; i < h->icq_n; i++)
+        ccn_charbuf_destroy(&h->icq[i].msg);
+    free(h->icq);
+    ccnd_expiry_destroy(&h->expiry);
     if (h->face0 != NULL) {
         ccn_charbuf_destroy(&h->face0->inbuf);
         ccn_charbuf_destroy(&h->face0->outbuf);
         free(h->face0);
         h->face0 = NULL;
     }
+    ccnd_stats_destroy(h);
     free(h);
     *pccnd = NULL;
 }
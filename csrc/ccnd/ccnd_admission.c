@@ -0,0 +1,282 @@
+/**
+ * @file ccnd_admission.c
+ *
+ * Content store admission control for ccnd.
+ *
+ * Every ContentObject that comes back for a pending interest is sent on,
+ * but it is only kept to answer later interests if the admission policy
+ * lets it in.  Content that is not admitted just passes through.  This
+ * keeps a one-shot bulk transfer from flushing the content that is asked
+ * for over and over, and saves indexing content that will never be asked
+ * for again.
+ *
+ * The policy is chosen by name, with an optional argument:
+ *  - all - admit everything (the default, and the old behavior)
+ *  - prob:P - admit a random P percent of the content
+ *  - second:N - admit content on the second request for its name,
+ *    counted with a frequency sketch of about N counters that forgets
+ *    old history by halving every counter now and then
+ *
+ * Ahead of the policy, names under the configured no-cache prefixes
+ * and objects over the size limit are never admitted, and keys always
+ * are.
+ *
+ * Part of ccnd - the CCNx Daemon.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+#include <ccn/uri.h>
+
+#include "ccnd_private.h"
+
+/** Rows in the frequency sketch */
+#define SKETCH_DEPTH 4
+/** Counters saturate at this value */
+#define SKETCH_MAX 15
+/** Default number of counters in each row */
+#define SKETCH_WIDTH_DEFAULT 16384
+
+struct ccnd_admission;
+
+typedef int (*admit_fn)(struct ccnd_handle *h, struct ccnd_admission *a,
+                        const unsigned char *name, size_t size);
+
+struct admission_policy {
+    const char *name;
+    admit_fn admit;
+};
+
+struct ccnd_admission {
+    const struct admission_policy *policy;
+    int percent;                    /**< for prob */
+    size_t maxsize;                 /**< largest ContentObject, 0 for any */
+    struct ccn_charbuf *nocache;    /**< Components of no-cache prefixes */
+    struct ccn_indexbuf *nocache_ends; /**< end of each prefix in nocache */
+    unsigned char *sketch;          /**< 4-bit counters, two to a byte */
+    unsigned width;                 /**< counters per row, a power of 2 */
+    unsigned long additions;        /**< since the counters were halved */
+};
+
+static int
+admit_all(struct ccnd_handle *h, struct ccnd_admission *a,
+          const unsigned char *name, size_t size)
+{
+    return(1);
+}
+
+static int
+admit_prob(struct ccnd_handle *h, struct ccnd_admission *a,
+           const unsigned char *name, size_t size)
+{
+    return((nrand48(h->seed) % 100) < a->percent);
+}
+
+/**
+ * Halve all of the sketch counters, so that old requests fade away.
+ */
+static void
+sketch_age(struct ccnd_admission *a)
+{
+    size_t n = (size_t)SKETCH_DEPTH * a->width / 2;
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        a->sketch[i] = (a->sketch[i] >> 1) & 0x77;
+    a->additions = 0;
+}
+
+/**
+ * Count a request for the name, and admit it if this is not the first.
+ *
+ * Only the smallest of the name's counters are bumped (a conservative
+ * update), which keeps the overestimates from collisions down.
+ */
+static int
+admit_second(struct ccnd_handle *h, struct ccnd_admission *a,
+             const unsigned char *name, size_t size)
+{
+    uint64_t hash = 14695981039346656037ULL;  /* FNV-1a */
+    unsigned idx[SKETCH_DEPTH];
+    unsigned v[SKETCH_DEPTH];
+    unsigned h1, h2;
+    unsigned mn = SKETCH_MAX;
+    size_t i;
+    int r;
+
+    for (i = 0; i < size; i++) {
+        hash ^= name[i];
+        hash *= 1099511628211ULL;
+    }
+    h1 = (unsigned)hash;
+    h2 = (unsigned)(hash >> 32) | 1;
+    for (r = 0; r < SKETCH_DEPTH; r++) {
+        idx[r] = r * a->width + ((h1 + r * h2) & (a->width - 1));
+        v[r] = (a->sketch[idx[r] >> 1] >> ((idx[r] & 1) * 4)) & 0xF;
+        if (v[r] < mn)
+            mn = v[r];
+    }
+    if (mn < SKETCH_MAX) {
+        for (r = 0; r < SKETCH_DEPTH; r++)
+            if (v[r] == mn)
+                a->sketch[idx[r] >> 1] += 1 << ((idx[r] & 1) * 4);
+    }
+    if (++(a->additions) >= 10UL * a->width)
+        sketch_age(a);
+    return(mn >= 1);
+}
+
+static const struct admission_policy policies[] = {
+    {"all", &admit_all},
+    {"prob", &admit_prob},
+    {"second", &admit_second},
+    {NULL, NULL}
+};
+
+/**
+ * Set up content store admission.
+ *
+ * @param spec is the policy, with its argument after a colon
+ *        (NULL for the default).
+ * @param nocache holds the no-cache prefixes as nul-terminated ccnx URIs,
+ *        or is NULL.
+ * @param maxsize is the largest ContentObject to admit, 0 for no limit.
+ * @returns the new state, or NULL if it cannot be allocated.
+ */
+struct ccnd_admission *
+ccnd_admission_create(struct ccnd_handle *h, const char *spec,
+                      struct ccn_charbuf *nocache, size_t maxsize)
+{
+    struct ccnd_admission *a;
+    struct ccn_charbuf *name = NULL;
+    const char *arg = NULL;
+    size_t len;
+    size_t i;
+    long n;
+
+    a = calloc(1, sizeof(*a));
+    if (a == NULL)
+        return(NULL);
+    a->policy = &policies[0];
+    a->maxsize = maxsize;
+    if (spec != NULL && spec[0] != 0) {
+        arg = strchr(spec, ':');
+        len = (arg == NULL) ? strlen(spec) : (size_t)(arg - spec);
+        for (i = 0; policies[i].name != NULL; i++) {
+            if (strlen(policies[i].name) == len &&
+                  memcmp(policies[i].name, spec, len) == 0)
+                break;
+        }
+        if (policies[i].name != NULL)
+            a->policy = &policies[i];
+        else
+            ccnd_msg(h, "CCND_CS_ADMIT: unknown policy %s, using all", spec);
+    }
+    n = (arg == NULL) ? -1 : atol(arg + 1);
+    if (a->policy->admit == &admit_prob) {
+        a->percent = (n < 0) ? 50 : (n > 100) ? 100 : n;
+    }
+    else if (a->policy->admit == &admit_second) {
+        for (a->width = 64; a->width < n && a->width < (1U << 24);)
+            a->width <<= 1;
+        if (n <= 0)
+            a->width = SKETCH_WIDTH_DEFAULT;
+        a->sketch = calloc(SKETCH_DEPTH * a->width / 2, 1);
+        if (a->sketch == NULL) {
+            free(a);
+            return(NULL);
+        }
+    }
+    if (nocache != NULL) {
+        a->nocache = ccn_charbuf_create();
+        a->nocache_ends = ccn_indexbuf_create();
+        name = ccn_charbuf_create();
+        for (i = 0; i < nocache->length; i += strlen((char *)nocache->buf + i) + 1) {
+            name->length = 0;
+            if (ccn_name_from_uri(name, (char *)nocache->buf + i) < 0)
+                continue;
+            /* Keep just the Components, without the Name element around them */
+            ccn_charbuf_append(a->nocache, name->buf + 1, name->length - 2);
+            ccn_indexbuf_append_element(a->nocache_ends, a->nocache->length);
+        }
+        ccn_charbuf_destroy(&name);
+    }
+    return(a);
+}
+
+void
+ccnd_admission_destroy(struct ccnd_admission **ap)
+{
+    struct ccnd_admission *a = *ap;
+
+    if (a == NULL)
+        return;
+    ccn_charbuf_destroy(&a->nocache);
+    ccn_indexbuf_destroy(&a->nocache_ends);
+    free(a->sketch);
+    free(a);
+    *ap = NULL;
+}
+
+/**
+ * @returns the name of the admission policy in effect.
+ */
+const char *
+ccnd_admission_policy(struct ccnd_admission *a)
+{
+    return(a == NULL ? "all" : a->policy->name);
+}
+
+/**
+ * Decide whether newly arrived content should go into the content store.
+ *
+ * @returns 1 to cache it, 0 to just pass it on.
+ */
+int
+ccnd_admit_content(struct ccnd_handle *h, struct content_entry *content,
+                   const struct ccn_parsed_ContentObject *pco)
+{
+    struct ccnd_admission *a = h->admission;
+    const unsigned char *name;
+    size_t namesize;
+    size_t start;
+    size_t i;
+
+    if (a == NULL)
+        return(1);
+    if (pco->type == CCN_CONTENT_KEY)
+        return(1);
+    if (a->maxsize != 0 && content->size > a->maxsize)
+        return(0);
+    /* The Components of the name, less the implicit digest */
+    name = content->key + content->comps[0];
+    namesize = content->comps[content->ncomps - 2] - content->comps[0];
+    if (a->nocache_ends != NULL) {
+        for (start = 0, i = 0; i < a->nocache_ends->n; i++) {
+            size_t end = a->nocache_ends->buf[i];
+            if (end - start <= namesize &&
+                  memcmp(a->nocache->buf + start, name, end - start) == 0)
+                return(0);
+            start = end;
+        }
+    }
+    return((a->policy->admit)(h, a, name, namesize));
+}
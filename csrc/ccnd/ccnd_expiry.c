@@ -0,0 +1,174 @@
+/**
+ * @file ccnd_expiry.c
+ *
+ * Batched content expiry for ccnd.
+ *
+ * Content that will go stale is not given a scheduled event of its own.
+ * Instead its accession is hashed, along with the time slot when it is due,
+ * into one of CCND_EXPIRY_SLOTS lists (a timing wheel), and a single
+ * scheduled event sweeps the lists as their slots come due.  Staleness is
+ * thus noticed up to one slot late, but never early.
+ *
+ * The wheel knows nothing else about ccnd; the clock and the action to
+ * take on expiry are supplied by the creator, so it may also be driven
+ * by a virtual clock (see schedbenchtest.c).
+ *
+ * Part of ccnd - the CCNx Daemon.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <stdlib.h>
+
+#include <ccn/indexbuf.h>
+#include <ccn/schedule.h>
+
+#include "ccnd_private.h"
+
+struct ccnd_expiry {
+    struct ccn_schedule *sched;
+    ccnd_expiry_clock now;          /**< microseconds, never going backwards */
+    ccnd_expiry_action expire;
+    void *data;                     /**< passed to now and expire */
+    struct ccn_indexbuf *wheel[CCND_EXPIRY_SLOTS];
+    unsigned long long slot;        /**< next time slot to sweep */
+    unsigned long n;                /**< number of pending entries */
+    struct ccn_scheduled_event *sweeper;
+};
+
+/**
+ * Make an empty expiry wheel that runs on the given schedule.
+ */
+struct ccnd_expiry *
+ccnd_expiry_create(struct ccn_schedule *sched,
+                   ccnd_expiry_clock now,
+                   ccnd_expiry_action expire,
+                   void *data)
+{
+    struct ccnd_expiry *w;
+
+    w = calloc(1, sizeof(*w));
+    if (w == NULL)
+        return(NULL);
+    w->sched = sched;
+    w->now = now;
+    w->expire = expire;
+    w->data = data;
+    return(w);
+}
+
+/**
+ * Destroy an expiry wheel, dropping any pending entries.
+ *
+ * If the schedule is to be destroyed too, either order is fine.
+ */
+void
+ccnd_expiry_destroy(struct ccnd_expiry **pw)
+{
+    struct ccnd_expiry *w = *pw;
+    int i;
+
+    if (w == NULL)
+        return;
+    if (w->sweeper != NULL)
+        ccn_schedule_cancel(w->sched, w->sweeper);
+    for (i = 0; i < CCND_EXPIRY_SLOTS; i++)
+        ccn_indexbuf_destroy(&w->wheel[i]);
+    free(w);
+    *pw = NULL;
+}
+
+/**
+ * Scheduled event that expires entries in batches.
+ *
+ * Sweeps the expiry slots that have come due since the last sweep.
+ * Entries in a swept list that are not yet due (because they are
+ * more than a full turn of the wheel away) are kept for a later turn.
+ */
+static int
+sweep_expiry(struct ccn_schedule *sched,
+             void *clienth,
+             struct ccn_scheduled_event *ev,
+             int flags)
+{
+    struct ccnd_expiry *w = ev->evdata;
+    struct ccn_indexbuf *slot = NULL;
+    unsigned long long now;
+    int turns;
+    int i, j;
+
+    if ((flags & CCN_SCHEDULE_CANCEL) != 0) {
+        w->sweeper = NULL;
+        return(0);
+    }
+    now = (w->now)(w->data) / CCND_EXPIRY_SLOT_USEC;
+    for (turns = 0; w->slot <= now && turns < CCND_EXPIRY_SLOTS;
+         turns++, w->slot++) {
+        slot = w->wheel[w->slot % CCND_EXPIRY_SLOTS];
+        if (slot == NULL)
+            continue;
+        for (i = 0, j = 0; i + 1 < slot->n; i += 2) {
+            if (slot->buf[i + 1] <= now) {
+                w->n--;
+                (w->expire)(w->data, slot->buf[i]);
+            }
+            else {
+                slot->buf[j++] = slot->buf[i];
+                slot->buf[j++] = slot->buf[i + 1];
+            }
+        }
+        slot->n = j;
+    }
+    w->slot = now + 1;
+    if (w->n == 0) {
+        w->sweeper = NULL;
+        return(0);
+    }
+    /* Stay aligned with the slot boundaries */
+    return(CCND_EXPIRY_SLOT_USEC - (w->now)(w->data) % CCND_EXPIRY_SLOT_USEC);
+}
+
+/**
+ * Enter an accession into the wheel, to expire after the
+ * given number of microseconds.
+ *
+ * An entry that is already due goes out with the next sweep.
+ */
+void
+ccnd_expiry_schedule(struct ccnd_expiry *w, ccn_accession_t accession,
+                     int microseconds)
+{
+    struct ccn_indexbuf **slotp = NULL;
+    unsigned long long now = (w->now)(w->data);
+    unsigned long long due;
+
+    if (w->sweeper == NULL) {
+        /* The wheel is empty, so it may start from here */
+        w->slot = now / CCND_EXPIRY_SLOT_USEC;
+        w->sweeper = ccn_schedule_event(w->sched,
+            CCND_EXPIRY_SLOT_USEC - now % CCND_EXPIRY_SLOT_USEC,
+            &sweep_expiry, w, 0);
+    }
+    due = (now + microseconds + CCND_EXPIRY_SLOT_USEC - 1) / CCND_EXPIRY_SLOT_USEC;
+    /* Already due: the next sweep takes it, not one a turn later */
+    if (due < w->slot)
+        due = w->slot;
+    slotp = &w->wheel[due % CCND_EXPIRY_SLOTS];
+    if (*slotp == NULL)
+        *slotp = ccn_indexbuf_create();
+    ccn_indexbuf_append_element(*slotp, accession);
+    ccn_indexbuf_append_element(*slotp, due);
+    w->n++;
+}
+
@@ -1057,11 +1057,9 @@ ccnd_answer_req(struct ccn_closure *selfp,
     if ((ccnd->debug & 128) != 0)
         ccnd_debug_ccnb(ccnd, __LINE__, "ccnd_answer_req_response", NULL,
                         msg->buf, msg->length);
-    res = ccn_put(info->h, msg->buf, msg->length);
-    if (res < 0)
-        goto Bail;
     if (CCND_TEST_100137)
         ccn_put(info->h, msg->buf, msg->length);
+    ccnd_internal_client_put(ccnd, &msg);
     res = CCN_UPCALL_RESULT_INTEREST_CONSUMED;
     goto Finish;
 Bail:
@@ -1379,6 +1377,7 @@ ccnd_internal_client_start(struct ccnd_handle *ccnd)
     if (ccnd->face0 == NULL)
         abort();
     ccnd->internal_client = h = ccn_create();
+    ccn_set_output_hook(h, &ccnd_internal_client_output, ccnd);
     if (ccnd_init_internal_keystore(ccnd) < 0) {
         ccn_destroy(&ccnd->internal_client);
         return(-1);
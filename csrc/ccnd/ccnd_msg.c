@@ -198,16 +198,27 @@ const char *ccnd_usage_message =
     "    CCND_CAP=\n"
     "      Capacity limit, in count of ContentObjects.\n"
     "      Not an absolute limit.\n"
+    "    CCND_CS_ADMIT=\n"
+    "      Content store admission policy: all (default), prob:PERCENT,\n"
+    "      or second[:COUNTERS] to cache only names requested before\n"
+    "    CCND_CS_NOCACHE=\n"
+    "      List of ccnx URI prefixes whose content is forwarded but not cached\n"
+    "    CCND_CS_MAXSIZE=\n"
+    "      Largest ContentObject, in bytes, to cache (default no limit)\n"
     "    CCND_MTU=\n"
     "      Packet size in bytes.\n"
     "      If set, interest stuffing is allowed within this budget.\n"
     "      Single items larger than this are not precluded.\n"
     "    CCND_DATA_PAUSE_MICROSEC=\n"
     "      Adjusts content-send delay time for multicast and udplink faces\n"
+    "      On multicast faces this is the starting pause, which then follows\n"
+    "      observed response times within 1/64 to 4 times this value\n"
     "    CCND_DEFAULT_TIME_TO_STALE=\n"
     "      Default for content objects without explicit FreshnessSeconds\n"
     "    CCND_MAX_TIME_TO_STALE=\n"
     "      Limit, in seconds, until content becomes stale\n"
+    "    CCND_STATUS_STALE_MS=\n"
+    "      Age, in milliseconds, up to which the web status view reuses data\n"
     "    CCND_KEYSTORE_DIRECTORY=\n"
     "      Directory readable only by ccnd where its keystores are kept\n"
     "      Defaults to a private subdirectory of /var/tmp\n"
@@ -45,6 +45,10 @@ struct ccn_charbuf;
 struct ccn_indexbuf;
 struct hashtb;
 struct ccnd_meter;
+struct ccnd_status;
+struct ccnd_admission;
+struct ccnd_expiry;
+struct ccn_parsed_ContentObject;
 
 /*
  * These are defined in this header.
@@ -55,6 +59,7 @@ struct content_entry;
 struct nameprefix_entry;
 struct interest_entry;
 struct pit_face_item;
+struct icq_item;
 struct content_tree_node;
 struct ccn_forwarding;
 struct ccn_strategy;
@@ -121,6 +126,7 @@ struct ccnd_handle {
     unsigned long capacity;         /**< may toss content if there more than
                                      this many content objects in the store */
     unsigned long n_stale;          /**< Number of stale content objects */
+    struct ccnd_expiry *expiry;     /**< see ccnd_expiry.c */
     struct ccn_indexbuf *unsol;     /**< unsolicited content */
     unsigned long oldformatcontent;
     unsigned long oldformatcontentgrumble;
@@ -128,10 +134,15 @@ struct ccnd_handle {
     unsigned long oldformatinterestgrumble;
     unsigned long content_dups_recvd;
     unsigned long content_items_sent;
+    unsigned long content_passed;   /**< new content sent on but not cached */
+    unsigned long content_suppressed; /**< multicast sends cancelled when overheard */
     unsigned long interests_accepted;
     unsigned long interests_dropped;
     unsigned long interests_sent;
     unsigned long interests_stuffed;
+    unsigned long interests_suppressed; /**< multicast sends skipped when overheard */
+    unsigned long nacks_sent;
+    unsigned long nacks_received;
     unsigned short seed[3];         /**< for PRNG */
     int running;                    /**< true while should be running */
     int debug;                      /**< For controlling debug output */
@@ -148,6 +159,10 @@ struct ccnd_handle {
     const char *progname;           /**< our name, for locating helpers */
     struct ccn *internal_client;    /**< internal client */
     struct face *face0;             /**< special face for internal client */
+    struct icq_item *icq;           /**< messages from internal client */
+    unsigned icq_n;                 /**< number of messages in icq */
+    unsigned icq_limit;             /**< allocated size of icq */
+    struct ccn_scheduled_event *icq_event; /**< pending processing of icq */
     struct ccn_charbuf *service_ccnb; /**< for local service discovery */
     struct ccn_charbuf *neighbor_ccnb; /**< for neighbor service discovery */
     struct ccn_seqwriter *notice;   /**< for notices of status changes */
@@ -159,6 +174,9 @@ struct ccnd_handle {
                                     /**< pluggable nonce generation */
     int tts_default;                /**< CCND_DEFAULT_TIME_TO_STALE (seconds) */
     int tts_limit;                  /**< CCND_MAX_TIME_TO_STALE (seconds) */
+    int status_stale_ms;            /**< CCND_STATUS_STALE_MS */
+    struct ccnd_status *status;     /**< status server, see ccnd_stats.c */
+    struct ccnd_admission *admission; /**< see ccnd_admission.c */
 };
 
 /**
@@ -181,6 +199,14 @@ struct content_queue {
     struct ccn_scheduled_event *sender;
 };
 
+/**
+ * A message from the internal client, waiting to be processed
+ */
+struct icq_item {
+    struct ccn_charbuf *msg;        /**< owned by the queue */
+    int dtag;                       /**< CCN_DTAG_Interest, etc. */
+};
+
 enum cq_delay_class {
     CCN_CQ_ASAP,
     CCN_CQ_NORMAL,
@@ -226,6 +252,8 @@ struct face {
     struct ccnd_meter *meter[CCND_FACE_METER_N];
     unsigned short pktseq;      /**< sequence number for sent packets */
     unsigned short adjstate;    /**< state of adjacency negotiotiation */
+    unsigned mcast_srtt;        /**< multicast response time, usec, smoothed */
+    unsigned mcast_rttvar;      /**< mean deviation of mcast_srtt */
 };
 
 /** face flags */
@@ -254,6 +282,19 @@ struct face {
 #define CCN_FACE_ADJ   (1 << 22) /** Adjacency guid has been negotiatied */
 #define CCN_NOFACEID    (~0U)    /** denotes no face */
 
+/**
+ * Content expiry is batched into time slots of CCND_EXPIRY_SLOT_USEC,
+ * hashed onto a timing wheel of CCND_EXPIRY_SLOTS lists (see ccnd_expiry.c).
+ */
+#define CCND_EXPIRY_SLOT_USEC 62500
+#define CCND_EXPIRY_SLOTS 512
+
+/**
+ * A stream face with more than this many bytes waiting to be written
+ * is considered congested.
+ */
+#define CCND_CONGESTED_BACKLOG 65536
+
 /**
  *  The content hash table is keyed by the initial portion of the ContentObject
  *  that contains all the parts of the complete name.  The extdata of the hash
@@ -273,6 +314,7 @@ struct content_entry {
     const unsigned char *key;   /**< ccnb-encoded ContentObject */
     int key_size;               /**< Size of fragment prior to Content */
     int size;                   /**< Size of ContentObject */
+    int queued;                 /**< Number of face send queues holding it */
     struct ccn_indexbuf *skiplinks; /**< skiplist for name-ordered ops */
 };
 
@@ -282,6 +324,7 @@ struct content_entry {
 #define CCN_CONTENT_ENTRY_SLOWSEND  1
 #define CCN_CONTENT_ENTRY_STALE     2
 #define CCN_CONTENT_ENTRY_PRECIOUS  4
+#define CCN_CONTENT_ENTRY_TRANSIT   8   /**< not admitted, see ccnd_admission.c */
 
 /**
  * The sparse_straggler hash table, keyed by accession, holds scattered
@@ -302,6 +345,7 @@ struct ccn_strategy {
     ccn_wrappedtime birth;          /**< when interest entry was created */
     ccn_wrappedtime renewed;        /**< when interest entry was renewed */
     unsigned renewals;              /**< number of times renewed */
+    int nack;                       /**< reason from latest upstream NACK */
 };
 
 struct ielinks;
@@ -326,7 +370,11 @@ struct interest_entry {
     const unsigned char *interest_msg; /**< pending interest message */
     unsigned size;                  /**< size of interest message */
     unsigned serial;                /**< used for logging */
+    unsigned flags;                 /**< CCND_IE_x */
+    unsigned mcast_usec;            /**< when first sent or heard on multicast */
 };
+#define CCND_IE_NACK      0x0001    /**< Downstreams want InterestNacks */
+#define CCND_IE_MCAST     0x0002    /**< mcast_usec is valid */
 
 #define TYPICAL_NONCE_SIZE 12       /**< actual allocated size may differ */
 /**
@@ -354,6 +402,7 @@ struct pit_face_item {
 #define CCND_PFI_PENDING  0x2000    /**< Pending for immediate data */
 #define CCND_PFI_SUPDATA  0x4000    /**< Suppressed data reply */
 #define CCND_PFI_DCFACE  0x10000    /**< This upstream is a DC face */
+#define CCND_PFI_MCWAIT  0x20000    /**< Listening before send on multicast */
 
 /**
  * The nameprefix hash table is keyed by the Component elements of
@@ -493,6 +542,8 @@ void ccnd_adjacency_offer_or_commit_req(struct ccnd_handle *ccnd,
                                         struct face *face);
 
 void ccnd_internal_client_has_somthing_to_say(struct ccnd_handle *h);
+void ccnd_internal_client_output(void *ccnd, const unsigned char *msg, size_t size);
+void ccnd_internal_client_put(struct ccnd_handle *h, struct ccn_charbuf **pmsg);
 
 struct face *ccnd_face_from_faceid(struct ccnd_handle *, unsigned);
 void ccnd_face_status_change(struct ccnd_handle *, unsigned);
@@ -501,7 +552,27 @@ void ccnd_send(struct ccnd_handle *h, struct face *face,
                const void *data, size_t size);
 
 /* Consider a separate header for these */
+struct ccnd_admission *ccnd_admission_create(struct ccnd_handle *h,
+                                             const char *spec,
+                                             struct ccn_charbuf *nocache,
+                                             size_t maxsize);
+void ccnd_admission_destroy(struct ccnd_admission **);
+const char *ccnd_admission_policy(struct ccnd_admission *);
+int ccnd_admit_content(struct ccnd_handle *h, struct content_entry *content,
+                       const struct ccn_parsed_ContentObject *pco);
+typedef unsigned long long (*ccnd_expiry_clock)(void *data);
+typedef void (*ccnd_expiry_action)(void *data, ccn_accession_t accession);
+struct ccnd_expiry *ccnd_expiry_create(struct ccn_schedule *sched,
+                                       ccnd_expiry_clock now,
+                                       ccnd_expiry_action expire,
+                                       void *data);
+void ccnd_expiry_destroy(struct ccnd_expiry **);
+void ccnd_expiry_schedule(struct ccnd_expiry *, ccn_accession_t accession,
+                          int microseconds);
+unsigned ccnd_mcast_pause(struct ccnd_handle *h, struct face *face);
 int ccnd_stats_handle_http_connection(struct ccnd_handle *, struct face *);
+void ccnd_stats_face_closed(struct ccnd_handle *, unsigned faceid);
+void ccnd_stats_destroy(struct ccnd_handle *);
 void ccnd_msg(struct ccnd_handle *, const char *, ...);
 void ccnd_debug_ccnb(struct ccnd_handle *h,
                      int lineno,
@@ -20,8 +20,10 @@
  */
 
 #include <sys/types.h>
+#include <ctype.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -46,6 +48,12 @@
 #define CRLF "\r\n"
 #define NL   "\n"
 
+#define STATUS_MAX_REQUEST  2048    /**< longest request line accepted */
+#define STATUS_PAGE_DEFAULT 100     /**< entries per page if only p= given */
+#define STATUS_BATCH        200     /**< list entries looked at per turn */
+#define STATUS_PAUSE_USEC   1000    /**< between turns, so forwarding goes on */
+#define STATUS_OUTBUF_LIMIT 65536   /**< hold off while a client lags this much */
+
 /**
  * Provide a way to monitor rates.
  */
@@ -61,16 +69,140 @@ struct ccnd_stats {
     long total_flood_control;      /* done propagating, still recorded */
 };
 
+/**
+ * A face, as recorded in a status snapshot.
+ */
+struct status_face {
+    unsigned faceid;
+    int flags;
+    int pending_interests;
+    unsigned recvcount;
+    unsigned sendface;
+    unsigned mcast_pause;        /**< listen-before-send, usec */
+    unsigned mcast_response;     /**< smoothed response time, usec */
+    int port;                   /**< port of the face address, or 0 */
+    size_t node;                /**< offset of address text in strings */
+    int nmeter;                 /**< 0 if the face has no meters */
+    struct ccnd_meter meter[CCND_FACE_METER_N];
+};
+
+/**
+ * A name prefix with active forwarding, as recorded in a status snapshot.
+ */
+struct status_fentry {
+    size_t key;                 /**< offset of name components in keys */
+    size_t keysize;
+    int dest;                   /**< index of first entry in dests */
+    int ndest;
+};
+
+struct status_dest {
+    unsigned faceid;
+    int flags;
+    int expires;
+};
+
+/**
+ * The state shown by the status server, copied out of the tables.
+ *
+ * Taking a snapshot is one pass that copies just what is displayed;
+ * the costly part, formatting names and markup, is then done a batch
+ * at a time on later turns of the event loop.  A snapshot is shared by
+ * the responses made from it, and is reused for new requests until it
+ * is CCND_STATUS_STALE_MS old or the forwarding table has changed.
+ */
+struct status_snapshot {
+    int refcount;
+    long sec;                   /**< when taken */
+    unsigned usec;
+    unsigned fgen;              /**< forward_to_gen when taken */
+    struct ccnd_stats stats;
+    unsigned long long accessioned;
+    int stored;
+    unsigned long stale;
+    int sparse;
+    unsigned long duplicate;
+    unsigned long sent;
+    unsigned long passed;
+    unsigned long suppressed;
+    int names;
+    int interests;
+    unsigned long interests_accepted;
+    unsigned long interests_dropped;
+    unsigned long interests_sent;
+    unsigned long interests_stuffed;
+    unsigned long interests_suppressed;
+    unsigned long nacks_sent;
+    unsigned long nacks_received;
+    int nface;
+    struct status_face *faces;
+    int nfib;
+    struct status_fentry *fib;
+    int ndest;
+    struct status_dest *dests;
+    struct ccn_charbuf *keys;
+    struct ccn_charbuf *strings;
+};
+
+/* Parts of the document, in order */
+enum status_phase {
+    SP_HEAD,
+    SP_FACES,
+    SP_METERS,
+    SP_FIB,
+    SP_TAIL,
+    SP_DONE
+};
+
+/* Views, selected by v= */
+#define SV_SUMMARY  1
+#define SV_FACES    2
+#define SV_FIB      4
+#define SV_ALL      (SV_SUMMARY | SV_FACES | SV_FIB)
+
+/**
+ * A status document being sent on a face.
+ */
+struct status_response {
+    struct status_response *next;
+    unsigned faceid;
+    struct ccn_scheduled_event *ev;
+    struct status_snapshot *snap;
+    int xml;
+    int views;                  /**< SV_* */
+    unsigned face_filter;       /**< from face=, or CCN_NOFACEID */
+    struct ccn_charbuf *prefix; /**< name components from prefix=, or NULL */
+    int page;                   /**< from p=, counting from 1 */
+    int per_page;               /**< from n=, 0 for no paging */
+    struct ccn_charbuf *query;  /**< the query without p=, for links */
+    enum status_phase phase;
+    int i;                      /**< position in the current list */
+    int matched;                /**< entries of the list that passed filters */
+    int started;                /**< the current list has been opened */
+    struct ccn_charbuf *out;    /**< output of this turn */
+    struct ccn_charbuf *name;   /**< scratch */
+};
+
+/**
+ * Status server state, hung off the ccnd handle.
+ */
+struct ccnd_status {
+    struct status_snapshot *cached;
+    struct status_response *responses;
+};
+
 static int ccnd_collect_stats(struct ccnd_handle *h, struct ccnd_stats *ans);
-static struct ccn_charbuf *collect_stats_html(struct ccnd_handle *h);
 static void send_http_response(struct ccnd_handle *h, struct face *face,
                                const char *mime_type,
                                struct ccn_charbuf *response);
-static struct ccn_charbuf *collect_stats_html(struct ccnd_handle *h);
-static struct ccn_charbuf *collect_stats_xml(struct ccnd_handle *h);
+static void status_snapshot_release(struct status_snapshot **ps);
 
 /* HTTP */
 
+static const char *resp400 =
+    "HTTP/1.1 400 Bad Request" CRLF
+    "Connection: close" CRLF CRLF;
+
 static const char *resp404 =
     "HTTP/1.1 404 Not Found" CRLF
     "Connection: close" CRLF CRLF;
@@ -79,11 +211,15 @@ static const char *resp405 =
     "HTTP/1.1 405 Method Not Allowed" CRLF
     "Connection: close" CRLF CRLF;
 
+static const char *resp414 =
+    "HTTP/1.1 414 Request-URI Too Long" CRLF
+    "Connection: close" CRLF CRLF;
+
 static void
 ccnd_stats_http_set_debug(struct ccnd_handle *h, struct face *face, int level)
 {
     struct ccn_charbuf *response = ccn_charbuf_create();
-    
+
     h->debug = 1;
     ccnd_msg(h, "CCND_DEBUG=%d", level);
     h->debug = level;
@@ -92,65 +228,331 @@ ccnd_stats_http_set_debug(struct ccnd_handle *h, struct face *face, int level)
     ccn_charbuf_destroy(&response);
 }
 
+static struct ccnd_status *
+ccnd_status_get(struct ccnd_handle *h)
+{
+    if (h->status == NULL)
+        h->status = calloc(1, sizeof(*h->status));
+    return(h->status);
+}
+
+static void
+status_response_destroy(struct ccnd_handle *h, struct status_response **pr)
+{
+    struct status_response *r = *pr;
+    struct status_response **pp;
+
+    if (r == NULL)
+        return;
+    for (pp = &h->status->responses; *pp != NULL; pp = &(*pp)->next) {
+        if (*pp == r) {
+            *pp = r->next;
+            break;
+        }
+    }
+    status_snapshot_release(&r->snap);
+    ccn_charbuf_destroy(&r->prefix);
+    ccn_charbuf_destroy(&r->query);
+    ccn_charbuf_destroy(&r->out);
+    ccn_charbuf_destroy(&r->name);
+    free(r);
+    *pr = NULL;
+}
+
+/**
+ * Append text to a charbuf, escaped for use in HTML attributes.
+ */
+static void
+append_html_escaped(struct ccn_charbuf *c, const char *s, size_t size)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        switch (s[i]) {
+            case '&': ccn_charbuf_append_string(c, "&amp;"); break;
+            case '<': ccn_charbuf_append_string(c, "&lt;"); break;
+            case '>': ccn_charbuf_append_string(c, "&gt;"); break;
+            case '\'': ccn_charbuf_append_string(c, "&#39;"); break;
+            case '"': ccn_charbuf_append_string(c, "&quot;"); break;
+            default: ccn_charbuf_append(c, s + i, 1); break;
+        }
+    }
+}
+
+/**
+ * Undo the %-escapes (and +) of a query value, leaving a C string in c.
+ */
+static void
+append_query_decoded(struct ccn_charbuf *c, const char *s, size_t size)
+{
+    size_t i;
+    unsigned v;
+
+    for (i = 0; i < size; i++) {
+        if (s[i] == '%' && i + 2 < size &&
+            isxdigit((unsigned char)s[i + 1]) &&
+            isxdigit((unsigned char)s[i + 2]) &&
+            sscanf(s + i + 1, "%2x", &v) == 1) {
+            ccn_charbuf_append_value(c, v, 1);
+            i += 2;
+        }
+        else if (s[i] == '+')
+            ccn_charbuf_append_value(c, ' ', 1);
+        else
+            ccn_charbuf_append(c, s + i, 1);
+    }
+    ccn_charbuf_as_string(c);
+}
+
+static int
+parse_positive(const char *s, int *ans)
+{
+    char *end = NULL;
+    long v;
+
+    v = strtol(s, &end, 10);
+    if (end == s || *end != 0 || v <= 0 || v > INT_MAX)
+        return(-1);
+    *ans = v;
+    return(0);
+}
+
+/**
+ * Parse the query part of a request for a status document.
+ *
+ * Recognized parameters are
+ *   f=html|xml  format
+ *   v=summary,faces,fib  which parts to show (default all)
+ *   face=N  only this face, and forwarding to it
+ *   prefix=URI  only forwarding entries under this prefix
+ *   n=N  entries per page, p=N  which page (from 1)
+ *   l=none|low|co|med|high  set the debug level instead
+ *
+ * @returns 0 for success, -1 for a bad request, or 1 if l= asked
+ *          for the debug level to be set to *debug.
+ */
+static int
+status_parse_query(struct status_response *r, const char *q, size_t size,
+                   int *debug)
+{
+    struct ccn_charbuf *val = ccn_charbuf_create();
+    const char *tok;
+    const char *eq;
+    const char *amp;
+    const char *v;
+    size_t nlen;
+    int set_debug = 0;
+    int res = 0;
+    int i;
+
+    r->xml = 0;
+    r->views = SV_ALL;
+    r->face_filter = CCN_NOFACEID;
+    for (tok = q; res == 0 && tok < q + size; tok = amp + 1) {
+        amp = memchr(tok, '&', q + size - tok);
+        if (amp == NULL)
+            amp = q + size;
+        if (amp == tok)
+            continue;
+        eq = memchr(tok, '=', amp - tok);
+        if (eq == NULL) {
+            res = -1;
+            break;
+        }
+        nlen = eq - tok;
+        val->length = 0;
+        append_query_decoded(val, eq + 1, amp - eq - 1);
+        v = ccn_charbuf_as_string(val);
+        if (nlen == 1 && tok[0] == 'f') {
+            if (0 == strcmp(v, "xml"))
+                r->xml = 1;
+            else if (0 == strcmp(v, "html"))
+                r->xml = 0;
+            else
+                res = -1;
+        }
+        else if (nlen == 1 && tok[0] == 'v') {
+            r->views = 0;
+            for (i = 0; res == 0 && v[i] != 0; i += nlen + (v[i + nlen] == ',')) {
+                nlen = strcspn(v + i, ",");
+                if (nlen == 7 && 0 == memcmp(v + i, "summary", 7))
+                    r->views |= SV_SUMMARY;
+                else if (nlen == 5 && 0 == memcmp(v + i, "faces", 5))
+                    r->views |= SV_FACES;
+                else if (nlen == 3 && 0 == memcmp(v + i, "fib", 3))
+                    r->views |= SV_FIB;
+                else
+                    res = -1;
+            }
+            nlen = 1;
+        }
+        else if (nlen == 1 && tok[0] == 'p')
+            res = parse_positive(v, &r->page);
+        else if (nlen == 1 && tok[0] == 'n')
+            res = parse_positive(v, &r->per_page);
+        else if (nlen == 4 && 0 == memcmp(tok, "face", 4)) {
+            if (0 == strcmp(v, "0"))
+                r->face_filter = 0;
+            else if ((res = parse_positive(v, &i)) == 0)
+                r->face_filter = i;
+        }
+        else if (nlen == 6 && 0 == memcmp(tok, "prefix", 6)) {
+            if (r->prefix == NULL)
+                r->prefix = ccn_charbuf_create();
+            r->prefix->length = 0;
+            if (ccn_name_from_uri(r->prefix, v) < 0)
+                res = -1;
+            else {
+                /* keep just the components, like the table keys */
+                memmove(r->prefix->buf, r->prefix->buf + 1,
+                        r->prefix->length - 2);
+                r->prefix->length -= 2;
+            }
+        }
+        else if (nlen == 1 && tok[0] == 'l') {
+            set_debug = 1;
+            if (0 == strcmp(v, "none"))
+                *debug = 0;
+            else if (0 == strcmp(v, "low"))
+                *debug = 1;
+            else if (0 == strcmp(v, "co"))
+                *debug = 4;
+            else if (0 == strcmp(v, "med"))
+                *debug = 71;
+            else if (0 == strcmp(v, "high"))
+                *debug = -1;
+            else
+                res = -1;
+        }
+        else
+            res = -1;
+        if (res == 0 && !(nlen == 1 && tok[0] == 'p')) {
+            append_html_escaped(r->query, tok, amp - tok);
+            ccn_charbuf_append_string(r->query, "&amp;");
+        }
+    }
+    ccn_charbuf_destroy(&val);
+    if (res < 0)
+        return(-1);
+    if (set_debug)
+        return(1);
+    if (r->page > 0 && r->per_page == 0)
+        r->per_page = STATUS_PAGE_DEFAULT;
+    if (r->per_page > 0 && r->page == 0)
+        r->page = 1;
+    if (r->per_page > 0 && r->page - 1 > INT_MAX / r->per_page - 1)
+        return(-1);
+    return(0);
+}
+
+static void send_status_error(struct ccnd_handle *h, struct face *face,
+                              const char *resp);
+static int status_turn(struct ccn_schedule *sched, void *clienth,
+                       struct ccn_scheduled_event *ev, int flags);
+static struct status_snapshot *status_snapshot_get(struct ccnd_handle *h);
+
 int
 ccnd_stats_handle_http_connection(struct ccnd_handle *h, struct face *face)
 {
-    struct ccn_charbuf *response = NULL;
-    char rbuf[16];
-    int i;
-    int nspace;
-    int n;
-    
+    struct status_response *r = NULL;
+    struct ccnd_status *st = NULL;
+    struct linger linger = { .l_onoff = 1, .l_linger = 1 };
+    const char *req = (const char *)face->inbuf->buf;
+    const char *q;
+    size_t n = face->inbuf->length;
+    size_t sp1;
+    size_t sp2;
+    char buf[128];
+    int hdrlen;
+    int debug = 0;
+    int res;
+
     if (face->inbuf->length < 4)
         return(-1);
     if ((face->flags & CCN_FACE_NOSEND) != 0) {
         ccnd_destroy_face(h, face->faceid);
         return(-1);
     }
-    n = sizeof(rbuf) - 1;
-    if (face->inbuf->length < n)
-        n = face->inbuf->length;
-    for (i = 0, nspace = 0; i < n && nspace < 2; i++) {
-        rbuf[i] = face->inbuf->buf[i];
-        if (rbuf[i] == ' ')
-            nspace++;
-    }
-    rbuf[i] = 0;
-    if (nspace < 2 && i < sizeof(rbuf) - 1)
-        return(-1);
-    if (0 == strcmp(rbuf, "GET / ") ||
-        0 == strcmp(rbuf, "GET /? ")) {
-        response = collect_stats_html(h);
-        send_http_response(h, face, "text/html", response);
+    if (n > STATUS_MAX_REQUEST)
+        n = STATUS_MAX_REQUEST;
+    for (sp1 = 0; sp1 < n && req[sp1] != ' '; sp1++)
+        continue;
+    for (sp2 = sp1 + 1; sp2 < n && req[sp2] != ' '; sp2++)
+        continue;
+    if (sp2 >= n) {
+        if (n < STATUS_MAX_REQUEST)
+            return(-1); /* wait for the rest of the request line */
+        send_status_error(h, face, resp414);
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?l=none ")) {
-        ccnd_stats_http_set_debug(h, face, 0);
+    if (sp1 != 3 || 0 != memcmp(req, "GET", 3)) {
+        send_status_error(h, face, resp405);
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?l=low ")) {
-        ccnd_stats_http_set_debug(h, face, 1);
+    q = req + sp1 + 1;
+    if (q[0] != '/' || (q + 1 != req + sp2 && q[1] != '?')) {
+        send_status_error(h, face, resp404);
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?l=co ")) {
-        ccnd_stats_http_set_debug(h, face, 4);
+    q += (q + 1 == req + sp2) ? 1 : 2;
+    st = ccnd_status_get(h);
+    r = calloc(1, sizeof(*r));
+    if (st == NULL || r == NULL) {
+        free(r);
+        send_status_error(h, face, resp404);
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?l=med ")) {
-        ccnd_stats_http_set_debug(h, face, 71);
+    r->faceid = face->faceid;
+    r->query = ccn_charbuf_create();
+    res = status_parse_query(r, q, req + sp2 - q, &debug);
+    if (res != 0) {
+        status_response_destroy(h, &r);
+        if (res < 0)
+            send_status_error(h, face, resp400);
+        else {
+            ccnd_stats_http_set_debug(h, face, debug);
+            face->flags |= (CCN_FACE_NOSEND | CCN_FACE_CLOSING);
+        }
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?l=high ")) {
-        ccnd_stats_http_set_debug(h, face, -1);
+    r->snap = status_snapshot_get(h);
+    r->out = ccn_charbuf_create();
+    r->name = ccn_charbuf_create();
+    r->next = st->responses;
+    st->responses = r;
+    if (r->snap == NULL) {
+        status_response_destroy(h, &r);
+        send_status_error(h, face, resp404);
+        return(0);
     }
-    else if (0 == strcmp(rbuf, "GET /?f=xml ")) {
-        response = collect_stats_xml(h);
-        send_http_response(h, face, "text/xml", response);
+    /*
+     * The document is produced a batch at a time, so its length is not
+     * known in advance; the end of the connection marks the end of it.
+     */
+    setsockopt(face->recv_fd, SOL_SOCKET, SO_LINGER, &linger, sizeof(linger));
+    hdrlen = snprintf(buf, sizeof(buf),
+                      "HTTP/1.1 200 OK" CRLF
+                      "Content-Type: %s; charset=utf-8" CRLF
+                      "Connection: close" CRLF CRLF,
+                      r->xml ? "text/xml" : "text/html");
+    ccnd_send(h, face, buf, hdrlen);
+    /* The request is all we read; a second one is not expected. */
+    face->flags |= CCN_FACE_NORECV;
+    r->ev = ccn_schedule_event(h->sched, 0, &status_turn, r, 0);
+    if (r->ev == NULL) {
+        status_response_destroy(h, &r);
+        face->flags |= (CCN_FACE_NOSEND | CCN_FACE_CLOSING);
     }
-    else if (0 == strcmp(rbuf, "GET "))
-        ccnd_send(h, face, resp404, strlen(resp404));
-    else
-        ccnd_send(h, face, resp405, strlen(resp405));
-    face->flags |= (CCN_FACE_NOSEND | CCN_FACE_CLOSING);
-    ccn_charbuf_destroy(&response);
     return(0);
 }
 
+static void
+send_status_error(struct ccnd_handle *h, struct face *face, const char *resp)
+{
+    ccnd_send(h, face, resp, strlen(resp));
+    face->flags |= (CCN_FACE_NOSEND | CCN_FACE_CLOSING);
+}
+
 static void
 send_http_response(struct ccnd_handle *h, struct face *face,
                    const char *mime_type, struct ccn_charbuf *response)
@@ -172,6 +574,45 @@ send_http_response(struct ccnd_handle *h, struct face *face,
     ccnd_send(h, face, response->buf, response->length);
 }
 
+/**
+ * Forget about status responses for a face that is going away.
+ */
+void
+ccnd_stats_face_closed(struct ccnd_handle *h, unsigned faceid)
+{
+    struct status_response *r;
+    struct status_response *next;
+
+    if (h->status == NULL)
+        return;
+    for (r = h->status->responses; r != NULL; r = next) {
+        next = r->next;
+        if (r->faceid == faceid) {
+            if (r->ev != NULL)
+                ccn_schedule_cancel(h->sched, r->ev); /* destroys r */
+            else
+                status_response_destroy(h, &r);
+        }
+    }
+}
+
+/**
+ * Free the status server state.
+ *
+ * Pending responses must have been cancelled (by destroying the schedule).
+ */
+void
+ccnd_stats_destroy(struct ccnd_handle *h)
+{
+    if (h->status == NULL)
+        return;
+    while (h->status->responses != NULL)
+        status_response_destroy(h, &h->status->responses);
+    status_snapshot_release(&h->status->cached);
+    free(h->status);
+    h->status = NULL;
+}
+
 /* Common statistics collection */
 
 static int
@@ -211,135 +652,200 @@ ccnd_collect_stats(struct ccnd_handle *h, struct ccnd_stats *ans)
     return(0);
 }
 
-/* HTML formatting */
+/* Snapshots */
 
-static void
-collect_faces_html(struct ccnd_handle *h, struct ccn_charbuf *b)
+static struct status_snapshot *
+status_snapshot_take(struct ccnd_handle *h)
 {
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct status_snapshot *s;
+    struct status_face *sf;
+    struct status_fentry *fe;
+    struct status_dest *d;
+    struct ccn_forwarding *f;
+    int ndest_limit = 0;
     int i;
-    struct ccn_charbuf *nodebuf;
-    int port;
-    
-    nodebuf = ccn_charbuf_create();
-    ccn_charbuf_putf(b, "<h4>Faces</h4>" NL);
-    ccn_charbuf_putf(b, "<ul>");
+    int m;
+
+    s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return(NULL);
+    s->refcount = 1;
+    s->sec = h->sec;
+    s->usec = h->usec;
+    s->fgen = h->forward_to_gen;
+    ccnd_collect_stats(h, &s->stats);
+    s->accessioned = h->accession;
+    s->stored = hashtb_n(h->content_tab);
+    s->stale = h->n_stale;
+    s->sparse = hashtb_n(h->sparse_straggler_tab);
+    s->duplicate = h->content_dups_recvd;
+    s->sent = h->content_items_sent;
+    s->passed = h->content_passed;
+    s->suppressed = h->content_suppressed;
+    s->names = hashtb_n(h->nameprefix_tab);
+    s->interests = hashtb_n(h->interest_tab);
+    s->interests_accepted = h->interests_accepted;
+    s->interests_dropped = h->interests_dropped;
+    s->interests_sent = h->interests_sent;
+    s->interests_stuffed = h->interests_stuffed;
+    s->interests_suppressed = h->interests_suppressed;
+    s->nacks_sent = h->nacks_sent;
+    s->nacks_received = h->nacks_received;
+    s->keys = ccn_charbuf_create();
+    s->strings = ccn_charbuf_create();
+    s->faces = calloc(h->face_limit + 1, sizeof(s->faces[0]));
+    s->fib = calloc(s->names + 1, sizeof(s->fib[0]));
+    if (s->keys == NULL || s->strings == NULL ||
+        s->faces == NULL || s->fib == NULL) {
+        status_snapshot_release(&s);
+        return(NULL);
+    }
     for (i = 0; i < h->face_limit; i++) {
         struct face *face = h->faces_by_faceid[i];
-        if (face != NULL && (face->flags & CCN_FACE_UNDECIDED) == 0) {
-            ccn_charbuf_putf(b, " <li>");
-            ccn_charbuf_putf(b, "<b>face:</b> %u <b>flags:</b> 0x%x",
-                             face->faceid, face->flags);
-            ccn_charbuf_putf(b, " <b>pending:</b> %d",
-                             face->pending_interests);
-            if (face->recvcount != 0)
-                ccn_charbuf_putf(b, " <b>activity:</b> %d",
-                                 face->recvcount);
-            nodebuf->length = 0;
-            port = ccn_charbuf_append_sockaddr(nodebuf, face->addr);
-            if (port > 0) {
-                const char *node = ccn_charbuf_as_string(nodebuf);
-                int chk = CCN_FACE_MCAST | CCN_FACE_UNDECIDED |
-                CCN_FACE_NOSEND | CCN_FACE_GG | CCN_FACE_PASSIVE;
-                if ((face->flags & chk) == 0)
-                    ccn_charbuf_putf(b,
-                                     " <b>remote:</b> "
-                                     "<a href='http://%s:%s/'>"
-                                     "%s:%d</a>",
-                                     node, CCN_DEFAULT_UNICAST_PORT,
-                                     node, port);
-                else if ((face->flags & CCN_FACE_PASSIVE) == 0)
-                    ccn_charbuf_putf(b, " <b>remote:</b> %s:%d",
-                                     node, port);
-                else
-                    ccn_charbuf_putf(b, " <b>local:</b> %s:%d",
-                                     node, port);
-                if (face->sendface != face->faceid &&
-                    face->sendface != CCN_NOFACEID)
-                    ccn_charbuf_putf(b, " <b>via:</b> %u", face->sendface);
+        if (face == NULL || (face->flags & CCN_FACE_UNDECIDED) != 0)
+            continue;
+        sf = &s->faces[s->nface++];
+        sf->faceid = face->faceid;
+        sf->flags = face->flags;
+        sf->pending_interests = face->pending_interests;
+        sf->recvcount = face->recvcount;
+        sf->sendface = face->sendface;
+        if ((face->flags & CCN_FACE_MCAST) != 0) {
+            sf->mcast_pause = ccnd_mcast_pause(h, face);
+            sf->mcast_response = face->mcast_srtt;
+        }
+        sf->node = s->strings->length;
+        sf->port = ccn_charbuf_append_sockaddr(s->strings, face->addr);
+        if (sf->port > 0)
+            ccn_charbuf_append_value(s->strings, 0, 1);
+        else {
+            sf->port = 0;
+            s->strings->length = sf->node;
+        }
+        if (face->meter[0] != NULL) {
+            sf->nmeter = CCND_FACE_METER_N;
+            for (m = 0; m < CCND_FACE_METER_N; m++)
+                if (face->meter[m] != NULL)
+                    sf->meter[m] = *face->meter[m];
+        }
+    }
+    hashtb_start(h->nameprefix_tab, e);
+    for (; e->data != NULL && s->nfib < s->names; hashtb_next(e)) {
+        struct nameprefix_entry *npe = e->data;
+        fe = NULL;
+        for (f = npe->forwarding; f != NULL; f = f->next) {
+            if ((f->flags & (CCN_FORW_ACTIVE | CCN_FORW_PFXO)) == 0)
+                continue;
+            if (s->ndest == ndest_limit) {
+                ndest_limit = 2 * ndest_limit + 64;
+                d = realloc(s->dests, ndest_limit * sizeof(s->dests[0]));
+                if (d == NULL)
+                    break;
+                s->dests = d;
+            }
+            if (fe == NULL) {
+                fe = &s->fib[s->nfib++];
+                fe->key = s->keys->length;
+                fe->keysize = e->keysize;
+                fe->dest = s->ndest;
+                ccn_charbuf_append(s->keys, e->key, e->keysize);
             }
-            ccn_charbuf_putf(b, "</li>" NL);
+            d = &s->dests[s->ndest++];
+            d->faceid = f->faceid;
+            d->flags = f->flags & CCN_FORW_PUBMASK;
+            d->expires = f->expires;
+            fe->ndest++;
         }
     }
-    ccn_charbuf_putf(b, "</ul>");
-    ccn_charbuf_destroy(&nodebuf);
+    hashtb_end(e);
+    return(s);
 }
 
 static void
-collect_face_meter_html(struct ccnd_handle *h, struct ccn_charbuf *b)
+status_snapshot_release(struct status_snapshot **ps)
 {
-    int i;
-    ccn_charbuf_putf(b, "<h4>Face Activity Rates</h4>");
-    ccn_charbuf_putf(b, "<table cellspacing='0' cellpadding='0' class='tbl' summary='face activity rates'>");
-    ccn_charbuf_putf(b, "<tbody>" NL);
-    ccn_charbuf_putf(b, " <tr><td>        </td>\t"
-                        " <td>Bytes/sec In/Out</td>\t"
-                        " <td>recv data/intr sent</td>\t"
-                        " <td>sent data/intr recv</td></tr>" NL);
-    for (i = 0; i < h->face_limit; i++) {
-        struct face *face = h->faces_by_faceid[i];
-        if (face != NULL && (face->flags & (CCN_FACE_UNDECIDED|CCN_FACE_PASSIVE)) == 0) {
-            ccn_charbuf_putf(b, " <tr>");
-            ccn_charbuf_putf(b, "<td><b>face:</b> %u</td>\t",
-                             face->faceid);
-            ccn_charbuf_putf(b, "<td>%6u / %u</td>\t\t",
-                                 ccnd_meter_rate(h, face->meter[FM_BYTI]),
-                                 ccnd_meter_rate(h, face->meter[FM_BYTO]));
-            ccn_charbuf_putf(b, "<td>%9u / %u</td>\t\t",
-                                 ccnd_meter_rate(h, face->meter[FM_DATI]),
-                                 ccnd_meter_rate(h, face->meter[FM_INTO]));
-            ccn_charbuf_putf(b, "<td>%9u / %u</td>",
-                                 ccnd_meter_rate(h, face->meter[FM_DATO]),
-                                 ccnd_meter_rate(h, face->meter[FM_INTI]));
-            ccn_charbuf_putf(b, "</tr>" NL);
-        }
+    struct status_snapshot *s = *ps;
+
+    if (s == NULL)
+        return;
+    *ps = NULL;
+    if (--s->refcount > 0)
+        return;
+    ccn_charbuf_destroy(&s->keys);
+    ccn_charbuf_destroy(&s->strings);
+    free(s->faces);
+    free(s->fib);
+    free(s->dests);
+    free(s);
+}
+
+/**
+ * Get a snapshot for a new response, taking a fresh one if the
+ * cached one is too old, or if registrations have come or gone since.
+ */
+static struct status_snapshot *
+status_snapshot_get(struct ccnd_handle *h)
+{
+    struct ccnd_status *st = h->status;
+    struct status_snapshot *s = st->cached;
+    long age_ms;
+
+    if (s != NULL) {
+        age_ms = (h->sec - s->sec) * 1000L +
+                 ((long)h->usec - (long)s->usec) / 1000L;
+        if (age_ms < 0 || age_ms >= h->status_stale_ms ||
+            s->fgen != h->forward_to_gen)
+            status_snapshot_release(&st->cached);
     }
-    ccn_charbuf_putf(b, "</tbody>");
-    ccn_charbuf_putf(b, "</table>");
+    if (st->cached == NULL)
+        st->cached = status_snapshot_take(h);
+    s = st->cached;
+    if (s != NULL)
+        s->refcount++;
+    return(s);
+}
+
+/* List filters */
+
+static int
+face_matches(struct status_response *r, int i)
+{
+    return(r->snap->faces[i].faceid == r->face_filter);
+}
+
+static int
+dest_matches(struct status_response *r, struct status_dest *d)
+{
+    return(r->face_filter == CCN_NOFACEID || d->faceid == r->face_filter);
+}
+
+static int
+fentry_matches(struct status_response *r, int i)
+{
+    struct status_snapshot *s = r->snap;
+    struct status_fentry *fe = &s->fib[i];
+    int j;
+
+    if (r->prefix != NULL &&
+        (fe->keysize < r->prefix->length ||
+         0 != memcmp(s->keys->buf + fe->key, r->prefix->buf,
+                     r->prefix->length)))
+        return(0);
+    for (j = 0; j < fe->ndest; j++)
+        if (dest_matches(r, &s->dests[fe->dest + j]))
+            return(1);
+    return(0);
 }
 
 static void
-collect_forwarding_html(struct ccnd_handle *h, struct ccn_charbuf *b)
+append_fentry_uri(struct status_response *r, struct status_fentry *fe)
 {
-    struct hashtb_enumerator ee;
-    struct hashtb_enumerator *e = &ee;
-    struct ccn_forwarding *f;
-    int res;
-    struct ccn_charbuf *name = ccn_charbuf_create();
-    
-    ccn_charbuf_putf(b, "<h4>Forwarding</h4>" NL);
-    ccn_charbuf_putf(b, "<ul>");
-    hashtb_start(h->nameprefix_tab, e);
-    for (; e->data != NULL; hashtb_next(e)) {
-        struct nameprefix_entry *ipe = e->data;
-        ccn_name_init(name);
-        res = ccn_name_append_components(name, e->key, 0, e->keysize);
-        if (res < 0)
-            abort();
-        if (0) {
-            ccn_charbuf_putf(b, " <li>");
-            ccn_uri_append(b, name->buf, name->length, 1);
-            ccn_charbuf_putf(b, "</li>" NL);
-        }
-        for (f = ipe->forwarding; f != NULL; f = f->next) {
-            if ((f->flags & (CCN_FORW_ACTIVE | CCN_FORW_PFXO)) != 0) {
-                ccn_name_init(name);
-                ccn_name_append_components(name, e->key, 0, e->keysize);
-                ccn_charbuf_putf(b, " <li>");
-                ccn_uri_append(b, name->buf, name->length, 1);
-                ccn_charbuf_putf(b,
-                                 " <b>face:</b> %u"
-                                 " <b>flags:</b> 0x%x"
-                                 " <b>expires:</b> %d",
-                                 f->faceid,
-                                 f->flags & CCN_FORW_PUBMASK,
-                                 f->expires);
-                ccn_charbuf_putf(b, "</li>" NL);
-            }
-        }
-    }
-    hashtb_end(e);
-    ccn_charbuf_destroy(&name);
-    ccn_charbuf_putf(b, "</ul>");
+    ccn_name_init(r->name);
+    ccn_name_append_components(r->name, r->snap->keys->buf + fe->key,
+                               0, fe->keysize);
+    ccn_uri_append(r->out, r->name->buf, r->name->length, 1);
 }
 
 static unsigned
@@ -347,27 +853,28 @@ ccnd_colorhash(struct ccnd_handle *h)
 {
     unsigned const char *a = h->ccnd_id;
     unsigned v;
-    
+
     v = (a[0] << 16) + (a[1] << 8) + a[2];
     return (v | 0xC0C0C0);
 }
 
-static struct ccn_charbuf *
-collect_stats_html(struct ccnd_handle *h)
+/* HTML formatting */
+
+static void
+status_head_html(struct ccnd_handle *h, struct status_response *r)
 {
-    struct ccnd_stats stats = {0};
-    struct ccn_charbuf *b = ccn_charbuf_create();
+    struct status_snapshot *s = r->snap;
+    struct ccn_charbuf *b = r->out;
     int pid;
     struct utsname un;
     const char *portstr;
-    
+
     portstr = getenv(CCN_LOCAL_PORT_ENVNAME);
     if (portstr == NULL || portstr[0] == 0 || strlen(portstr) > 10)
         portstr = CCN_DEFAULT_UNICAST_PORT;
     uname(&un);
     pid = getpid();
-    
-    ccnd_collect_stats(h, &stats);
+
     ccn_charbuf_putf(b,
         "<html xmlns='http://www.w3.org/1999/xhtml'>"
         "<head>"
@@ -389,13 +896,7 @@ collect_stats_html(struct ccnd_handle *h)
         "</style>"
         "</head>" NL
         "<body bgcolor='#%06X'>"
-        "<p class='header'>%s ccnd[%d] local port %s api %d start %ld.%06u now %ld.%06u</p>" NL
-        "<div><b>Content items:</b> %llu accessioned,"
-        " %d stored, %lu stale, %d sparse, %lu duplicate, %lu sent</div>" NL
-        "<div><b>Interests:</b> %d names,"
-        " %ld pending, %ld propagating, %ld noted</div>" NL
-        "<div><b>Interest totals:</b> %lu accepted,"
-        " %lu dropped, %lu sent, %lu stuffed</div>" NL,
+        "<p class='header'>%s ccnd[%d] local port %s api %d start %ld.%06u now %ld.%06u</p>" NL,
         un.nodename,
         pid,
         ccnd_colorhash(h),
@@ -404,145 +905,134 @@ collect_stats_html(struct ccnd_handle *h)
         portstr,
         (int)CCN_API_VERSION,
         h->starttime, h->starttime_usec,
-        h->sec,
-        h->usec,
-        (unsigned long long)h->accession,
-        hashtb_n(h->content_tab),
-        h->n_stale,
-        hashtb_n(h->sparse_straggler_tab),
-        h->content_dups_recvd,
-        h->content_items_sent,
-        hashtb_n(h->nameprefix_tab), stats.total_interest_counts,
-        hashtb_n(h->interest_tab) - stats.total_flood_control,
-        stats.total_flood_control,
-        h->interests_accepted, h->interests_dropped,
-        h->interests_sent, h->interests_stuffed);
-    if (0)
-        ccn_charbuf_putf(b,
-                         "<div><b>Active faces and listeners:</b> %d</div>" NL,
-                         hashtb_n(h->faces_by_fd) + hashtb_n(h->dgram_faces));
-    collect_faces_html(h, b);
-    collect_face_meter_html(h, b);
-    collect_forwarding_html(h, b);
+        s->sec,
+        s->usec);
+    if ((r->views & SV_SUMMARY) == 0)
+        return;
     ccn_charbuf_putf(b,
-        "</body>"
-        "</html>" NL);
-    return(b);
+        "<div><b>Content items:</b> %llu accessioned,"
+        " %d stored, %lu stale, %d sparse, %lu duplicate, %lu sent,"
+        " %lu uncached, %lu suppressed</div>" NL
+        "<div><b>Interests:</b> %d names,"
+        " %ld pending, %ld propagating, %ld noted</div>" NL
+        "<div><b>Interest totals:</b> %lu accepted,"
+        " %lu dropped, %lu sent, %lu stuffed, %lu suppressed,"
+        " %lu nacked, %lu nacks received</div>" NL,
+        s->accessioned,
+        s->stored,
+        s->stale,
+        s->sparse,
+        s->duplicate,
+        s->sent,
+        s->passed,
+        s->suppressed,
+        s->names, s->stats.total_interest_counts,
+        s->interests - s->stats.total_flood_control,
+        s->stats.total_flood_control,
+        s->interests_accepted, s->interests_dropped,
+        s->interests_sent, s->interests_stuffed,
+        s->interests_suppressed,
+        s->nacks_sent, s->nacks_received);
 }
 
-/* XML formatting */
-
 static void
-collect_meter_xml(struct ccnd_handle *h, struct ccn_charbuf *b, struct ccnd_meter *m)
+status_face_html(struct ccnd_handle *h, struct status_response *r, int i)
 {
-    uintmax_t total;
-    unsigned rate;
-    
-    if (m == NULL)
-        return;
-    total = ccnd_meter_total(m);
-    rate = ccnd_meter_rate(h, m);
-    ccn_charbuf_putf(b, "<%s><total>%ju</total><persec>%u</persec></%s>",
-        m->what, total, rate, m->what);
+    struct status_face *face = &r->snap->faces[i];
+    struct ccn_charbuf *b = r->out;
+
+    ccn_charbuf_putf(b, " <li>");
+    ccn_charbuf_putf(b, "<b>face:</b> %u <b>flags:</b> 0x%x",
+                     face->faceid, face->flags);
+    ccn_charbuf_putf(b, " <b>pending:</b> %d",
+                     face->pending_interests);
+    if (face->recvcount != 0)
+        ccn_charbuf_putf(b, " <b>activity:</b> %d",
+                         face->recvcount);
+    if (face->port > 0) {
+        const char *node = (const char *)r->snap->strings->buf + face->node;
+        int port = face->port;
+        int chk = CCN_FACE_MCAST | CCN_FACE_UNDECIDED |
+        CCN_FACE_NOSEND | CCN_FACE_GG | CCN_FACE_PASSIVE;
+        if ((face->flags & chk) == 0)
+            ccn_charbuf_putf(b,
+                             " <b>remote:</b> "
+                             "<a href='http://%s:%s/'>"
+                             "%s:%d</a>",
+                             node, CCN_DEFAULT_UNICAST_PORT,
+                             node, port);
+        else if ((face->flags & CCN_FACE_PASSIVE) == 0)
+            ccn_charbuf_putf(b, " <b>remote:</b> %s:%d",
+                             node, port);
+        else
+            ccn_charbuf_putf(b, " <b>local:</b> %s:%d",
+                             node, port);
+        if (face->sendface != face->faceid &&
+            face->sendface != CCN_NOFACEID)
+            ccn_charbuf_putf(b, " <b>via:</b> %u", face->sendface);
+    }
+    if ((face->flags & CCN_FACE_MCAST) != 0)
+        ccn_charbuf_putf(b, " <b>pause:</b> %u <b>response:</b> %u",
+                         face->mcast_pause, face->mcast_response);
+    ccn_charbuf_putf(b, "</li>" NL);
 }
 
 static void
-collect_faces_xml(struct ccnd_handle *h, struct ccn_charbuf *b)
+status_face_meter_html(struct ccnd_handle *h, struct status_response *r, int i)
 {
-    int i;
-    int m;
-    int port;
-    struct ccn_charbuf *nodebuf;
-    
-    nodebuf = ccn_charbuf_create();
-    ccn_charbuf_putf(b, "<faces>");
-    for (i = 0; i < h->face_limit; i++) {
-        struct face *face = h->faces_by_faceid[i];
-        if (face != NULL && (face->flags & CCN_FACE_UNDECIDED) == 0) {
-            ccn_charbuf_putf(b, "<face>");
-            ccn_charbuf_putf(b,
-                             "<faceid>%u</faceid>"
-                             "<faceflags>%04x</faceflags>",
-                             face->faceid, face->flags);
-            ccn_charbuf_putf(b, "<pending>%d</pending>",
-                             face->pending_interests);
-            ccn_charbuf_putf(b, "<recvcount>%d</recvcount>",
-                             face->recvcount);
-            nodebuf->length = 0;
-            port = ccn_charbuf_append_sockaddr(nodebuf, face->addr);
-            if (port > 0) {
-                const char *node = ccn_charbuf_as_string(nodebuf);
-                ccn_charbuf_putf(b, "<ip>%s:%d</ip>", node, port);
-            }
-            if (face->sendface != face->faceid &&
-                face->sendface != CCN_NOFACEID)
-                ccn_charbuf_putf(b, "<via>%u</via>", face->sendface);
-            if (face != NULL && (face->flags & CCN_FACE_PASSIVE) == 0) {
-                ccn_charbuf_putf(b, "<meters>");
-                for (m = 0; m < CCND_FACE_METER_N; m++)
-                    collect_meter_xml(h, b, face->meter[m]);
-                ccn_charbuf_putf(b, "</meters>");
-            }
-            ccn_charbuf_putf(b, "</face>" NL);
-        }
-    }
-    ccn_charbuf_putf(b, "</faces>");
-    ccn_charbuf_destroy(&nodebuf);
+    struct status_face *face = &r->snap->faces[i];
+    struct ccn_charbuf *b = r->out;
+
+    if ((face->flags & (CCN_FACE_UNDECIDED|CCN_FACE_PASSIVE)) != 0)
+        return;
+    ccn_charbuf_putf(b, " <tr>");
+    ccn_charbuf_putf(b, "<td><b>face:</b> %u</td>\t",
+                     face->faceid);
+    ccn_charbuf_putf(b, "<td>%6u / %u</td>\t\t",
+                         ccnd_meter_rate(h, &face->meter[FM_BYTI]),
+                         ccnd_meter_rate(h, &face->meter[FM_BYTO]));
+    ccn_charbuf_putf(b, "<td>%9u / %u</td>\t\t",
+                         ccnd_meter_rate(h, &face->meter[FM_DATI]),
+                         ccnd_meter_rate(h, &face->meter[FM_INTO]));
+    ccn_charbuf_putf(b, "<td>%9u / %u</td>",
+                         ccnd_meter_rate(h, &face->meter[FM_DATO]),
+                         ccnd_meter_rate(h, &face->meter[FM_INTI]));
+    ccn_charbuf_putf(b, "</tr>" NL);
 }
 
 static void
-collect_forwarding_xml(struct ccnd_handle *h, struct ccn_charbuf *b)
+status_fentry_html(struct ccnd_handle *h, struct status_response *r, int i)
 {
-    struct hashtb_enumerator ee;
-    struct hashtb_enumerator *e = &ee;
-    struct ccn_forwarding *f;
-    int res;
-    struct ccn_charbuf *name = ccn_charbuf_create();
-    
-    ccn_charbuf_putf(b, "<forwarding>");
-    hashtb_start(h->nameprefix_tab, e);
-    for (; e->data != NULL; hashtb_next(e)) {
-        struct nameprefix_entry *ipe = e->data;
-        for (f = ipe->forwarding, res = 0; f != NULL && !res; f = f->next) {
-            if ((f->flags & (CCN_FORW_ACTIVE | CCN_FORW_PFXO)) != 0)
-                res = 1;
-        }
-        if (res) {
-            ccn_name_init(name);
-            ccn_name_append_components(name, e->key, 0, e->keysize);
-            ccn_charbuf_putf(b, "<fentry>");
-            ccn_charbuf_putf(b, "<prefix>");
-            ccn_uri_append(b, name->buf, name->length, 1);
-            ccn_charbuf_putf(b, "</prefix>");
-            for (f = ipe->forwarding; f != NULL; f = f->next) {
-                if ((f->flags & (CCN_FORW_ACTIVE | CCN_FORW_PFXO)) != 0) {
-                    ccn_charbuf_putf(b,
-                                     "<dest>"
-                                     "<faceid>%u</faceid>"
-                                     "<flags>%x</flags>"
-                                     "<expires>%d</expires>"
-                                     "</dest>",
-                                     f->faceid,
-                                     f->flags & CCN_FORW_PUBMASK,
-                                     f->expires);
-                }
-            }
-            ccn_charbuf_putf(b, "</fentry>");
-        }
+    struct status_fentry *fe = &r->snap->fib[i];
+    struct status_dest *d;
+    int j;
+
+    for (j = 0; j < fe->ndest; j++) {
+        d = &r->snap->dests[fe->dest + j];
+        if (!dest_matches(r, d))
+            continue;
+        ccn_charbuf_putf(r->out, " <li>");
+        append_fentry_uri(r, fe);
+        ccn_charbuf_putf(r->out,
+                         " <b>face:</b> %u"
+                         " <b>flags:</b> 0x%x"
+                         " <b>expires:</b> %d",
+                         d->faceid,
+                         d->flags,
+                         d->expires);
+        ccn_charbuf_putf(r->out, "</li>" NL);
     }
-    hashtb_end(e);
-    ccn_charbuf_destroy(&name);
-    ccn_charbuf_putf(b, "</forwarding>");
 }
 
-static struct ccn_charbuf *
-collect_stats_xml(struct ccnd_handle *h)
+/* XML formatting */
+
+static void
+status_head_xml(struct ccnd_handle *h, struct status_response *r)
 {
-    struct ccnd_stats stats = {0};
-    struct ccn_charbuf *b = ccn_charbuf_create();
+    struct status_snapshot *s = r->snap;
+    struct ccn_charbuf *b = r->out;
     int i;
-        
-    ccnd_collect_stats(h, &stats);
+
     ccn_charbuf_putf(b,
         "<ccnd>"
         "<identity>"
@@ -556,8 +1046,10 @@ collect_stats_xml(struct ccnd_handle *h)
         "</identity>",
         (int)CCN_API_VERSION,
         h->starttime, h->starttime_usec,
-        h->sec,
-        h->usec);
+        s->sec,
+        s->usec);
+    if ((r->views & SV_SUMMARY) == 0)
+        return;
     ccn_charbuf_putf(b,
         "<cobs>"
         "<accessioned>%llu</accessioned>"
@@ -566,6 +1058,8 @@ collect_stats_xml(struct ccnd_handle *h)
         "<sparse>%d</sparse>"
         "<duplicate>%lu</duplicate>"
         "<sent>%lu</sent>"
+        "<uncached>%lu</uncached>"
+        "<suppressed>%lu</suppressed>"
         "</cobs>"
         "<interests>"
         "<names>%d</names>"
@@ -576,22 +1070,338 @@ collect_stats_xml(struct ccnd_handle *h)
         "<dropped>%lu</dropped>"
         "<sent>%lu</sent>"
         "<stuffed>%lu</stuffed>"
+        "<suppressed>%lu</suppressed>"
+        "<nacked>%lu</nacked>"
+        "<nacksreceived>%lu</nacksreceived>"
         "</interests>",
-        (unsigned long long)h->accession,
-        hashtb_n(h->content_tab),
-        h->n_stale,
-        hashtb_n(h->sparse_straggler_tab),
-        h->content_dups_recvd,
-        h->content_items_sent,
-        hashtb_n(h->nameprefix_tab), stats.total_interest_counts,
-        hashtb_n(h->interest_tab) - stats.total_flood_control,
-        stats.total_flood_control,
-        h->interests_accepted, h->interests_dropped,
-        h->interests_sent, h->interests_stuffed);
-    collect_faces_xml(h, b);
-    collect_forwarding_xml(h, b);
-    ccn_charbuf_putf(b, "</ccnd>" NL);
-    return(b);
+        s->accessioned,
+        s->stored,
+        s->stale,
+        s->sparse,
+        s->duplicate,
+        s->sent,
+        s->passed,
+        s->suppressed,
+        s->names, s->stats.total_interest_counts,
+        s->interests - s->stats.total_flood_control,
+        s->stats.total_flood_control,
+        s->interests_accepted, s->interests_dropped,
+        s->interests_sent, s->interests_stuffed,
+        s->interests_suppressed,
+        s->nacks_sent, s->nacks_received);
+}
+
+static void
+collect_meter_xml(struct ccnd_handle *h, struct ccn_charbuf *b, struct ccnd_meter *m)
+{
+    uintmax_t total;
+    unsigned rate;
+
+    if (m == NULL || m->what[0] == 0)
+        return;
+    total = ccnd_meter_total(m);
+    rate = ccnd_meter_rate(h, m);
+    ccn_charbuf_putf(b, "<%s><total>%ju</total><persec>%u</persec></%s>",
+        m->what, total, rate, m->what);
+}
+
+static void
+status_face_xml(struct ccnd_handle *h, struct status_response *r, int i)
+{
+    struct status_face *face = &r->snap->faces[i];
+    struct ccn_charbuf *b = r->out;
+    int m;
+
+    ccn_charbuf_putf(b, "<face>");
+    ccn_charbuf_putf(b,
+                     "<faceid>%u</faceid>"
+                     "<faceflags>%04x</faceflags>",
+                     face->faceid, face->flags);
+    ccn_charbuf_putf(b, "<pending>%d</pending>",
+                     face->pending_interests);
+    ccn_charbuf_putf(b, "<recvcount>%d</recvcount>",
+                     face->recvcount);
+    if (face->port > 0)
+        ccn_charbuf_putf(b, "<ip>%s:%d</ip>",
+                         r->snap->strings->buf + face->node, face->port);
+    if (face->sendface != face->faceid &&
+        face->sendface != CCN_NOFACEID)
+        ccn_charbuf_putf(b, "<via>%u</via>", face->sendface);
+    if ((face->flags & CCN_FACE_MCAST) != 0)
+        ccn_charbuf_putf(b, "<pause>%u</pause><response>%u</response>",
+                         face->mcast_pause, face->mcast_response);
+    if ((face->flags & CCN_FACE_PASSIVE) == 0) {
+        ccn_charbuf_putf(b, "<meters>");
+        for (m = 0; m < face->nmeter; m++)
+            collect_meter_xml(h, b, &face->meter[m]);
+        ccn_charbuf_putf(b, "</meters>");
+    }
+    ccn_charbuf_putf(b, "</face>" NL);
+}
+
+static void
+status_fentry_xml(struct ccnd_handle *h, struct status_response *r, int i)
+{
+    struct status_fentry *fe = &r->snap->fib[i];
+    struct status_dest *d;
+    int j;
+
+    ccn_charbuf_putf(r->out, "<fentry>");
+    ccn_charbuf_putf(r->out, "<prefix>");
+    append_fentry_uri(r, fe);
+    ccn_charbuf_putf(r->out, "</prefix>");
+    for (j = 0; j < fe->ndest; j++) {
+        d = &r->snap->dests[fe->dest + j];
+        if (!dest_matches(r, d))
+            continue;
+        ccn_charbuf_putf(r->out,
+                         "<dest>"
+                         "<faceid>%u</faceid>"
+                         "<flags>%x</flags>"
+                         "<expires>%d</expires>"
+                         "</dest>",
+                         d->faceid,
+                         d->flags,
+                         d->expires);
+    }
+    ccn_charbuf_putf(r->out, "</fentry>");
+}
+
+/* Lists */
+
+static void
+status_list_open(struct status_response *r)
+{
+    struct ccn_charbuf *b = r->out;
+
+    switch (r->phase) {
+        case SP_FACES:
+            if (r->xml)
+                ccn_charbuf_putf(b, "<faces>");
+            else {
+                ccn_charbuf_putf(b, "<h4>Faces</h4>" NL);
+                ccn_charbuf_putf(b, "<ul>");
+            }
+            break;
+        case SP_METERS:
+            ccn_charbuf_putf(b, "<h4>Face Activity Rates</h4>");
+            ccn_charbuf_putf(b, "<table cellspacing='0' cellpadding='0' class='tbl' summary='face activity rates'>");
+            ccn_charbuf_putf(b, "<tbody>" NL);
+            ccn_charbuf_putf(b, " <tr><td>        </td>\t"
+                                " <td>Bytes/sec In/Out</td>\t"
+                                " <td>recv data/intr sent</td>\t"
+                                " <td>sent data/intr recv</td></tr>" NL);
+            break;
+        case SP_FIB:
+            if (r->xml)
+                ccn_charbuf_putf(b, "<forwarding>");
+            else {
+                ccn_charbuf_putf(b, "<h4>Forwarding</h4>" NL);
+                ccn_charbuf_putf(b, "<ul>");
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Say where this page is in the list, with links to the neighbors.
+ */
+static void
+status_list_pager(struct status_response *r)
+{
+    struct ccn_charbuf *b = r->out;
+    int first = (r->page - 1) * r->per_page;
+
+    if (r->xml) {
+        ccn_charbuf_putf(b, "<page number='%d' size='%d' total='%d'/>",
+                         r->page, r->per_page, r->matched);
+        return;
+    }
+    if (first < r->matched)
+        ccn_charbuf_putf(b, "<p>%d to %d of %d", first + 1,
+                         r->matched - first < r->per_page ?
+                         r->matched : first + r->per_page, r->matched);
+    else
+        ccn_charbuf_putf(b, "<p>none of %d", r->matched);
+    if (r->page > 1)
+        ccn_charbuf_putf(b, " <a href='/?%sp=%d'>previous</a>",
+                         ccn_charbuf_as_string(r->query), r->page - 1);
+    if (first + r->per_page < r->matched)
+        ccn_charbuf_putf(b, " <a href='/?%sp=%d'>next</a>",
+                         ccn_charbuf_as_string(r->query), r->page + 1);
+    ccn_charbuf_putf(b, "</p>" NL);
+}
+
+static void
+status_list_close(struct status_response *r)
+{
+    struct ccn_charbuf *b = r->out;
+
+    if (r->xml && r->per_page > 0)
+        status_list_pager(r);
+    switch (r->phase) {
+        case SP_FACES:
+            ccn_charbuf_putf(b, r->xml ? "</faces>" : "</ul>");
+            break;
+        case SP_METERS:
+            ccn_charbuf_putf(b, "</tbody>");
+            ccn_charbuf_putf(b, "</table>");
+            return;
+        case SP_FIB:
+            ccn_charbuf_putf(b, r->xml ? "</forwarding>" : "</ul>");
+            break;
+        default:
+            break;
+    }
+    if (!r->xml && r->per_page > 0)
+        status_list_pager(r);
+}
+
+/**
+ * Work on the current list, looking at no more than *budget entries.
+ *
+ * match is NULL if there is no filtering, which lets us go straight
+ * to the requested page.
+ * @returns 1 when the list is finished, else 0.
+ */
+static int
+status_list(struct ccnd_handle *h, struct status_response *r, int n,
+            int (*match)(struct status_response *, int),
+            void (*emit)(struct ccnd_handle *, struct status_response *, int),
+            int *budget)
+{
+    int first = 0;
+    int last = INT_MAX;
+
+    if (r->per_page > 0) {
+        first = (r->page - 1) * r->per_page;
+        last = (first > INT_MAX - r->per_page) ? INT_MAX : first + r->per_page;
+    }
+    if (!r->started) {
+        status_list_open(r);
+        r->started = 1;
+        if (match == NULL)
+            r->i = r->matched = (first < n) ? first : n;
+    }
+    for (; r->i < n && *budget > 0; r->i++, (*budget)--) {
+        if (match == NULL && r->matched >= last) {
+            r->i = r->matched = n;
+            break;
+        }
+        if (match != NULL && !match(r, r->i))
+            continue;
+        if (r->matched >= first && r->matched < last)
+            emit(h, r, r->i);
+        r->matched++;
+    }
+    if (r->i < n)
+        return(0);
+    status_list_close(r);
+    r->i = r->matched = r->started = 0;
+    return(1);
+}
+
+/**
+ * Produce the next part of the document.
+ */
+static void
+status_step(struct ccnd_handle *h, struct status_response *r, int *budget)
+{
+    struct status_snapshot *s = r->snap;
+    int faces_filtered = (r->face_filter != CCN_NOFACEID);
+    int fib_filtered = (faces_filtered || r->prefix != NULL);
+
+    switch (r->phase) {
+        case SP_HEAD:
+            if (r->xml)
+                status_head_xml(h, r);
+            else
+                status_head_html(h, r);
+            r->phase = SP_FACES;
+            break;
+        case SP_FACES:
+            if ((r->views & SV_FACES) == 0)
+                r->phase = SP_FIB;
+            else if (status_list(h, r, s->nface,
+                                 faces_filtered ? &face_matches : NULL,
+                                 r->xml ? &status_face_xml : &status_face_html,
+                                 budget))
+                r->phase = r->xml ? SP_FIB : SP_METERS;
+            break;
+        case SP_METERS:
+            if (status_list(h, r, s->nface,
+                            faces_filtered ? &face_matches : NULL,
+                            &status_face_meter_html, budget))
+                r->phase = SP_FIB;
+            break;
+        case SP_FIB:
+            if ((r->views & SV_FIB) == 0)
+                r->phase = SP_TAIL;
+            else if (status_list(h, r, s->nfib,
+                                 fib_filtered ? &fentry_matches : NULL,
+                                 r->xml ? &status_fentry_xml : &status_fentry_html,
+                                 budget))
+                r->phase = SP_TAIL;
+            break;
+        case SP_TAIL:
+            if (r->xml)
+                ccn_charbuf_putf(r->out, "</ccnd>" NL);
+            else
+                ccn_charbuf_putf(r->out,
+                    "</body>"
+                    "</html>" NL);
+            r->phase = SP_DONE;
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * Scheduled event that sends the next batch of a status document.
+ *
+ * Each turn looks at no more than STATUS_BATCH list entries, and then
+ * yields for STATUS_PAUSE_USEC so that forwarding is not held up by a
+ * large document.  Nothing is produced while the client is not keeping up.
+ */
+static int
+status_turn(struct ccn_schedule *sched,
+            void *clienth,
+            struct ccn_scheduled_event *ev,
+            int flags)
+{
+    struct ccnd_handle *h = clienth;
+    struct status_response *r = ev->evdata;
+    struct face *face;
+    int budget = STATUS_BATCH;
+
+    if ((flags & CCN_SCHEDULE_CANCEL) != 0) {
+        status_response_destroy(h, &r);
+        return(0);
+    }
+    face = ccnd_face_from_faceid(h, r->faceid);
+    if (face == NULL || (face->flags & CCN_FACE_NOSEND) != 0) {
+        /* The client has gone away */
+        if (face != NULL)
+            face->flags |= CCN_FACE_CLOSING;
+        status_response_destroy(h, &r);
+        return(0);
+    }
+    if (face->outbuf != NULL &&
+        face->outbuf->length - face->outbufindex > STATUS_OUTBUF_LIMIT)
+        return(STATUS_PAUSE_USEC);
+    r->out->length = 0;
+    while (budget > 0 && r->phase != SP_DONE)
+        status_step(h, r, &budget);
+    ccnd_send(h, face, r->out->buf, r->out->length);
+    if (r->phase == SP_DONE) {
+        face->flags |= (CCN_FACE_NOSEND | CCN_FACE_CLOSING);
+        status_response_destroy(h, &r);
+        return(0);
+    }
+    return(STATUS_PAUSE_USEC);
 }
 
 /**
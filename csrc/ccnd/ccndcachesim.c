@@ -0,0 +1,564 @@
+/**
+ * @file ccndcachesim.c
+ *
+ * Trace-driven simulation of the ccnd content store.
+ *
+ * Starts a private ccnd for each admission policy to be compared, and
+ * plays the same request trace through it from a consumer, with a
+ * producer behind it that answers whatever reaches it.  Requests go
+ * one at a time, so each is either a hit in the ccnd content store or a
+ * miss that the producer sees.
+ *
+ * The trace is a file of ccnx URIs, one request to a line, or is made
+ * up: blocks of requests for a set of popular names, chosen with a Zipf
+ * distribution, mixed with blocks that scan through names that are
+ * never asked for again, as a bulk transfer would.
+ *
+ * For each policy, prints the hit ratio and the CPU time that ccnd
+ * used, per request and per packet that it handled, as a single line
+ * of name=value pairs.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+#include <ccn/uri.h>
+
+#define BLOCK 256               /**< requests in each block of the made-up trace */
+#define REQUEST_TIMEOUT 2.0     /**< seconds to wait for each answer */
+
+struct sim {
+    const char *ccnd_prog;
+    const char *label;
+    struct ccn_charbuf *workdir;
+    pid_t ccnd_pid;
+    int capacity;
+    int size;                       /**< payload bytes per object */
+    /* the trace */
+    struct ccn_charbuf *names;      /**< ccnb Names, one after another */
+    struct ccn_indexbuf *ends;      /**< end of each in names */
+    /* per-run state */
+    struct ccn *consumer;
+    struct ccn *producer;
+    struct ccn_closure serve;
+    struct ccn_closure fetched;
+    int misses;
+    int done;
+    int errors;
+};
+
+static double
+now_secs(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-h] [-a policies] [-c capacity] [-f trace] [-n requests]"
+            " [-u names] [-z alpha] [-b percent] [-s size] [-l label]"
+            " [-d ccnd]\n"
+            " Replay a request trace through a private ccnd, once for each"
+            " content store admission policy, and report the hit ratio and"
+            " ccnd CPU time.\n"
+            "  -a policies - comma-separated CCND_CS_ADMIT values"
+            " (default all,prob:10,second)\n"
+            "  -c capacity - CCND_CAP for ccnd (default 1000)\n"
+            "  -f trace - file of ccnx URIs, one request to a line;"
+            " otherwise the trace is made up:\n"
+            "  -n requests - number of requests (default 20000)\n"
+            "  -u names - number of popular names (default 5000)\n"
+            "  -z alpha - Zipf exponent for the popular names (default 0.9)\n"
+            "  -b percent - requests that are part of one-shot scans"
+            " (default 50)\n"
+            "  -s size - payload bytes per object (default 1024)\n"
+            "  -l label - included in every result line\n"
+            "  -d ccnd - the program to run (default from PATH)\n"
+            " CCND_CS_NOCACHE and CCND_CS_MAXSIZE are passed on to ccnd.\n",
+            progname);
+    exit(1);
+}
+
+/**
+ * Read a trace of ccnx URIs, skipping blank lines and # comments.
+ */
+static int
+read_trace(struct sim *s, const char *path)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    char line[4096];
+    FILE *f;
+    size_t n;
+    int res = 0;
+
+    f = fopen(path, "r");
+    if (f == NULL) {
+        perror(path);
+        return(-1);
+    }
+    while (fgets(line, sizeof(line), f) != NULL) {
+        n = strcspn(line, "\r\n");
+        line[n] = 0;
+        if (n == 0 || line[0] == '#')
+            continue;
+        ccn_charbuf_reset(name);
+        if (ccn_name_from_uri(name, line) < 0) {
+            fprintf(stderr, "%s: not a ccnx URI: %s\n", path, line);
+            res = -1;
+            break;
+        }
+        ccn_charbuf_append_charbuf(s->names, name);
+        ccn_indexbuf_append_element(s->ends, s->names->length);
+    }
+    fclose(f);
+    ccn_charbuf_destroy(&name);
+    return(res);
+}
+
+/**
+ * Make up a trace.
+ *
+ * Each block of BLOCK requests is either a scan of new names (with the
+ * given probability) or a run of popular names.  The seed is fixed, so
+ * every policy sees the same trace.
+ */
+static void
+make_trace(struct sim *s, int nreq, int nnames, double alpha, int bulk)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    double *cdf = calloc(nnames, sizeof(cdf[0]));
+    double sum = 0;
+    double x;
+    int scan = 0;
+    int lo, hi, mid;
+    int i, k;
+
+    for (k = 0; k < nnames; k++)
+        cdf[k] = (sum += 1.0 / pow(k + 1, alpha));
+    srand48(1);
+    for (i = 0; i < nreq; i++) {
+        if (i % BLOCK == 0)
+            scan = (lrand48() % 100) < bulk;
+        ccn_name_from_uri(name, "ccnx:/ccndcachesim");
+        if (scan) {
+            ccn_name_append_str(name, "bulk");
+            ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i);
+        }
+        else {
+            x = drand48() * sum;
+            for (lo = 0, hi = nnames - 1; lo < hi;) {
+                mid = (lo + hi) / 2;
+                if (cdf[mid] < x)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            ccn_name_append_str(name, "hot");
+            ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, lo);
+        }
+        ccn_charbuf_append_charbuf(s->names, name);
+        ccn_indexbuf_append_element(s->ends, s->names->length);
+    }
+    free(cdf);
+    ccn_charbuf_destroy(&name);
+}
+
+/**
+ * Remove a directory and everything in it.
+ */
+static int
+rm_tree(const char *path)
+{
+    struct ccn_charbuf *sub = ccn_charbuf_create();
+    struct dirent *de;
+    struct stat st;
+    DIR *d;
+    int res = 0;
+
+    d = opendir(path);
+    if (d == NULL)
+        res = -1;
+    while (d != NULL && (de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        ccn_charbuf_reset(sub);
+        ccn_charbuf_putf(sub, "%s/%s", path, de->d_name);
+        if (lstat(ccn_charbuf_as_string(sub), &st) == 0 && S_ISDIR(st.st_mode))
+            res |= rm_tree(ccn_charbuf_as_string(sub));
+        else
+            res |= unlink(ccn_charbuf_as_string(sub));
+    }
+    if (d != NULL) {
+        closedir(d);
+        res |= rmdir(path);
+    }
+    ccn_charbuf_destroy(&sub);
+    return(res);
+}
+
+/**
+ * Start ccnd with the given policy, logging to the work directory.
+ */
+static int
+start_ccnd(struct sim *s, const char *policy)
+{
+    struct ccn_charbuf *log = ccn_charbuf_create();
+    char cap[20];
+    int fd;
+
+    snprintf(cap, sizeof(cap), "%d", s->capacity);
+    ccn_charbuf_putf(log, "%s/ccnd.log", ccn_charbuf_as_string(s->workdir));
+    fflush(stdout);
+    s->ccnd_pid = fork();
+    if (s->ccnd_pid == 0) {
+        setenv("CCND_DEBUG", "1", 1);
+        setenv("CCND_CAP", cap, 1);
+        setenv("CCND_CS_ADMIT", policy, 1);
+        fd = open(ccn_charbuf_as_string(log), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            dup2(fd, 1);
+            dup2(fd, 2);
+            close(fd);
+        }
+        execlp(s->ccnd_prog, s->ccnd_prog, (char *)NULL);
+        perror(s->ccnd_prog);
+        _exit(127);
+    }
+    ccn_charbuf_destroy(&log);
+    if (s->ccnd_pid == -1) {
+        perror("fork");
+        s->ccnd_pid = 0;
+        return(-1);
+    }
+    return(0);
+}
+
+static void
+stop_ccnd(struct sim *s)
+{
+    if (s->ccnd_pid <= 0)
+        return;
+    kill(s->ccnd_pid, SIGTERM);
+    waitpid(s->ccnd_pid, NULL, 0);
+    s->ccnd_pid = 0;
+}
+
+/**
+ * @returns the CPU seconds used so far by ccnd, or -1 if that is not known.
+ */
+static double
+ccnd_cpu(struct sim *s)
+{
+    char path[40];
+    char buf[1024];
+    unsigned long utime, stime;
+    const char *p;
+    FILE *f;
+    size_t n;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)s->ccnd_pid);
+    f = fopen(path, "r");
+    if (f == NULL)
+        return(-1);
+    n = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    buf[n] = 0;
+    /* Fields 14 and 15, counting from the pid; the name may hold spaces */
+    p = strrchr(buf, ')');
+    if (p == NULL || sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u"
+                            " %lu %lu", &utime, &stime) != 2)
+        return(-1);
+    return((double)(utime + stime) / sysconf(_SC_CLK_TCK));
+}
+
+/**
+ * The producer answers everything that gets past the content store.
+ */
+static enum ccn_upcall_res
+serve_content(struct ccn_closure *selfp,
+              enum ccn_upcall_kind kind,
+              struct ccn_upcall_info *info)
+{
+    struct sim *s = selfp->data;
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_charbuf *name = NULL;
+    struct ccn_charbuf *co = NULL;
+    char *payload = NULL;
+    int res;
+
+    if (kind != CCN_UPCALL_INTEREST)
+        return(CCN_UPCALL_RESULT_OK);
+    name = ccn_charbuf_create();
+    co = ccn_charbuf_create();
+    payload = calloc(1, s->size + 1);
+    ccn_charbuf_append(name, info->interest_ccnb + info->pi->offset[CCN_PI_B_Name],
+                       info->pi->offset[CCN_PI_E_Name] -
+                       info->pi->offset[CCN_PI_B_Name]);
+    res = ccn_sign_content(info->h, co, name, &sp, payload, s->size);
+    if (res >= 0)
+        res = ccn_put(info->h, co->buf, co->length);
+    if (res >= 0)
+        s->misses++;
+    free(payload);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&co);
+    return(res < 0 ? CCN_UPCALL_RESULT_ERR : CCN_UPCALL_RESULT_INTEREST_CONSUMED);
+}
+
+static enum ccn_upcall_res
+fetched_content(struct ccn_closure *selfp,
+                enum ccn_upcall_kind kind,
+                struct ccn_upcall_info *info)
+{
+    struct sim *s = selfp->data;
+
+    if (kind == CCN_UPCALL_CONTENT || kind == CCN_UPCALL_CONTENT_RAW ||
+          kind == CCN_UPCALL_CONTENT_UNVERIFIED)
+        s->done = 1;
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Run both handles until the current request is answered or times out.
+ */
+static int
+wait_for_answer(struct sim *s)
+{
+    struct pollfd fds[2];
+    double deadline = now_secs() + REQUEST_TIMEOUT;
+
+    while (!s->done && now_secs() < deadline) {
+        fds[0].fd = ccn_get_connection_fd(s->consumer);
+        fds[1].fd = ccn_get_connection_fd(s->producer);
+        fds[0].events = fds[1].events = POLLIN;
+        poll(fds, 2, 10);
+        if (ccn_run(s->producer, 0) < 0 || ccn_run(s->consumer, 0) < 0)
+            return(-1);
+    }
+    return(s->done ? 0 : -1);
+}
+
+static int
+connect_handles(struct sim *s)
+{
+    struct ccn_charbuf *root = ccn_charbuf_create();
+    int i;
+
+    s->consumer = ccn_create();
+    s->producer = ccn_create();
+    for (i = 0; i < 1000; i++) {
+        if (ccn_connect(s->consumer, NULL) >= 0)
+            break;
+        ccn_disconnect(s->consumer);
+        usleep(10000);
+    }
+    if (i == 1000 || ccn_connect(s->producer, NULL) < 0) {
+        fprintf(stderr, "ccnd did not start; see %s/ccnd.log\n",
+                ccn_charbuf_as_string(s->workdir));
+        ccn_charbuf_destroy(&root);
+        return(-1);
+    }
+    ccn_defer_verification(s->consumer, 1);
+    ccn_name_init(root);
+    ccn_set_interest_filter(s->producer, root, &s->serve);
+    ccn_charbuf_destroy(&root);
+    /* Let the registration finish */
+    for (i = 0; i < 20; i++) {
+        ccn_run(s->producer, 10);
+        ccn_run(s->consumer, 0);
+    }
+    return(0);
+}
+
+/**
+ * Play the trace through a ccnd with the given policy, and report.
+ */
+static int
+run_policy(struct sim *s, const char *policy)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    double cpu0, cpu1, t0, t1;
+    int nreq = s->ends->n;
+    int start;
+    int failed = 0;
+    int packets;
+    int i;
+
+    s->misses = 0;
+    if (start_ccnd(s, policy) < 0 || connect_handles(s) < 0)
+        failed = nreq;
+    cpu0 = ccnd_cpu(s);
+    t0 = now_secs();
+    for (i = 0; i < nreq && failed < nreq; i++) {
+        start = i == 0 ? 0 : s->ends->buf[i - 1];
+        ccn_charbuf_reset(name);
+        ccn_charbuf_append(name, s->names->buf + start, s->ends->buf[i] - start);
+        s->done = 0;
+        if (ccn_express_interest(s->consumer, name, &s->fetched, NULL) < 0 ||
+              wait_for_answer(s) < 0)
+            failed++;
+    }
+    t1 = now_secs();
+    cpu1 = ccnd_cpu(s);
+    printf("policy=%s", policy);
+    if (s->label != NULL)
+        printf(" label=%s", s->label);
+    printf(" capacity=%d requests=%d misses=%d failed=%d hit_ratio=%.4f"
+           " ms=%.0f", s->capacity, nreq, s->misses, failed,
+           nreq > 0 ? 1.0 - (double)(s->misses + failed) / nreq : 0,
+           (t1 - t0) * 1000);
+    /* Each request is an interest in and content out; a miss doubles that */
+    packets = 2 * (nreq + s->misses);
+    if (cpu0 >= 0 && cpu1 >= 0 && nreq > 0)
+        printf(" ccnd_cpu_ms=%.0f us_per_request=%.1f us_per_packet=%.1f",
+               (cpu1 - cpu0) * 1000, (cpu1 - cpu0) * 1e6 / nreq,
+               (cpu1 - cpu0) * 1e6 / packets);
+    printf("\n");
+    fflush(stdout);
+    ccn_destroy(&s->consumer);
+    ccn_destroy(&s->producer);
+    stop_ccnd(s);
+    ccn_charbuf_destroy(&name);
+    return(failed == 0 ? 0 : -1);
+}
+
+/**
+ * Pick a port no ccnd is using.
+ */
+static void
+choose_port(void)
+{
+    struct ccn *h = ccn_create();
+    char port[12];
+    int res;
+    int i;
+
+    if (getenv("CCN_LOCAL_PORT") == NULL) {
+        for (i = 0; i < 100; i++) {
+            snprintf(port, sizeof(port), "%d", 9800 + (getpid() + i) % 1000);
+            setenv("CCN_LOCAL_PORT", port, 1);
+            res = ccn_connect(h, NULL);
+            ccn_disconnect(h);
+            if (res < 0)
+                break;
+        }
+    }
+    ccn_destroy(&h);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct sim sim = {0};
+    struct sim *s = &sim;
+    char dir[] = "/tmp/ccndcachesimXXXXXX";
+    const char *policies = "all,prob:10,second";
+    const char *trace = NULL;
+    char *list = NULL;
+    char *policy = NULL;
+    char *next = NULL;
+    int nreq = 20000;
+    int nnames = 5000;
+    double alpha = 0.9;
+    int bulk = 50;
+    int opt;
+
+    s->ccnd_prog = "ccnd";
+    s->capacity = 1000;
+    s->size = 1024;
+    while ((opt = getopt(argc, argv, "ha:c:f:n:u:z:b:s:l:d:")) != -1) {
+        switch (opt) {
+            case 'a': policies = optarg; break;
+            case 'c': s->capacity = atoi(optarg); break;
+            case 'f': trace = optarg; break;
+            case 'n': nreq = atoi(optarg); break;
+            case 'u': nnames = atoi(optarg); break;
+            case 'z': alpha = atof(optarg); break;
+            case 'b': bulk = atoi(optarg); break;
+            case 's': s->size = atoi(optarg); break;
+            case 'l': s->label = optarg; break;
+            case 'd': s->ccnd_prog = optarg; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (s->capacity <= 0 || nreq <= 0 || nnames <= 0 || alpha < 0 ||
+          bulk < 0 || bulk > 100 || s->size < 0 || s->size > 8000)
+        usage(argv[0]);
+    s->names = ccn_charbuf_create();
+    s->ends = ccn_indexbuf_create();
+    if (trace != NULL) {
+        if (read_trace(s, trace) < 0)
+            exit(1);
+    }
+    else
+        make_trace(s, nreq, nnames, alpha, bulk);
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    s->workdir = ccn_charbuf_create();
+    ccn_charbuf_putf(s->workdir, "%s", dir);
+    /* Keep our keys, and those of ccnd, out of the user's own */
+    setenv("CCNX_DIR", dir, 1);
+    setenv("CCND_KEYSTORE_DIRECTORY", dir, 1);
+    setenv("CCNX_SIGNAGENT_SOCK", "", 1);
+    unsetenv("CCN_LOCAL_SOCKNAME");
+    choose_port();
+    signal(SIGPIPE, SIG_IGN);
+    s->serve.p = &serve_content;
+    s->serve.data = s;
+    s->fetched.p = &fetched_content;
+    s->fetched.data = s;
+    list = strdup(policies);
+    for (policy = list; policy != NULL; policy = next) {
+        next = strchr(policy, ',');
+        if (next != NULL)
+            *next++ = 0;
+        if (policy[0] != 0 && run_policy(s, policy) < 0)
+            s->errors++;
+    }
+    free(list);
+    if (s->errors != 0)
+        fprintf(stderr, "logs left in %s\n", dir);
+    else
+        rm_tree(dir);
+    ccn_charbuf_destroy(&s->names);
+    ccn_charbuf_destroy(&s->workdir);
+    ccn_indexbuf_destroy(&s->ends);
+    return(s->errors == 0 ? 0 : 1);
+}
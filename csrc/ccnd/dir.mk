@@ -16,12 +16,14 @@ LDLIBS = -L$(CCNLIBDIR) $(MORE_LDLIBS) -lccn
 CCNLIBDIR = ../lib
 
 INSTALLED_PROGRAMS = ccnd ccndsmoketest 
-PROGRAMS = $(INSTALLED_PROGRAMS)
+PROGRAMS = $(INSTALLED_PROGRAMS) ccndcachesim schedbenchtest
 DEBRIS = anything.ccnb contentobjecthash.ccnb contentmishash.ccnb \
          contenthash.ccnb
 
 BROKEN_PROGRAMS = 
-CSRC = ccnd_main.c ccnd.c ccnd_msg.c ccnd_stats.c ccnd_internal_client.c ccndsmoketest.c
+CSRC = ccnd_main.c ccnd.c ccnd_msg.c ccnd_stats.c ccnd_internal_client.c \
+       ccnd_admission.c ccnd_expiry.c ccndsmoketest.c ccndcachesim.c \
+       schedbenchtest.c
 HSRC = ccnd_private.h
 SCRIPTSRC = testbasics fortunes.ccnb contentobjecthash.ref anything.ref \
             minsuffix.ref
@@ -32,7 +34,8 @@ all: default $(BROKEN_PROGRAMS)
 
 $(PROGRAMS): $(CCNLIBDIR)/libccn.a
 
-CCND_OBJ = ccnd_main.o ccnd.o ccnd_msg.o ccnd_stats.o ccnd_internal_client.o
+CCND_OBJ = ccnd_main.o ccnd.o ccnd_msg.o ccnd_stats.o ccnd_internal_client.o \
+           ccnd_admission.o ccnd_expiry.o
 ccnd: $(CCND_OBJ) ccnd_built.sh
 	$(CC) $(CFLAGS) -o $@ $(CCND_OBJ) $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 	sh ./ccnd_built.sh
@@ -43,12 +46,19 @@ ccnd_built.sh:
 ccndsmoketest: ccndsmoketest.o
 	$(CC) $(CFLAGS) -o $@ ccndsmoketest.o $(LDLIBS)
 
+ccndcachesim: ccndcachesim.o
+	$(CC) $(CFLAGS) -o $@ ccndcachesim.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto -lm
+
+schedbenchtest: schedbenchtest.o ccnd_expiry.o
+	$(CC) $(CFLAGS) -o $@ schedbenchtest.o ccnd_expiry.o $(LDLIBS)
+
 clean:
 	rm -f *.o *.a $(PROGRAMS) $(BROKEN_PROGRAMS) depend
 	rm -rf *.dSYM $(DEBRIS)
 
-check test: ccnd ccndsmoketest $(SCRIPTSRC)
+check test: ccnd ccndsmoketest schedbenchtest $(SCRIPTSRC)
 	./testbasics
+	./schedbenchtest 100000
 	: ---------------------- :
 	:  ccnd unit tests pass  :
 	: ---------------------- :
@@ -87,3 +97,20 @@ ccnd_internal_client.o: ccnd_internal_client.c ../include/ccn/ccn.h \
   ../include/ccn/reg_mgmt.h ../include/ccn/seqwriter.h
 ccndsmoketest.o: ccndsmoketest.c ../include/ccn/ccnd.h \
   ../include/ccn/ccn_private.h
+ccnd_admission.o: ccnd_admission.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/uri.h ccnd_private.h \
+  ../include/ccn/ccn_private.h \
+  ../include/ccn/reg_mgmt.h ../include/ccn/schedule.h \
+  ../include/ccn/seqwriter.h
+ccndcachesim.o: ccndcachesim.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/uri.h
+ccnd_expiry.o: ccnd_expiry.c ../include/ccn/indexbuf.h \
+  ../include/ccn/schedule.h ccnd_private.h ../include/ccn/ccn_private.h \
+  ../include/ccn/coding.h ../include/ccn/reg_mgmt.h \
+  ../include/ccn/charbuf.h ../include/ccn/seqwriter.h
+schedbenchtest.o: schedbenchtest.c ../include/ccn/schedule.h \
+  ccnd_private.h ../include/ccn/ccn_private.h ../include/ccn/coding.h \
+  ../include/ccn/reg_mgmt.h ../include/ccn/charbuf.h \
+  ../include/ccn/seqwriter.h
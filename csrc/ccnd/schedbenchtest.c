@@ -0,0 +1,203 @@
+/**
+ * @file schedbenchtest.c
+ *
+ * A simple test program to benchmark content expiry scheduling.
+ *
+ * Compares one scheduled event per content object with the batched
+ * expiry used by ccnd (see ccnd_expiry.c), in which accessions are
+ * hashed into per-time-slot lists swept by a single event.  The wheel
+ * is ccnd's own, driven by a virtual clock, so only the scheduling cost
+ * is measured.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <ccn/schedule.h>
+
+#include "ccnd_private.h"
+
+#define COUNT 2000000
+#define PER_MILLISECOND 1000
+#define MAX_FRESHNESS 4
+
+struct bench {
+    unsigned long long now;         /* virtual microseconds */
+    unsigned long pending;          /* objects not yet expired */
+    unsigned long expired;
+    unsigned long events;           /* scheduled events outstanding */
+    unsigned long max_events;
+    unsigned char *stale;           /* per-object stale flags */
+    struct ccnd_expiry *wheel;
+};
+
+static void
+gettime(const struct ccn_gettime *self, struct ccn_timeval *result)
+{
+    struct bench *b = self->data;
+    result->s = b->now / 1000000;
+    result->micros = b->now % 1000000;
+}
+
+static void
+note_event(struct bench *b, int delta)
+{
+    b->events += delta;
+    if (b->events > b->max_events)
+        b->max_events = b->events;
+}
+
+static unsigned long long
+clock_now(void *data)
+{
+    struct bench *b = data;
+    return(b->now);
+}
+
+static void
+expire_one(void *data, ccn_accession_t accession)
+{
+    struct bench *b = data;
+
+    b->stale[accession] = 1;
+    b->expired++;
+    b->pending--;
+}
+
+/* One event per object */
+static int
+expire_event(struct ccn_schedule *sched, void *clienth,
+             struct ccn_scheduled_event *ev, int flags)
+{
+    struct bench *b = clienth;
+    note_event(b, -1);
+    if ((flags & CCN_SCHEDULE_CANCEL) != 0)
+        return(0);
+    expire_one(b, ev->evint);
+    return(0);
+}
+
+static void
+run(const char *label, int batched, int count)
+{
+    struct bench bb = {0};
+    struct bench *b = &bb;
+    struct ccn_gettime ticktock = {"virtual", &gettime, 1000000, b};
+    struct ccn_schedule *sched;
+    clock_t t0, t1;
+    int i, k;
+
+    b->stale = calloc(count, 1);
+    b->now = 1000000;
+    sched = ccn_schedule_create(b, &ticktock);
+    if (batched) {
+        b->wheel = ccnd_expiry_create(sched, &clock_now, &expire_one, b);
+        /* The wheel's one sweeping event */
+        note_event(b, 1);
+    }
+    srandom(1);
+    t0 = clock();
+    for (i = 0; i < count;) {
+        for (k = 0; k < PER_MILLISECOND && i < count; k++, i++) {
+            int microseconds = 1000000 * (1 + random() % MAX_FRESHNESS);
+            b->pending++;
+            if (batched)
+                ccnd_expiry_schedule(b->wheel, i, microseconds);
+            else {
+                ccn_schedule_event(sched, microseconds, &expire_event, NULL, i);
+                note_event(b, 1);
+            }
+        }
+        b->now += 1000;
+        ccn_schedule_run(sched);
+    }
+    while (b->pending > 0) {
+        b->now += 1000;
+        ccn_schedule_run(sched);
+    }
+    t1 = clock();
+    for (i = 0; i < count; i++)
+        if (!b->stale[i])
+            break;
+    printf("%-8s %d objects, %lu expired%s, peak events %lu, "
+           "%.3f s cpu, %.1f ns per expired object\n",
+           label, count, b->expired, (i == count) ? "" : " (MISSED SOME)",
+           b->max_events,
+           (double)(t1 - t0) / CLOCKS_PER_SEC,
+           1.0e9 * (t1 - t0) / CLOCKS_PER_SEC / (b->expired ? b->expired : 1));
+    ccnd_expiry_destroy(&b->wheel);
+    ccn_schedule_destroy(&sched);
+    free(b->stale);
+}
+
+/*
+ * An entry scheduled when it is already due, into a slot the wheel
+ * has swept, must go out with the next sweep, not a turn later.
+ */
+static int
+check_past_due(void)
+{
+    struct bench bb = {0};
+    struct bench *b = &bb;
+    struct ccn_gettime ticktock = {"virtual", &gettime, 1000000, b};
+    struct ccn_schedule *sched;
+    int res = 0;
+
+    b->stale = calloc(2, 1);
+    b->now = 1000000;
+    sched = ccn_schedule_create(b, &ticktock);
+    b->wheel = ccnd_expiry_create(sched, &clock_now, &expire_one, b);
+    /* This one keeps the wheel turning */
+    ccnd_expiry_schedule(b->wheel, 0, 10 * CCND_EXPIRY_SLOT_USEC);
+    b->pending++;
+    while (b->now < 1000000 + 5 * CCND_EXPIRY_SLOT_USEC / 2) {
+        b->now += 1000;
+        ccn_schedule_run(sched);
+    }
+    ccnd_expiry_schedule(b->wheel, 1, -CCND_EXPIRY_SLOT_USEC);
+    b->pending++;
+    while (b->now < 1000000 + 5 * CCND_EXPIRY_SLOT_USEC) {
+        b->now += 1000;
+        ccn_schedule_run(sched);
+    }
+    if (!b->stale[1] || b->stale[0]) {
+        fprintf(stderr, "past-due entry %s\n",
+                b->stale[0] ? "went early" : "was not expired by the next sweep");
+        res = -1;
+    }
+    ccnd_expiry_destroy(&b->wheel);
+    ccn_schedule_destroy(&sched);
+    free(b->stale);
+    return(res);
+}
+
+int
+main(int argc, char **argv)
+{
+    int count = COUNT;
+    if (argc > 1)
+        count = atoi(argv[1]);
+    if (count <= 0) {
+        fprintf(stderr, "usage: %s [count]\n", argv[0]);
+        exit(1);
+    }
+    if (check_past_due() < 0)
+        exit(1);
+    run("event", 0, count);
+    run("batched", 1, count);
+    exit(0);
+}
@@ -664,6 +664,7 @@ r_init_destroy(struct ccnr_handle **pccnr)
     hashtb_destroy(&h->nameprefix_tab);
     hashtb_destroy(&h->enum_state_tab);
     hashtb_destroy(&h->content_by_accession_tab);
+    hashtb_destroy(&h->latest_version_tab);
 
     // SyncActions sync_stop method should be shutting down heartbeat
     if (h->sync_plumbing) {
@@ -325,6 +325,9 @@ ccnr_uri_listen(struct ccnr_handle *ccnr, struct ccn *ccn, const char *uri,
  *  Create the repository keystore if necessary,
  *  and load it into the client handle h.
  *
+ *  A shared secret named by CCNR_SECRET_KEY_FILE is loaded as well,
+ *  so that content signed with it can be verified.
+ *
  *  It is permitted for h to be NULL to skip the load.
  *  @returns -1 if there were problems.
  */
@@ -338,6 +341,7 @@ ccnr_init_repo_keystore(struct ccnr_handle *ccnr, struct ccn *h)
     int res = -1;
     size_t save;
     char *keystore_path = NULL;
+    const char *secret_path = NULL;
     struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
     
     temp = ccn_charbuf_create();
@@ -386,6 +390,15 @@ Finish:
         ccn_charbuf_append_value(ccnr->ccnr_keyid, 0, 1);
         ccn_charbuf_append(ccnr->ccnr_keyid, ccnr->ccnr_id, sizeof(ccnr->ccnr_id));
     }
+    secret_path = getenv("CCNR_SECRET_KEY_FILE");
+    if (res >= 0 && h != NULL && secret_path != NULL && secret_path[0] != 0) {
+        res = ccn_load_secret_key(h, secret_path, NULL);
+        if (res < 0) {
+            culprit = temp;
+            temp->length = 0;
+            ccn_charbuf_append_string(temp, secret_path);
+        }
+    }
     if (res < 0) {
         ccnr->running = -1; /* Make note of init failure */
         if (culprit != NULL)
@@ -41,12 +41,15 @@ stdiologger(void *loggerdata, const char *format, va_list ap)
 }
 
 static struct ccnr_handle *global_h = NULL;
+static volatile sig_atomic_t early_signal = 0;
 
 static void
 handle_signal(int sig)
 {
     if (global_h != NULL)
         global_h->running = 0;
+    else
+        early_signal = sig; /* still starting up */
     signal(sig, SIG_DFL);
 }
 /**
@@ -72,6 +75,8 @@ static const char *ccnr_usage_message =
 "    CCNR_GLOBAL_PREFIX=ccnx:/parc.com/csl/ccn/Repos\n"
 "      CCNx URI representing the prefix where data/policy.xml is stored.\n"
 "      Only meaningful if no policy file exists at startup.\n"
+"    CCNR_SECRET_KEY_FILE=\n"
+"      File holding a shared secret, used to verify HMAC-signed content.\n"
 "    CCNR_START_WRITE_SCOPE_LIMIT=3\n"
 "      0..3 (default 3) Process start-write(-checked) interests with a scope\n"
 "      not exceeding the given value.  0 is effectively read-only. 3 indicates unlimited.\n"
@@ -129,13 +134,17 @@ main(int argc, char **argv)
         exit(1);
     }
     signal(SIGPIPE, SIG_IGN);
-    global_h = r_init_create(argv[0], stdiologger, stderr);
-    if (global_h == NULL)
-        exit(1);
+    /* Catch these during startup too, so the index is left consistent */
     signal(SIGINT, &handle_signal);
     signal(SIGTERM, &handle_signal);
     signal(SIGXFSZ, &handle_signal);
-    r_dispatch_run(global_h);
+    global_h = r_init_create(argv[0], stdiologger, stderr);
+    if (global_h == NULL)
+        exit(1);
+    if (early_signal == 0)
+        r_dispatch_run(global_h);
+    else
+        global_h->running = 0;
     s = (global_h->running != 0);
     ccnr_msg(global_h, "exiting.");
     r_init_destroy(&global_h);
@@ -207,6 +207,7 @@ struct ccnr_handle {
     unsigned cookie_limit;          /**< content_by_cookie size(power of 2)*/
     struct content_entry **content_by_cookie; /**< cookie-to-content table */
     struct hashtb *content_by_accession_tab; /**< keyed by accession */
+    struct hashtb *latest_version_tab; /**< keyed by prefix flatname */
     ccnr_cookie cookie;      /**< newest used cookie number */
     ccnr_cookie min_stale;      /**< smallest cookie of stale content */
     ccnr_cookie max_stale;      /**< largest cookie of stale content */
@@ -362,6 +363,22 @@ struct content_by_accession_entry {
     struct content_entry *content;
 };
 
+/**
+ * The latest version index is keyed by the flatname of a name prefix.
+ *
+ * It is filled in as prefixes are asked about, and kept current as
+ * content is committed.  A size of 0 records that no version is held.
+ */
+struct latest_version_entry {
+    unsigned char vcomp[7];     /**< the version component */
+    int size;                   /**< 7, or 0 for none */
+};
+
+/**
+ * Limit on the number of prefixes in the latest version index.
+ */
+#define CCNR_MAX_LATEST_VERSIONS 4000
+
 /**
  * The propagating interest hash table is keyed by Nonce.
  *
@@ -84,6 +84,12 @@ r_proto_bulk_import(struct ccn_closure *selfp,
                              enum ccn_upcall_kind kind,
                              struct ccn_upcall_info *info,
                              int marker_comp);
+
+static enum ccn_upcall_res
+r_proto_latest_version(struct ccn_closure *selfp,
+                       enum ccn_upcall_kind kind,
+                       struct ccn_upcall_info *info,
+                       int marker_comp);
 static int
 name_comp_equal_prefix(const unsigned char *data,
                     const struct ccn_indexbuf *indexbuf,
@@ -174,6 +180,13 @@ r_proto_answer_req(struct ccn_closure *selfp,
                             NULL, info->interest_ccnb, info->pi->offset[CCN_PI_E]);
         res = r_proto_start_write_checked(selfp, kind, info, marker_comp);
         goto Finish;
+    } else if (((marker_comp = ncomps - 3) >= 0) &&
+               0 == r_util_name_comp_compare(info->interest_ccnb, info->interest_comps, marker_comp, REPO_LV, strlen(REPO_LV))) {
+        if (CCNSHOULDLOG(ccnr, LM_8, CCNL_FINER))
+            ccnr_debug_ccnb(ccnr, __LINE__, "repo_latest_version",
+                            NULL, info->interest_ccnb, info->pi->offset[CCN_PI_E]);
+        res = r_proto_latest_version(selfp, kind, info, marker_comp);
+        goto Finish;
     } else if (((marker_comp = 0) == 0) &&
                name_comp_equal_prefix(info->interest_ccnb, info->interest_comps, marker_comp, REPO_AF, strlen(REPO_AF))) {
         if (CCNSHOULDLOG(ccnr, LM_8, CCNL_FINER))
@@ -1429,6 +1442,63 @@ Bail:
     return (ans);
 }
 
+/**
+ * Answer a query of the latest version index.
+ *
+ * The query name is <prefix>/%C1.R.lv/<nonce>.  The answer carries
+ * the Name of the latest version held under prefix; if none is held,
+ * there is no answer.
+ */
+static enum ccn_upcall_res
+r_proto_latest_version(struct ccn_closure *selfp,
+                       enum ccn_upcall_kind kind,
+                       struct ccn_upcall_info *info,
+                       int marker_comp)
+{
+    enum ccn_upcall_res ans = CCN_UPCALL_RESULT_ERR;
+    struct ccnr_handle *ccnr = NULL;
+    struct ccn_indexbuf *ic = NULL;
+    struct ccn_charbuf *msg = NULL;
+    struct ccn_charbuf *name = NULL;
+    struct ccn_charbuf *reply_body = NULL;
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    int res;
+    
+    ccnr = (struct ccnr_handle *)selfp->data;
+    ic = info->interest_comps;
+    name = ccn_charbuf_create();
+    ccn_name_init(name);
+    ccn_name_append_components(name, info->interest_ccnb, ic->buf[0], ic->buf[marker_comp]);
+    reply_body = ccn_charbuf_create();
+    res = r_store_latest_version(ccnr, name->buf, name->length, reply_body);
+    if (res < 0) {
+        ans = CCN_UPCALL_RESULT_OK;
+        goto Bail;
+    }
+    /* Generate our reply */
+    ccn_name_init(name);
+    ccn_name_append_components(name, info->interest_ccnb, ic->buf[0], ic->buf[ic->n - 1]);
+    msg = ccn_charbuf_create();
+    sp.freshness = 1; /* Seconds */
+    res = ccn_sign_content(info->h, msg, name, &sp,
+                           reply_body->buf, reply_body->length);
+    if (res < 0)
+        goto Bail;
+    res = ccn_put(info->h, msg->buf, msg->length);
+    if (res < 0) {
+        ccnr_debug_ccnb(ccnr, __LINE__, "r_proto_latest_version ccn_put FAILED", NULL,
+                        msg->buf, msg->length);
+        goto Bail;
+    }
+    ans = CCN_UPCALL_RESULT_INTEREST_CONSUMED;
+
+Bail:
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&msg);
+    ccn_charbuf_destroy(&reply_body);
+    return(ans);
+}
+
 /* Construct a charbuf with an encoding of a Policy object 
  *
  *  <xs:complexType name="PolicyType">
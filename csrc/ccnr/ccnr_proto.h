@@ -28,6 +28,7 @@
 #define REPO_SW "\xC1.R.sw"
 #define REPO_SWC "\xC1.R.sw-c"
 #define REPO_AF "\xC1.R.af"
+#define REPO_LV "\xC1.R.lv"
 #define NAME_BE "\xC1.E.be"
 
 struct ccnr_parsed_policy {
@@ -82,6 +82,8 @@ const ccnr_accession r_store_mark_repoFile1 = ((ccnr_accession)1) << 48;
 static int
 r_store_set_flatname(struct ccnr_handle *h, struct content_entry *content,
                      struct ccn_parsed_ContentObject *pco);
+static void
+r_store_note_versions(struct ccnr_handle *h, struct content_entry *content);
 static int
 r_store_content_btree_insert(struct ccnr_handle *h,
                              struct content_entry *content,
@@ -506,6 +508,8 @@ r_store_init(struct ccnr_handle *h)
     CHKPTR(h->content_by_cookie);
     h->content_by_accession_tab = hashtb_create(sizeof(struct content_by_accession_entry), &param);
     CHKPTR(h->content_by_accession_tab);
+    h->latest_version_tab = hashtb_create(sizeof(struct latest_version_entry), NULL);
+    CHKPTR(h->latest_version_tab);
     h->btree = btree = ccn_btree_create();
     CHKPTR(btree);
     FAILIF(btree->nextnodeid != 1);
@@ -1493,10 +1497,157 @@ r_store_commit_content(struct ccnr_handle *h, struct content_entry *content)
         }
         r_store_send_content(h, r_io_fdholder_from_fd(h, h->active_out_fd), content);
         r_store_content_change_flags(content, CCN_CONTENT_ENTRY_STABLE, 0);
+        r_store_note_versions(h, content);
     }
     return(0);
 }
 
+/**
+ * Bring the latest version index up to date with newly committed content.
+ *
+ * Each version component in the name may be the latest under the
+ * prefix before it.  Only prefixes already in the index are touched;
+ * the others are looked up when first asked about.
+ */
+static void
+r_store_note_versions(struct ccnr_handle *h, struct content_entry *content)
+{
+    struct latest_version_entry *entry = NULL;
+    const unsigned char *flat = NULL;
+    const unsigned char *comp = NULL;
+    size_t size;
+    size_t i;
+    int rnc;
+    
+    if (content->flatname == NULL || hashtb_n(h->latest_version_tab) == 0)
+        return;
+    flat = content->flatname->buf;
+    size = content->flatname->length;
+    for (i = 0; i < size; i += CCNFLATSKIP(rnc)) {
+        rnc = ccn_flatname_next_comp(flat + i, size - i);
+        if (rnc <= 0)
+            break;
+        comp = flat + i + CCNFLATDELIMSZ(rnc);
+        if (CCNFLATDATASZ(rnc) != sizeof(entry->vcomp) ||
+            comp[0] != CCN_MARKER_VERSION)
+            continue;
+        entry = hashtb_lookup(h->latest_version_tab, flat, i);
+        if (entry != NULL && (entry->size == 0 ||
+                memcmp(comp, entry->vcomp, sizeof(entry->vcomp)) > 0)) {
+            memcpy(entry->vcomp, comp, sizeof(entry->vcomp));
+            entry->size = sizeof(entry->vcomp);
+        }
+    }
+}
+
+/**
+ * Find the highest version component directly under a name prefix,
+ * by asking the store for the rightmost match of an interest that
+ * excludes everything but versions.
+ */
+static void
+r_store_find_latest_version(struct ccnr_handle *h,
+                            const unsigned char *name, size_t size,
+                            struct latest_version_entry *entry)
+{
+    struct ccn_charbuf *interest = NULL;
+    struct ccn_parsed_interest parsed_interest = {0};
+    struct ccn_parsed_interest *pi = &parsed_interest;
+    struct ccn_indexbuf *comps = NULL;
+    struct content_entry *content = NULL;
+    const unsigned char *flat = NULL;
+    unsigned char lowtime[7] = {CCN_MARKER_VERSION, 0, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    unsigned char future[7] = {CCN_MARKER_VERSION + 1, 0, 0, 0, 0, 0, 0};
+    size_t i;
+    int n;
+    int rnc;
+    int res;
+    
+    entry->size = 0;
+    interest = ccn_charbuf_create();
+    comps = ccn_indexbuf_create();
+    ccn_charbuf_append_tt(interest, CCN_DTAG_Interest, CCN_DTAG);
+    ccn_charbuf_append(interest, name, size);
+    ccn_charbuf_append_tt(interest, CCN_DTAG_Exclude, CCN_DTAG);
+    ccn_charbuf_append_tt(interest, CCN_DTAG_Any, CCN_DTAG);
+    ccn_charbuf_append_closer(interest); /* </Any> */
+    ccnb_append_tagged_blob(interest, CCN_DTAG_Component, lowtime, sizeof(lowtime));
+    ccnb_append_tagged_blob(interest, CCN_DTAG_Component, future, sizeof(future));
+    ccn_charbuf_append_tt(interest, CCN_DTAG_Any, CCN_DTAG);
+    ccn_charbuf_append_closer(interest); /* </Any> */
+    ccn_charbuf_append_closer(interest); /* </Exclude> */
+    ccnb_tagged_putf(interest, CCN_DTAG_ChildSelector, "1");
+    ccn_charbuf_append_closer(interest); /* </Interest> */
+    res = ccn_parse_interest(interest->buf, interest->length, pi, comps);
+    if (res < 0)
+        goto Bail;
+    content = r_store_lookup(h, interest->buf, pi, comps);
+    if (content == NULL)
+        goto Bail;
+    /* The version is the component just past the prefix */
+    flat = content->flatname->buf;
+    for (i = 0, n = 0;; i += CCNFLATSKIP(rnc), n++) {
+        rnc = ccn_flatname_next_comp(flat + i, content->flatname->length - i);
+        if (rnc <= 0)
+            goto Bail;
+        if (n == pi->prefix_comps)
+            break;
+    }
+    if (CCNFLATDATASZ(rnc) == sizeof(entry->vcomp)) {
+        memcpy(entry->vcomp, flat + i + CCNFLATDELIMSZ(rnc), sizeof(entry->vcomp));
+        entry->size = sizeof(entry->vcomp);
+    }
+Bail:
+    ccn_charbuf_destroy(&interest);
+    ccn_indexbuf_destroy(&comps);
+}
+
+/**
+ * Look up the latest version held under a name prefix.
+ *
+ * @param name is the ccnb-encoded Name of the prefix.
+ * @param resultbuf is set to the Name of the latest version, that is,
+ *        the prefix followed by a version component.
+ * @returns 0 if a version is held, or -1 if not.
+ */
+PUBLIC int
+r_store_latest_version(struct ccnr_handle *h,
+                       const unsigned char *name, size_t size,
+                       struct ccn_charbuf *resultbuf)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct latest_version_entry *entry = NULL;
+    struct ccn_charbuf *flatname = NULL;
+    int ans = -1;
+    int res;
+    
+    flatname = ccn_charbuf_create();
+    res = ccn_flatname_from_ccnb(flatname, name, size);
+    if (res < 0)
+        goto Bail;
+    if (hashtb_n(h->latest_version_tab) >= CCNR_MAX_LATEST_VERSIONS) {
+        /* Start over rather than keep track of which prefixes are in use */
+        hashtb_destroy(&h->latest_version_tab);
+        h->latest_version_tab = hashtb_create(sizeof(struct latest_version_entry), NULL);
+    }
+    hashtb_start(h->latest_version_tab, e);
+    res = hashtb_seek(e, flatname->buf, flatname->length, 0);
+    entry = e->data;
+    if (res == HT_NEW_ENTRY)
+        r_store_find_latest_version(h, name, size, entry);
+    if (entry != NULL && entry->size != 0) {
+        resultbuf->length = 0;
+        ccn_charbuf_append(resultbuf, name, size);
+        ccn_name_append(resultbuf, entry->vcomp, entry->size);
+        ans = 0;
+    }
+    hashtb_end(e);
+Bail:
+    ccn_charbuf_destroy(&flatname);
+    return(ans);
+}
+
 PUBLIC void
 ccnr_debug_content(struct ccnr_handle *h,
                    int lineno,
@@ -48,6 +48,7 @@ int r_store_name_append_components(struct ccn_charbuf *dst, struct ccnr_handle *
 int r_store_content_flags(struct content_entry *content);
 int r_store_content_change_flags(struct content_entry *content, int set, int clear);
 int r_store_commit_content(struct ccnr_handle *h, struct content_entry *content);
+int r_store_latest_version(struct ccnr_handle *h, const unsigned char *name, size_t size, struct ccn_charbuf *resultbuf);
 void r_store_forget_content(struct ccnr_handle *h, struct content_entry **pentry);
 void ccnr_debug_content(struct ccnr_handle *h, int lineno, const char *msg,
                         struct fdholder *fdholder,
@@ -0,0 +1,1025 @@
+/**
+ * @file ccnrbench.c
+ *
+ * Repository performance benchmark.
+ *
+ * Starts a private ccnd and ccnr in a temporary directory, and measures
+ * writes (start-write of several streams at once), pipelined reads,
+ * name enumeration, repository restarts with a stable index and with an
+ * index rebuild, and the time for a second repository to catch up by
+ * sync.  The content is signed before anything is timed.
+ *
+ * Each result is printed as a single line of name=value pairs, so that
+ * runs against different versions of the code can be compared by script.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+#include <ccn/sync.h>
+#include <ccn/uri.h>
+
+#define W_WRITE     0x01
+#define W_READ      0x02
+#define W_ENUM      0x04
+#define W_RESTART   0x08
+#define W_SYNC      0x10
+
+#define REPO_SRV_URI "ccnx:/%C1.M.S.localhost/%C1.M.SRV/repository"
+#define SYNC_TOPO_URI "ccnx:/ccnrbench/topo"
+#define PROBE_MS 10
+
+struct repo {
+    const char *label;
+    struct ccn_charbuf *dir;        /**< CCNR_DIRECTORY */
+    struct ccn_charbuf *file;       /**< its repoFile1 */
+    pid_t pid;
+};
+
+struct bench {
+    struct ccn *h;
+    const char *ccnd_prog;
+    const char *ccnr_prog;
+    const char *label;
+    struct ccn_charbuf *workdir;
+    pid_t ccnd_pid;
+    int sync;                       /**< run the repositories with sync */
+    struct repo repo[2];
+    /* parameters */
+    int nobjects;
+    int size;
+    int nstreams;
+    int pipeline;
+    int passes;
+    int nenum;
+    int nrestart;
+    /* content */
+    int per_stream;
+    struct ccn_charbuf *prefix;
+    struct ccn_charbuf **streams;   /**< versioned name of each stream */
+    struct ccn_charbuf *objects;    /**< all the ContentObjects */
+    struct ccn_indexbuf *ends;      /**< end of each in objects */
+    intmax_t data_bytes;
+    /* per-workload state */
+    double *sent;
+    double *lat;
+    int nlat;
+    int next;
+    int done;
+    int served;
+    int timeouts;
+    struct ccn_closure serve;
+    struct ccn_closure fetched;
+    struct ccn_closure started;
+    int errors;
+};
+
+static double
+now_secs(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return(tv.tv_sec + tv.tv_usec / 1e6);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-h] [-n objects] [-s size] [-w streams] [-p pipeline]"
+            " [-r passes] [-e enumerations] [-R restarts] [-t workloads]"
+            " [-l label] [-d ccnd] [-c ccnr]\n"
+            " Measure repository performance on a private ccnd and ccnr.\n"
+            "  -n objects - number of ContentObjects to write (default 5000)\n"
+            "  -s size - payload bytes per object (default 1024)\n"
+            "  -w streams - streams written at once (default 4)\n"
+            "  -p pipeline - reads outstanding at once (default 12)\n"
+            "  -r passes - times to read everything (default 3)\n"
+            "  -e enumerations - name enumerations to time (default 20)\n"
+            "  -R restarts - repository restarts of each kind (default 3)\n"
+            "  -t workloads - comma-separated list from write, read, enum,"
+            " restart, sync, all (default write,read,enum,restart)\n"
+            "  -l label - included in every result line\n"
+            "  -d ccnd, -c ccnr - the programs to run (default from PATH)\n"
+            " Results go to stdout, one line per measurement;"
+            " times are in milliseconds.\n",
+            progname);
+    exit(1);
+}
+
+static int
+parse_workloads(const char *s)
+{
+    static const char *names[] = {"write", "read", "enum", "restart", "sync"};
+    int w = 0;
+    int i;
+    size_t n;
+
+    while (*s != 0) {
+        n = strcspn(s, ",");
+        if (n == 3 && strncmp(s, "all", n) == 0)
+            w |= W_WRITE | W_READ | W_ENUM | W_RESTART | W_SYNC;
+        else {
+            for (i = 0; i < 5; i++)
+                if (strlen(names[i]) == n && strncmp(s, names[i], n) == 0)
+                    break;
+            if (i == 5)
+                return(-1);
+            w |= 1 << i;
+        }
+        s += n;
+        if (*s == ',')
+            s++;
+    }
+    return(w);
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+
+    return((x > y) - (x < y));
+}
+
+/**
+ * Print one result line.
+ *
+ * The latency percentiles are nearest-rank over the nlat samples in
+ * lat, which gets sorted.
+ */
+static void
+report(struct bench *b, const char *workload, const char *extra,
+       int objects, intmax_t bytes, double secs, double *lat, int nlat)
+{
+    int p[3] = {50, 90, 99};
+    int i, k;
+
+    printf("workload=%s", workload);
+    if (b->label != NULL)
+        printf(" label=%s", b->label);
+    if (extra != NULL)
+        printf(" %s", extra);
+    printf(" objects=%d bytes=%jd ms=%.1f", objects, bytes, secs * 1000);
+    if (secs > 0 && objects > 0)
+        printf(" objects_per_sec=%.0f mbytes_per_sec=%.2f",
+               objects / secs, bytes / secs / 1e6);
+    if (nlat > 0) {
+        qsort(lat, nlat, sizeof(lat[0]), &cmp_double);
+        for (i = 0; i < 3; i++) {
+            k = (p[i] * nlat + 99) / 100 - 1;
+            printf(" p%d_ms=%.2f", p[i], lat[k] * 1000);
+        }
+        printf(" max_ms=%.2f samples=%d", lat[nlat - 1] * 1000, nlat);
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+static intmax_t
+file_size(struct ccn_charbuf *path)
+{
+    struct stat st;
+
+    if (stat(ccn_charbuf_as_string(path), &st) != 0)
+        return(-1);
+    return(st.st_size);
+}
+
+/**
+ * Remove a directory and everything in it.
+ */
+static int
+rm_tree(const char *path)
+{
+    struct ccn_charbuf *sub = ccn_charbuf_create();
+    struct dirent *de;
+    struct stat st;
+    DIR *d;
+    int res = 0;
+
+    d = opendir(path);
+    if (d == NULL)
+        res = -1;
+    while (d != NULL && (de = readdir(d)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        ccn_charbuf_reset(sub);
+        ccn_charbuf_putf(sub, "%s/%s", path, de->d_name);
+        if (lstat(ccn_charbuf_as_string(sub), &st) == 0 && S_ISDIR(st.st_mode))
+            res |= rm_tree(ccn_charbuf_as_string(sub));
+        else
+            res |= unlink(ccn_charbuf_as_string(sub));
+    }
+    if (d != NULL) {
+        closedir(d);
+        res |= rmdir(path);
+    }
+    ccn_charbuf_destroy(&sub);
+    return(res);
+}
+
+/**
+ * Start a daemon with its output going to a log file in the work directory.
+ * @param env is a NULL-terminated list of name, value pairs to set first.
+ */
+static pid_t
+spawn(struct bench *b, const char *prog, const char *logname,
+      const char **env)
+{
+    struct ccn_charbuf *log = ccn_charbuf_create();
+    pid_t pid;
+    int fd;
+    int i;
+
+    ccn_charbuf_putf(log, "%s/%s", ccn_charbuf_as_string(b->workdir), logname);
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        for (i = 0; env[i] != NULL; i += 2)
+            setenv(env[i], env[i + 1], 1);
+        fd = open(ccn_charbuf_as_string(log), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (fd >= 0) {
+            dup2(fd, 1);
+            dup2(fd, 2);
+            close(fd);
+        }
+        execlp(prog, prog, (char *)NULL);
+        perror(prog);
+        _exit(127);
+    }
+    if (pid == -1)
+        perror("fork");
+    ccn_charbuf_destroy(&log);
+    return(pid);
+}
+
+/**
+ * Stop a daemon, politely at first.
+ */
+static void
+stop(pid_t *pidp)
+{
+    int i;
+
+    if (*pidp <= 0)
+        return;
+    kill(*pidp, SIGTERM);
+    for (i = 0; i < 1000; i++) {
+        if (waitpid(*pidp, NULL, WNOHANG) == *pidp) {
+            *pidp = 0;
+            return;
+        }
+        usleep(10000);
+    }
+    kill(*pidp, SIGKILL);
+    waitpid(*pidp, NULL, 0);
+    *pidp = 0;
+}
+
+static int
+start_ccnd(struct bench *b)
+{
+    /*
+     * With no capacity, ccnd makes content stale soon after it arrives,
+     * and the data pause (used only for multicast) sets how soon.
+     */
+    const char *env[] = {
+        "CCND_DEBUG", "1",
+        "CCND_CAP", "0",
+        "CCND_DATA_PAUSE_MICROSEC", "1",
+        NULL};
+    int i;
+
+    b->ccnd_pid = spawn(b, b->ccnd_prog, "ccnd.log", env);
+    if (b->ccnd_pid <= 0)
+        return(-1);
+    for (i = 0; i < 1000; i++) {
+        if (ccn_connect(b->h, NULL) >= 0)
+            return(0);
+        ccn_disconnect(b->h);
+        if (waitpid(b->ccnd_pid, NULL, WNOHANG) == b->ccnd_pid) {
+            b->ccnd_pid = 0;
+            break;
+        }
+        usleep(10000);
+    }
+    fprintf(stderr, "ccnd did not start; see %s/ccnd.log\n",
+            ccn_charbuf_as_string(b->workdir));
+    return(-1);
+}
+
+/**
+ * Make the template for readiness probes, which are local and short-lived
+ * so that ccnd does not hold on to one that it had nowhere to send.
+ */
+static struct ccn_charbuf *
+make_probe_template(void)
+{
+    struct ccn_charbuf *templ = ccn_charbuf_create();
+
+    ccnb_element_begin(templ, CCN_DTAG_Interest);
+    ccnb_element_begin(templ, CCN_DTAG_Name);
+    ccnb_element_end(templ); /* </Name> */
+    ccnb_tagged_putf(templ, CCN_DTAG_Scope, "%d", 1);
+    ccnb_append_tagged_binary_number(templ, CCN_DTAG_InterestLifetime,
+                                     PROBE_MS * 4096 / 1000);
+    ccnb_element_end(templ); /* </Interest> */
+    return(templ);
+}
+
+/**
+ * @returns the signing time of a ContentObject in seconds, or -1.
+ */
+static double
+signing_time(struct ccn_charbuf *co, struct ccn_parsed_ContentObject *pco)
+{
+    const unsigned char *ts = NULL;
+    size_t size = 0;
+    double t = 0;
+    size_t i;
+
+    if (ccn_ref_tagged_BLOB(CCN_DTAG_Timestamp, co->buf,
+                            pco->offset[CCN_PCO_B_Timestamp],
+                            pco->offset[CCN_PCO_E_Timestamp], &ts, &size) < 0)
+        return(-1);
+    for (i = 0; i < size; i++)
+        t = t * 256 + ts[i];
+    return(t / 4096);
+}
+
+/**
+ * Start a repository and wait until it answers.
+ *
+ * ccnr indexes its backing file before it connects to ccnd, so the
+ * first answer means it is ready to serve all of its content.  The
+ * answer is signed when it is first asked for, which tells it apart
+ * from one left in ccnd by an instance that has just been stopped.
+ * @returns seconds taken, or -1 for failure.
+ */
+static double
+start_repo(struct bench *b, struct repo *r)
+{
+    const char *env[] = {
+        "CCNR_DIRECTORY", NULL,
+        "CCNR_DEBUG", "WARNING",
+        "CCNR_SKIP_VERIFY", "1",
+        "CCNS_ENABLE", NULL,
+        "CCNS_DEBUG", "WARNING",
+        NULL};
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *templ = make_probe_template();
+    struct ccn_charbuf *logname = ccn_charbuf_create();
+    struct ccn_charbuf *co = ccn_charbuf_create();
+    struct ccn_parsed_ContentObject pco = {0};
+    double t0 = now_secs();
+    double ans = -1;
+    int res = -1;
+
+    env[1] = ccn_charbuf_as_string(r->dir);
+    env[7] = b->sync ? "1" : "0";
+    ccn_charbuf_putf(logname, "ccnr-%s.log", r->label);
+    ccn_name_from_uri(name, REPO_SRV_URI);
+    mkdir(ccn_charbuf_as_string(r->dir), 0777);
+    r->pid = spawn(b, b->ccnr_prog, ccn_charbuf_as_string(logname), env);
+    while (r->pid > 0 && now_secs() - t0 < 120) {
+        res = ccn_get(b->h, name, templ, PROBE_MS, co, &pco, NULL, 0);
+        if (res >= 0 && signing_time(co, &pco) >= t0 - 0.001)
+            break;
+        if (res >= 0) {
+            res = -1;
+            usleep(2000);
+        }
+        if (waitpid(r->pid, NULL, WNOHANG) == r->pid)
+            r->pid = 0;
+    }
+    if (res >= 0)
+        ans = now_secs() - t0;
+    else
+        fprintf(stderr, "repository %s did not start; see %s/%s\n", r->label,
+                ccn_charbuf_as_string(b->workdir),
+                ccn_charbuf_as_string(logname));
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&templ);
+    ccn_charbuf_destroy(&logname);
+    ccn_charbuf_destroy(&co);
+    return(ans);
+}
+
+/**
+ * Wait until a repository's backing file has reached the given size.
+ * @returns 0, or -1 if it has not after timeout seconds.
+ */
+static int
+wait_for_size(struct bench *b, struct repo *r, intmax_t size, double timeout)
+{
+    double t0 = now_secs();
+
+    while (file_size(r->file) < size) {
+        if (now_secs() - t0 > timeout)
+            return(-1);
+        ccn_run(b->h, 5);
+    }
+    return(0);
+}
+
+/**
+ * Find the stream and segment named by an interest for our content.
+ * @returns the object index, or -1 if it is not one of ours.
+ */
+static int
+object_index(struct bench *b, const unsigned char *ccnb,
+             struct ccn_indexbuf *comps)
+{
+    const unsigned char *comp;
+    size_t size;
+    int stream = -1;
+    int seg = 0;
+    size_t i;
+
+    /* /ccnrbench/run/sK/version/segment */
+    if (comps->n < 6)
+        return(-1);
+    if (ccn_name_comp_get(ccnb, comps, 2, &comp, &size) < 0 ||
+          size < 2 || comp[0] != 's')
+        return(-1);
+    for (i = 1, stream = 0; i < size && comp[i] >= '0' && comp[i] <= '9'; i++)
+        stream = stream * 10 + comp[i] - '0';
+    if (i != size || stream >= b->nstreams)
+        return(-1);
+    if (ccn_name_comp_get(ccnb, comps, 4, &comp, &size) < 0 ||
+          size < 1 || size > 4 || comp[0] != CCN_MARKER_SEQNUM)
+        return(-1);
+    for (i = 1; i < size; i++)
+        seg = (seg << 8) + comp[i];
+    if (seg >= b->per_stream)
+        return(-1);
+    return(stream * b->per_stream + seg);
+}
+
+/**
+ * Sign all the content before anything is timed.
+ */
+static int
+make_content(struct bench *b)
+{
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    char *payload = calloc(1, b->size + 1);
+    int res = 0;
+    int i, s;
+
+    for (i = 0; i < b->size; i++)
+        payload[i] = 'a' + i % 26;
+    b->streams = calloc(b->nstreams, sizeof(b->streams[0]));
+    for (s = 0; s < b->nstreams && res >= 0; s++) {
+        b->streams[s] = ccn_charbuf_create();
+        ccn_charbuf_append_charbuf(b->streams[s], b->prefix);
+        ccn_charbuf_reset(name);
+        ccn_charbuf_putf(name, "s%d", s);
+        ccn_name_append(b->streams[s], name->buf, name->length);
+        res = ccn_create_version(b->h, b->streams[s], CCN_V_NOW, 0, 0);
+        for (i = 0; i < b->per_stream && res >= 0; i++) {
+            ccn_charbuf_reset(name);
+            ccn_charbuf_append_charbuf(name, b->streams[s]);
+            ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i);
+            sp.sp_flags = (i == b->per_stream - 1) ? CCN_SP_FINAL_BLOCK : 0;
+            res = ccn_sign_content(b->h, b->objects, name, &sp,
+                                   payload, b->size);
+            ccn_indexbuf_append_element(b->ends, b->objects->length);
+        }
+    }
+    b->data_bytes = b->objects->length;
+    ccn_charbuf_destroy(&name);
+    free(payload);
+    return(res);
+}
+
+static enum ccn_upcall_res
+serve_content(struct ccn_closure *selfp,
+              enum ccn_upcall_kind kind,
+              struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+    size_t start;
+    int i;
+
+    if (kind != CCN_UPCALL_INTEREST)
+        return(CCN_UPCALL_RESULT_OK);
+    i = object_index(b, info->interest_ccnb, info->interest_comps);
+    if (i < 0)
+        return(CCN_UPCALL_RESULT_OK);
+    start = i == 0 ? 0 : b->ends->buf[i - 1];
+    if (ccn_put(info->h, b->objects->buf + start,
+                b->ends->buf[i] - start) < 0)
+        return(CCN_UPCALL_RESULT_ERR);
+    b->served++;
+    /* The last segment of a stream completes its write */
+    if (i % b->per_stream == b->per_stream - 1 && b->sent != NULL)
+        b->lat[i / b->per_stream] = now_secs() - b->sent[i / b->per_stream];
+    return(CCN_UPCALL_RESULT_INTEREST_CONSUMED);
+}
+
+static enum ccn_upcall_res
+start_write_reply(struct ccn_closure *selfp,
+                  enum ccn_upcall_kind kind,
+                  struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+
+    if (kind == CCN_UPCALL_INTEREST_TIMED_OUT)
+        b->timeouts++;
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Write all the streams at once by start-write, and wait until the
+ * repository's backing file holds all the content.
+ *
+ * The latency is that of a whole stream, from the start-write until the
+ * repository has fetched its last segment.
+ */
+static int
+bench_write(struct bench *b, struct repo *r)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    intmax_t before = file_size(r->file);
+    double t0;
+    int res = 0;
+    int s;
+
+    b->sent = calloc(b->nstreams, sizeof(double));
+    b->lat = calloc(b->nstreams, sizeof(double));
+    b->served = b->timeouts = 0;
+    ccn_set_interest_filter(b->h, b->prefix, &b->serve);
+    t0 = now_secs();
+    for (s = 0; s < b->nstreams; s++) {
+        ccn_charbuf_reset(name);
+        ccn_charbuf_append_charbuf(name, b->streams[s]);
+        ccn_name_from_uri(name, "%C1.R.sw");
+        ccn_name_append_nonce(name);
+        b->sent[s] = now_secs();
+        ccn_express_interest(b->h, name, &b->started, NULL);
+    }
+    res = wait_for_size(b, r, before + b->data_bytes,
+                        60 + b->nobjects / 100);
+    if (res < 0)
+        fprintf(stderr, "write: repository got %jd of %jd bytes "
+                "(%d objects served)\n", file_size(r->file) - before,
+                b->data_bytes, b->served);
+    else
+        report(b, "write", NULL, b->nobjects, b->data_bytes, now_secs() - t0,
+               b->lat, b->nstreams);
+    ccn_set_interest_filter(b->h, b->prefix, NULL);
+    free(b->sent);
+    free(b->lat);
+    b->sent = b->lat = NULL;
+    ccn_charbuf_destroy(&name);
+    return(res);
+}
+
+static int
+express_read(struct bench *b)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    int i = b->next++;
+    int res;
+
+    ccn_charbuf_append_charbuf(name, b->streams[i / b->per_stream]);
+    ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i % b->per_stream);
+    b->sent[i] = now_secs();
+    res = ccn_express_interest(b->h, name, &b->fetched, NULL);
+    ccn_charbuf_destroy(&name);
+    return(res);
+}
+
+static enum ccn_upcall_res
+read_content(struct ccn_closure *selfp,
+             enum ccn_upcall_kind kind,
+             struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+    int i;
+
+    switch (kind) {
+        case CCN_UPCALL_INTEREST_TIMED_OUT:
+            b->timeouts++;
+            return(CCN_UPCALL_RESULT_REEXPRESS);
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+        case CCN_UPCALL_CONTENT_RAW:
+        case CCN_UPCALL_CONTENT_KEYMISSING:
+            break;
+        default:
+            return(CCN_UPCALL_RESULT_OK);
+    }
+    i = object_index(b, info->interest_ccnb, info->interest_comps);
+    if (i < 0)
+        return(CCN_UPCALL_RESULT_ERR);
+    b->lat[b->nlat++] = now_secs() - b->sent[i];
+    b->done++;
+    if (b->next < b->nobjects)
+        express_read(b);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Read everything with a window of outstanding interests.
+ *
+ * ccnd runs with no content store capacity, so every object comes
+ * from the repository.
+ */
+static int
+bench_read(struct bench *b, int pass)
+{
+    struct ccn_charbuf *extra = ccn_charbuf_create();
+    double t0;
+    int res = 0;
+    int i;
+
+    b->sent = calloc(b->nobjects, sizeof(double));
+    b->lat = calloc(b->nobjects, sizeof(double));
+    b->nlat = b->next = b->done = b->timeouts = 0;
+    t0 = now_secs();
+    for (i = 0; i < b->pipeline && b->next < b->nobjects; i++)
+        express_read(b);
+    while (b->done < b->nobjects && now_secs() - t0 < 60 + b->nobjects / 100)
+        ccn_run(b->h, 100);
+    if (b->done < b->nobjects) {
+        fprintf(stderr, "read: got %d of %d objects\n", b->done, b->nobjects);
+        res = -1;
+    }
+    else {
+        ccn_charbuf_putf(extra, "pass=%d pipeline=%d timeouts=%d",
+                         pass, b->pipeline, b->timeouts);
+        report(b, "read", ccn_charbuf_as_string(extra), b->nobjects,
+               b->data_bytes, now_secs() - t0, b->lat, b->nlat);
+    }
+    free(b->sent);
+    free(b->lat);
+    b->sent = b->lat = NULL;
+    ccn_charbuf_destroy(&extra);
+    return(res);
+}
+
+/**
+ * Time complete enumerations of the run's prefix, whose children are
+ * the streams.
+ */
+static int
+bench_enum(struct bench *b)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *resultbuf = ccn_charbuf_create();
+    struct ccn_charbuf *extra = ccn_charbuf_create();
+    struct ccn_parsed_ContentObject pco = {0};
+    struct ccn_indexbuf *comps = ccn_indexbuf_create();
+    double *lat = calloc(b->nenum, sizeof(double));
+    double t0, t1;
+    intmax_t bytes = 0;
+    int segments = 0;
+    int res = 0;
+    int i;
+
+    t0 = now_secs();
+    for (i = 0; i < b->nenum && res >= 0; i++) {
+        t1 = now_secs();
+        ccn_charbuf_reset(name);
+        ccn_charbuf_append_charbuf(name, b->prefix);
+        ccn_name_from_uri(name, "%C1.E.be");
+        for (;;) {
+            res = ccn_get(b->h, name, NULL, 3000, resultbuf, &pco, comps, 0);
+            if (res < 0)
+                break;
+            segments++;
+            bytes += resultbuf->length;
+            if (ccn_is_final_pco(resultbuf->buf, &pco, comps) == 1)
+                break;
+            /* Ask for the next segment of the same version */
+            ccn_charbuf_reset(name);
+            ccn_name_init(name);
+            ccn_name_append_components(name, resultbuf->buf,
+                                       comps->buf[0], comps->buf[comps->n - 2]);
+            ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, segments);
+        }
+        lat[i] = now_secs() - t1;
+    }
+    if (res < 0)
+        fprintf(stderr, "enum: enumeration %d failed\n", i);
+    else {
+        ccn_charbuf_putf(extra, "enumerations=%d segments=%d",
+                         b->nenum, segments);
+        report(b, "enum", ccn_charbuf_as_string(extra), 0, bytes,
+               now_secs() - t0, lat, b->nenum);
+    }
+    free(lat);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&resultbuf);
+    ccn_charbuf_destroy(&extra);
+    ccn_indexbuf_destroy(&comps);
+    return(res);
+}
+
+/**
+ * Restart the repository, first with its index intact and then with the
+ * index removed so it must be rebuilt from the backing file.
+ */
+static int
+bench_restart(struct bench *b, struct repo *r)
+{
+    struct ccn_charbuf *index = ccn_charbuf_create();
+    double *lat = calloc(b->nrestart, sizeof(double));
+    intmax_t before;
+    double total;
+    int rebuild;
+    int res = 0;
+    int i;
+
+    ccn_charbuf_putf(index, "%s/index", ccn_charbuf_as_string(r->dir));
+    for (rebuild = 0; rebuild < 2 && res >= 0; rebuild++) {
+        total = 0;
+        for (i = 0; i < b->nrestart && res >= 0; i++) {
+            stop(&r->pid);
+            before = file_size(r->file);
+            if (rebuild && rm_tree(ccn_charbuf_as_string(index)) != 0 &&
+                  errno != ENOENT) {
+                perror(ccn_charbuf_as_string(index));
+                res = -1;
+                break;
+            }
+            lat[i] = start_repo(b, r);
+            if (lat[i] < 0)
+                res = -1;
+            else if (file_size(r->file) != before) {
+                fprintf(stderr, "restart changed the repository file\n");
+                res = -1;
+            }
+            total += lat[i];
+        }
+        /* Only a rebuild has to read the content */
+        if (res >= 0 && rebuild)
+            report(b, "restart_rebuild", NULL, b->nobjects, b->data_bytes,
+                   total / b->nrestart, lat, b->nrestart);
+        else if (res >= 0)
+            report(b, "restart", NULL, 0, 0, total / b->nrestart,
+                   lat, b->nrestart);
+    }
+    free(lat);
+    ccn_charbuf_destroy(&index);
+    return(res);
+}
+
+/**
+ * Give a repository the slice that covers the benchmark content.
+ */
+static int
+write_slice(struct bench *b)
+{
+    struct ccns_slice *slice = ccns_slice_create();
+    struct ccn_charbuf *topo = ccn_charbuf_create();
+    int res;
+
+    ccn_name_from_uri(topo, SYNC_TOPO_URI);
+    res = ccns_slice_set_topo_prefix(slice, topo, b->prefix);
+    if (res >= 0)
+        res = ccns_write_slice(b->h, slice, NULL);
+    if (res < 0)
+        fprintf(stderr, "could not write the sync slice\n");
+    ccns_slice_destroy(&slice);
+    ccn_charbuf_destroy(&topo);
+    return(res);
+}
+
+/**
+ * Time how long a new, empty repository takes to get everything by sync.
+ *
+ * The new one is started alone, so that only it gets the slice written
+ * for it, and the time runs from when the first one is started again.
+ */
+static int
+bench_sync(struct bench *b)
+{
+    struct repo *a = &b->repo[0];
+    struct repo *r = &b->repo[1];
+    intmax_t before;
+    double t0;
+    int res;
+
+    stop(&a->pid);
+    if (start_repo(b, r) < 0)
+        return(-1);
+    before = file_size(r->file);
+    res = write_slice(b);
+    if (res >= 0)
+        res = wait_for_size(b, r, before + 1, 10);
+    if (res < 0)
+        return(-1);
+    before = file_size(r->file);
+    /* a starts syncing before it answers, so time from its launch */
+    t0 = now_secs();
+    if (start_repo(b, a) < 0)
+        return(-1);
+    res = wait_for_size(b, r, before + b->data_bytes, 60 + b->nobjects / 50);
+    if (res < 0)
+        fprintf(stderr, "sync: repository got %jd of %jd bytes\n",
+                file_size(r->file) - before, b->data_bytes);
+    else
+        report(b, "sync", NULL, b->nobjects, b->data_bytes, now_secs() - t0,
+               NULL, 0);
+    return(res);
+}
+
+static void
+init_repo(struct bench *b, struct repo *r, const char *label)
+{
+    r->label = label;
+    r->dir = ccn_charbuf_create();
+    ccn_charbuf_putf(r->dir, "%s/repo-%s", ccn_charbuf_as_string(b->workdir),
+                     label);
+    r->file = ccn_charbuf_create();
+    ccn_charbuf_putf(r->file, "%s/repoFile1", ccn_charbuf_as_string(r->dir));
+}
+
+/**
+ * Pick a port no ccnd is using.
+ */
+static void
+choose_port(void)
+{
+    struct ccn *h = ccn_create();
+    char port[12];
+    int res;
+    int i;
+
+    if (getenv("CCN_LOCAL_PORT") == NULL) {
+        for (i = 0; i < 100; i++) {
+            snprintf(port, sizeof(port), "%d", 9800 + (getpid() + i) % 1000);
+            setenv("CCN_LOCAL_PORT", port, 1);
+            res = ccn_connect(h, NULL);
+            ccn_disconnect(h);
+            if (res < 0)
+                break;
+        }
+    }
+    ccn_destroy(&h);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench bench = {0};
+    struct bench *b = &bench;
+    char dir[] = "/tmp/ccnrbenchXXXXXX";
+    char run[40];
+    int workloads = W_WRITE | W_READ | W_ENUM | W_RESTART;
+    int keep = 0;
+    int opt;
+    int i;
+
+    b->ccnd_prog = "ccnd";
+    b->ccnr_prog = "ccnr";
+    b->nobjects = 5000;
+    b->size = 1024;
+    b->nstreams = 4;
+    b->pipeline = 12;
+    b->passes = 3;
+    b->nenum = 20;
+    b->nrestart = 3;
+    while ((opt = getopt(argc, argv, "hkn:s:w:p:r:e:R:t:l:d:c:")) != -1) {
+        switch (opt) {
+            case 'n': b->nobjects = atoi(optarg); break;
+            case 's': b->size = atoi(optarg); break;
+            case 'w': b->nstreams = atoi(optarg); break;
+            case 'p': b->pipeline = atoi(optarg); break;
+            case 'r': b->passes = atoi(optarg); break;
+            case 'e': b->nenum = atoi(optarg); break;
+            case 'R': b->nrestart = atoi(optarg); break;
+            case 't': workloads = parse_workloads(optarg); break;
+            case 'l': b->label = optarg; break;
+            case 'd': b->ccnd_prog = optarg; break;
+            case 'c': b->ccnr_prog = optarg; break;
+            case 'k': keep = 1; break;
+            case 'h':
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (workloads <= 0 || b->nstreams <= 0 || b->nobjects < b->nstreams ||
+          b->size < 0 || b->size > 8000 || b->pipeline <= 0 ||
+          b->nenum <= 0 || b->nrestart <= 0 || b->passes < 0)
+        usage(argv[0]);
+    /* Everything after the write reads what it wrote */
+    workloads |= W_WRITE;
+    b->per_stream = b->nobjects / b->nstreams;
+    if (b->per_stream > 0xFFFFFF)
+        usage(argv[0]);
+    b->nobjects = b->per_stream * b->nstreams;
+    b->sync = (workloads & W_SYNC) != 0;
+
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    b->workdir = ccn_charbuf_create();
+    ccn_charbuf_putf(b->workdir, "%s", dir);
+    /* Keep our keys, and those of ccnd, out of the user's own */
+    setenv("CCNX_DIR", dir, 1);
+    setenv("CCND_KEYSTORE_DIRECTORY", dir, 1);
+    setenv("CCNX_SIGNAGENT_SOCK", "", 1);
+    unsetenv("CCN_LOCAL_SOCKNAME");
+    choose_port();
+    signal(SIGPIPE, SIG_IGN);
+    init_repo(b, &b->repo[0], "a");
+    init_repo(b, &b->repo[1], "b");
+    b->h = ccn_create();
+    b->prefix = ccn_charbuf_create();
+    b->objects = ccn_charbuf_create();
+    b->ends = ccn_indexbuf_create();
+    b->serve.p = &serve_content;
+    b->serve.data = b;
+    b->fetched.p = &read_content;
+    b->fetched.data = b;
+    b->started.p = &start_write_reply;
+    b->started.data = b;
+    snprintf(run, sizeof(run), "%ld-%d", (long)time(NULL), (int)getpid());
+    ccn_name_from_uri(b->prefix, "ccnx:/ccnrbench");
+    ccn_name_append_str(b->prefix, run);
+
+    printf("workload=setup");
+    if (b->label != NULL)
+        printf(" label=%s", b->label);
+    printf(" objects=%d size=%d streams=%d pipeline=%d sync=%d port=%s\n",
+           b->nobjects, b->size, b->nstreams, b->pipeline, b->sync,
+           getenv("CCN_LOCAL_PORT"));
+    if (make_content(b) < 0) {
+        fprintf(stderr, "could not sign the content\n");
+        b->errors++;
+    }
+    else if (start_ccnd(b) < 0 || start_repo(b, &b->repo[0]) < 0)
+        b->errors++;
+    else if (b->sync && write_slice(b) < 0)
+        b->errors++;
+    else if (bench_write(b, &b->repo[0]) < 0)
+        b->errors++;
+    else {
+        for (i = 1; (workloads & W_READ) != 0 && i <= b->passes; i++)
+            if (bench_read(b, i) < 0)
+                b->errors++;
+        if ((workloads & W_ENUM) != 0 && bench_enum(b) < 0)
+            b->errors++;
+        if ((workloads & W_RESTART) != 0 && bench_restart(b, &b->repo[0]) < 0)
+            b->errors++;
+        if ((workloads & W_SYNC) != 0 && bench_sync(b) < 0)
+            b->errors++;
+    }
+    ccn_disconnect(b->h);
+    stop(&b->repo[0].pid);
+    stop(&b->repo[1].pid);
+    stop(&b->ccnd_pid);
+    if (b->errors != 0 || keep)
+        fprintf(stderr, "logs and repositories left in %s\n", dir);
+    else
+        rm_tree(dir);
+    ccn_destroy(&b->h);
+    for (i = 0; b->streams != NULL && i < b->nstreams; i++)
+        ccn_charbuf_destroy(&b->streams[i]);
+    free(b->streams);
+    for (i = 0; i < 2; i++) {
+        ccn_charbuf_destroy(&b->repo[i].dir);
+        ccn_charbuf_destroy(&b->repo[i].file);
+    }
+    ccn_charbuf_destroy(&b->prefix);
+    ccn_charbuf_destroy(&b->objects);
+    ccn_charbuf_destroy(&b->workdir);
+    ccn_indexbuf_destroy(&b->ends);
+    return(b->errors == 0 ? 0 : 1);
+}
@@ -19,11 +19,11 @@ SYNCLIBDIR = ../sync
 CPREFLAGS = -I../include -I..
 
 INSTALLED_PROGRAMS = ccnr
-PROGRAMS = $(INSTALLED_PROGRAMS)
+PROGRAMS = $(INSTALLED_PROGRAMS) ccnrbench
 DEBRIS = 
 
 BROKEN_PROGRAMS = 
-CSRC = ccnr_dispatch.c ccnr_forwarding.c ccnr_init.c ccnr_internal_client.c ccnr_io.c ccnr_link.c ccnr_main.c ccnr_match.c ccnr_msg.c ccnr_net.c ccnr_proto.c ccnr_sendq.c ccnr_stats.c ccnr_store.c ccnr_sync.c ccnr_util.c
+CSRC = ccnr_dispatch.c ccnr_forwarding.c ccnr_init.c ccnr_internal_client.c ccnr_io.c ccnr_link.c ccnr_main.c ccnr_match.c ccnr_msg.c ccnr_net.c ccnr_proto.c ccnr_sendq.c ccnr_stats.c ccnr_store.c ccnr_sync.c ccnr_util.c ccnrbench.c
 HSRC = ccnr_dispatch.h ccnr_forwarding.h ccnr_init.h ccnr_internal_client.h        \
        ccnr_io.h ccnr_link.h ccnr_match.h ccnr_msg.h ccnr_net.h ccnr_private.h     \
        ccnr_proto.h ccnr_sendq.h ccnr_stats.h ccnr_store.h ccnr_sync.h ccnr_util.h
@@ -41,6 +41,9 @@ CCNR_OBJ = ccnr_dispatch.o ccnr_forwarding.o ccnr_init.o ccnr_internal_client.o
 ccnr: $(CCNR_OBJ)
 	$(CC) $(CFLAGS) -o $@ $(CCNR_OBJ) $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 
+ccnrbench: ccnrbench.o
+	$(CC) $(CFLAGS) -o $@ ccnrbench.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
 clean:
 	rm -f *.o *.a $(PROGRAMS) $(BROKEN_PROGRAMS) depend
 	rm -rf *.dSYM *.gcov *.gcda *.gcno $(DEBRIS)
@@ -187,3 +190,6 @@ ccnr_util.o: ccnr_util.c ../include/ccn/bloom.h ../include/ccn/ccn.h \
   ../include/ccn/hashtb.h ../include/ccn/schedule.h \
   ../include/ccn/reg_mgmt.h ../include/ccn/uri.h ccnr_private.h \
   ../include/ccn/seqwriter.h ccnr_util.h
+ccnrbench.o: ccnrbench.c ../include/ccn/ccn.h ../include/ccn/coding.h \
+  ../include/ccn/charbuf.h ../include/ccn/indexbuf.h ../include/ccn/sync.h \
+  ../include/ccn/uri.h
@@ -1,11 +1,11 @@
 /**
  * @file ccn_splitccnb.c
  * Utility to break up a file filled with ccnb-encoded data items into
- * one data item per file.
+ * one data item per file, or into batches of them.
  *
  * A CCNx command-line utility.
  *
- * Copyright (C) 2008, 2009 Palo Alto Research Center, Inc.
+ * Copyright (C) 2008, 2009, 2012 Palo Alto Research Center, Inc.
  *
  * This work is free software; you can redistribute it and/or modify it under
  * the terms of the GNU General Public License version 2 as published by the
@@ -19,10 +19,10 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -30,13 +30,48 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <ccn/archive.h>
+#include <ccn/charbuf.h>
 #include <ccn/coding.h>
+#include <ccn/indexbuf.h>
+#include <ccn/uri.h>
 
 struct fstate {
     char *prefix;
-    int segnum;
+    struct ccn_indexbuf *selected; /* objects to write, or NULL for all */
+    size_t nobjects;
+    size_t batch;               /* objects per output file */
 };
 
+static int
+default_workers(void)
+{
+    long n = -1;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        return(1);
+    if (n > CCN_ARCHIVE_MAX_WORKERS)
+        return(CCN_ARCHIVE_MAX_WORKERS);
+    return(n);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-hi] [-j workers] [-n count] [-p uri] file ...\n"
+            " Splits each file of ccnb-encoded objects into files named "
+            "file-00000.ccnb, ...\n"
+            "  -i          keep an index in file%s for later runs\n"
+            "  -j workers  number of writing processes (default %d)\n"
+            "  -n count    objects per output file (default 1)\n"
+            "  -p uri      only objects with names under uri\n",
+            progname, CCN_ARCHIVE_INDEX_SUFFIX, default_workers());
+    exit(1);
+}
+
 static char *
 segment_prefix(char *path)
 {
@@ -52,121 +87,176 @@ segment_prefix(char *path)
 }
 
 static int
-write_segment(unsigned char *data, size_t s, struct fstate *perfilestate)
+write_full(int fd, const unsigned char *buf, size_t size)
 {
-    int ofd;
-    char ofile[256];
-    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
-    int res;
+    ssize_t res;
+    size_t i;
 
-    sprintf(ofile, "%s-%05d.ccnb", perfilestate->prefix, perfilestate->segnum);
-    ofd = open(ofile, O_CREAT | O_WRONLY | O_TRUNC, mode);
-    if (ofd == -1) {
-        perror("open");
-        return (1);
-    }
-    res = write(ofd, data, s);
-    close(ofd);
-    if (res != s) {
-        perror("write");
-        return (1);
+    for (i = 0; i < size; i += res) {
+        res = write(fd, buf + i, size - i);
+        if (res == -1) {
+            if (errno == EINTR)
+                res = 0;
+            else
+                return(-1);
+        }
     }
-    perfilestate->segnum++;
-    return (0);
+    return(0);
+}
+
+static size_t
+nth_object(struct fstate *st, size_t i)
+{
+    return(st->selected == NULL ? i : st->selected->buf[i]);
 }
 
+/**
+ * Write one output file, coalescing objects that are adjacent
+ * in the archive.
+ */
 static int
-process_test(unsigned char *data, size_t n, struct fstate *perfilestate)
+write_segment(struct ccn_archive *a, struct fstate *st, size_t segnum)
 {
-    struct ccn_skeleton_decoder skel_decoder = {0};
-    struct ccn_skeleton_decoder *d = &skel_decoder;
+    int ofd;
+    char ofile[256];
+    mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH;
+    const unsigned char *data = NULL;
+    const unsigned char *p;
+    size_t size = 0;
+    size_t n;
+    size_t i, end;
     int res = 0;
-    size_t s;
 
- retry:
-    s = ccn_skeleton_decode(d, data, n);
-    if (d->state < 0) {
-        res = 1;
-        fprintf(stderr, "error state %d after %d of %d chars\n",
-            (int)d->state, (int)s, (int)n);
-    }
-    else if (s == 0) {
-        fprintf(stderr, "nothing to do\n");
+    snprintf(ofile, sizeof(ofile), "%s-%05lu.ccnb", st->prefix, (unsigned long)segnum);
+    ofd = open(ofile, O_CREAT | O_WRONLY | O_TRUNC, mode);
+    if (ofd == -1) {
+        perror(ofile);
+        return (1);
     }
-    else {
-        if (s < n) {
-            if (write_segment(data, s, perfilestate) != 0) {
-                return (1);
-            }
-            /* fprintf(stderr, "resuming at index %d\n", (int)d->index); */
-            data += s;
-            n -= s;
-            goto retry;
+    end = (segnum + 1) * st->batch;
+    if (end > st->nobjects)
+        end = st->nobjects;
+    for (i = segnum * st->batch; i < end && res == 0; i++) {
+        ccn_archive_get(a, nth_object(st, i), &p, &n);
+        if (data != NULL && data + size == p) {
+            size += n;
+            continue;
         }
-        fprintf(stderr, "\n");
+        if (data != NULL)
+            res = write_full(ofd, data, size);
+        data = p;
+        size = n;
     }
-    if (!CCN_FINAL_DSTATE(d->state)) {
-        res = 1;
-        fprintf(stderr, "incomplete state %d after %d of %d chars\n",
-            (int)d->state, (int)s, (int)n);
-    } else  if (write_segment(data, s, perfilestate) != 0) {
-        res = 1;
-    }
-    return(res);
+    if (res == 0 && data != NULL)
+        res = write_full(ofd, data, size);
+    if (res != 0)
+        perror(ofile);
+    if (close(ofd) != 0)
+        res = -1;
+    return (res == 0 ? 0 : 1);
 }
 
 static int
-process_fd(int fd, struct fstate *perfilestate)
+split_worker(void *data, struct ccn_archive *a, size_t first, size_t count, int fd)
 {
-    unsigned char *buf;
-    ssize_t len;
-    struct stat s;
+    struct fstate *st = data;
+    size_t i;
     int res = 0;
 
-    res = fstat(fd, &s);
-    len = s.st_size;
-    buf = (unsigned char *)mmap((void *)NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
-    if (buf == (void *)-1) return (1);
-    fprintf(stderr, " <!-- input is %6lu bytes -->\n", (unsigned long)len);
-    res |= process_test(buf, len, perfilestate);
-    munmap((void *)buf, len);
+    for (i = first; i < first + count; i++)
+        res |= write_segment(a, st, i);
     return(res);
 }
 
-
 static int
-process_file(char *path, struct fstate *perfilestate)
+process_file(char *path, struct fstate *st, int flags, int workers,
+             struct ccn_charbuf *prefix)
 {
-    int fd;
+    struct ccn_archive *a;
+    size_t nseg;
     int res = 0;
 
-    fd = open(path, O_RDONLY);
-    if (-1 == fd) {
+    a = ccn_archive_open(path, flags);
+    if (a == NULL) {
         perror(path);
         return(1);
     }
-
-    perfilestate->segnum = 0;
-    if (perfilestate->prefix != NULL) free(perfilestate->prefix);
-    perfilestate->prefix = segment_prefix(path);
-
-    res = process_fd(fd, perfilestate);
-    if (fd > 0)
-        close(fd);
+    if (ccn_archive_unparsed(a) != 0) {
+        res = 1;
+        fprintf(stderr, "error or incomplete object after %lu objects, "
+                "%lu bytes left over\n", (unsigned long)ccn_archive_count(a),
+                (unsigned long)ccn_archive_unparsed(a));
+    }
+    if (st->prefix != NULL) free(st->prefix);
+    st->prefix = segment_prefix(path);
+    st->nobjects = ccn_archive_count(a);
+    if (prefix != NULL) {
+        st->selected->n = 0;
+        if (ccn_archive_select(a, prefix, workers, st->selected) < 0) {
+            fprintf(stderr, "%s: selection failed\n", path);
+            ccn_archive_close(&a);
+            return(1);
+        }
+        st->nobjects = st->selected->n;
+    }
+    nseg = (st->nobjects + st->batch - 1) / st->batch;
+    if (nseg == 0)
+        fprintf(stderr, "nothing to do\n");
+    else if (ccn_archive_run(a, nseg, workers, &split_worker, st, -1) < 0)
+        res = 1;
+    ccn_archive_close(&a);
     return(res);
 }
 
 int
 main(int argc, char *argv[])
 {
-    int i;
-    int res = 0;
+    const char *progname = argv[0];
     struct fstate perfilestate = {0};
+    struct ccn_charbuf *prefix = NULL;
+    int workers = default_workers();
+    int flags = 0;
+    int res = 0;
+    int opt;
+    int i;
 
-    for (i = 1; argv[i] != 0; i++) {
+    perfilestate.batch = 1;
+    while ((opt = getopt(argc, argv, "hij:n:p:")) != -1) {
+        switch (opt) {
+            case 'i':
+                flags |= CCN_ARCHIVE_KEEP_INDEX;
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                if (workers <= 0 || workers > CCN_ARCHIVE_MAX_WORKERS)
+                    usage(progname);
+                break;
+            case 'n':
+                if (atol(optarg) <= 0)
+                    usage(progname);
+                perfilestate.batch = atol(optarg);
+                break;
+            case 'p':
+                prefix = ccn_charbuf_create();
+                if (ccn_name_from_uri(prefix, optarg) < 0) {
+                    fprintf(stderr, "%s: bad ccn URI: %s\n", progname, optarg);
+                    exit(1);
+                }
+                perfilestate.selected = ccn_indexbuf_create();
+                break;
+            case 'h':
+            default:
+                usage(progname);
+        }
+    }
+    if (argv[optind] == NULL)
+        usage(progname);
+    for (i = optind; argv[i] != 0; i++) {
         fprintf(stderr, "<!-- Processing %s -->\n", argv[i]);
-        res |= process_file(argv[i], &perfilestate);
+        res |= process_file(argv[i], &perfilestate, flags, workers, prefix);
     }
+    free(perfilestate.prefix);
+    ccn_indexbuf_destroy(&perfilestate.selected);
+    ccn_charbuf_destroy(&prefix);
     return(res);
 }
-
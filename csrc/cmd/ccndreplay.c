@@ -0,0 +1,1011 @@
+/**
+ * @file ccndreplay.c
+ * Replays captured traffic against a local ccnd and measures it.
+ *
+ * The traces may be pcap captures, such as those written by tcpdump or
+ * ccndumppcap, or files of ccnb objects.  Each flow in a capture that
+ * was sending to the ccnd port becomes a new face to the local ccnd,
+ * over a unix-domain socket, udp, or tcp, and its messages are sent at
+ * their recorded times, at a multiple of that speed, or as fast as
+ * possible.  A ccnb trace has no timing, and is replayed with its
+ * Interests on one face and everything else on another.
+ *
+ * Reports the forwarding throughput, the latency of each Interest until
+ * content for it comes back on the same face, and what was dropped.
+ *
+ * A CCNx command-line utility.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+
+#if defined(NEED_GETADDRINFO_COMPAT)
+#include "getaddrinfo.h"
+#include "dummyin6.h"
+#endif
+
+#include <ccn/ccn.h>
+#include <ccn/ccnd.h>
+#include <ccn/ccn_private.h>
+#include <ccn/charbuf.h>
+#include <ccn/coding.h>
+#include <ccn/hashtb.h>
+#include <ccn/indexbuf.h>
+#include <ccn/random.h>
+
+/* pcap file header magic, as written by the capturing host */
+#define PCAP_MAGIC_USEC 0xa1b2c3d4U
+#define PCAP_MAGIC_NSEC 0xa1b23c4dU
+#define PCAP_HDR_LENGTH 24
+#define PCAP_REC_LENGTH 16
+
+/* the link types we can find IP in */
+#define LINKTYPE_NULL 0
+#define LINKTYPE_ETHERNET 1
+#define LINKTYPE_RAW 101
+#define LINKTYPE_LOOP 108
+#define LINKTYPE_LINUX_SLL 113
+
+#define TCP_FLAG_SYN 0x02
+
+#define REPLAY_KEEP_NONCES 1
+
+enum message_kind {
+    KIND_INTEREST,
+    KIND_CONTENT,
+    KIND_OTHER
+};
+
+struct packet {
+    int64_t t;              /**< microseconds from the start of the trace */
+    unsigned face;
+    enum message_kind kind;
+    size_t start;           /**< offset in replay data */
+    size_t size;
+};
+
+/**
+ * Key for the flows of a capture; any one source of traffic to ccnd.
+ */
+struct flow_key {
+    unsigned char proto;
+    unsigned char addr[16];
+    unsigned char port[2];
+};
+
+struct flow {
+    unsigned face;
+    int broken;             /**< lost our place in a tcp stream */
+    int seq_valid;
+    uint32_t next_seq;
+    struct ccn_skeleton_decoder decoder;
+    struct ccn_charbuf *partial;
+};
+
+struct face {
+    int fd;
+    int dgram;
+    struct ccn_skeleton_decoder decoder;
+    struct ccn_charbuf *inbuf;
+};
+
+/**
+ * An Interest that has been sent and not yet answered.
+ * The key is the face number followed by the ccnb Name.
+ */
+struct pending {
+    int64_t sent;
+    int64_t expiry;
+};
+
+struct counts {
+    unsigned long messages[3];      /* indexed by message_kind */
+    unsigned long skipped;          /* captured packets not to ccnd */
+    unsigned long unparsed;         /* bytes we could not frame */
+    unsigned long sent;
+    unsigned long sent_bytes;
+    unsigned long send_errors;
+    unsigned long received[3];
+    unsigned long received_bytes;
+    unsigned long satisfied;
+    unsigned long unsatisfied;
+    unsigned long repeated;         /* Interest sent while already pending */
+    unsigned long closed;           /* faces closed by ccnd */
+};
+
+struct replay {
+    int flags;
+    struct ccn_charbuf *data;       /* all the messages of the traces */
+    struct packet *packets;
+    size_t n_packets;
+    size_t packets_limit;
+    struct hashtb *flows;
+    unsigned n_faces;
+    int64_t toffset;                /* start of current trace file */
+    int64_t tend;                   /* latest time seen */
+    struct face *faces;
+    struct pollfd *pfds;
+    struct hashtb *pending;
+    struct ccn_charbuf *key;
+    struct ccn_indexbuf *comps;
+    unsigned *latency;              /* microseconds, one per satisfied */
+    size_t n_latency;
+    size_t latency_limit;
+    struct counts c;
+};
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-hn] [-t unix|udp|tcp] [-H host] [-s speed] [-w seconds]"
+            " [-P port] trace ...\n"
+            "   Replays pcap captures or ccnb files against a local ccnd"
+            " and reports\n"
+            "   throughput, Interest latency, and drops.\n"
+            "   -t transport  how to connect the replayed faces"
+            " (default unix)\n"
+            "   -H host       ccnd host for udp and tcp (default localhost)\n"
+            "   -s speed      multiple of the recorded speed, 0 for"
+            " as fast as possible\n"
+            "                 (default 1)\n"
+            "   -w seconds    time to wait for replies at the end"
+            " (default 4)\n"
+            "   -P port       the ccnd port in the captures (default %s)\n"
+            "   -n            keep the recorded Nonces instead of"
+            " making new ones\n",
+            progname, CCN_DEFAULT_UNICAST_PORT);
+    exit(1);
+}
+
+static int64_t
+now_us(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return((int64_t)tv.tv_sec * 1000000 + tv.tv_usec);
+}
+
+static uint32_t
+get32(const unsigned char *p, int swap)
+{
+    uint32_t v;
+
+    if (swap)
+        return(((uint32_t)p[3] << 24) | (p[2] << 16) | (p[1] << 8) | p[0]);
+    memcpy(&v, p, sizeof(v));
+    return(v);
+}
+
+static unsigned
+get16be(const unsigned char *p)
+{
+    return((p[0] << 8) | p[1]);
+}
+
+static uint32_t
+get32be(const unsigned char *p)
+{
+    return(((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]);
+}
+
+static enum message_kind
+message_kind(const unsigned char *msg, size_t size)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+
+    d = ccn_buf_decoder_start(&decoder, msg, size);
+    if (ccn_buf_match_dtag(d, CCN_DTAG_Interest))
+        return(KIND_INTEREST);
+    if (ccn_buf_match_dtag(d, CCN_DTAG_ContentObject))
+        return(KIND_CONTENT);
+    return(KIND_OTHER);
+}
+
+static void
+add_packet(struct replay *r, unsigned face, int64_t t,
+           const unsigned char *msg, size_t size)
+{
+    struct packet *p;
+
+    if (r->n_packets == r->packets_limit) {
+        r->packets_limit = 2 * r->packets_limit + 1024;
+        p = realloc(r->packets, r->packets_limit * sizeof(*p));
+        if (p == NULL) {
+            fprintf(stderr, "out of memory\n");
+            exit(1);
+        }
+        r->packets = p;
+    }
+    p = &r->packets[r->n_packets++];
+    p->t = t;
+    p->face = face;
+    p->kind = message_kind(msg, size);
+    p->start = r->data->length;
+    p->size = size;
+    ccn_charbuf_append(r->data, msg, size);
+    r->c.messages[p->kind]++;
+    if (t > r->tend)
+        r->tend = t;
+}
+
+/**
+ * Add a framed message, unwrapping a CCNProtocolDataUnit.
+ */
+static void
+add_message(struct replay *r, unsigned face, int64_t t,
+            const unsigned char *msg, size_t size)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+    size_t start;
+
+    d = ccn_buf_decoder_start(&decoder, msg, size);
+    if (!ccn_buf_match_dtag(d, CCN_DTAG_CCNProtocolDataUnit)) {
+        add_packet(r, face, t, msg, size);
+        return;
+    }
+    ccn_buf_advance(d);
+    while (ccn_buf_match_dtag(d, CCN_DTAG_Interest) ||
+           ccn_buf_match_dtag(d, CCN_DTAG_ContentObject)) {
+        start = d->decoder.token_index;
+        ccn_buf_advance_past_element(d);
+        if (d->decoder.state < 0)
+            break;
+        add_packet(r, face, t, msg + start, d->decoder.token_index - start);
+    }
+}
+
+static void
+reset_framing(struct flow *f)
+{
+    memset(&f->decoder, 0, sizeof(f->decoder));
+    f->partial->length = 0;
+}
+
+/**
+ * Frame the bytes sent by a flow into messages.
+ */
+static int
+frame_input(struct replay *r, struct flow *f, int64_t t,
+            const unsigned char *p, size_t n)
+{
+    struct ccn_skeleton_decoder *d = &f->decoder;
+    ssize_t m;
+
+    while (n > 0) {
+        m = ccn_skeleton_decode(d, p, n);
+        if (d->state < 0 || m <= 0) {
+            r->c.unparsed += f->partial->length + n;
+            reset_framing(f);
+            return(-1);
+        }
+        ccn_charbuf_append(f->partial, p, m);
+        p += m;
+        n -= m;
+        if (d->state == 0) {
+            add_message(r, f->face, t, f->partial->buf, f->partial->length);
+            reset_framing(f);
+        }
+    }
+    return(0);
+}
+
+static struct flow *
+get_flow(struct replay *r, int proto, const unsigned char *addr,
+         size_t addrlen, const unsigned char *port)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct flow_key key;
+    struct flow *f;
+
+    memset(&key, 0, sizeof(key));
+    key.proto = proto;
+    memcpy(key.addr, addr, addrlen);
+    memcpy(key.port, port, sizeof(key.port));
+    hashtb_start(r->flows, e);
+    if (hashtb_seek(e, &key, sizeof(key), 0) == HT_NEW_ENTRY) {
+        f = e->data;
+        f->face = r->n_faces++;
+        f->partial = ccn_charbuf_create();
+    }
+    f = e->data;
+    hashtb_end(e);
+    return(f);
+}
+
+/**
+ * Pick the ccnb out of one captured frame.
+ */
+static void
+add_frame(struct replay *r, int linktype, const unsigned char *p, size_t n,
+          int64_t t, unsigned port)
+{
+    const unsigned char *src;
+    size_t srclen;
+    unsigned ethertype;
+    unsigned len;
+    int proto;
+    int tcpflags = 0;
+    uint32_t seq = 0;
+    int32_t delta;
+    struct flow *f;
+
+    switch (linktype) {
+        case LINKTYPE_NULL:
+        case LINKTYPE_LOOP:
+            if (n < 4)
+                goto Skip;
+            p += 4, n -= 4;
+            break;
+        case LINKTYPE_ETHERNET:
+            if (n < 14)
+                goto Skip;
+            ethertype = get16be(p + 12);
+            p += 14, n -= 14;
+            while (ethertype == 0x8100 && n >= 4) { /* VLAN tags */
+                ethertype = get16be(p + 2);
+                p += 4, n -= 4;
+            }
+            if (ethertype != 0x0800 && ethertype != 0x86DD)
+                goto Skip;
+            break;
+        case LINKTYPE_LINUX_SLL:
+            if (n < 16)
+                goto Skip;
+            p += 16, n -= 16;
+            break;
+        case LINKTYPE_RAW:
+            break;
+        default:
+            goto Skip;
+    }
+    /* IP */
+    if (n >= 20 && (p[0] >> 4) == 4) {
+        len = (p[0] & 0xF) * 4;
+        if (get16be(p + 2) < n)
+            n = get16be(p + 2);
+        if (len < 20 || n < len || (get16be(p + 6) & 0x3FFF) != 0)
+            goto Skip; /* fragments are not reassembled */
+        proto = p[9];
+        src = p + 12;
+        srclen = 4;
+        p += len, n -= len;
+    }
+    else if (n >= 40 && (p[0] >> 4) == 6) {
+        if (get16be(p + 4) + 40 < n)
+            n = get16be(p + 4) + 40;
+        proto = p[6];
+        src = p + 8;
+        srclen = 16;
+        p += 40, n -= 40;
+    }
+    else
+        goto Skip;
+    /* UDP or TCP */
+    if (proto == IPPROTO_UDP && n >= 8) {
+        if (get16be(p + 4) < n)
+            n = get16be(p + 4);
+        len = 8;
+    }
+    else if (proto == IPPROTO_TCP && n >= 20) {
+        len = (p[12] >> 4) * 4;
+        seq = get32be(p + 4);
+        tcpflags = p[13];
+    }
+    else
+        goto Skip;
+    if (n < len || get16be(p + 2) != port)
+        goto Skip;
+    f = get_flow(r, proto, src, srclen, p);
+    p += len, n -= len;
+    if (proto == IPPROTO_UDP) {
+        /* each datagram holds whole messages */
+        if (frame_input(r, f, t, p, n) == 0 && f->partial->length > 0) {
+            r->c.unparsed += f->partial->length;
+            reset_framing(f);
+        }
+        return;
+    }
+    if ((tcpflags & TCP_FLAG_SYN) != 0) {
+        f->seq_valid = 1;
+        f->next_seq = seq + 1;
+        f->broken = 0;
+        reset_framing(f);
+        return;
+    }
+    if (n == 0)
+        return;
+    if (!f->seq_valid) {
+        f->seq_valid = 1;
+        f->next_seq = seq;
+    }
+    delta = seq - f->next_seq;
+    if (delta > 0) {
+        /* The capture missed some of the stream, so we can't find the
+           message boundaries again. */
+        f->broken = 1;
+        r->c.unparsed += n;
+        return;
+    }
+    if ((uint32_t)-delta >= n)
+        return; /* retransmission */
+    p += -delta, n -= -delta;
+    f->next_seq += n;
+    if (f->broken)
+        r->c.unparsed += n;
+    else if (frame_input(r, f, t, p, n) < 0)
+        f->broken = 1;
+    return;
+Skip:
+    r->c.skipped++;
+}
+
+static int
+load_pcap(struct replay *r, const unsigned char *p, size_t size, unsigned port)
+{
+    uint32_t magic = get32(p, 0);
+    int swap = 0;
+    int nsec = 0;
+    int linktype;
+    int64_t tbase = -1;
+    int64_t t;
+    size_t caplen;
+    size_t i;
+
+    if (magic == PCAP_MAGIC_NSEC || get32(p, 1) == PCAP_MAGIC_NSEC)
+        nsec = 1;
+    if (get32(p, 1) == PCAP_MAGIC_USEC || get32(p, 1) == PCAP_MAGIC_NSEC)
+        swap = 1;
+    linktype = get32(p + 20, swap);
+    for (i = PCAP_HDR_LENGTH; i + PCAP_REC_LENGTH <= size; i += caplen) {
+        caplen = get32(p + i + 8, swap);
+        t = (int64_t)get32(p + i, swap) * 1000000 +
+            (nsec ? get32(p + i + 4, swap) / 1000 : get32(p + i + 4, swap));
+        i += PCAP_REC_LENGTH;
+        if (caplen > size - i)
+            return(-1);
+        if (tbase < 0)
+            tbase = t;
+        add_frame(r, linktype, p + i, caplen, r->toffset + t - tbase, port);
+    }
+    return(0);
+}
+
+/**
+ * A ccnb trace has no timing or addresses; its Interests go out
+ * on one face and everything else on another.
+ */
+static int
+load_ccnb(struct replay *r, const unsigned char *p, size_t size)
+{
+    struct ccn_skeleton_decoder decoder;
+    struct ccn_skeleton_decoder *d = &decoder;
+    unsigned face = r->n_faces;
+    size_t i;
+    ssize_t m;
+
+    r->n_faces += 2;
+    for (i = 0; i < size; i += m) {
+        memset(d, 0, sizeof(*d));
+        m = ccn_skeleton_decode(d, p + i, size - i);
+        if (d->state != 0 || m <= 0) {
+            r->c.unparsed += size - i;
+            return(-1);
+        }
+        add_message(r, face + (message_kind(p + i, m) != KIND_INTEREST),
+                    r->toffset, p + i, m);
+    }
+    return(0);
+}
+
+static int
+load_trace(struct replay *r, const char *path, unsigned port)
+{
+    const unsigned char *p;
+    struct stat st;
+    uint32_t magic;
+    int res;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &st) == -1) {
+        perror(path);
+        if (fd != -1)
+            close(fd);
+        return(-1);
+    }
+    if (st.st_size == 0) {
+        close(fd);
+        return(0);
+    }
+    p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        perror(path);
+        return(-1);
+    }
+    magic = (st.st_size >= PCAP_HDR_LENGTH) ? get32(p, 0) : 0;
+    if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC ||
+        (st.st_size >= PCAP_HDR_LENGTH &&
+         (get32(p, 1) == PCAP_MAGIC_USEC || get32(p, 1) == PCAP_MAGIC_NSEC)))
+        res = load_pcap(r, p, st.st_size, port);
+    else
+        res = load_ccnb(r, p, st.st_size);
+    if (res < 0)
+        fprintf(stderr, "%s: trace is truncated or not ccnb\n", path);
+    munmap((void *)p, st.st_size);
+    /* the next trace starts where this one ended */
+    r->toffset = r->tend;
+    return(0);
+}
+
+static int
+open_face(const char *transport, const char *host, const char *portstr)
+{
+    struct sockaddr_un sa = {0};
+    struct addrinfo hints = {0};
+    struct addrinfo *ai = NULL;
+    int sock_type = SOCK_STREAM;
+    int sock;
+    int res;
+
+    if (strcmp(transport, "unix") == 0) {
+        ccn_setup_sockaddr_un(portstr, &sa);
+        sock = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (sock == -1)
+            return(-1);
+        res = connect(sock, (struct sockaddr *)&sa, sizeof(sa));
+    }
+    else {
+        if (strcmp(transport, "udp") == 0)
+            sock_type = SOCK_DGRAM;
+        if (portstr == NULL || portstr[0] == 0)
+            portstr = CCN_DEFAULT_UNICAST_PORT;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = sock_type;
+        res = getaddrinfo(host, portstr, &hints, &ai);
+        if (res != 0 || ai == NULL) {
+            fprintf(stderr, "getaddrinfo(\"%s\", \"%s\", ...): %s\n",
+                    host, portstr, gai_strerror(res));
+            return(-1);
+        }
+        sock = socket(ai->ai_family, ai->ai_socktype, 0);
+        if (sock == -1) {
+            freeaddrinfo(ai);
+            return(-1);
+        }
+        res = connect(sock, ai->ai_addr, ai->ai_addrlen);
+        freeaddrinfo(ai);
+    }
+    if (res == -1) {
+        close(sock);
+        return(-1);
+    }
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+    return(sock);
+}
+
+static void
+add_latency(struct replay *r, int64_t dt)
+{
+    unsigned *l;
+
+    if (r->n_latency == r->latency_limit) {
+        r->latency_limit = 2 * r->latency_limit + 1024;
+        l = realloc(r->latency, r->latency_limit * sizeof(*l));
+        if (l == NULL)
+            return;
+        r->latency = l;
+    }
+    r->latency[r->n_latency++] = dt;
+}
+
+/**
+ * Satisfy the pending Interests from this face that the content matches.
+ *
+ * An Interest's name is a prefix of the content name, so we look up each
+ * prefix of that name.  Selectors are not considered.
+ */
+static void
+match_pending(struct replay *r, unsigned face,
+              const unsigned char *msg, size_t size)
+{
+    struct ccn_parsed_ContentObject pco;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ccn_charbuf *key = r->key;
+    struct ccn_indexbuf *comps = r->comps;
+    size_t hdrlen;
+    int64_t t;
+    int n;
+    int i;
+
+    if (ccn_parse_ContentObject(msg, size, &pco, comps) < 0)
+        return;
+    n = comps->n - 1;
+    t = now_us();
+    key->length = 0;
+    ccn_charbuf_append(key, &face, sizeof(face));
+    ccn_charbuf_append(key, msg + pco.offset[CCN_PCO_B_Name],
+                       comps->buf[0] - pco.offset[CCN_PCO_B_Name]);
+    hdrlen = key->length;
+    for (i = n; i >= 0; i--) {
+        key->length = hdrlen;
+        ccn_charbuf_append(key, msg + comps->buf[0],
+                           comps->buf[i] - comps->buf[0]);
+        ccn_charbuf_append_closer(key);
+        if (hashtb_lookup(r->pending, key->buf, key->length) == NULL)
+            continue;
+        hashtb_start(r->pending, e);
+        hashtb_seek(e, key->buf, key->length, 0);
+        add_latency(r, t - ((struct pending *)e->data)->sent);
+        r->c.satisfied++;
+        hashtb_delete(e);
+        hashtb_end(e);
+    }
+}
+
+static void
+process_incoming(struct replay *r, unsigned face,
+                 const unsigned char *msg, size_t size)
+{
+    enum message_kind kind = message_kind(msg, size);
+
+    r->c.received[kind]++;
+    r->c.received_bytes += size;
+    if (kind == KIND_CONTENT)
+        match_pending(r, face, msg, size);
+}
+
+static void
+close_face(struct replay *r, unsigned i)
+{
+    close(r->faces[i].fd);
+    r->faces[i].fd = -1;
+    r->pfds[i].fd = -1;
+    r->c.closed++;
+}
+
+/**
+ * Read what ccnd has sent on a face, framed as ccnd frames its input.
+ */
+static void
+read_face(struct replay *r, unsigned i)
+{
+    struct face *face = &r->faces[i];
+    struct ccn_skeleton_decoder *d = &face->decoder;
+    struct ccn_charbuf *c = face->inbuf;
+    unsigned char *buf;
+    size_t msgstart = 0;
+    ssize_t res;
+
+    if (c->length == 0)
+        memset(d, 0, sizeof(*d));
+    buf = ccn_charbuf_reserve(c, 8800);
+    res = recv(face->fd, buf, c->limit - c->length, 0);
+    if (res == -1 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return;
+    if (res == -1 || (res == 0 && !face->dgram)) {
+        close_face(r, i);
+        return;
+    }
+    c->length += res;
+    ccn_skeleton_decode(d, c->buf + d->index, c->length - d->index);
+    while (d->state == 0) {
+        process_incoming(r, i, c->buf + msgstart, d->index - msgstart);
+        msgstart = d->index;
+        if (msgstart == c->length) {
+            c->length = 0;
+            return;
+        }
+        ccn_skeleton_decode(d, c->buf + d->index, c->length - d->index);
+    }
+    if (face->dgram || d->state < 0) {
+        r->c.unparsed += c->length - msgstart;
+        c->length = 0;
+        return;
+    }
+    if (msgstart > 0) {
+        memmove(c->buf, c->buf + msgstart, c->length - msgstart);
+        c->length -= msgstart;
+        d->index -= msgstart;
+    }
+}
+
+/**
+ * Take in whatever has arrived, waiting up to timeout_ms.
+ * @returns nonzero if the face numbered writer (if any) may be written.
+ */
+static int
+poll_faces(struct replay *r, int timeout_ms, int writer)
+{
+    unsigned i;
+    int res;
+
+    if (writer >= 0)
+        r->pfds[writer].events = POLLIN | POLLOUT;
+    res = poll(r->pfds, r->n_faces, timeout_ms);
+    if (writer >= 0)
+        r->pfds[writer].events = POLLIN;
+    if (res <= 0)
+        return(0);
+    for (i = 0; i < r->n_faces; i++)
+        if ((r->pfds[i].revents & (POLLIN | POLLERR | POLLHUP)) != 0)
+            read_face(r, i);
+    return(writer >= 0 && r->pfds[writer].fd != -1 &&
+           (r->pfds[writer].revents & POLLOUT) != 0);
+}
+
+static int
+send_message(struct replay *r, unsigned i, const unsigned char *msg, size_t size)
+{
+    struct face *face = &r->faces[i];
+    size_t n = 0;
+    ssize_t res;
+
+    while (n < size) {
+        if (face->fd == -1)
+            return(-1);
+        res = send(face->fd, msg + n, size - n, 0);
+        if (res >= 0)
+            n += res;
+        else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            poll_faces(r, 100, i);
+        else
+            return(-1);
+    }
+    return(0);
+}
+
+/**
+ * Note an Interest as pending on its face, giving it a fresh Nonce
+ * unless asked not to.
+ */
+static void
+note_interest(struct replay *r, unsigned face, unsigned char *msg,
+              size_t size, int64_t t)
+{
+    struct ccn_parsed_interest parsed_interest = {0};
+    struct ccn_parsed_interest *pi = &parsed_interest;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct pending *p;
+    const unsigned char *nonce = NULL;
+    size_t nonce_size = 0;
+    int res;
+
+    if (ccn_parse_interest(msg, size, pi, NULL) < 0)
+        return;
+    if ((r->flags & REPLAY_KEEP_NONCES) == 0 &&
+        ccn_ref_tagged_BLOB(CCN_DTAG_Nonce, msg,
+                            pi->offset[CCN_PI_B_Nonce],
+                            pi->offset[CCN_PI_E_Nonce],
+                            &nonce, &nonce_size) == 0)
+        ccn_random_bytes(msg + (nonce - msg), nonce_size);
+    r->key->length = 0;
+    ccn_charbuf_append(r->key, &face, sizeof(face));
+    ccn_charbuf_append(r->key, msg + pi->offset[CCN_PI_B_Name],
+                       pi->offset[CCN_PI_E_Name] - pi->offset[CCN_PI_B_Name]);
+    hashtb_start(r->pending, e);
+    res = hashtb_seek(e, r->key->buf, r->key->length, 0);
+    p = e->data;
+    if (res == HT_OLD_ENTRY) {
+        if (t < p->expiry)
+            r->c.repeated++;
+        else {
+            /* ccnd has forgotten the earlier one by now */
+            r->c.unsatisfied++;
+            res = HT_NEW_ENTRY;
+        }
+    }
+    if (res == HT_NEW_ENTRY) {
+        p->sent = t;
+        p->expiry = t + ccn_interest_lifetime(msg, pi) * 1000000 / 4096;
+    }
+    hashtb_end(e);
+}
+
+static void
+replay(struct replay *r, double speed)
+{
+    struct packet *pk;
+    unsigned char *msg;
+    int64_t start;
+    int64_t due;
+    int64_t t;
+    size_t i;
+
+    start = now_us();
+    for (i = 0; i < r->n_packets; i++) {
+        pk = &r->packets[i];
+        msg = r->data->buf + pk->start;
+        if (speed > 0) {
+            due = start + (int64_t)(pk->t / speed);
+            for (t = now_us(); t < due; t = now_us())
+                poll_faces(r, (due - t) / 1000, -1);
+        }
+        else if ((i & 63) == 0)
+            poll_faces(r, 0, -1);
+        if (pk->kind == KIND_INTEREST)
+            note_interest(r, pk->face, msg, pk->size, now_us());
+        if (send_message(r, pk->face, msg, pk->size) < 0)
+            r->c.send_errors++;
+        else {
+            r->c.sent++;
+            r->c.sent_bytes += pk->size;
+        }
+    }
+}
+
+static int
+compare_unsigned(const void *a, const void *b)
+{
+    unsigned x = *(const unsigned *)a;
+    unsigned y = *(const unsigned *)b;
+
+    return((x > y) - (x < y));
+}
+
+static double
+percentile(struct replay *r, double q)
+{
+    if (r->n_latency == 0)
+        return(0);
+    return(r->latency[(size_t)(q * (r->n_latency - 1))] / 1000.0);
+}
+
+static void
+report(struct replay *r, const char *transport, double speed,
+       double send_time, double total_time)
+{
+    struct counts *c = &r->c;
+    unsigned long drops;
+
+    qsort(r->latency, r->n_latency, sizeof(r->latency[0]), &compare_unsigned);
+    printf("trace: %lu interests, %lu content objects, %lu other"
+           " on %u faces, %.3f s recorded",
+           c->messages[KIND_INTEREST], c->messages[KIND_CONTENT],
+           c->messages[KIND_OTHER], r->n_faces, r->tend / 1.0e6);
+    printf(" (%lu packets skipped, %lu bytes unparsed)\n",
+           c->skipped, c->unparsed);
+    if (speed > 0)
+        printf("replay: %s at %gx recorded speed\n", transport, speed);
+    else
+        printf("replay: %s as fast as possible\n", transport);
+    printf("sent: %lu messages, %lu bytes in %.3f s,"
+           " %.0f msg/s, %.2f MB/s\n",
+           c->sent, c->sent_bytes, send_time,
+           send_time > 0 ? c->sent / send_time : 0,
+           send_time > 0 ? c->sent_bytes / send_time / 1.0e6 : 0);
+    printf("received: %lu content objects, %lu interests, %lu other,"
+           " %lu bytes in %.3f s, %.0f msg/s\n",
+           c->received[KIND_CONTENT], c->received[KIND_INTEREST],
+           c->received[KIND_OTHER], c->received_bytes, total_time,
+           total_time > 0 ? (c->received[KIND_CONTENT] +
+                             c->received[KIND_INTEREST] +
+                             c->received[KIND_OTHER]) / total_time : 0);
+    printf("interests: %lu satisfied, %lu unsatisfied, %lu repeated"
+           " while pending\n", c->satisfied, c->unsatisfied, c->repeated);
+    printf("latency ms: min %.3f p50 %.3f p90 %.3f p99 %.3f"
+           " p99.9 %.3f max %.3f\n",
+           percentile(r, 0), percentile(r, 0.5), percentile(r, 0.9),
+           percentile(r, 0.99), percentile(r, 0.999), percentile(r, 1));
+    drops = c->unsatisfied + c->send_errors;
+    printf("drops: %lu (%lu unsatisfied interests, %lu send errors,"
+           " %lu faces closed by ccnd)\n",
+           drops, c->unsatisfied, c->send_errors, c->closed);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct replay rr = {0};
+    struct replay *r = &rr;
+    const char *transport = "unix";
+    const char *host = "localhost";
+    const char *portstr;
+    unsigned port = atoi(CCN_DEFAULT_UNICAST_PORT);
+    double speed = 1;
+    double drain = 4;
+    int64_t t0, t1, t2;
+    unsigned i;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "hnt:H:s:w:P:")) != -1) {
+        switch (opt) {
+            case 'n':
+                r->flags |= REPLAY_KEEP_NONCES;
+                break;
+            case 't':
+                transport = optarg;
+                if (strcmp(transport, "unix") != 0 &&
+                    strcmp(transport, "udp") != 0 &&
+                    strcmp(transport, "tcp") != 0)
+                    usage(argv[0]);
+                break;
+            case 'H':
+                host = optarg;
+                break;
+            case 's':
+                speed = atof(optarg);
+                break;
+            case 'w':
+                drain = atof(optarg);
+                break;
+            case 'P':
+                port = atoi(optarg);
+                break;
+            case 'h':
+            default:
+                usage(argv[0]);
+        }
+    }
+    if (argv[optind] == NULL || speed < 0 || drain < 0)
+        usage(argv[0]);
+    r->data = ccn_charbuf_create();
+    r->flows = hashtb_create(sizeof(struct flow), NULL);
+    r->pending = hashtb_create(sizeof(struct pending), NULL);
+    r->key = ccn_charbuf_create();
+    r->comps = ccn_indexbuf_create();
+    for (i = optind; argv[i] != NULL; i++)
+        if (load_trace(r, argv[i], port) < 0)
+            exit(1);
+    if (r->n_packets == 0) {
+        fprintf(stderr, "%s: nothing to replay\n", argv[0]);
+        exit(1);
+    }
+    portstr = getenv(CCN_LOCAL_PORT_ENVNAME);
+    r->faces = calloc(r->n_faces, sizeof(r->faces[0]));
+    r->pfds = calloc(r->n_faces, sizeof(r->pfds[0]));
+    for (i = 0; i < r->n_faces; i++) {
+        r->faces[i].fd = open_face(transport, host, portstr);
+        if (r->faces[i].fd == -1) {
+            fprintf(stderr, "%s: cannot open face %u of %u to ccnd: %s\n",
+                    argv[0], i + 1, r->n_faces, strerror(errno));
+            exit(1);
+        }
+        r->faces[i].dgram = (strcmp(transport, "udp") == 0);
+        r->faces[i].inbuf = ccn_charbuf_create();
+        r->pfds[i].fd = r->faces[i].fd;
+        r->pfds[i].events = POLLIN;
+    }
+    t0 = now_us();
+    replay(r, speed);
+    t1 = now_us();
+    for (t2 = t1; t2 < t1 + drain * 1e6 && hashtb_n(r->pending) > 0;
+         t2 = now_us())
+        poll_faces(r, 10, -1);
+    r->c.unsatisfied += hashtb_n(r->pending);
+    report(r, transport, speed, (t1 - t0) / 1.0e6, (t2 - t0) / 1.0e6);
+    exit(0);
+}
@@ -52,6 +52,7 @@
 #define MAX_PACKET 65536
 #define DEFAULT_SRC_PORT 55555
 #define DEFAULT_DEST_PORT CCN_DEFAULT_UNICAST_PORT_NUMBER
+#define FLUSH_INTERVAL 1024 /* packets between flushes of the dump */
 
 static void
 usage(const char *progname)
@@ -75,6 +76,7 @@ dump_udp_packet(pcap_dumper_t *dump_file,
                                                            just be contents */
                 struct timeval *ts) { /* timing info */
 
+    static unsigned long dumped = 0;
     unsigned char pktbuf[MAX_PACKET];
     uint32_t llc_val = PF_INET; // in host byte order
 
@@ -128,6 +130,9 @@ dump_udp_packet(pcap_dumper_t *dump_file,
 
     pcap_dump((unsigned char *)dump_file, &pcap_header, &pktbuf[0]);
 
+    /* pcap_dump_close flushes whatever is left at the end */
+    if (++dumped % FLUSH_INTERVAL != 0)
+        return 0;
     if (0 != pcap_dump_flush(dump_file)) {
         fprintf(stderr, "Error flushing pcap dump...\n");
         return -1;
@@ -3,6 +3,8 @@
  * 
  * Utility program to record a file's size
  *
+ * Changes are picked up as they happen, using ccn_filewatch; where that
+ * is not supported, the file is polled instead.
  */
 
 /*
@@ -31,6 +33,7 @@
 #include <sys/poll.h>
 #include <sys/stat.h>
 #include <sys/time.h>
+#include <ccn/filewatch.h>
 
 static int
 usage(const char *progname) {
@@ -72,6 +75,117 @@ printstat(FILE *out, struct stat *s)
             );
 }
 
+static long
+msec_since(const struct timeval *t)
+{
+    struct timeval now;
+    
+    gettimeofday(&now, NULL);
+    return((now.tv_sec - t->tv_sec) * 1000L +
+           (now.tv_usec - t->tv_usec) / 1000);
+}
+
+static void
+note_event(void *data, const char *path, int kind)
+{
+    int *events = data;
+    
+    (*events)++;
+}
+
+/**
+ * Wait for the file to settle, acting on change events.
+ *
+ * Arguments and return values are as for ccn_filewatch, except that
+ * -5 means change events are not available on this system.
+ */
+static int
+watch_events(const char *path,
+             FILE *out,
+             off_t minsize,
+             off_t maxsize,
+             time_t maxsec,
+             int msecstable)
+{
+    struct ccn_filewatch *w = NULL;
+    struct stat curr = {0};
+    struct stat prev = {0};
+    struct stat statname = {0};
+    struct pollfd fds[1];
+    struct timeval start;
+    struct timeval changed;
+    long timeout;
+    long left;
+    int events = 0;
+    int fd = -1;
+    int res = 0;
+    
+    w = ccn_filewatch_create(0);
+    if (w == NULL)
+        return(-5);
+    fd = open(path, O_RDONLY, 0);
+    if (fd < 0 || ccn_filewatch_add(w, path) < 0 || fstat(fd, &curr) < 0) {
+        res = -1;
+        goto Finish;
+    }
+    printstat(out, &curr);
+    prev = curr;
+    gettimeofday(&start, NULL);
+    changed = start;
+    for (;;) {
+        if (maxsize != 0 && curr.st_size > maxsize) {
+            res = -2;
+            break;
+        }
+        left = maxsec * 1000L - msec_since(&start);
+        if (left < 0) {
+            res = -3;
+            break;
+        }
+        timeout = msecstable - msec_since(&changed);
+        if (timeout <= 0) {
+            if (curr.st_size >= minsize) {
+                res = 0;
+                break;
+            }
+            timeout = left; /* too small, so wait for it to grow */
+        }
+        if (timeout > left)
+            timeout = left;
+        fds[0].fd = ccn_filewatch_fd(w);
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        res = poll(fds, 1, timeout + 1);
+        if (res < 0 && errno != EINTR)
+            break;
+        events = 0;
+        ccn_filewatch_process(w, &note_event, &events);
+        if (events == 0)
+            continue;
+        res = stat(path, &statname);
+        if (res < 0 ||
+            statname.st_dev != curr.st_dev ||
+            statname.st_ino != curr.st_ino) {
+            res = -4;
+            break;
+        }
+        res = fstat(fd, &curr);
+        if (res == -1)
+            break;
+        if (statchanged(&prev, &curr)) {
+            printstat(out, &curr);
+            prev = curr;
+            gettimeofday(&changed, NULL);
+        }
+    }
+Finish:
+    if (fd >= 0)
+        close(fd);
+    ccn_filewatch_destroy(&w);
+    fflush(out);
+    return(res);
+}
+
 /**
  * Monitor the size of the named file, recording its growth
  *
@@ -84,7 +198,8 @@ printstat(FILE *out, struct stat *s)
  * @param maxsize is threshold beyond which we stop monitoring
  * @param maxsec is a limit, in seconds, on how long to monitor
  * @param msecstable is a time in milliseconds to consider file size stable
- * @param msecpoll is the delay, in milliseconds, between polls.
+ * @param msecpoll is the delay, in milliseconds, between polls, where
+ *        change events are not available.
  *
  * @returns 0 if stability was obtained within given parameters,
  *         -1 if system call failed or invaild arguments (see errno),
@@ -122,6 +237,9 @@ ccn_filewatch(const char *path,
         return(-1);
     if (msecstable < 1)
         return(-1);
+    res = watch_events(path, out, minsize, maxsize, maxsec, msecstable);
+    if (res != -5)
+        return(res);
     fd = open(path, O_RDONLY, 0);
     if (fd < 0)
         return(-1);
@@ -20,6 +20,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <unistd.h>
 #include <errno.h>
 #include <pwd.h>
@@ -34,12 +35,14 @@ static void
 usage(const char *progname)
 {
     fprintf(stderr,
-            "%s [-h] [-f] [-u username] [-l keylength] [-v validity] [directory]\n"
+            "%s [-h] [-f] [-u username] [-t rsa|ec] [-l keylength] [-v validity] [directory]\n"
             "   Initialize a CCNx keystore with given parameters\n", progname);
     fprintf(stderr,
             "   -h  Display this help message.\n"
             "   -f  Force overwriting an existing keystore. Default no overwrite permitted.\n" 
             "   -u username  Username for this keystore.  Default username of effective uid.\n"
+            "   -t type  Type of key to be generated, rsa or ec (ECDSA P-256).  Default rsa.\n"
+            "            EC keys are much faster to sign with.\n"
             "   -l keylength  Length of RSA key to be generated.  Default 1024 bits.\n"
             "   -v validity  Number of days that certificate should be valid.  Default 30.\n"
             "   directory  Directory in which to create .ccnx/.ccnx_keystore. Default $HOME.\n"
@@ -59,9 +62,10 @@ main(int argc, char **argv)
     char useruid[32];
     struct passwd *pwd = NULL;
     int keylength = 0;
+    enum ccn_keystore_key_type key_type = CCN_KEYSTORE_KEY_RSA;
     int validity = 0;
     
-    while ((opt = getopt(argc, argv, "hfu:p:l:v:")) != -1) {
+    while ((opt = getopt(argc, argv, "hfu:p:t:l:v:")) != -1) {
         switch (opt) {
             case 'f':
                 force = 1;
@@ -69,13 +73,19 @@ main(int argc, char **argv)
             case 'u':
                 user = optarg;
                 break;
-            case 'l':
-                keylength = atoi(optarg);
-                if (keylength < 512) {
-                    fprintf(stderr, "%d: Key length too short for signing CCNx objects.\n", keylength);
+            case 't':
+                if (strcasecmp(optarg, "rsa") == 0)
+                    key_type = CCN_KEYSTORE_KEY_RSA;
+                else if (strcasecmp(optarg, "ec") == 0)
+                    key_type = CCN_KEYSTORE_KEY_EC;
+                else {
+                    fprintf(stderr, "%s: Unknown key type.\n", optarg);
                     exit(1);
                 }
                 break;
+            case 'l':
+                keylength = atoi(optarg);
+                break;
             case 'v':
                 validity = atoi(optarg);
                 if (validity < 0) {
@@ -89,6 +99,14 @@ main(int argc, char **argv)
                 exit(1);
         }
     }
+    if (key_type == CCN_KEYSTORE_KEY_RSA && keylength != 0 && keylength < 512) {
+        fprintf(stderr, "%d: Key length too short for signing CCNx objects.\n", keylength);
+        exit(1);
+    }
+    if (key_type == CCN_KEYSTORE_KEY_EC && keylength != 0 && keylength != 256) {
+        fprintf(stderr, "%d: EC keys are 256 bits.\n", keylength);
+        exit(1);
+    }
     dir = argv[optind];
     if (dir == NULL){
         dir = getenv("HOME");
@@ -133,13 +151,14 @@ main(int argc, char **argv)
             user = useruid;
         }
     }
-    res = ccn_keystore_file_init(ccn_charbuf_as_string(keystore), CCN_KEYSTORE_PASS,
-                                 user, keylength, validity);
+    res = ccn_keystore_file_init_type(ccn_charbuf_as_string(keystore),
+                                      CCN_KEYSTORE_PASS, user, key_type,
+                                      keylength, validity);
     if (res != 0) {
         if (errno != 0)
             perror(ccn_charbuf_as_string(keystore));
         else
-            fprintf(stderr, "ccn_keystore_file_init: invalid argument\n");
+            fprintf(stderr, "ccn_keystore_file_init_type: invalid argument\n");
         exit(1);
     }
     return(0);
@@ -1,11 +1,10 @@
 /**
- * @file ccn_splitccnb.c
- * Utility to break up a file filled with ccnb-encoded data items into
- * one data item per file.
+ * @file ccnnamelist.c
+ * Utility to list the names of the ccnb-encoded objects in files.
  *
  * A CCNx command-line utility.
  *
- * Copyright (C) 2008, 2009 Palo Alto Research Center, Inc.
+ * Copyright (C) 2008, 2009, 2012 Palo Alto Research Center, Inc.
  *
  * This work is free software; you can redistribute it and/or modify it under
  * the terms of the GNU General Public License version 2 as published by the
@@ -19,10 +18,10 @@
  * Boston, MA 02110-1301, USA.
  */
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
-#include <sys/mman.h>
 #include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
@@ -30,15 +29,52 @@
 #include <string.h>
 #include <unistd.h>
 
+#include <ccn/archive.h>
+#include <ccn/charbuf.h>
 #include <ccn/coding.h>
 #include <ccn/uri.h>
 
+/* Below this many objects per worker, forking costs more than it saves */
+#define MIN_OBJECTS_PER_WORKER 4096
+
+struct options {
+    struct ccn_charbuf *prefix; /* only names under this, if not NULL */
+    int flags;                  /* for ccn_archive_open */
+    int workers;
+};
+
+static int
+default_workers(void)
+{
+    long n = -1;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        return(1);
+    if (n > CCN_ARCHIVE_MAX_WORKERS)
+        return(CCN_ARCHIVE_MAX_WORKERS);
+    return(n);
+}
+
+static void
+append_name(struct ccn_charbuf *c, const unsigned char *data, size_t size,
+            struct options *opt)
+{
+    if (opt->prefix != NULL &&
+        !ccn_archive_object_has_prefix(data, size, opt->prefix))
+        return;
+    ccn_uri_append(c, data, size, 1);
+    ccn_charbuf_append(c, "\n", 1);
+}
+
 /* returns
  *  res >= 0    res characters remaining to be processed from data
  *  decoder state will be set appropriately   
  */
 static size_t
-process_data(struct ccn_skeleton_decoder *d, unsigned char *data, size_t n, struct ccn_charbuf *c)
+process_data(struct ccn_skeleton_decoder *d, unsigned char *data, size_t n,
+             struct ccn_charbuf *c, struct options *opt)
 {
     size_t s;
     
@@ -48,8 +84,8 @@ retry:
         return (0);
     if (CCN_FINAL_DSTATE(d->state)) {
         c->length = 0;
-        ccn_uri_append(c, data, s, 1);
-        printf("%s\n", ccn_charbuf_as_string(c));
+        append_name(c, data, s, opt);
+        fwrite(c->buf, 1, c->length, stdout);
         data += s;
         n -= s;
         if (n > 0) goto retry;
@@ -58,44 +94,87 @@ retry:
 }
 
 static int
-process_fd(int fd, struct ccn_charbuf *c)
+write_full(int fd, const unsigned char *buf, size_t size)
+{
+    ssize_t res;
+    size_t i;
+
+    for (i = 0; i < size; i += res) {
+        res = write(fd, buf + i, size - i);
+        if (res == -1) {
+            if (errno == EINTR)
+                res = 0;
+            else
+                return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+names_worker(void *data, struct ccn_archive *a, size_t first, size_t count, int fd)
+{
+    struct options *opt = data;
+    struct ccn_charbuf *c = ccn_charbuf_create();
+    const unsigned char *p;
+    size_t size;
+    size_t i;
+    int res = 0;
+
+    for (i = first; i < first + count && res == 0; i++) {
+        ccn_archive_get(a, i, &p, &size);
+        append_name(c, p, size, opt);
+        if (c->length >= 65536 || i + 1 == first + count) {
+            res = write_full(fd, c->buf, c->length);
+            c->length = 0;
+        }
+    }
+    ccn_charbuf_destroy(&c);
+    return(res);
+}
+
+/**
+ * List the names from a regular file, dividing the objects
+ * among several processes.
+ */
+static int
+process_archive(struct ccn_archive *a, struct options *opt)
+{
+    size_t count = ccn_archive_count(a);
+    int workers = opt->workers;
+
+    if (workers > count / MIN_OBJECTS_PER_WORKER)
+        workers = count / MIN_OBJECTS_PER_WORKER;
+    fflush(stdout);
+    if (ccn_archive_run(a, count, workers, &names_worker, opt, STDOUT_FILENO) < 0) {
+        perror("write");
+        return(1);
+    }
+    if (ccn_archive_unparsed(a) != 0) {
+        fprintf(stderr, "%s state after %lu objects, %lu bytes left over\n",
+                "error or incomplete", (unsigned long)count,
+                (unsigned long)ccn_archive_unparsed(a));
+        return(1);
+    }
+    return(0);
+}
+
+static int
+process_fd(int fd, struct ccn_charbuf *c, struct options *opt)
 {
     struct ccn_skeleton_decoder skel_decoder = {0};
     struct ccn_skeleton_decoder *d = &skel_decoder;
     unsigned char *bufp;
     unsigned char buf[1024 * 1024];
     ssize_t len;
-    struct stat s;
     size_t res = 0;
     
-    if (0 != fstat(fd, &s)) {
-        perror("fstat");
-        return(1);
-    }
-    
-    if (S_ISREG(s.st_mode)) {
-        res = s.st_size;
-        bufp = (unsigned char *)mmap((void *)NULL, res,
-                                     PROT_READ, MAP_PRIVATE, fd, 0);
-        if (bufp != (void *)-1) {
-            res = process_data(d, bufp, res, c);
-            if (!CCN_FINAL_DSTATE(d->state)) {
-                fprintf(stderr, "%s state %d after %lu bytes\n",
-                        (d->state < 0) ? "error" : "incomplete",
-                        (int)d->state,
-                        (unsigned long)d->index);
-                return(1);
-            }
-            return(0);
-        }
-    }
-    
-    /* either not a regular file amenable to mapping, or the map failed */
+    /* not a regular file amenable to mapping */
     bufp = &buf[0];
     res = 0;
     while ((len = read(fd, bufp + res, sizeof(buf) - res)) > 0) {
         len += res;
-        res = process_data(d, bufp, len, c);
+        res = process_data(d, bufp, len, c, opt);
         if (d->state < 0) {
             fprintf(stderr, "error state %d\n", (int)d->state);
             return(1);
@@ -117,13 +196,20 @@ process_fd(int fd, struct ccn_charbuf *c)
 
 
 static int
-process_file(char *path, struct ccn_charbuf *c)
+process_file(char *path, struct ccn_charbuf *c, struct options *opt)
 {
+    struct ccn_archive *a = NULL;
     int fd = -1;
     int res = 0;
     if (strcmp(path, "-") == 0) {
         fd = STDIN_FILENO;
     } else {
+        a = ccn_archive_open(path, opt->flags);
+        if (a != NULL) {
+            res = process_archive(a, opt);
+            ccn_archive_close(&a);
+            return(res);
+        }
         fd = open(path, O_RDONLY);
         if (-1 == fd) {
             perror(path);
@@ -131,7 +217,8 @@ process_file(char *path, struct ccn_charbuf *c)
         }
         
     }
-    res = process_fd(fd, c);
+    res = process_fd(fd, c, opt);
+    fflush(stdout);
     close(fd);
     return(res);
 }
@@ -140,10 +227,13 @@ static void
 usage(const char *progname)
 {
     fprintf(stderr,
-            "%s [-h] [file1 ... fileN]\n"
+            "%s [-hi] [-j workers] [-p uri] [file1 ... fileN]\n"
             "   Produces a list of names from the ccnb encoded"
-            " objects in the given file(s), or from stdin if no files or \"-\"\n",
-            progname);
+            " objects in the given file(s), or from stdin if no files or \"-\"\n"
+            "   -i          keep an index in file%s for later runs\n"
+            "   -j workers  number of processes for large files (default %d)\n"
+            "   -p uri      only names under uri\n",
+            progname, CCN_ARCHIVE_INDEX_SUFFIX, default_workers());
     exit(1);
 }
 
@@ -153,22 +243,42 @@ main(int argc, char *argv[])
     int i;
     int res = 0;
     struct ccn_charbuf *c = ccn_charbuf_create();
+    struct options options = {0};
     int opt;
     
-    while ((opt = getopt(argc, argv, "h")) != -1) {
+    options.workers = default_workers();
+    while ((opt = getopt(argc, argv, "hij:p:")) != -1) {
         switch (opt) {
+            case 'i':
+                options.flags |= CCN_ARCHIVE_KEEP_INDEX;
+                break;
+            case 'j':
+                options.workers = atoi(optarg);
+                if (options.workers <= 0 ||
+                    options.workers > CCN_ARCHIVE_MAX_WORKERS)
+                    usage(argv[0]);
+                break;
+            case 'p':
+                options.prefix = ccn_charbuf_create();
+                if (ccn_name_from_uri(options.prefix, optarg) < 0) {
+                    fprintf(stderr, "%s: bad ccn URI: %s\n", argv[0], optarg);
+                    exit(1);
+                }
+                break;
             case 'h':
             default:
                 usage(argv[0]);
         }
     }
     
-    if (argv[optind] == NULL)
-        return (process_fd(STDIN_FILENO, c));
+    if (argv[optind] == NULL) {
+        res = process_fd(STDIN_FILENO, c, &options);
+        fflush(stdout);
+        return (res);
+    }
     
     for (i = optind; argv[i] != 0; i++) {
-        res |= process_file(argv[i], c);
+        res |= process_file(argv[i], c, &options);
     }
     return(res);
 }
-
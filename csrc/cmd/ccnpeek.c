@@ -23,6 +23,7 @@
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/time.h>
 #include <ccn/bloom.h>
 #include <ccn/ccn.h>
 #include <ccn/charbuf.h>
@@ -32,12 +33,14 @@ static void
 usage(const char *progname)
 {
     fprintf(stderr,
-            "%s [-a] [-c] [-l lifetime] [-s scope] [-u] [-v] [-w timeout] ccnx:/a/b\n"
+            "%s [-a] [-c] [-l lifetime] [-N] [-s scope] [-u] [-v] [-w timeout] ccnx:/a/b\n"
             "   Get one content item matching the name prefix and write it to stdout"
             "\n"
             "   -a - allow stale data\n"
             "   -c - content only, not full ccnb\n"
             "   -l x - lifetime (seconds) of interest. 0.00012 < x <= 30.0000, Default 4.\n"
+            "   -N - ask to be told at once if the interest cannot be satisfied,\n"
+            "        and report how long it took if it was not\n"
             "   -s {0,1,2} - scope of interest.  Default none.\n"
             "   -u - allow unverified content\n"
             "   -v - resolve version number\n"
@@ -58,6 +61,7 @@ main(int argc, char **argv)
     int res;
     int opt;
     int allow_stale = 0;
+    int want_nack = 0;
     int content_only = 0;
     int scope = -1;
     const unsigned char *ptr;
@@ -68,8 +72,9 @@ main(int argc, char **argv)
     unsigned lifetime_l12 = lifetime_default;
     double lifetime;
     int get_flags = 0;
+    struct timeval t0, t1;
     
-    while ((opt = getopt(argc, argv, "acl:s:uvw:h")) != -1) {
+    while ((opt = getopt(argc, argv, "acl:Ns:uvw:h")) != -1) {
         switch (opt) {
             case 'a':
                 allow_stale = 1;
@@ -90,6 +95,9 @@ main(int argc, char **argv)
                     exit(1);
                 }
                 break;
+            case 'N':
+                want_nack = 1;
+                break;
             case 's':
                 scope = atoi(optarg);
                 if (scope < 0 || scope > 2) {
@@ -138,15 +146,16 @@ main(int argc, char **argv)
         fprintf(stderr, "%s: bad ccn URI: %s\n", argv[0], arg);
         exit(1);
     }
-	if (allow_stale || lifetime_l12 != lifetime_default || scope != -1) {
+	if (allow_stale || want_nack || lifetime_l12 != lifetime_default || scope != -1) {
         templ = ccn_charbuf_create();
         ccn_charbuf_append_tt(templ, CCN_DTAG_Interest, CCN_DTAG);
         ccn_charbuf_append_tt(templ, CCN_DTAG_Name, CCN_DTAG);
         ccn_charbuf_append_closer(templ); /* </Name> */
-		if (allow_stale) {
+		if (allow_stale || want_nack) {
 			ccn_charbuf_append_tt(templ, CCN_DTAG_AnswerOriginKind, CCN_DTAG);
-			ccnb_append_number(templ,
-							   CCN_AOK_DEFAULT | CCN_AOK_STALE);
+			ccnb_append_number(templ, CCN_AOK_DEFAULT |
+							   (allow_stale ? CCN_AOK_STALE : 0) |
+							   (want_nack ? CCN_AOK_NACK : 0));
 			ccn_charbuf_append_closer(templ); /* </AnswerOriginKind> */
 		}
         if (scope != -1) {
@@ -175,7 +184,14 @@ main(int argc, char **argv)
             resultbuf->length = 0;
         }
     }
+    gettimeofday(&t0, NULL);
     res = ccn_get(h, name, templ, timeout_ms, resultbuf, &pcobuf, NULL, get_flags);
+    if (res < 0 && want_nack) {
+        gettimeofday(&t1, NULL);
+        fprintf(stderr, "%s: no content after %ld ms\n", argv[0],
+                (long)(t1.tv_sec - t0.tv_sec) * 1000 +
+                (t1.tv_usec - t0.tv_usec) / 1000);
+    }
     if (res >= 0) {
         ptr = resultbuf->buf;
         length = resultbuf->length;
@@ -0,0 +1,381 @@
+/**
+ * @file ccnpublish.c
+ * Publishes files and directory trees as segmented content.
+ *
+ * A CCNx command-line utility.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <dirent.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/ccn_private.h> /* for ccn_process_scheduled_operations() */
+#include <ccn/charbuf.h>
+#include <ccn/filewatch.h>
+#include <ccn/publish.h>
+#include <ccn/uri.h>
+
+static int
+default_workers(void)
+{
+    long n = -1;
+#ifdef _SC_NPROCESSORS_ONLN
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (n < 1)
+        return(1);
+    if (n > CCN_PUBLISH_MAX_WORKERS)
+        return(CCN_PUBLISH_MAX_WORKERS);
+    return(n);
+}
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-hnv] [-b blocksize] [-j workers] [-w settle_ms] "
+            "[-x freshness_seconds] URI file|directory ...\n"
+            " Publishes each file, and each file under each directory, as "
+            "segmented ContentObjects\n"
+            " named by URI and the path, signing with several worker "
+            "processes, then serves\n"
+            " them until interrupted.\n"
+            "  -b blocksize  segment size in bytes (default 4096, max %d)\n"
+            "  -j workers    number of signing processes (default %d)\n"
+            "  -n            exit after publishing, without serving\n"
+            "  -v            report each file as it is published\n"
+            "  -w settle_ms  publish files as new versions, and keep watching "
+            "for changes;\n"
+            "                a changed file is published again once it has "
+            "been quiet this long\n"
+            "  -x seconds    freshness of the published content\n",
+            progname, CCN_PUBLISH_MAX_BLOCKSIZE, default_workers());
+    exit(1);
+}
+
+struct publish_state {
+    const char *progname;
+    struct ccn_publisher *publisher;
+    struct ccn_charbuf *root;
+    char **paths;               /* the trees named on the command line */
+    int npaths;
+    int watch;                  /* publish versions, for updates */
+    int verbose;
+    int errors;
+};
+
+static int
+publish_file(struct publish_state *st, struct ccn_charbuf *name,
+             const char *path)
+{
+    int res;
+
+    if (st->watch)
+        res = ccn_publisher_update_file(st->publisher, name, path);
+    else
+        res = ccn_publisher_add_file(st->publisher, name, path);
+    if (res < 0) {
+        fprintf(stderr, "%s: failed to publish %s\n", st->progname, path);
+        st->errors++;
+    }
+    else if (st->verbose && res > 0)
+        fprintf(stderr, "%s: %d segments\n", path, res);
+    return(res);
+}
+
+/**
+ * Publish a file, or everything under a directory.
+ *
+ * Each level of the path below the starting point adds one component
+ * to the name.
+ */
+static void
+publish_path(struct publish_state *st, struct ccn_charbuf *name,
+             struct ccn_charbuf *path)
+{
+    struct stat statbuf;
+    struct dirent *de = NULL;
+    DIR *dir = NULL;
+    size_t namelen = name->length;
+    size_t pathlen = path->length;
+
+    if (stat(ccn_charbuf_as_string(path), &statbuf) == -1) {
+        perror(ccn_charbuf_as_string(path));
+        st->errors++;
+        return;
+    }
+    if (S_ISREG(statbuf.st_mode)) {
+        publish_file(st, name, ccn_charbuf_as_string(path));
+        return;
+    }
+    if (!S_ISDIR(statbuf.st_mode))
+        return;
+    dir = opendir(ccn_charbuf_as_string(path));
+    if (dir == NULL) {
+        perror(ccn_charbuf_as_string(path));
+        st->errors++;
+        return;
+    }
+    while ((de = readdir(dir)) != NULL) {
+        if (de->d_name[0] == '.')
+            continue;
+        name->length = namelen - 1;
+        ccn_charbuf_append_closer(name);
+        ccn_name_append_str(name, de->d_name);
+        path->length = pathlen;
+        ccn_charbuf_putf(path, "/%s", de->d_name);
+        publish_path(st, name, path);
+    }
+    closedir(dir);
+    name->length = namelen - 1;
+    ccn_charbuf_append_closer(name);
+    path->length = pathlen;
+    ccn_charbuf_as_string(path);
+}
+
+/**
+ * Name a tree by the last component of its path.
+ */
+static void
+tree_name(struct publish_state *st, struct ccn_charbuf *name, const char *path)
+{
+    const char *base = strrchr(path, '/');
+
+    base = (base == NULL) ? path : base + 1;
+    ccn_charbuf_reset(name);
+    ccn_charbuf_append_charbuf(name, st->root);
+    ccn_name_append_str(name, base);
+}
+
+/**
+ * Find the name for a path reported by the watcher.
+ * @returns 0 for success, -1 if the path is not in any of our trees.
+ */
+static int
+name_for_path(struct publish_state *st, struct ccn_charbuf *name,
+              const char *path)
+{
+    const char *p = NULL;
+    const char *slash = NULL;
+    size_t len = 0;
+    int i;
+
+    for (i = 0; i < st->npaths; i++) {
+        len = strlen(st->paths[i]);
+        if (strncmp(path, st->paths[i], len) == 0 &&
+            (path[len] == 0 || path[len] == '/'))
+            break;
+    }
+    if (i == st->npaths)
+        return(-1);
+    tree_name(st, name, st->paths[i]);
+    for (p = path + len; *p == '/'; p = slash) {
+        p++;
+        slash = strchr(p, '/');
+        if (slash == NULL)
+            slash = p + strlen(p);
+        if (p[0] == '.')
+            return(-1); /* skipped when publishing the tree, too */
+        ccn_name_append(name, p, slash - p);
+    }
+    return(0);
+}
+
+static void
+file_changed(void *data, const char *path, int kind)
+{
+    struct publish_state *st = data;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct stat statbuf;
+
+    if (name_for_path(st, name, path) < 0)
+        goto Finish;
+    if (kind == CCN_FILEWATCH_REMOVED) {
+        if (ccn_publisher_remove_file(st->publisher, name) == 0 &&
+            st->verbose)
+            fprintf(stderr, "%s: removed\n", path);
+    }
+    else if (stat(path, &statbuf) == 0 && S_ISREG(statbuf.st_mode))
+        publish_file(st, name, path);
+Finish:
+    ccn_charbuf_destroy(&name);
+}
+
+/**
+ * Serve interests, and publish new versions of the files that change.
+ */
+static int
+watch_and_serve(struct publish_state *st, struct ccn *h,
+                struct ccn_filewatch *w)
+{
+    struct pollfd fds[2];
+    int timeout;
+    int next;
+    int res;
+
+    for (;;) {
+        timeout = ccn_process_scheduled_operations(h);
+        next = ccn_filewatch_process(w, &file_changed, st);
+        if (next >= 0 && (timeout < 0 || next < timeout))
+            timeout = next;
+        fds[0].fd = ccn_get_connection_fd(h);
+        fds[0].events = POLLIN;
+        if (ccn_output_is_pending(h))
+            fds[0].events |= POLLOUT;
+        fds[1].fd = ccn_filewatch_fd(w);
+        fds[1].events = POLLIN;
+        fds[0].revents = fds[1].revents = 0;
+        res = poll(fds, 2, timeout < 0 ? -1 : (timeout + 999) / 1000);
+        if (res < 0 && errno != EINTR)
+            return(-1);
+        if (fds[0].revents != 0) {
+            res = ccn_run(h, 0);
+            if (res < 0)
+                return(res);
+        }
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    struct ccn *ccn = NULL;
+    struct ccn_charbuf *root = NULL;
+    struct ccn_charbuf *name = NULL;
+    struct ccn_charbuf *path = NULL;
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_publisher_stats stats = {0};
+    struct publish_state st = {0};
+    struct timeval t0, t1;
+    struct ccn_filewatch *w = NULL;
+    double elapsed;
+    long blocksize = 4096;
+    int workers = default_workers();
+    int serve = 1;
+    int settle_ms = -1;
+    int i;
+    int res;
+
+    st.progname = progname;
+    while ((res = getopt(argc, argv, "hb:j:nvw:x:")) != -1) {
+        switch (res) {
+            case 'b':
+                blocksize = atol(optarg);
+                if (blocksize <= 0 || blocksize > CCN_PUBLISH_MAX_BLOCKSIZE)
+                    usage(progname);
+                break;
+            case 'j':
+                workers = atoi(optarg);
+                if (workers <= 0 || workers > CCN_PUBLISH_MAX_WORKERS)
+                    usage(progname);
+                break;
+            case 'n':
+                serve = 0;
+                break;
+            case 'v':
+                st.verbose = 1;
+                break;
+            case 'w':
+                settle_ms = atoi(optarg);
+                if (settle_ms < 0)
+                    usage(progname);
+                st.watch = 1;
+                break;
+            case 'x':
+                sp.freshness = atol(optarg);
+                if (sp.freshness <= 0)
+                    usage(progname);
+                break;
+            default:
+            case 'h':
+                usage(progname);
+                break;
+        }
+    }
+    argc -= optind;
+    argv += optind;
+    if (argc < 2)
+        usage(progname);
+    root = ccn_charbuf_create();
+    res = ccn_name_from_uri(root, argv[0]);
+    if (res < 0) {
+        fprintf(stderr, "%s: bad CCN URI: %s\n", progname, argv[0]);
+        exit(1);
+    }
+    ccn = ccn_create();
+    if (ccn_connect(ccn, NULL) == -1) {
+        perror("Could not connect to ccnd");
+        exit(1);
+    }
+    st.publisher = ccn_publisher_create(ccn, root, &sp, blocksize, workers);
+    if (st.publisher == NULL) {
+        fprintf(stderr, "%s: cannot create publisher\n", progname);
+        exit(1);
+    }
+    st.root = root;
+    st.paths = calloc(argc, sizeof(st.paths[0]));
+    name = ccn_charbuf_create();
+    path = ccn_charbuf_create();
+    if (st.watch) {
+        /* Start watching first, so that no change is missed */
+        w = ccn_filewatch_create(settle_ms);
+        if (w == NULL) {
+            perror("cannot watch for changes");
+            exit(1);
+        }
+    }
+    gettimeofday(&t0, NULL);
+    for (i = 1; i < argc; i++) {
+        ccn_charbuf_reset(path);
+        ccn_charbuf_append_string(path, argv[i]);
+        while (path->length > 1 && path->buf[path->length - 1] == '/')
+            path->length--;
+        st.paths[st.npaths++] = strdup(ccn_charbuf_as_string(path));
+        if (w != NULL && ccn_filewatch_add(w, ccn_charbuf_as_string(path)) < 0) {
+            perror(ccn_charbuf_as_string(path));
+            st.errors++;
+        }
+        tree_name(&st, name, ccn_charbuf_as_string(path));
+        publish_path(&st, name, path);
+    }
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    ccn_publisher_get_stats(st.publisher, &stats);
+    fprintf(stderr, "%s: published %ju files, %ju segments, %ju bytes "
+            "in %.3f s, %.2f MB/s with %d workers\n", progname,
+            stats.files, stats.segments, stats.bytes, elapsed,
+            elapsed > 0 ? stats.bytes / elapsed / 1.0e6 : 0.0, workers);
+    if (serve && w != NULL)
+        watch_and_serve(&st, ccn, w);
+    else if (serve && stats.files > 0)
+        ccn_run(ccn, -1);
+    ccn_filewatch_destroy(&w);
+    ccn_publisher_destroy(&st.publisher);
+    for (i = 0; i < st.npaths; i++)
+        free(st.paths[i]);
+    free(st.paths);
+    ccn_charbuf_destroy(&root);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&path);
+    ccn_destroy(&ccn);
+    exit(st.errors == 0 ? 0 : 1);
+}
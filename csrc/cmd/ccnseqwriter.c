@@ -30,7 +30,7 @@ static void
 usage(const char *progname)
 {
         fprintf(stderr,
-                "%s [-h] [-b 0<blocksize<=4096] [-r] ccnx:/some/uri\n"
+                "%s [-h] [-b 0<blocksize<=4096] [-r] [-w window] ccnx:/some/uri\n"
                 "    Reads stdin, sending data under the given URI"
                 " using ccn versioning and segmentation.\n"
                 "    -h generate this help message.\n"
@@ -39,6 +39,7 @@ usage(const char *progname)
                 " store the content.\n"
                 "    -s n set scope of start-write interest.\n"
                 "       n = 1(local), 2(neighborhood), 3(everywhere) Default 1.\n"
+                "    -w number of segments to sign ahead of demand.  Default 8.\n"
                 "    -x specify the freshness for content objects.\n",
                 progname);
         exit(1);
@@ -71,6 +72,7 @@ main(int argc, char **argv)
     struct ccn_seqwriter *w = NULL;
     int blocksize = 1024;
     int freshness = -1;
+    int window = -1;
     int torepo = 0;
     int scope = 1;
     int i;
@@ -81,7 +83,7 @@ main(int argc, char **argv)
     unsigned char *buf = NULL;
     struct ccn_charbuf *templ;
     
-    while ((res = getopt(argc, argv, "hrb:s:x:")) != -1) {
+    while ((res = getopt(argc, argv, "hrb:s:w:x:")) != -1) {
         switch (res) {
             case 'b':
                 blocksize = atoi(optarg);
@@ -96,6 +98,11 @@ main(int argc, char **argv)
                 if (scope < 1 || scope > 3)
                     usage(progname);
                 break;
+            case 'w':
+                window = atoi(optarg);
+                if (window < 0)
+                    usage(progname);
+                break;
             case 'x':
                 freshness = atoi(optarg);
                 if (freshness < 0)
@@ -133,6 +140,10 @@ main(int argc, char **argv)
     ccn_seqw_set_block_limits(w, blocksize, blocksize);
     if (freshness > -1)
         ccn_seqw_set_freshness(w, freshness);
+    if (window > -1 && ccn_seqw_set_window(w, window) < 0) {
+        fprintf(stderr, "%s: bad window: %d\n", progname, window);
+        exit(1);
+    }
     if (torepo) {
         struct ccn_charbuf *name_v = ccn_charbuf_create();
         ccn_seqw_get_name(w, name_v);
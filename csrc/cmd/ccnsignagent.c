@@ -0,0 +1,150 @@
+/**
+ * @file ccnsignagent.c
+ *
+ * Holds unlocked keys and signs for local clients.
+ *
+ * libccn signs with the user's default key through this agent when it
+ * is running, so short-lived tools need not unlock the keystore.
+ */
+
+/*
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <ccn/charbuf.h>
+#include <ccn/signagent.h>
+
+static volatile sig_atomic_t stopping = 0;
+
+static void
+usage(const char *progname)
+{
+    fprintf(stderr,
+            "%s [-h] [-s sockname] [keystore ...]\n"
+            " Unlocks keystores and signs with them for local clients.\n"
+            " The first keystore holds the default key; if none is named,"
+            " the user's default keystore is used.\n"
+            " The password is taken from CCNX_KEYSTORE_PASSWORD.\n"
+            "  -h - print this message and exit\n"
+            "  -s sockname - listen here rather than at CCNX_SIGNAGENT_SOCK"
+            " or the usual place\n"
+            , progname);
+    exit(1);
+}
+
+static void
+handle_signal(int sig)
+{
+    stopping = sig;
+}
+
+static int
+default_keystore(struct ccn_charbuf *path)
+{
+    const char *s;
+
+    s = getenv("CCNX_DIR");
+    if (s != NULL && s[0] != 0)
+        return(ccn_charbuf_putf(path, "%s/.ccnx_keystore", s));
+    s = getenv("HOME");
+    if (s != NULL && s[0] != 0)
+        return(ccn_charbuf_putf(path, "%s/.ccnx/.ccnx_keystore", s));
+    return(-1);
+}
+
+static void
+print_keyid(const char *progname, const char *keystore,
+            struct ccn_charbuf *pubid)
+{
+    size_t i;
+
+    fprintf(stderr, "%s: serving ", progname);
+    for (i = 0; i < pubid->length; i++)
+        fprintf(stderr, "%02X", pubid->buf[i]);
+    fprintf(stderr, " from %s\n", keystore);
+}
+
+int
+main(int argc, char **argv)
+{
+    const char *progname = argv[0];
+    struct ccn_signagent_server *server = NULL;
+    struct ccn_charbuf *sockname = ccn_charbuf_create();
+    struct ccn_charbuf *keystore = ccn_charbuf_create();
+    struct ccn_charbuf *pubid = ccn_charbuf_create();
+    const char *password;
+    int opt;
+    int res;
+    int i;
+
+    while ((opt = getopt(argc, argv, "hs:")) != -1) {
+        switch (opt) {
+            case 's':
+                ccn_charbuf_putf(sockname, "%s", optarg);
+                break;
+            case 'h':
+            default:
+                usage(progname);
+        }
+    }
+    if (sockname->length == 0 && ccn_signagent_sockname(sockname) < 0) {
+        fprintf(stderr, "%s: no place for the socket; use -s\n", progname);
+        exit(1);
+    }
+    password = getenv("CCNX_KEYSTORE_PASSWORD");
+    if (password == NULL)
+        password = "Th1s1sn0t8g00dp8ssw0rd.";
+    server = ccn_signagent_server_create(ccn_charbuf_as_string(sockname));
+    if (server == NULL) {
+        fprintf(stderr, "%s: %s: %s\n", progname,
+                ccn_charbuf_as_string(sockname), strerror(errno));
+        exit(1);
+    }
+    for (i = optind; i < argc || (i == optind && argc == optind); i++) {
+        keystore->length = 0;
+        if (i < argc)
+            res = ccn_charbuf_putf(keystore, "%s", argv[i]);
+        else
+            res = default_keystore(keystore);
+        if (res >= 0)
+            res = ccn_signagent_server_add_key(server,
+                                               ccn_charbuf_as_string(keystore),
+                                               password, pubid);
+        if (res < 0) {
+            fprintf(stderr, "%s: cannot serve keystore %s: %s\n", progname,
+                    ccn_charbuf_as_string(keystore), strerror(errno));
+            ccn_signagent_server_destroy(&server);
+            exit(1);
+        }
+        print_keyid(progname, ccn_charbuf_as_string(keystore), pubid);
+    }
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGINT, &handle_signal);
+    signal(SIGTERM, &handle_signal);
+    signal(SIGHUP, &handle_signal);
+    res = 0;
+    while (stopping == 0 && res == 0)
+        res = ccn_signagent_server_run(server, 1000);
+    ccn_signagent_server_destroy(&server);
+    ccn_charbuf_destroy(&sockname);
+    ccn_charbuf_destroy(&keystore);
+    ccn_charbuf_destroy(&pubid);
+    return(res == 0 ? 0 : 1);
+}
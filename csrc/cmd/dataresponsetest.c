@@ -227,6 +227,10 @@ interest_handler(struct ccn_closure *selfp,
     case CCN_UPCALL_INTEREST_TIMED_OUT:
         fprintf(stderr, "refresh\n");
         return (CCN_UPCALL_RESULT_REEXPRESS);
+
+    case CCN_UPCALL_INTEREST_NACKED:
+        fprintf(stderr, "Interest refused\n");
+        return (CCN_UPCALL_RESULT_ERR);
         
     case CCN_UPCALL_CONTENT:
     case CCN_UPCALL_CONTENT_UNVERIFIED:
@@ -13,20 +13,19 @@
 #
 
 LDLIBS = -L$(CCNLIBDIR) $(MORE_LDLIBS) -lccn
-EXPATLIBS = -lexpat
 CCNLIBDIR = ../lib
 SYNCLIBS = -L../sync -lccnsync
 
 INSTALLED_PROGRAMS = \
-    ccn_ccnbtoxml ccn_splitccnb ccnc ccndumpnames ccnnamelist ccnrm \
+    ccn_ccnbtoxml ccn_xmltoccnb ccn_splitccnb ccnc ccndumpnames ccnnamelist ccnrm \
     ccnls ccnslurp ccnbx ccncat ccnbasicconfig \
     ccnsendchunks ccncatchunks ccncatchunks2 \
     ccnpoke ccnpeek ccnhexdumpdata \
-    ccnseqwriter ccnsimplecat \
-    ccnfilewatch ccninitkeystore \
+    ccnseqwriter ccnsimplecat ccnpublish \
+    ccnfilewatch ccninitkeystore ccnsignagent ccndreplay \
     ccnlibtest \
     ccnsyncwatch ccnsyncslice \
-    $(EXPAT_PROGRAMS) $(PCAP_PROGRAMS)
+    $(PCAP_PROGRAMS)
 
 PROGRAMS = $(INSTALLED_PROGRAMS) \
     ccnbuzz  \
@@ -35,7 +34,6 @@ PROGRAMS = $(INSTALLED_PROGRAMS) \
     ccnsnew \
     $(PCAP_PROGRAMS)
 
-EXPAT_PROGRAMS = ccn_xmltoccnb
 #PCAP_PROGRAMS = ccndumppcap
 BROKEN_PROGRAMS =
 DEBRIS =
@@ -44,9 +42,10 @@ CSRC =  ccn_ccnbtoxml.c ccn_splitccnb.c ccn_xmltoccnb.c ccnbasicconfig.c \
        ccnbuzz.c ccnbx.c \
        ccnc.c \
        ccncat.c ccnsimplecat.c ccncatchunks.c ccncatchunks2.c \
-       ccndumpnames.c ccndumppcap.c ccnfilewatch.c ccnpeek.c ccnhexdumpdata.c \
+       ccndumpnames.c ccndumppcap.c ccndreplay.c ccnfilewatch.c ccnpeek.c ccnhexdumpdata.c \
        ccninitkeystore.c ccnls.c ccnnamelist.c ccnpoke.c ccnrm.c ccnsendchunks.c \
-       ccnseqwriter.c \
+       ccnsignagent.c \
+       ccnseqwriter.c ccnpublish.c \
        ccnsnew.c \
        ccnsyncwatch.c ccnsyncslice.c ccn_fetch_test.c ccnlibtest.c ccnslurp.c dataresponsetest.c 
 
@@ -62,10 +61,10 @@ ccn_ccnbtoxml: ccn_ccnbtoxml.o
 	$(CC) $(CFLAGS) -o $@ ccn_ccnbtoxml.o $(LDLIBS)
 
 ccn_xmltoccnb: ccn_xmltoccnb.o
-	$(CC) $(CFLAGS) -o $@ ccn_xmltoccnb.o $(LDLIBS) $(EXPATLIBS)
+	$(CC) $(CFLAGS) -o $@ ccn_xmltoccnb.o $(LDLIBS)
 
 ccn_splitccnb: ccn_splitccnb.o
-	$(CC) $(CFLAGS) -o $@ ccn_splitccnb.o $(LDLIBS)
+	$(CC) $(CFLAGS) -o $@ ccn_splitccnb.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 
 hashtbtest: hashtbtest.o
 	$(CC) $(CFLAGS) -o $@ hashtbtest.o $(LDLIBS)
@@ -118,6 +117,9 @@ ccnsendchunks: ccnsendchunks.o
 ccnseqwriter: ccnseqwriter.o
 	$(CC) $(CFLAGS) -o $@ ccnseqwriter.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 
+ccnpublish: ccnpublish.o
+	$(CC) $(CFLAGS) -o $@ ccnpublish.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
 ccn_fetch_test: ccn_fetch_test.o
 	$(CC) $(CFLAGS) -o $@ ccn_fetch_test.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 
@@ -172,8 +174,14 @@ signbenchtest: signbenchtest.o
 ccndumppcap: ccndumppcap.o
 	$(CC) $(CFLAGS) -o $@ ccndumppcap.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto -lpcap
 
+ccndreplay: ccndreplay.o
+	$(CC) $(CFLAGS) -o $@ ccndreplay.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
 ccnfilewatch: ccnfilewatch.o
-	$(CC) $(CFLAGS) -o $@ ccnfilewatch.o
+	$(CC) $(CFLAGS) -o $@ ccnfilewatch.o $(LDLIBS)
+
+ccnsignagent: ccnsignagent.o
+	$(CC) $(CFLAGS) -o $@ ccnsignagent.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
 
 ccnsnew: ccnsnew.o
 	$(CC) $(CFLAGS) -o $@ ccnsnew.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
@@ -193,10 +201,14 @@ clean:
 # but must be updated manually.
 ###############################
 ccn_ccnbtoxml.o: ccn_ccnbtoxml.c ../include/ccn/charbuf.h \
-  ../include/ccn/coding.h ../include/ccn/extend_dict.h
-ccn_splitccnb.o: ccn_splitccnb.c ../include/ccn/coding.h
+  ../include/ccn/coding.h ../include/ccn/extend_dict.h \
+  ../include/ccn/xmlcodec.h
+ccn_splitccnb.o: ccn_splitccnb.c ../include/ccn/archive.h \
+  ../include/ccn/charbuf.h ../include/ccn/coding.h \
+  ../include/ccn/indexbuf.h ../include/ccn/uri.h
 ccn_xmltoccnb.o: ccn_xmltoccnb.c ../include/ccn/coding.h \
-  ../include/ccn/charbuf.h ../include/ccn/extend_dict.h
+  ../include/ccn/charbuf.h ../include/ccn/extend_dict.h \
+  ../include/ccn/xmlcodec.h
 ccnbasicconfig.o: ccnbasicconfig.c ../include/ccn/bloom.h \
   ../include/ccn/ccn.h ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/ccnd.h ../include/ccn/uri.h \
@@ -230,7 +242,11 @@ ccndumpnames.o: ccndumpnames.c ../include/ccn/ccn.h \
 ccndumppcap.o: ccndumppcap.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
   ../include/ccn/ccnd.h
-ccnfilewatch.o: ccnfilewatch.c
+ccndreplay.o: ccndreplay.c ../include/ccn/ccn.h ../include/ccn/coding.h \
+  ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
+  ../include/ccn/ccnd.h ../include/ccn/ccn_private.h \
+  ../include/ccn/hashtb.h ../include/ccn/random.h
+ccnfilewatch.o: ccnfilewatch.c ../include/ccn/filewatch.h
 ccnpeek.o: ccnpeek.c ../include/ccn/bloom.h ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/uri.h
@@ -241,8 +257,8 @@ ccninitkeystore.o: ccninitkeystore.c ../include/ccn/ccn.h \
   ../include/ccn/indexbuf.h ../include/ccn/keystore.h
 ccnls.o: ccnls.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h ../include/ccn/uri.h
-ccnnamelist.o: ccnnamelist.c ../include/ccn/coding.h ../include/ccn/uri.h \
-  ../include/ccn/charbuf.h
+ccnnamelist.o: ccnnamelist.c ../include/ccn/archive.h \
+  ../include/ccn/coding.h ../include/ccn/uri.h ../include/ccn/charbuf.h
 ccnpoke.o: ccnpoke.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h ../include/ccn/uri.h \
   ../include/ccn/keystore.h ../include/ccn/signing.h
@@ -252,6 +268,13 @@ ccnsendchunks.o: ccnsendchunks.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/uri.h \
   ../include/ccn/keystore.h ../include/ccn/signing.h
+ccnsignagent.o: ccnsignagent.c ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/signagent.h
+ccnpublish.o: ccnpublish.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/ccn_private.h \
+  ../include/ccn/filewatch.h ../include/ccn/publish.h \
+  ../include/ccn/uri.h
 ccnseqwriter.o: ccnseqwriter.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/uri.h \
@@ -271,9 +294,9 @@ ccn_fetch_test.o: ccn_fetch_test.c ../include/ccn/fetch.h \
 ccnlibtest.o: ccnlibtest.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
   ../include/ccn/reg_mgmt.h ../include/ccn/uri.h
-ccnslurp.o: ccnslurp.c ../include/ccn/bloom.h ../include/ccn/ccn.h \
-  ../include/ccn/coding.h ../include/ccn/charbuf.h \
-  ../include/ccn/indexbuf.h ../include/ccn/uri.h
+ccnslurp.o: ccnslurp.c ../include/ccn/ccn.h ../include/ccn/coding.h \
+  ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
+  ../include/ccn/crawl.h ../include/ccn/uri.h
 dataresponsetest.o: dataresponsetest.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h
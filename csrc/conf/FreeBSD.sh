@@ -12,11 +12,6 @@
 # FOR A PARTICULAR PURPOSE.
 #
 echo "# FreeBSD.sh $@ was here" >> conf.mk
-set -x
-mkdir -p include
-find include lib -type l -name \*expat\* -exec rm '{}' ';'
-test -f /usr/local/include/expat.h && exit 0
-echo "# Using bsdxml.h for expat - recommend installing expat package and repeat ./configure" >> conf.mk
-# Make some symlinks so that we can use the native expat.
-ln -s /usr/include/bsdxml.h include/expat.h
-ln -s /usr/lib/libbsdxml.a lib/libexpat.a
+# Remove the expat symlinks that older versions made here
+find include lib -type l -name \*expat\* -exec rm '{}' ';' 2>/dev/null
+exit 0
@@ -0,0 +1,116 @@
+/**
+ * @file ccn/archive.h
+ * @brief Indexed access to files of concatenated ccnb objects.
+ *
+ * Files such as repoFile1 and packet captures hold a sequence of ccnb
+ * objects.  An archive maps such a file into memory and builds an index
+ * of where each top-level object starts, so the objects may be divided
+ * among worker processes.  The index may be kept beside the file for
+ * later runs.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_ARCHIVE_DEFINED
+#define CCN_ARCHIVE_DEFINED
+
+#include <stddef.h>
+struct ccn_archive;
+struct ccn_charbuf;
+struct ccn_indexbuf;
+
+#define CCN_ARCHIVE_MAX_WORKERS 64
+
+/* flags for ccn_archive_open */
+#define CCN_ARCHIVE_KEEP_INDEX 1    /**< use and save path.ccnbi */
+
+/**
+ * Suffix added to the archive's path to name its index file.
+ */
+#define CCN_ARCHIVE_INDEX_SUFFIX ".ccnbi"
+
+/**
+ * Open a file of ccnb objects.
+ *
+ * With CCN_ARCHIVE_KEEP_INDEX, an index file that matches the size and
+ * modification time of the archive is used instead of scanning it, and
+ * a new index is saved if possible.
+ * @returns NULL if the file cannot be opened or mapped.
+ */
+struct ccn_archive *ccn_archive_open(const char *path, int flags);
+
+/**
+ * @returns the number of complete top-level objects.
+ */
+size_t ccn_archive_count(struct ccn_archive *a);
+
+/**
+ * @returns the number of bytes after the last complete object, which
+ *          is non-zero if the file is truncated or not valid ccnb.
+ */
+size_t ccn_archive_unparsed(struct ccn_archive *a);
+
+/**
+ * Get the ith object.
+ * @returns 0, or -1 if i is out of range.
+ */
+int ccn_archive_get(struct ccn_archive *a, size_t i,
+                    const unsigned char **ccnb, size_t *size);
+
+/**
+ * Test whether a ContentObject, Interest, or Name starts with prefix.
+ * @param prefix is a ccnb-encoded Name.
+ */
+int ccn_archive_object_has_prefix(const unsigned char *ccnb, size_t size,
+                                  const struct ccn_charbuf *prefix);
+
+/**
+ * Worker for ccn_archive_run.
+ *
+ * Handles items first through first + count - 1, writing any output
+ * to fd.
+ * @returns 0 for success.
+ */
+typedef int ccn_archive_worker(void *data, struct ccn_archive *a,
+                               size_t first, size_t count, int fd);
+
+/**
+ * Divide nitems items into contiguous ranges, and call worker for each
+ * range in its own forked process.
+ *
+ * The items are usually the objects of the archive, but need not be.
+ * Each process writes to its own spool file, and the spools are copied
+ * to outfd in order, so the output is the same as if the items had been
+ * handled in one pass.  With one worker, or one item, no process is
+ * forked.
+ * @param outfd may be -1 if there is no output.
+ * @returns 0, or -1 if any worker failed.
+ */
+int ccn_archive_run(struct ccn_archive *a, size_t nitems, int workers,
+                    ccn_archive_worker *worker, void *data, int outfd);
+
+/**
+ * Find the objects with names under prefix, using several processes.
+ *
+ * The indexes of the objects are appended to result, in order.
+ * @returns the number found, or -1 for an error.
+ */
+int ccn_archive_select(struct ccn_archive *a, const struct ccn_charbuf *prefix,
+                       int workers, struct ccn_indexbuf *result);
+
+void ccn_archive_close(struct ccn_archive **ap);
+
+#endif
@@ -0,0 +1,94 @@
+/**
+ * @file ccn/bulkdata.h
+ * @brief Ordered, windowed transfer of sequence-numbered content.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2008, 2009, 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_BULKDATA_DEFINED
+#define CCN_BULKDATA_DEFINED
+
+#include <stdint.h>
+#include <ccn/ccn.h>
+
+/*
+ * The client provides a ccn_seqfunc * (and perhaps a matching param)
+ * to specify the scheme for naming the content items in the sequence.
+ * Given the sequence number x, it should place in resultbuf the
+ * corresponding blob that that will be used in the final explicit
+ * Component of the Name of item x in the sequence.  This should
+ * act as a mathematical function, returning the same answer for a given x.
+ * (Usually param will be NULL, but is provided in case it is needed.)
+ */
+typedef void ccn_seqfunc(uintmax_t x, void *param,
+                         struct ccn_charbuf *resultbuf);
+
+/*
+ * Ready-to-use sequencing functions
+ */
+extern ccn_seqfunc ccn_decimal_seqfunc;
+extern ccn_seqfunc ccn_binary_seqfunc;
+extern ccn_seqfunc ccn_segment_seqfunc;
+
+/**
+ * Upper bound on the number of items in flight or held for reordering.
+ */
+#define CCN_BULKDATA_MAX_WINDOW 256
+
+struct ccn_bulkdata;
+
+/**
+ * Counters, for monitoring a transfer.
+ */
+struct ccn_bulkdata_stats {
+    uintmax_t delivered;        /**< items handed to the client, in order */
+    uintmax_t reordered;        /**< items held for a while before delivery */
+    uintmax_t expressed;        /**< interests sent, including retries */
+    uintmax_t timeouts;         /**< interests that timed out */
+    uintmax_t duplicates;       /**< arrivals that were not needed */
+    int in_flight;              /**< interests currently outstanding */
+    int window;                 /**< current congestion window */
+    int rto_us;                 /**< current retransmission timeout */
+    int srtt_us;                /**< smoothed round-trip time */
+    int done;                   /**< nonzero when the final item is delivered */
+};
+
+/**
+ * Create a bulk data transfer.
+ *
+ * Interests are expressed for name_prefix with one more component
+ * generated by seqfunc, starting with sequence number first.
+ * The client closure is called with CCN_UPCALL_CONTENT (or
+ * CCN_UPCALL_CONTENT_UNVERIFIED) for each item, strictly in sequence order,
+ * with CCN_UPCALL_INTEREST_TIMED_OUT if an item cannot be retrieved,
+ * and with CCN_UPCALL_FINAL when the transfer is destroyed.
+ * The transfer ends after an item whose FinalBlockID matches its own
+ * sequence component, or after the limit set by ccn_bulkdata_set_limit().
+ */
+struct ccn_bulkdata *
+ccn_bulkdata_create(struct ccn *h,
+                    struct ccn_charbuf *name_prefix,
+                    ccn_seqfunc *seqfunc, void *seqfunc_param,
+                    uintmax_t first,
+                    struct ccn_closure *client);
+int ccn_bulkdata_set_window(struct ccn_bulkdata *b, int window);
+int ccn_bulkdata_set_limit(struct ccn_bulkdata *b, uintmax_t last);
+int ccn_bulkdata_start(struct ccn_bulkdata *b);
+int ccn_bulkdata_get_stats(struct ccn_bulkdata *b,
+                           struct ccn_bulkdata_stats *stats);
+void ccn_bulkdata_destroy(struct ccn_bulkdata **bp);
+
+#endif
@@ -37,7 +37,7 @@
  * Thus CCN_API_VERSION=1000 would have corresponded to the first public
  * release (0.1.0), but that version did not have this macro defined.
  */
-#define CCN_API_VERSION 7000
+#define CCN_API_VERSION 7001
 
 /**
  * Interest lifetime default.
@@ -79,7 +79,8 @@ enum ccn_upcall_kind {
     CCN_UPCALL_CONTENT_UNVERIFIED,/**< content that has not been verified */
     CCN_UPCALL_CONTENT_BAD,       /**< verification failed */
     CCN_UPCALL_CONTENT_KEYMISSING,/**< key has not been fetched */
-    CCN_UPCALL_CONTENT_RAW        /**< verification has not been attempted */
+    CCN_UPCALL_CONTENT_RAW,       /**< verification has not been attempted */
+    CCN_UPCALL_INTEREST_NACKED    /**< network says interest cannot be satisfied */
 };
 
 /**
@@ -141,6 +142,8 @@ struct ccn_upcall_info {
     const unsigned char *content_ccnb;
     struct ccn_parsed_ContentObject *pco;
     struct ccn_indexbuf *content_comps;
+    /* Reason for CCN_UPCALL_INTEREST_NACKED (enum ccn_nack_reason) */
+    int nack_reason;
 };
 
 /*
@@ -358,9 +361,10 @@ int ccn_set_run_timeout(struct ccn *h, int timeout);
  * ccn_get: Get a single matching ContentObject
  * This is a convenience for getting a single matching ContentObject.
  * Blocks until a matching ContentObject arrives or there is a timeout.
- * If h is NULL or ccn_get is called from inside an upcall, a new connection
- * will be used and upcalls from other requests will not be processed while
- * ccn_get is active.
+ * If h is NULL a new connection will be used.  If ccn_get is called from
+ * inside an upcall, it shares the connection of h, and upcalls from other
+ * requests will not be processed while ccn_get is active; messages for
+ * them are held back until control returns to ccn_run.
  * The pcobuf and compsbuf arguments may be supplied to save the work of
  * re-parsing the ContentObject.  Either or both may be NULL if this
  * information is not actually needed.
@@ -376,7 +380,26 @@ int ccn_get(struct ccn *h,
             struct ccn_indexbuf *compsbuf,
             int flags);
 
+/*
+ * ccn_get_multi: Get several ContentObjects at once
+ * Expresses interests for all n names right away, and blocks until all
+ * have been answered or the timeout (for the whole batch) runs out.
+ * results[i] receives the ContentObject for names[i], and is left empty
+ * if none arrived.  With CCN_GET_ANY in flags, returns as soon as any
+ * one of them has arrived.  Works like ccn_get otherwise.
+ * Returns the number of ContentObjects obtained, or -1 for an error.
+ * This call is available beginning with CCN_API_VERSION 7001.
+ */
+int ccn_get_multi(struct ccn *h,
+                  struct ccn_charbuf **names,
+                  int n,
+                  struct ccn_charbuf *interest_template,
+                  int timeout_ms,
+                  struct ccn_charbuf **results,
+                  int flags);
+
 #define CCN_GET_NOKEYWAIT 1
+#define CCN_GET_ANY 2
 
 /* Handy if the content object didn't arrive in the usual way. */
 int ccn_verify_content(struct ccn *h,
@@ -610,6 +633,7 @@ ccn_parse_Collection_next(struct ccn_buf_decoder *d,
 #define CCN_AOK_DEFAULT (CCN_AOK_CS | CCN_AOK_NEW)
 #define CCN_AOK_STALE   0x4     /* OK to answer with stale data */
 #define CCN_AOK_EXPIRE  0x10    /* Mark as stale (must have Scope 0) */
+#define CCN_AOK_NACK    0x20    /* Send an InterestNack rather than drop */
 
 /*
  * ccn_parse_interest:
@@ -840,6 +864,16 @@ int ccn_load_default_key(struct ccn *h,
                          const char *keystore_path,
                          const char *keystore_passphrase);
 
+/*
+ * ccn_load_secret_key: load a shared secret for HMAC-SHA256 signing
+ * The secret is read from a file of random bytes; the digest of the
+ * secret stands in for a public key digest as the pubid.  Content
+ * signed with it is verified by any handle that has loaded the same secret.
+ */
+int ccn_load_secret_key(struct ccn *h,
+                        const char *secret_path,
+                        struct ccn_charbuf *keyid_out);
+
 int ccn_get_public_key(struct ccn *h,
                        const struct ccn_signing_params *params,
                        struct ccn_charbuf *digest_result,
@@ -856,6 +890,8 @@ int ccn_chk_signing_params(struct ccn *h,
 /* low-level content-object signing */
 
 #define CCN_SIGNING_DEFAULT_DIGEST_ALGORITHM "SHA256"
+/* OID of hmacWithSHA256, the DigestAlgorithm of secret-key signatures */
+#define CCN_SIGNING_HMAC_SHA256_ALGORITHM "1.2.840.113549.2.9"
 
 int ccn_signed_info_create(
     struct ccn_charbuf *c,              /* filled with result */
@@ -875,6 +911,25 @@ int ccn_encode_ContentObject(struct ccn_charbuf *buf,
                              const char *digest_algorithm,
                              const struct ccn_pkey *private_key);
 
+struct ccn_sigc;
+int ccn_encode_ContentObject_sigc(struct ccn_charbuf *buf,
+                                  const struct ccn_charbuf *Name,
+                                  const struct ccn_charbuf *SignedInfo,
+                                  const void *data,
+                                  size_t size,
+                                  const char *digest_algorithm,
+                                  const struct ccn_pkey *private_key,
+                                  struct ccn_sigc *sig_ctx);
+
+int ccn_encode_presigned_ContentObject(struct ccn_charbuf *buf,
+                                       const struct ccn_charbuf *Name,
+                                       const struct ccn_charbuf *SignedInfo,
+                                       const void *data,
+                                       size_t size,
+                                       const char *digest_algorithm,
+                                       const void *signature,
+                                       size_t signature_size);
+
 /***********************************
  * Matching
  */
@@ -906,6 +961,32 @@ int ccn_excluded(const unsigned char *excl,
                  const unsigned char *nextcomp,
                  size_t nextcomp_size);
 
+/***********************************
+ * InterestNack
+ *
+ * Tells a downstream neighbor that an Interest it sent cannot be
+ * satisfied this way, so that it need not wait out the lifetime.
+ * The Interest is carried as it was received, Nonce and all.
+ * These are only sent for Interests that ask for them with CCN_AOK_NACK.
+ */
+enum ccn_nack_reason {
+    CCN_NACK_NO_ROUTE = 1,      /**< no FIB entry, or every upstream failed */
+    CCN_NACK_CONGESTION = 2,    /**< every upstream is backed up */
+    CCN_NACK_DUPLICATE = 3      /**< the Nonce was seen on another face */
+};
+
+int ccn_encode_InterestNack(struct ccn_charbuf *buf, int reason,
+                            const unsigned char *interest, size_t size);
+
+/*
+ * ccn_parse_InterestNack:
+ * Returns the reason, or a negative value for an error.
+ * The Interest it carries is returned through interest and interest_size.
+ */
+int ccn_parse_InterestNack(const unsigned char *msg, size_t size,
+                           const unsigned char **interest,
+                           size_t *interest_size);
+
 /***********************************
  * StatusResponse
  */
@@ -27,6 +27,8 @@
 
 struct ccn;
 struct ccn_charbuf;
+struct ccn_indexbuf;
+struct ccn_parsed_ContentObject;
 struct sockaddr_un;
 struct sockaddr;
 struct ccn_schedule;
@@ -36,6 +38,23 @@ struct ccn_schedule;
  */
 void ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size);
 
+/*
+ * The common part of ccn_get and ccn_get_multi.
+ * templates, if not NULL, gives a template for each name, overriding
+ * interest_template.  pcobuf and compsbuf apply to the first name.
+ * Returns the number of ContentObjects obtained, or -1 for an error.
+ */
+int ccn_get_batch(struct ccn *h,
+                  struct ccn_charbuf **names,
+                  int n,
+                  struct ccn_charbuf *interest_template,
+                  struct ccn_charbuf **templates,
+                  int timeout_ms,
+                  struct ccn_charbuf **results,
+                  struct ccn_parsed_ContentObject *pcobuf,
+                  struct ccn_indexbuf *compsbuf,
+                  int flags);
+
 /*
  * Do any time-based operations
  * Returns number of microseconds before next call needed
@@ -55,6 +74,16 @@ struct ccn_schedule *ccn_set_schedule(struct ccn *h, struct ccn_schedule *s);
  */
 struct ccn_charbuf *ccn_grab_buffered_output(struct ccn *h);
 
+/*
+ * Hand each message put on an unconnected handle to a function,
+ * rather than buffering it.  The message is passed by reference and is
+ * valid only for the duration of the call, which must not re-enter the
+ * handle.
+ */
+typedef void ccn_output_hook(void *hookdata,
+                             const unsigned char *msg, size_t size);
+void ccn_set_output_hook(struct ccn *h, ccn_output_hook *hook, void *hookdata);
+
 /*
  * set up client sockets for communicating with ccnd
  * In the INET case, the sockaddr passed in must be large enough to
@@ -164,6 +164,8 @@ enum ccn_dtag {
     CCN_DTAG_SyncConfigSliceList = 125,
     CCN_DTAG_SyncConfigSliceOp = 126,
     CCN_DTAG_SyncNodeDeltas = 127,
+    CCN_DTAG_InterestNack = 128,
+    CCN_DTAG_NackReason = 129,
     CCN_DTAG_SequenceNumber = 256,
     CCN_DTAG_CCNProtocolDataUnit = 17702112
 };
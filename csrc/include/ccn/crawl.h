@@ -0,0 +1,98 @@
+/**
+ * @file ccn/crawl.h
+ * @brief Enumeration of the content under a name prefix.
+ *
+ * A crawl discovers the names under a prefix with passive interests that
+ * exclude everything already found.  The name space at the prefix is
+ * divided into many ranges from the start, each with its own interest,
+ * and a range is split in two at each name that it turns up, so the
+ * interests stay small no matter how many names there are.  The names
+ * found are kept in order, level by level.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_CRAWL_DEFINED
+#define CCN_CRAWL_DEFINED
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ccn/ccn.h>
+
+/**
+ * Upper bound on the number of interests in flight.
+ */
+#define CCN_CRAWL_MAX_WINDOW 4096
+
+/**
+ * Upper bound on the number of ranges the prefix is first divided into.
+ */
+#define CCN_CRAWL_MAX_PARTITIONS 65
+
+/* flags for ccn_crawl_create */
+#define CCN_CRAWL_LOCAL_SCOPE 1     /**< ask only the local ccnd (Scope 0) */
+#define CCN_CRAWL_ALLOW_STALE 2     /**< also enumerate stale content */
+
+struct ccn_crawl;
+
+/**
+ * Counters, for monitoring a crawl.
+ */
+struct ccn_crawl_stats {
+    uintmax_t found;            /**< content objects found */
+    uintmax_t nodes;            /**< names explored for further components */
+    uintmax_t expressed;        /**< interests sent, including retries */
+    uintmax_t timeouts;         /**< interests that timed out */
+    uintmax_t empty;            /**< ranges found to hold nothing more */
+    uintmax_t duplicates;       /**< arrivals that were not needed */
+    int in_flight;              /**< interests currently outstanding */
+    int window;                 /**< current concurrency window */
+    int queued;                 /**< ranges waiting for the window to open */
+    int srtt_us;                /**< smoothed round-trip time of answers */
+    int done;                   /**< nonzero when nothing is left to ask */
+};
+
+/**
+ * Create a crawl of the content under name_prefix.
+ *
+ * The client closure is called with CCN_UPCALL_CONTENT (or
+ * CCN_UPCALL_CONTENT_UNVERIFIED) once for each content object found,
+ * in no particular order, and with CCN_UPCALL_FINAL when the crawl is
+ * destroyed.  Only content already held by the network is enumerated;
+ * the interests ask that none be generated.
+ * @param flags are CCN_CRAWL_LOCAL_SCOPE and CCN_CRAWL_ALLOW_STALE.
+ */
+struct ccn_crawl *ccn_crawl_create(struct ccn *h,
+                                   struct ccn_charbuf *name_prefix,
+                                   int flags,
+                                   struct ccn_closure *client);
+int ccn_crawl_set_window(struct ccn_crawl *c, int window);
+int ccn_crawl_set_partitions(struct ccn_crawl *c, int partitions);
+int ccn_crawl_start(struct ccn_crawl *c);
+int ccn_crawl_get_stats(struct ccn_crawl *c, struct ccn_crawl_stats *stats);
+
+/**
+ * Called by ccn_crawl_walk() with the ccnb-encoded Name of a content
+ * object, including its implicit digest component.
+ * @returns 0 to continue, or nonzero to stop the walk.
+ */
+typedef int ccn_crawl_walker(void *data, const unsigned char *name,
+                             size_t size);
+
+int ccn_crawl_walk(struct ccn_crawl *c, ccn_crawl_walker *walker, void *data);
+void ccn_crawl_destroy(struct ccn_crawl **cp);
+
+#endif
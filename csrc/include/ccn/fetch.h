@@ -53,6 +53,11 @@ typedef enum {
 	ccn_fetch_flags_NoteAll = 0xffff
 } ccn_fetch_flags;
 
+/**
+ * Upper bound for the number of buffers (the fetch window) of a stream.
+ */
+#define CCN_FETCH_MAX_BUFS 64
+
 #define CCN_FETCH_READ_ZERO (-3)
 #define CCN_FETCH_READ_TIMEOUT (-2)
 #define CCN_FETCH_READ_NONE (-1)
@@ -110,7 +115,7 @@ ccn_fetch_get_ccn(struct ccn_fetch *f);
  * and an attempt is made to determine the version number using the highest
  * version.  If interestTemplate == NULL then a suitable default is used.
  * The max number of buffers (maxBufs) is a hint, and may be clamped to an
- * implementation minimum or maximum.
+ * implementation minimum or maximum (see CCN_FETCH_MAX_BUFS).
  * If assumeFixed, then assume that the segment size is given by the first
  * segment fetched, otherwise segments may be of variable size. 
  * @returns NULL if the stream creation failed,
@@ -163,6 +168,29 @@ ccn_fetch_read(struct ccn_fetch_stream *fs,
 			   void *buf,
 			   intmax_t len);
 
+/**
+ * Changes the maximum number of buffers (the fetch window) for the stream.
+ * Clients may use this to adapt the number of segment interests in flight
+ * to the observed delivery rate.
+ * @returns the new (possibly clamped) window, or -1 if maxBufs <= 0.
+ */
+int
+ccn_fetch_set_window(struct ccn_fetch_stream *fs, int maxBufs);
+
+/**
+ * @returns the current fetch window (max number of buffers).
+ */
+int
+ccn_fetch_get_window(struct ccn_fetch_stream *fs);
+
+/**
+ * @returns the segment size for the stream, 0 if not yet known,
+ * or -1 if segments are of variable size.
+ * Once known, byte positions map to segment numbers as pos / size.
+ */
+int
+ccn_fetch_seg_size(struct ccn_fetch_stream *fs);
+
 /**
  * Resets the timeout indicator, which will cause pending interests to be
  * retried.  The client determines conditions for a timeout to be considered
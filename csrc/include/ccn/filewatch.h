@@ -0,0 +1,74 @@
+/**
+ * @file ccn/filewatch.h
+ * @brief Notification of changes to files and directory trees.
+ *
+ * A watcher follows files and whole directory trees, picking up
+ * subdirectories as they are created, and reports each changed file
+ * once its changes have settled, so a burst of writes turns into one
+ * report.  It is event driven (inotify), and is meant to be polled
+ * together with the ccn connection.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_FILEWATCH_DEFINED
+#define CCN_FILEWATCH_DEFINED
+
+struct ccn_filewatch;
+
+/* kinds of change reported to a ccn_filewatch_handler */
+#define CCN_FILEWATCH_CHANGED 1     /**< created or written */
+#define CCN_FILEWATCH_REMOVED 2     /**< unlinked or renamed away */
+
+/**
+ * Called by ccn_filewatch_process() for each file whose changes
+ * have settled.  The path is the watched path, extended by the
+ * names of the directories below it.
+ */
+typedef void ccn_filewatch_handler(void *data, const char *path, int kind);
+
+/**
+ * Create a watcher.
+ *
+ * A file is reported when settle_ms milliseconds have passed
+ * without further changes to it, or when it has been changing for
+ * ten times that long.
+ * @returns NULL, with errno set, if the system has no support.
+ */
+struct ccn_filewatch *ccn_filewatch_create(int settle_ms);
+
+/**
+ * Watch a file, or a directory and everything under it.
+ * @returns 0 for success, -1 for error (see errno).
+ */
+int ccn_filewatch_add(struct ccn_filewatch *w, const char *path);
+
+/**
+ * Get the file descriptor that becomes readable when there are events.
+ */
+int ccn_filewatch_fd(struct ccn_filewatch *w);
+
+/**
+ * Take in any pending events, and report the files that have settled.
+ * @returns the number of microseconds until the next file is due to
+ *          settle, or -1 if there are none waiting.
+ */
+int ccn_filewatch_process(struct ccn_filewatch *w,
+                          ccn_filewatch_handler *handler, void *data);
+
+void ccn_filewatch_destroy(struct ccn_filewatch **wp);
+
+#endif
@@ -42,6 +42,11 @@ struct ccn_pkey;
  */
 struct ccn_certificate;
 
+/*
+ * opaque type for signing contexts (see ccn/signing.h)
+ */
+struct ccn_sigc;
+
 struct ccn_keystore *ccn_keystore_create(void);
 void ccn_keystore_destroy(struct ccn_keystore **p);
 int ccn_keystore_init(struct ccn_keystore *p, char *name, char *password);
@@ -51,5 +56,27 @@ const char *ccn_keystore_digest_algorithm(struct ccn_keystore *p);
 ssize_t ccn_keystore_public_key_digest_length(struct ccn_keystore *p);
 const unsigned char *ccn_keystore_public_key_digest(struct ccn_keystore *p);
 const struct ccn_certificate *ccn_keystore_certificate(struct ccn_keystore *p);
+struct ccn_sigc *ccn_keystore_sigc(struct ccn_keystore *p);
 int ccn_keystore_file_init(char *filename, char *password, char *subject, int keylength, int validity_days);
+
+/*
+ * Key types that ccn_keystore_file_init_type can generate,
+ * and shared secrets for keyed-hash signatures
+ */
+enum ccn_keystore_key_type {
+    CCN_KEYSTORE_KEY_RSA = 0,   /**< RSA, keylength bits (default 1024) */
+    CCN_KEYSTORE_KEY_EC = 1,    /**< ECDSA over NIST P-256 (keylength 256) */
+    CCN_KEYSTORE_KEY_HMAC = 2   /**< shared secret for HMAC-SHA256 */
+};
+int ccn_keystore_file_init_type(char *filename, char *password, char *subject,
+                                enum ccn_keystore_key_type key_type,
+                                int keylength, int validity_days);
+int ccn_keystore_key_type(struct ccn_keystore *p);
+
+/*
+ * Shared secrets are kept in files of raw random bytes, readable
+ * only by their owner.
+ */
+int ccn_keystore_init_secret(struct ccn_keystore *p, char *filename);
+int ccn_keystore_secret_file_init(char *filename, int keylength);
 #endif
@@ -0,0 +1,84 @@
+/**
+ * @file ccn/publish.h
+ * @brief Publish files as segmented content, signing in parallel.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_PUBLISH_DEFINED
+#define CCN_PUBLISH_DEFINED
+
+#include <stdint.h>
+struct ccn_publisher;
+struct ccn;
+struct ccn_charbuf;
+struct ccn_signing_params;
+
+#define CCN_PUBLISH_MAX_BLOCKSIZE (1 << 20)
+#define CCN_PUBLISH_MAX_WORKERS 64
+
+/**
+ * Counters, for monitoring a publisher.
+ */
+struct ccn_publisher_stats {
+    uintmax_t files;            /**< files published */
+    uintmax_t segments;         /**< segments signed */
+    uintmax_t bytes;            /**< bytes of file data published */
+    uintmax_t served;           /**< segments sent in answer to interests */
+    uintmax_t unchanged;        /**< updates skipped, content the same */
+};
+
+/**
+ * Create a publisher that answers interests under prefix.
+ *
+ * Each file is cut into blocks of blocksize bytes, named with the
+ * segment numbering convention under the name it is added with.
+ * The segments are signed by worker processes, and kept in
+ * spool files rather than in memory.
+ * @param params may be NULL for the defaults.
+ */
+struct ccn_publisher *
+ccn_publisher_create(struct ccn *h, struct ccn_charbuf *prefix,
+                     const struct ccn_signing_params *params,
+                     int blocksize, int workers);
+int ccn_publisher_add_file(struct ccn_publisher *p, struct ccn_charbuf *name,
+                           const char *path);
+
+/**
+ * Publish the file at path as a new version of name.
+ *
+ * The segments go under name plus a version component, and an interest
+ * for name alone is answered with the first segment of the latest
+ * version.  Nothing is signed if the file has the same content as the
+ * version already published.  The previous version is no longer served.
+ * @returns the number of segments published, 0 if the content is
+ *          unchanged, or -1 for an error.
+ */
+int ccn_publisher_update_file(struct ccn_publisher *p,
+                              struct ccn_charbuf *name, const char *path);
+
+/**
+ * Stop serving the versions of name published by
+ * ccn_publisher_update_file().
+ * @returns 0 for success, -1 if nothing was published under name.
+ */
+int ccn_publisher_remove_file(struct ccn_publisher *p,
+                              struct ccn_charbuf *name);
+int ccn_publisher_get_stats(struct ccn_publisher *p,
+                            struct ccn_publisher_stats *stats);
+void ccn_publisher_destroy(struct ccn_publisher **pp);
+
+#endif
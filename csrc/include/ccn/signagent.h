@@ -0,0 +1,155 @@
+/**
+ * @file ccn/signagent.h
+ * @brief Signing through a per-user agent that holds unlocked keys.
+ *
+ * Loading a keystore means decrypting it, which costs a short-lived
+ * tool much more than the one signature it makes.  A signing agent
+ * (see ccnsignagent) loads the user's keystores once, and then signs
+ * SHA-256 digests for its clients over a unix-domain socket, many to
+ * a request if the client likes.  When an agent is running, a ccn
+ * handle that needs the user's default key signs through it instead
+ * of loading the keystore; set CCNX_SIGNAGENT_SOCK to the empty string
+ * to prevent this.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_SIGNAGENT_DEFINED
+#define CCN_SIGNAGENT_DEFINED
+
+#include <stddef.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+
+/*
+ * Agent protocol
+ *
+ * Each message is an 8-byte header followed by a body.  The header
+ * holds a version byte, an op, a 16-bit count, and the 32-bit size of
+ * the body, all big-endian.
+ *
+ * CCN_SIGNAGENT_OP_KEY asks about a key; the body is a key id, or empty
+ * for the agent's default key.  The reply body is the 32-byte key id,
+ * a 16-bit length and the DigestAlgorithm (empty for the default),
+ * and then the DER-encoded public key.
+ *
+ * CCN_SIGNAGENT_OP_SIGN has the key id, followed by count SHA-256
+ * digests.  The reply holds count signatures, each preceded by its
+ * 16-bit length.
+ *
+ * A failed request gets CCN_SIGNAGENT_OP_ERROR, with an errno value
+ * as the count and an empty body.
+ */
+#define CCN_SIGNAGENT_VERSION       1
+#define CCN_SIGNAGENT_OP_KEY        1
+#define CCN_SIGNAGENT_OP_SIGN       2
+#define CCN_SIGNAGENT_OP_ERROR      255
+#define CCN_SIGNAGENT_HEADER_SIZE   8
+#define CCN_SIGNAGENT_KEYID_SIZE    32
+#define CCN_SIGNAGENT_DIGEST_SIZE   32
+#define CCN_SIGNAGENT_MAX_BATCH     4096
+
+struct ccn_pkey;
+struct ccn_signagent;
+struct ccn_signagent_server;
+
+/**
+ * Find the pathname of the agent's socket.
+ *
+ * This is CCNX_SIGNAGENT_SOCK if it is set, otherwise .ccnx_signagent.sock
+ * next to the user's default keystore.
+ * @returns 0 for success, -1 if the agent is disabled or there is no
+ *          place for it.
+ */
+int ccn_signagent_sockname(struct ccn_charbuf *path);
+
+/**
+ * Connect to an agent and learn its default key.
+ *
+ * A process forked after this gets a connection of its own the first
+ * time it asks for a signature.
+ * @param sockname is the agent's socket, or NULL for the usual one.
+ * @returns NULL, with errno set, if no agent is serving.
+ */
+struct ccn_signagent *ccn_signagent_open(const char *sockname);
+void ccn_signagent_close(struct ccn_signagent **ap);
+
+/** The key id (public key digest) of the agent's default key */
+const unsigned char *ccn_signagent_pubid(struct ccn_signagent *a);
+/** The public key of the agent's default key */
+const struct ccn_pkey *ccn_signagent_public_key(struct ccn_signagent *a);
+/** The DigestAlgorithm to put in Signatures, NULL for the default */
+const char *ccn_signagent_digest_algorithm(struct ccn_signagent *a);
+
+/**
+ * Sign a batch of SHA-256 digests with the agent's default key.
+ * @param digests holds count digests of CCN_SIGNAGENT_DIGEST_SIZE bytes.
+ * @param sigs has the signatures appended.
+ * @param ends, if not NULL, has the end offset in sigs of each
+ *        signature appended.
+ * @returns 0 for success, -1 for error (see errno).
+ */
+int ccn_signagent_sign_digests(struct ccn_signagent *a,
+                               const unsigned char *digests, int count,
+                               struct ccn_charbuf *sigs,
+                               struct ccn_indexbuf *ends);
+
+/**
+ * Append a ContentObject signed by the agent's default key.
+ *
+ * This is ccn_encode_ContentObject(), with the signing done by the agent.
+ * @returns 0 for success, -1 for error.
+ */
+int ccn_signagent_sign_content(struct ccn_signagent *a,
+                               struct ccn_charbuf *resultbuf,
+                               const struct ccn_charbuf *Name,
+                               const struct ccn_charbuf *SignedInfo,
+                               const void *data, size_t size);
+
+/**
+ * Create the serving end of an agent, listening on sockname.
+ *
+ * A stale socket at sockname, with no agent answering on it, is
+ * replaced; anything else that is there is left alone, and the call
+ * fails with EEXIST (or EADDRINUSE for a live agent).  The socket is
+ * accessible only to its owner.
+ * @returns NULL, with errno set, for failure.
+ */
+struct ccn_signagent_server *ccn_signagent_server_create(const char *sockname);
+
+/**
+ * Unlock a keystore and serve its key.  The first key added is the
+ * default key.  Only keys with SHA-256 signatures can be served.
+ * @param pubid_out, if not NULL, is loaded with the key id.
+ * @returns 0 for success, -1 for error (see errno).
+ */
+int ccn_signagent_server_add_key(struct ccn_signagent_server *s,
+                                 const char *keystore_path,
+                                 const char *password,
+                                 struct ccn_charbuf *pubid_out);
+
+/**
+ * Serve clients for up to timeout_ms milliseconds (-1 for no limit).
+ * @returns 0, or -1 if the listening socket has failed.
+ */
+int ccn_signagent_server_run(struct ccn_signagent_server *s, int timeout_ms);
+
+/**
+ * Close everything and remove the socket.
+ */
+void ccn_signagent_server_destroy(struct ccn_signagent_server **sp);
+
+#endif
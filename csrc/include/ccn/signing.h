@@ -53,6 +53,9 @@ void ccn_sigc_destroy(struct ccn_sigc **);
 int ccn_sigc_update(struct ccn_sigc *ctx, const void *data, size_t size);
 int ccn_sigc_final(struct ccn_sigc *ctx, struct ccn_signature *signature, size_t *size, const struct ccn_pkey *priv_key);
 size_t ccn_sigc_signature_max_size(struct ccn_sigc *ctx, const struct ccn_pkey *priv_key);
+int ccn_sign_digest(const struct ccn_pkey *priv_key,
+                    const unsigned char *digest, size_t digest_size,
+                    unsigned char *signature, size_t *size);
 int ccn_verify_signature(const unsigned char *msg, size_t size, const struct ccn_parsed_ContentObject *co,
                          const struct ccn_pkey *verification_pubkey);
 struct ccn_pkey *ccn_d2i_pubkey(const unsigned char *p, size_t size);
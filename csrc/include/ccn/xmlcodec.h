@@ -0,0 +1,116 @@
+/**
+ * @file ccn/xmlcodec.h
+ * @brief Streaming conversion between ccnb and its XML representation.
+ *
+ * Both converters accept their input in arbitrary pieces and write their
+ * output through a caller-supplied function, so a file of any size can be
+ * converted with memory bounded by its largest single element.  Output
+ * is accumulated and handed over in large blocks.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef CCN_XMLCODEC_DEFINED
+#define CCN_XMLCODEC_DEFINED
+
+#include <stddef.h>
+#include <ccn/coding.h>
+
+struct ccn_ccnbtoxml;
+struct ccn_xmltoccnb;
+
+/**
+ * Output function for the converters.
+ * @returns negative for an error, which stops the conversion.
+ */
+typedef int ccn_xmlcodec_output(void *outdata,
+                                const unsigned char *p, size_t size);
+
+/* flags for ccn_ccnbtoxml_create */
+#define CCN_CCNBTOXML_FORCE_BINARY  (1 << 0) /**< no text BLOBs, no line breaks */
+#define CCN_CCNBTOXML_PREFER_HEX    (1 << 1) /**< hexBinary instead of base64 */
+#define CCN_CCNBTOXML_VERBOSE       (1 << 2) /**< annotate Components */
+
+/**
+ * Create a ccnb to XML converter.
+ * @param dtags is the dictionary of DTAG names, normally &ccn_dtag_dict;
+ *        it must outlast the converter.
+ */
+struct ccn_ccnbtoxml *
+ccn_ccnbtoxml_create(int flags, const struct ccn_dict *dtags,
+                     ccn_xmlcodec_output *out, void *outdata);
+
+/**
+ * Convert some ccnb.
+ *
+ * Stops just after the end of each top-level element, so the caller may
+ * redirect the output between objects.
+ * @returns the number of bytes consumed; fewer than n only at the end of
+ *          an object or on an error.
+ */
+size_t ccn_ccnbtoxml_decode(struct ccn_ccnbtoxml *d,
+                            const unsigned char *p, size_t n);
+
+/**
+ * @returns -1 after an error, 0 between top-level elements,
+ *          or 1 inside one.
+ */
+int ccn_ccnbtoxml_status(struct ccn_ccnbtoxml *d);
+
+/**
+ * Hand over any buffered output.
+ * @returns 0, or -1 if the output function failed.
+ */
+int ccn_ccnbtoxml_flush(struct ccn_ccnbtoxml *d);
+
+void ccn_ccnbtoxml_destroy(struct ccn_ccnbtoxml **dp);
+
+/* flags for ccn_xmltoccnb_create */
+#define CCN_XMLTOCCNB_TOSS_WHITE    (1 << 0) /**< drop whitespace-only UDATA */
+
+/**
+ * Create an XML to ccnb converter.
+ *
+ * The XML may contain any number of top-level elements, each of which
+ * becomes one ccnb object.  Attributes named ccnbencoding select how
+ * character data is turned into a BLOB, as written by ccn_ccnbtoxml.
+ * @param dtags is the dictionary of DTAG names, normally &ccn_dtag_dict.
+ */
+struct ccn_xmltoccnb *
+ccn_xmltoccnb_create(int flags, const struct ccn_dict *dtags,
+                     ccn_xmlcodec_output *out, void *outdata);
+
+/**
+ * Convert some XML.
+ * @returns 0, or -1 for malformed input or an output error.
+ */
+int ccn_xmltoccnb_encode(struct ccn_xmltoccnb *u,
+                         const unsigned char *p, size_t n);
+
+/**
+ * Check that the input ended cleanly, and flush the output.
+ * @returns 0, or -1 for truncated input or an output error.
+ */
+int ccn_xmltoccnb_finish(struct ccn_xmltoccnb *u);
+
+/**
+ * @returns the current input line number, for error messages.
+ */
+int ccn_xmltoccnb_line(struct ccn_xmltoccnb *u);
+
+void ccn_xmltoccnb_destroy(struct ccn_xmltoccnb **up);
+
+#endif
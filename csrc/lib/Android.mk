@@ -27,10 +27,12 @@ CCNLIBOBJ := ccn_client.o ccn_charbuf.o ccn_indexbuf.o ccn_coding.o \
 		ccn_buf_decoder.o ccn_uri.o ccn_buf_encoder.o ccn_bloom.o \
 		ccn_name_util.o ccn_face_mgmt.o ccn_reg_mgmt.o ccn_digest.o \
 		ccn_interest.o ccn_keystore.o ccn_seqwriter.o ccn_signing.o \
+		ccn_publish.o \
 		ccn_sockcreate.o ccn_traverse.o \
 		ccn_match.o hashtb.o ccn_merkle_path_asn1.o \
 		ccn_sockaddrutil.o ccn_setup_sockaddr_un.o \
 		ccn_bulkdata.o ccn_versioning.o ccn_header.o ccn_fetch.o \
+		ccn_xmlcodec.o ccn_archive.o ccn_crawl.o ccn_filewatch.o ccn_signagent.o \
 		ccn_btree.o ccn_btree_content.o ccn_btree_store.o
 
 CCNLIBSRC := $(CCNLIBOBJ:.o=.c)
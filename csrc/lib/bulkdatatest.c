@@ -0,0 +1,285 @@
+/**
+ * @file bulkdatatest.c
+ *
+ * A test program for the bulk data transfer engine.
+ *
+ * Runs a transfer over an unconnected ccn handle, answering the
+ * interests directly with ccn_dispatch_message(), as ccnd does for its
+ * internal client.  Interests are dropped at random to inject loss, and
+ * the answers to each batch are shuffled to exercise the reordering.
+ * Checks that every item is delivered once, in order, and reports the
+ * throughput at each loss rate.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ccn/bulkdata.h>
+#include <ccn/ccn.h>
+#include <ccn/ccn_private.h>
+#include <ccn/charbuf.h>
+#include <ccn/keystore.h>
+#include <ccn/uri.h>
+
+#define COUNT 1000
+#define PAYLOAD_SIZE 1024
+#define WINDOW 32
+#define MAX_BATCH 256
+
+struct receiver {
+    struct ccn_closure cl;
+    struct ccn_bulkdata **bp;   /* destroyed from the upcall when done */
+    struct ccn_bulkdata_stats stats;
+    uintmax_t expected;
+    int hole;                   /* item that is never answered, or -1 */
+    int errors;
+    int timeouts;
+    int finals;
+};
+
+static struct ccn_charbuf **objects;
+
+static enum ccn_upcall_res
+incoming(struct ccn_closure *selfp,
+         enum ccn_upcall_kind kind,
+         struct ccn_upcall_info *info)
+{
+    struct receiver *r = selfp->data;
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
+
+    switch (kind) {
+        case CCN_UPCALL_FINAL:
+            r->finals++;
+            return(CCN_UPCALL_RESULT_OK);
+        case CCN_UPCALL_INTEREST_TIMED_OUT:
+            r->timeouts++;
+            if (r->hole < 0)
+                return(CCN_UPCALL_RESULT_REEXPRESS);
+            /* give up on the hole, and expect what follows */
+            if (r->expected != r->hole) {
+                fprintf(stderr, "timed out at %ju, not %d\n", r->expected, r->hole);
+                r->errors++;
+            }
+            r->expected++;
+            return(CCN_UPCALL_RESULT_OK);
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+            break;
+        default:
+            r->errors++;
+            return(CCN_UPCALL_RESULT_ERR);
+    }
+    ccn_content_get_value(info->content_ccnb, info->pco->offset[CCN_PCO_E],
+                          info->pco, &data, &data_size);
+    if (r->expected >= COUNT || data_size != PAYLOAD_SIZE ||
+        data[0] != (r->expected & 0xff) || data[1] != ((r->expected >> 8) & 0xff)) {
+        fprintf(stderr, "item %ju out of order or damaged\n", r->expected);
+        r->errors++;
+    }
+    r->expected++;
+    if (r->expected == COUNT) {
+        ccn_bulkdata_get_stats(*r->bp, &r->stats);
+        ccn_bulkdata_destroy(r->bp);
+    }
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+static void
+make_objects(struct ccn_charbuf *prefix)
+{
+    struct ccn_keystore *keystore = ccn_keystore_create();
+    struct ccn_charbuf *signed_info = ccn_charbuf_create();
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *finalblockid = ccn_charbuf_create();
+    struct ccn_charbuf *seqcomp = ccn_charbuf_create();
+    const char *keystore_name = "test.keystore";
+    const char *keystore_password = "Th1s1sn0t8g00dp8ssw0rd.";
+    unsigned char data[PAYLOAD_SIZE];
+    int res;
+    int i;
+
+    res = ccn_keystore_init(keystore, (char *)keystore_name, (char *)keystore_password);
+    if (res != 0) {
+        res = ccn_keystore_file_init((char *)keystore_name, (char *)keystore_password,
+                                     "ccnxuser", 0, 3650);
+        if (res == 0)
+            res = ccn_keystore_init(keystore, (char *)keystore_name,
+                                    (char *)keystore_password);
+        if (res != 0) {
+            fprintf(stderr, "Cannot create keystore %s\n", keystore_name);
+            exit(1);
+        }
+    }
+    objects = calloc(COUNT, sizeof(objects[0]));
+    ccn_segment_seqfunc(COUNT - 1, NULL, seqcomp);
+    ccn_charbuf_append_tt(finalblockid, seqcomp->length, CCN_BLOB);
+    ccn_charbuf_append_charbuf(finalblockid, seqcomp);
+    memset(data, 'b', sizeof(data));
+    for (i = 0; i < COUNT; i++) {
+        signed_info->length = 0;
+        res = ccn_signed_info_create(signed_info,
+                                     ccn_keystore_public_key_digest(keystore),
+                                     ccn_keystore_public_key_digest_length(keystore),
+                                     NULL, CCN_CONTENT_DATA, -1,
+                                     (i == COUNT - 1) ? finalblockid : NULL,
+                                     NULL);
+        name->length = 0;
+        ccn_charbuf_append_charbuf(name, prefix);
+        ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i);
+        data[0] = i & 0xff;
+        data[1] = (i >> 8) & 0xff;
+        objects[i] = ccn_charbuf_create();
+        res |= ccn_encode_ContentObject(objects[i], name, signed_info,
+                                        data, sizeof(data), NULL,
+                                        ccn_keystore_private_key(keystore));
+        if (res != 0) {
+            fprintf(stderr, "Failed to encode ContentObject\n");
+            exit(1);
+        }
+    }
+    ccn_charbuf_destroy(&finalblockid);
+    ccn_charbuf_destroy(&seqcomp);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&signed_info);
+    ccn_keystore_destroy(&keystore);
+}
+
+/*
+ * The item an interest asks for, from its last name component.
+ */
+static int
+requested_item(const unsigned char *interest, size_t size)
+{
+    struct ccn_parsed_interest pi = {0};
+    struct ccn_indexbuf *comps = ccn_indexbuf_create();
+    const unsigned char *comp = NULL;
+    size_t comp_size = 0;
+    int x = -1;
+    size_t i;
+
+    if (ccn_parse_interest(interest, size, &pi, comps) >= 0 &&
+        ccn_name_comp_get(interest, comps, comps->n - 2, &comp, &comp_size) == 0 &&
+        comp_size >= 1 && comp[0] == CCN_MARKER_SEQNUM) {
+        for (x = 0, i = 1; i < comp_size; i++)
+            x = (x << 8) + comp[i];
+    }
+    ccn_indexbuf_destroy(&comps);
+    return(x);
+}
+
+static int
+run(int loss_percent, int window, int hole)
+{
+    struct ccn *h = ccn_create();
+    struct ccn_charbuf *prefix = ccn_charbuf_create();
+    struct ccn_charbuf *out = NULL;
+    struct ccn_bulkdata *b = NULL;
+    struct ccn_bulkdata_stats *stats;
+    struct receiver rr = {{0}};
+    struct receiver *r = &rr;
+    struct ccn_skeleton_decoder dd;
+    struct timeval t0, t1;
+    int batch[MAX_BATCH];
+    int n, i, j, t, x;
+    size_t start;
+    double elapsed;
+
+    ccn_name_from_uri(prefix, "ccnx:/test/bulkdata");
+    if (objects == NULL)
+        make_objects(prefix);
+    r->cl.p = &incoming;
+    r->cl.data = r;
+    r->bp = &b;
+    r->hole = hole;
+    stats = &r->stats;
+    b = ccn_bulkdata_create(h, prefix, &ccn_segment_seqfunc, NULL, 0, &r->cl);
+    if (b == NULL || ccn_bulkdata_set_window(b, window) < 0) {
+        fprintf(stderr, "ccn_bulkdata_create failed\n");
+        exit(1);
+    }
+    srandom(loss_percent + 1);
+    gettimeofday(&t0, NULL);
+    ccn_bulkdata_start(b);
+    while (b != NULL) {
+        ccn_process_scheduled_operations(h);
+        out = ccn_grab_buffered_output(h);
+        n = 0;
+        for (start = 0; out != NULL && start < out->length; start += dd.index) {
+            memset(&dd, 0, sizeof(dd));
+            ccn_skeleton_decode(&dd, out->buf + start, out->length - start);
+            if (!CCN_FINAL_DSTATE(dd.state))
+                break;
+            x = requested_item(out->buf + start, dd.index);
+            if (x < 0 || x >= COUNT || x == hole || n == MAX_BATCH)
+                continue;
+            if (random() % 100 < loss_percent)
+                continue;
+            batch[n++] = x;
+        }
+        ccn_charbuf_destroy(&out);
+        /* answer the batch in a random order */
+        for (i = n - 1; i > 0; i--) {
+            j = random() % (i + 1);
+            t = batch[i]; batch[i] = batch[j]; batch[j] = t;
+        }
+        for (i = 0; i < n; i++)
+            ccn_dispatch_message(h, objects[batch[i]]->buf, objects[batch[i]]->length);
+        if (n == 0)
+            usleep(1000);
+    }
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    printf("loss %2d%%%s: %ju items in %.3f s, %.0f items/s, %ju expressed, "
+           "%ju timeouts, %ju reordered, %ju duplicates, rto %d us\n",
+           loss_percent, hole < 0 ? "" : ", 1 hole",
+           stats->delivered, elapsed, stats->delivered / elapsed,
+           stats->expressed, stats->timeouts, stats->reordered,
+           stats->duplicates, stats->rto_us);
+    ccn_destroy(&h);
+    ccn_charbuf_destroy(&prefix);
+    if (r->expected != COUNT || r->errors != 0 || r->finals != 1) {
+        fprintf(stderr, "FAILED: %ju of %d delivered, %d errors, %d finals\n",
+                r->expected, COUNT, r->errors, r->finals);
+        return(1);
+    }
+    return(0);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int losses[] = {0, 1, 5, 10, -1};
+    int window = WINDOW;
+    int status = 0;
+    int i;
+
+    if (argc > 1)
+        window = atoi(argv[1]);
+    if (window < 1 || window > CCN_BULKDATA_MAX_WINDOW) {
+        fprintf(stderr, "usage: %s [window]\n", argv[0]);
+        exit(1);
+    }
+    for (i = 0; losses[i] >= 0; i++)
+        status |= run(losses[i], window, -1);
+    status |= run(0, window, COUNT / 2);
+    for (i = 0; objects != NULL && i < COUNT; i++)
+        ccn_charbuf_destroy(&objects[i]);
+    free(objects);
+    exit(status);
+}
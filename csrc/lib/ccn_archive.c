@@ -0,0 +1,477 @@
+/**
+ * @file ccn_archive.c
+ * @brief Indexed access to files of concatenated ccnb objects.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccn/archive.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+
+/*
+ * The index file is a header followed by count + 1 offsets, the last
+ * being the end of the last complete object.  It is in host byte order,
+ * since it is only a cache; one that does not match is rebuilt.
+ */
+#define CCN_ARCHIVE_INDEX_MAGIC "CCNBIDX1"
+#define CCN_ARCHIVE_BYTEORDER 0x01020304
+
+struct ccn_archive_index_header {
+    char magic[8];
+    uint32_t byteorder;
+    uint32_t pad;
+    uint64_t size;              /* of the archive when indexed */
+    int64_t mtime;
+    uint64_t count;
+};
+
+struct ccn_archive {
+    const unsigned char *data;  /* the mapped archive */
+    size_t size;
+    const uint64_t *offsets;    /* count + 1 entries */
+    size_t count;
+    void *index_map;            /* mapped index file, if we used one */
+    size_t index_map_size;
+    uint64_t *built;            /* index we built, if we did */
+};
+
+static int
+write_full(int fd, const void *buf, size_t size)
+{
+    const unsigned char *p = buf;
+    ssize_t res;
+    size_t i;
+
+    for (i = 0; i < size; i += res) {
+        res = write(fd, p + i, size - i);
+        if (res == -1) {
+            if (errno == EINTR)
+                res = 0;
+            else
+                return(-1);
+        }
+    }
+    return(0);
+}
+
+static int
+build_index(struct ccn_archive *a)
+{
+    struct ccn_skeleton_decoder decoder;
+    struct ccn_skeleton_decoder *d = &decoder;
+    size_t limit = 1024;
+    size_t pos = 0;
+    uint64_t *p;
+    ssize_t n;
+
+    a->built = malloc(limit * sizeof(a->built[0]));
+    if (a->built == NULL)
+        return(-1);
+    a->built[0] = 0;
+    a->count = 0;
+    while (pos < a->size) {
+        memset(d, 0, sizeof(*d));
+        n = ccn_skeleton_decode(d, a->data + pos, a->size - pos);
+        if (d->state != 0 || n <= 0)
+            break; /* error or incomplete object */
+        pos += n;
+        if (a->count + 2 > limit) {
+            limit *= 2;
+            p = realloc(a->built, limit * sizeof(a->built[0]));
+            if (p == NULL)
+                return(-1);
+            a->built = p;
+        }
+        a->built[++a->count] = pos;
+    }
+    a->offsets = a->built;
+    return(0);
+}
+
+static int
+load_index(struct ccn_archive *a, const char *ipath, const struct stat *st)
+{
+    struct ccn_archive_index_header *h;
+    struct stat ist;
+    const uint64_t *o;
+    size_t i;
+    int fd;
+
+    fd = open(ipath, O_RDONLY);
+    if (fd == -1)
+        return(-1);
+    if (fstat(fd, &ist) == -1 || ist.st_size < sizeof(*h)) {
+        close(fd);
+        return(-1);
+    }
+    a->index_map_size = ist.st_size;
+    a->index_map = mmap(NULL, a->index_map_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (a->index_map == MAP_FAILED) {
+        a->index_map = NULL;
+        return(-1);
+    }
+    h = a->index_map;
+    o = (const uint64_t *)(h + 1);
+    if (memcmp(h->magic, CCN_ARCHIVE_INDEX_MAGIC, sizeof(h->magic)) != 0 ||
+        h->byteorder != CCN_ARCHIVE_BYTEORDER ||
+        h->size != st->st_size || h->mtime != st->st_mtime ||
+        a->index_map_size - sizeof(*h) < sizeof(o[0]) ||
+        h->count > (a->index_map_size - sizeof(*h)) / sizeof(o[0]) - 1)
+        goto Stale;
+    for (i = 0; i < h->count; i++)
+        if (o[i] >= o[i + 1])
+            goto Stale;
+    if (o[0] != 0 || o[h->count] > a->size)
+        goto Stale;
+    a->offsets = o;
+    a->count = h->count;
+    return(0);
+Stale:
+    munmap(a->index_map, a->index_map_size);
+    a->index_map = NULL;
+    return(-1);
+}
+
+static void
+save_index(struct ccn_archive *a, const char *ipath, const struct stat *st)
+{
+    struct ccn_archive_index_header h = {{0}};
+    struct ccn_charbuf *temp = ccn_charbuf_create();
+    int fd;
+
+    memcpy(h.magic, CCN_ARCHIVE_INDEX_MAGIC, sizeof(h.magic));
+    h.byteorder = CCN_ARCHIVE_BYTEORDER;
+    h.size = st->st_size;
+    h.mtime = st->st_mtime;
+    h.count = a->count;
+    ccn_charbuf_putf(temp, "%s.XXXXXX", ipath);
+    fd = mkstemp(ccn_charbuf_as_string(temp));
+    if (fd == -1) {
+        ccn_charbuf_destroy(&temp);
+        return; /* not writable - that's fine */
+    }
+    if (write_full(fd, &h, sizeof(h)) == 0 &&
+        write_full(fd, a->offsets, (a->count + 1) * sizeof(a->offsets[0])) == 0 &&
+        close(fd) == 0)
+        fd = rename(ccn_charbuf_as_string(temp), ipath);
+    else
+        fd = -1;
+    if (fd == -1)
+        unlink(ccn_charbuf_as_string(temp));
+    ccn_charbuf_destroy(&temp);
+}
+
+struct ccn_archive *
+ccn_archive_open(const char *path, int flags)
+{
+    struct ccn_archive *a = NULL;
+    struct ccn_charbuf *ipath = NULL;
+    struct stat st;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return(NULL);
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return(NULL);
+    }
+    a = calloc(1, sizeof(*a));
+    if (a == NULL) {
+        close(fd);
+        return(NULL);
+    }
+    a->size = st.st_size;
+    if (a->size > 0) {
+        a->data = mmap(NULL, a->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (a->data == MAP_FAILED) {
+            a->data = NULL;
+            close(fd);
+            ccn_archive_close(&a);
+            return(NULL);
+        }
+#ifdef MADV_SEQUENTIAL
+        madvise((void *)a->data, a->size, MADV_SEQUENTIAL);
+#endif
+    }
+    close(fd);
+    if ((flags & CCN_ARCHIVE_KEEP_INDEX) != 0) {
+        ipath = ccn_charbuf_create();
+        ccn_charbuf_putf(ipath, "%s%s", path, CCN_ARCHIVE_INDEX_SUFFIX);
+        if (load_index(a, ccn_charbuf_as_string(ipath), &st) == 0) {
+            ccn_charbuf_destroy(&ipath);
+            return(a);
+        }
+    }
+    if (build_index(a) < 0)
+        ccn_archive_close(&a);
+    else if (ipath != NULL)
+        save_index(a, ccn_charbuf_as_string(ipath), &st);
+    ccn_charbuf_destroy(&ipath);
+    return(a);
+}
+
+void
+ccn_archive_close(struct ccn_archive **ap)
+{
+    struct ccn_archive *a = *ap;
+
+    if (a == NULL)
+        return;
+    if (a->data != NULL)
+        munmap((void *)a->data, a->size);
+    if (a->index_map != NULL)
+        munmap(a->index_map, a->index_map_size);
+    free(a->built);
+    free(a);
+    *ap = NULL;
+}
+
+size_t
+ccn_archive_count(struct ccn_archive *a)
+{
+    return(a->count);
+}
+
+size_t
+ccn_archive_unparsed(struct ccn_archive *a)
+{
+    return(a->size - a->offsets[a->count]);
+}
+
+int
+ccn_archive_get(struct ccn_archive *a, size_t i,
+                const unsigned char **ccnb, size_t *size)
+{
+    if (i >= a->count)
+        return(-1);
+    *ccnb = a->data + a->offsets[i];
+    *size = a->offsets[i + 1] - a->offsets[i];
+    return(0);
+}
+
+/**
+ * Locate the components of the name of a ContentObject, Interest, or
+ * Name, as ccn_uri_append does.
+ */
+static int
+name_comps(const unsigned char *ccnb, size_t size, size_t *start, size_t *end)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d = ccn_buf_decoder_start(&decoder, ccnb, size);
+
+    if (ccn_buf_match_dtag(d, CCN_DTAG_Interest)    ||
+        ccn_buf_match_dtag(d, CCN_DTAG_ContentObject)) {
+        ccn_buf_advance(d);
+        if (ccn_buf_match_dtag(d, CCN_DTAG_Signature))
+            ccn_buf_advance_past_element(d);
+    }
+    if (!ccn_buf_match_dtag(d, CCN_DTAG_Name))
+        return(-1);
+    ccn_buf_advance(d);
+    *start = d->decoder.token_index;
+    while (ccn_buf_match_dtag(d, CCN_DTAG_Component))
+        ccn_buf_advance_past_element(d);
+    *end = d->decoder.token_index;
+    ccn_buf_check_close(d);
+    if (d->decoder.state < 0)
+        return(-1);
+    return(0);
+}
+
+/*
+ * Components are self-delimiting, so comparing the bytes of the encoded
+ * components suffices.
+ */
+static int
+has_prefix(const unsigned char *ccnb, size_t size,
+           const unsigned char *pcomps, size_t psize)
+{
+    size_t start, end;
+
+    if (name_comps(ccnb, size, &start, &end) < 0)
+        return(0);
+    return(end - start >= psize && memcmp(ccnb + start, pcomps, psize) == 0);
+}
+
+int
+ccn_archive_object_has_prefix(const unsigned char *ccnb, size_t size,
+                              const struct ccn_charbuf *prefix)
+{
+    size_t start, end;
+
+    if (name_comps(prefix->buf, prefix->length, &start, &end) < 0)
+        return(0);
+    return(has_prefix(ccnb, size, prefix->buf + start, end - start));
+}
+
+static int
+open_spool(void)
+{
+    char path[256];
+    const char *dir = getenv("TMPDIR");
+    int fd;
+
+    if (dir == NULL || dir[0] == 0)
+        dir = "/tmp";
+    snprintf(path, sizeof(path), "%s/ccnarchive.XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path);
+    return(fd);
+}
+
+static int
+copy_spool(int fd, int outfd)
+{
+    unsigned char buf[65536];
+    ssize_t n;
+
+    if (lseek(fd, 0, SEEK_SET) == -1)
+        return(-1);
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n == -1) {
+            if (errno == EINTR)
+                continue;
+            return(-1);
+        }
+        if (write_full(outfd, buf, n) < 0)
+            return(-1);
+    }
+    return(0);
+}
+
+int
+ccn_archive_run(struct ccn_archive *a, size_t nitems, int workers,
+                ccn_archive_worker *worker, void *data, int outfd)
+{
+    pid_t pid[CCN_ARCHIVE_MAX_WORKERS];
+    int spool[CCN_ARCHIVE_MAX_WORKERS];
+    size_t first, next;
+    int status;
+    int res = 0;
+    int n, i;
+
+    if (workers > CCN_ARCHIVE_MAX_WORKERS)
+        workers = CCN_ARCHIVE_MAX_WORKERS;
+    if (workers > nitems)
+        workers = nitems;
+    if (workers <= 1)
+        return(worker(data, a, 0, nitems, outfd) == 0 ? 0 : -1);
+    /* Don't let the workers inherit unwritten output */
+    fflush(NULL);
+    for (n = 0; n < workers; n++) {
+        spool[n] = -1;
+        if (outfd >= 0) {
+            spool[n] = open_spool();
+            if (spool[n] == -1)
+                break;
+        }
+        first = nitems * n / workers;
+        next = nitems * (n + 1) / workers;
+        pid[n] = fork();
+        if (pid[n] == 0)
+            _exit(worker(data, a, first, next - first, spool[n]) == 0 ? 0 : 1);
+        if (pid[n] == -1) {
+            if (spool[n] != -1)
+                close(spool[n]);
+            break;
+        }
+    }
+    if (n < workers)
+        res = -1;
+    for (i = 0; i < n; i++) {
+        while (waitpid(pid[i], &status, 0) == -1 && errno == EINTR)
+            continue;
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            res = -1;
+    }
+    for (i = 0; i < n; i++) {
+        if (spool[i] == -1)
+            continue;
+        if (res == 0 && copy_spool(spool[i], outfd) < 0)
+            res = -1;
+        close(spool[i]);
+    }
+    return(res);
+}
+
+struct select_state {
+    const unsigned char *pcomps;
+    size_t psize;
+    unsigned char *selected;    /* shared with the workers */
+};
+
+static int
+select_worker(void *data, struct ccn_archive *a, size_t first, size_t count,
+              int fd)
+{
+    struct select_state *s = data;
+    size_t i;
+
+    for (i = first; i < first + count; i++)
+        s->selected[i] = has_prefix(a->data + a->offsets[i],
+                                    a->offsets[i + 1] - a->offsets[i],
+                                    s->pcomps, s->psize);
+    return(0);
+}
+
+int
+ccn_archive_select(struct ccn_archive *a, const struct ccn_charbuf *prefix,
+                   int workers, struct ccn_indexbuf *result)
+{
+    struct select_state s = {0};
+    size_t start, end;
+    size_t i;
+    int found = 0;
+    int res;
+
+    if (name_comps(prefix->buf, prefix->length, &start, &end) < 0)
+        return(-1);
+    if (a->count == 0)
+        return(0);
+    s.pcomps = prefix->buf + start;
+    s.psize = end - start;
+    s.selected = mmap(NULL, a->count, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_ANON, -1, 0);
+    if (s.selected == MAP_FAILED)
+        return(-1);
+    res = ccn_archive_run(a, a->count, workers, &select_worker, &s, -1);
+    for (i = 0; res == 0 && i < a->count; i++) {
+        if (s.selected[i]) {
+            if (ccn_indexbuf_append_element(result, i) < 0)
+                res = -1;
+            found++;
+        }
+    }
+    munmap(s.selected, a->count);
+    return(res < 0 ? -1 : found);
+}
@@ -676,6 +676,40 @@ ccn_parse_interest(const unsigned char *msg, size_t size,
     return (ncomp);
 }
 
+int
+ccn_parse_InterestNack(const unsigned char *msg, size_t size,
+                       const unsigned char **interest,
+                       size_t *interest_size)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d = ccn_buf_decoder_start(&decoder, msg, size);
+    size_t start;
+    int reason = -1;
+    if (ccn_buf_match_dtag(d, CCN_DTAG_InterestNack)) {
+        ccn_buf_advance(d);
+        reason = ccn_parse_optional_tagged_nonNegativeInteger(d,
+                         CCN_DTAG_NackReason);
+        start = d->decoder.token_index;
+        if (!ccn_buf_match_dtag(d, CCN_DTAG_Interest))
+            return (d->decoder.state = -__LINE__);
+        ccn_buf_advance_past_element(d);
+        if (interest != NULL)
+            *interest = msg + start;
+        if (interest_size != NULL)
+            *interest_size = d->decoder.token_index - start;
+        ccn_buf_check_close(d);
+    }
+    else
+        return (d->decoder.state = -__LINE__);
+    if (d->decoder.state < 0)
+        return (d->decoder.state);
+    if (d->decoder.index != size || !CCN_FINAL_DSTATE(d->decoder.state))
+        return (CCN_DSTATE_ERR_CODING);
+    if (reason <= 0)
+        return (-__LINE__);
+    return (reason);
+}
+
 struct parsed_KeyName {
     int Name;
     int endName;
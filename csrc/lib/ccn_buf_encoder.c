@@ -166,10 +166,32 @@ ccn_encode_ContentObject(struct ccn_charbuf *buf,
                          const char *digest_algorithm,
                          const struct ccn_pkey *private_key
                          )
+{
+    return(ccn_encode_ContentObject_sigc(buf, Name, SignedInfo, data, size,
+                                         digest_algorithm, private_key, NULL));
+}
+
+/**
+ * Encode and sign a ContentObject, reusing a signing context.
+ *
+ * This is ccn_encode_ContentObject(), for callers that sign many objects
+ * with one key and can keep a context for it (see ccn_keystore_sigc()).
+ * @param sig_ctx is the context to use, or NULL for a temporary one.
+ * @returns 0 for success or -1 for error.
+ */
+int
+ccn_encode_ContentObject_sigc(struct ccn_charbuf *buf,
+                              const struct ccn_charbuf *Name,
+                              const struct ccn_charbuf *SignedInfo,
+                              const void *data,
+                              size_t size,
+                              const char *digest_algorithm,
+                              const struct ccn_pkey *private_key,
+                              struct ccn_sigc *sig_ctx)
 {
     int res = 0;
-    struct ccn_sigc *sig_ctx;
-    struct ccn_signature *signature;
+    struct ccn_sigc *temp_ctx = NULL;
+    struct ccn_signature *signature = NULL;
     size_t signature_size;
     struct ccn_charbuf *content_header;
     size_t closer_start;
@@ -181,41 +203,67 @@ ccn_encode_ContentObject(struct ccn_charbuf *buf,
     closer_start = content_header->length;
     res |= ccn_charbuf_append_closer(content_header);
     if (res < 0)
-        return(-1);
-    sig_ctx = ccn_sigc_create();
+        goto Bail;
     if (sig_ctx == NULL)
-        return(-1);
+        sig_ctx = temp_ctx = ccn_sigc_create();
+    res = -1;
+    if (sig_ctx == NULL)
+        goto Bail;
     if (0 != ccn_sigc_init(sig_ctx, digest_algorithm, private_key))
-        return(-1);
+        goto Bail;
     if (0 != ccn_sigc_update(sig_ctx, Name->buf, Name->length))
-        return(-1);
+        goto Bail;
     if (0 != ccn_sigc_update(sig_ctx, SignedInfo->buf, SignedInfo->length))
-        return(-1);
+        goto Bail;
     if (0 != ccn_sigc_update(sig_ctx, content_header->buf, closer_start))
-        return(-1);
+        goto Bail;
     if (0 != ccn_sigc_update(sig_ctx, data, size))
-        return(-1);
+        goto Bail;
     if (0 != ccn_sigc_update(sig_ctx, content_header->buf + closer_start,
                              content_header->length - closer_start))
-        return(-1);
+        goto Bail;
     signature = calloc(1, ccn_sigc_signature_max_size(sig_ctx, private_key));
     if (signature == NULL)
-        return(-1);
-    res = ccn_sigc_final(sig_ctx, signature, &signature_size, private_key);
-    if (0 != res) {
-        free(signature);
-        return(-1);
-    }
-    ccn_sigc_destroy(&sig_ctx);
+        goto Bail;
+    if (0 != ccn_sigc_final(sig_ctx, signature, &signature_size, private_key))
+        goto Bail;
+    res = ccn_encode_presigned_ContentObject(buf, Name, SignedInfo,
+                                             data, size, digest_algorithm,
+                                             signature, signature_size);
+Bail:
+    free(signature);
+    ccn_sigc_destroy(&temp_ctx);
+    ccn_charbuf_destroy(&content_header);
+    return(res == 0 ? 0 : -1);
+}
+
+/**
+ * Encode a ContentObject with a signature made elsewhere.
+ *
+ * The signature must cover the Name, the SignedInfo, and the whole
+ * Content element, as for ccn_encode_ContentObject().
+ * @param signature is the SignatureBits.
+ * @returns 0 for success or -1 for error.
+ */
+int
+ccn_encode_presigned_ContentObject(struct ccn_charbuf *buf,
+                                   const struct ccn_charbuf *Name,
+                                   const struct ccn_charbuf *SignedInfo,
+                                   const void *data,
+                                   size_t size,
+                                   const char *digest_algorithm,
+                                   const void *signature,
+                                   size_t signature_size)
+{
+    int res = 0;
+
     res |= ccn_charbuf_append_tt(buf, CCN_DTAG_ContentObject, CCN_DTAG);
-    res |= ccn_encode_Signature(buf, digest_algorithm,
-                                NULL, 0, signature, signature_size);
+    res |= ccn_encode_Signature(buf, digest_algorithm, NULL, 0,
+                                signature, signature_size);
     res |= ccn_charbuf_append_charbuf(buf, Name);
     res |= ccn_charbuf_append_charbuf(buf, SignedInfo);
     res |= ccnb_append_tagged_blob(buf, CCN_DTAG_Content, data, size);
     res |= ccn_charbuf_append_closer(buf);
-    free(signature);
-    ccn_charbuf_destroy(&content_header);
     return(res == 0 ? 0 : -1);
 }
 
@@ -243,6 +291,29 @@ ccn_encode_StatusResponse(struct ccn_charbuf *buf,
     return(res);
 }
 
+/**
+ * Append an InterestNack
+ *
+ * @param buf is the buffer to append to.
+ * @param reason is one of the CCN_NACK_* codes.
+ * @param interest is the ccnb-encoded Interest being refused.
+ * @param size is its size in bytes.
+ * @returns 0 for success or -1 for error.
+ */
+int
+ccn_encode_InterestNack(struct ccn_charbuf *buf, int reason,
+                        const unsigned char *interest, size_t size)
+{
+    int res = 0;
+    if (reason <= 0)
+        return(-1);
+    res |= ccn_charbuf_append_tt(buf, CCN_DTAG_InterestNack, CCN_DTAG);
+    res |= ccnb_tagged_putf(buf, CCN_DTAG_NackReason, "%d", reason);
+    res |= ccn_charbuf_append(buf, interest, size);
+    res |= ccn_charbuf_append_closer(buf);
+    return(res == 0 ? 0 : -1);
+}
+
 /**
  * Append a ccnb start marker
  *
@@ -1,10 +1,10 @@
 /**
  * @file ccn_bulkdata.c
- * @brief (INCOMPLETE)Support for transport of bulk data.
+ * @brief Support for transport of bulk data.
  * 
  * Part of the CCNx C Library.
  *
- * Copyright (C) 2008, 2009 Palo Alto Research Center, Inc.
+ * Copyright (C) 2008, 2009, 2012 Palo Alto Research Center, Inc.
  *
  * This library is free software; you can redistribute it and/or modify it
  * under the terms of the GNU Lesser General Public License version 2.1
@@ -21,33 +21,18 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/time.h>
 
-#include <ccn/bloom.h>
+#include <ccn/bulkdata.h>
 #include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
 
-/************ Candidate API stuff - was in ccn/ccn.h for a while ******/
-/***********************************
- * Bulk data
- */
-
-/*
- * The client provides a ccn_seqfunc * (and perhaps a matching param)
- * to specify the scheme for naming the content items in the sequence.
- * Given the sequence number x, it should place in resultbuf the
- * corresponding blob that that will be used in the final explicit
- * Component of the Name of item x in the sequence.  This should
- * act as a mathematical function, returning the same answer for a given x.
- * (Usually param will be NULL, but is provided in case it is needed.)
- */
-typedef void ccn_seqfunc(uintmax_t x, void *param,
-                         struct ccn_charbuf *resultbuf);
-
-/*
- * Ready-to-use sequencing functions
- */
-extern ccn_seqfunc ccn_decimal_seqfunc;
-extern ccn_seqfunc ccn_binary_seqfunc;
-/**********************************************************************/
+#define INITIAL_RTO_US 1000000
+#define MIN_RTO_US 50000
+#define MAX_RTO_US 8000000
+#define MAX_RETRIES 8
+#define DEFAULT_WINDOW 16
 
 /*
  * Encode the number in decimal ascii
@@ -71,7 +56,7 @@ ccn_binary_seqfunc(uintmax_t x, void *param, struct ccn_charbuf *resultbuf)
     int n;
     unsigned char *b;
     (void)param; /* unused */
-    for (n = 0, m = 0; x < m; n++)
+    for (n = 0, m = 0; x > m; n++)
         m = (m << 8) | 0xff;
     b = ccn_charbuf_reserve(resultbuf, n + 1);
     resultbuf->length = n + 1;
@@ -79,187 +64,580 @@ ccn_binary_seqfunc(uintmax_t x, void *param, struct ccn_charbuf *resultbuf)
         b[n] = x & 0xff;
 }
 
+/*
+ * Encode the number as a segment number, as ccn_name_append_numeric does
+ * with CCN_MARKER_SEQNUM.
+ */
+void
+ccn_segment_seqfunc(uintmax_t x, void *param, struct ccn_charbuf *resultbuf)
+{
+    uintmax_t m;
+    int n;
+    unsigned char *b;
+    (void)param; /* unused */
+    for (n = 0, m = x; m != 0; n++)
+        m >>= 8;
+    b = ccn_charbuf_reserve(resultbuf, n + 1);
+    resultbuf->length = n + 1;
+    b[0] = CCN_MARKER_SEQNUM;
+    for (; n > 0; n--, x >>= 8)
+        b[n] = x & 0xff;
+}
+
+enum slot_state {
+    SLOT_FREE = 0,      /* not in use, or already delivered */
+    SLOT_IN_FLIGHT,     /* interest expressed */
+    SLOT_HELD,          /* arrived out of order, awaiting delivery */
+    SLOT_SKIPPED        /* given up on, to be passed over in order */
+};
+
+/*
+ * One entry of the reorder ring.  Slots are allocated once, and are
+ * indexed by sequence number modulo the ring size.  Each has its own
+ * closure, so an arrival identifies its slot without a search.
+ */
+struct slot {
+    struct ccn_closure closure;
+    struct ccn_bulkdata *parent;    /* NULL once the transfer is destroyed */
+    uintmax_t x;                    /* sequence number for this item */
+    enum slot_state state;
+    int retries;
+    struct timeval sent;
+    struct ccn_charbuf *seqcomp;    /* the final Component, as generated */
+    struct ccn_charbuf *content;    /* held ContentObject */
+    struct ccn_parsed_ContentObject pco;
+    struct ccn_indexbuf *comps;
+    enum ccn_upcall_kind kind;
+};
+
 /*
  * Our private record of the state of the bulk data reception
  */
-struct bulkdata {
+struct ccn_bulkdata {
+    struct ccn *h;
     ccn_seqfunc *seqfunc;           /* the sequence number scheme */
     void *seqfunc_param;            /* parameters thereto, if needed */
-    struct pending *first;          /* start of list of pending items */
     struct ccn_closure *client;     /* client-supplied upcall for delivery */
-    uintmax_t next_expected;        /* smallest undelivered sequence number */
     struct ccn_charbuf *name_prefix;
-    int prefix_comps;
-    /* pubid, etc? */
+    struct slot **ring;             /* reorder buffer */
+    int ring_size;
+    uintmax_t next_expected;        /* smallest undelivered sequence number */
+    uintmax_t next_to_ask;          /* smallest sequence number not yet asked */
+    uintmax_t last;                 /* last sequence number, if known */
+    int have_last;
+    uintmax_t recover;              /* no further backoff until this is asked */
+    int max_window;
+    double cwnd;                    /* congestion window, in items */
+    int in_flight;
+    int rto_us;
+    int srtt_us;                    /* zero until there is a sample */
+    int rttvar_us;
+    int busy;                       /* nonzero while in one of our upcalls */
+    int destroyed;                  /* destroy was called from the client */
+    struct ccn_bulkdata_stats stats;
 };
 
-struct pending {
-    struct pending *prev;           /* links for doubly-linked list */
-    struct pending *next;
-    struct bulkdata *parent;
-    uintmax_t x;                    /* sequence number for this item */
-    struct ccn_closure closure;     /* our closure for getting matching data */
-    unsigned char *content_ccnb;    /* the content that has arrived */
-    size_t content_size;
-};
+static enum ccn_upcall_res incoming_bulkdata(struct ccn_closure *selfp,
+                                             enum ccn_upcall_kind kind,
+                                             struct ccn_upcall_info *info);
 
-static enum ccn_upcall_res deliver_content(struct ccn *h, struct bulkdata *b);
-static void express_bulkdata_interest(struct ccn *h, struct pending *b);
-// XXX - missing a way to create a struct bulkdata *
-// XXX - missing code to create new pendings
+static void destroy_bulkdata(struct ccn_bulkdata *b);
 
+static void
+destroy_slot(struct slot *p)
+{
+    ccn_charbuf_destroy(&p->seqcomp);
+    ccn_charbuf_destroy(&p->content);
+    ccn_indexbuf_destroy(&p->comps);
+    free(p);
+}
 
-/*static*/ enum ccn_upcall_res
-imcoming_bulkdata(struct ccn_closure *selfp,
-                  enum ccn_upcall_kind kind,
-                  struct ccn_upcall_info *info)
+static int
+elapsed_us(const struct timeval *then)
 {
-    struct bulkdata *b;
-    struct pending *p = selfp->data;
-    enum ccn_upcall_res res = CCN_UPCALL_RESULT_ERR;
+    struct timeval now;
+    long d;
+    
+    gettimeofday(&now, NULL);
+    d = (now.tv_sec - then->tv_sec) * 1000000L + (now.tv_usec - then->tv_usec);
+    if (d < 0)
+        d = 0;
+    if (d > MAX_RTO_US)
+        d = MAX_RTO_US;
+    return(d);
+}
 
-    assert(selfp == &p->closure);
-    b = p->parent;
+/*
+ * Update the round-trip estimate, as in RFC 6298.
+ * Only unretried items are sampled (Karn's algorithm).
+ */
+static void
+note_rtt(struct ccn_bulkdata *b, int sample)
+{
+    int err;
+    
+    if (b->srtt_us == 0) {
+        b->srtt_us = sample + 1;
+        b->rttvar_us = sample / 2;
+    }
+    else {
+        err = sample - b->srtt_us;
+        if (err < 0)
+            err = -err;
+        b->rttvar_us += (err - b->rttvar_us) / 4;
+        b->srtt_us += (sample - b->srtt_us) / 8;
+    }
+    b->rto_us = b->srtt_us + 4 * b->rttvar_us;
+    if (b->rto_us < MIN_RTO_US)
+        b->rto_us = MIN_RTO_US;
+    if (b->rto_us > MAX_RTO_US)
+        b->rto_us = MAX_RTO_US;
+}
+
+static int
+express_bulkdata_interest(struct ccn_bulkdata *b, struct slot *p)
+{
+    struct ccn_charbuf *name = NULL;
+    struct ccn_charbuf *templ = NULL;
+    uintmax_t lifetime;
+    int res;
+    
+    name = ccn_charbuf_create();
+    templ = ccn_charbuf_create();
+    ccn_charbuf_append(name, b->name_prefix->buf, b->name_prefix->length);
+    ccn_name_append(name, p->seqcomp->buf, p->seqcomp->length);
+    ccn_charbuf_append_tt(templ, CCN_DTAG_Interest, CCN_DTAG);
+    ccn_charbuf_append_tt(templ, CCN_DTAG_Name, CCN_DTAG);
+    ccn_charbuf_append_closer(templ); /* </Name> */
+    /* exactly one more component - the implicit digest */
+    ccnb_tagged_putf(templ, CCN_DTAG_MinSuffixComponents, "%d", 1);
+    ccnb_tagged_putf(templ, CCN_DTAG_MaxSuffixComponents, "%d", 1);
+    /* InterestLifetime is in units of 1/4096 second */
+    lifetime = ((uintmax_t)b->rto_us * 4096 + 999999) / 1000000;
+    ccnb_append_tagged_binary_number(templ, CCN_DTAG_InterestLifetime, lifetime);
+    ccn_charbuf_append_closer(templ); /* </Interest> */
+    res = ccn_express_interest(b->h, name, &p->closure, templ);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&templ);
+    if (res < 0)
+        return(res);
+    gettimeofday(&p->sent, NULL);
+    b->stats.expressed++;
+    return(0);
+}
+
+/*
+ * Express interests for new items while the window allows.
+ */
+static void
+fill_window(struct ccn_bulkdata *b)
+{
+    struct slot *p;
+    
+    while (b->in_flight < (int)b->cwnd &&
+           b->next_to_ask < b->next_expected + b->ring_size &&
+           !(b->have_last && b->next_to_ask > b->last)) {
+        p = b->ring[b->next_to_ask % b->ring_size];
+        if (p->state != SLOT_FREE)
+            break;
+        p->x = b->next_to_ask;
+        p->retries = 0;
+        p->seqcomp->length = 0;
+        (*b->seqfunc)(p->x, b->seqfunc_param, p->seqcomp);
+        if (express_bulkdata_interest(b, p) < 0)
+            break;
+        p->state = SLOT_IN_FLIGHT;
+        b->in_flight++;
+        b->next_to_ask++;
+    }
+}
+
+/*
+ * Check whether a ContentObject marks itself as the last in the sequence.
+ */
+static int
+is_final_block(const unsigned char *ccnb,
+               struct ccn_parsed_ContentObject *pco,
+               struct slot *p)
+{
+    const unsigned char *fb = NULL;
+    size_t fb_size = 0;
+    int res;
+    
+    if (pco->offset[CCN_PCO_B_FinalBlockID] == pco->offset[CCN_PCO_E_FinalBlockID])
+        return(0);
+    res = ccn_ref_tagged_BLOB(CCN_DTAG_FinalBlockID, ccnb,
+                              pco->offset[CCN_PCO_B_FinalBlockID],
+                              pco->offset[CCN_PCO_E_FinalBlockID],
+                              &fb, &fb_size);
+    return(res == 0 && fb_size == p->seqcomp->length &&
+           memcmp(fb, p->seqcomp->buf, fb_size) == 0);
+}
+
+/*
+ * Hand an item to the client, and free its slot.
+ *
+ * Our state is brought up to date first, since the client may destroy
+ * the transfer from its upcall (as it likely will after the last item).
+ */
+static void
+deliver(struct ccn_bulkdata *b, struct slot *p, enum ccn_upcall_kind kind,
+        struct ccn_upcall_info *info)
+{
+    if (is_final_block(info->content_ccnb, info->pco, p)) {
+        b->have_last = 1;
+        b->last = p->x;
+    }
+    p->state = SLOT_FREE;
+    b->next_expected++;
+    b->stats.delivered++;
+    if (b->have_last && p->x == b->last)
+        b->stats.done = 1;
+    (*b->client->p)(b->client, kind, info);
+}
+
+/*
+ * Deliver any held items that are now in order, and pass over any
+ * that the client has given up on.
+ * The held copy is handed over in place, with the parse done on arrival.
+ */
+static void
+deliver_held(struct ccn_bulkdata *b)
+{
+    struct ccn_upcall_info info = {0};
+    struct slot *p;
+    
+    info.h = b->h;
+    while (!b->destroyed) {
+        p = b->ring[b->next_expected % b->ring_size];
+        if (p->x != b->next_expected)
+            break;
+        if (p->state == SLOT_SKIPPED) {
+            p->state = SLOT_FREE;
+            b->next_expected++;
+            if (b->have_last && p->x == b->last)
+                b->stats.done = 1;
+            continue;
+        }
+        if (p->state != SLOT_HELD)
+            break;
+        info.content_ccnb = p->content->buf;
+        info.pco = &p->pco;
+        info.content_comps = p->comps;
+        info.matched_comps = p->comps->n - 1;
+        b->stats.reordered++;
+        deliver(b, p, p->kind, &info);
+        /* The slot is not reused before we return, even if b is destroyed */
+        p->content->length = 0;
+    }
+}
+
+/*
+ * Check that an arrival is for the item its slot is now waiting for.
+ * A late answer to an interest from an earlier use of the slot may arrive.
+ */
+static int
+seqcomp_matches(struct slot *p, struct ccn_upcall_info *info)
+{
+    const unsigned char *comp = NULL;
+    size_t comp_size = 0;
+    int n = info->content_comps->n;
+    
+    if (n < 2 || ccn_name_comp_get(info->content_ccnb, info->content_comps,
+                                   n - 2, &comp, &comp_size) < 0)
+        return(0);
+    return(comp_size == p->seqcomp->length &&
+           memcmp(comp, p->seqcomp->buf, comp_size) == 0);
+}
+
+static enum ccn_upcall_res
+handle_upcall(struct ccn_bulkdata *b, struct slot *p,
+              enum ccn_upcall_kind kind,
+              struct ccn_upcall_info *info)
+{
+    size_t size;
     
     switch (kind) {
-        case CCN_UPCALL_FINAL:
-            p->prev->next = p->next->prev;
-            p->next->prev = p->prev->next;
-            if (b != NULL && p == b->first)
-                b->first = (p == p->next) ? NULL : p->next;
-            if (p->content_ccnb != NULL)
-                free(p->content_ccnb);
-            free(p);
-            return(CCN_UPCALL_RESULT_OK);
-	case CCN_UPCALL_CONTENT:
-    	case CCN_UPCALL_CONTENT_UNVERIFIED:
-	case CCN_UPCALL_CONTENT_BAD:
-            /* XXX - should we be returning bad (signature failed) content */
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
             break;
         case CCN_UPCALL_INTEREST_TIMED_OUT:
-            /* XXX - may want to give client a chance to decide */ 
-            return(CCN_UPCALL_RESULT_REEXPRESS);
+            if (b->have_last && p->x > b->last) {
+                /* asked for before the end was known */
+                p->state = SLOT_FREE;
+                b->in_flight--;
+                return(CCN_UPCALL_RESULT_OK);
+            }
+            b->stats.timeouts++;
+            if (p->x >= b->recover) {
+                /* back off once per window of losses */
+                b->recover = b->next_to_ask;
+                b->cwnd /= 2;
+                if (b->cwnd < 1)
+                    b->cwnd = 1;
+                b->rto_us *= 2;
+                if (b->rto_us > MAX_RTO_US)
+                    b->rto_us = MAX_RTO_US;
+            }
+            if (++(p->retries) > MAX_RETRIES) {
+                /* let the client decide */
+                if ((*b->client->p)(b->client, kind, info) != CCN_UPCALL_RESULT_REEXPRESS) {
+                    /* skip this one, so that later items still get delivered */
+                    p->state = SLOT_SKIPPED;
+                    b->in_flight--;
+                    deliver_held(b);
+                    if (!b->destroyed)
+                        fill_window(b);
+                    return(CCN_UPCALL_RESULT_OK);
+                }
+                if (b->destroyed)
+                    return(CCN_UPCALL_RESULT_OK);
+                p->retries = 0;
+            }
+            /* a new interest, so that the lifetime follows the backoff */
+            if (express_bulkdata_interest(b, p) < 0) {
+                p->state = SLOT_FREE;
+                b->in_flight--;
+            }
+            return(CCN_UPCALL_RESULT_OK);
         default:
+            /* e.g. CCN_UPCALL_CONTENT_BAD - the timeout will take care of it */
             return(CCN_UPCALL_RESULT_ERR);
     }
-    /* XXX - check to see if seq comp matches, if not we have a hole to fill */
-    
-    if (p->content_ccnb == NULL) {
+    if (p->x < b->next_expected || !seqcomp_matches(p, info)) {
+        b->stats.duplicates++;
+        return(CCN_UPCALL_RESULT_OK);
+    }
+    b->in_flight--;
+    if (p->retries == 0)
+        note_rtt(b, elapsed_us(&p->sent));
+    /* additive increase, once per window's worth */
+    b->cwnd += 1.0 / b->cwnd;
+    if (b->cwnd > b->max_window)
+        b->cwnd = b->max_window;
     if (p->x == b->next_expected) {
         /* Good, we have in-order data to deliver to the caller */
-        res = (*b->client->p)(b->client, kind, info);
-        if (res == CCN_UPCALL_RESULT_OK) {
-            b->next_expected += 1;
-            b->first = (p == p->next) ? NULL : p->next;
-            p->prev->next = p->next->prev;
-            p->next->prev = p->prev->next;
-            p->next = p->prev = p;
-            p->parent = NULL;
-        }
-        // else ...
+        deliver(b, p, kind, info);
+        deliver_held(b);
     }
-    else if (p->content_ccnb == NULL) {
+    else {
         /* Out-of-order data, save it for later */
-        size_t size = info->pco->offset[CCN_PCO_E];
-        selfp->refcount++; /* don't call FINAL just yet */
-        p->content_ccnb = malloc(size);
-        memcpy(p->content_ccnb, info->content_ccnb, size);
-        p->content_size = size;
-    }
+        size = info->pco->offset[CCN_PCO_E];
+        p->content->length = 0;
+        ccn_charbuf_append(p->content, info->content_ccnb, size);
+        p->pco = *info->pco;
+        p->comps->n = 0;
+        ccn_indexbuf_append(p->comps, info->content_comps->buf,
+                            info->content_comps->n);
+        p->kind = kind;
+        p->state = SLOT_HELD;
     }
-    while (b->first != NULL && b->first->x == b->next_expected &&
-           b->first->content_ccnb != NULL) {
-        res = deliver_content(info->h, b);
-        if (res != CCN_UPCALL_RESULT_OK)
-            break;
-    }
-    if (b->first == NULL) {
-        // XXX 
+    if (!b->destroyed)
+        fill_window(b);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+static enum ccn_upcall_res
+incoming_bulkdata(struct ccn_closure *selfp,
+                  enum ccn_upcall_kind kind,
+                  struct ccn_upcall_info *info)
+{
+    struct slot *p = selfp->data;
+    struct ccn_bulkdata *b = p->parent;
+    enum ccn_upcall_res res;
+    
+    assert(selfp == &p->closure);
+    if (kind == CCN_UPCALL_FINAL) {
+        if (b == NULL)
+            destroy_slot(p);
         return(CCN_UPCALL_RESULT_OK);
     }
-    for (p = b->first; p->x >= b->next_expected; p = p->next) {
-        // XXX - this is not really right ...
-        if (p->content_ccnb == NULL)
-            express_bulkdata_interest(info->h, p);
-    }
-    return(CCN_UPCALL_RESULT_OK);
+    if (b == NULL || p->state != SLOT_IN_FLIGHT)
+        return(CCN_UPCALL_RESULT_OK);
+    b->busy++;
+    res = handle_upcall(b, p, kind, info);
+    if (--(b->busy) == 0 && b->destroyed)
+        destroy_bulkdata(b);
+    return(res);
 }
 
-static void
-express_bulkdata_interest(struct ccn *h, struct pending *p)
+/**
+ * Create a bulk data transfer.
+ *
+ * Nothing is requested until ccn_bulkdata_start() is called.
+ * @param name_prefix is the ccnb-encoded Name, to which a sequence
+ *        component is appended for each item.
+ * @param seqfunc names the items; see ccn_segment_seqfunc, for example.
+ * @param first is the sequence number of the first item.
+ * @param client is called with each item, in order.
+ * @returns the new transfer, or NULL for an error.
+ */
+struct ccn_bulkdata *
+ccn_bulkdata_create(struct ccn *h,
+                    struct ccn_charbuf *name_prefix,
+                    ccn_seqfunc *seqfunc, void *seqfunc_param,
+                    uintmax_t first,
+                    struct ccn_closure *client)
 {
-    int res;
-    struct bulkdata *b = NULL;
-    int prefix_comps = -1;
-    int addl_comps = -1;
-    struct ccn_charbuf *name = NULL;
-    struct ccn_charbuf *templ = NULL;
-    struct ccn_charbuf *seq = NULL;
+    struct ccn_bulkdata *b;
     
-    b = p->parent;
+    if (h == NULL || name_prefix == NULL || seqfunc == NULL || client == NULL)
+        return(NULL);
+    b = calloc(1, sizeof(*b));
     if (b == NULL)
-        return;
-    name = ccn_charbuf_create();
-    templ = ccn_charbuf_create();
-    seq = ccn_charbuf_create();
+        return(NULL);
+    b->h = h;
+    b->seqfunc = seqfunc;
+    b->seqfunc_param = seqfunc_param;
+    b->client = client;
+    client->refcount++;
+    b->name_prefix = ccn_charbuf_create();
+    ccn_charbuf_append_charbuf(b->name_prefix, name_prefix);
+    b->next_expected = b->next_to_ask = first;
+    b->rto_us = INITIAL_RTO_US;
+    if (ccn_bulkdata_set_window(b, DEFAULT_WINDOW) < 0) {
+        ccn_bulkdata_destroy(&b);
+        return(NULL);
+    }
+    return(b);
+}
 
-    ccn_charbuf_append(name, b->name_prefix->buf, b->name_prefix->length);
-    
-    seq->length = 0;
-    (*b->seqfunc)(p->x, b->seqfunc_param, seq);
-    ccn_name_append(name, seq->buf, seq->length);
-    prefix_comps = -1;
-    addl_comps = 1;
+/**
+ * Set the maximum number of items in flight.
+ *
+ * The window opens additively from 1 to this size as items arrive, and
+ * is halved when an interest times out.  Items that arrive early are held
+ * until they can be delivered in order, so this also bounds the reordering.
+ * May only be called before ccn_bulkdata_start().
+ * @returns 0 for success, -1 for an error.
+ */
+int
+ccn_bulkdata_set_window(struct ccn_bulkdata *b, int window)
+{
+    struct slot **ring;
+    struct slot *p;
+    int i;
     
-    ccn_charbuf_append_tt(templ, CCN_DTAG_Interest, CCN_DTAG);
+    if (b == NULL || window < 1 || window > CCN_BULKDATA_MAX_WINDOW)
+        return(-1);
+    if (b->next_to_ask != b->next_expected || b->in_flight != 0)
+        return(-1);
+    ring = calloc(window, sizeof(ring[0]));
+    if (ring == NULL)
+        return(-1);
+    for (i = 0; i < window; i++) {
+        p = calloc(1, sizeof(*p));
+        if (p == NULL)
+            break;
+        p->closure.p = &incoming_bulkdata;
+        p->closure.data = p;
+        p->parent = b;
+        p->seqcomp = ccn_charbuf_create();
+        p->content = ccn_charbuf_create();
+        p->comps = ccn_indexbuf_create();
+        ring[i] = p;
+    }
+    if (i < window) {
+        while (i > 0)
+            destroy_slot(ring[--i]);
+        free(ring);
+        return(-1);
+    }
+    if (b->ring != NULL) {
+        for (i = 0; i < b->ring_size; i++)
+            destroy_slot(b->ring[i]);
+        free(b->ring);
+    }
+    b->ring = ring;
+    b->ring_size = window;
+    b->max_window = window;
+    b->cwnd = 1;
+    return(0);
+}
 
-    ccn_charbuf_append_tt(templ, CCN_DTAG_Name, CCN_DTAG);
-    ccn_charbuf_append_closer(templ); /* </Name> */
+/**
+ * Set the sequence number of the last item, if it is known in advance.
+ */
+int
+ccn_bulkdata_set_limit(struct ccn_bulkdata *b, uintmax_t last)
+{
+    if (b == NULL || last < b->next_expected)
+        return(-1);
+    b->have_last = 1;
+    b->last = last;
+    return(0);
+}
+
+/**
+ * Start expressing interests.
+ * The transfer then runs from the upcalls, as ccn_run() is called.
+ */
+int
+ccn_bulkdata_start(struct ccn_bulkdata *b)
+{
+    if (b == NULL)
+        return(-1);
+    fill_window(b);
+    return(0);
+}
 
-    // XXX - may want to set Min/MaxSuffixComponents
+int
+ccn_bulkdata_get_stats(struct ccn_bulkdata *b, struct ccn_bulkdata_stats *stats)
+{
+    if (b == NULL || stats == NULL)
+        return(-1);
+    b->stats.in_flight = b->in_flight;
+    b->stats.window = (int)b->cwnd;
+    b->stats.rto_us = b->rto_us;
+    b->stats.srtt_us = b->srtt_us;
+    *stats = b->stats;
+    return(0);
+}
+
+static void
+destroy_bulkdata(struct ccn_bulkdata *b)
+{
+    struct ccn_closure *client;
+    struct ccn_upcall_info info = {0};
+    struct slot *p;
+    int i;
     
-    ccn_charbuf_append_closer(templ); /* </Interest> */
-    res = ccn_express_interest(h, name, &p->closure, templ);
-    assert(res >= 0); // XXX - handle this better
-    ccn_charbuf_destroy(&name);
-    ccn_charbuf_destroy(&templ);
-    ccn_charbuf_destroy(&seq);
+    for (i = 0; i < b->ring_size; i++) {
+        p = b->ring[i];
+        p->parent = NULL;
+        if (p->closure.refcount == 0)
+            destroy_slot(p);
+    }
+    free(b->ring);
+    ccn_charbuf_destroy(&b->name_prefix);
+    client = b->client;
+    free(b);
+    if (client != NULL && --(client->refcount) == 0) {
+        info.h = NULL;
+        (client->p)(client, CCN_UPCALL_FINAL, &info);
+    }
 }
 
-/*
- * deliver_content is used to deliver a previously-buffered
- * ContentObject to the client.
+/**
+ * Destroy a bulk data transfer.
+ *
+ * Interests still outstanding are left to expire; their slots are freed
+ * when the library is done with them.  The client closure gets
+ * CCN_UPCALL_FINAL if this was the last reference to it.
+ * This may be called from the client's upcall; the transfer is then
+ * torn down when the upcall returns.
  */
-static enum ccn_upcall_res
-deliver_content(struct ccn *h, struct bulkdata *b)
+void
+ccn_bulkdata_destroy(struct ccn_bulkdata **bp)
 {
-    struct ccn_upcall_info info = {0};
-    struct ccn_parsed_ContentObject obj = {0};
-    struct pending *p = b->first;
-    int res;
-    enum ccn_upcall_res ans;
-    assert(p != NULL && p->x == b->next_expected && p->content_ccnb != NULL);
-    info.pco = &obj;
-    info.content_comps = ccn_indexbuf_create();
-    res = ccn_parse_ContentObject(p->content_ccnb, p->content_size,
-                                  &obj, info.content_comps);
-    assert(res >= 0);
-    info.content_ccnb = p->content_ccnb;
-    info.matched_comps = info.content_comps->n - 2;
-    /* XXX - we have no matched interest to present */
-    ans = (*b->client->p)(b->client, CCN_UPCALL_CONTENT, &info);
-    // XXX - check for refusal
-    info.content_ccnb = NULL;
-    free(p->content_ccnb);
-    p->content_ccnb = NULL;
-    p->content_size = 0;
-    ccn_indexbuf_destroy(&info.content_comps);
-    if (ans == CCN_UPCALL_RESULT_OK) {
-        struct ccn_closure *old = &p->closure;
-        if ((--(old->refcount)) == 0) {
-            info.pco = NULL;
-            (old->p)(old, CCN_UPCALL_FINAL, &info);
-        }
+    struct ccn_bulkdata *b = *bp;
+    
+    if (b == NULL)
+        return;
+    *bp = NULL;
+    if (b->busy) {
+        b->destroyed = 1;
+        return;
     }
-    return(ans);
+    destroy_bulkdata(b);
 }
@@ -44,6 +44,7 @@
 #include <ccn/hashtb.h>
 #include <ccn/reg_mgmt.h>
 #include <ccn/schedule.h>
+#include <ccn/signagent.h>
 #include <ccn/signing.h>
 #include <ccn/keystore.h>
 #include <ccn/uri.h>
@@ -72,6 +73,7 @@ struct ccn {
     struct hashtb *keys;    /* public keys, by pubid */
     struct hashtb *keystores;   /* unlocked private keys */
     struct ccn_charbuf *default_pubid;
+    struct ccn_signagent *signagent; /* signs for default_pubid, if open */
     struct ccn_schedule *schedule;
     struct timeval now;
     int timeout;
@@ -81,7 +83,13 @@ struct ccn {
     int verbose_error;
     int tap;
     int running;
+    int scope;                  /* nonzero during a scoped ccn_get */
+    int scope_serial;           /* source of scope ids */
+    struct ccn_charbuf *deferred; /* messages held back by a scoped ccn_get */
+    struct ccn_charbuf *spare_inbuf;
     int defer_verification;     /* Client wants to do its own verification */
+    ccn_output_hook *output_hook; /* for in-process use, see ccn_put() */
+    void *output_hookdata;
 };
 
 struct interests_by_prefix { /* keyed by components of name prefix */
@@ -97,6 +105,7 @@ struct expressed_interest {
     int target;                  /* how many we want outstanding (0 or 1) */
     int outstanding;             /* number currently outstanding (0 or 1) */
     int lifetime_us;             /* interest lifetime in microseconds */
+    int scope;                   /* h->scope when expressed */
     struct ccn_charbuf *wanted_pub; /* waiting for this pub to arrive */
     struct expressed_interest *next; /* link to next in list */
 };
@@ -456,6 +465,9 @@ ccn_disconnect(struct ccn *h)
     }
     ccn_charbuf_destroy(&h->inbuf);
     ccn_charbuf_destroy(&h->outbuf);
+    /* held-back messages came from the old connection */
+    if (h->deferred != NULL)
+        h->deferred->length = 0;
     /* a stored ccndid may no longer be valid */
     ccn_charbuf_destroy(&h->ccndid);
     /* all interest filters expire */
@@ -596,9 +608,12 @@ ccn_destroy(struct ccn **hp)
     }
     hashtb_destroy(&(h->keys));
     hashtb_destroy(&(h->keystores));
+    ccn_signagent_close(&h->signagent);
     ccn_charbuf_destroy(&h->interestbuf);
     ccn_charbuf_destroy(&h->inbuf);
+    ccn_charbuf_destroy(&h->spare_inbuf);
     ccn_charbuf_destroy(&h->outbuf);
+    ccn_charbuf_destroy(&h->deferred);
     ccn_indexbuf_destroy(&h->scratch_indexbuf);
     ccn_charbuf_destroy(&h->default_pubid);
     ccn_charbuf_destroy(&h->ccndid);
@@ -743,6 +758,7 @@ ccn_express_interest(struct ccn *h,
     }
     ccn_replace_handler(h, &(interest->action), action);
     interest->target = 1;
+    interest->scope = h->scope;
     interest->next = entry->list;
     entry->list = interest;
     hashtb_end(e);
@@ -1130,6 +1146,10 @@ ccn_put(struct ccn *h, const void *p, size_t length)
             h->tap = -1;
         }
     }
+    if (h->sock == -1 && h->output_hook != NULL) {
+        (h->output_hook)(h->output_hookdata, p, length);
+        return(0);
+    }
     if (h->outbuf != NULL && h->outbufindex < h->outbuf->length) {
         // XXX - should limit unbounded growth of h->outbuf
         ccn_charbuf_append(h->outbuf, p, length); // XXX - check res
@@ -1171,6 +1191,26 @@ ccn_grab_buffered_output(struct ccn *h)
     return(NULL);
 }
 
+/**
+ * Deliver output directly to an in-process consumer.
+ *
+ * This is not used by normal ccn clients, but is made available for use when
+ * ccnd needs to communicate with its internal client.  While the handle
+ * is not connected, each message passed to ccn_put() is handed to hook
+ * as soon as it has been checked, instead of being accumulated for
+ * ccn_grab_buffered_output().  The message is only valid for the duration
+ * of the call.
+ * @param h is the ccn handle.
+ * @param hook is the function to call, or NULL to resume buffering.
+ * @param hookdata is passed to hook.
+ */
+void
+ccn_set_output_hook(struct ccn *h, ccn_output_hook *hook, void *hookdata)
+{
+    h->output_hook = hook;
+    h->output_hookdata = hookdata;
+}
+
 static void
 ccn_refresh_interest(struct ccn *h, struct expressed_interest *interest)
 {
@@ -1297,6 +1337,41 @@ finalize_pkey(struct hashtb_enumerator *e)
         ccn_pubkey_free(*entry);
 }
 
+/**
+ * Marker for the KeyName of a shared secret.
+ *
+ * Content signed with a shared secret names the secret with a KeyName of
+ * the form /%C1.M.SECRET/%C1.M.K%00<keyid>.  Such names are never fetched.
+ */
+#define SECRET_KEY_MARKER "\xC1.M.SECRET"
+
+/**
+ * Check whether the KeyLocator of a ContentObject names a shared secret.
+ */
+static int
+ccn_key_name_is_secret(const unsigned char *msg,
+                       struct ccn_parsed_ContentObject *pco)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+    const unsigned char *comp = NULL;
+    size_t size = 0;
+
+    d = ccn_buf_decoder_start(&decoder, msg + pco->offset[CCN_PCO_B_KeyName_Name],
+                              pco->offset[CCN_PCO_E_KeyName_Name] -
+                              pco->offset[CCN_PCO_B_KeyName_Name]);
+    if (!ccn_buf_match_dtag(d, CCN_DTAG_Name))
+        return(0);
+    ccn_buf_advance(d);
+    if (!ccn_buf_match_dtag(d, CCN_DTAG_Component))
+        return(0);
+    ccn_buf_advance(d);
+    if (!ccn_buf_match_blob(d, &comp, &size))
+        return(0);
+    return(size == sizeof(SECRET_KEY_MARKER) - 1 &&
+           0 == memcmp(comp, SECRET_KEY_MARKER, size));
+}
+
 /**
  * Examine a ContentObject and try to find the public key needed to
  * verify it.  It might be present in our cache of keys, or in the
@@ -1317,6 +1392,7 @@ ccn_locate_key(struct ccn *h,
     const unsigned char *pkeyid;
     size_t pkeyid_size;
     struct ccn_pkey **entry;
+    struct ccn_keystore **keystore;
     struct ccn_buf_decoder decoder;
     struct ccn_buf_decoder *d;
 
@@ -1335,6 +1411,13 @@ ccn_locate_key(struct ccn *h,
         *pubkey = *entry;
         return (0);
     }
+    /* A shared secret that we hold verifies what it signs */
+    keystore = hashtb_lookup(h->keystores, pkeyid, pkeyid_size);
+    if (keystore != NULL &&
+          ccn_keystore_key_type(*keystore) == CCN_KEYSTORE_KEY_HMAC) {
+        *pubkey = (struct ccn_pkey *)ccn_keystore_private_key(*keystore);
+        return (0);
+    }
     /* Is a key locator present? */
     if (pco->offset[CCN_PCO_B_KeyLocator] == pco->offset[CCN_PCO_E_KeyLocator])
         return (-1);
@@ -1343,6 +1426,8 @@ ccn_locate_key(struct ccn *h,
                               pco->offset[CCN_PCO_E_Key_Certificate_KeyName] -
                               pco->offset[CCN_PCO_B_Key_Certificate_KeyName]);
     if (ccn_buf_match_dtag(d, CCN_DTAG_KeyName)) {
+        if (ccn_key_name_is_secret(msg, pco))
+            return(-1); /* never to be had from the network */
         return(1);
     }
     else if (ccn_buf_match_dtag(d, CCN_DTAG_Key)) {
@@ -1541,9 +1626,10 @@ ccn_initiate_key_fetch(struct ccn *h,
                pco->offset[CCN_PCO_B_KeyName_Name]);
     /*
      * If there is no KeyName provided, we can't ask, but we might win if the
-     * key arrives along with some other content.
+     * key arrives along with some other content.  Shared secrets are never
+     * asked for.
      */
-    if (namelen == 0)
+    if (namelen == 0 || ccn_key_name_is_secret(msg, pco))
         return(-1);
     key_closure = calloc(1, sizeof(*key_closure));
     if (key_closure == NULL)
@@ -1591,12 +1677,96 @@ ccn_check_pub_arrival(struct ccn *h, struct expressed_interest *interest)
     }
 }
 
+/**
+ * Hold back a message that arrived during a scoped ccn_get,
+ * to be dispatched once control returns to ccn_run.
+ */
+static void
+ccn_defer_message(struct ccn *h, const unsigned char *msg, size_t size)
+{
+    if (h->deferred == NULL)
+        h->deferred = ccn_charbuf_create();
+    if (h->deferred == NULL || ccn_charbuf_append(h->deferred, msg, size) < 0)
+        NOTE_ERRNO(h);
+}
+
+/**
+ * Hand an InterestNack to the handlers of the interests it refuses.
+ *
+ * An interest matches if it is the same as the refused one up to the
+ * InterestLifetime; ccnd does not alter that part as it forwards.
+ * @returns 1 if the message should be deferred, otherwise 0.
+ */
+static int
+ccn_dispatch_nack(struct ccn *h, struct ccn_upcall_info *info, int reason,
+                  const unsigned char *msg, size_t size)
+{
+    struct ccn_parsed_interest npi = {0};
+    struct ccn_indexbuf *comps = NULL;
+    struct interests_by_prefix *entry = NULL;
+    struct expressed_interest *interest = NULL;
+    size_t keystart;
+    size_t keysize;
+    int defer = 0;
+    int res;
+    enum ccn_upcall_res ures;
+
+    if (h->interests_by_prefix == NULL)
+        return(0);
+    comps = ccn_indexbuf_obtain(h);
+    res = ccn_parse_interest(msg, size, &npi, comps);
+    if (res >= 0) {
+        keystart = comps->buf[0];
+        entry = hashtb_lookup(h->interests_by_prefix, msg + keystart,
+                              comps->buf[comps->n - 1] - keystart);
+    }
+    keysize = npi.offset[CCN_PI_B_InterestLifetime];
+    for (interest = (entry ? entry->list : NULL); interest != NULL;
+         interest = interest->next) {
+        if (interest->magic != 0x7059e5f4)
+            ccn_gripe(interest);
+        if (interest->target == 0 || interest->outstanding == 0)
+            continue;
+        res = ccn_parse_interest(interest->interest_msg, interest->size,
+                                 info->pi, info->interest_comps);
+        if (res < 0 ||
+            info->pi->offset[CCN_PI_B_InterestLifetime] != keysize ||
+            memcmp(interest->interest_msg, msg, keysize) != 0)
+            continue;
+        if (h->scope != 0 && interest->scope != h->scope) {
+            defer = 1;
+            continue;
+        }
+        interest->outstanding = 0;
+        info->interest_ccnb = interest->interest_msg;
+        info->matched_comps = comps->n - 1;
+        info->nack_reason = reason;
+        ures = (interest->action->p)(interest->action,
+                                     CCN_UPCALL_INTEREST_NACKED, info);
+        if (interest->magic != 0x7059e5f4)
+            ccn_gripe(interest);
+        if (ures == CCN_UPCALL_RESULT_REEXPRESS)
+            ccn_refresh_interest(h, interest);
+        else {
+            interest->target = 0;
+            replace_interest_msg(interest, NULL);
+            ccn_replace_handler(h, &(interest->action), NULL);
+        }
+    }
+    ccn_indexbuf_release(h, comps);
+    return(defer);
+}
+
 /**
  * Dispatch a message through the registered upcalls.
  * This is not used by normal ccn clients, but is made available for use when
  * ccnd needs to communicate with its internal client.
+ *
+ * While a scoped ccn_get is running, only the interests it expressed
+ * are eligible; anything else that wants the message gets it later,
+ * from ccn_dispatch_deferred().
  * @param h is the ccn handle.
- * @param msg is the ccnb-encoded Interest or ContentObject.
+ * @param msg is the ccnb-encoded Interest, InterestNack or ContentObject.
  * @param size is its size in bytes.
  */
 void
@@ -1604,8 +1774,11 @@ ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size)
 {
     struct ccn_parsed_interest pi = {0};
     struct ccn_upcall_info info = {0};
+    const unsigned char *nacked = NULL;
+    size_t nacked_size = 0;
     int i;
     int res;
+    int defer = 0;
     enum ccn_upcall_res ures;
 
     h->running++;
@@ -1617,7 +1790,9 @@ ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size)
         /* This message is an Interest */
         enum ccn_upcall_kind upcall_kind = CCN_UPCALL_INTEREST;
         info.interest_ccnb = msg;
-        if (h->interest_filters != NULL && info.interest_comps->n > 0) {
+        if (h->scope != 0)
+            defer = 1;
+        else if (h->interest_filters != NULL && info.interest_comps->n > 0) {
             struct ccn_indexbuf *comps = info.interest_comps;
             size_t keystart = comps->buf[0];
             unsigned char *key = msg + keystart;
@@ -1633,6 +1808,11 @@ ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size)
             }
         }
     }
+    else if ((res = ccn_parse_InterestNack(msg, size, &nacked,
+                                           &nacked_size)) > 0) {
+        /* This message is an InterestNack */
+        defer = ccn_dispatch_nack(h, &info, res, nacked, nacked_size);
+    }
     else {
         /* This message should be a ContentObject. */
         struct ccn_parsed_ContentObject obj = {0};
@@ -1668,6 +1848,10 @@ ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size)
                                     enum ccn_upcall_kind upcall_kind = CCN_UPCALL_CONTENT;
                                     struct ccn_pkey *pubkey = NULL;
                                     int type = ccn_get_content_type(msg, info.pco);
+                                    if (h->scope != 0 && interest->scope != h->scope) {
+                                        defer = 1;
+                                        continue;
+                                    }
                                     if (type == CCN_CONTENT_KEY)
                                         res = ccn_cache_key(h, msg, size, info.pco);
                                     res = ccn_locate_key(h, msg, info.pco, &pubkey);
@@ -1717,19 +1901,64 @@ ccn_dispatch_message(struct ccn *h, unsigned char *msg, size_t size)
             }
         }
     } // XXX whew, what a lot of right braces!
+    if (defer)
+        ccn_defer_message(h, msg, size);
     ccn_indexbuf_release(h, info.interest_comps);
     ccn_indexbuf_destroy(&info.content_comps);
     h->running--;
 }
 
+/**
+ * Dispatch the messages held back while a scoped ccn_get was running.
+ *
+ * Messages deferred again during this (by a ccn_get called from one
+ * of these upcalls) start a fresh queue.
+ */
+static void
+ccn_dispatch_deferred(struct ccn *h)
+{
+    struct ccn_skeleton_decoder decoder;
+    struct ccn_skeleton_decoder *d = &decoder;
+    struct ccn_charbuf *q = h->deferred;
+    size_t start;
+
+    if (q == NULL || q->length == 0)
+        return;
+    h->deferred = NULL;
+    for (start = 0; start < q->length; start += d->index) {
+        memset(d, 0, sizeof(*d));
+        ccn_skeleton_decode(d, q->buf + start, q->length - start);
+        if (d->state != 0 || d->index == 0)
+            break;
+        ccn_dispatch_message(h, q->buf + start, d->index);
+    }
+    q->length = 0;
+    if (h->deferred == NULL)
+        h->deferred = q;
+    else
+        ccn_charbuf_destroy(&q);
+}
+
+/**
+ * Read what is available from the socket and dispatch the complete messages.
+ *
+ * The messages are dispatched from a buffer that no longer belongs to h,
+ * with any partial message at the end moved to a fresh h->inbuf first.
+ * So an upcall that reads from the connection again (a scoped ccn_get)
+ * continues the stream correctly, and does not disturb the message
+ * still being handled.
+ */
 static int
 ccn_process_input(struct ccn *h)
 {
     ssize_t res;
-    ssize_t msgstart;
+    size_t msgstart;
+    size_t msgend;
     unsigned char *buf;
     struct ccn_skeleton_decoder *d = &h->decoder;
     struct ccn_charbuf *inbuf = h->inbuf;
+    struct ccn_indexbuf *ends = NULL;
+    size_t i;
     if (inbuf == NULL)
         h->inbuf = inbuf = ccn_charbuf_create();
     if (inbuf->length == 0)
@@ -1747,26 +1976,35 @@ ccn_process_input(struct ccn *h)
             return(NOTE_ERRNO(h));
     }
     inbuf->length += res;
-    msgstart = 0;
     ccn_skeleton_decode(d, buf, res);
+    if (d->state != 0)
+        return(0);
+    ends = ccn_indexbuf_obtain(h);
     while (d->state == 0) {
-        ccn_dispatch_message(h, inbuf->buf + msgstart, 
-                              d->index - msgstart);
-        msgstart = d->index;
-        if (msgstart == inbuf->length) {
-            inbuf->length = 0;
-            return(0);
-        }
+        ccn_indexbuf_append_element(ends, d->index);
+        if (d->index == inbuf->length)
+            break;
         ccn_skeleton_decode(d, inbuf->buf + d->index,
                             inbuf->length - d->index);
     }
-    if (msgstart < inbuf->length && msgstart > 0) {
-        /* move partial message to start of buffer */
-        memmove(inbuf->buf, inbuf->buf + msgstart,
-                inbuf->length - msgstart);
-        inbuf->length -= msgstart;
-        d->index -= msgstart;
-    }
+    /* Hand the partial message, if any, to a fresh inbuf */
+    msgend = ends->buf[ends->n - 1];
+    h->inbuf = h->spare_inbuf;
+    h->spare_inbuf = NULL;
+    if (h->inbuf == NULL)
+        h->inbuf = ccn_charbuf_create();
+    h->inbuf->length = 0;
+    ccn_charbuf_append(h->inbuf, inbuf->buf + msgend, inbuf->length - msgend);
+    d->index -= msgend;
+    for (i = 0, msgstart = 0; i < ends->n; msgstart = ends->buf[i], i++)
+        ccn_dispatch_message(h, inbuf->buf + msgstart,
+                             ends->buf[i] - msgstart);
+    ccn_indexbuf_release(h, ends);
+    inbuf->length = 0;
+    if (h->spare_inbuf == NULL)
+        h->spare_inbuf = inbuf;
+    else
+        ccn_charbuf_destroy(&inbuf);
     return(0);
 }
 
@@ -1919,6 +2157,7 @@ ccn_set_schedule(struct ccn *h, struct ccn_schedule *schedule)
  * Process any scheduled operations that are due.
  * This is not used by normal ccn clients, but is made available for use
  * by ccnd to run its internal client.
+ * Messages held back by a scoped ccn_get are dispatched here first.
  * @param h is the ccn handle.
  * @returns the number of microseconds until the next thing needs to happen.
  */
@@ -1930,6 +2169,8 @@ ccn_process_scheduled_operations(struct ccn *h)
     struct interests_by_prefix *entry;
     struct expressed_interest *ie;
     int need_clean = 0;
+    if (h->running == 0)
+        ccn_dispatch_deferred(h);
     h->refresh_us = 5 * CCN_INTEREST_LIFETIME_MICROSEC;
     gettimeofday(&h->now, NULL);
     if (ccn_output_is_pending(h))
@@ -2072,6 +2313,7 @@ struct simple_get_data {
     struct ccn_charbuf *resultbuf;
     struct ccn_parsed_ContentObject *pcobuf;
     struct ccn_indexbuf *compsbuf;
+    int *pending;               /**< gets of the batch still waiting */
     int flags;
     int res;
 };
@@ -2096,6 +2338,18 @@ handle_simple_incoming_content(
     }
     if (kind == CCN_UPCALL_INTEREST_TIMED_OUT)
         return(selfp->intdata ? CCN_UPCALL_RESULT_REEXPRESS : CCN_UPCALL_RESULT_OK);
+    if (selfp->intdata == 0)
+        return(CCN_UPCALL_RESULT_OK); /* too late, ccn_get has returned */
+    if (kind == CCN_UPCALL_INTEREST_NACKED) {
+        /* Only asked for with CCN_AOK_NACK; give up on this one now */
+        selfp->intdata = 0;
+        if (md->pending != NULL) {
+            *md->pending -= 1;
+            if (*md->pending == 0)
+                ccn_set_run_timeout(h, 0);
+        }
+        return(CCN_UPCALL_RESULT_OK);
+    }
     if (kind == CCN_UPCALL_CONTENT_UNVERIFIED) {
         if ((md->flags & CCN_GET_NOKEYWAIT) == 0)
             return(CCN_UPCALL_RESULT_VERIFY);
@@ -2119,20 +2373,249 @@ handle_simple_incoming_content(
                             info->content_comps->buf, info->content_comps->n);
     }
     md->res = 0;
-    ccn_set_run_timeout(h, 0);
+    selfp->intdata = 0;
+    if (md->pending != NULL) {
+        if ((md->flags & CCN_GET_ANY) != 0)
+            *md->pending = 0;
+        else
+            *md->pending -= 1;
+        if (*md->pending == 0)
+            ccn_set_run_timeout(h, 0);
+    }
     return(CCN_UPCALL_RESULT_OK);
 }
 
+/**
+ * Age the interests expressed within the current scope.
+ *
+ * This is the part of ccn_process_scheduled_operations() that a
+ * scoped ccn_get needs: key arrivals, re-expression, timeouts.
+ * Nothing is freed here, since an outer upcall may be holding on to
+ * parts of the interest table; the normal cleanup takes care of that
+ * once control gets back to ccn_run.
+ * @returns the number of microseconds until the next thing is due.
+ */
+static int
+ccn_age_scoped_interests(struct ccn *h)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct interests_by_prefix *entry;
+    struct expressed_interest *ie;
+
+    h->refresh_us = 5 * CCN_INTEREST_LIFETIME_MICROSEC;
+    gettimeofday(&h->now, NULL);
+    if (h->interests_by_prefix == NULL)
+        return(h->refresh_us);
+    for (hashtb_start(h->interests_by_prefix, e); e->data != NULL; hashtb_next(e)) {
+        entry = e->data;
+        for (ie = entry->list; ie != NULL; ie = ie->next) {
+            if (ie->scope != h->scope)
+                continue;
+            ccn_check_pub_arrival(h, ie);
+            if (ie->target != 0)
+                ccn_age_interest(h, ie, e->key, e->keysize);
+        }
+    }
+    hashtb_end(e);
+    return(h->refresh_us);
+}
+
+/**
+ * Run a scoped dispatch on the connection, from inside an upcall.
+ *
+ * Only the interests expressed in this scope get their upcalls; other
+ * messages are held back for ccn_run.  Returns when *pending drops to
+ * zero, the time runs out, or the connection is lost.
+ */
+static int
+ccn_run_scoped(struct ccn *h, int *pending, int timeout_ms)
+{
+    struct timeval start;
+    struct pollfd fds[1];
+    int microsec;
+    int millisec;
+    int res = 0;
+
+    gettimeofday(&start, NULL);
+    while (*pending > 0) {
+        if (h->sock == -1) {
+            res = -1;
+            break;
+        }
+        microsec = ccn_age_scoped_interests(h);
+        millisec = microsec / 1000;
+        if (timeout_ms >= 0) {
+            int elapsed = (h->now.tv_sec  - start.tv_sec) * 1000 +
+                          (h->now.tv_usec - start.tv_usec) / 1000;
+            if (elapsed >= timeout_ms)
+                break;
+            if (timeout_ms - elapsed < millisec)
+                millisec = timeout_ms - elapsed;
+        }
+        fds[0].fd = h->sock;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        if (ccn_output_is_pending(h))
+            fds[0].events |= POLLOUT;
+        res = poll(fds, 1, millisec);
+        if (res < 0 && errno != EINTR) {
+            res = NOTE_ERRNO(h);
+            break;
+        }
+        res = 0;
+        if ((fds[0].revents & POLLOUT) != 0)
+            ccn_pushout(h);
+        if ((fds[0].revents & (POLLIN | POLLHUP | POLLERR)) != 0)
+            ccn_process_input(h);
+        if (h->err == ENOTCONN) {
+            res = -1;
+            break;
+        }
+    }
+    return(res);
+}
+
+/**
+ * Common part of ccn_get() and ccn_get_multi().
+ *
+ * Three ways to wait, depending on where we are called from:
+ *  - normally, ccn_run on h, so other upcalls keep being served;
+ *  - from inside an upcall, a scoped dispatch on the same connection
+ *    (other messages are held back, and delivered in order later);
+ *  - with no handle, or no socket to share, a temporary connection.
+ *
+ * templates, if not NULL, holds a template for each name, overriding
+ * interest_template where not NULL.
+ * The pcobuf and compsbuf, if given, apply to the first name.
+ * @returns the number of ContentObjects obtained, or -1 for an error.
+ */
+int
+ccn_get_batch(struct ccn *h,
+              struct ccn_charbuf **names,
+              int n,
+              struct ccn_charbuf *interest_template,
+              struct ccn_charbuf **templates,
+              int timeout_ms,
+              struct ccn_charbuf **results,
+              struct ccn_parsed_ContentObject *pcobuf,
+              struct ccn_indexbuf *compsbuf,
+              int flags)
+{
+    struct ccn_charbuf *templ;
+    struct ccn *orig_h = h;
+    struct hashtb *saved_keys = NULL;
+    struct simple_get_data **mds = NULL;
+    struct simple_get_data *md;
+    int saved_timeout = 0;
+    int pending = 0;
+    int scoped = 0;
+    int res = 0;
+    int i;
+
+    if ((flags & ~((int)(CCN_GET_NOKEYWAIT | CCN_GET_ANY))) != 0 || n < 0)
+        return(-1);
+    if (h != NULL && h->running && h->sock != -1 && h->scope == 0)
+        scoped = 1;
+    else if (h == NULL || h->running) {
+        h = ccn_create();
+        if (h == NULL)
+            return(-1);
+        if (orig_h != NULL) { /* Dad, can I borrow the keys? */
+            saved_keys = h->keys;
+            h->keys = orig_h->keys;
+        }
+        res = ccn_connect(h, ccn_get_connect_type(orig_h));
+        if (res < 0) {
+            if (saved_keys != NULL)
+                h->keys = saved_keys;
+            ccn_destroy(&h);
+            return(-1);
+        }
+    }
+    mds = calloc(n + 1, sizeof(*mds));
+    if (mds == NULL)
+        res = -1;
+    if (scoped) {
+        saved_timeout = h->timeout;
+        h->scope = ++h->scope_serial;
+        if (h->scope == 0)
+            h->scope = h->scope_serial = 1;
+    }
+    for (i = 0; i < n && res >= 0; i++) {
+        md = calloc(1, sizeof(*md));
+        if (md == NULL) {
+            res = -1;
+            break;
+        }
+        mds[i] = md;
+        md->resultbuf = results[i];
+        if (i == 0) {
+            md->pcobuf = pcobuf;
+            md->compsbuf = compsbuf;
+        }
+        md->pending = &pending;
+        md->flags = flags;
+        md->res = -1;
+        md->closure.p = &handle_simple_incoming_content;
+        md->closure.data = md;
+        md->closure.intdata = 1; /* tell upcall to re-express if needed */
+        md->closure.refcount = 1;
+        pending++;
+        templ = interest_template;
+        if (templates != NULL && templates[i] != NULL)
+            templ = templates[i];
+        res = ccn_express_interest(h, names[i], &md->closure, templ);
+        if (res < 0)
+            pending--;
+    }
+    if (res >= 0 && pending > 0) {
+        if (scoped)
+            res = ccn_run_scoped(h, &pending, timeout_ms);
+        else
+            res = ccn_run(h, timeout_ms);
+    }
+    if (res >= 0)
+        res = 0;
+    for (i = 0; mds != NULL && mds[i] != NULL; i++) {
+        md = mds[i];
+        if (md->res == 0 && res >= 0)
+            res++;
+        md->resultbuf = NULL;
+        md->pcobuf = NULL;
+        md->compsbuf = NULL;
+        md->pending = NULL;
+        md->closure.intdata = 0;
+        md->closure.refcount--;
+        if (md->closure.refcount == 0)
+            free(md);
+    }
+    free(mds);
+    if (scoped) {
+        h->scope = 0;
+        h->timeout = saved_timeout;
+    }
+    if (h != orig_h) {
+        if (saved_keys != NULL)
+            h->keys = saved_keys;
+        ccn_destroy(&h);
+    }
+    return(res);
+}
+
 /**
  * Get a single matching ContentObject
  * This is a convenience for getting a single matching ContentObject.
  * Blocks until a matching ContentObject arrives or there is a timeout.
- * @param h is the ccn handle. If NULL or ccn_get is called from inside
- *        an upcall, a new connection will be used and upcalls from other
- *        requests will not be processed while ccn_get is active.
+ * @param h is the ccn handle. If NULL, a new connection will be used.
+ *        If ccn_get is called from inside an upcall, it shares the
+ *        connection of h, and upcalls from other requests will not be
+ *        processed while ccn_get is active; messages for them are held
+ *        back until control returns to ccn_run().
  * @param name holds a ccnb-encoded Name
  * @param interest_template conveys other fields to be used in the interest
- *        (may be NULL).
+ *        (may be NULL).  If its AnswerOriginKind includes CCN_AOK_NACK,
+ *        an InterestNack from ccnd ends the wait early, as a failure.
  * @param timeout_ms limits the time spent waiting for an answer (milliseconds).
  * @param resultbuf is updated to contain the ccnb-encoded ContentObject.
  * @param pcobuf may be supplied to save the client the work of re-parsing the
@@ -2152,55 +2635,49 @@ ccn_get(struct ccn *h,
         struct ccn_indexbuf *compsbuf,
         int flags)
 {
-    struct ccn *orig_h = h;
-    struct hashtb *saved_keys = NULL;
     int res;
-    struct simple_get_data *md;
 
     if ((flags & ~((int)CCN_GET_NOKEYWAIT)) != 0)
         return(-1);
-    if (h == NULL || h->running) {
-        h = ccn_create();
-        if (h == NULL)
-            return(-1);
-        if (orig_h != NULL) { /* Dad, can I borrow the keys? */
-            saved_keys = h->keys;
-            h->keys = orig_h->keys;
-        }
-        res = ccn_connect(h, ccn_get_connect_type(orig_h));
-        if (res < 0) {
-            ccn_destroy(&h);
+    res = ccn_get_batch(h, &name, 1, interest_template, NULL, timeout_ms,
+                        &resultbuf, pcobuf, compsbuf, flags);
+    return((res == 1) ? 0 : -1);
+}
+
+/**
+ * Get several ContentObjects at once
+ * Expresses an interest for each of the n names right away, and blocks
+ * until all have been answered or the time runs out.  Behaves like
+ * ccn_get() otherwise, including when called from inside an upcall.
+ * @param h is the ccn handle (may be NULL).
+ * @param names holds n ccnb-encoded Names.
+ * @param n is the number of names.
+ * @param interest_template is used for all of the interests (may be NULL).
+ * @param timeout_ms limits the time spent waiting for all of the answers.
+ * @param results holds n charbufs; each is set to the ccnb-encoded
+ *        ContentObject for the corresponding name, or emptied if none arrived.
+ * @param flags as for ccn_get(), and CCN_GET_ANY to return as soon as
+ *        any one of the ContentObjects has arrived.
+ * @returns the number of ContentObjects obtained, or -1 for an error.
+ */
+int
+ccn_get_multi(struct ccn *h,
+              struct ccn_charbuf **names,
+              int n,
+              struct ccn_charbuf *interest_template,
+              int timeout_ms,
+              struct ccn_charbuf **results,
+              int flags)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        if (names[i] == NULL || results[i] == NULL)
             return(-1);
-        }
-    }
-    md = calloc(1, sizeof(*md));
-    md->resultbuf = resultbuf;
-    md->pcobuf = pcobuf;
-    md->compsbuf = compsbuf;
-    md->flags = flags;
-    md->res = -1;
-    md->closure.p = &handle_simple_incoming_content;
-    md->closure.data = md;
-    md->closure.intdata = 1; /* tell upcall to re-express if needed */
-    md->closure.refcount = 1;
-    res = ccn_express_interest(h, name, &md->closure, interest_template);
-    if (res >= 0)
-        res = ccn_run(h, timeout_ms);
-    if (res >= 0)
-        res = md->res;
-    md->resultbuf = NULL;
-    md->pcobuf = NULL;
-    md->compsbuf = NULL;
-    md->closure.intdata = 0;
-    md->closure.refcount--;
-    if (md->closure.refcount == 0)
-        free(md);
-    if (h != orig_h) {
-        if (saved_keys != NULL)
-            h->keys = saved_keys;
-        ccn_destroy(&h);
+        results[i]->length = 0;
     }
-    return(res);
+    return(ccn_get_batch(h, names, n, interest_template, NULL, timeout_ms,
+                         results, NULL, NULL, flags));
 }
 
 /**
@@ -2492,6 +2969,60 @@ Cleanup:
     return(res);
 }
 
+/**
+ * Load a shared secret for signing and verifying with HMAC-SHA256.
+ *
+ * Content is signed with the secret by using its keyid as the pubid
+ * in the signing parameters.  Content signed with the secret by others
+ * is verified once it has been loaded.
+ * @param h is the ccn handle
+ * @param secret_path is the pathname of a file holding the secret
+ * @param keyid_out, if not NULL, is loaded with the keyid of the secret
+ * @result is 0 for success, negative for error.
+ */
+int
+ccn_load_secret_key(struct ccn *h,
+                    const char *secret_path,
+                    struct ccn_charbuf *keyid_out)
+{
+    struct ccn_keystore *keystore = NULL;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    int res;
+
+    keystore = ccn_keystore_create();
+    if (keystore == NULL)
+        return(NOTE_ERRNO(h));
+    res = ccn_keystore_init_secret(keystore, (char *)secret_path);
+    if (res != 0) {
+        res = NOTE_ERRNO(h);
+        ccn_keystore_destroy(&keystore);
+        return(res);
+    }
+    if (keyid_out != NULL) {
+        keyid_out->length = 0;
+        ccn_charbuf_append(keyid_out,
+                           ccn_keystore_public_key_digest(keystore),
+                           ccn_keystore_public_key_digest_length(keystore));
+    }
+    hashtb_start(h->keystores, e);
+    res = hashtb_seek(e, ccn_keystore_public_key_digest(keystore),
+                      ccn_keystore_public_key_digest_length(keystore), 0);
+    if (res == HT_NEW_ENTRY) {
+        struct ccn_keystore **p = e->data;
+        *p = keystore;
+        keystore = NULL;
+        res = 0;
+    }
+    else if (res == HT_OLD_ENTRY)
+        res = 0;
+    else
+        res = NOTE_ERRNO(h);
+    hashtb_end(e);
+    ccn_keystore_destroy(&keystore);
+    return(res);
+}
+
 /**
  * Load the handle's default signing key from a keystore.
  *
@@ -2552,6 +3083,7 @@ ccn_get_public_key(struct ccn *h,
     struct hashtb_enumerator ee;
     struct hashtb_enumerator *e = &ee;
     struct ccn_keystore *keystore = NULL;
+    const struct ccn_pkey *public_key = NULL;
     struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
     int res;
     res = ccn_chk_signing_params(h, params, &sp, NULL, NULL, NULL, NULL);
@@ -2561,33 +3093,38 @@ ccn_get_public_key(struct ccn *h,
     if (hashtb_seek(e, sp.pubid, sizeof(sp.pubid), 0) == HT_OLD_ENTRY) {
         struct ccn_keystore **pk = e->data;
         keystore = *pk;
-        if (digest_result != NULL) {
-            digest_result->length = 0;
-            ccn_charbuf_append(digest_result,
-                               ccn_keystore_public_key_digest(keystore),
-                               ccn_keystore_public_key_digest_length(keystore));
-        }
-        if (result != NULL) {
-            struct ccn_buf_decoder decoder;
-            struct ccn_buf_decoder *d;
-            const unsigned char *p;
-            size_t size;
-            result->length = 0;
-            ccn_append_pubkey_blob(result, ccn_keystore_public_key(keystore));
-            d = ccn_buf_decoder_start(&decoder, result->buf, result->length);
-            res = ccn_buf_match_blob(d, &p, &size);
-            if (res >= 0) {
-                memmove(result->buf, p, size);
-                result->length = size;
-                res = 0;
-            }
-        }
+        public_key = ccn_keystore_public_key(keystore);
     }
-    else {
-        res = NOTE_ERR(h, -1);
+    else
         hashtb_delete(e);
-    }
     hashtb_end(e);
+    if (keystore == NULL && h->signagent != NULL &&
+          memcmp(sp.pubid, ccn_signagent_pubid(h->signagent),
+                 sizeof(sp.pubid)) == 0)
+        public_key = ccn_signagent_public_key(h->signagent);
+    else if (keystore == NULL)
+        return(NOTE_ERR(h, -1));
+    if (digest_result != NULL) {
+        digest_result->length = 0;
+        ccn_charbuf_append(digest_result, sp.pubid, sizeof(sp.pubid));
+    }
+    if (result != NULL && public_key == NULL)
+        res = NOTE_ERR(h, EINVAL); /* a shared secret has none */
+    else if (result != NULL) {
+        struct ccn_buf_decoder decoder;
+        struct ccn_buf_decoder *d;
+        const unsigned char *p;
+        size_t size;
+        result->length = 0;
+        ccn_append_pubkey_blob(result, public_key);
+        d = ccn_buf_decoder_start(&decoder, result->buf, result->length);
+        res = ccn_buf_match_blob(d, &p, &size);
+        if (res >= 0) {
+            memmove(result->buf, p, size);
+            result->length = size;
+            res = 0;
+        }
+    }
     return(res);
 }
 
@@ -2643,6 +3180,15 @@ ccn_load_or_create_default_key(struct ccn *h)
     default_pubid = ccn_charbuf_create();
     if (default_pubid == NULL || path == NULL)
         return(NOTE_ERRNO(h));
+    /* A signing agent saves us from unlocking the keystore */
+    h->signagent = ccn_signagent_open(NULL);
+    if (h->signagent != NULL) {
+        ccn_charbuf_append(default_pubid, ccn_signagent_pubid(h->signagent),
+                           CCN_SIGNAGENT_KEYID_SIZE);
+        h->default_pubid = default_pubid;
+        ccn_charbuf_destroy(&path);
+        return(0);
+    }
     s = getenv("CCNX_DIR");
     if (s != NULL && s[0] != 0)
         ccn_charbuf_putf(path, "%s", s);
@@ -2838,6 +3384,8 @@ ccn_sign_content(struct ccn *h,
     struct ccn_signing_params p = CCN_SIGNING_PARAMS_INIT;
     struct ccn_charbuf *signed_info = NULL;
     struct ccn_keystore *keystore = NULL;
+    struct ccn_signagent *agent = NULL;
+    const struct ccn_pkey *public_key = NULL;
     struct ccn_charbuf *timestamp = NULL;
     struct ccn_charbuf *finalblockid = NULL;
     struct ccn_charbuf *keylocator = NULL;
@@ -2852,14 +3400,50 @@ ccn_sign_content(struct ccn *h,
     if (hashtb_seek(e, p.pubid, sizeof(p.pubid), 0) == HT_OLD_ENTRY) {
         struct ccn_keystore **pk = e->data;
         keystore = *pk;
+    }
+    else
+        hashtb_delete(e);
+    hashtb_end(e);
+    if (keystore != NULL)
+        public_key = ccn_keystore_public_key(keystore);
+    else if (h->signagent != NULL &&
+             memcmp(p.pubid, ccn_signagent_pubid(h->signagent),
+                    sizeof(p.pubid)) == 0) {
+        agent = h->signagent;
+        public_key = ccn_signagent_public_key(agent);
+    }
+    else
+        res = NOTE_ERR(h, -1);
+    if (res >= 0) {
         signed_info = ccn_charbuf_create();
-        if (keylocator == NULL && (p.sp_flags & CCN_SP_OMIT_KEY_LOCATOR) == 0) {
+        if (keylocator == NULL && (p.sp_flags & CCN_SP_OMIT_KEY_LOCATOR) == 0 &&
+              keystore != NULL &&
+              ccn_keystore_key_type(keystore) == CCN_KEYSTORE_KEY_HMAC) {
+            /* Construct a key locator naming the shared secret */
+            struct ccn_charbuf *name = ccn_charbuf_create();
+            struct ccn_charbuf *comp = ccn_charbuf_create();
+            ccn_name_init(name);
+            ccn_name_append_str(name, SECRET_KEY_MARKER);
+            ccn_charbuf_append_value(comp, CCN_MARKER_CONTROL, 1);
+            ccn_charbuf_append_string(comp, ".M.K");
+            ccn_charbuf_append_value(comp, 0, 1);
+            ccn_charbuf_append(comp, p.pubid, sizeof(p.pubid));
+            res = ccn_name_append(name, comp->buf, comp->length);
+            keylocator = ccn_charbuf_create();
+            ccn_charbuf_append_tt(keylocator, CCN_DTAG_KeyLocator, CCN_DTAG);
+            ccn_charbuf_append_tt(keylocator, CCN_DTAG_KeyName, CCN_DTAG);
+            ccn_charbuf_append_charbuf(keylocator, name);
+            ccn_charbuf_append_closer(keylocator); /* </KeyName> */
+            ccn_charbuf_append_closer(keylocator); /* </KeyLocator> */
+            ccn_charbuf_destroy(&name);
+            ccn_charbuf_destroy(&comp);
+        }
+        else if (keylocator == NULL && (p.sp_flags & CCN_SP_OMIT_KEY_LOCATOR) == 0) {
             /* Construct a key locator containing the key itself */
             keylocator = ccn_charbuf_create();
             ccn_charbuf_append_tt(keylocator, CCN_DTAG_KeyLocator, CCN_DTAG);
             ccn_charbuf_append_tt(keylocator, CCN_DTAG_Key, CCN_DTAG);
-            res = ccn_append_pubkey_blob(keylocator,
-                                         ccn_keystore_public_key(keystore));
+            res = ccn_append_pubkey_blob(keylocator, public_key);
             ccn_charbuf_append_closer(keylocator); /* </Key> */
             ccn_charbuf_append_closer(keylocator); /* </KeyLocator> */
         }
@@ -2884,8 +3468,8 @@ ccn_sign_content(struct ccn *h,
         }
         if (res >= 0)
             res = ccn_signed_info_create(signed_info,
-                                         ccn_keystore_public_key_digest(keystore),
-                                         ccn_keystore_public_key_digest_length(keystore),
+                                         p.pubid,
+                                         sizeof(p.pubid),
                                          timestamp,
                                          p.type,
                                          p.freshness,
@@ -2902,20 +3486,22 @@ ccn_sign_content(struct ccn *h,
             else
                 NOTE_ERR(h, -1);
         }
-        if (res >= 0)
-            res = ccn_encode_ContentObject(resultbuf,
-                                           name_prefix,
-                                           signed_info,
-                                           data,
-                                           size,
-                                           ccn_keystore_digest_algorithm(keystore),
-                                           ccn_keystore_private_key(keystore));
-    }
-    else {
-        res = NOTE_ERR(h, -1);
-        hashtb_delete(e);
+        if (res >= 0 && agent != NULL) {
+            res = ccn_signagent_sign_content(agent, resultbuf, name_prefix,
+                                             signed_info, data, size);
+            if (res < 0)
+                NOTE_ERRNO(h);
+        }
+        else if (res >= 0)
+            res = ccn_encode_ContentObject_sigc(resultbuf,
+                                                name_prefix,
+                                                signed_info,
+                                                data,
+                                                size,
+                                                ccn_keystore_digest_algorithm(keystore),
+                                                ccn_keystore_private_key(keystore),
+                                                ccn_keystore_sigc(keystore));
     }
-    hashtb_end(e);
     ccn_charbuf_destroy(&timestamp);
     ccn_charbuf_destroy(&keylocator);
     ccn_charbuf_destroy(&finalblockid);
@@ -0,0 +1,825 @@
+/**
+ * @file ccn_crawl.c
+ * @brief Enumeration of the content under a name prefix.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/crawl.h>
+#include <ccn/indexbuf.h>
+
+#define INITIAL_RTO_US 250000
+#define MIN_RTO_US 50000
+#define MAX_RTO_US 8000000
+#define MAX_RETRIES 1
+#define DEFAULT_WINDOW 256
+#define DEFAULT_PARTITIONS 17
+#define MIN_WINDOW 4
+#define QUEUE_SLACK_US 5000
+
+enum entry_kind {
+    ENTRY_HEAD = 0,     /* start of a node's list, with no component */
+    ENTRY_FENCE,        /* boundary between the initial ranges */
+    ENTRY_NAME,         /* a component with names below it */
+    ENTRY_OBJECT        /* an implicit digest, naming a content object */
+};
+
+/*
+ * A member of a node's ordered set of next components.
+ * The component value follows the struct in the same allocation.
+ */
+struct entry {
+    struct entry *next;
+    struct node *child;         /* for ENTRY_NAME */
+    enum entry_kind kind;
+    size_t size;
+    unsigned char *comp;
+};
+
+/*
+ * One name that is being explored for further components.
+ * The list starting at head is kept in canonical order.
+ */
+struct node {
+    struct entry head;
+    struct ccn_charbuf *name;   /* ccnb-encoded Name of this node */
+    int ncomps;
+};
+
+enum range_state {
+    RANGE_READY = 0,    /* waiting for the window to open */
+    RANGE_IN_FLIGHT,    /* interest expressed */
+    RANGE_DONE          /* answered or empty; freed at CCN_UPCALL_FINAL */
+};
+
+/*
+ * A span of next components of a node, between two entries of its set.
+ * The bounds are exclusive, except that a fence is the first component
+ * of the range it starts.  A range may hold one entry that is already
+ * known, the hole, which its interest excludes explicitly.
+ * Each range has its own closure, so an arrival identifies its range
+ * without a search, and the range is replaced by two when it turns up
+ * a name.
+ */
+struct range {
+    struct ccn_closure closure;
+    struct ccn_crawl *parent;   /* NULL once the crawl is destroyed */
+    struct range *prev;         /* live ranges of the crawl */
+    struct range *next;
+    struct range *ready_next;   /* stack of ranges waiting to be asked */
+    struct node *node;
+    struct entry *after;        /* finds go after this entry */
+    struct entry *lo;           /* lower bound, or NULL */
+    struct entry *hi;           /* upper bound, or NULL */
+    struct entry *hole;
+    enum range_state state;
+    int retries;
+    struct timeval sent;
+};
+
+/*
+ * Our private record of the state of the crawl
+ */
+struct ccn_crawl {
+    struct ccn *h;
+    struct ccn_closure *client;     /* client-supplied upcall for objects */
+    struct node *root;
+    int flags;
+    int partitions;
+    int started;
+    struct range *live;             /* ranges not yet done */
+    struct range *ready;            /* ranges not yet asked, most recent first */
+    int queued;
+    int in_flight;                  /* first interests, held to the window */
+    int probing;                    /* retries of ranges that seem empty */
+    int max_window;
+    double cwnd;                    /* concurrency window, in interests */
+    int slow_start;
+    struct timeval last_decrease;
+    int rto_us;
+    int srtt_us;                    /* zero until there is a sample */
+    int rttvar_us;
+    int min_rtt_us;
+    struct ccn_crawl_stats stats;
+};
+
+static enum ccn_upcall_res incoming_range(struct ccn_closure *selfp,
+                                          enum ccn_upcall_kind kind,
+                                          struct ccn_upcall_info *info);
+
+/*
+ * Compare name components in the canonical order - shorter first,
+ * then lexicographic.
+ */
+static int
+compare_comps(const unsigned char *a, size_t asize,
+              const unsigned char *b, size_t bsize)
+{
+    if (asize != bsize)
+        return(asize < bsize ? -1 : 1);
+    return(memcmp(a, b, asize));
+}
+
+static int
+compare_entry(const struct entry *e, const unsigned char *comp, size_t size)
+{
+    return(compare_comps(e->comp, e->size, comp, size));
+}
+
+static struct entry *
+new_entry(enum entry_kind kind, const unsigned char *comp, size_t size)
+{
+    struct entry *e;
+
+    e = calloc(1, sizeof(*e) + size);
+    if (e == NULL)
+        return(NULL);
+    e->kind = kind;
+    e->size = size;
+    e->comp = (unsigned char *)(e + 1);
+    memcpy(e->comp, comp, size);
+    return(e);
+}
+
+static struct node *
+new_node(struct ccn_charbuf *name, int ncomps)
+{
+    struct node *n;
+
+    n = calloc(1, sizeof(*n));
+    if (n == NULL)
+        return(NULL);
+    n->name = ccn_charbuf_create();
+    if (n->name == NULL) {
+        free(n);
+        return(NULL);
+    }
+    ccn_charbuf_append_charbuf(n->name, name);
+    n->ncomps = ncomps;
+    return(n);
+}
+
+static void
+destroy_node(struct node *n)
+{
+    struct entry *e;
+    struct entry *next;
+
+    for (e = n->head.next; e != NULL; e = next) {
+        next = e->next;
+        if (e->child != NULL)
+            destroy_node(e->child);
+        free(e);
+    }
+    ccn_charbuf_destroy(&n->name);
+    free(n);
+}
+
+static int
+elapsed_us(const struct timeval *then)
+{
+    struct timeval now;
+    long d;
+
+    gettimeofday(&now, NULL);
+    d = (now.tv_sec - then->tv_sec) * 1000000L + (now.tv_usec - then->tv_usec);
+    if (d < 0)
+        d = 0;
+    if (d > MAX_RTO_US)
+        d = MAX_RTO_US;
+    return(d);
+}
+
+/*
+ * Update the round-trip estimate, as in RFC 6298.
+ * Only answers to unretried interests are sampled (Karn's algorithm).
+ */
+static void
+note_rtt(struct ccn_crawl *c, int sample)
+{
+    int err;
+
+    if (c->srtt_us == 0) {
+        c->srtt_us = sample + 1;
+        c->rttvar_us = sample / 2;
+    }
+    else {
+        err = sample - c->srtt_us;
+        if (err < 0)
+            err = -err;
+        c->rttvar_us += (err - c->rttvar_us) / 4;
+        c->srtt_us += (sample - c->srtt_us) / 8;
+    }
+    c->rto_us = c->srtt_us + 4 * c->rttvar_us;
+    if (c->rto_us < MIN_RTO_US)
+        c->rto_us = MIN_RTO_US;
+    if (c->rto_us > MAX_RTO_US)
+        c->rto_us = MAX_RTO_US;
+}
+
+/*
+ * Adjust the window from the delay of an answer.
+ *
+ * Timeouts say nothing about congestion here, since a range that holds
+ * nothing more is only discovered by its interest timing out.  Instead,
+ * the window shrinks when the smoothed delay of the answers is well above
+ * the least delay seen, which means that interests are queueing somewhere,
+ * and grows while it is not.
+ */
+static void
+adjust_window(struct ccn_crawl *c, int sample)
+{
+    if (c->min_rtt_us == 0 || sample < c->min_rtt_us)
+        c->min_rtt_us = sample;
+    if (c->srtt_us > 2 * c->min_rtt_us + QUEUE_SLACK_US) {
+        /* back off at most once per round trip */
+        if (elapsed_us(&c->last_decrease) > c->srtt_us) {
+            c->cwnd = c->cwnd * 3 / 4;
+            if (c->cwnd < MIN_WINDOW)
+                c->cwnd = MIN_WINDOW;
+            c->slow_start = 0;
+            gettimeofday(&c->last_decrease, NULL);
+        }
+        return;
+    }
+    if (c->slow_start)
+        c->cwnd += 1;
+    else
+        c->cwnd += 1.0 / c->cwnd;
+    if (c->cwnd > c->max_window)
+        c->cwnd = c->max_window;
+}
+
+/*
+ * Make a range and put it on the stack of ranges to ask about.
+ */
+static struct range *
+new_range(struct ccn_crawl *c, struct node *node, struct entry *after,
+          struct entry *lo, struct entry *hi, struct entry *hole)
+{
+    struct range *r;
+
+    r = calloc(1, sizeof(*r));
+    if (r == NULL)
+        return(NULL);
+    r->closure.p = &incoming_range;
+    r->closure.data = r;
+    r->parent = c;
+    r->node = node;
+    r->after = after;
+    r->lo = lo;
+    r->hi = hi;
+    r->hole = hole;
+    r->state = RANGE_READY;
+    r->next = c->live;
+    if (c->live != NULL)
+        c->live->prev = r;
+    c->live = r;
+    r->ready_next = c->ready;
+    c->ready = r;
+    c->queued++;
+    return(r);
+}
+
+/*
+ * Take a range off the live list.
+ * It is freed when the library is done with its closure.
+ */
+static void
+finish_range(struct ccn_crawl *c, struct range *r)
+{
+    r->state = RANGE_DONE;
+    if (r->prev != NULL)
+        r->prev->next = r->next;
+    else
+        c->live = r->next;
+    if (r->next != NULL)
+        r->next->prev = r->prev;
+    r->prev = r->next = NULL;
+}
+
+static void
+append_any(struct ccn_charbuf *templ)
+{
+    ccn_charbuf_append_tt(templ, CCN_DTAG_Any, CCN_DTAG);
+    ccn_charbuf_append_closer(templ); /* </Any> */
+}
+
+/*
+ * Append the exclusion of everything up to and including the lower bound
+ * of a range.  A fence is in its range, so what is excluded is everything
+ * up to the component just before it in the canonical order.
+ */
+static void
+append_lower_bound(struct ccn_charbuf *templ, struct entry *lo)
+{
+    unsigned char pred[CCN_CRAWL_MAX_PARTITIONS];
+    size_t size = lo->size;
+    size_t i;
+
+    if (lo->kind != ENTRY_FENCE) {
+        append_any(templ);
+        ccnb_append_tagged_blob(templ, CCN_DTAG_Component, lo->comp, lo->size);
+        return;
+    }
+    assert(size > 0 && size <= sizeof(pred));
+    memcpy(pred, lo->comp, size);
+    for (i = size; i > 0 && pred[i - 1] == 0; i--)
+        pred[i - 1] = 0xFF;
+    if (i > 0)
+        pred[i - 1]--;
+    else
+        size--; /* all zero, so the predecessor is all ones and shorter */
+    append_any(templ);
+    ccnb_append_tagged_blob(templ, CCN_DTAG_Component, pred, size);
+}
+
+/*
+ * Express the interest for a range.
+ * The lifetime follows the retransmission timeout, doubled for a retry.
+ */
+static int
+express_range(struct ccn_crawl *c, struct range *r)
+{
+    struct ccn_charbuf *templ = NULL;
+    uintmax_t lifetime;
+    int aok = CCN_AOK_CS;
+    int res;
+
+    templ = ccn_charbuf_create();
+    ccn_charbuf_append_tt(templ, CCN_DTAG_Interest, CCN_DTAG);
+    ccn_charbuf_append_tt(templ, CCN_DTAG_Name, CCN_DTAG);
+    ccn_charbuf_append_closer(templ); /* </Name> */
+    if (r->lo != NULL || r->hi != NULL || r->hole != NULL) {
+        ccn_charbuf_append_tt(templ, CCN_DTAG_Exclude, CCN_DTAG);
+        if (r->lo != NULL)
+            append_lower_bound(templ, r->lo);
+        if (r->hole != NULL)
+            ccnb_append_tagged_blob(templ, CCN_DTAG_Component,
+                                    r->hole->comp, r->hole->size);
+        if (r->hi != NULL) {
+            ccnb_append_tagged_blob(templ, CCN_DTAG_Component,
+                                    r->hi->comp, r->hi->size);
+            append_any(templ);
+        }
+        ccn_charbuf_append_closer(templ); /* </Exclude> */
+    }
+    if ((c->flags & CCN_CRAWL_ALLOW_STALE) != 0)
+        aok |= CCN_AOK_STALE;
+    ccnb_tagged_putf(templ, CCN_DTAG_AnswerOriginKind, "%d", aok);
+    if ((c->flags & CCN_CRAWL_LOCAL_SCOPE) != 0)
+        ccnb_tagged_putf(templ, CCN_DTAG_Scope, "%d", 0);
+    /* InterestLifetime is in units of 1/4096 second */
+    lifetime = ((uintmax_t)c->rto_us * 4096 + 999999) / 1000000;
+    ccnb_append_tagged_binary_number(templ, CCN_DTAG_InterestLifetime,
+                                     lifetime << r->retries);
+    ccn_charbuf_append_closer(templ); /* </Interest> */
+    res = ccn_express_interest(c->h, r->node->name, &r->closure, templ);
+    ccn_charbuf_destroy(&templ);
+    if (res < 0)
+        return(res);
+    gettimeofday(&r->sent, NULL);
+    c->stats.expressed++;
+    return(0);
+}
+
+/*
+ * Express interests for waiting ranges while the window allows.
+ */
+static void
+fill_window(struct ccn_crawl *c)
+{
+    struct range *r;
+
+    while (c->in_flight < (int)c->cwnd && c->ready != NULL) {
+        r = c->ready;
+        c->ready = r->ready_next;
+        r->ready_next = NULL;
+        c->queued--;
+        if (express_range(c, r) < 0) {
+            finish_range(c, r);
+            if (r->closure.refcount == 0)
+                free(r);
+            continue;
+        }
+        r->state = RANGE_IN_FLIGHT;
+        c->in_flight++;
+    }
+    c->stats.done = (c->started && c->in_flight == 0 && c->probing == 0 &&
+                     c->ready == NULL);
+}
+
+/*
+ * Check that a component is one that a range is asking for.
+ */
+static int
+in_range(struct range *r, const unsigned char *comp, size_t size)
+{
+    int res;
+
+    if (r->lo != NULL) {
+        res = compare_entry(r->lo, comp, size);
+        if (res > 0 || (res == 0 && r->lo->kind != ENTRY_FENCE))
+            return(0);
+    }
+    if (r->hi != NULL && compare_entry(r->hi, comp, size) <= 0)
+        return(0);
+    if (r->hole != NULL && compare_entry(r->hole, comp, size) == 0)
+        return(0);
+    return(1);
+}
+
+/*
+ * Record the next component that a range turned up, and replace the
+ * range with the two on either side of it.  If there are more components,
+ * start exploring the new name.
+ * @returns 1 if the content object should go to the client.
+ */
+static int
+note_find(struct ccn_crawl *c, struct range *r,
+          const unsigned char *comp, size_t size,
+          struct ccn_upcall_info *info)
+{
+    struct node *node = r->node;
+    struct node *child = NULL;
+    struct entry *e = NULL;
+    struct entry *p = NULL;
+    struct entry *hole = NULL;
+    struct ccn_charbuf *name = NULL;
+    int n = info->content_comps->n - 1;
+    int ans = 0;
+
+    e = new_entry(n == node->ncomps ? ENTRY_OBJECT : ENTRY_NAME, comp, size);
+    if (e == NULL)
+        return(-1);
+    p = r->after;
+    if (r->hole != NULL && p->next == r->hole && compare_entry(r->hole, comp, size) < 0)
+        p = r->hole;
+    e->next = p->next;
+    p->next = e;
+    /* the two halves, lower one first unless it is empty */
+    if (!(r->lo != NULL && r->lo->kind == ENTRY_FENCE &&
+          compare_entry(r->lo, comp, size) == 0))
+        new_range(c, node, r->after, r->lo, e, p == r->hole ? r->hole : NULL);
+    new_range(c, node, e, e, r->hi, p == r->hole ? NULL : r->hole);
+    if (e->kind == ENTRY_OBJECT)
+        return(1);
+    name = ccn_charbuf_create();
+    ccn_charbuf_append_charbuf(name, node->name);
+    ccn_name_append(name, comp, size);
+    child = new_node(name, node->ncomps + 1);
+    ccn_charbuf_destroy(&name);
+    if (child == NULL)
+        return(-1);
+    e->child = child;
+    c->stats.nodes++;
+    if (n == node->ncomps + 1) {
+        /* The object is named by this component and its digest */
+        ccn_digest_ContentObject(info->content_ccnb, info->pco);
+        hole = new_entry(ENTRY_OBJECT, info->pco->digest, info->pco->digest_bytes);
+        if (hole == NULL)
+            return(-1);
+        child->head.next = hole;
+        ans = 1;
+    }
+    new_range(c, child, &child->head, NULL, NULL, hole);
+    return(ans);
+}
+
+/*
+ * Account for an interest that is no longer outstanding.
+ */
+static void
+note_gone(struct ccn_crawl *c, struct range *r)
+{
+    if (r->retries == 0)
+        c->in_flight--;
+    else
+        c->probing--;
+}
+
+static enum ccn_upcall_res
+incoming_range(struct ccn_closure *selfp,
+               enum ccn_upcall_kind kind,
+               struct ccn_upcall_info *info)
+{
+    struct range *r = selfp->data;
+    struct ccn_crawl *c = r->parent;
+    const unsigned char *comp = NULL;
+    size_t comp_size = 0;
+    int ncomps;
+    int sample;
+    int res;
+
+    assert(selfp == &r->closure);
+    if (kind == CCN_UPCALL_FINAL) {
+        if (c != NULL && r->state != RANGE_DONE) {
+            if (r->state == RANGE_IN_FLIGHT)
+                note_gone(c, r);
+            finish_range(c, r);
+        }
+        free(r);
+        return(CCN_UPCALL_RESULT_OK);
+    }
+    if (c == NULL || r->state != RANGE_IN_FLIGHT)
+        return(CCN_UPCALL_RESULT_OK);
+    switch (kind) {
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+        case CCN_UPCALL_CONTENT_RAW:
+        case CCN_UPCALL_CONTENT_KEYMISSING:
+            break;
+        case CCN_UPCALL_INTEREST_TIMED_OUT:
+            c->stats.timeouts++;
+            if (r->retries < MAX_RETRIES) {
+                /*
+                 * Most likely the range is empty.  Make sure with a longer
+                 * lifetime, but without holding a place in the window.
+                 */
+                if (r->retries++ == 0) {
+                    c->in_flight--;
+                    c->probing++;
+                }
+                if (express_range(c, r) == 0) {
+                    fill_window(c);
+                    return(CCN_UPCALL_RESULT_OK);
+                }
+            }
+            /* nothing more to be found here */
+            c->stats.empty++;
+            note_gone(c, r);
+            finish_range(c, r);
+            fill_window(c);
+            return(CCN_UPCALL_RESULT_OK);
+        default:
+            /* e.g. CCN_UPCALL_CONTENT_BAD - the timeout will take care of it */
+            return(CCN_UPCALL_RESULT_ERR);
+    }
+    /* the next component after the node's name, perhaps the digest */
+    ncomps = r->node->ncomps;
+    if (info->content_comps->n - 1 == ncomps) {
+        ccn_digest_ContentObject(info->content_ccnb, info->pco);
+        comp = info->pco->digest;
+        comp_size = info->pco->digest_bytes;
+    }
+    else if (info->content_comps->n - 1 < ncomps ||
+             ccn_name_comp_get(info->content_ccnb, info->content_comps,
+                               ncomps, &comp, &comp_size) < 0)
+        comp = NULL;
+    if (comp == NULL || !in_range(r, comp, comp_size)) {
+        /* not what was asked for, so ask again */
+        c->stats.duplicates++;
+        if (express_range(c, r) == 0)
+            return(CCN_UPCALL_RESULT_OK);
+        note_gone(c, r);
+        finish_range(c, r);
+        fill_window(c);
+        return(CCN_UPCALL_RESULT_OK);
+    }
+    note_gone(c, r);
+    if (r->retries == 0) {
+        sample = elapsed_us(&r->sent);
+        note_rtt(c, sample);
+        adjust_window(c, sample);
+    }
+    res = note_find(c, r, comp, comp_size, info);
+    finish_range(c, r);
+    if (res > 0) {
+        c->stats.found++;
+        (*c->client->p)(c->client, kind, info);
+    }
+    fill_window(c);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Create a crawl of the content under a prefix.
+ *
+ * Nothing is requested until ccn_crawl_start() is called.
+ * @param name_prefix is the ccnb-encoded Name to enumerate.
+ * @param flags are CCN_CRAWL_LOCAL_SCOPE and CCN_CRAWL_ALLOW_STALE.
+ * @param client is called with each content object found.
+ * @returns the new crawl, or NULL for an error.
+ */
+struct ccn_crawl *
+ccn_crawl_create(struct ccn *h,
+                 struct ccn_charbuf *name_prefix,
+                 int flags,
+                 struct ccn_closure *client)
+{
+    struct ccn_crawl *c;
+    struct ccn_indexbuf *comps = NULL;
+    int res;
+
+    if (h == NULL || name_prefix == NULL || client == NULL)
+        return(NULL);
+    comps = ccn_indexbuf_create();
+    res = ccn_name_split(name_prefix, comps);
+    ccn_indexbuf_destroy(&comps);
+    if (res < 0)
+        return(NULL);
+    c = calloc(1, sizeof(*c));
+    if (c == NULL)
+        return(NULL);
+    c->h = h;
+    c->flags = flags;
+    c->root = new_node(name_prefix, res);
+    if (c->root == NULL) {
+        free(c);
+        return(NULL);
+    }
+    c->client = client;
+    client->refcount++;
+    c->partitions = DEFAULT_PARTITIONS;
+    c->max_window = DEFAULT_WINDOW;
+    c->rto_us = INITIAL_RTO_US;
+    return(c);
+}
+
+/**
+ * Set the maximum number of interests in flight.
+ *
+ * The window starts out large enough for the initial ranges, and grows
+ * as answers arrive, up to this size.  It shrinks when the delay of the
+ * answers rises well above the least delay seen.
+ * @returns 0 for success, -1 for an error.
+ */
+int
+ccn_crawl_set_window(struct ccn_crawl *c, int window)
+{
+    if (c == NULL || window < 1 || window > CCN_CRAWL_MAX_WINDOW)
+        return(-1);
+    c->max_window = window;
+    if (c->cwnd > window)
+        c->cwnd = window;
+    return(0);
+}
+
+/**
+ * Set the number of ranges the name space just below the prefix is
+ * divided into at the start.
+ *
+ * The ranges are separated by fences chosen to spread typical
+ * components: for each length, in order, the first bytes 0x3F, 0x7F,
+ * 0xBF and 0xFF each end a range.  Ranges below the top level start
+ * out whole, and all ranges divide as names are found.  The default
+ * of 17 covers components of up to four bytes finely.
+ * May only be called before ccn_crawl_start().
+ * @returns 0 for success, -1 for an error.
+ */
+int
+ccn_crawl_set_partitions(struct ccn_crawl *c, int partitions)
+{
+    if (c == NULL || c->started ||
+        partitions < 1 || partitions > CCN_CRAWL_MAX_PARTITIONS)
+        return(-1);
+    c->partitions = partitions;
+    return(0);
+}
+
+/**
+ * Start expressing interests.
+ * The crawl then runs from the upcalls, as ccn_run() is called.
+ */
+int
+ccn_crawl_start(struct ccn_crawl *c)
+{
+    unsigned char fence[CCN_CRAWL_MAX_PARTITIONS];
+    struct entry *after;
+    struct entry *lo = NULL;
+    struct entry *e;
+    size_t size;
+    int i;
+
+    if (c == NULL || c->started)
+        return(-1);
+    after = &c->root->head;
+    for (i = 0; i < c->partitions - 1; i++) {
+        size = 1 + i / 4;
+        fence[0] = ((i % 4) + 1) * 64 - 1;
+        memset(fence + 1, 0xFF, size - 1);
+        e = new_entry(ENTRY_FENCE, fence, size);
+        if (e == NULL)
+            return(-1);
+        after->next = e;
+        new_range(c, c->root, after, lo, e, NULL);
+        after = lo = e;
+    }
+    new_range(c, c->root, after, lo, NULL, NULL);
+    c->started = 1;
+    c->cwnd = c->partitions < c->max_window ? c->partitions : c->max_window;
+    c->slow_start = 1;
+    fill_window(c);
+    return(0);
+}
+
+int
+ccn_crawl_get_stats(struct ccn_crawl *c, struct ccn_crawl_stats *stats)
+{
+    if (c == NULL || stats == NULL)
+        return(-1);
+    c->stats.in_flight = c->in_flight + c->probing;
+    c->stats.window = (int)c->cwnd;
+    c->stats.queued = c->queued;
+    c->stats.srtt_us = c->srtt_us;
+    *stats = c->stats;
+    return(0);
+}
+
+static int
+walk_node(struct node *n, struct ccn_charbuf *name,
+          ccn_crawl_walker *walker, void *data)
+{
+    struct entry *e;
+    int res;
+
+    for (e = n->head.next; e != NULL; e = e->next) {
+        if (e->kind == ENTRY_OBJECT) {
+            name->length = 0;
+            ccn_charbuf_append_charbuf(name, n->name);
+            ccn_name_append(name, e->comp, e->size);
+            res = (*walker)(data, name->buf, name->length);
+            if (res != 0)
+                return(res);
+        }
+        else if (e->child != NULL) {
+            res = walk_node(e->child, name, walker, data);
+            if (res != 0)
+                return(res);
+        }
+    }
+    return(0);
+}
+
+/**
+ * Visit the names of the content objects found so far, in canonical order.
+ * @returns 0, or the nonzero value that stopped the walk.
+ */
+int
+ccn_crawl_walk(struct ccn_crawl *c, ccn_crawl_walker *walker, void *data)
+{
+    struct ccn_charbuf *name;
+    int res;
+
+    if (c == NULL || walker == NULL)
+        return(-1);
+    name = ccn_charbuf_create();
+    res = walk_node(c->root, name, walker, data);
+    ccn_charbuf_destroy(&name);
+    return(res);
+}
+
+/**
+ * Destroy a crawl.
+ *
+ * Interests still outstanding are left to expire; their ranges are freed
+ * when the library is done with them.  The client closure gets
+ * CCN_UPCALL_FINAL if this was the last reference to it.
+ */
+void
+ccn_crawl_destroy(struct ccn_crawl **cp)
+{
+    struct ccn_crawl *c = *cp;
+    struct ccn_closure *client;
+    struct ccn_upcall_info info = {0};
+    struct range *r;
+    struct range *next;
+
+    if (c == NULL)
+        return;
+    *cp = NULL;
+    for (r = c->live; r != NULL; r = next) {
+        next = r->next;
+        r->parent = NULL;
+        r->node = NULL;
+        if (r->closure.refcount == 0)
+            free(r);
+    }
+    destroy_node(c->root);
+    client = c->client;
+    free(c);
+    if (client != NULL && --(client->refcount) == 0) {
+        info.h = NULL;
+        (client->p)(client, CCN_UPCALL_FINAL, &info);
+    }
+}
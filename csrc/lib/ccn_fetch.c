@@ -745,7 +745,8 @@ ccn_fetch_get_ccn(struct ccn_fetch *f) {
  * If resolveVersion, then we assume that the version is unresolved, 
  * and an attempt is made to determine the version number using the highest
  * version.
- * The number of buffers (nBufs) may be silently limited.
+ * The number of buffers (nBufs) may be silently limited
+ * (see CCN_FETCH_MAX_BUFS).
  * @returns NULL if the stream creation failed,
  * otherwise returns the new stream.
  */
@@ -760,7 +761,7 @@ ccn_fetch_open(struct ccn_fetch *f,
 	// returns a new ccn_fetch_stream object based on the arguments
 	// returns NULL if not successful
     if (maxBufs <= 0) return NULL;
-	if (maxBufs > 16) maxBufs = 16;
+	if (maxBufs > CCN_FETCH_MAX_BUFS) maxBufs = CCN_FETCH_MAX_BUFS;
 	int res = 0;
 	FILE *debug = f->debug;
 	ccn_fetch_flags flags = f->debugFlags;
@@ -1028,6 +1029,50 @@ ccn_fetch_read(struct ccn_fetch_stream *fs,
 	return nr;
 }
 
+/**
+ * Changes the maximum number of buffers (the fetch window) for the stream.
+ * The window may be grown or shrunk at any time; growing it allows more
+ * segment interests to be in flight once the reader makes progress.
+ * @returns the new (possibly clamped) window, or -1 if maxBufs <= 0.
+ */
+extern int
+ccn_fetch_set_window(struct ccn_fetch_stream *fs, int maxBufs) {
+	if (maxBufs <= 0) return -1;
+	if (maxBufs > CCN_FETCH_MAX_BUFS) maxBufs = CCN_FETCH_MAX_BUFS;
+	if (maxBufs != fs->maxBufs) {
+		FILE *debug = fs->parent->debug;
+		ccn_fetch_flags flags = fs->parent->debugFlags;
+		if (debug != NULL && (flags & ccn_fetch_flags_NoteNeed)) {
+			fprintf(debug,
+					"-- ccn_fetch set_window %s, maxBufs %d -> %d\n",
+					fs->id, fs->maxBufs, maxBufs);
+			fflush(debug);
+		}
+		fs->maxBufs = maxBufs;
+		if (fs->segsAhead >= maxBufs) fs->segsAhead = maxBufs-1;
+		NeedSegments(fs);
+		PruneSegments(fs);
+	}
+	return maxBufs;
+}
+
+/**
+ * @returns the current fetch window (max number of buffers).
+ */
+extern int
+ccn_fetch_get_window(struct ccn_fetch_stream *fs) {
+	return fs->maxBufs;
+}
+
+/**
+ * @returns the segment size for the stream, 0 if not yet known,
+ * or -1 if segments are of variable size.
+ */
+extern int
+ccn_fetch_seg_size(struct ccn_fetch_stream *fs) {
+	return fs->segSize;
+}
+
 /**
  * Resets the timeout marker.
  */
@@ -0,0 +1,433 @@
+/**
+ * @file ccn_filewatch.c
+ * @brief Notification of changes to files and directory trees.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ccn/filewatch.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <ccn/charbuf.h>
+#include <ccn/hashtb.h>
+
+/*
+ * Each watched directory has its own inotify watch, so a tree costs one
+ * watch per directory.  Changes are collected in the pending table, keyed
+ * by path, and a file is handed to the client only after it has been
+ * quiet for the settle time.  If the event queue overflows, every watched
+ * file is taken to have changed.
+ */
+
+#define FILE_MASK (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                   IN_DELETE_SELF | IN_MOVE_SELF)
+#define DIR_MASK  (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | \
+                   IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | \
+                   IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/* A burst may hold off a report for at most this many settle times */
+#define MAX_SETTLE_FACTOR 10
+
+struct watch { /* keyed by the watch descriptor */
+    char *path;
+    int is_dir;
+};
+
+struct pending { /* keyed by path, nul-terminated */
+    struct timeval first;       /* first change not yet reported */
+    struct timeval last;        /* latest change */
+    int kind;
+};
+
+struct ccn_filewatch {
+    int fd;
+    int settle_us;
+    struct hashtb *watches;
+    struct hashtb *pending;
+    struct ccn_charbuf *path;   /* scratch */
+    int overflowed;
+};
+
+static void
+finalize_watch(struct hashtb_enumerator *e)
+{
+    struct watch *wa = e->data;
+
+    free(wa->path);
+    wa->path = NULL;
+}
+
+static long
+elapsed_us(const struct timeval *from, const struct timeval *to)
+{
+    return((to->tv_sec - from->tv_sec) * 1000000L +
+           (to->tv_usec - from->tv_usec));
+}
+
+static void
+note_change(struct ccn_filewatch *w, const char *path, int kind)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct pending *pe;
+    struct timeval now;
+    int res;
+
+    gettimeofday(&now, NULL);
+    hashtb_start(w->pending, e);
+    res = hashtb_seek(e, path, strlen(path), 1);
+    pe = e->data;
+    if (res == HT_NEW_ENTRY)
+        pe->first = now;
+    if (res >= 0) {
+        pe->last = now;
+        pe->kind = kind;
+    }
+    hashtb_end(e);
+}
+
+static int
+add_watch(struct ccn_filewatch *w, const char *path, int is_dir)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct watch *wa;
+    char *copy;
+    int wd;
+    int res;
+
+    wd = inotify_add_watch(w->fd, path, is_dir ? DIR_MASK : FILE_MASK);
+    if (wd == -1)
+        return(-1);
+    copy = strdup(path);
+    if (copy == NULL)
+        return(-1);
+    hashtb_start(w->watches, e);
+    res = hashtb_seek(e, &wd, sizeof(wd), 0);
+    wa = e->data;
+    if (res == HT_OLD_ENTRY)
+        finalize_watch(e);
+    if (res >= 0) {
+        wa->path = copy;
+        wa->is_dir = is_dir;
+    }
+    else
+        free(copy);
+    hashtb_end(e);
+    return(res < 0 ? -1 : 0);
+}
+
+/**
+ * Watch a directory and the ones below it.
+ *
+ * If report is nonzero, the files found are noted as changed;
+ * this is for directories that show up after the watch has started,
+ * since their contents may have been written before we saw them.
+ */
+static int
+add_tree(struct ccn_filewatch *w, struct ccn_charbuf *path, int report)
+{
+    struct dirent *de = NULL;
+    struct stat statbuf;
+    DIR *dir = NULL;
+    size_t pathlen = path->length;
+    int res;
+
+    res = add_watch(w, ccn_charbuf_as_string(path), 1);
+    if (res < 0)
+        return(res);
+    dir = opendir(ccn_charbuf_as_string(path));
+    if (dir == NULL)
+        return(-1);
+    while ((de = readdir(dir)) != NULL) {
+        if (strcmp(de->d_name, ".") == 0 || strcmp(de->d_name, "..") == 0)
+            continue;
+        path->length = pathlen;
+        ccn_charbuf_putf(path, "/%s", de->d_name);
+        if (lstat(ccn_charbuf_as_string(path), &statbuf) == -1)
+            continue;
+        if (S_ISDIR(statbuf.st_mode))
+            add_tree(w, path, report);
+        else if (report && S_ISREG(statbuf.st_mode))
+            note_change(w, ccn_charbuf_as_string(path), CCN_FILEWATCH_CHANGED);
+    }
+    closedir(dir);
+    path->length = pathlen;
+    ccn_charbuf_as_string(path);
+    return(0);
+}
+
+/**
+ * Treat everything watched as changed, after events have been lost.
+ */
+static void
+rescan(struct ccn_filewatch *w)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ccn_charbuf *path = ccn_charbuf_create();
+    struct ccn_charbuf *dirs = ccn_charbuf_create();
+    struct watch *wa;
+    size_t i;
+
+    /* Collect the paths first, since add_tree changes the table */
+    for (hashtb_start(w->watches, e); e->data != NULL; hashtb_next(e)) {
+        wa = e->data;
+        if (wa->is_dir)
+            ccn_charbuf_append(dirs, wa->path, strlen(wa->path) + 1);
+        else
+            note_change(w, wa->path, CCN_FILEWATCH_CHANGED);
+    }
+    hashtb_end(e);
+    for (i = 0; i < dirs->length; i += strlen((char *)dirs->buf + i) + 1) {
+        ccn_charbuf_reset(path);
+        ccn_charbuf_append_string(path, (char *)dirs->buf + i);
+        add_tree(w, path, 1);
+    }
+    ccn_charbuf_destroy(&dirs);
+    ccn_charbuf_destroy(&path);
+}
+
+static void
+handle_event(struct ccn_filewatch *w, const struct inotify_event *ev)
+{
+    struct watch *wa;
+
+    if ((ev->mask & IN_Q_OVERFLOW) != 0) {
+        w->overflowed = 1;
+        return;
+    }
+    wa = hashtb_lookup(w->watches, &ev->wd, sizeof(ev->wd));
+    if (wa == NULL)
+        return;
+    if ((ev->mask & IN_IGNORED) != 0) {
+        struct hashtb_enumerator ee;
+        struct hashtb_enumerator *e = &ee;
+        hashtb_start(w->watches, e);
+        if (hashtb_seek(e, &ev->wd, sizeof(ev->wd), 0) == HT_OLD_ENTRY)
+            hashtb_delete(e);
+        hashtb_end(e);
+        return;
+    }
+    ccn_charbuf_reset(w->path);
+    ccn_charbuf_append_string(w->path, wa->path);
+    if (ev->len > 0 && ev->name[0] != 0)
+        ccn_charbuf_putf(w->path, "/%s", ev->name);
+    if (!wa->is_dir) {
+        if ((ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0)
+            note_change(w, wa->path, CCN_FILEWATCH_REMOVED);
+        else
+            note_change(w, wa->path, CCN_FILEWATCH_CHANGED);
+        return;
+    }
+    if ((ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) != 0)
+        return; /* the entries within have been reported already */
+    if ((ev->mask & IN_ISDIR) != 0) {
+        if ((ev->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+            add_tree(w, w->path, 1);
+        return;
+    }
+    if ((ev->mask & (IN_DELETE | IN_MOVED_FROM)) != 0)
+        note_change(w, ccn_charbuf_as_string(w->path), CCN_FILEWATCH_REMOVED);
+    else
+        note_change(w, ccn_charbuf_as_string(w->path), CCN_FILEWATCH_CHANGED);
+}
+
+struct ccn_filewatch *
+ccn_filewatch_create(int settle_ms)
+{
+    struct hashtb_param param = {0};
+    struct ccn_filewatch *w = NULL;
+
+    if (settle_ms < 0) {
+        errno = EINVAL;
+        return(NULL);
+    }
+    w = calloc(1, sizeof(*w));
+    if (w == NULL)
+        return(NULL);
+    w->settle_us = settle_ms * 1000;
+    w->fd = inotify_init();
+    if (w->fd == -1) {
+        free(w);
+        return(NULL);
+    }
+    fcntl(w->fd, F_SETFL, O_NONBLOCK | fcntl(w->fd, F_GETFL));
+    fcntl(w->fd, F_SETFD, FD_CLOEXEC);
+    param.finalize = &finalize_watch;
+    w->watches = hashtb_create(sizeof(struct watch), &param);
+    w->pending = hashtb_create(sizeof(struct pending), NULL);
+    w->path = ccn_charbuf_create();
+    return(w);
+}
+
+int
+ccn_filewatch_add(struct ccn_filewatch *w, const char *path)
+{
+    struct stat statbuf;
+    struct ccn_charbuf *p = NULL;
+    int res;
+
+    if (w == NULL || path == NULL) {
+        errno = EINVAL;
+        return(-1);
+    }
+    if (stat(path, &statbuf) == -1)
+        return(-1);
+    if (!S_ISDIR(statbuf.st_mode))
+        return(add_watch(w, path, 0));
+    p = ccn_charbuf_create();
+    ccn_charbuf_append_string(p, path);
+    while (p->length > 1 && p->buf[p->length - 1] == '/')
+        p->length--;
+    res = add_tree(w, p, 0);
+    ccn_charbuf_destroy(&p);
+    return(res);
+}
+
+int
+ccn_filewatch_fd(struct ccn_filewatch *w)
+{
+    if (w == NULL)
+        return(-1);
+    return(w->fd);
+}
+
+int
+ccn_filewatch_process(struct ccn_filewatch *w,
+                      ccn_filewatch_handler *handler, void *data)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    union {
+        struct inotify_event ev;
+        char buf[16 * (sizeof(struct inotify_event) + NAME_MAX + 1)];
+    } u;
+    const struct inotify_event *ev;
+    struct pending *pe;
+    struct timeval now;
+    ssize_t res;
+    long quiet;
+    long busy;
+    long wait;
+    long next = -1;
+    size_t i;
+
+    if (w == NULL)
+        return(-1);
+    for (;;) {
+        res = read(w->fd, u.buf, sizeof(u.buf));
+        if (res <= 0)
+            break;
+        for (i = 0; i + sizeof(*ev) <= res; i += sizeof(*ev) + ev->len) {
+            ev = (const struct inotify_event *)(u.buf + i);
+            handle_event(w, ev);
+        }
+    }
+    if (w->overflowed) {
+        w->overflowed = 0;
+        rescan(w);
+    }
+    gettimeofday(&now, NULL);
+    hashtb_start(w->pending, e);
+    while (e->data != NULL) {
+        pe = e->data;
+        quiet = elapsed_us(&pe->last, &now);
+        busy = elapsed_us(&pe->first, &now);
+        if (quiet >= w->settle_us ||
+              busy >= (long)w->settle_us * MAX_SETTLE_FACTOR) {
+            if (handler != NULL)
+                (handler)(data, e->key, pe->kind);
+            hashtb_delete(e);
+            continue;
+        }
+        wait = w->settle_us - quiet;
+        if (wait > (long)w->settle_us * MAX_SETTLE_FACTOR - busy)
+            wait = (long)w->settle_us * MAX_SETTLE_FACTOR - busy;
+        if (next < 0 || wait < next)
+            next = wait;
+        hashtb_next(e);
+    }
+    hashtb_end(e);
+    return(next);
+}
+
+void
+ccn_filewatch_destroy(struct ccn_filewatch **wp)
+{
+    struct ccn_filewatch *w = *wp;
+
+    if (w == NULL)
+        return;
+    if (w->fd != -1)
+        close(w->fd);
+    hashtb_destroy(&w->watches);
+    hashtb_destroy(&w->pending);
+    ccn_charbuf_destroy(&w->path);
+    free(w);
+    *wp = NULL;
+}
+
+#else
+
+/* Only the inotify implementation exists so far */
+
+struct ccn_filewatch *
+ccn_filewatch_create(int settle_ms)
+{
+    errno = ENOSYS;
+    return(NULL);
+}
+
+int
+ccn_filewatch_add(struct ccn_filewatch *w, const char *path)
+{
+    errno = ENOSYS;
+    return(-1);
+}
+
+int
+ccn_filewatch_fd(struct ccn_filewatch *w)
+{
+    return(-1);
+}
+
+int
+ccn_filewatch_process(struct ccn_filewatch *w,
+                      ccn_filewatch_handler *handler, void *data)
+{
+    return(-1);
+}
+
+void
+ccn_filewatch_destroy(struct ccn_filewatch **wp)
+{
+    *wp = NULL;
+}
+
+#endif
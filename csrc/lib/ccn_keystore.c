@@ -22,9 +22,13 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <openssl/bn.h>
 #include <openssl/rsa.h>
+#ifndef OPENSSL_NO_EC
+#include <openssl/ec.h>
+#endif
 #include <openssl/evp.h>
 #include <openssl/x509v3.h>
 #include <openssl/pkcs12.h>
@@ -32,15 +36,26 @@
 #include <openssl/rand.h>
 
 #include <ccn/keystore.h>
+#include <ccn/signing.h>
+
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L && !defined(OPENSSL_NO_HMAC)
+#define CCN_HMAC_PKEY 1 /* EVP_PKEY_HMAC keys are available */
+#endif
+
+/* Shared secrets shorter than this are refused */
+#define CCN_MIN_SECRET_BYTES 16
+#define CCN_MAX_SECRET_BYTES 64
 
 struct ccn_keystore {
     int initialized;
+    int key_type;
     EVP_PKEY *private_key;
     EVP_PKEY *public_key;
     X509 *certificate;
     char *digest_algorithm;
     ssize_t pubkey_digest_length;
     unsigned char pubkey_digest[SHA256_DIGEST_LENGTH];
+    struct ccn_sigc *sigc;      /* kept for signing with private_key */
 };
 
 struct ccn_keystore *
@@ -62,6 +77,7 @@ ccn_keystore_destroy(struct ccn_keystore **p)
             X509_free((*p)->certificate);
         if ((*p)->digest_algorithm != NULL)
             free((*p)->digest_algorithm);
+        ccn_sigc_destroy(&(*p)->sigc);
         free(*p);
         *p = NULL;
     }
@@ -105,9 +121,17 @@ ccn_keystore_init(struct ccn_keystore *p, char *filename, char *password)
     switch (EVP_PKEY_type(p->private_key->type)) {
         case EVP_PKEY_DSA:
             digest_obj = OBJ_nid2obj(NID_sha1);
+            p->key_type = -1;
+            break;
+#ifndef OPENSSL_NO_EC
+        case EVP_PKEY_EC:
+            digest_obj = NULL;
+            p->key_type = CCN_KEYSTORE_KEY_EC;
             break;
+#endif
         default:
             digest_obj = NULL;
+            p->key_type = CCN_KEYSTORE_KEY_RSA;
     }
     if (digest_obj) {
         digest_size = 1 + OBJ_obj2txt(NULL, 0, digest_obj, 1);
@@ -121,6 +145,109 @@ ccn_keystore_init(struct ccn_keystore *p, char *filename, char *password)
     return (0);
 }
 
+/**
+ * Initialize a keystore with a shared secret for HMAC-SHA256 signing
+ *
+ * The file holds the raw bytes of the secret, which should be random.
+ * The SHA256 digest of the secret takes the place of the public key
+ * digest, identifying the key in the PublisherPublicKeyDigest of
+ * what it signs.  There is no public key or certificate.
+ * @param filename  the name of the file holding the secret.
+ * @returns 0 on success, -1 on failure
+ */
+int
+ccn_keystore_init_secret(struct ccn_keystore *p, char *filename)
+{
+#ifdef CCN_HMAC_PKEY
+    unsigned char secret[CCN_MAX_SECRET_BYTES + 1];
+    ASN1_OBJECT *digest_obj;
+    int digest_size;
+    ssize_t size;
+    int fd;
+
+    if (p->initialized)
+        return (-1);
+    fd = open(filename, O_RDONLY);
+    if (fd == -1)
+        return (-1);
+    size = read(fd, secret, sizeof(secret));
+    close(fd);
+    if (size < CCN_MIN_SECRET_BYTES || size > CCN_MAX_SECRET_BYTES) {
+        OPENSSL_cleanse(secret, sizeof(secret));
+        errno = EINVAL;
+        return (-1);
+    }
+    p->private_key = EVP_PKEY_new_mac_key(EVP_PKEY_HMAC, NULL, secret, size);
+    SHA256(secret, size, p->pubkey_digest);
+    OPENSSL_cleanse(secret, sizeof(secret));
+    if (p->private_key == NULL)
+        return (-1);
+    p->pubkey_digest_length = SHA256_DIGEST_LENGTH;
+    digest_obj = OBJ_nid2obj(NID_hmacWithSHA256);
+    digest_size = 1 + OBJ_obj2txt(NULL, 0, digest_obj, 1);
+    p->digest_algorithm = calloc(1, digest_size);
+    if (p->digest_algorithm == NULL)
+        return (-1);
+    OBJ_obj2txt(p->digest_algorithm, digest_size, digest_obj, 1);
+    p->key_type = CCN_KEYSTORE_KEY_HMAC;
+    p->initialized = 1;
+    return (0);
+#else
+    errno = ENOSYS;
+    return (-1);
+#endif
+}
+
+/**
+ * Create a file holding a new random shared secret
+ * @param filename  the name of the file to be created.
+ * @param keylength the number of bits in the secret.
+ *                  A value <= 0 will result in the default (256) being used.
+ * @returns 0 on success, -1 on failure
+ */
+int
+ccn_keystore_secret_file_init(char *filename, int keylength)
+{
+    unsigned char secret[CCN_MAX_SECRET_BYTES];
+    int size;
+    int fd;
+    int res;
+
+    if (keylength <= 0)
+        keylength = 256;
+    size = keylength / 8;
+    if (size < CCN_MIN_SECRET_BYTES || size > CCN_MAX_SECRET_BYTES ||
+          size * 8 != keylength) {
+        errno = EINVAL;
+        return (-1);
+    }
+    if (1 != RAND_bytes(secret, size))
+        return (-1);
+    fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0600);
+    if (fd == -1)
+        res = -1;
+    else {
+        res = (write(fd, secret, size) == size) ? 0 : -1;
+        if (close(fd) != 0)
+            res = -1;
+    }
+    OPENSSL_cleanse(secret, sizeof(secret));
+    return (res);
+}
+
+/**
+ * Report what kind of key the keystore holds
+ * @returns a ccn_keystore_key_type, or -1 for other key types
+ *          or if the keystore is not initialized.
+ */
+int
+ccn_keystore_key_type(struct ccn_keystore *p)
+{
+    if (0 == p->initialized)
+        return (-1);
+    return (p->key_type);
+}
+
 const struct ccn_pkey *
 ccn_keystore_private_key(struct ccn_keystore *p)
 {
@@ -170,6 +297,24 @@ ccn_keystore_certificate(struct ccn_keystore *p)
     return ((const void *)(p->certificate));
 }
 
+/**
+ * Get a signing context to use with this keystore's private key.
+ *
+ * The context is made on first use and kept until the keystore is
+ * destroyed, so signing many objects does not set one up each time.
+ * It must be initialized with ccn_sigc_init before each signature.
+ * @returns the context, or NULL if the keystore is not initialized.
+ */
+struct ccn_sigc *
+ccn_keystore_sigc(struct ccn_keystore *p)
+{
+    if (0 == p->initialized)
+        return (NULL);
+    if (p->sigc == NULL)
+        p->sigc = ccn_sigc_create();
+    return (p->sigc);
+}
+
 static int
 add_cert_extension_with_context(X509 *cert, int nid, char *value)
 {
@@ -198,7 +343,7 @@ add_cert_extension(X509 *cert, int nid, char *value)
     return(1);
 }
 /**
- * Create a PKCS12 keystore file
+ * Create a PKCS12 keystore file holding an RSA key
  * @param filename  the name of the keystore file to be created.
  * @param password  the import/export password for the keystore.
  * @param subject   the subject (and issuer) name in the certificate.
@@ -212,12 +357,88 @@ int
 ccn_keystore_file_init(char *filename, char *password,
                        char *subject, int keylength, int validity_days)
 {
-	RSA *rsa = RSA_new();
+    return(ccn_keystore_file_init_type(filename, password, subject,
+                                       CCN_KEYSTORE_KEY_RSA,
+                                       keylength, validity_days));
+}
+
+/**
+ * Generate an RSA key pair
+ * @returns 1 on success, 0 on failure
+ */
+static int
+generate_rsa_key(EVP_PKEY *pkey, int keylength)
+{
+    RSA *rsa = RSA_new();
     BIGNUM *pub_exp = BN_new();
+    int res = 0;
+    
+    if (rsa != NULL && pub_exp != NULL) {
+        BN_set_word(pub_exp, RSA_F4);
+        res = 1;
+        res &= RSA_generate_key_ex(rsa, keylength, pub_exp, NULL);
+        res &= EVP_PKEY_set1_RSA(pkey, rsa);
+    }
+    if (rsa != NULL)
+        RSA_free(rsa);
+    if (pub_exp != NULL)
+        BN_free(pub_exp);
+    return(res);
+}
+
+#ifndef OPENSSL_NO_EC
+/**
+ * Generate an EC key pair on the NIST P-256 curve
+ *
+ * The curve is recorded by name, so that the encoded public key
+ * (and hence the publisher key digest) stays short.
+ * @returns 1 on success, 0 on failure
+ */
+static int
+generate_ec_key(EVP_PKEY *pkey)
+{
+    EC_KEY *ec = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+    int res = 0;
+    
+    if (ec != NULL) {
+        EC_KEY_set_asn1_flag(ec, OPENSSL_EC_NAMED_CURVE);
+        res = 1;
+        res &= EC_KEY_generate_key(ec);
+        res &= EVP_PKEY_set1_EC_KEY(pkey, ec);
+        EC_KEY_free(ec);
+    }
+    return(res);
+}
+#endif
+
+/**
+ * Create a PKCS12 keystore file holding a key of the given type
+ *
+ * EC keys are much cheaper to sign with than RSA keys of comparable
+ * strength, though somewhat more expensive to verify.
+ * @param filename  the name of the keystore file to be created.
+ * @param password  the import/export password for the keystore.
+ * @param subject   the subject (and issuer) name in the certificate.
+ * @param key_type  the kind of key to generate.
+ * @param keylength the number of bits in the key to be generated.
+ *                  A value <= 0 will result in the default for the key type
+ *                  (1024 for RSA, 256 for EC) being used.
+ *                  EC keys must be 256 bits.
+ * @param validity_days the number of days the certificate in the keystore will
+ *                  be valid.  A value <= 0 will result in the default (30) being used.
+ * @returns 0 on success, -1 on failure
+ */
+int
+ccn_keystore_file_init_type(char *filename, char *password, char *subject,
+                            enum ccn_keystore_key_type key_type,
+                            int keylength, int validity_days)
+{
     EVP_PKEY *pkey = EVP_PKEY_new();
     X509 *cert = X509_new();
     X509_NAME *name = NULL;
     PKCS12 *pkcs12 = NULL;
+    const EVP_MD *cert_md = NULL;
+    char *key_usage = NULL;
     unsigned char spkid[SHA256_DIGEST_LENGTH];
     char spkid_hex[1 + 2 * SHA256_DIGEST_LENGTH];
     unsigned long serial = 0;
@@ -229,21 +450,42 @@ ccn_keystore_file_init(char *filename, char *password,
     int ans = -1;
     
     // Check whether initial allocations succeeded.
-    if (rsa == NULL || pub_exp == NULL || pkey == NULL || cert == NULL)
+    if (pkey == NULL || cert == NULL)
         goto Bail;
     
-    // Set up default values for keylength and expiration.
-    if (keylength <= 0)
-        keylength = 1024;
+    // Set up default values for expiration.
     if (validity_days <= 0)
         validity_days = 30;
     
     OpenSSL_add_all_algorithms();
     
-    BN_set_word(pub_exp, RSA_F4);
-    res = 1;
-    res &= RSA_generate_key_ex(rsa, keylength, pub_exp, NULL);
-    res &= EVP_PKEY_set1_RSA(pkey, rsa);
+    switch (key_type) {
+        case CCN_KEYSTORE_KEY_RSA:
+            if (keylength <= 0)
+                keylength = 1024;
+            res = generate_rsa_key(pkey, keylength);
+            key_usage = "digitalSignature,nonRepudiation,keyEncipherment,dataEncipherment,keyAgreement";
+            cert_md = EVP_sha1();
+            break;
+#ifndef OPENSSL_NO_EC
+        case CCN_KEYSTORE_KEY_EC:
+            if (keylength > 0 && keylength != 256) {
+                errno = EINVAL;
+                goto Bail;
+            }
+            res = generate_ec_key(pkey);
+            key_usage = "digitalSignature,nonRepudiation,keyAgreement";
+#if OPENSSL_VERSION_NUMBER < 0x10000000L
+            cert_md = EVP_ecdsa();
+#else
+            cert_md = EVP_sha256();
+#endif
+            break;
+#endif
+        default:
+            errno = EINVAL;
+            goto Bail;
+    }
     res &= X509_set_version(cert, 2);       // 2 => X509v3
 	if (res == 0)
         goto Bail;
@@ -271,7 +513,7 @@ ccn_keystore_file_init(char *filename, char *password,
     
     // Add the necessary extensions.
     res &= add_cert_extension(cert, NID_basic_constraints, "critical,CA:FALSE");
-    res &= add_cert_extension(cert, NID_key_usage, "digitalSignature,nonRepudiation,keyEncipherment,dataEncipherment,keyAgreement");
+    res &= add_cert_extension(cert, NID_key_usage, key_usage);
     res &= add_cert_extension(cert, NID_ext_key_usage, "clientAuth");
     
     if (res == 0)
@@ -296,7 +538,7 @@ ccn_keystore_file_init(char *filename, char *password,
         goto Bail;
     
     // The certificate is complete, sign it.
-    res = X509_sign(cert, pkey, EVP_sha1());
+    res = X509_sign(cert, pkey, cert_md);
     if (res == 0)
         goto Bail;
 
@@ -332,14 +574,6 @@ Bail:
         EVP_PKEY_free(pkey);
         pkey = NULL;
     }
-    if (rsa != NULL) {
-        RSA_free(rsa);
-        rsa = NULL;
-    }
-    if (pub_exp != NULL){
-        BN_free(pub_exp);
-        pub_exp = NULL;
-    }
     if (cert != NULL) {
         X509_free(cert);
         cert = NULL;
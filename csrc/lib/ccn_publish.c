@@ -0,0 +1,734 @@
+/**
+ * @file ccn_publish.c
+ * @brief Publish files as segmented content, signing in parallel.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/digest.h>
+#include <ccn/hashtb.h>
+#include <ccn/indexbuf.h>
+#include <ccn/publish.h>
+
+/*
+ * Signing is the bottleneck when publishing, so the segments of each file
+ * are divided among forked worker processes, worker k taking segments
+ * k, k + workers, k + 2 * workers, ...  Each worker appends the signed
+ * segments to its own spool file and records where each one landed in a
+ * table that is shared with the parent, so nothing needs to be passed
+ * back once the workers are done.  Interests are answered by reading
+ * the segment back from the spool.
+ *
+ * When a file is replaced or removed its segments become dead space in
+ * the spools.  Once more than half of a spool is dead, the live segments
+ * are copied to a fresh spool and the old one is closed, which gives the
+ * space back.
+ *
+ * Files published with ccn_publisher_update_file() also have an entry
+ * in the latest table, keyed by the unversioned name, which holds the
+ * versioned name and a digest of the content that went into it.
+ */
+
+struct segment {
+    off_t offset;               /* where it is in its spool file */
+    size_t size;                /* size of the signed ContentObject */
+};
+
+struct published_file { /* keyed by the name components */
+    struct segment *segs;       /* shared with the workers, via mmap */
+    uintmax_t nseg;
+};
+
+#define CONTENT_DIGEST_SIZE 32
+
+struct latest_version { /* keyed by the unversioned name components */
+    struct ccn_charbuf *vname;  /* the name with its version */
+    unsigned char digest[CONTENT_DIGEST_SIZE];
+};
+
+struct ccn_publisher {
+    struct ccn_closure cl;
+    struct ccn *h;
+    struct ccn_charbuf *prefix;
+    struct ccn_signing_params sp;
+    struct hashtb *files;
+    struct hashtb *latest;
+    struct ccn_charbuf *buf;    /* for reading segments back */
+    int *spool;                 /* file descriptor per worker */
+    off_t *dead;                /* bytes no longer referenced, per spool */
+    int blocksize;
+    int workers;
+    struct ccn_publisher_stats stats;
+};
+
+static void
+finalize_published_file(struct hashtb_enumerator *e)
+{
+    struct ccn_publisher *p = hashtb_get_param(e->ht, NULL);
+    struct published_file *f = e->data;
+    uintmax_t s;
+
+    if (f->segs != NULL && p->dead != NULL)
+        for (s = 0; s < f->nseg; s++)
+            p->dead[s % p->workers] += f->segs[s].size;
+    if (f->segs != NULL)
+        munmap(f->segs, f->nseg * sizeof(f->segs[0]));
+    f->segs = NULL;
+}
+
+static void
+finalize_latest_version(struct hashtb_enumerator *e)
+{
+    struct latest_version *v = e->data;
+
+    ccn_charbuf_destroy(&v->vname);
+}
+
+static int
+open_spool(void)
+{
+    char path[256];
+    const char *dir = getenv("TMPDIR");
+    int fd;
+
+    if (dir == NULL || dir[0] == 0)
+        dir = "/tmp";
+    snprintf(path, sizeof(path), "%s/ccnpublish.XXXXXX", dir);
+    fd = mkstemp(path);
+    if (fd != -1)
+        unlink(path);
+    return(fd);
+}
+
+static int
+write_full(int fd, const unsigned char *buf, size_t size)
+{
+    ssize_t res;
+    size_t i;
+
+    for (i = 0; i < size; i += res) {
+        res = write(fd, buf + i, size - i);
+        if (res == -1) {
+            if (errno == EINTR)
+                res = 0;
+            else
+                return(-1);
+        }
+    }
+    return(0);
+}
+
+static ssize_t
+pread_full(int fd, unsigned char *buf, size_t size, off_t offset)
+{
+    ssize_t res;
+    size_t i;
+
+    for (i = 0; i < size; i += res) {
+        res = pread(fd, buf + i, size - i, offset + i);
+        if (res == -1) {
+            if (errno == EINTR)
+                res = 0;
+            else
+                return(-1);
+        }
+        else if (res == 0)
+            break;
+    }
+    return(i);
+}
+
+/**
+ * Copy the live segments of spool k to a fresh spool, dropping the dead ones.
+ *
+ * The new offsets follow from the segment sizes, so they are only
+ * stored once the copy has succeeded; on failure the old spool stays.
+ * @returns 0 for success, -1 for failure.
+ */
+static int
+compact_spool(struct ccn_publisher *p, int k)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct published_file *f = NULL;
+    unsigned char *buf = NULL;
+    off_t end = 0;
+    uintmax_t s;
+    int fd;
+    int res = 0;
+
+    fd = open_spool();
+    if (fd == -1)
+        return(-1);
+    for (hashtb_start(p->files, e); res == 0 && e->data != NULL; hashtb_next(e)) {
+        f = e->data;
+        for (s = k; res == 0 && s < f->nseg; s += p->workers) {
+            ccn_charbuf_reset(p->buf);
+            buf = ccn_charbuf_reserve(p->buf, f->segs[s].size);
+            if (buf == NULL ||
+                pread_full(p->spool[k], buf, f->segs[s].size,
+                           f->segs[s].offset) != f->segs[s].size ||
+                write_full(fd, buf, f->segs[s].size) < 0)
+                res = -1;
+        }
+    }
+    hashtb_end(e);
+    if (res < 0) {
+        close(fd);
+        return(-1);
+    }
+    for (hashtb_start(p->files, e); e->data != NULL; hashtb_next(e)) {
+        f = e->data;
+        for (s = k; s < f->nseg; s += p->workers) {
+            f->segs[s].offset = end;
+            end += f->segs[s].size;
+        }
+    }
+    hashtb_end(e);
+    close(p->spool[k]);
+    p->spool[k] = fd;
+    p->dead[k] = 0;
+    return(0);
+}
+
+/**
+ * Compact any spool that has become more dead than live.
+ */
+static void
+reclaim_spools(struct ccn_publisher *p)
+{
+    off_t size;
+    int k;
+
+    for (k = 0; k < p->workers; k++) {
+        if (p->dead[k] == 0)
+            continue;
+        size = lseek(p->spool[k], 0, SEEK_END);
+        if (size == (off_t)-1 || p->dead[k] * 2 < size)
+            continue;
+        if (p->dead[k] >= size) {
+            /* Nothing live, so no need for a copy */
+            if (ftruncate(p->spool[k], 0) == 0)
+                p->dead[k] = 0;
+        }
+        else
+            compact_spool(p, k);
+    }
+}
+
+/**
+ * Sign every n-th segment of a file, starting with segment k.
+ *
+ * This is the work done by worker k.
+ * @returns 0 for success, -1 for failure.
+ */
+static int
+sign_segments(struct ccn_publisher *p, int fd, struct ccn_charbuf *name,
+              struct segment *segs, uintmax_t nseg, int k, int n)
+{
+    struct ccn_signing_params sp = p->sp;
+    struct ccn_charbuf *segname = ccn_charbuf_create();
+    struct ccn_charbuf *cob = ccn_charbuf_create();
+    unsigned char *buf = malloc(p->blocksize);
+    int spool = p->spool[k];
+    off_t end;
+    ssize_t got;
+    uintmax_t s;
+    int res = -1;
+
+    end = lseek(spool, 0, SEEK_END);
+    if (buf == NULL || end == (off_t)-1)
+        goto Bail;
+    for (s = k; s < nseg; s += n) {
+        got = pread_full(fd, buf, p->blocksize, (off_t)s * p->blocksize);
+        if (got < 0)
+            goto Bail;
+        ccn_charbuf_reset(segname);
+        ccn_charbuf_append_charbuf(segname, name);
+        ccn_name_append_numeric(segname, CCN_MARKER_SEQNUM, s);
+        sp.sp_flags = p->sp.sp_flags;
+        /* Put the key locator in the first segment only */
+        if (s > 0)
+            sp.sp_flags |= CCN_SP_OMIT_KEY_LOCATOR;
+        if (s + 1 == nseg)
+            sp.sp_flags |= CCN_SP_FINAL_BLOCK;
+        ccn_charbuf_reset(cob);
+        if (ccn_sign_content(p->h, cob, segname, &sp, buf, got) != 0)
+            goto Bail;
+        if (write_full(spool, cob->buf, cob->length) < 0)
+            goto Bail;
+        segs[s].offset = end;
+        segs[s].size = cob->length;
+        end += cob->length;
+    }
+    res = 0;
+Bail:
+    free(buf);
+    ccn_charbuf_destroy(&cob);
+    ccn_charbuf_destroy(&segname);
+    return(res);
+}
+
+/**
+ * Get the table key for a name, which is its components
+ * without the enclosing Name element.
+ */
+static int
+name_key(struct ccn_charbuf *name, const unsigned char **keyp, size_t *sizep)
+{
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+
+    d = ccn_buf_decoder_start(&decoder, name->buf, name->length);
+    if (!ccn_buf_match_dtag(d, CCN_DTAG_Name))
+        return(-1);
+    ccn_buf_advance(d);
+    if (d->decoder.state < 0 || d->decoder.token_index + 1 > name->length)
+        return(-1);
+    *keyp = name->buf + d->decoder.token_index;
+    *sizep = name->length - 1 - d->decoder.token_index;
+    return(0);
+}
+
+static struct published_file *
+lookup_file(struct ccn_publisher *p, struct ccn_charbuf *name)
+{
+    const unsigned char *key = NULL;
+    size_t size = 0;
+
+    if (name_key(name, &key, &size) < 0)
+        return(NULL);
+    return(hashtb_lookup(p->files, key, size));
+}
+
+/**
+ * Find the segment an interest is asking for, if it is one of ours.
+ *
+ * The interest may name a segment, or the file itself, which
+ * is taken as asking for the first segment.
+ */
+static struct segment *
+lookup_segment(struct ccn_publisher *p, struct ccn_upcall_info *info,
+               int *spoolp)
+{
+    struct ccn_indexbuf *comps = info->interest_comps;
+    const unsigned char *key = info->interest_ccnb + comps->buf[0];
+    struct published_file *f = NULL;
+    const unsigned char *comp = NULL;
+    size_t comp_size = 0;
+    uintmax_t s = 0;
+    size_t i;
+    int n = comps->n - 1;
+
+    f = hashtb_lookup(p->files, key, comps->buf[n] - comps->buf[0]);
+    if (f == NULL) {
+        /* The unversioned name gets the latest version */
+        struct latest_version *v;
+        v = hashtb_lookup(p->latest, key, comps->buf[n] - comps->buf[0]);
+        if (v != NULL)
+            f = lookup_file(p, v->vname);
+    }
+    if (f == NULL && n >= 1) {
+        if (ccn_name_comp_get(info->interest_ccnb, comps, n - 1,
+                              &comp, &comp_size) != 0 ||
+            comp_size < 1 || comp[0] != CCN_MARKER_SEQNUM ||
+            comp_size > 1 + sizeof(s))
+            return(NULL);
+        for (i = 1; i < comp_size; i++)
+            s = (s << 8) + comp[i];
+        f = hashtb_lookup(p->files, key, comps->buf[n - 1] - comps->buf[0]);
+    }
+    if (f == NULL || s >= f->nseg)
+        return(NULL);
+    *spoolp = p->spool[s % p->workers];
+    return(&f->segs[s]);
+}
+
+static enum ccn_upcall_res
+incoming_interest(struct ccn_closure *selfp,
+                  enum ccn_upcall_kind kind,
+                  struct ccn_upcall_info *info)
+{
+    struct ccn_publisher *p = selfp->data;
+    struct segment *seg = NULL;
+    unsigned char *buf = NULL;
+    int spool = -1;
+
+    if (kind == CCN_UPCALL_FINAL)
+        return(CCN_UPCALL_RESULT_OK);
+    if (kind != CCN_UPCALL_INTEREST || p == NULL)
+        return(CCN_UPCALL_RESULT_OK);
+    seg = lookup_segment(p, info, &spool);
+    if (seg == NULL)
+        return(CCN_UPCALL_RESULT_OK);
+    ccn_charbuf_reset(p->buf);
+    buf = ccn_charbuf_reserve(p->buf, seg->size);
+    if (buf == NULL || pread_full(spool, buf, seg->size, seg->offset) != seg->size)
+        return(CCN_UPCALL_RESULT_ERR);
+    p->buf->length = seg->size;
+    if (!ccn_content_matches_interest(p->buf->buf, p->buf->length, 1, NULL,
+                                      info->interest_ccnb,
+                                      info->pi->offset[CCN_PI_E], info->pi))
+        return(CCN_UPCALL_RESULT_OK);
+    if (ccn_put(info->h, p->buf->buf, p->buf->length) < 0)
+        return(CCN_UPCALL_RESULT_ERR);
+    p->stats.served++;
+    return(CCN_UPCALL_RESULT_INTEREST_CONSUMED);
+}
+
+struct ccn_publisher *
+ccn_publisher_create(struct ccn *h, struct ccn_charbuf *prefix,
+                     const struct ccn_signing_params *params,
+                     int blocksize, int workers)
+{
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct hashtb_param param = {0};
+    struct ccn_publisher *p = NULL;
+    int i;
+
+    if (h == NULL || prefix == NULL ||
+        blocksize <= 0 || blocksize > CCN_PUBLISH_MAX_BLOCKSIZE ||
+        workers <= 0 || workers > CCN_PUBLISH_MAX_WORKERS)
+        return(NULL);
+    if (params != NULL)
+        sp = *params;
+    /* The workers inherit the key, so get it loaded before they start */
+    if (ccn_get_public_key(h, &sp, NULL, NULL) < 0)
+        return(NULL);
+    p = calloc(1, sizeof(*p));
+    if (p == NULL)
+        return(NULL);
+    p->cl.p = &incoming_interest;
+    p->cl.data = p;
+    p->h = h;
+    p->sp = sp;
+    p->sp.sp_flags &= ~(CCN_SP_FINAL_BLOCK | CCN_SP_OMIT_KEY_LOCATOR);
+    p->sp.template_ccnb = NULL;
+    if (sp.template_ccnb != NULL) {
+        p->sp.template_ccnb = ccn_charbuf_create();
+        ccn_charbuf_append_charbuf(p->sp.template_ccnb, sp.template_ccnb);
+    }
+    p->prefix = ccn_charbuf_create();
+    ccn_charbuf_append_charbuf(p->prefix, prefix);
+    param.finalize = &finalize_published_file;
+    param.finalize_data = p;
+    p->files = hashtb_create(sizeof(struct published_file), &param);
+    param.finalize = &finalize_latest_version;
+    param.finalize_data = NULL;
+    p->latest = hashtb_create(sizeof(struct latest_version), &param);
+    p->buf = ccn_charbuf_create();
+    p->blocksize = blocksize;
+    p->workers = workers;
+    p->spool = calloc(workers, sizeof(p->spool[0]));
+    p->dead = calloc(workers, sizeof(p->dead[0]));
+    for (i = 0; p->spool != NULL && i < workers; i++)
+        p->spool[i] = -1;
+    for (i = 0; p->spool != NULL && i < workers; i++) {
+        p->spool[i] = open_spool();
+        if (p->spool[i] == -1)
+            break;
+    }
+    if (p->spool == NULL || p->dead == NULL || i < workers ||
+        ccn_set_interest_filter(h, p->prefix, &p->cl) < 0) {
+        ccn_publisher_destroy(&p);
+        return(NULL);
+    }
+    return(p);
+}
+
+/**
+ * Segment, sign, and index a file.
+ *
+ * An existing file of the same name is replaced.
+ * @returns the number of segments, or -1 for an error.
+ */
+int
+ccn_publisher_add_file(struct ccn_publisher *p, struct ccn_charbuf *name,
+                       const char *path)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ccn_indexbuf *comps = NULL;
+    struct published_file *f = NULL;
+    struct segment *segs = NULL;
+    struct stat statbuf;
+    uintmax_t nseg;
+    pid_t pid[CCN_PUBLISH_MAX_WORKERS];
+    off_t end[CCN_PUBLISH_MAX_WORKERS];
+    int n = 0;
+    int status;
+    int reclaim = 0;
+    int fd = -1;
+    int res = -1;
+    int i;
+
+    if (p == NULL || name == NULL || path == NULL)
+        return(-1);
+    for (i = 0; i < CCN_PUBLISH_MAX_WORKERS; i++)
+        end[i] = -1;
+    fd = open(path, O_RDONLY);
+    if (fd == -1 || fstat(fd, &statbuf) == -1)
+        goto Bail;
+    nseg = (statbuf.st_size + p->blocksize - 1) / p->blocksize;
+    if (nseg == 0)
+        nseg = 1; /* an empty file still gets a segment */
+    segs = mmap(NULL, nseg * sizeof(segs[0]), PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_ANON, -1, 0);
+    if (segs == MAP_FAILED) {
+        segs = NULL;
+        goto Bail;
+    }
+    /* So that a failure does not leave partial work in the spools */
+    for (i = 0; i < p->workers; i++) {
+        end[i] = lseek(p->spool[i], 0, SEEK_END);
+        if (end[i] == (off_t)-1)
+            goto Bail;
+    }
+    if (p->workers == 1 || nseg == 1)
+        res = sign_segments(p, fd, name, segs, nseg, 0, 1);
+    else {
+        res = 0;
+        /* A worker that signs through the agent reconnects on its own */
+        for (n = 0; n < p->workers && n < nseg; n++) {
+            pid[n] = fork();
+            if (pid[n] == 0)
+                _exit(sign_segments(p, fd, name, segs, nseg, n, p->workers) == 0 ? 0 : 1);
+            if (pid[n] == -1)
+                break;
+        }
+        for (i = 0; i < n; i++) {
+            while (waitpid(pid[i], &status, 0) == -1 && errno == EINTR)
+                continue;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                res = -1;
+        }
+        if (n < p->workers && n < nseg)
+            res = -1; /* some segments were not signed */
+    }
+    if (res < 0)
+        goto Bail;
+    comps = ccn_indexbuf_create();
+    if (ccn_name_split(name, comps) < 0) {
+        res = -1;
+        goto Bail;
+    }
+    hashtb_start(p->files, e);
+    res = hashtb_seek(e, name->buf + comps->buf[0],
+                      comps->buf[comps->n - 1] - comps->buf[0], 0);
+    if (res >= 0) {
+        f = e->data;
+        if (res == HT_OLD_ENTRY) {
+            finalize_published_file(e);
+            reclaim = 1;
+        }
+        f->segs = segs;
+        f->nseg = nseg;
+        segs = NULL;
+        p->stats.files++;
+        p->stats.segments += nseg;
+        p->stats.bytes += statbuf.st_size;
+        res = nseg;
+    }
+    hashtb_end(e);
+    if (reclaim)
+        reclaim_spools(p);
+Bail:
+    if (segs != NULL) {
+        munmap(segs, nseg * sizeof(segs[0]));
+        for (i = 0; i < p->workers; i++)
+            if (end[i] != (off_t)-1 && ftruncate(p->spool[i], end[i]) == -1)
+                res = -1;
+    }
+    if (fd != -1)
+        close(fd);
+    ccn_indexbuf_destroy(&comps);
+    return(res);
+}
+
+/**
+ * Compute the digest of a file's content.
+ * @returns 0 for success, -1 for failure.
+ */
+static int
+file_digest(const char *path, unsigned char *digest)
+{
+    struct ccn_digest *dg = NULL;
+    unsigned char buf[8192];
+    ssize_t got;
+    int fd;
+    int res = -1;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1)
+        return(-1);
+    dg = ccn_digest_create(CCN_DIGEST_SHA256);
+    if (dg == NULL || ccn_digest_size(dg) != CONTENT_DIGEST_SIZE)
+        goto Bail;
+    ccn_digest_init(dg);
+    while ((got = read(fd, buf, sizeof(buf))) != 0) {
+        if (got == -1) {
+            if (errno == EINTR)
+                continue;
+            goto Bail;
+        }
+        if (ccn_digest_update(dg, buf, got) < 0)
+            goto Bail;
+    }
+    if (ccn_digest_final(dg, digest, CONTENT_DIGEST_SIZE) < 0)
+        goto Bail;
+    res = 0;
+Bail:
+    ccn_digest_destroy(&dg);
+    close(fd);
+    return(res);
+}
+
+static void
+drop_file(struct ccn_publisher *p, struct ccn_charbuf *name)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    const unsigned char *key = NULL;
+    size_t size = 0;
+
+    if (name_key(name, &key, &size) < 0 ||
+        hashtb_lookup(p->files, key, size) == NULL)
+        return;
+    hashtb_start(p->files, e);
+    if (hashtb_seek(e, key, size, 0) == HT_OLD_ENTRY)
+        hashtb_delete(e);
+    hashtb_end(e);
+    reclaim_spools(p);
+}
+
+int
+ccn_publisher_update_file(struct ccn_publisher *p, struct ccn_charbuf *name,
+                          const char *path)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct latest_version *v = NULL;
+    struct ccn_charbuf *vname = NULL;
+    const unsigned char *key = NULL;
+    unsigned char digest[CONTENT_DIGEST_SIZE];
+    size_t size = 0;
+    int res;
+
+    if (p == NULL || name == NULL || path == NULL)
+        return(-1);
+    if (name_key(name, &key, &size) < 0 || file_digest(path, digest) < 0)
+        return(-1);
+    v = hashtb_lookup(p->latest, key, size);
+    if (v != NULL && memcmp(v->digest, digest, sizeof(digest)) == 0) {
+        p->stats.unchanged++;
+        return(0);
+    }
+    vname = ccn_charbuf_create();
+    ccn_charbuf_append_charbuf(vname, name);
+    res = ccn_create_version(p->h, vname, CCN_V_NOW, 0, 0);
+    if (res >= 0)
+        res = ccn_publisher_add_file(p, vname, path);
+    if (res < 0) {
+        ccn_charbuf_destroy(&vname);
+        return(-1);
+    }
+    hashtb_start(p->latest, e);
+    if (hashtb_seek(e, key, size, 0) >= 0) {
+        v = e->data;
+        if (v->vname != NULL)
+            drop_file(p, v->vname);
+        ccn_charbuf_destroy(&v->vname);
+        v->vname = vname;
+        vname = NULL;
+        memcpy(v->digest, digest, sizeof(digest));
+    }
+    else
+        res = -1;
+    hashtb_end(e);
+    ccn_charbuf_destroy(&vname);
+    return(res);
+}
+
+int
+ccn_publisher_remove_file(struct ccn_publisher *p, struct ccn_charbuf *name)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct latest_version *v = NULL;
+    const unsigned char *key = NULL;
+    size_t size = 0;
+
+    if (p == NULL || name == NULL || name_key(name, &key, &size) < 0)
+        return(-1);
+    v = hashtb_lookup(p->latest, key, size);
+    if (v == NULL)
+        return(-1);
+    if (v->vname != NULL)
+        drop_file(p, v->vname);
+    hashtb_start(p->latest, e);
+    if (hashtb_seek(e, key, size, 0) == HT_OLD_ENTRY)
+        hashtb_delete(e);
+    hashtb_end(e);
+    return(0);
+}
+
+int
+ccn_publisher_get_stats(struct ccn_publisher *p,
+                        struct ccn_publisher_stats *stats)
+{
+    if (p == NULL || stats == NULL)
+        return(-1);
+    *stats = p->stats;
+    return(0);
+}
+
+void
+ccn_publisher_destroy(struct ccn_publisher **pp)
+{
+    struct ccn_publisher *p = *pp;
+    int i;
+
+    if (p == NULL)
+        return;
+    if (p->h != NULL && p->prefix != NULL)
+        ccn_set_interest_filter(p->h, p->prefix, NULL);
+    for (i = 0; p->spool != NULL && i < p->workers; i++)
+        if (p->spool[i] != -1)
+            close(p->spool[i]);
+    free(p->spool);
+    hashtb_destroy(&p->latest);
+    hashtb_destroy(&p->files);
+    free(p->dead);
+    ccn_charbuf_destroy(&p->buf);
+    ccn_charbuf_destroy(&p->prefix);
+    ccn_charbuf_destroy(&p->sp.template_ccnb);
+    free(p);
+    *pp = NULL;
+}
@@ -22,10 +22,13 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
+#include <string.h>
 #include <ccn/ccn.h>
 #include <ccn/seqwriter.h>
 
 #define MAX_DATA_SIZE 4096
+#define DEFAULT_WINDOW 8
+#define MAX_WINDOW 256
 
 struct ccn_seqwriter {
     struct ccn_closure cl;
@@ -34,7 +37,11 @@ struct ccn_seqwriter {
     struct ccn_charbuf *nv;
     struct ccn_charbuf *buffer;
     struct ccn_charbuf *cob0;
-    uintmax_t seqnum;
+    struct ccn_charbuf **ready; /* signed segments not yet sent, by seqnum */
+    uintmax_t seqnum;           /* seqnum of the data in buffer */
+    uintmax_t base;             /* lowest seqnum that may be in ready */
+    uintmax_t asked;            /* one past the highest seqnum asked for */
+    int window;                 /* capacity of ready */
     int batching;
     int blockminsize;
     int blockmaxsize;
@@ -64,6 +71,164 @@ seqw_next_cob(struct ccn_seqwriter *w)
     return(cob);
 }
 
+/**
+ * Sign the buffered data ahead of demand, if there is room in the window.
+ *
+ * The signed segment is held until an interest asks for it, so the
+ * signing is done by the writer rather than on the interest's round trip.
+ * @returns 0 if the buffer was signed and emptied, -1 if not.
+ */
+static int
+seqw_presign(struct ccn_seqwriter *w)
+{
+    struct ccn_charbuf *cob = NULL;
+    
+    if (w->ready == NULL || w->seqnum - w->base >= w->window)
+        return(-1);
+    cob = seqw_next_cob(w);
+    if (cob == NULL)
+        return(-1);
+    w->ready[w->seqnum % w->window] = cob;
+    w->buffer->length = 0;
+    w->seqnum++;
+    return(0);
+}
+
+/**
+ * Note that a segment has been sent.
+ *
+ * Segment 0 is kept for answering later interests for the stream;
+ * others are left to the content store.
+ */
+static void
+seqw_sent(struct ccn_seqwriter *w, uintmax_t seqnum, struct ccn_charbuf *cob)
+{
+    if (seqnum == 0 && w->cob0 == NULL)
+        w->cob0 = cob;
+    else
+        ccn_charbuf_destroy(&cob);
+    if (w->ready == NULL) {
+        w->base = w->seqnum;
+        return;
+    }
+    while (w->base < w->seqnum && w->ready[w->base % w->window] == NULL)
+        w->base++;
+}
+
+/**
+ * Find out which segment of the stream an interest asks for.
+ *
+ * This is done from the interest's name alone, so that an interest for
+ * some other segment does not cost a signature to find out.
+ * @returns 1, with *seqnum set, if the interest names a segment of this
+ *          version; 0 if it names a prefix of the version, so it might
+ *          match any segment; -1 if it cannot match anything we write.
+ */
+static int
+seqw_interest_seqnum(struct ccn_seqwriter *w, struct ccn_upcall_info *info,
+                     uintmax_t *seqnum)
+{
+    struct ccn_indexbuf *nix = ccn_indexbuf_create();
+    struct ccn_indexbuf *comps = info->interest_comps;
+    const unsigned char *p = NULL;
+    size_t size = 0;
+    size_t i;
+    int m = info->pi->prefix_comps;
+    int n;
+    int k;
+    int res = -1;
+    
+    n = ccn_name_split(w->nv, nix);
+    if (n < 0)
+        goto Finish;
+    k = (m < n) ? m : n;
+    if (comps->buf[k] - comps->buf[0] != nix->buf[k] - nix->buf[0] ||
+        memcmp(info->interest_ccnb + comps->buf[0], w->nv->buf + nix->buf[0],
+               nix->buf[k] - nix->buf[0]) != 0)
+        goto Finish;
+    if (m <= n) {
+        res = 0;
+        goto Finish;
+    }
+    ccn_name_comp_get(info->interest_ccnb, comps, n, &p, &size);
+    if (size < 1 || size > 1 + sizeof(*seqnum) || p[0] != CCN_MARKER_SEQNUM)
+        goto Finish;
+    for (*seqnum = 0, i = 1; i < size; i++)
+        *seqnum = (*seqnum << 8) + p[i];
+    res = 1;
+Finish:
+    ccn_indexbuf_destroy(&nix);
+    return(res);
+}
+
+/**
+ * Send a ready segment, if any matches the interest.
+ * @returns 1 if a segment was sent, 0 if not.
+ */
+static int
+seqw_answer_from_ready(struct ccn_seqwriter *w, struct ccn_upcall_info *info)
+{
+    struct ccn_charbuf *cob = NULL;
+    uintmax_t s;
+    int res;
+    
+    if (w->ready == NULL)
+        return(0);
+    for (s = w->base; s < w->seqnum; s++) {
+        cob = w->ready[s % w->window];
+        if (cob == NULL)
+            continue;
+        if (ccn_content_matches_interest(cob->buf, cob->length,
+                                         1, NULL,
+                                         info->interest_ccnb,
+                                         info->pi->offset[CCN_PI_E],
+                                         info->pi)) {
+            res = ccn_put(info->h, cob->buf, cob->length);
+            if (res < 0)
+                return(0);
+            w->ready[s % w->window] = NULL;
+            seqw_sent(w, s, cob);
+            return(1);
+        }
+    }
+    return(0);
+}
+
+/**
+ * Send all the ready segments, whether or not they have been asked for.
+ */
+static void
+seqw_flush_ready(struct ccn_seqwriter *w)
+{
+    struct ccn_charbuf *cob = NULL;
+    uintmax_t s;
+    
+    if (w->ready == NULL)
+        return;
+    for (s = w->base; s < w->seqnum; s++) {
+        cob = w->ready[s % w->window];
+        if (cob == NULL)
+            continue;
+        if (ccn_put(w->h, cob->buf, cob->length) < 0)
+            break;
+        w->ready[s % w->window] = NULL;
+        seqw_sent(w, s, cob);
+    }
+}
+
+static void
+seqw_destroy_ready(struct ccn_seqwriter *w)
+{
+    int i;
+    
+    if (w->ready == NULL)
+        return;
+    for (i = 0; i < w->window; i++)
+        ccn_charbuf_destroy(&w->ready[i]);
+    free(w->ready);
+    w->ready = NULL;
+}
+
 static enum ccn_upcall_res
 seqw_incoming_interest(
                        struct ccn_closure *selfp,
@@ -73,6 +238,7 @@ seqw_incoming_interest(
     int res;
     struct ccn_charbuf *cob = NULL;
     struct ccn_seqwriter *w = selfp->data;
+    uintmax_t seqnum = 0;
     
     if (w == NULL || selfp != &(w->cl))
         abort();
@@ -82,10 +248,22 @@ seqw_incoming_interest(
             ccn_charbuf_destroy(&w->nv);
             ccn_charbuf_destroy(&w->buffer);
             ccn_charbuf_destroy(&w->cob0);
+            seqw_destroy_ready(w);
             free(w);
             break;
         case CCN_UPCALL_INTEREST:
-            if (w->closed || w->buffer->length > w->blockminsize) {
+            if (seqw_answer_from_ready(w, info)) {
+                w->interests_possibly_pending = (w->seqnum < w->asked);
+                return(CCN_UPCALL_RESULT_INTEREST_CONSUMED);
+            }
+            res = seqw_interest_seqnum(w, info, &seqnum);
+            if (res < 0)
+                break;
+            /* Remember it, since it will not be delivered again */
+            if (res == 1 && seqnum >= w->asked)
+                w->asked = seqnum + 1;
+            if ((w->closed || w->buffer->length > w->blockminsize) &&
+                (res == 0 || seqnum == w->seqnum)) {
                 cob = seqw_next_cob(w);
                 if (cob == NULL)
                     return(CCN_UPCALL_RESULT_OK);
@@ -94,11 +272,12 @@ seqw_incoming_interest(
                                                  info->interest_ccnb,
                                                  info->pi->offset[CCN_PI_E],
                                                  info->pi)) {
-                    w->interests_possibly_pending = 0;
                     res = ccn_put(info->h, cob->buf, cob->length);
                     if (res >= 0) {
                         w->buffer->length = 0;
                         w->seqnum++;
+                        w->interests_possibly_pending = (w->seqnum < w->asked);
+                        seqw_sent(w, w->seqnum - 1, cob);
                         return(CCN_UPCALL_RESULT_INTEREST_CONSUMED);
                     }
                 }
@@ -165,11 +344,14 @@ ccn_seqw_create(struct ccn *h, struct ccn_charbuf *name)
     w->blockminsize = 0;
     w->blockmaxsize = MAX_DATA_SIZE;
     w->freshness = -1;
+    w->window = DEFAULT_WINDOW;
+    w->ready = calloc(w->window, sizeof(w->ready[0]));
     res = ccn_set_interest_filter(h, nb, &(w->cl));
     if (res < 0) {
         ccn_charbuf_destroy(&w->nb);
         ccn_charbuf_destroy(&w->nv);
         ccn_charbuf_destroy(&w->buffer);
+        free(w->ready);
         free(w);
         return(NULL);
     }
@@ -197,8 +379,10 @@ ccn_seqw_get_name(struct ccn_seqwriter *w, struct ccn_charbuf *nv)
  *
  * This is roughly analogous to a write(2) call in non-blocking mode.
  *
+ * When the current buffer fills, it is signed ahead of demand and held
+ * in a window of ready segments (see ccn_seqw_set_window()).
  * The current implementation returns an error and refuses the new data if
- * it does not fit in the current buffer.
+ * it does not fit in the current buffer and the window is full.
  * That is, there are no partial writes.
  * In this case, the caller should ccn_run() for a little while and retry.
  * 
@@ -220,10 +404,16 @@ ccn_seqw_write(struct ccn_seqwriter *w, const void *buf, size_t size)
     if (w->buffer == NULL || size > w->blockmaxsize)
         return(ccn_seterror(w->h, EINVAL));
     ans = size;
+    if (size + w->buffer->length > w->blockmaxsize &&
+        w->buffer->length >= w->blockminsize && w->buffer->length > 0)
+        seqw_presign(w);
     if (size + w->buffer->length > w->blockmaxsize)
         ans = ccn_seterror(w->h, EAGAIN);
     else if (size != 0)
         ccn_charbuf_append(w->buffer, buf, size);
+    if (w->buffer->length == w->blockmaxsize && w->batching == 0 &&
+        !w->interests_possibly_pending)
+        seqw_presign(w);
     if (w->interests_possibly_pending &&
         (w->closed || w->buffer->length >= w->blockminsize) &&
         (w->batching == 0 || ans == -1)) {
@@ -231,13 +421,12 @@ ccn_seqw_write(struct ccn_seqwriter *w, const void *buf, size_t size)
         if (cob != NULL) {
             res = ccn_put(w->h, cob->buf, cob->length);
             if (res >= 0) {
-                if (w->seqnum == 0) {
-                    w->cob0 = cob;
-                    cob = NULL;
-                }
                 w->buffer->length = 0;
                 w->seqnum++;
-                w->interests_possibly_pending = 0;
+                /* Segments asked for earlier are still wanted */
+                w->interests_possibly_pending = (w->seqnum < w->asked);
+                seqw_sent(w, w->seqnum - 1, cob);
+                cob = NULL;
             }
             ccn_charbuf_destroy(&cob);
         }
@@ -285,6 +474,37 @@ ccn_seqw_set_block_limits(struct ccn_seqwriter *w, int l, int h)
     return(0);
 }
 
+/**
+ * Set the number of segments that may be signed ahead of demand.
+ *
+ * Full blocks are signed as they are written, and held until interests
+ * ask for them, so that signing is off the consumer's round trip and
+ * a pipelining consumer may be answered from the window.
+ * Zero disables signing ahead, so that each block is signed as an
+ * interest arrives for it.  The default is 8.
+ * May only be changed while no segments are waiting in the window.
+ * @returns 0 for success, -1 for failure.
+ */
+int
+ccn_seqw_set_window(struct ccn_seqwriter *w, int window)
+{
+    struct ccn_charbuf **ready = NULL;
+    
+    if (w == NULL || w->cl.data != w || w->closed)
+        return(-1);
+    if (window < 0 || window > MAX_WINDOW || w->base != w->seqnum)
+        return(-1);
+    if (window > 0) {
+        ready = calloc(window, sizeof(ready[0]));
+        if (ready == NULL)
+            return(-1);
+    }
+    seqw_destroy_ready(w);
+    w->ready = ready;
+    w->window = window;
+    return(0);
+}
+
 int
 ccn_seqw_set_freshness(struct ccn_seqwriter *w, int freshness)
 {
@@ -318,6 +538,7 @@ ccn_seqw_close(struct ccn_seqwriter *w)
 {
     if (w == NULL || w->cl.data != w)
         return(-1);
+    seqw_flush_ready(w);
     w->closed = 1;
     w->interests_possibly_pending = 1;
     w->batching = 0;
@@ -0,0 +1,931 @@
+/**
+ * @file ccn_signagent.c
+ * @brief Signing through a per-user agent that holds unlocked keys.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/un.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/digest.h>
+#include <ccn/hashtb.h>
+#include <ccn/indexbuf.h>
+#include <ccn/keystore.h>
+#include <ccn/signagent.h>
+#include <ccn/signing.h>
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+/* Bound on the body of any message, requests and replies alike */
+#define MAX_BODY_SIZE (CCN_SIGNAGENT_KEYID_SIZE + \
+                       CCN_SIGNAGENT_MAX_BATCH * CCN_SIGNAGENT_DIGEST_SIZE)
+
+/***********************************
+ * Messages
+ */
+
+static void
+put_uint(unsigned char *p, unsigned val, int n)
+{
+    while (n-- > 0) {
+        p[n] = val & 0xFF;
+        val >>= 8;
+    }
+}
+
+static unsigned
+get_uint(const unsigned char *p, int n)
+{
+    unsigned val = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+        val = (val << 8) | p[i];
+    return(val);
+}
+
+static int
+append_header(struct ccn_charbuf *c, int op, unsigned count, size_t size)
+{
+    unsigned char *p;
+
+    p = ccn_charbuf_reserve(c, CCN_SIGNAGENT_HEADER_SIZE);
+    if (p == NULL)
+        return(-1);
+    p[0] = CCN_SIGNAGENT_VERSION;
+    p[1] = op;
+    put_uint(p + 2, count, 2);
+    put_uint(p + 4, size, 4);
+    c->length += CCN_SIGNAGENT_HEADER_SIZE;
+    return(0);
+}
+
+static int
+append_uint(struct ccn_charbuf *c, unsigned val, int n)
+{
+    unsigned char *p;
+
+    p = ccn_charbuf_reserve(c, n);
+    if (p == NULL)
+        return(-1);
+    put_uint(p, val, n);
+    c->length += n;
+    return(0);
+}
+
+static int
+unix_sockaddr(const char *sockname, struct sockaddr_un *a)
+{
+    memset(a, 0, sizeof(*a));
+    if (strlen(sockname) >= sizeof(a->sun_path)) {
+        errno = ENAMETOOLONG;
+        return(-1);
+    }
+    a->sun_family = AF_UNIX;
+    strcpy(a->sun_path, sockname);
+    return(0);
+}
+
+/**
+ * Find the pathname of the agent's socket.
+ *
+ * This parallels the location of the user's default keystore.
+ */
+int
+ccn_signagent_sockname(struct ccn_charbuf *path)
+{
+    const char *s;
+
+    path->length = 0;
+    s = getenv("CCNX_SIGNAGENT_SOCK");
+    if (s != NULL) {
+        if (s[0] == 0)
+            return(-1);
+        return(ccn_charbuf_putf(path, "%s", s));
+    }
+    s = getenv("CCNX_DIR");
+    if (s != NULL && s[0] != 0)
+        return(ccn_charbuf_putf(path, "%s/.ccnx_signagent.sock", s));
+    s = getenv("HOME");
+    if (s != NULL && s[0] != 0)
+        return(ccn_charbuf_putf(path, "%s/.ccnx/.ccnx_signagent.sock", s));
+    return(-1);
+}
+
+/***********************************
+ * Client side
+ */
+
+struct ccn_signagent {
+    int fd;
+    pid_t pid;                      /* the process that connected fd */
+    struct ccn_charbuf *sockname;
+    unsigned char pubid[CCN_SIGNAGENT_KEYID_SIZE];
+    struct ccn_pkey *public_key;
+    char *digest_algorithm;
+    struct ccn_charbuf *msg;        /* scratch */
+};
+
+static int
+write_fully(int fd, const unsigned char *p, size_t size)
+{
+    ssize_t res;
+
+    while (size > 0) {
+        res = send(fd, p, size, SEND_FLAGS);
+        if (res == -1 && errno == EINTR)
+            continue;
+        if (res <= 0)
+            return(-1);
+        p += res;
+        size -= res;
+    }
+    return(0);
+}
+
+static int
+read_fully(int fd, unsigned char *p, size_t size)
+{
+    ssize_t res;
+
+    while (size > 0) {
+        res = read(fd, p, size);
+        if (res == -1 && errno == EINTR)
+            continue;
+        if (res == 0)
+            errno = ECONNRESET;
+        if (res <= 0)
+            return(-1);
+        p += res;
+        size -= res;
+    }
+    return(0);
+}
+
+/**
+ * Send the request in a->msg, and replace it with the body of the reply.
+ * @returns the count from the reply, or -1 for error.
+ */
+static int
+transact(struct ccn_signagent *a, int op)
+{
+    unsigned char header[CCN_SIGNAGENT_HEADER_SIZE];
+    unsigned count;
+    size_t size;
+
+    if (a->fd == -1) {
+        errno = ENOTCONN;
+        return(-1);
+    }
+    if (write_fully(a->fd, a->msg->buf, a->msg->length) < 0)
+        return(-1);
+    if (read_fully(a->fd, header, sizeof(header)) < 0)
+        return(-1);
+    count = get_uint(header + 2, 2);
+    size = get_uint(header + 4, 4);
+    if (header[0] != CCN_SIGNAGENT_VERSION || size > MAX_BODY_SIZE) {
+        errno = EPROTO;
+        return(-1);
+    }
+    a->msg->length = 0;
+    if (ccn_charbuf_reserve(a->msg, size) == NULL)
+        return(-1);
+    if (read_fully(a->fd, a->msg->buf, size) < 0)
+        return(-1);
+    a->msg->length = size;
+    if (header[1] == CCN_SIGNAGENT_OP_ERROR) {
+        errno = (count != 0) ? count : EIO;
+        return(-1);
+    }
+    if (header[1] != op) {
+        errno = EPROTO;
+        return(-1);
+    }
+    return(count);
+}
+
+/**
+ * Connect to the agent and ask for its default key.
+ *
+ * On a reconnection the key must not have changed.
+ */
+static int
+agent_connect(struct ccn_signagent *a)
+{
+    struct sockaddr_un addr;
+    const unsigned char *p;
+    size_t alg_size;
+    int reconnect = (a->public_key != NULL);
+
+    if (a->fd != -1)
+        close(a->fd);
+    a->fd = -1;
+    if (unix_sockaddr(ccn_charbuf_as_string(a->sockname), &addr) < 0)
+        return(-1);
+    a->fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (a->fd == -1)
+        return(-1);
+    fcntl(a->fd, F_SETFD, FD_CLOEXEC);
+#ifdef SO_NOSIGPIPE
+    {
+        int on = 1;
+        setsockopt(a->fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+    }
+#endif
+    if (connect(a->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+        goto Bail;
+    a->pid = getpid();
+    a->msg->length = 0;
+    append_header(a->msg, CCN_SIGNAGENT_OP_KEY, 0, 0);
+    if (transact(a, CCN_SIGNAGENT_OP_KEY) < 0)
+        goto Bail;
+    p = a->msg->buf;
+    if (a->msg->length < CCN_SIGNAGENT_KEYID_SIZE + 2)
+        goto Garbled;
+    alg_size = get_uint(p + CCN_SIGNAGENT_KEYID_SIZE, 2);
+    if (a->msg->length < CCN_SIGNAGENT_KEYID_SIZE + 2 + alg_size)
+        goto Garbled;
+    if (reconnect) {
+        if (memcmp(a->pubid, p, sizeof(a->pubid)) != 0) {
+            errno = ENOENT; /* The default key has changed under us */
+            goto Bail;
+        }
+        return(0);
+    }
+    memcpy(a->pubid, p, sizeof(a->pubid));
+    p += CCN_SIGNAGENT_KEYID_SIZE + 2;
+    if (alg_size > 0) {
+        a->digest_algorithm = calloc(1, alg_size + 1);
+        if (a->digest_algorithm == NULL)
+            goto Bail;
+        memcpy(a->digest_algorithm, p, alg_size);
+    }
+    p += alg_size;
+    a->public_key = ccn_d2i_pubkey(p, a->msg->buf + a->msg->length - p);
+    if (a->public_key == NULL)
+        goto Garbled;
+    return(0);
+Garbled:
+    errno = EPROTO;
+Bail:
+    close(a->fd);
+    a->fd = -1;
+    return(-1);
+}
+
+struct ccn_signagent *
+ccn_signagent_open(const char *sockname)
+{
+    struct ccn_signagent *a;
+    int res;
+
+    a = calloc(1, sizeof(*a));
+    if (a == NULL)
+        return(NULL);
+    a->fd = -1;
+    a->sockname = ccn_charbuf_create();
+    a->msg = ccn_charbuf_create();
+    if (a->sockname == NULL || a->msg == NULL)
+        res = -1;
+    else if (sockname != NULL)
+        res = ccn_charbuf_putf(a->sockname, "%s", sockname);
+    else {
+        res = ccn_signagent_sockname(a->sockname);
+        if (res < 0)
+            errno = ENOENT;
+    }
+    if (res >= 0)
+        res = agent_connect(a);
+    if (res < 0) {
+        res = errno;
+        ccn_signagent_close(&a);
+        errno = res;
+    }
+    return(a);
+}
+
+void
+ccn_signagent_close(struct ccn_signagent **ap)
+{
+    struct ccn_signagent *a = *ap;
+
+    if (a == NULL)
+        return;
+    if (a->fd != -1)
+        close(a->fd);
+    if (a->public_key != NULL)
+        ccn_pubkey_free(a->public_key);
+    free(a->digest_algorithm);
+    ccn_charbuf_destroy(&a->sockname);
+    ccn_charbuf_destroy(&a->msg);
+    free(a);
+    *ap = NULL;
+}
+
+const unsigned char *
+ccn_signagent_pubid(struct ccn_signagent *a)
+{
+    return(a->pubid);
+}
+
+const struct ccn_pkey *
+ccn_signagent_public_key(struct ccn_signagent *a)
+{
+    return(a->public_key);
+}
+
+const char *
+ccn_signagent_digest_algorithm(struct ccn_signagent *a)
+{
+    return(a->digest_algorithm);
+}
+
+int
+ccn_signagent_sign_digests(struct ccn_signagent *a,
+                           const unsigned char *digests, int count,
+                           struct ccn_charbuf *sigs,
+                           struct ccn_indexbuf *ends)
+{
+    const unsigned char *p;
+    const unsigned char *stop;
+    size_t sig_size;
+    int attempt;
+    int res = -1;
+    int i;
+
+    if (count < 1 || count > CCN_SIGNAGENT_MAX_BATCH) {
+        errno = EINVAL;
+        return(-1);
+    }
+    /* A forked child would read replies meant for its parent */
+    if (a->pid != getpid() && agent_connect(a) < 0)
+        return(-1);
+    /* If the agent has been restarted, try once more on a new connection */
+    for (attempt = 0; attempt < 2 && res < 0; attempt++) {
+        if (attempt > 0 && agent_connect(a) < 0)
+            return(-1);
+        a->msg->length = 0;
+        append_header(a->msg, CCN_SIGNAGENT_OP_SIGN, count,
+                      sizeof(a->pubid) + count * CCN_SIGNAGENT_DIGEST_SIZE);
+        ccn_charbuf_append(a->msg, a->pubid, sizeof(a->pubid));
+        ccn_charbuf_append(a->msg, digests, count * CCN_SIGNAGENT_DIGEST_SIZE);
+        res = transact(a, CCN_SIGNAGENT_OP_SIGN);
+        if (res < 0 && errno != ECONNRESET && errno != EPIPE &&
+              errno != ENOTCONN)
+            return(-1);
+    }
+    if (res != count) {
+        errno = EPROTO;
+        return(-1);
+    }
+    p = a->msg->buf;
+    stop = p + a->msg->length;
+    for (i = 0; i < count; i++) {
+        if (stop - p < 2)
+            break;
+        sig_size = get_uint(p, 2);
+        p += 2;
+        if (stop - p < (ptrdiff_t)sig_size)
+            break;
+        ccn_charbuf_append(sigs, p, sig_size);
+        p += sig_size;
+        if (ends != NULL)
+            ccn_indexbuf_append_element(ends, sigs->length);
+    }
+    if (i != count) {
+        errno = EPROTO;
+        return(-1);
+    }
+    return(0);
+}
+
+int
+ccn_signagent_sign_content(struct ccn_signagent *a,
+                           struct ccn_charbuf *resultbuf,
+                           const struct ccn_charbuf *Name,
+                           const struct ccn_charbuf *SignedInfo,
+                           const void *data, size_t size)
+{
+    struct ccn_digest *digest = NULL;
+    struct ccn_charbuf *content_header = NULL;
+    struct ccn_charbuf *sig = NULL;
+    unsigned char md[CCN_SIGNAGENT_DIGEST_SIZE];
+    size_t closer_start;
+    int res = 0;
+
+    /* The signed portion is the same as for ccn_encode_ContentObject() */
+    content_header = ccn_charbuf_create();
+    sig = ccn_charbuf_create();
+    digest = ccn_digest_create(CCN_DIGEST_SHA256);
+    if (content_header == NULL || sig == NULL || digest == NULL) {
+        res = -1;
+        goto Cleanup;
+    }
+    res |= ccn_charbuf_append_tt(content_header, CCN_DTAG_Content, CCN_DTAG);
+    if (size != 0)
+        res |= ccn_charbuf_append_tt(content_header, size, CCN_BLOB);
+    closer_start = content_header->length;
+    res |= ccn_charbuf_append_closer(content_header);
+    if (res < 0)
+        goto Cleanup;
+    ccn_digest_init(digest);
+    res |= ccn_digest_update(digest, Name->buf, Name->length);
+    res |= ccn_digest_update(digest, SignedInfo->buf, SignedInfo->length);
+    res |= ccn_digest_update(digest, content_header->buf, closer_start);
+    res |= ccn_digest_update(digest, data, size);
+    res |= ccn_digest_update(digest, content_header->buf + closer_start,
+                             content_header->length - closer_start);
+    res |= ccn_digest_final(digest, md, sizeof(md));
+    if (res < 0)
+        goto Cleanup;
+    res = ccn_signagent_sign_digests(a, md, 1, sig, NULL);
+    if (res < 0)
+        goto Cleanup;
+    res = ccn_encode_presigned_ContentObject(resultbuf, Name, SignedInfo,
+                                             data, size, a->digest_algorithm,
+                                             sig->buf, sig->length);
+Cleanup:
+    ccn_digest_destroy(&digest);
+    ccn_charbuf_destroy(&content_header);
+    ccn_charbuf_destroy(&sig);
+    return(res == 0 ? 0 : -1);
+}
+
+/***********************************
+ * Serving side
+ */
+
+struct agent_key { /* keyed by key id */
+    struct ccn_keystore *keystore;
+    struct ccn_charbuf *pubkey;     /* DER-encoded public key */
+};
+
+struct agent_client {
+    int fd;
+    struct ccn_charbuf *inbuf;
+    struct ccn_charbuf *outbuf;
+    size_t outdone;                 /* bytes of outbuf already sent */
+};
+
+struct ccn_signagent_server {
+    int listener;
+    struct ccn_charbuf *sockname;
+    struct hashtb *keys;
+    struct ccn_charbuf *default_pubid;
+    struct agent_client *clients;
+    int n_clients;
+    int max_clients;
+    struct pollfd *fds;
+    struct ccn_charbuf *body;       /* scratch */
+    unsigned char *sigbuf;          /* scratch */
+    size_t sigbuf_size;
+};
+
+static void
+finalize_agent_key(struct hashtb_enumerator *e)
+{
+    struct agent_key *k = e->data;
+
+    ccn_keystore_destroy(&k->keystore);
+    ccn_charbuf_destroy(&k->pubkey);
+}
+
+struct ccn_signagent_server *
+ccn_signagent_server_create(const char *sockname)
+{
+    struct ccn_signagent_server *s;
+    struct hashtb_param param = {0};
+    struct sockaddr_un addr;
+    struct stat st;
+    mode_t savedmask;
+    int fd;
+    int res;
+
+    if (unix_sockaddr(sockname, &addr) < 0)
+        return(NULL);
+    /* Leave alone an agent that is already serving */
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1)
+        return(NULL);
+    res = connect(fd, (struct sockaddr *)&addr, sizeof(addr));
+    close(fd);
+    if (res == 0) {
+        errno = EADDRINUSE;
+        return(NULL);
+    }
+    /* Only a socket left behind by a dead agent may be removed */
+    if (lstat(sockname, &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) {
+            errno = EEXIST;
+            return(NULL);
+        }
+        if (unlink(sockname) == -1)
+            return(NULL);
+    }
+    else if (errno != ENOENT)
+        return(NULL);
+    s = calloc(1, sizeof(*s));
+    if (s == NULL)
+        return(NULL);
+    param.finalize = &finalize_agent_key;
+    s->keys = hashtb_create(sizeof(struct agent_key), &param);
+    s->sockname = ccn_charbuf_create();
+    s->body = ccn_charbuf_create();
+    s->listener = -1;
+    if (s->keys == NULL || s->sockname == NULL || s->body == NULL)
+        goto Bail;
+    ccn_charbuf_putf(s->sockname, "%s", sockname);
+    s->listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (s->listener == -1)
+        goto Bail;
+    savedmask = umask(0177); /* only the owner may use the agent */
+    res = bind(s->listener, (struct sockaddr *)&addr, sizeof(addr));
+    umask(savedmask);
+    if (res == -1) {
+        /* Not ours, so destroy must not unlink it */
+        res = errno;
+        close(s->listener);
+        s->listener = -1;
+        errno = res;
+        goto Bail;
+    }
+    if (listen(s->listener, 30) == -1)
+        goto Bail;
+    fcntl(s->listener, F_SETFL, O_NONBLOCK);
+    fcntl(s->listener, F_SETFD, FD_CLOEXEC);
+    return(s);
+Bail:
+    res = errno;
+    ccn_signagent_server_destroy(&s);
+    errno = res;
+    return(NULL);
+}
+
+int
+ccn_signagent_server_add_key(struct ccn_signagent_server *s,
+                             const char *keystore_path,
+                             const char *password,
+                             struct ccn_charbuf *pubid_out)
+{
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    struct ccn_keystore *keystore = NULL;
+    struct ccn_charbuf *pubkey = NULL;
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d;
+    const unsigned char *p = NULL;
+    size_t size = 0;
+    const struct ccn_pkey *pkey;
+    int res;
+
+    keystore = ccn_keystore_create();
+    if (keystore == NULL)
+        return(-1);
+    res = ccn_keystore_init(keystore, (char *)keystore_path, (char *)password);
+    if (res != 0)
+        goto Bail;
+    /* Only the default digest algorithm can be signed as a bare digest */
+    if (ccn_keystore_digest_algorithm(keystore) != NULL ||
+          ccn_keystore_public_key_digest_length(keystore) !=
+          CCN_SIGNAGENT_KEYID_SIZE ||
+          (ccn_keystore_key_type(keystore) != CCN_KEYSTORE_KEY_RSA &&
+           ccn_keystore_key_type(keystore) != CCN_KEYSTORE_KEY_EC)) {
+        errno = EINVAL;
+        goto Bail;
+    }
+    pkey = ccn_keystore_public_key(keystore);
+    pubkey = ccn_charbuf_create();
+    if (pubkey == NULL || ccn_append_pubkey_blob(pubkey, pkey) < 0)
+        goto Bail;
+    d = ccn_buf_decoder_start(&decoder, pubkey->buf, pubkey->length);
+    if (ccn_buf_match_blob(d, &p, &size)) {
+        memmove(pubkey->buf, p, size);
+        pubkey->length = size;
+    }
+    if (ccn_pubkey_size(ccn_keystore_private_key(keystore)) > s->sigbuf_size) {
+        free(s->sigbuf);
+        s->sigbuf_size = ccn_pubkey_size(ccn_keystore_private_key(keystore));
+        s->sigbuf = calloc(1, s->sigbuf_size);
+        if (s->sigbuf == NULL) {
+            s->sigbuf_size = 0;
+            goto Bail;
+        }
+    }
+    if (pubid_out != NULL) {
+        pubid_out->length = 0;
+        ccn_charbuf_append(pubid_out,
+                           ccn_keystore_public_key_digest(keystore),
+                           CCN_SIGNAGENT_KEYID_SIZE);
+    }
+    hashtb_start(s->keys, e);
+    res = hashtb_seek(e, ccn_keystore_public_key_digest(keystore),
+                      CCN_SIGNAGENT_KEYID_SIZE, 0);
+    if (res == HT_NEW_ENTRY) {
+        struct agent_key *k = e->data;
+        k->keystore = keystore;
+        k->pubkey = pubkey;
+        keystore = NULL;
+        pubkey = NULL;
+    }
+    if (res >= 0 && s->default_pubid == NULL) {
+        s->default_pubid = ccn_charbuf_create();
+        ccn_charbuf_append(s->default_pubid, e->key, e->keysize);
+    }
+    hashtb_end(e);
+    ccn_keystore_destroy(&keystore);
+    ccn_charbuf_destroy(&pubkey);
+    return(res < 0 ? -1 : 0);
+Bail:
+    res = errno;
+    ccn_keystore_destroy(&keystore);
+    ccn_charbuf_destroy(&pubkey);
+    errno = (res != 0) ? res : EINVAL;
+    return(-1);
+}
+
+static struct agent_key *
+lookup_key(struct ccn_signagent_server *s, const unsigned char *pubid)
+{
+    if (pubid == NULL) {
+        if (s->default_pubid == NULL)
+            return(NULL);
+        pubid = s->default_pubid->buf;
+    }
+    return(hashtb_lookup(s->keys, pubid, CCN_SIGNAGENT_KEYID_SIZE));
+}
+
+/**
+ * Handle one request, appending the reply to the client's outbuf.
+ * @returns the errno value for an error reply, or 0.
+ */
+static int
+serve_request(struct ccn_signagent_server *s, struct agent_client *c,
+              int op, unsigned count, const unsigned char *body, size_t size)
+{
+    struct agent_key *k;
+    const char *alg;
+    size_t sig_size;
+    unsigned i;
+
+    s->body->length = 0;
+    switch (op) {
+        case CCN_SIGNAGENT_OP_KEY:
+            if (size != 0 && size != CCN_SIGNAGENT_KEYID_SIZE)
+                return(EINVAL);
+            k = lookup_key(s, size == 0 ? NULL : body);
+            if (k == NULL)
+                return(ENOENT);
+            alg = ccn_keystore_digest_algorithm(k->keystore);
+            if (alg == NULL)
+                alg = "";
+            ccn_charbuf_append(s->body,
+                               ccn_keystore_public_key_digest(k->keystore),
+                               CCN_SIGNAGENT_KEYID_SIZE);
+            append_uint(s->body, strlen(alg), 2);
+            ccn_charbuf_append_string(s->body, alg);
+            ccn_charbuf_append_charbuf(s->body, k->pubkey);
+            count = 0;
+            break;
+        case CCN_SIGNAGENT_OP_SIGN:
+            if (count < 1 || count > CCN_SIGNAGENT_MAX_BATCH ||
+                  size != CCN_SIGNAGENT_KEYID_SIZE +
+                          count * CCN_SIGNAGENT_DIGEST_SIZE)
+                return(EINVAL);
+            k = lookup_key(s, body);
+            if (k == NULL)
+                return(ENOENT);
+            body += CCN_SIGNAGENT_KEYID_SIZE;
+            for (i = 0; i < count; i++, body += CCN_SIGNAGENT_DIGEST_SIZE) {
+                if (ccn_sign_digest(ccn_keystore_private_key(k->keystore),
+                                    body, CCN_SIGNAGENT_DIGEST_SIZE,
+                                    s->sigbuf, &sig_size) < 0)
+                    return(EIO);
+                append_uint(s->body, sig_size, 2);
+                ccn_charbuf_append(s->body, s->sigbuf, sig_size);
+            }
+            break;
+        default:
+            return(EOPNOTSUPP);
+    }
+    append_header(c->outbuf, op, count, s->body->length);
+    ccn_charbuf_append_charbuf(c->outbuf, s->body);
+    return(0);
+}
+
+static void
+close_client(struct ccn_signagent_server *s, int i)
+{
+    struct agent_client *c = &s->clients[i];
+
+    close(c->fd);
+    ccn_charbuf_destroy(&c->inbuf);
+    ccn_charbuf_destroy(&c->outbuf);
+    s->clients[i] = s->clients[--s->n_clients];
+}
+
+static void
+accept_clients(struct ccn_signagent_server *s)
+{
+    struct agent_client *c;
+    int fd;
+
+    for (;;) {
+        fd = accept(s->listener, NULL, NULL);
+        if (fd == -1)
+            return;
+        if (s->n_clients == s->max_clients) {
+            int n = 2 * s->max_clients + 4;
+            void *clients = realloc(s->clients, n * sizeof(s->clients[0]));
+            void *fds = realloc(s->fds, (n + 1) * sizeof(s->fds[0]));
+            if (clients != NULL)
+                s->clients = clients;
+            if (fds != NULL)
+                s->fds = fds;
+            if (clients == NULL || fds == NULL) {
+                close(fd);
+                return;
+            }
+            s->max_clients = n;
+        }
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        fcntl(fd, F_SETFD, FD_CLOEXEC);
+        c = &s->clients[s->n_clients++];
+        memset(c, 0, sizeof(*c));
+        c->fd = fd;
+        c->inbuf = ccn_charbuf_create();
+        c->outbuf = ccn_charbuf_create();
+    }
+}
+
+/**
+ * Read what a client has sent, and reply to each complete request.
+ * @returns -1 if the client should be dropped.
+ */
+static int
+service_input(struct ccn_signagent_server *s, struct agent_client *c)
+{
+    const unsigned char *p;
+    unsigned count;
+    size_t size;
+    size_t used = 0;
+    ssize_t res;
+    int err;
+
+    if (ccn_charbuf_reserve(c->inbuf, 8800) == NULL)
+        return(-1);
+    res = read(c->fd, c->inbuf->buf + c->inbuf->length,
+               c->inbuf->limit - c->inbuf->length);
+    if (res == 0 || (res == -1 && errno != EAGAIN && errno != EINTR))
+        return(-1);
+    if (res < 0)
+        return(0);
+    c->inbuf->length += res;
+    while (c->inbuf->length - used >= CCN_SIGNAGENT_HEADER_SIZE) {
+        p = c->inbuf->buf + used;
+        count = get_uint(p + 2, 2);
+        size = get_uint(p + 4, 4);
+        if (p[0] != CCN_SIGNAGENT_VERSION || size > MAX_BODY_SIZE)
+            return(-1);
+        if (c->inbuf->length - used < CCN_SIGNAGENT_HEADER_SIZE + size)
+            break;
+        err = serve_request(s, c, p[1], count,
+                            p + CCN_SIGNAGENT_HEADER_SIZE, size);
+        if (err != 0)
+            append_header(c->outbuf, CCN_SIGNAGENT_OP_ERROR, err, 0);
+        used += CCN_SIGNAGENT_HEADER_SIZE + size;
+    }
+    if (used > 0) {
+        memmove(c->inbuf->buf, c->inbuf->buf + used, c->inbuf->length - used);
+        c->inbuf->length -= used;
+    }
+    return(0);
+}
+
+static int
+service_output(struct agent_client *c)
+{
+    ssize_t res;
+
+    while (c->outdone < c->outbuf->length) {
+        res = send(c->fd, c->outbuf->buf + c->outdone,
+                   c->outbuf->length - c->outdone, SEND_FLAGS);
+        if (res == -1 && errno == EINTR)
+            continue;
+        if (res == -1 && errno == EAGAIN)
+            return(0);
+        if (res <= 0)
+            return(-1);
+        c->outdone += res;
+    }
+    c->outbuf->length = 0;
+    c->outdone = 0;
+    return(0);
+}
+
+int
+ccn_signagent_server_run(struct ccn_signagent_server *s, int timeout_ms)
+{
+    struct timeval start;
+    struct timeval now;
+    int elapsed_ms;
+    int wait_ms = timeout_ms;
+    int res;
+    int i;
+
+    if (s->fds == NULL) {
+        s->fds = calloc(1, sizeof(s->fds[0]));
+        if (s->fds == NULL)
+            return(-1);
+    }
+    gettimeofday(&start, NULL);
+    for (;;) {
+        s->fds[0].fd = s->listener;
+        s->fds[0].events = POLLIN;
+        s->fds[0].revents = 0;
+        for (i = 0; i < s->n_clients; i++) {
+            s->fds[i + 1].fd = s->clients[i].fd;
+            s->fds[i + 1].events = POLLIN;
+            if (s->clients[i].outbuf->length > 0)
+                s->fds[i + 1].events |= POLLOUT;
+            s->fds[i + 1].revents = 0;
+        }
+        res = poll(s->fds, s->n_clients + 1, wait_ms);
+        if (res == -1)
+            return(errno == EINTR ? 0 : -1);
+        /* Work from the end, so a dropped client does not disturb the rest */
+        for (i = s->n_clients - 1; i >= 0; i--) {
+            struct agent_client *c = &s->clients[i];
+            short revents = s->fds[i + 1].revents;
+            if ((revents & (POLLIN | POLLHUP | POLLERR)) != 0 &&
+                  service_input(s, c) < 0)
+                close_client(s, i);
+            else if (c->outbuf->length > 0 && service_output(c) < 0)
+                close_client(s, i);
+        }
+        if ((s->fds[0].revents & (POLLERR | POLLNVAL)) != 0)
+            return(-1);
+        if ((s->fds[0].revents & POLLIN) != 0)
+            accept_clients(s);
+        if (timeout_ms >= 0) {
+            gettimeofday(&now, NULL);
+            elapsed_ms = (now.tv_sec - start.tv_sec) * 1000 +
+                         (now.tv_usec - start.tv_usec) / 1000;
+            if (elapsed_ms >= timeout_ms)
+                return(0);
+            wait_ms = timeout_ms - elapsed_ms;
+        }
+    }
+}
+
+void
+ccn_signagent_server_destroy(struct ccn_signagent_server **sp)
+{
+    struct ccn_signagent_server *s = *sp;
+
+    if (s == NULL)
+        return;
+    while (s->n_clients > 0)
+        close_client(s, s->n_clients - 1);
+    if (s->listener != -1) {
+        close(s->listener);
+        unlink(ccn_charbuf_as_string(s->sockname));
+    }
+    hashtb_destroy(&s->keys);
+    ccn_charbuf_destroy(&s->sockname);
+    ccn_charbuf_destroy(&s->default_pubid);
+    ccn_charbuf_destroy(&s->body);
+    free(s->clients);
+    free(s->fds);
+    free(s->sigbuf);
+    free(s);
+    *sp = NULL;
+}
@@ -21,6 +21,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <openssl/evp.h>
+#if !defined(OPENSSL_NO_EC)
+#include <openssl/ecdsa.h>
+#endif
+#include <openssl/rsa.h>
+#include <openssl/sha.h>
 #include <openssl/rand.h>
 #include <openssl/x509.h>
 #include <ccn/merklepathasn1.h>
@@ -28,11 +33,23 @@
 #include <ccn/signing.h>
 #include <ccn/random.h>
 
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L && !defined(OPENSSL_NO_HMAC)
+#define CCN_HMAC_PKEY 1 /* EVP_PKEY_HMAC keys are available */
+#endif
+
 struct ccn_sigc {
     EVP_MD_CTX context;
+    int keyed;      /**< set up for a keyed hash (HMAC) */
 };
 
-#if !defined(OPENSSL_NO_EC) && !defined(OPENSSL_NO_ECDSA) && defined(NID_ecdsa_with_SHA256)
+/*
+ * OpenSSL 0.9.8 has no predefined EVP_MD for ECDSA with SHA256, so we
+ * supply one.  From 1.0.0 on the key passed to the signature finalization
+ * selects the signature algorithm, and the stock digests are used instead.
+ */
+#if OPENSSL_VERSION_NUMBER < 0x10000000L && \
+    !defined(OPENSSL_NO_EC) && !defined(OPENSSL_NO_ECDSA) && defined(NID_ecdsa_with_SHA256)
+#define CCN_SHA256EC_MD 1
 static int init256(EVP_MD_CTX *ctx)
 { return SHA256_Init(ctx->md_data); }
 static int update256(EVP_MD_CTX *ctx,const void *data,size_t count)
@@ -72,6 +89,11 @@ md_from_digest_and_pkey(const char *digest, const struct ccn_pkey *pkey)
     if (digest == NULL) {
         md_nid = NID_sha256;
     }
+#ifdef CCN_HMAC_PKEY
+    else if (strcmp(digest, CCN_SIGNING_HMAC_SHA256_ALGORITHM) == 0) {
+        md_nid = NID_hmacWithSHA256;
+    }
+#endif
     else {
         /* figure out what algorithm the OID represents */
         md_nid = OBJ_txt2nid(digest);
@@ -86,24 +108,54 @@ md_from_digest_and_pkey(const char *digest, const struct ccn_pkey *pkey)
         case EVP_PKEY_DSA:
 #if !defined(OPENSSL_NO_EC)
         case EVP_PKEY_EC:
+#endif
+#ifdef CCN_HMAC_PKEY
+        case EVP_PKEY_HMAC:
 #endif
             break;
         default:
             fprintf(stderr, "not a Key type I understand right now: NID %d\n", pkey_type);
             return(NULL);
     }
+#ifdef CCN_HMAC_PKEY
+    /* A keyed hash goes with a shared secret, and nothing else does */
+    if (pkey_type == EVP_PKEY_HMAC || md_nid == NID_hmacWithSHA256) {
+        if (pkey_type == EVP_PKEY_HMAC && md_nid == NID_hmacWithSHA256)
+            return(EVP_sha256());
+        fprintf(stderr, "keyed hash needs a secret key: %s with NID %d\n",
+                digest, pkey_type);
+        return(NULL);
+    }
+#endif
+#if OPENSSL_VERSION_NUMBER >= 0x10000000L
+    /*
+     * In OpenSSL 1.0.0 and later the key that is passed in the signature
+     * finalization step determines the signature algorithm applied to the
+     * digest, so a plain digest serves every key type.
+     */
+    switch (md_nid) {
+#ifndef OPENSSL_NO_SHA
+        case NID_sha1:      // supported for RSA/DSA/EC key types
+            return(EVP_sha1());
+#endif
+        case NID_sha256:    // supported for RSA/EC key types
+            if (pkey_type != EVP_PKEY_DSA)
+                return(EVP_sha256());
+            break;
+        case NID_sha512:    // supported for RSA/EC key types
+            if (pkey_type != EVP_PKEY_DSA)
+                return(EVP_sha512());
+            break;
+        default:
+            break;
+    }
+#else
     /*
      * In OpenSSL 0.9.8 the digest algorithm and key type determine the
      * digest and signature methods that are in the staticly defined
      * EVP_MD structures, so we need to get the correct predefined one, or
-     * create our own.
-     * In OpenSSL 1.0.0 the EVP_MD structure allows for the key that is passed
-     * in the signature finalization step to determine the signature algorithm
-     * applied to the digest, so we would be able to use a single SHA256 context
-     * independent of the key type (assuming size compatability).
-     * At the point that 1.0.0 or later is the default provider we could simplify
-     * this code.   The Java code (OIDLookup.java) uses a much more elaborate
-     * set of hash maps to perform a similar function.
+     * create our own.  The Java code (OIDLookup.java) uses a much more
+     * elaborate set of hash maps to perform a similar function.
      */
     switch (md_nid) {
 #ifndef OPENSSL_NO_SHA
@@ -123,7 +175,7 @@ md_from_digest_and_pkey(const char *digest, const struct ccn_pkey *pkey)
         case NID_sha256:    // supported for RSA/EC key types
             if (pkey_type == EVP_PKEY_RSA)
                 return(EVP_sha256());
-#if !defined(OPENSSL_NO_EC) && !defined(OPENSSL_NO_ECDSA) && defined(NID_ecdsa_with_SHA256)
+#ifdef CCN_SHA256EC_MD
             else if (pkey_type == EVP_PKEY_EC) {
                 return(&sha256ec_md);
             } /* our own md */
@@ -135,6 +187,7 @@ md_from_digest_and_pkey(const char *digest, const struct ccn_pkey *pkey)
         default:
             break;
     }
+#endif
     fprintf(stderr, "not a Digest+Signature algorithm I understand right now: %s with NID %d\n",
             digest, pkey_type);
     return (NULL);
@@ -158,13 +211,37 @@ ccn_sigc_destroy(struct ccn_sigc **ctx)
     }
 }
 
+/**
+ * Prepare a signing context for a new signature.
+ *
+ * A context may be initialized again after ccn_sigc_final to sign
+ * something else, which saves setting up a fresh one per signature.
+ * @returns 0 for success, -1 for error.
+ */
 int
 ccn_sigc_init(struct ccn_sigc *ctx, const char *digest, const struct ccn_pkey *priv_key)
 {
     const EVP_MD *md;
 
-    EVP_MD_CTX_init(&ctx->context);
+    /* ccn_sigc_create leaves the context in its initialized state */
     md = md_from_digest_and_pkey(digest, priv_key);
+    if (md == NULL)
+        return (-1);
+#ifdef CCN_HMAC_PKEY
+    if (ctx->keyed ||
+          EVP_PKEY_type(((EVP_PKEY *)priv_key)->type) == EVP_PKEY_HMAC) {
+        /* A keyed context holds state for its key; start over */
+        EVP_MD_CTX_cleanup(&ctx->context);
+        ctx->keyed = 0;
+    }
+    if (EVP_PKEY_type(((EVP_PKEY *)priv_key)->type) == EVP_PKEY_HMAC) {
+        if (1 != EVP_DigestSignInit(&ctx->context, NULL, md, NULL,
+                                    (EVP_PKEY *)priv_key))
+            return (-1);
+        ctx->keyed = 1;
+        return (0);
+    }
+#endif
     if (0 == EVP_SignInit_ex(&ctx->context, md, NULL))
         return (-1);
     return (0);
@@ -183,6 +260,16 @@ ccn_sigc_final(struct ccn_sigc *ctx, struct ccn_signature *signature, size_t *si
 {
     unsigned int sig_size;
 
+#ifdef CCN_HMAC_PKEY
+    if (ctx->keyed) {
+        size_t mac_size = EVP_PKEY_size((EVP_PKEY *)priv_key);
+        if (1 != EVP_DigestSignFinal(&ctx->context,
+                                     (unsigned char *)signature, &mac_size))
+            return (-1);
+        *size = mac_size;
+        return (0);
+    }
+#endif
     if (0 == EVP_SignFinal(&ctx->context, (unsigned char *)signature, &sig_size, (EVP_PKEY *)priv_key))
         return (-1);
     *size = sig_size;
@@ -195,6 +282,46 @@ ccn_sigc_signature_max_size(struct ccn_sigc *ctx, const struct ccn_pkey *priv_ke
     return (EVP_PKEY_size((EVP_PKEY *)priv_key));
 }
 
+/**
+ * Sign a SHA-256 digest that has already been computed.
+ *
+ * The signature is the same as the one ccn_sigc_final() would make
+ * for the default digest algorithm, so the message may be digested
+ * somewhere else than where the private key lives.
+ * @param signature must have room for ccn_pubkey_size(priv_key) bytes.
+ * @returns 0 for success, -1 for error.
+ */
+int
+ccn_sign_digest(const struct ccn_pkey *priv_key,
+                const unsigned char *digest, size_t digest_size,
+                unsigned char *signature, size_t *size)
+{
+    EVP_PKEY *pkey = (EVP_PKEY *)priv_key;
+    unsigned int sig_size = 0;
+    int res = 0;
+
+    if (digest_size != SHA256_DIGEST_LENGTH)
+        return (-1);
+    switch (EVP_PKEY_type(pkey->type)) {
+        case EVP_PKEY_RSA:
+            res = RSA_sign(NID_sha256, digest, digest_size,
+                           signature, &sig_size, pkey->pkey.rsa);
+            break;
+#if !defined(OPENSSL_NO_EC)
+        case EVP_PKEY_EC:
+            res = ECDSA_sign(0, digest, digest_size,
+                             signature, &sig_size, pkey->pkey.ec);
+            break;
+#endif
+        default:
+            break;
+    }
+    if (res != 1)
+        return (-1);
+    *size = sig_size;
+    return (0);
+}
+
 #define is_left(x) (0 == (x & 1))
 #define node_lr(x) (x & 1)
 #define sibling_of(x) (x ^ 1)
@@ -277,6 +404,41 @@ int ccn_merkle_root_hash(const unsigned char *msg, size_t size,
     return (0);
 }
 
+#ifdef CCN_HMAC_PKEY
+/**
+ * Check a keyed-hash signature by computing it afresh.
+ * @returns 1 if it matches, 0 if not, -1 for error.
+ */
+static int
+verify_keyed_hash(const EVP_MD *md, EVP_PKEY *pkey,
+                  const unsigned char *data, size_t size,
+                  const unsigned char *sig, size_t sig_size)
+{
+    EVP_MD_CTX ctx;
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    size_t mac_size = sizeof(mac);
+    unsigned char diff = 0;
+    size_t i;
+    int res;
+
+    EVP_MD_CTX_init(&ctx);
+    res = EVP_DigestSignInit(&ctx, NULL, md, NULL, pkey);
+    if (res == 1)
+        res = EVP_DigestSignUpdate(&ctx, data, size);
+    if (res == 1)
+        res = EVP_DigestSignFinal(&ctx, mac, &mac_size);
+    EVP_MD_CTX_cleanup(&ctx);
+    if (res != 1)
+        return (-1);
+    if (mac_size != sig_size)
+        return (0);
+    /* Look at every byte, so the time taken tells nothing */
+    for (i = 0; i < mac_size; i++)
+        diff |= mac[i] ^ sig[i];
+    return (diff == 0);
+}
+#endif
+
 int ccn_verify_signature(const unsigned char *msg,
                      size_t size,
                      const struct ccn_parsed_ContentObject *co,
@@ -329,6 +491,18 @@ int ccn_verify_signature(const unsigned char *msg,
          */
     }
     digest = md_from_digest_and_pkey((const char *)digest_algorithm, verification_pubkey);
+    if (digest == NULL)
+        return (-1);
+#ifdef CCN_HMAC_PKEY
+    if (EVP_PKEY_type(pkey->type) == EVP_PKEY_HMAC) {
+        /* Keyed hashes are not aggregated, so there is no witness */
+        if (co->offset[CCN_PCO_B_Witness] != co->offset[CCN_PCO_E_Witness])
+            return (-1);
+        return (verify_keyed_hash(digest, pkey, msg + co->offset[CCN_PCO_B_Name],
+                                  co->offset[CCN_PCO_E_Content] - co->offset[CCN_PCO_B_Name],
+                                  signature_bits, signature_bits_size));
+    }
+#endif
     EVP_MD_CTX_init(ver_ctx);
     res = EVP_VerifyInit_ex(ver_ctx, digest, NULL);
     if (!res) {
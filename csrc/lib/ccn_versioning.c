@@ -112,8 +112,107 @@ ms_to_tu(int m)
     return ((m * 4096) / 1000);
 }
 
+/**
+ * Marker for a query of a repository's latest-version index.
+ *
+ * An interest for <prefix>/%C1.R.lv/<nonce> is answered by a repository
+ * that holds versions of prefix, with a ContentObject whose content is
+ * the Name of the latest of them.
+ */
+#define LATEST_VERSION_MARKER "\xC1.R.lv"
+
+/**
+ * Ask for the next version, and at the same time ask any repository
+ * for the latest version it knows, returning when either answers.
+ *
+ * The ContentObject for the probe goes in cobj (with pco and ndx),
+ * the answer from the index in lvans.  Either may be left empty.
+ */
+static int
+get_with_index(struct ccn *h, struct ccn_charbuf *prefix,
+               struct ccn_charbuf *templ, int timeout_ms,
+               struct ccn_charbuf *cobj,
+               struct ccn_parsed_ContentObject *pco,
+               struct ccn_indexbuf *ndx,
+               struct ccn_charbuf *lvans, int flags)
+{
+    struct ccn_charbuf *names[2];
+    struct ccn_charbuf *templates[2];
+    struct ccn_charbuf *results[2];
+    struct ccn_charbuf *query = NULL;
+    int res;
+
+    query = ccn_charbuf_create();
+    ccn_charbuf_append_charbuf(query, prefix);
+    ccn_name_append_str(query, LATEST_VERSION_MARKER);
+    ccn_name_append_nonce(query);
+    names[0] = prefix;
+    templates[0] = templ;
+    results[0] = cobj;
+    names[1] = query;
+    templates[1] = NULL;
+    results[1] = lvans;
+    cobj->length = 0;
+    lvans->length = 0;
+    res = ccn_get_batch(h, names, 2, NULL, templates, timeout_ms, results,
+                        pco, ndx, flags | CCN_GET_ANY);
+    ccn_charbuf_destroy(&query);
+    return(res);
+}
+
+/**
+ * Take the version out of an answer from a latest-version index.
+ * @param lvans is the ContentObject.
+ * @param prefix is the ccnb-encoded Name that was asked about,
+ *        with its n components indexed by nix.
+ * @returns 0, with *vers and *vers_size referring into lvans, if the
+ *          answer names a version directly under prefix, or -1.
+ */
+static int
+index_answer_version(struct ccn_charbuf *lvans,
+                     struct ccn_charbuf *prefix, struct ccn_indexbuf *nix,
+                     int n, const unsigned char **vers, size_t *vers_size)
+{
+    struct ccn_parsed_ContentObject pco = { 0 };
+    struct ccn_buf_decoder decoder;
+    struct ccn_buf_decoder *d = NULL;
+    struct ccn_indexbuf *comps = NULL;
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
+    int res;
+
+    res = ccn_parse_ContentObject(lvans->buf, lvans->length, &pco, NULL);
+    if (res < 0 || pco.type != CCN_CONTENT_DATA)
+        return(-1);
+    res = ccn_content_get_value(lvans->buf, lvans->length, &pco,
+                                &data, &data_size);
+    if (res < 0)
+        return(-1);
+    comps = ccn_indexbuf_create();
+    d = ccn_buf_decoder_start(&decoder, data, data_size);
+    res = ccn_parse_Name(d, comps);
+    if (res != n + 1 ||
+        comps->buf[n] - comps->buf[0] != nix->buf[n] - nix->buf[0] ||
+        memcmp(data + comps->buf[0], prefix->buf + nix->buf[0],
+               nix->buf[n] - nix->buf[0]) != 0)
+        res = -1;
+    else
+        res = ccn_name_comp_get(data, comps, n, vers, vers_size);
+    ccn_indexbuf_destroy(&comps);
+    if (res < 0 || *vers_size != 7 || (*vers)[0] != CCN_MARKER_VERSION)
+        return(-1);
+    return(0);
+}
+
 /**
  * Resolve the version, based on existing ccn content.
+ *
+ * The first interest for a version goes out together with a query for
+ * the latest-version index of a repository holding the content, so a
+ * repository-backed name resolves in one round trip with CCN_V_HIGH.
+ * With CCN_V_EST, an index answer no newer than a version already found
+ * ends the search; a newer one gets one more probe past it, waiting only
+ * twice as long as the index took to answer, and the search stops there.
  * @param h is the the ccn handle; it may be NULL, but it is preferable to
  *        use the handle that the client probably already has.
  * @param name is a ccnb-encoded Name prefix. It gets extended in-place with
@@ -138,12 +237,20 @@ ccn_resolve_version(struct ccn *h, struct ccn_charbuf *name,
     struct ccn_charbuf *templ = NULL;
     struct ccn_charbuf *prefix = ccn_charbuf_create();
     struct ccn_charbuf *cobj = ccn_charbuf_create();
+    struct ccn_charbuf *lvans = ccn_charbuf_create();
     struct ccn_parsed_ContentObject *pco = &pco_space;
     struct ccn_indexbuf *ndx = ccn_indexbuf_create();
     const unsigned char *vers = NULL;
     size_t vers_size = 0;
+    const unsigned char *pvers = NULL;
+    size_t pvers_size = 0;
+    const unsigned char *ivers = NULL;
+    size_t ivers_size = 0;
+    unsigned char best[7];
     struct timeval start, prev, now;
     int n;
+    int use_index = 1;
+    int last_round = 0;
     int rtt_max = 0;
     int rtt;
     int ttimeout;
@@ -168,7 +275,6 @@ ccn_resolve_version(struct ccn *h, struct ccn_charbuf *name,
     templ = resolve_templ(templ, lowtime, sizeof(lowtime),
                           ms_to_tu(timeout_ms) * 7 / 8);
     ccn_charbuf_append(prefix, name->buf, name->length); /* our copy */
-    cobj->length = 0;
     gettimeofday(&start, NULL);
     prev = start;
     /*
@@ -177,42 +283,72 @@ ccn_resolve_version(struct ccn *h, struct ccn_charbuf *name,
      * keep sending an Interest, excluding earlier versions, tracking the
      * maximum round trip time and using a timeout of 4*RTT, and an interest
      * lifetime that should get a retransmit.   If there is no response,
-     * return the highest version found so far.
+     * return the highest version found so far.  Once a repository's
+     * latest-version index has answered, there is at most one more
+     * round, with a timeout of 2*RTT, since the index is likely to be
+     * right.  An index answer that is not newer than the highest
+     * version seen confirms it, and ends the search.
      */
-    res = ccn_get(h, prefix, templ, timeout_ms, cobj, pco, ndx, 0);
-    while (cobj->length != 0) {
-        if (pco->type == CCN_CONTENT_NACK) // XXX - also check for number of components
+    res = get_with_index(h, prefix, templ, timeout_ms, cobj, pco, ndx, lvans, 0);
+    for (;;) {
+        vers = NULL;
+        if (cobj->length != 0 && pco->type != CCN_CONTENT_NACK) { // XXX - also check for number of components
+            res = ccn_name_comp_get(cobj->buf, ndx, n, &pvers, &pvers_size);
+            if (res >= 0 && pvers_size == 7 && pvers[0] == CCN_MARKER_VERSION) {
+                vers = pvers;
+                vers_size = pvers_size;
+            }
+        }
+        if (use_index && lvans->length != 0 &&
+            index_answer_version(lvans, prefix, nix, n, &ivers, &ivers_size) == 0) {
+            use_index = 0;
+            if ((myres < 0 || memcmp(ivers, best, 7) > 0) &&
+                (vers == NULL || memcmp(ivers, vers, 7) > 0)) {
+                vers = ivers;
+                vers_size = ivers_size;
+            }
+            if (vers != NULL)
+                last_round = 1;
+        }
+        if (vers == NULL)
             break;
-        res = ccn_name_comp_get(cobj->buf, ndx, n, &vers, &vers_size);
-        if (res < 0)
+        /* Looks like we have versions. */
+        name->length = 0;
+        ccn_charbuf_append(name, prefix->buf, prefix->length);
+        ccn_name_append(name, vers, vers_size);
+        memcpy(best, vers, 7);
+        myres = 0;
+        if ((versioning_flags & CCN_V_EST) == 0 || last_round == 2)
             break;
-        if (vers_size == 7 && vers[0] == CCN_MARKER_VERSION) {
-            /* Looks like we have versions. */
-            name->length = 0;
-            ccn_charbuf_append(name, prefix->buf, prefix->length);
-            ccn_name_append(name, vers, vers_size);
-            myres = 0;
-            if ((versioning_flags & CCN_V_EST) == 0)
-                break;
-            gettimeofday(&now, NULL);
-            rtt = (now.tv_sec - prev.tv_sec) * 1000000 + (now.tv_usec - prev.tv_usec);
-            if (rtt > rtt_max) rtt_max = rtt;
-            prev = now;
-            timeout_ms -= (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
-            if (timeout_ms <= 0)
-                break;
-            ttimeout = timeout_ms < (rtt_max/250) ? timeout_ms : (rtt_max/250);
-            templ = resolve_templ(templ, vers, vers_size, ms_to_tu(ttimeout) * 7 / 8);
-            if (templ == NULL) break;
+        gettimeofday(&now, NULL);
+        rtt = (now.tv_sec - prev.tv_sec) * 1000000 + (now.tv_usec - prev.tv_usec);
+        if (rtt > rtt_max) rtt_max = rtt;
+        prev = now;
+        timeout_ms -= (now.tv_sec - start.tv_sec) * 1000 + (now.tv_usec - start.tv_usec) / 1000;
+        if (timeout_ms <= 0)
+            break;
+        ttimeout = rtt_max / 250;
+        if (last_round) {
+            ttimeout = rtt / 500;
+            last_round = 2;
+        }
+        if (ttimeout > timeout_ms)
+            ttimeout = timeout_ms;
+        templ = resolve_templ(templ, vers, vers_size, ms_to_tu(ttimeout) * 7 / 8);
+        if (templ == NULL) break;
+        if (use_index)
+            res = get_with_index(h, prefix, templ, ttimeout, cobj, pco, ndx,
+                                 lvans, CCN_GET_NOKEYWAIT);
+        else {
             cobj->length = 0;
             res = ccn_get(h, prefix, templ, ttimeout, cobj, pco, ndx,
                           CCN_GET_NOKEYWAIT);
         }
-        else break;
     }
 Finish:
     ccn_charbuf_destroy(&prefix);
     ccn_charbuf_destroy(&cobj);
+    ccn_charbuf_destroy(&lvans);
     ccn_indexbuf_destroy(&ndx);
     ccn_indexbuf_destroy(&nix);
     ccn_charbuf_destroy(&templ);
@@ -0,0 +1,1449 @@
+/**
+ * @file ccn_xmlcodec.c
+ * @brief Streaming conversion between ccnb and its XML representation.
+ *
+ * Part of the CCNx C Library.
+ *
+ * Copyright (C) 2008-2012 Palo Alto Research Center, Inc.
+ *
+ * This library is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License version 2.1
+ * as published by the Free Software Foundation.
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details. You should have received
+ * a copy of the GNU Lesser General Public License along with this library;
+ * if not, write to the Free Software Foundation, Inc., 51 Franklin Street,
+ * Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ccn/charbuf.h>
+#include <ccn/coding.h>
+#include <ccn/hashtb.h>
+#include <ccn/indexbuf.h>
+#include <ccn/xmlcodec.h>
+
+/**
+ * Output is handed over once this much has accumulated.
+ */
+#define CCN_XMLCODEC_OUTBUF_SIZE 65536
+
+struct xmlcodec_sink {
+    struct ccn_charbuf *buf;
+    ccn_xmlcodec_output *out;
+    void *outdata;
+    int err;
+};
+
+static int
+sink_init(struct xmlcodec_sink *k, ccn_xmlcodec_output *out, void *outdata)
+{
+    k->out = out;
+    k->outdata = outdata;
+    k->buf = ccn_charbuf_create();
+    if (k->buf == NULL ||
+        ccn_charbuf_reserve(k->buf, CCN_XMLCODEC_OUTBUF_SIZE) == NULL)
+        return(-1);
+    return(0);
+}
+
+static int
+sink_flush(struct xmlcodec_sink *k)
+{
+    if (k->buf->length > 0 && k->err == 0) {
+        if ((k->out)(k->outdata, k->buf->buf, k->buf->length) < 0)
+            k->err = 1;
+    }
+    k->buf->length = 0;
+    return(k->err ? -1 : 0);
+}
+
+static void
+sink_bytes(struct xmlcodec_sink *k, const void *p, size_t size)
+{
+    if (k->buf->length + size <= CCN_XMLCODEC_OUTBUF_SIZE) {
+        memcpy(k->buf->buf + k->buf->length, p, size);
+        k->buf->length += size;
+        return;
+    }
+    sink_flush(k);
+    if (size >= CCN_XMLCODEC_OUTBUF_SIZE) {
+        if (k->err == 0 && (k->out)(k->outdata, p, size) < 0)
+            k->err = 1;
+        return;
+    }
+    memcpy(k->buf->buf, p, size);
+    k->buf->length = size;
+}
+
+static void
+sink_str(struct xmlcodec_sink *k, const char *s)
+{
+    sink_bytes(k, s, strlen(s));
+}
+
+/**
+ * Room for at least size more bytes, which the caller fills in and
+ * accounts for in k->buf->length.
+ */
+static unsigned char *
+sink_room(struct xmlcodec_sink *k, size_t size)
+{
+    if (k->buf->length + size > CCN_XMLCODEC_OUTBUF_SIZE)
+        sink_flush(k);
+    return(ccn_charbuf_reserve(k->buf, size));
+}
+
+/*
+ * ccnb to XML
+ */
+
+#define CCN_NO_SCHEMA INT_MIN
+#define CCN_UNKNOWN_SCHEMA (INT_MIN+1)
+
+struct ccn_ccnbtoxml_frame {
+    size_t nameindex;           /**< byte index into stringstack */
+    size_t savedss;
+    int saved_schema;
+    int saved_schema_state;
+};
+
+struct ccn_ccnbtoxml {
+    int state;
+    int tagstate;
+    size_t numval;
+    uintmax_t bignumval;
+    int schema;
+    int sstate;
+    int blob_tagged;            /**< BLOB started right after a tag */
+    int annotating;             /**< collecting a Component for a comment */
+    int flags;
+    struct ccn_ccnbtoxml_frame *stack;
+    int nest;
+    int stack_limit;
+    struct ccn_charbuf *stringstack;
+    struct ccn_charbuf *blob;   /**< a BLOB that spans pieces of input */
+    struct ccn_charbuf *annotation;
+    struct hashtb *dtag_names;  /**< DTAG number to name */
+    struct xmlcodec_sink sink;
+};
+
+struct ccn_ccnbtoxml *
+ccn_ccnbtoxml_create(int flags, const struct ccn_dict *dtags,
+                     ccn_xmlcodec_output *out, void *outdata)
+{
+    struct ccn_ccnbtoxml *d;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    int i;
+
+    d = calloc(1, sizeof(*d));
+    if (d == NULL)
+        return(NULL);
+    d->schema = CCN_NO_SCHEMA;
+    d->flags = flags;
+    d->stringstack = ccn_charbuf_create();
+    d->blob = ccn_charbuf_create();
+    d->annotation = ccn_charbuf_create();
+    d->dtag_names = hashtb_create(sizeof(const char *), NULL);
+    if (d->stringstack == NULL || d->blob == NULL || d->annotation == NULL ||
+        d->dtag_names == NULL || sink_init(&d->sink, out, outdata) < 0) {
+        ccn_ccnbtoxml_destroy(&d);
+        return(NULL);
+    }
+    hashtb_start(d->dtag_names, e);
+    for (i = 0; i < dtags->count; i++) {
+        if (hashtb_seek(e, &dtags->dict[i].index, sizeof(int), 0) == HT_NEW_ENTRY)
+            *(const char **)e->data = dtags->dict[i].name;
+    }
+    hashtb_end(e);
+    return(d);
+}
+
+void
+ccn_ccnbtoxml_destroy(struct ccn_ccnbtoxml **dp)
+{
+    struct ccn_ccnbtoxml *d = *dp;
+    if (d != NULL) {
+        if (d->sink.buf != NULL)
+            sink_flush(&d->sink);
+        ccn_charbuf_destroy(&d->sink.buf);
+        ccn_charbuf_destroy(&d->stringstack);
+        ccn_charbuf_destroy(&d->blob);
+        ccn_charbuf_destroy(&d->annotation);
+        hashtb_destroy(&d->dtag_names);
+        free(d->stack);
+        free(d);
+        *dp = NULL;
+    }
+}
+
+int
+ccn_ccnbtoxml_flush(struct ccn_ccnbtoxml *d)
+{
+    return(sink_flush(&d->sink));
+}
+
+int
+ccn_ccnbtoxml_status(struct ccn_ccnbtoxml *d)
+{
+    if (d->state < 0 || d->sink.err)
+        return(-1);
+    if (d->state == 0 && d->nest == 0 && d->tagstate == 0)
+        return(0);
+    return(1);
+}
+
+static struct ccn_ccnbtoxml_frame *
+decoder_push(struct ccn_ccnbtoxml *d)
+{
+    struct ccn_ccnbtoxml_frame *s;
+    int limit;
+
+    if (d->nest == d->stack_limit) {
+        limit = 2 * d->stack_limit + 8;
+        s = realloc(d->stack, limit * sizeof(*s));
+        if (s == NULL)
+            return(NULL);
+        d->stack = s;
+        d->stack_limit = limit;
+    }
+    s = &d->stack[d->nest++];
+    s->nameindex = d->stringstack->length;
+    s->savedss = d->stringstack->length;
+    s->saved_schema = d->schema;
+    s->saved_schema_state = d->sstate;
+    return(s);
+}
+
+static void
+decoder_pop(struct ccn_ccnbtoxml *d)
+{
+    struct ccn_ccnbtoxml_frame *s;
+    if (d->nest > 0) {
+        s = &d->stack[--d->nest];
+        d->stringstack->length = s->savedss;
+        d->schema = s->saved_schema;
+        d->sstate = s->saved_schema_state;
+    }
+}
+
+static const char *
+dtag_name(struct ccn_ccnbtoxml *d, size_t numval)
+{
+    const char **np;
+    int ndx;
+
+    if (numval > INT_MAX)
+        return(NULL);
+    ndx = numval;
+    np = hashtb_lookup(d->dtag_names, &ndx, sizeof(ndx));
+    return(np == NULL ? NULL : *np);
+}
+
+static const char Base64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int
+is_text_encodable(const unsigned char *p, size_t length)
+{
+    size_t i;
+
+    if (length == 0) return (0);
+    for (i = 0; i < length; i++) {
+        unsigned char c = p[i];
+        if (c < ' ' || c > '~') return (0);
+        if (c == '<' || c == '>' || c == '&') return (0);
+    }
+    return (1);
+}
+
+/* c.f. ccn_uri_append_percentescaped */
+static void
+put_percent_escaped(struct xmlcodec_sink *k,
+                    const unsigned char *data, size_t size)
+{
+    size_t i;
+    unsigned char ch;
+    char buf[4];
+    for (i = 0; i < size && data[i] == '.'; i++)
+        continue;
+    /* For a component that consists solely of zero or more dots, add 3 more */
+    if (i == size)
+        sink_str(k, "...");
+    for (i = 0; i < size; i++) {
+        ch = data[i];
+        /*
+         * Leave unescaped only the generic URI unreserved characters.
+         * See RFC 3986. Here we assume the compiler uses ASCII.
+         */
+        if (('a' <= ch && ch <= 'z') ||
+            ('A' <= ch && ch <= 'Z') ||
+            ('0' <= ch && ch <= '9') ||
+            ch == '-' || ch == '.' || ch == '_' || ch == '~')
+            sink_bytes(k, &ch, 1);
+        else {
+            snprintf(buf, sizeof(buf), "%%%02X", (unsigned)ch);
+            sink_bytes(k, buf, 3);
+        }
+    }
+}
+
+static void
+put_hex(struct xmlcodec_sink *k, const unsigned char *p, size_t n)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    unsigned char *o;
+    size_t i, chunk;
+
+    while (n > 0) {
+        chunk = (n > 4096) ? 4096 : n;
+        o = sink_room(k, 2 * chunk);
+        if (o == NULL) {
+            k->err = 1;
+            return;
+        }
+        for (i = 0; i < chunk; i++) {
+            o[2 * i] = hex[p[i] >> 4];
+            o[2 * i + 1] = hex[p[i] & 0xF];
+        }
+        k->buf->length += 2 * chunk;
+        p += chunk;
+        n -= chunk;
+    }
+}
+
+/**
+ * Base64, with a line break after every 64 characters unless
+ * breaks is zero.
+ */
+static void
+put_base64(struct xmlcodec_sink *k, const unsigned char *p, size_t n,
+           int breaks)
+{
+    unsigned char *o;
+    size_t i, lines;
+    unsigned v;
+
+    while (n > 0) {
+        /* 48 bytes make one full line */
+        for (lines = 0; lines < 64 && n >= 48; lines++) {
+            o = sink_room(k, 65);
+            if (o == NULL) {
+                k->err = 1;
+                return;
+            }
+            for (i = 0; i < 48; i += 3, o += 4) {
+                v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+                o[0] = Base64[v >> 18];
+                o[1] = Base64[(v >> 12) & 0x3F];
+                o[2] = Base64[(v >> 6) & 0x3F];
+                o[3] = Base64[v & 0x3F];
+            }
+            k->buf->length += 64;
+            if (breaks) {
+                o[0] = '\n';
+                k->buf->length += 1;
+            }
+            p += 48;
+            n -= 48;
+        }
+        if (n >= 48)
+            continue;
+        if (n == 0)
+            return;
+        o = sink_room(k, 65);
+        if (o == NULL) {
+            k->err = 1;
+            return;
+        }
+        for (i = 0; i + 3 <= n; i += 3, o += 4) {
+            v = (p[i] << 16) | (p[i + 1] << 8) | p[i + 2];
+            o[0] = Base64[v >> 18];
+            o[1] = Base64[(v >> 12) & 0x3F];
+            o[2] = Base64[(v >> 6) & 0x3F];
+            o[3] = Base64[v & 0x3F];
+        }
+        if (i < n) {
+            v = (p[i] << 16) | ((i + 1 < n) ? (p[i + 1] << 8) : 0);
+            o[0] = Base64[v >> 18];
+            o[1] = Base64[(v >> 12) & 0x3F];
+            o[2] = (i + 1 < n) ? Base64[(v >> 6) & 0x3F] : '=';
+            o[3] = '=';
+            i += 3;
+        }
+        k->buf->length += i / 3 * 4;
+        if (breaks && i / 3 * 4 == 64)
+            ccn_charbuf_append_value(k->buf, '\n', 1);
+        return;
+    }
+}
+
+static void
+put_blob(struct ccn_ccnbtoxml *d, const unsigned char *p, size_t n)
+{
+    struct xmlcodec_sink *k = &d->sink;
+    int forced = (d->flags & CCN_CCNBTOXML_FORCE_BINARY) != 0;
+
+    if (d->blob_tagged) {
+        if (!forced && is_text_encodable(p, n)) {
+            sink_str(k, " ccnbencoding=\"text\">");
+            sink_bytes(k, p, n);
+            return;
+        }
+        if ((d->flags & CCN_CCNBTOXML_PREFER_HEX) != 0) {
+            sink_str(k, " ccnbencoding=\"hexBinary\">");
+            put_hex(k, p, n);
+        }
+        else {
+            sink_str(k, " ccnbencoding=\"base64Binary\">");
+            put_base64(k, p, n, !forced);
+        }
+    }
+    else
+        put_base64(k, p, n, !forced);
+    if (d->annotating)
+        ccn_charbuf_append(d->annotation, p, n);
+}
+
+size_t
+ccn_ccnbtoxml_decode(struct ccn_ccnbtoxml *d, const unsigned char *p, size_t n)
+{
+    struct xmlcodec_sink *k = &d->sink;
+    int state = d->state;
+    int tagstate = d->tagstate;
+    size_t numval = d->numval;
+    size_t i = 0;
+    size_t j;
+    unsigned char c;
+    size_t chunk;
+    struct ccn_ccnbtoxml_frame *s;
+    const char *tagname;
+    char buf[64];
+
+    while (i < n) {
+        switch (state) {
+            case 0: /* start new thing */
+                if (tagstate > 1 && tagstate-- == 2) {
+                    sink_str(k, "\""); /* close off the attribute value */
+                    decoder_pop(d);
+                }
+                if (p[i] == CCN_CLOSE) {
+                    i++;
+                    if (d->nest == 0 || tagstate > 1) {
+                        state = -__LINE__;
+                        break;
+                    }
+                    s = &d->stack[d->nest - 1];
+                    if (tagstate == 1) {
+                        tagstate = 0;
+                        sink_str(k, "/>");
+                    }
+                    else if (d->schema == -1-CCN_PROCESSING_INSTRUCTIONS) {
+                        sink_str(k, "?>");
+                        if (d->sstate != 2) {
+                            state = -__LINE__;
+                            break;
+                        }
+                    }
+                    else {
+                        sink_str(k, "</");
+                        sink_str(k, (char *)d->stringstack->buf + s->nameindex);
+                        sink_str(k, ">");
+                    }
+                    if (d->annotating) {
+                        if (d->annotation->length > 0) {
+                            sink_str(k, "<!--       ");
+                            put_percent_escaped(k, d->annotation->buf,
+                                                d->annotation->length);
+                            sink_str(k, " -->");
+                        }
+                        d->annotating = 0;
+                    }
+                    decoder_pop(d);
+                    if (d->nest == 0) {
+                        /* end of a top-level object - let the caller know */
+                        sink_str(k, "\n");
+                        n = i;
+                    }
+                    break;
+                }
+                numval = 0;
+                state = 1;
+                /* FALLTHRU */
+            case 1: /* parsing numval */
+                c = p[i++];
+                if ((c & CCN_TT_HBIT) == CCN_CLOSE) {
+                    if (numval > (numval << 7)) {
+                        state = 9;
+                        d->bignumval = numval;
+                        i--;
+                        continue;
+                    }
+                    numval = (numval << 7) + (c & 127);
+                    if (numval > (numval << (7-CCN_TT_BITS))) {
+                        state = 9;
+                        d->bignumval = numval;
+                    }
+                }
+                else {
+                    numval = (numval << (7-CCN_TT_BITS)) +
+                             ((c >> CCN_TT_BITS) & CCN_MAX_TINY);
+                    c &= CCN_TT_MASK;
+                    switch (c) {
+                        case CCN_EXT:
+                            if (tagstate == 1) {
+                                tagstate = 0;
+                                sink_str(k, ">");
+                            }
+                            if (numval != CCN_PROCESSING_INSTRUCTIONS ||
+                                decoder_push(d) == NULL) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            d->schema = -1-numval;
+                            d->sstate = 0;
+                            sink_str(k, "<?");
+                            state = 0;
+                            break;
+                        case CCN_DTAG:
+                            if (tagstate == 1) {
+                                tagstate = 0;
+                                sink_str(k, ">");
+                            }
+                            s = decoder_push(d);
+                            if (s == NULL) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            d->schema = numval;
+                            d->sstate = 0;
+                            tagname = dtag_name(d, numval);
+                            if (tagname == NULL) {
+                                fprintf(stderr,
+                                        "*** Warning: unrecognized DTAG %lu\n",
+                                        (unsigned long)numval);
+                                ccn_charbuf_append(d->stringstack,
+                                                   "UNKNOWN_DTAG",
+                                                   sizeof("UNKNOWN_DTAG"));
+                                snprintf(buf, sizeof(buf),
+                                         "<UNKNOWN_DTAG code=\"%lu\"",
+                                         (unsigned long)d->schema);
+                                sink_str(k, buf);
+                                d->schema = CCN_UNKNOWN_SCHEMA;
+                            }
+                            else {
+                                ccn_charbuf_append(d->stringstack, tagname,
+                                                   strlen(tagname)+1);
+                                sink_str(k, "<");
+                                sink_str(k, tagname);
+                            }
+                            if ((d->flags & CCN_CCNBTOXML_VERBOSE) != 0 &&
+                                numval == CCN_DTAG_Component) {
+                                d->annotating = 1;
+                                d->annotation->length = 0;
+                            }
+                            tagstate = 1;
+                            state = 0;
+                            break;
+                        case CCN_BLOB:
+                            d->blob_tagged = (tagstate == 1);
+                            if (tagstate == 1)
+                                tagstate = 0;
+                            else
+                                fprintf(stderr, "blob not tagged in xml output\n");
+                            if (numval <= n - i) {
+                                /* all here - no need to copy */
+                                put_blob(d, p + i, numval);
+                                i += numval;
+                                state = 0;
+                                break;
+                            }
+                            d->blob->length = 0;
+                            state = 7;
+                            break;
+                        case CCN_UDATA:
+                            if (tagstate == 1) {
+                                tagstate = 0;
+                                sink_str(k, ">");
+                            }
+                            state = 3;
+                            if (d->schema == -1-CCN_PROCESSING_INSTRUCTIONS) {
+                                if (d->sstate > 0) {
+                                    sink_str(k, " ");
+                                }
+                                state = 6;
+                                d->sstate += 1;
+                            }
+                            if (numval == 0)
+                                state = 0;
+                            break;
+                        case CCN_DATTR:
+                            if (tagstate != 1) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            if (decoder_push(d) == NULL) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            snprintf(buf, sizeof(buf), " UNKNOWN_DATTR_%lu=\"",
+                                     (unsigned long)numval);
+                            sink_str(k, buf);
+                            tagstate = 3;
+                            state = 0;
+                            break;
+                        case CCN_ATTR:
+                            if (tagstate != 1) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            /* FALLTHRU */
+                        case CCN_TAG:
+                            if (tagstate == 1 && c == CCN_TAG) {
+                                tagstate = 0;
+                                sink_str(k, ">");
+                            }
+                            numval += 1; /* encoded as length-1 */
+                            if (numval == 0 || decoder_push(d) == NULL) {
+                                state = -__LINE__;
+                                break;
+                            }
+                            state = (c == CCN_TAG) ? 4 : 5;
+                            break;
+                        default:
+                            state = -__LINE__;
+                    }
+                }
+                break;
+            case 3: /* utf-8 data */
+                chunk = n - i;
+                if (chunk > numval)
+                    chunk = numval;
+                for (j = i; j < i + chunk; j++) {
+                    c = p[j];
+                    if (c == '&' || c == '<' || c == '>' || c == '"' || c == 0)
+                        break;
+                }
+                sink_bytes(k, p + i, j - i);
+                numval -= j - i;
+                i = j;
+                if (numval == 0) {
+                    state = 0;
+                    break;
+                }
+                if (i == n)
+                    break;
+                c = p[i++];
+                if (--numval == 0) {
+                    state = 0;
+                }
+                switch (c) {
+                    case 0:
+                        state = -__LINE__;
+                        break;
+                    case '&':
+                        sink_str(k, "&amp;");
+                        break;
+                    case '<':
+                        sink_str(k, "&lt;");
+                        break;
+                    case '>':
+                        sink_str(k, "&gt;");
+                        break;
+                    case '"':
+                        sink_str(k, "&quot;");
+                        break;
+                }
+                break;
+            case 4: /* parsing tag name */
+            case 5: /* parsing attribute name */
+                chunk = n - i;
+                if (chunk > numval) {
+                    chunk = numval;
+                }
+                ccn_charbuf_append(d->stringstack, p + i, chunk);
+                numval -= chunk;
+                i += chunk;
+                if (numval == 0) {
+                    ccn_charbuf_append(d->stringstack, (const unsigned char *)"\0", 1);
+                    s = &d->stack[d->nest - 1];
+                    if (strlen((char*)d->stringstack->buf + s->nameindex) !=
+                            d->stringstack->length -1 - s->nameindex) {
+                        state = -__LINE__;
+                        break;
+                    }
+                    if (state == 4) {
+                        sink_str(k, "<");
+                        sink_str(k, (char *)d->stringstack->buf + s->nameindex);
+                        tagstate = 1;
+                    }
+                    else {
+                        sink_str(k, " ");
+                        sink_str(k, (char *)d->stringstack->buf + s->nameindex);
+                        sink_str(k, "=\"");
+                        tagstate = 3;
+                    }
+                    state = 0;
+                }
+                break;
+            case 6: /* processing instructions */
+                chunk = n - i;
+                if (chunk > numval)
+                    chunk = numval;
+                sink_bytes(k, p + i, chunk);
+                numval -= chunk;
+                i += chunk;
+                if (numval == 0)
+                    state = 0;
+                break;
+            case 7: /* BLOB that spans pieces of input */
+                chunk = n - i;
+                if (chunk > numval)
+                    chunk = numval;
+                ccn_charbuf_append(d->blob, p + i, chunk);
+                numval -= chunk;
+                i += chunk;
+                if (numval == 0) {
+                    put_blob(d, d->blob->buf, d->blob->length);
+                    state = 0;
+                }
+                break;
+            case 9: /* parsing big numval - cannot be a length anymore */
+                c = p[i++];
+                if ((c & CCN_TT_HBIT) == CCN_CLOSE) {
+                    d->bignumval = (d->bignumval << 7) + (c & 127);
+                }
+                else {
+                    /*
+                     * There's nothing that we actually need the bignumval
+                     * for, so give up.
+                     */
+                    state = -__LINE__;
+                }
+                break;
+            default:
+                n = i;
+        }
+    }
+    d->state = state;
+    d->tagstate = tagstate;
+    d->numval = numval;
+    return(i);
+}
+
+/*
+ * XML to ccnb
+ */
+
+enum xmltoccnb_state {
+    XE_TEXT,                    /**< character data */
+    XE_MARKUP,                  /**< between < and > */
+    XE_ENTITY,                  /**< between & and ; in character data */
+    XE_ERROR
+};
+
+struct ccn_xmltoccnb {
+    enum xmltoccnb_state state;
+    int quote;                  /**< quote character open in a tag */
+    int cr;                     /**< last character was a CR */
+    int line;
+    int flags;
+    int is_base64binary;
+    int is_hexBinary;
+    int is_text;
+    struct ccn_charbuf *openudata;
+    struct ccn_charbuf *tok;    /**< markup, without the < and > */
+    struct ccn_charbuf *attvalue;
+    struct ccn_charbuf *names;  /**< names of the open elements */
+    struct ccn_indexbuf *nameindex;
+    unsigned char ent[16];
+    int entlen;
+    struct hashtb *dtags;       /**< DTAG name to number */
+    struct xmlcodec_sink sink;
+};
+
+struct ccn_xmltoccnb *
+ccn_xmltoccnb_create(int flags, const struct ccn_dict *dtags,
+                     ccn_xmlcodec_output *out, void *outdata)
+{
+    struct ccn_xmltoccnb *u;
+    struct hashtb_enumerator ee;
+    struct hashtb_enumerator *e = &ee;
+    int i;
+
+    u = calloc(1, sizeof(*u));
+    if (u == NULL)
+        return(NULL);
+    u->flags = flags;
+    u->line = 1;
+    u->openudata = ccn_charbuf_create();
+    u->tok = ccn_charbuf_create();
+    u->attvalue = ccn_charbuf_create();
+    u->names = ccn_charbuf_create();
+    u->nameindex = ccn_indexbuf_create();
+    u->dtags = hashtb_create(sizeof(int), NULL);
+    if (u->openudata == NULL || u->tok == NULL || u->attvalue == NULL ||
+        u->names == NULL || u->nameindex == NULL || u->dtags == NULL ||
+        sink_init(&u->sink, out, outdata) < 0) {
+        ccn_xmltoccnb_destroy(&u);
+        return(NULL);
+    }
+    hashtb_start(u->dtags, e);
+    for (i = 0; i < dtags->count; i++) {
+        if (hashtb_seek(e, dtags->dict[i].name,
+                        strlen(dtags->dict[i].name), 0) == HT_NEW_ENTRY)
+            *(int *)e->data = dtags->dict[i].index;
+    }
+    hashtb_end(e);
+    return(u);
+}
+
+void
+ccn_xmltoccnb_destroy(struct ccn_xmltoccnb **up)
+{
+    struct ccn_xmltoccnb *u = *up;
+    if (u != NULL) {
+        if (u->sink.buf != NULL)
+            sink_flush(&u->sink);
+        ccn_charbuf_destroy(&u->sink.buf);
+        ccn_charbuf_destroy(&u->openudata);
+        ccn_charbuf_destroy(&u->tok);
+        ccn_charbuf_destroy(&u->attvalue);
+        ccn_charbuf_destroy(&u->names);
+        ccn_indexbuf_destroy(&u->nameindex);
+        hashtb_destroy(&u->dtags);
+        free(u);
+        *up = NULL;
+    }
+}
+
+int
+ccn_xmltoccnb_line(struct ccn_xmltoccnb *u)
+{
+    return(u->line);
+}
+
+struct base64_decoder {
+    size_t input_processed;
+    size_t result_size;
+    unsigned char *output;
+    size_t output_size;
+    unsigned partial;
+    int phase;
+};
+
+/* "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/" */
+static void
+base64_decode_bytes(struct base64_decoder *d, const void *p, size_t count)
+{
+    size_t i;
+    size_t oi = d->result_size;
+    const char *s = p;
+    unsigned partial = d->partial;
+    unsigned endgame = partial & 0x100;
+    int phase = d->phase;
+    char ch;
+    if (phase < 0)
+        return;
+    for (i = 0; i < count; i++) {
+        ch = s[i];
+        /*
+         * We know we have UTF-8, hence ascii for the characters we care about.
+         * Thus the range checks here are legitimate.
+         */
+        if ('A' <= ch && ch <= 'Z')
+            ch -= 'A';
+        else if ('a' <= ch && ch <= 'z')
+            ch -= 'a' - 26;
+        else if ('0' <= ch && ch <= '9')
+            ch -= '0' - 52;
+        else if (ch == '+')
+            ch = 62;
+        else if (ch == '/')
+            ch = 63;
+        else if (ch == ' ' || ch == '\t' || ch == '\n')
+            continue;
+        else if (ch == '=')
+            if (phase > 4 || (partial & 3) != 0)
+                phase = -1;
+            else {
+                phase -= 2;
+                partial >>= 2;
+                endgame = 0x100;
+                continue;
+            }
+        else {
+            phase = -1;
+            break;
+        }
+        if (endgame != 0) {
+            phase = -1;
+            break;
+        }
+        partial <<= 6;
+        partial |= ch;
+        phase += 6;
+        if (phase >= 8) {
+            if (oi < d->output_size)
+                d->output[oi] = partial >> (phase - 8);
+            oi += 1;
+            phase -= 8;
+        }
+    }
+    d->phase = phase;
+    d->partial = partial & ((1<<6)-1);
+    d->result_size = oi;
+}
+
+static void
+emit_tt(struct ccn_xmltoccnb *u, size_t numval, enum ccn_tt tt)
+{
+    unsigned char buf[1+8*((sizeof(numval)+6)/7)];
+    unsigned char *p = buf + (sizeof(buf)-1);
+    int n = 1;
+    p[0] = (CCN_TT_HBIT & ~CCN_CLOSE) |
+           ((numval & CCN_MAX_TINY) << CCN_TT_BITS) |
+           (CCN_TT_MASK & tt);
+    numval >>= (7-CCN_TT_BITS);
+    while (numval != 0) {
+        (--p)[0] = (((unsigned char)numval) & ~CCN_TT_HBIT) | CCN_CLOSE;
+        n++;
+        numval >>= 7;
+    }
+    sink_bytes(&u->sink, p, n);
+}
+
+static int
+all_whitespace(struct ccn_charbuf *b)
+{
+    size_t i;
+    size_t n = b->length;
+    for (i = 0; i < n; i++) {
+        switch (b->buf[i]) {
+            case ' ':
+            case '\t':
+            case '\n':
+                continue;
+        }
+        return(0);
+    }
+    return(1);
+}
+
+static void
+finish_openudata(struct ccn_xmltoccnb *u)
+{
+    if (u->is_base64binary) {
+        unsigned char *obuf = NULL;
+        ssize_t len = -1;
+        size_t maxbinlen = u->openudata->length * 3 / 4 + 4;
+        struct base64_decoder d = { 0 };
+        u->is_base64binary = 0;
+        obuf = ccn_charbuf_reserve(u->openudata, maxbinlen);
+        if (obuf != NULL) {
+            d.output = obuf;
+            d.output_size = maxbinlen;
+            base64_decode_bytes(&d, u->openudata->buf, u->openudata->length);
+            if (d.phase == 0 && d.result_size <= d.output_size)
+                len = d.result_size;
+        }
+        if (len == -1) {
+            fprintf(stderr,
+                "could not decode base64binary, leaving as character data\n");
+        }
+        else {
+            emit_tt(u, len, CCN_BLOB);
+            sink_bytes(&u->sink, obuf, len);
+            u->openudata->length = 0;
+            return;
+        }
+    }
+    else if (u->is_hexBinary) {
+        size_t maxbinlen = (u->openudata->length + 1)/2;
+        unsigned char *obuf = NULL;
+        int v = -1;
+        size_t i;
+        size_t j = 0;
+        unsigned char ch;
+        u->is_hexBinary = 0;
+        obuf = ccn_charbuf_reserve(u->openudata, maxbinlen);
+        if (obuf != NULL) {
+            for (v = 1, i = 0, j = 0; v > 0 && i < u->openudata->length; i++) {
+                ch = u->openudata->buf[i];
+                if (ch <= ' ')
+                    continue;
+                v = (v << 4) + (('0' <= ch && ch <= '9') ? (ch - '0') :
+                                ('A' <= ch && ch <= 'F') ? (ch - 'A' + 10) :
+                                ('a' <= ch && ch <= 'f') ? (ch - 'a' + 10) :
+                                -1024);
+                if (v > 255) {
+                    if (j >= maxbinlen)
+                        break;
+                    obuf[j++] = v & 255;
+                    v = 1;
+                }
+            }
+        }
+        if (v != 1) {
+            fprintf(stderr,
+                    "could not decode hexBinary, leaving as character data\n");
+        }
+        else {
+            emit_tt(u, j, CCN_BLOB);
+            sink_bytes(&u->sink, obuf, j);
+            u->openudata->length = 0;
+            return;
+        }
+    }
+    else if (u->is_text) {
+        u->is_text = 0;
+        emit_tt(u, u->openudata->length, CCN_BLOB);
+        sink_bytes(&u->sink, u->openudata->buf, u->openudata->length);
+        u->openudata->length = 0;
+        return;
+    }
+    if (u->openudata->length != 0) {
+        if (!((u->flags & CCN_XMLTOCCNB_TOSS_WHITE) != 0 &&
+              all_whitespace(u->openudata))) {
+            emit_tt(u, u->openudata->length, CCN_UDATA);
+            sink_bytes(&u->sink, u->openudata->buf, u->openudata->length);
+        }
+        u->openudata->length = 0;
+    }
+}
+
+/**
+ * Between top-level elements only whitespace is allowed, and it is dropped.
+ */
+static int
+finish_toplevel_text(struct ccn_xmltoccnb *u)
+{
+    int res = all_whitespace(u->openudata) ? 0 : -1;
+    u->openudata->length = 0;
+    return(res);
+}
+
+static void
+emit_name(struct ccn_xmltoccnb *u, enum ccn_tt tt,
+          const unsigned char *name, size_t length)
+{
+    int *dictindex;
+
+    finish_openudata(u);
+    if (tt == CCN_TAG) {
+        dictindex = hashtb_lookup(u->dtags, name, length);
+        if (dictindex != NULL) {
+            emit_tt(u, *dictindex, CCN_DTAG);
+            return;
+        }
+    }
+    emit_tt(u, length-1, tt);
+    sink_bytes(&u->sink, name, length);
+}
+
+static void
+emit_xchars(struct ccn_xmltoccnb *u, const unsigned char *xchars, size_t length)
+{
+    finish_openudata(u);
+    emit_tt(u, length, CCN_UDATA);
+    sink_bytes(&u->sink, xchars, length);
+}
+
+static void
+emit_closer(struct ccn_xmltoccnb *u)
+{
+    static const unsigned char closer[] = { CCN_CLOSE };
+    finish_openudata(u);
+    sink_bytes(&u->sink, closer, sizeof(closer));
+}
+
+/**
+ * Append the UTF-8 for an entity reference, given what is between
+ * the & and the ;.
+ */
+static int
+append_entity(struct ccn_charbuf *c, const unsigned char *e, size_t len)
+{
+    unsigned long v = 0;
+    unsigned char u[4];
+    size_t i;
+    int n;
+
+    if (len == 3 && memcmp(e, "amp", 3) == 0)
+        return(ccn_charbuf_append_value(c, '&', 1));
+    if (len == 2 && memcmp(e, "lt", 2) == 0)
+        return(ccn_charbuf_append_value(c, '<', 1));
+    if (len == 2 && memcmp(e, "gt", 2) == 0)
+        return(ccn_charbuf_append_value(c, '>', 1));
+    if (len == 4 && memcmp(e, "quot", 4) == 0)
+        return(ccn_charbuf_append_value(c, '"', 1));
+    if (len == 4 && memcmp(e, "apos", 4) == 0)
+        return(ccn_charbuf_append_value(c, '\'', 1));
+    if (len < 2 || e[0] != '#')
+        return(-1);
+    if (e[1] == 'x') {
+        if (len < 3)
+            return(-1);
+        for (i = 2; i < len && v <= 0x10FFFF; i++) {
+            if ('0' <= e[i] && e[i] <= '9') v = v * 16 + e[i] - '0';
+            else if ('a' <= e[i] && e[i] <= 'f') v = v * 16 + e[i] - 'a' + 10;
+            else if ('A' <= e[i] && e[i] <= 'F') v = v * 16 + e[i] - 'A' + 10;
+            else return(-1);
+        }
+    }
+    else {
+        for (i = 1; i < len && v <= 0x10FFFF; i++) {
+            if ('0' <= e[i] && e[i] <= '9') v = v * 10 + e[i] - '0';
+            else return(-1);
+        }
+    }
+    if (v == 0 || v > 0x10FFFF || (0xD800 <= v && v <= 0xDFFF))
+        return(-1);
+    if (v < 0x80) {
+        u[0] = v;
+        n = 1;
+    }
+    else if (v < 0x800) {
+        u[0] = 0xC0 | (v >> 6);
+        u[1] = 0x80 | (v & 0x3F);
+        n = 2;
+    }
+    else if (v < 0x10000) {
+        u[0] = 0xE0 | (v >> 12);
+        u[1] = 0x80 | ((v >> 6) & 0x3F);
+        u[2] = 0x80 | (v & 0x3F);
+        n = 3;
+    }
+    else {
+        u[0] = 0xF0 | (v >> 18);
+        u[1] = 0x80 | ((v >> 12) & 0x3F);
+        u[2] = 0x80 | ((v >> 6) & 0x3F);
+        u[3] = 0x80 | (v & 0x3F);
+        n = 4;
+    }
+    return(ccn_charbuf_append(c, u, n));
+}
+
+static int
+is_xml_space(unsigned char c)
+{
+    return(c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+/**
+ * Decide whether the > just seen ends the markup in u->tok.
+ */
+static int
+markup_complete(struct ccn_xmltoccnb *u)
+{
+    const unsigned char *b = u->tok->buf;
+    size_t len = u->tok->length;
+    size_t i;
+    int depth;
+
+    if (len >= 3 && memcmp(b, "!--", 3) == 0)
+        return(len >= 5 && b[len - 1] == '-' && b[len - 2] == '-');
+    if (len >= 8 && memcmp(b, "![CDATA[", 8) == 0)
+        return(len >= 10 && b[len - 1] == ']' && b[len - 2] == ']');
+    if (len > 0 && b[0] == '?')
+        return(len >= 2 && b[len - 1] == '?');
+    if (len > 0 && b[0] == '!') {
+        if (len < 3 && memcmp(b, "!--", len) == 0)
+            return(0);
+        if (len < 8 && memcmp(b, "![CDATA[", len) == 0)
+            return(0);
+        /* a DOCTYPE may have an internal subset in brackets */
+        for (depth = 0, i = 0; i < len; i++)
+            depth += (b[i] == '[') - (b[i] == ']');
+        return(depth <= 0);
+    }
+    return(u->quote == 0);
+}
+
+static int
+process_pi(struct ccn_xmltoccnb *u, const unsigned char *b, size_t len)
+{
+    size_t t, d;
+
+    /* b is the text between <? and ?> */
+    for (t = 0; t < len && !is_xml_space(b[t]); t++)
+        continue;
+    if (t == 0)
+        return(-1);
+    for (d = t; d < len && is_xml_space(b[d]); d++)
+        continue;
+    if (t == 3 && memcmp(b, "xml", 3) == 0)
+        return(0); /* XML declaration */
+    if (u->nameindex->n == 0) {
+        if (finish_toplevel_text(u) < 0)
+            return(-1);
+    }
+    else
+        finish_openudata(u);
+    emit_tt(u, CCN_PROCESSING_INSTRUCTIONS, CCN_EXT);
+    emit_xchars(u, b, t);
+    emit_xchars(u, b + d, len - d);
+    emit_closer(u);
+    return(0);
+}
+
+static int
+process_end_tag(struct ccn_xmltoccnb *u, const unsigned char *b, size_t len)
+{
+    size_t i, top;
+    const unsigned char *name;
+
+    /* b is the text between </ and > */
+    for (i = 0; i < len && !is_xml_space(b[i]); i++)
+        continue;
+    if (u->nameindex->n == 0)
+        return(-1);
+    top = u->nameindex->buf[u->nameindex->n - 1];
+    name = u->names->buf + top;
+    if (i != u->names->length - top || memcmp(name, b, i) != 0)
+        return(-1);
+    for (; i < len; i++)
+        if (!is_xml_space(b[i]))
+            return(-1);
+    emit_closer(u);
+    u->names->length = top;
+    u->nameindex->n--;
+    return(0);
+}
+
+static int
+process_start_tag(struct ccn_xmltoccnb *u, const unsigned char *b, size_t len)
+{
+    int is_base64binary = 0;
+    int is_hexBinary = 0;
+    int is_text = 0;
+    int empty = 0;
+    size_t i, j, name, namelen, v;
+    unsigned char q;
+
+    /* b is the text between < and > */
+    if (len > 0 && b[len - 1] == '/') {
+        empty = 1;
+        len--;
+    }
+    for (i = 0; i < len && !is_xml_space(b[i]); i++)
+        if (b[i] == '=' || b[i] == '"' || b[i] == '\'')
+            return(-1);
+    if (i == 0)
+        return(-1);
+    if (u->nameindex->n == 0 && finish_toplevel_text(u) < 0)
+        return(-1);
+    emit_name(u, CCN_TAG, b, i);
+    ccn_indexbuf_append_element(u->nameindex, u->names->length);
+    ccn_charbuf_append(u->names, b, i);
+    for (;;) {
+        while (i < len && is_xml_space(b[i]))
+            i++;
+        if (i == len)
+            break;
+        for (name = i; i < len && !is_xml_space(b[i]) && b[i] != '='; i++)
+            if (b[i] == '"' || b[i] == '\'')
+                return(-1);
+        namelen = i - name;
+        while (i < len && is_xml_space(b[i]))
+            i++;
+        if (namelen == 0 || i == len || b[i] != '=')
+            return(-1);
+        for (i++; i < len && is_xml_space(b[i]); i++)
+            continue;
+        if (i == len || (b[i] != '"' && b[i] != '\''))
+            return(-1);
+        q = b[i++];
+        /* Normalize the value - entities expanded, whitespace to spaces */
+        u->attvalue->length = 0;
+        for (v = i; i < len && b[i] != q; i++) {
+            if (b[i] == '&') {
+                ccn_charbuf_append(u->attvalue, b + v, i - v);
+                for (j = i + 1; j < len && b[j] != ';' && b[j] != q; j++)
+                    continue;
+                if (j == len || b[j] != ';' ||
+                    append_entity(u->attvalue, b + i + 1, j - i - 1) < 0)
+                    return(-1);
+                i = j;
+                v = j + 1;
+            }
+            else if (b[i] == '<')
+                return(-1);
+            else if (b[i] == '\t' || b[i] == '\n') {
+                ccn_charbuf_append(u->attvalue, b + v, i - v);
+                ccn_charbuf_append_value(u->attvalue, ' ', 1);
+                v = i + 1;
+            }
+        }
+        if (i == len)
+            return(-1);
+        ccn_charbuf_append(u->attvalue, b + v, i - v);
+        i++;
+        if (i < len && !is_xml_space(b[i]))
+            return(-1);
+        ccn_charbuf_as_string(u->attvalue);
+        if (namelen == 12 && memcmp(b + name, "ccnbencoding", 12) == 0) {
+            if (0 == strcmp((char *)u->attvalue->buf, "base64Binary")) {
+                is_base64binary = 1;
+                continue;
+            }
+            if (0 == strcmp((char *)u->attvalue->buf, "hexBinary")) {
+                is_hexBinary = 1;
+                continue;
+            }
+            if (0 == strcmp((char *)u->attvalue->buf, "text")) {
+                is_text = 1;
+                continue;
+            }
+            fprintf(stderr, "warning - unknown ccnbencoding found (%s)\n",
+                    (char *)u->attvalue->buf);
+        }
+        emit_name(u, CCN_ATTR, b + name, namelen);
+        emit_xchars(u, u->attvalue->buf, u->attvalue->length);
+    }
+    u->is_base64binary = is_base64binary;
+    u->is_hexBinary = is_hexBinary;
+    u->is_text = is_text;
+    if (empty)
+        return(process_end_tag(u, u->names->buf +
+                               u->nameindex->buf[u->nameindex->n - 1],
+                               u->names->length -
+                               u->nameindex->buf[u->nameindex->n - 1]));
+    return(0);
+}
+
+static int
+process_markup(struct ccn_xmltoccnb *u)
+{
+    const unsigned char *b = u->tok->buf;
+    size_t len = u->tok->length;
+
+    if (len == 0)
+        return(-1);
+    if (len >= 3 && memcmp(b, "!--", 3) == 0)
+        return(0);
+    if (len >= 8 && memcmp(b, "![CDATA[", 8) == 0) {
+        ccn_charbuf_append(u->openudata, b + 8, len - 10);
+        return(0);
+    }
+    if (b[0] == '!')
+        return(0); /* DOCTYPE - nothing we need from it */
+    if (b[0] == '?')
+        return(process_pi(u, b + 1, len - 2));
+    if (b[0] == '/')
+        return(process_end_tag(u, b + 1, len - 1));
+    return(process_start_tag(u, b, len));
+}
+
+int
+ccn_xmltoccnb_encode(struct ccn_xmltoccnb *u, const unsigned char *p, size_t n)
+{
+    size_t i = 0;
+    size_t j;
+    unsigned char c;
+    struct ccn_charbuf *dst;
+
+    while (i < n && u->state != XE_ERROR) {
+        dst = (u->state == XE_MARKUP) ? u->tok : u->openudata;
+        switch (u->state) {
+            case XE_TEXT:
+                for (j = i; j < n; j++) {
+                    c = p[j];
+                    if (c == '<' || c == '&' || c == '\r' || c == '\n')
+                        break;
+                }
+                break;
+            case XE_MARKUP:
+                for (j = i; j < n; j++) {
+                    c = p[j];
+                    if (c == '>' || c == '"' || c == '\'' || c == '\r' || c == '\n')
+                        break;
+                }
+                break;
+            case XE_ENTITY:
+                c = p[i++];
+                if (c == ';') {
+                    if (append_entity(u->openudata, u->ent, u->entlen) < 0)
+                        u->state = XE_ERROR;
+                    else
+                        u->state = XE_TEXT;
+                }
+                else if (u->entlen == sizeof(u->ent) || c == '<' || c == '&' ||
+                         is_xml_space(c))
+                    u->state = XE_ERROR;
+                else
+                    u->ent[u->entlen++] = c;
+                continue;
+            default:
+                continue;
+        }
+        if (j > i) {
+            ccn_charbuf_append(dst, p + i, j - i);
+            u->cr = 0;
+            i = j;
+        }
+        if (i == n)
+            break;
+        c = p[i++];
+        switch (c) {
+            case '\r':
+                ccn_charbuf_append_value(dst, '\n', 1);
+                u->line++;
+                u->cr = 1;
+                continue;
+            case '\n':
+                if (!u->cr) {
+                    ccn_charbuf_append_value(dst, '\n', 1);
+                    u->line++;
+                }
+                u->cr = 0;
+                continue;
+        }
+        u->cr = 0;
+        if (u->state == XE_TEXT) {
+            if (c == '<') {
+                u->tok->length = 0;
+                u->quote = 0;
+                u->state = XE_MARKUP;
+            }
+            else {
+                u->entlen = 0;
+                u->state = XE_ENTITY;
+            }
+            continue;
+        }
+        /* in markup */
+        if (c == '>' && markup_complete(u)) {
+            u->state = (process_markup(u) < 0) ? XE_ERROR : XE_TEXT;
+            continue;
+        }
+        if ((c == '"' || c == '\'') && u->tok->length > 0 &&
+            u->tok->buf[0] != '!' && u->tok->buf[0] != '?') {
+            if (u->quote == 0)
+                u->quote = c;
+            else if (u->quote == c)
+                u->quote = 0;
+        }
+        ccn_charbuf_append_value(u->tok, c, 1);
+    }
+    if (u->state == XE_ERROR || u->sink.err)
+        return(-1);
+    return(0);
+}
+
+int
+ccn_xmltoccnb_finish(struct ccn_xmltoccnb *u)
+{
+    if (u->state != XE_TEXT || u->nameindex->n != 0 ||
+        finish_toplevel_text(u) < 0)
+        u->state = XE_ERROR;
+    if (sink_flush(&u->sink) < 0 || u->state == XE_ERROR)
+        return(-1);
+    return(0);
+}
@@ -0,0 +1,429 @@
+/**
+ * @file crawltest.c
+ *
+ * A test program for the namespace crawler.
+ *
+ * Generates a tree of content objects, some of which are named by
+ * components that have further names below them, and answers the
+ * crawler's interests with the leftmost matching object, as a repository
+ * would.  Every object must be found exactly once, and the walk must
+ * visit them in canonical order.  Reports the crawl rate with different
+ * numbers of initial partitions.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/ccn_private.h>
+#include <ccn/charbuf.h>
+#include <ccn/crawl.h>
+#include <ccn/indexbuf.h>
+#include <ccn/keystore.h>
+#include <ccn/uri.h>
+
+#define COUNT 2000
+#define WINDOW 1024
+#define MAX_LEVELS 8
+#define LATENCY_US 2000
+
+struct object {
+    struct ccn_charbuf *ccnb;
+    struct ccn_charbuf *name;   /* including the implicit digest */
+    struct ccn_parsed_ContentObject pco;
+    struct ccn_indexbuf *comps; /* of name */
+    int skip[MAX_LEVELS];       /* next object differing in component i */
+    int seen;
+};
+
+struct receiver {
+    struct ccn_closure cl;
+    int found;
+    int errors;
+    int finals;
+};
+
+/* an answer waiting to be delivered */
+struct held {
+    int x;
+    struct timeval due;
+};
+
+struct walk_check {
+    int n;
+    int errors;
+};
+
+static struct object *objects;
+static int n_objects;
+static int latency_us = LATENCY_US;
+
+static int
+compare_objects(const void *a, const void *b)
+{
+    const struct object *aa = a;
+    const struct object *bb = b;
+    return(ccn_compare_names(aa->name->buf, aa->name->length,
+                             bb->name->buf, bb->name->length));
+}
+
+/*
+ * Append the name of a content object, with its digest, to c.
+ */
+static void
+full_name(struct ccn_charbuf *c, const unsigned char *ccnb,
+          struct ccn_parsed_ContentObject *pco, struct ccn_indexbuf *comps)
+{
+    ccn_name_init(c);
+    ccn_name_append_components(c, ccnb, comps->buf[0], comps->buf[comps->n - 1]);
+    ccn_digest_ContentObject(ccnb, pco);
+    ccn_name_append(c, pco->digest, pco->digest_bytes);
+}
+
+static int
+find_object(struct ccn_charbuf *name)
+{
+    struct object key;
+    struct object *p;
+
+    key.name = name;
+    p = bsearch(&key, objects, n_objects, sizeof(objects[0]), &compare_objects);
+    return(p == NULL ? -1 : p - objects);
+}
+
+static enum ccn_upcall_res
+incoming(struct ccn_closure *selfp,
+         enum ccn_upcall_kind kind,
+         struct ccn_upcall_info *info)
+{
+    struct receiver *r = selfp->data;
+    struct ccn_charbuf *name = NULL;
+    int i;
+
+    switch (kind) {
+        case CCN_UPCALL_FINAL:
+            r->finals++;
+            return(CCN_UPCALL_RESULT_OK);
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+            break;
+        default:
+            r->errors++;
+            return(CCN_UPCALL_RESULT_ERR);
+    }
+    name = ccn_charbuf_create();
+    full_name(name, info->content_ccnb, info->pco, info->content_comps);
+    i = find_object(name);
+    if (i < 0 || objects[i].seen++ != 0) {
+        fprintf(stderr, "object %d unknown or found twice\n", i);
+        r->errors++;
+    }
+    r->found++;
+    ccn_charbuf_destroy(&name);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+static int
+check_walk(void *data, const unsigned char *name, size_t size)
+{
+    struct walk_check *w = data;
+
+    if (w->n >= n_objects || size != objects[w->n].name->length ||
+        memcmp(name, objects[w->n].name->buf, size) != 0) {
+        fprintf(stderr, "walk out of order at %d\n", w->n);
+        w->errors++;
+        return(1);
+    }
+    w->n++;
+    return(0);
+}
+
+static void
+add_object(struct ccn_charbuf *name, struct ccn_keystore *keystore,
+           struct ccn_charbuf *signed_info)
+{
+    struct object *p = &objects[n_objects++];
+    struct ccn_indexbuf *comps = ccn_indexbuf_create();
+    int res;
+
+    p->ccnb = ccn_charbuf_create();
+    res = ccn_encode_ContentObject(p->ccnb, name, signed_info,
+                                   "crawl", 5, NULL,
+                                   ccn_keystore_private_key(keystore));
+    if (res == 0)
+        res = ccn_parse_ContentObject(p->ccnb->buf, p->ccnb->length, &p->pco, comps);
+    if (res < 0) {
+        fprintf(stderr, "Failed to encode ContentObject\n");
+        exit(1);
+    }
+    p->name = ccn_charbuf_create();
+    full_name(p->name, p->ccnb->buf, &p->pco, comps);
+    comps->n = 0;
+    ccn_name_split(p->name, comps);
+    p->comps = comps;
+}
+
+/*
+ * Note, for each object and level, where the objects with the same
+ * components up to that level end, so an answer can skip excluded names
+ * as a repository would.
+ */
+static void
+make_skips(void)
+{
+    struct ccn_indexbuf *a, *b;
+    int i, l;
+
+    for (i = n_objects - 1; i >= 0; i--) {
+        a = objects[i].comps;
+        for (l = 0; l < MAX_LEVELS; l++) {
+            objects[i].skip[l] = i + 1;
+            if (i + 1 == n_objects || l + 1 >= (int)a->n)
+                continue;
+            b = objects[i + 1].comps;
+            if (l + 1 < (int)b->n && a->buf[l + 1] == b->buf[l + 1] &&
+                memcmp(objects[i].name->buf, objects[i + 1].name->buf,
+                       a->buf[l + 1]) == 0)
+                objects[i].skip[l] = objects[i + 1].skip[l];
+        }
+    }
+}
+
+/*
+ * Make count objects in a tree of three levels.  The top level mixes
+ * text, binary, and one-byte components (including '?', which is the
+ * first fence); every seventh of its components also names an object.
+ */
+static void
+make_objects(struct ccn_charbuf *prefix, int count)
+{
+    struct ccn_keystore *keystore = ccn_keystore_create();
+    struct ccn_charbuf *signed_info = ccn_charbuf_create();
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    const char *keystore_name = "test.keystore";
+    const char *keystore_password = "Th1s1sn0t8g00dp8ssw0rd.";
+    unsigned char comp[8];
+    char text[32];
+    int top, i, res;
+    size_t len;
+
+    res = ccn_keystore_init(keystore, (char *)keystore_name, (char *)keystore_password);
+    if (res != 0) {
+        res = ccn_keystore_file_init((char *)keystore_name, (char *)keystore_password,
+                                     "ccnxuser", 0, 3650);
+        if (res == 0)
+            res = ccn_keystore_init(keystore, (char *)keystore_name,
+                                    (char *)keystore_password);
+        if (res != 0) {
+            fprintf(stderr, "Cannot create keystore %s\n", keystore_name);
+            exit(1);
+        }
+    }
+    res = ccn_signed_info_create(signed_info,
+                                 ccn_keystore_public_key_digest(keystore),
+                                 ccn_keystore_public_key_digest_length(keystore),
+                                 NULL, CCN_CONTENT_DATA, -1, NULL, NULL);
+    if (res < 0) {
+        fprintf(stderr, "Failed to create signed_info\n");
+        exit(1);
+    }
+    objects = calloc(count + count / 7 + 1, sizeof(objects[0]));
+    for (i = 0; i < count; i++) {
+        top = i / 50;
+        name->length = 0;
+        ccn_charbuf_append_charbuf(name, prefix);
+        switch (top % 3) {
+            case 0:
+                len = snprintf(text, sizeof(text), "dir%d", top);
+                ccn_name_append(name, text, len);
+                break;
+            case 1:
+                comp[0] = CCN_MARKER_VERSION;
+                comp[1] = top >> 8;
+                comp[2] = top;
+                ccn_name_append(name, comp, 3);
+                break;
+            default:
+                comp[0] = (top == 2) ? '?' : (top * 37) & 0xFF;
+                ccn_name_append(name, comp, 1);
+        }
+        if (i % 50 == 0 && top % 7 == 0)
+            add_object(name, keystore, signed_info);
+        len = snprintf(text, sizeof(text), "file%d", (i / 10) % 5);
+        ccn_name_append(name, text, len);
+        ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i % 10);
+        add_object(name, keystore, signed_info);
+    }
+    qsort(objects, n_objects, sizeof(objects[0]), &compare_objects);
+    make_skips();
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&signed_info);
+    ccn_keystore_destroy(&keystore);
+}
+
+/*
+ * Answer an interest with the leftmost object that matches it, if any.
+ */
+static int
+answer(const unsigned char *interest, size_t size)
+{
+    struct ccn_parsed_interest pi = {0};
+    const unsigned char *prefix;
+    size_t prefix_size;
+    int lo, hi, mid;
+
+    if (ccn_parse_interest(interest, size, &pi, NULL) < 0)
+        return(-1);
+    prefix = interest + pi.offset[CCN_PI_B_Name];
+    prefix_size = pi.offset[CCN_PI_E_Name] - pi.offset[CCN_PI_B_Name];
+    for (lo = 0, hi = n_objects; lo < hi;) {
+        mid = (lo + hi) / 2;
+        if (ccn_compare_names(objects[mid].name->buf, objects[mid].name->length,
+                              prefix, prefix_size) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    /* the objects under the prefix follow; all but the closer must match */
+    for (; lo < n_objects; lo = objects[lo].skip[pi.prefix_comps]) {
+        if (objects[lo].name->length < prefix_size ||
+            memcmp(objects[lo].name->buf, prefix, prefix_size - 1) != 0)
+            break;
+        if (ccn_content_matches_interest(objects[lo].ccnb->buf,
+                                         objects[lo].ccnb->length, 1,
+                                         &objects[lo].pco,
+                                         interest, size, &pi))
+            return(lo);
+    }
+    return(-1);
+}
+
+static int
+run(struct ccn_charbuf *prefix, int partitions, int window)
+{
+    struct ccn *h = ccn_create();
+    struct ccn_charbuf *out = NULL;
+    struct ccn_crawl *c = NULL;
+    struct ccn_crawl_stats stats = {0};
+    struct receiver rr = {{0}};
+    struct receiver *r = &rr;
+    struct walk_check w = {0};
+    struct ccn_skeleton_decoder dd;
+    struct ccn_charbuf *held = ccn_charbuf_create();
+    struct held *p;
+    struct timeval t0, t1, now;
+    size_t start;
+    size_t taken = 0;
+    double elapsed;
+    int i, n, x;
+
+    for (i = 0; i < n_objects; i++)
+        objects[i].seen = 0;
+    r->cl.p = &incoming;
+    r->cl.data = r;
+    c = ccn_crawl_create(h, prefix, 0, &r->cl);
+    if (c == NULL || ccn_crawl_set_partitions(c, partitions) < 0 ||
+        ccn_crawl_set_window(c, window) < 0) {
+        fprintf(stderr, "ccn_crawl_create failed\n");
+        exit(1);
+    }
+    gettimeofday(&t0, NULL);
+    ccn_crawl_start(c);
+    for (ccn_crawl_get_stats(c, &stats); !stats.done; ccn_crawl_get_stats(c, &stats)) {
+        ccn_process_scheduled_operations(h);
+        out = ccn_grab_buffered_output(h);
+        gettimeofday(&now, NULL);
+        for (start = 0; out != NULL && start < out->length; start += dd.index) {
+            memset(&dd, 0, sizeof(dd));
+            ccn_skeleton_decode(&dd, out->buf + start, out->length - start);
+            if (!CCN_FINAL_DSTATE(dd.state))
+                break;
+            x = answer(out->buf + start, dd.index);
+            if (x < 0)
+                continue;
+            /* hold the answer for the latency of the link */
+            p = (struct held *)ccn_charbuf_reserve(held, sizeof(*p));
+            p->x = x;
+            p->due.tv_sec = now.tv_sec + (now.tv_usec + latency_us) / 1000000;
+            p->due.tv_usec = (now.tv_usec + latency_us) % 1000000;
+            held->length += sizeof(*p);
+        }
+        ccn_charbuf_destroy(&out);
+        for (n = 0; taken < held->length; taken += sizeof(*p), n++) {
+            p = (struct held *)(held->buf + taken);
+            if (timercmp(&p->due, &now, >))
+                break;
+            x = p->x;
+            ccn_dispatch_message(h, objects[x].ccnb->buf, objects[x].ccnb->length);
+        }
+        if (taken == held->length)
+            held->length = taken = 0;
+        if (n == 0)
+            usleep(500);
+    }
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    printf("partitions %2d: %ju objects in %.3f s, %.0f objects/s, "
+           "%ju nodes, %ju expressed, %ju timeouts, %ju empty ranges, "
+           "window %d\n",
+           partitions, stats.found, elapsed, stats.found / elapsed,
+           stats.nodes, stats.expressed, stats.timeouts, stats.empty,
+           stats.window);
+    ccn_crawl_walk(c, &check_walk, &w);
+    ccn_crawl_destroy(&c);
+    ccn_destroy(&h);
+    ccn_charbuf_destroy(&held);
+    if (r->found != n_objects || r->errors != 0 || r->finals != 1 ||
+        w.n != n_objects || w.errors != 0) {
+        fprintf(stderr, "FAILED: %d of %d found, %d errors, %d finals, "
+                "%d walked\n", r->found, n_objects, r->errors, r->finals, w.n);
+        return(1);
+    }
+    return(0);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int partitions[] = {1, 5, 17, 33, 65, -1};
+    struct ccn_charbuf *prefix = ccn_charbuf_create();
+    int count = COUNT;
+    int status = 0;
+    int i;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+    if (argc > 2)
+        latency_us = atoi(argv[2]);
+    if (count < 1 || latency_us < 0) {
+        fprintf(stderr, "usage: %s [count [latency_us]]\n", argv[0]);
+        exit(1);
+    }
+    ccn_name_from_uri(prefix, "ccnx:/test/crawl");
+    make_objects(prefix, count);
+    for (i = 0; partitions[i] >= 0; i++)
+        status |= run(prefix, partitions[i], WINDOW);
+    for (i = 0; i < n_objects; i++) {
+        ccn_charbuf_destroy(&objects[i].ccnb);
+        ccn_charbuf_destroy(&objects[i].name);
+        ccn_indexbuf_destroy(&objects[i].comps);
+    }
+    free(objects);
+    ccn_charbuf_destroy(&prefix);
+    exit(status);
+}
@@ -13,29 +13,33 @@
 #
 
 LDLIBS = -L$(CCNLIBDIR) $(MORE_LDLIBS) -lccn
-EXPATLIBS = -lexpat
 CCNLIBDIR = ../lib
 
 PROGRAMS = hashtbtest skel_decode_test \
-    encodedecodetest signbenchtest basicparsetest ccnbtreetest
+    encodedecodetest signbenchtest seqwbenchtest bulkdatatest regbenchtest \
+    xmlcodectest crawltest filewatchtest getbenchtest basicparsetest ccnbtreetest \
+    signagenttest resolvebenchtest
 
 BROKEN_PROGRAMS =
-DEBRIS = ccn_verifysig _bt_* test.keystore
-CSRC = ccn_bloom.c \
+DEBRIS = ccn_verifysig _bt_* _fw_* test.keystore
+CSRC = ccn_archive.c ccn_bloom.c \
        ccn_btree.c ccn_btree_content.c ccn_btree_store.c \
        ccn_buf_decoder.c ccn_buf_encoder.c ccn_bulkdata.c \
-       ccn_charbuf.c ccn_client.c ccn_coding.c ccn_digest.c ccn_extend_dict.c \
-       ccn_dtag_table.c ccn_indexbuf.c ccn_interest.c ccn_keystore.c \
-       ccn_match.c ccn_reg_mgmt.c ccn_face_mgmt.c \
+       ccn_charbuf.c ccn_client.c ccn_coding.c ccn_crawl.c ccn_digest.c \
+       ccn_extend_dict.c ccn_filewatch.c ccn_dtag_table.c ccn_indexbuf.c ccn_interest.c ccn_keystore.c \
+       ccn_match.c ccn_reg_mgmt.c ccn_face_mgmt.c ccn_publish.c \
        ccn_merkle_path_asn1.c ccn_name_util.c ccn_schedule.c \
-       ccn_seqwriter.c ccn_signing.c \
+       ccn_seqwriter.c ccn_signagent.c ccn_signing.c \
        ccn_sockcreate.c ccn_traverse.c ccn_uri.c \
-       ccn_verifysig.c ccn_versioning.c \
+       ccn_verifysig.c ccn_versioning.c ccn_xmlcodec.c \
        ccn_header.c \
        ccn_fetch.c \
        lned.c \
        encodedecodetest.c hashtb.c hashtbtest.c \
-       signbenchtest.c skel_decode_test.c \
+       signbenchtest.c seqwbenchtest.c bulkdatatest.c \
+       regbenchtest.c xmlcodectest.c crawltest.c filewatchtest.c getbenchtest.c \
+       signagenttest.c resolvebenchtest.c \
+       skel_decode_test.c \
        basicparsetest.c ccnbtreetest.c \
        ccn_sockaddrutil.c ccn_setup_sockaddr_un.c
 LIBS = libccn.a
@@ -43,11 +47,13 @@ LIB_OBJS = ccn_client.o ccn_charbuf.o ccn_indexbuf.o ccn_coding.o \
        ccn_dtag_table.o ccn_schedule.o ccn_extend_dict.o \
        ccn_buf_decoder.o ccn_uri.o ccn_buf_encoder.o ccn_bloom.o \
        ccn_name_util.o ccn_face_mgmt.o ccn_reg_mgmt.o ccn_digest.o \
-       ccn_interest.o ccn_keystore.o ccn_seqwriter.o ccn_signing.o \
+       ccn_interest.o ccn_keystore.o ccn_seqwriter.o ccn_signagent.o ccn_signing.o \
+       ccn_publish.o \
        ccn_sockcreate.o ccn_traverse.o \
        ccn_match.o hashtb.o ccn_merkle_path_asn1.o \
        ccn_sockaddrutil.o ccn_setup_sockaddr_un.o \
        ccn_bulkdata.o ccn_versioning.o ccn_header.o ccn_fetch.o \
+       ccn_xmlcodec.o ccn_archive.o ccn_crawl.o ccn_filewatch.o \
        ccn_btree.o ccn_btree_content.o ccn_btree_store.o \
        lned.o
 
@@ -76,8 +82,15 @@ shlib: $(SHLIBNAME)
 
 lib: libccn.a
 
-test: default encodedecodetest ccnbtreetest
+test: default encodedecodetest ccnbtreetest bulkdatatest xmlcodectest crawltest \
+      filewatchtest signagenttest ccn_verifysig
 	./encodedecodetest -o /dev/null
+	./bulkdatatest
+	./xmlcodectest
+	./crawltest
+	./filewatchtest
+	$(RM) -R _fw_*
+	./signagenttest
 	./ccnbtreetest
 	./ccnbtreetest - < q.dat
 	$(RM) -R _bt_*
@@ -147,6 +160,33 @@ signbenchtest.o:
 signbenchtest: signbenchtest.o
 	$(CC) $(CFLAGS) -o $@ signbenchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto 
 
+seqwbenchtest: seqwbenchtest.o
+	$(CC) $(CFLAGS) -o $@ seqwbenchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+bulkdatatest: bulkdatatest.o
+	$(CC) $(CFLAGS) -o $@ bulkdatatest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+regbenchtest: regbenchtest.o
+	$(CC) $(CFLAGS) -o $@ regbenchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+xmlcodectest: xmlcodectest.o
+	$(CC) $(CFLAGS) -o $@ xmlcodectest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+crawltest: crawltest.o
+	$(CC) $(CFLAGS) -o $@ crawltest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+filewatchtest: filewatchtest.o
+	$(CC) $(CFLAGS) -o $@ filewatchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+signagenttest: signagenttest.o
+	$(CC) $(CFLAGS) -o $@ signagenttest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+getbenchtest: getbenchtest.o
+	$(CC) $(CFLAGS) -o $@ getbenchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
+resolvebenchtest: resolvebenchtest.o
+	$(CC) $(CFLAGS) -o $@ resolvebenchtest.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto
+
 ccndumppcap: ccndumppcap.o
 	$(CC) $(CFLAGS) -o $@ ccndumppcap.o $(LDLIBS) $(OPENSSL_LIBS) -lcrypto -lpcap
 
@@ -181,16 +221,21 @@ ccn_buf_encoder.o: ccn_buf_encoder.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/signing.h \
   ../include/ccn/ccn_private.h
-ccn_bulkdata.o: ccn_bulkdata.c ../include/ccn/bloom.h \
+ccn_bulkdata.o: ccn_bulkdata.c ../include/ccn/bulkdata.h \
   ../include/ccn/ccn.h ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h
+bulkdatatest.o: bulkdatatest.c ../include/ccn/bulkdata.h \
+  ../include/ccn/ccn.h ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/ccn_private.h \
+  ../include/ccn/keystore.h ../include/ccn/uri.h
 ccn_charbuf.o: ccn_charbuf.c ../include/ccn/charbuf.h
 ccn_client.o: ccn_client.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
   ../include/ccn/ccn_private.h ../include/ccn/ccnd.h \
   ../include/ccn/digest.h ../include/ccn/hashtb.h \
   ../include/ccn/reg_mgmt.h ../include/ccn/schedule.h \
-  ../include/ccn/signing.h ../include/ccn/keystore.h ../include/ccn/uri.h
+  ../include/ccn/signagent.h ../include/ccn/signing.h \
+  ../include/ccn/keystore.h ../include/ccn/uri.h
 ccn_coding.o: ccn_coding.c ../include/ccn/coding.h
 ccn_digest.o: ccn_digest.c ../include/ccn/digest.h
 ccn_extend_dict.o: ccn_extend_dict.c ../include/ccn/charbuf.h \
@@ -217,6 +262,10 @@ ccn_name_util.o: ccn_name_util.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/random.h
 ccn_schedule.o: ccn_schedule.c ../include/ccn/schedule.h
+ccn_publish.o: ccn_publish.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/digest.h \
+  ../include/ccn/hashtb.h ../include/ccn/publish.h
 ccn_seqwriter.o: ccn_seqwriter.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/seqwriter.h
@@ -238,6 +287,34 @@ ccn_versioning.o: ccn_versioning.c ../include/ccn/bloom.h \
   ../include/ccn/ccn.h ../include/ccn/coding.h ../include/ccn/charbuf.h \
   ../include/ccn/indexbuf.h ../include/ccn/uri.h \
   ../include/ccn/ccn_private.h
+ccn_xmlcodec.o: ccn_xmlcodec.c ../include/ccn/charbuf.h \
+  ../include/ccn/coding.h ../include/ccn/hashtb.h \
+  ../include/ccn/indexbuf.h ../include/ccn/xmlcodec.h
+ccn_archive.o: ccn_archive.c ../include/ccn/archive.h \
+  ../include/ccn/ccn.h ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h
+ccn_crawl.o: ccn_crawl.c ../include/ccn/ccn.h ../include/ccn/coding.h \
+  ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
+  ../include/ccn/crawl.h
+crawltest.o: crawltest.c ../include/ccn/ccn.h ../include/ccn/coding.h \
+  ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
+  ../include/ccn/ccn_private.h ../include/ccn/crawl.h \
+  ../include/ccn/keystore.h ../include/ccn/uri.h
+ccn_filewatch.o: ccn_filewatch.c ../include/ccn/filewatch.h \
+  ../include/ccn/charbuf.h ../include/ccn/hashtb.h
+filewatchtest.o: filewatchtest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/filewatch.h \
+  ../include/ccn/publish.h ../include/ccn/uri.h
+ccn_signagent.o: ccn_signagent.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/digest.h \
+  ../include/ccn/hashtb.h ../include/ccn/keystore.h \
+  ../include/ccn/signagent.h ../include/ccn/signing.h
+signagenttest.o: signagenttest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/keystore.h \
+  ../include/ccn/signagent.h ../include/ccn/signing.h
 ccn_header.o: ccn_header.c ../include/ccn/ccn.h ../include/ccn/coding.h \
   ../include/ccn/charbuf.h ../include/ccn/indexbuf.h \
   ../include/ccn/header.h
@@ -254,7 +331,25 @@ hashtb.o: hashtb.c ../include/ccn/hashtb.h
 hashtbtest.o: hashtbtest.c ../include/ccn/hashtb.h
 signbenchtest.o: signbenchtest.c ../include/ccn/ccn.h \
   ../include/ccn/coding.h ../include/ccn/charbuf.h \
-  ../include/ccn/indexbuf.h ../include/ccn/keystore.h
+  ../include/ccn/indexbuf.h ../include/ccn/keystore.h \
+  ../include/ccn/signing.h
+seqwbenchtest.o: seqwbenchtest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/seqwriter.h \
+  ../include/ccn/uri.h
+getbenchtest.o: getbenchtest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/uri.h
+resolvebenchtest.o: resolvebenchtest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/uri.h
+regbenchtest.o: regbenchtest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/reg_mgmt.h \
+  ../include/ccn/uri.h
+xmlcodectest.o: xmlcodectest.c ../include/ccn/ccn.h \
+  ../include/ccn/coding.h ../include/ccn/charbuf.h \
+  ../include/ccn/indexbuf.h ../include/ccn/xmlcodec.h
 skel_decode_test.o: skel_decode_test.c ../include/ccn/charbuf.h \
   ../include/ccn/coding.h
 basicparsetest.o: basicparsetest.c ../include/ccn/ccn.h \
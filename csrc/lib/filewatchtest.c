@@ -0,0 +1,275 @@
+/**
+ * @file filewatchtest.c
+ *
+ * A test program for the file watcher, driving a publisher.
+ *
+ * Watches a scratch directory tree and publishes a new version of each
+ * file that changes, as ccnpublish -w does.  Checks that a burst of writes
+ * is published once, that rewriting the same bytes publishes nothing,
+ * that files in new subdirectories are picked up, and that removals are
+ * reported.  Reports the latency from a change to the end of its publication.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/filewatch.h>
+#include <ccn/publish.h>
+#include <ccn/uri.h>
+
+#define SETTLE_MS 50
+#define ROUNDS 20
+#define BURST 100
+#define WAIT_MS 5000
+
+struct tstate {
+    struct ccn_publisher *publisher;
+    struct ccn_filewatch *w;
+    struct ccn_charbuf *prefix;
+    const char *tree;
+    struct timeval published_at;
+    int published;
+    int unchanged;
+    int removed;
+    int errors;
+};
+
+static long
+usec_between(const struct timeval *a, const struct timeval *b)
+{
+    return((b->tv_sec - a->tv_sec) * 1000000L + (b->tv_usec - a->tv_usec));
+}
+
+static void
+changed(void *data, const char *path, int kind)
+{
+    struct tstate *t = data;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    const char *p = path + strlen(t->tree);
+    const char *slash;
+    int res;
+
+    ccn_charbuf_append_charbuf(name, t->prefix);
+    for (; *p == '/'; p = slash) {
+        p++;
+        slash = strchr(p, '/');
+        if (slash == NULL)
+            slash = p + strlen(p);
+        ccn_name_append(name, p, slash - p);
+    }
+    if (kind == CCN_FILEWATCH_REMOVED) {
+        if (ccn_publisher_remove_file(t->publisher, name) == 0)
+            t->removed++;
+    }
+    else {
+        res = ccn_publisher_update_file(t->publisher, name, path);
+        if (res < 0) {
+            fprintf(stderr, "update of %s failed\n", path);
+            t->errors++;
+        }
+        else if (res == 0)
+            t->unchanged++;
+        else {
+            t->published++;
+            gettimeofday(&t->published_at, NULL);
+        }
+    }
+    ccn_charbuf_destroy(&name);
+}
+
+/**
+ * Run the watcher until *counter reaches want, or ms milliseconds pass.
+ */
+static int
+wait_for(struct tstate *t, int *counter, int want, int ms)
+{
+    struct pollfd fds[1];
+    struct timeval start, now;
+    int next;
+
+    gettimeofday(&start, NULL);
+    for (;;) {
+        next = ccn_filewatch_process(t->w, &changed, t);
+        if (*counter >= want)
+            return(0);
+        gettimeofday(&now, NULL);
+        if (usec_between(&start, &now) > ms * 1000L)
+            return(-1);
+        fds[0].fd = ccn_filewatch_fd(t->w);
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        poll(fds, 1, next < 0 ? 100 : next / 1000 + 1);
+    }
+}
+
+static void
+write_file(const char *dir, const char *file, const char *text, int append)
+{
+    char path[256];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    fd = open(path, O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0666);
+    if (fd == -1 || write(fd, text, strlen(text)) != strlen(text)) {
+        perror(path);
+        exit(1);
+    }
+    close(fd);
+}
+
+static int
+compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return((x > y) - (x < y));
+}
+
+int
+main(int argc, char **argv)
+{
+    struct ccn *h = NULL;
+    struct tstate ts = {0};
+    struct tstate *t = &ts;
+    struct ccn_publisher_stats stats = {0};
+    struct timeval t0;
+    char top[] = "_fw_XXXXXX";
+    char tree[64];
+    char sub[96];
+    char file[16];
+    char text[64];
+    char path[128];
+    long lat[ROUNDS];
+    int want;
+    int i;
+
+    if (mkdtemp(top) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    /* Keep the signing key with the scratch files */
+    setenv("CCNX_DIR", top, 1);
+    snprintf(tree, sizeof(tree), "%s/tree", top);
+    snprintf(sub, sizeof(sub), "%s/sub", tree);
+    mkdir(tree, 0777);
+    t->tree = tree;
+    t->w = ccn_filewatch_create(SETTLE_MS);
+    if (t->w == NULL) {
+        if (errno == ENOSYS) {
+            fprintf(stderr, "filewatchtest: not supported here, skipped\n");
+            exit(0);
+        }
+        perror("ccn_filewatch_create");
+        exit(1);
+    }
+    h = ccn_create();
+    t->prefix = ccn_charbuf_create();
+    ccn_name_from_uri(t->prefix, "ccnx:/test/filewatch");
+    t->publisher = ccn_publisher_create(h, t->prefix, NULL, 1024, 2);
+    if (t->publisher == NULL || ccn_filewatch_add(t->w, tree) < 0) {
+        fprintf(stderr, "filewatchtest: setup failed\n");
+        exit(1);
+    }
+
+    /* Single changes, for latency */
+    for (i = 0; i < ROUNDS; i++) {
+        snprintf(file, sizeof(file), "f%d", i % 4);
+        snprintf(text, sizeof(text), "round %d\n", i);
+        want = t->published + 1;
+        write_file(tree, file, text, 0);
+        gettimeofday(&t0, NULL);
+        if (wait_for(t, &t->published, want, WAIT_MS) < 0) {
+            fprintf(stderr, "round %d: change to %s not published\n", i, file);
+            exit(1);
+        }
+        lat[i] = usec_between(&t0, &t->published_at);
+        if (lat[i] < SETTLE_MS * 1000L) {
+            fprintf(stderr, "round %d: published before settling\n", i);
+            t->errors++;
+        }
+    }
+    qsort(lat, ROUNDS, sizeof(lat[0]), &compare_long);
+    printf("change-to-publish latency (settle %d ms): "
+           "min %.1f ms, median %.1f ms, max %.1f ms\n", SETTLE_MS,
+           lat[0] / 1000.0, lat[ROUNDS / 2] / 1000.0, lat[ROUNDS - 1] / 1000.0);
+
+    /* A burst of writes is published once */
+    want = t->published + 1;
+    for (i = 0; i < BURST; i++) {
+        snprintf(text, sizeof(text), "line %d\n", i);
+        write_file(tree, "burst", text, 1);
+    }
+    if (wait_for(t, &t->published, want, WAIT_MS) < 0) {
+        fprintf(stderr, "burst not published\n");
+        exit(1);
+    }
+    wait_for(t, &t->published, want + 1, 4 * SETTLE_MS); /* times out */
+    if (t->published != want) {
+        fprintf(stderr, "burst published %d times\n", t->published - want + 1);
+        t->errors++;
+    }
+
+    /* The same bytes again are not published */
+    want = t->unchanged + 1;
+    write_file(tree, "burst", "", 1);
+    if (wait_for(t, &t->unchanged, want, WAIT_MS) < 0) {
+        fprintf(stderr, "unchanged rewrite was published\n");
+        t->errors++;
+    }
+
+    /* New subdirectories are watched, including what is already in them */
+    want = t->published + 2;
+    mkdir(sub, 0777);
+    write_file(sub, "early", "written right away\n", 0);
+    if (wait_for(t, &t->published, want - 1, WAIT_MS) < 0) {
+        fprintf(stderr, "file in new subdirectory not published\n");
+        exit(1);
+    }
+    write_file(sub, "late", "written later\n", 0);
+    if (wait_for(t, &t->published, want, WAIT_MS) < 0) {
+        fprintf(stderr, "later file in new subdirectory not published\n");
+        exit(1);
+    }
+
+    /* Removal */
+    snprintf(path, sizeof(path), "%s/burst", tree);
+    want = t->removed + 1;
+    unlink(path);
+    if (wait_for(t, &t->removed, want, WAIT_MS) < 0) {
+        fprintf(stderr, "removal not reported\n");
+        t->errors++;
+    }
+
+    ccn_publisher_get_stats(t->publisher, &stats);
+    printf("%ju versions published, %ju unchanged, %d removed\n",
+           stats.files, stats.unchanged, t->removed);
+    ccn_filewatch_destroy(&t->w);
+    ccn_publisher_destroy(&t->publisher);
+    ccn_charbuf_destroy(&t->prefix);
+    ccn_destroy(&h);
+    if (t->errors != 0) {
+        fprintf(stderr, "filewatchtest: %d errors\n", t->errors);
+        exit(1);
+    }
+    return(0);
+}
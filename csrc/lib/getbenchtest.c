@@ -0,0 +1,226 @@
+/**
+ * @file getbenchtest.c
+ *
+ * A test program to benchmark ccn_get and ccn_get_multi.
+ *
+ * Times ccn_get called from inside an upcall, which shares the caller's
+ * connection, and checks that an upcall for another interest answered
+ * meanwhile is held back until ccn_get returns, and is not lost.
+ * Then compares a batch of sequential ccn_get calls with one
+ * ccn_get_multi for the same number of names.  Uses the ping
+ * responder of the local ccnd, so needs a running ccnd.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/uri.h>
+
+#define ROUNDS 200
+#define BATCH 32
+#define TIMEOUT_MS 2000
+
+struct bench {
+    struct ccn_closure trigger;
+    struct ccn_closure background;
+    struct ccn *h;
+    struct ccn_charbuf *result;
+    int round;
+    int in_get;             /* nonzero while the nested ccn_get runs */
+    int held_back;          /* background upcalls that waited correctly */
+    int errors;
+    long lat[ROUNDS];
+};
+
+static long
+usec_between(const struct timeval *a, const struct timeval *b)
+{
+    return((b->tv_sec - a->tv_sec) * 1000000L + (b->tv_usec - a->tv_usec));
+}
+
+static int
+compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return((x > y) - (x < y));
+}
+
+/**
+ * Make a fresh ping name, so that nothing is answered from a cache.
+ */
+static struct ccn_charbuf *
+ping_name(const char *tag, int i)
+{
+    static unsigned serial;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    char uri[80];
+
+    snprintf(uri, sizeof(uri), "ccnx:/ccnx/ping/%s%d.%d.%u",
+             tag, i, (int)getpid(), serial++);
+    ccn_name_from_uri(name, uri);
+    return(name);
+}
+
+static void
+express(struct bench *b, struct ccn_closure *cl, const char *tag)
+{
+    struct ccn_charbuf *name = ping_name(tag, b->round);
+    ccn_express_interest(b->h, name, cl, NULL);
+    ccn_charbuf_destroy(&name);
+}
+
+static enum ccn_upcall_res
+incoming_background(struct ccn_closure *selfp,
+                    enum ccn_upcall_kind kind,
+                    struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+
+    if (kind == CCN_UPCALL_FINAL)
+        return(CCN_UPCALL_RESULT_OK);
+    if (kind == CCN_UPCALL_INTEREST_TIMED_OUT) {
+        fprintf(stderr, "background interest timed out\n");
+        b->errors++;
+        return(CCN_UPCALL_RESULT_OK);
+    }
+    if (b->in_get) {
+        fprintf(stderr, "background upcall during ccn_get\n");
+        b->errors++;
+    }
+    else
+        b->held_back++;
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+static enum ccn_upcall_res
+incoming_trigger(struct ccn_closure *selfp,
+                 enum ccn_upcall_kind kind,
+                 struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+    struct ccn_charbuf *name = NULL;
+    struct timeval t0, t1;
+    int res;
+
+    if (kind == CCN_UPCALL_FINAL)
+        return(CCN_UPCALL_RESULT_OK);
+    if (kind == CCN_UPCALL_INTEREST_TIMED_OUT)
+        return(CCN_UPCALL_RESULT_REEXPRESS);
+    /* Something else to be answered while ccn_get is busy */
+    express(b, &b->background, "bg");
+    name = ping_name("get", b->round);
+    b->in_get = 1;
+    gettimeofday(&t0, NULL);
+    res = ccn_get(info->h, name, NULL, TIMEOUT_MS, b->result, NULL, NULL,
+                  CCN_GET_NOKEYWAIT);
+    gettimeofday(&t1, NULL);
+    b->in_get = 0;
+    ccn_charbuf_destroy(&name);
+    if (res < 0) {
+        fprintf(stderr, "round %d: nested ccn_get failed\n", b->round);
+        b->errors++;
+    }
+    b->lat[b->round] = usec_between(&t0, &t1);
+    b->round++;
+    if (b->round < ROUNDS)
+        express(b, &b->trigger, "t");
+    else
+        ccn_set_run_timeout(info->h, 0);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct bench bb = {{0}};
+    struct bench *b = &bb;
+    struct ccn_charbuf *names[BATCH];
+    struct ccn_charbuf *results[BATCH];
+    struct timeval t0, t1;
+    long seq_us, multi_us;
+    int i, res;
+
+    b->h = ccn_create();
+    if (ccn_connect(b->h, NULL) == -1) {
+        ccn_perror(b->h, "Could not connect to ccnd");
+        exit(1);
+    }
+    b->result = ccn_charbuf_create();
+    b->trigger.p = &incoming_trigger;
+    b->trigger.data = b;
+    b->background.p = &incoming_background;
+    b->background.data = b;
+
+    /* ccn_get from inside an upcall */
+    express(b, &b->trigger, "t");
+    while (b->round < ROUNDS && ccn_run(b->h, TIMEOUT_MS) >= 0 && b->errors == 0)
+        continue;
+    ccn_run(b->h, 100); /* collect the last background answer */
+    qsort(b->lat, b->round, sizeof(b->lat[0]), &compare_long);
+    printf("nested ccn_get: %d rounds, median %ld us, max %ld us\n",
+           b->round, b->lat[b->round / 2], b->lat[b->round - 1]);
+    if (b->held_back != b->round) {
+        fprintf(stderr, "%d of %d background upcalls held back\n",
+                b->held_back, b->round);
+        b->errors++;
+    }
+
+    /* Sequential ccn_get against one ccn_get_multi */
+    for (i = 0; i < BATCH; i++) {
+        names[i] = ping_name("seq", i);
+        results[i] = ccn_charbuf_create();
+    }
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < BATCH; i++) {
+        if (ccn_get(b->h, names[i], NULL, TIMEOUT_MS, results[i],
+                    NULL, NULL, CCN_GET_NOKEYWAIT) < 0)
+            b->errors++;
+    }
+    gettimeofday(&t1, NULL);
+    seq_us = usec_between(&t0, &t1);
+    for (i = 0; i < BATCH; i++) {
+        ccn_charbuf_destroy(&names[i]);
+        names[i] = ping_name("multi", i);
+    }
+    gettimeofday(&t0, NULL);
+    res = ccn_get_multi(b->h, names, BATCH, NULL, TIMEOUT_MS, results,
+                        CCN_GET_NOKEYWAIT);
+    gettimeofday(&t1, NULL);
+    multi_us = usec_between(&t0, &t1);
+    if (res != BATCH) {
+        fprintf(stderr, "ccn_get_multi got %d of %d\n", res, BATCH);
+        b->errors++;
+    }
+    for (i = 0; i < BATCH; i++) {
+        if (results[i]->length == 0 && res == BATCH)
+            b->errors++;
+        ccn_charbuf_destroy(&names[i]);
+        ccn_charbuf_destroy(&results[i]);
+    }
+    printf("%d names: sequential ccn_get %ld us, ccn_get_multi %ld us\n",
+           BATCH, seq_us, multi_us);
+
+    ccn_charbuf_destroy(&b->result);
+    ccn_destroy(&b->h);
+    if (b->errors != 0) {
+        fprintf(stderr, "getbenchtest: %d errors\n", b->errors);
+        exit(1);
+    }
+    return(0);
+}
@@ -0,0 +1,206 @@
+/**
+ * @file regbenchtest.c
+ *
+ * A simple test program to benchmark ccnd control-plane throughput.
+ *
+ * Registers thousands of distinct prefixes with the local ccnd using
+ * selfreg requests, keeping a pipeline of them outstanding, and reports
+ * the rate at which ccnd's internal client answers them.  The requests
+ * are signed before the clock starts, so the client's own signing cost
+ * is not counted.  Needs a running ccnd and a keystore.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/reg_mgmt.h>
+#include <ccn/uri.h>
+
+#define COUNT 5000
+#define PIPELINE 32
+
+struct bench {
+    struct ccn_closure cl;
+    struct ccn *h;
+    struct ccn_charbuf **requests; /* presigned request names */
+    int count;
+    int next;
+    int answered;
+    int failed;
+    int outstanding;
+    int timeouts;
+};
+
+static void
+ask(struct bench *b)
+{
+    ccn_express_interest(b->h, b->requests[b->next], &b->cl, NULL);
+    b->next++;
+    b->outstanding++;
+}
+
+static enum ccn_upcall_res
+incoming_reply(struct ccn_closure *selfp,
+               enum ccn_upcall_kind kind,
+               struct ccn_upcall_info *info)
+{
+    struct bench *b = selfp->data;
+    struct ccn_forwarding_entry *fe = NULL;
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
+
+    switch (kind) {
+        case CCN_UPCALL_FINAL:
+            return(CCN_UPCALL_RESULT_OK);
+        case CCN_UPCALL_INTEREST_TIMED_OUT:
+            b->timeouts++;
+            return(CCN_UPCALL_RESULT_REEXPRESS);
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+            break;
+        default:
+            return(CCN_UPCALL_RESULT_ERR);
+    }
+    b->outstanding--;
+    b->answered++;
+    if (ccn_content_get_value(info->content_ccnb, info->pco->offset[CCN_PCO_E],
+                              info->pco, &data, &data_size) == 0)
+        fe = ccn_forwarding_entry_parse(data, data_size);
+    if (fe == NULL)
+        b->failed++;
+    ccn_forwarding_entry_destroy(&fe);
+    while (b->outstanding < PIPELINE && b->next < b->count)
+        ask(b);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/*
+ * Find out the ccndid, which goes into each request
+ */
+static void
+get_ccndid(struct ccn *h, struct ccn_charbuf *ccndid)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *resultbuf = ccn_charbuf_create();
+    struct ccn_parsed_ContentObject pcobuf = {0};
+    const unsigned char *id = NULL;
+    size_t id_size = 0;
+    int res;
+
+    ccn_name_from_uri(name, "ccnx:/%C1.M.S.localhost/%C1.M.SRV/ccnd/KEY");
+    res = ccn_get(h, name, NULL, 4500, resultbuf, &pcobuf, NULL, 0);
+    if (res >= 0)
+        res = ccn_ref_tagged_BLOB(CCN_DTAG_PublisherPublicKeyDigest,
+                                  resultbuf->buf,
+                                  pcobuf.offset[CCN_PCO_B_PublisherPublicKeyDigest],
+                                  pcobuf.offset[CCN_PCO_E_PublisherPublicKeyDigest],
+                                  &id, &id_size);
+    if (res < 0) {
+        fprintf(stderr, "Cannot obtain ccndid\n");
+        exit(1);
+    }
+    ccn_charbuf_append(ccndid, id, id_size);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&resultbuf);
+}
+
+static struct ccn_charbuf *
+make_request(struct ccn *h, struct ccn_charbuf *ccndid, int i)
+{
+    struct ccn_forwarding_entry fe_store = {0};
+    struct ccn_forwarding_entry *fe = &fe_store;
+    struct ccn_charbuf *reqname = ccn_charbuf_create();
+    struct ccn_charbuf *reg_request = ccn_charbuf_create();
+    struct ccn_charbuf *signed_request = ccn_charbuf_create();
+    struct ccn_charbuf *empty = ccn_charbuf_create();
+    char uri[80];
+
+    snprintf(uri, sizeof(uri), "ccnx:/test/regbench/%d/%d", (int)getpid(), i);
+    fe->action = "selfreg";
+    fe->ccnd_id = ccndid->buf;
+    fe->ccnd_id_size = ccndid->length;
+    fe->faceid = ~0;
+    fe->name_prefix = ccn_charbuf_create();
+    ccn_name_from_uri(fe->name_prefix, uri);
+    fe->flags = CCN_FORW_ACTIVE | CCN_FORW_CHILD_INHERIT;
+    fe->lifetime = 60;
+    ccnb_append_forwarding_entry(reg_request, fe);
+    ccn_name_init(empty);
+    if (ccn_sign_content(h, signed_request, empty, NULL,
+                         reg_request->buf, reg_request->length) != 0) {
+        fprintf(stderr, "Cannot sign request\n");
+        exit(1);
+    }
+    ccn_name_from_uri(reqname, "ccnx:/ccnx");
+    ccn_name_append(reqname, ccndid->buf, ccndid->length);
+    ccn_name_append_str(reqname, "selfreg");
+    ccn_name_append(reqname, signed_request->buf, signed_request->length);
+    ccn_charbuf_destroy(&fe->name_prefix);
+    ccn_charbuf_destroy(&reg_request);
+    ccn_charbuf_destroy(&signed_request);
+    ccn_charbuf_destroy(&empty);
+    return(reqname);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct ccn_charbuf *ccndid = ccn_charbuf_create();
+    struct bench bench = {{0}};
+    struct bench *b = &bench;
+    struct timeval t0, t1;
+    double elapsed;
+    int i;
+
+    b->count = COUNT;
+    if (argc > 1)
+        b->count = atoi(argv[1]);
+    if (b->count <= 0) {
+        fprintf(stderr, "usage: %s [count]\n", argv[0]);
+        exit(1);
+    }
+    b->h = ccn_create();
+    if (ccn_connect(b->h, NULL) == -1) {
+        perror("Could not connect to ccnd");
+        exit(1);
+    }
+    get_ccndid(b->h, ccndid);
+    b->requests = calloc(b->count, sizeof(b->requests[0]));
+    for (i = 0; i < b->count; i++)
+        b->requests[i] = make_request(b->h, ccndid, i);
+    b->cl.p = &incoming_reply;
+    b->cl.data = b;
+    gettimeofday(&t0, NULL);
+    while (b->outstanding < PIPELINE && b->next < b->count)
+        ask(b);
+    while (b->answered < b->count && ccn_run(b->h, 1000) >= 0)
+        continue;
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    printf("%d prefix registrations in %.3f s, %.0f requests/s, "
+           "%d failed, %d timeouts\n",
+           b->answered, elapsed, b->answered / elapsed, b->failed, b->timeouts);
+    ccn_destroy(&b->h);
+    for (i = 0; i < b->count; i++)
+        ccn_charbuf_destroy(&b->requests[i]);
+    free(b->requests);
+    ccn_charbuf_destroy(&ccndid);
+    exit(b->answered == b->count && b->failed == 0 ? 0 : 1);
+}
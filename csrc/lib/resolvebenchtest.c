@@ -0,0 +1,336 @@
+/**
+ * @file resolvebenchtest.c
+ *
+ * A simple test program to benchmark ccn_resolve_version latency.
+ *
+ * A child process stands in for a repository some distance away: it
+ * holds versions of a set of names, answers version probes and queries
+ * of its latest-version index (see ccn_versioning.c), and holds each
+ * answer back for a while to give it a round trip time.  The parent
+ * resolves each name with CCN_V_HIGHEST, once with the index not
+ * answering, once with it answering, and once with it answering a
+ * version that is out of date.  Each must find the latest version, and
+ * the index must make the lookup faster.  Needs a running ccnd and a
+ * keystore.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/uri.h>
+
+#define COUNT 21                /* item 0 is for getting started */
+#define VERSIONS 20
+#define DELAY_MS 10
+#define TIMEOUT_MS 2000
+#define MAX_HELD 64
+#define LATEST_VERSION_MARKER "\xC1.R.lv"
+
+enum index_mode {
+    INDEX_NONE,         /* no index queries are answered */
+    INDEX_CURRENT,      /* the index knows the latest version */
+    INDEX_STALE,        /* the index is one version behind */
+    INDEX_MODES
+};
+
+static const char *mode_names[INDEX_MODES] = {"none", "current", "stale"};
+
+struct held {
+    struct ccn_charbuf *cob;
+    struct timeval due;
+};
+
+struct repo {
+    struct ccn_closure cl;
+    struct ccn *h;
+    struct ccn_charbuf *prefix;
+    int prefix_comps;
+    int delay_ms;
+    struct ccn_charbuf *cobs[INDEX_MODES][COUNT][VERSIONS];
+    struct held held[MAX_HELD];
+    int nheld;
+};
+
+static long
+usec_between(const struct timeval *a, const struct timeval *b)
+{
+    return((b->tv_sec - a->tv_sec) * 1000000L + (b->tv_usec - a->tv_usec));
+}
+
+static int
+compare_long(const void *a, const void *b)
+{
+    long x = *(const long *)a;
+    long y = *(const long *)b;
+    return((x > y) - (x < y));
+}
+
+/**
+ * Make the name of one of the test items, with version v if v >= 0.
+ */
+static void
+item_name(struct ccn_charbuf *name, struct ccn_charbuf *prefix,
+          int mode, int i, int v)
+{
+    char num[20];
+
+    ccn_charbuf_reset(name);
+    ccn_charbuf_append_charbuf(name, prefix);
+    ccn_name_append_str(name, mode_names[mode]);
+    snprintf(num, sizeof(num), "%d", i);
+    ccn_name_append_str(name, num);
+    if (v >= 0)
+        ccn_create_version(NULL, name, 0, 1300000000 + v, 0);
+}
+
+/**
+ * Queue a ContentObject to go out after the delay.
+ */
+static void
+hold(struct repo *r, const unsigned char *cob, size_t size)
+{
+    struct held *e;
+
+    if (r->nheld == MAX_HELD)
+        return;
+    e = &r->held[r->nheld++];
+    e->cob = ccn_charbuf_create();
+    ccn_charbuf_append(e->cob, cob, size);
+    gettimeofday(&e->due, NULL);
+    e->due.tv_usec += r->delay_ms * 1000;
+    e->due.tv_sec += e->due.tv_usec / 1000000;
+    e->due.tv_usec %= 1000000;
+}
+
+static void
+send_due(struct repo *r)
+{
+    struct timeval now;
+    int i;
+
+    gettimeofday(&now, NULL);
+    while (r->nheld > 0 && usec_between(&r->held[0].due, &now) >= 0) {
+        ccn_put(r->h, r->held[0].cob->buf, r->held[0].cob->length);
+        ccn_charbuf_destroy(&r->held[0].cob);
+        r->nheld--;
+        for (i = 0; i < r->nheld; i++)
+            r->held[i] = r->held[i + 1];
+    }
+}
+
+/**
+ * Answer a query of the index with the name of version v of the item.
+ */
+static void
+answer_index(struct repo *r, struct ccn_upcall_info *info, int mode, int i,
+             int v)
+{
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *vname = ccn_charbuf_create();
+    struct ccn_charbuf *cob = ccn_charbuf_create();
+
+    ccn_charbuf_append(name, info->interest_ccnb + info->pi->offset[CCN_PI_B_Name],
+                       info->pi->offset[CCN_PI_E_Name] - info->pi->offset[CCN_PI_B_Name]);
+    item_name(vname, r->prefix, mode, i, v);
+    sp.freshness = 1;
+    if (ccn_sign_content(r->h, cob, name, &sp, vname->buf, vname->length) == 0)
+        hold(r, cob->buf, cob->length);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&vname);
+    ccn_charbuf_destroy(&cob);
+}
+
+static enum ccn_upcall_res
+incoming_interest(struct ccn_closure *selfp,
+                  enum ccn_upcall_kind kind,
+                  struct ccn_upcall_info *info)
+{
+    struct repo *r = selfp->data;
+    struct ccn_indexbuf *comps = info->interest_comps;
+    struct ccn_charbuf *cob = NULL;
+    const unsigned char *comp = NULL;
+    size_t size = 0;
+    int n = comps->n - 1 - r->prefix_comps;
+    int mode;
+    int i = -1;
+    int v;
+
+    if (kind != CCN_UPCALL_INTEREST)
+        return(CCN_UPCALL_RESULT_OK);
+    if (n < 2)
+        return(CCN_UPCALL_RESULT_OK);
+    for (mode = 0; mode < INDEX_MODES; mode++)
+        if (ccn_name_comp_strcmp(info->interest_ccnb, comps, r->prefix_comps,
+                                 mode_names[mode]) == 0)
+            break;
+    if (ccn_name_comp_get(info->interest_ccnb, comps, r->prefix_comps + 1,
+                          &comp, &size) == 0 && size > 0 && size < 10) {
+        char num[10];
+        memcpy(num, comp, size);
+        num[size] = 0;
+        i = atoi(num);
+    }
+    if (mode == INDEX_MODES || i < 0 || i >= COUNT)
+        return(CCN_UPCALL_RESULT_OK);
+    if (n == 4 && ccn_name_comp_strcmp(info->interest_ccnb, comps,
+                                       r->prefix_comps + 2,
+                                       LATEST_VERSION_MARKER) == 0) {
+        if (mode == INDEX_CURRENT)
+            answer_index(r, info, mode, i, VERSIONS - 1);
+        else if (mode == INDEX_STALE)
+            answer_index(r, info, mode, i, VERSIONS - 2);
+        return(CCN_UPCALL_RESULT_OK);
+    }
+    if (n != 2)
+        return(CCN_UPCALL_RESULT_OK);
+    /* Answer a probe with the highest version that matches */
+    for (v = VERSIONS - 1; v >= 0; v--) {
+        cob = r->cobs[mode][i][v];
+        if (ccn_content_matches_interest(cob->buf, cob->length, 1, NULL,
+                                         info->interest_ccnb,
+                                         info->pi->offset[CCN_PI_E],
+                                         info->pi)) {
+            hold(r, cob->buf, cob->length);
+            break;
+        }
+    }
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+/**
+ * Run the stand-in repository until killed.
+ */
+static void
+run_repo(struct ccn_charbuf *prefix, int delay_ms)
+{
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct repo *r = calloc(1, sizeof(*r));
+    int mode, i, v;
+
+    r->h = ccn_create();
+    if (ccn_connect(r->h, NULL) == -1) {
+        perror("Could not connect to ccnd");
+        exit(1);
+    }
+    r->prefix = prefix;
+    r->prefix_comps = ccn_name_split(prefix, NULL);
+    r->delay_ms = delay_ms;
+    for (mode = 0; mode < INDEX_MODES; mode++)
+        for (i = 0; i < COUNT; i++)
+            for (v = 0; v < VERSIONS; v++) {
+                item_name(name, prefix, mode, i, v);
+                ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, 0);
+                r->cobs[mode][i][v] = ccn_charbuf_create();
+                sp.sp_flags = CCN_SP_FINAL_BLOCK;
+                if (ccn_sign_content(r->h, r->cobs[mode][i][v], name, &sp,
+                                     "resolvebench", 12) != 0) {
+                    fprintf(stderr, "Cannot sign content\n");
+                    exit(1);
+                }
+            }
+    r->cl.p = &incoming_interest;
+    r->cl.data = r;
+    ccn_set_interest_filter(r->h, prefix, &r->cl);
+    for (;;) {
+        if (ccn_run(r->h, 1) < 0)
+            exit(1);
+        send_due(r);
+    }
+}
+
+int
+main(int argc, char **argv)
+{
+    struct ccn_charbuf *prefix = ccn_charbuf_create();
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct ccn_charbuf *want = ccn_charbuf_create();
+    struct ccn *h = NULL;
+    struct timeval t0, t1;
+    long lat[INDEX_MODES][COUNT - 1];
+    double median[INDEX_MODES];
+    char uri[80];
+    pid_t repo;
+    int delay_ms = DELAY_MS;
+    int errors = 0;
+    int res;
+    int mode, i;
+
+    if (argc > 1)
+        delay_ms = atoi(argv[1]);
+    if (argc > 2 || delay_ms <= 0) {
+        fprintf(stderr, "usage: %s [delay_ms]\n", argv[0]);
+        exit(1);
+    }
+    h = ccn_create();
+    if (ccn_connect(h, NULL) == -1) {
+        perror("Could not connect to ccnd");
+        exit(1);
+    }
+    snprintf(uri, sizeof(uri), "ccnx:/test/resolvebench/%d", (int)getpid());
+    ccn_name_from_uri(prefix, uri);
+    repo = fork();
+    if (repo == 0)
+        run_repo(prefix, delay_ms);
+    /* Wait for the stand-in to be answering */
+    for (i = 0, res = -1; i < 100 && res < 0; i++) {
+        item_name(name, prefix, INDEX_NONE, 0, -1);
+        res = ccn_get(h, name, NULL, 100, NULL, NULL, NULL, 0);
+    }
+    if (res < 0) {
+        fprintf(stderr, "The stand-in repository did not answer\n");
+        errors++;
+    }
+    for (mode = 0; mode < INDEX_MODES && errors == 0; mode++) {
+        for (i = 1; i < COUNT; i++) {
+            item_name(name, prefix, mode, i, -1);
+            item_name(want, prefix, mode, i, VERSIONS - 1);
+            gettimeofday(&t0, NULL);
+            res = ccn_resolve_version(h, name, CCN_V_HIGHEST, TIMEOUT_MS);
+            gettimeofday(&t1, NULL);
+            lat[mode][i - 1] = usec_between(&t0, &t1);
+            if (res != 0 || name->length != want->length ||
+                memcmp(name->buf, want->buf, want->length) != 0) {
+                fprintf(stderr, "index %s: item %d did not resolve to "
+                        "the latest version\n", mode_names[mode], i);
+                errors++;
+            }
+        }
+        qsort(lat[mode], COUNT - 1, sizeof(lat[mode][0]), &compare_long);
+        median[mode] = lat[mode][(COUNT - 1) / 2] / 1000.0;
+        printf("CCN_V_HIGHEST, %d ms away, index %-7s: "
+               "median %6.1f ms, max %6.1f ms\n", delay_ms, mode_names[mode],
+               median[mode], lat[mode][COUNT - 2] / 1000.0);
+    }
+    if (errors == 0 && median[INDEX_CURRENT] >= median[INDEX_NONE]) {
+        fprintf(stderr, "The index did not make resolving faster\n");
+        errors++;
+    }
+    kill(repo, SIGTERM);
+    waitpid(repo, NULL, 0);
+    ccn_destroy(&h);
+    ccn_charbuf_destroy(&prefix);
+    ccn_charbuf_destroy(&name);
+    ccn_charbuf_destroy(&want);
+    exit(errors == 0 ? 0 : 1);
+}
@@ -0,0 +1,203 @@
+/**
+ * @file seqwbenchtest.c
+ *
+ * A simple test program to benchmark seqwriter throughput.
+ *
+ * A producer writes a stream with a seqwriter while a consumer in the
+ * same process fetches it with a pipeline of interests, both through the
+ * local ccnd.  The stream is written once signing each block on demand
+ * (window 0) and once signing ahead into the seqwriter's window.
+ * Needs a running ccnd and a keystore.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/seqwriter.h>
+#include <ccn/uri.h>
+
+#define BLOCKSIZE 4096
+#define COUNT 2000
+#define PIPELINE 16
+#define WINDOW 16
+
+struct consumer {
+    struct ccn_closure cl;
+    struct ccn *h;
+    struct ccn_charbuf *name;   /* versioned stream name */
+    uintmax_t next;             /* next segment to ask for */
+    uintmax_t count;            /* number of segments in the stream */
+    uintmax_t received;
+    unsigned char *have;
+    unsigned long long bytes;
+    int outstanding;
+    int timeouts;
+};
+
+static void
+ask(struct consumer *c)
+{
+    struct ccn_charbuf *name = ccn_charbuf_create();
+
+    ccn_charbuf_append_charbuf(name, c->name);
+    ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, c->next);
+    ccn_express_interest(c->h, name, &c->cl, NULL);
+    ccn_charbuf_destroy(&name);
+    c->next++;
+    c->outstanding++;
+}
+
+static enum ccn_upcall_res
+incoming_content(struct ccn_closure *selfp,
+                 enum ccn_upcall_kind kind,
+                 struct ccn_upcall_info *info)
+{
+    struct consumer *c = selfp->data;
+    const unsigned char *data = NULL;
+    size_t data_size = 0;
+    uintmax_t seq;
+    int n;
+    int res;
+
+    switch (kind) {
+        case CCN_UPCALL_FINAL:
+            return(CCN_UPCALL_RESULT_OK);
+        case CCN_UPCALL_INTEREST_TIMED_OUT:
+            c->timeouts++;
+            return(CCN_UPCALL_RESULT_REEXPRESS);
+        case CCN_UPCALL_CONTENT:
+        case CCN_UPCALL_CONTENT_UNVERIFIED:
+            break;
+        default:
+            return(CCN_UPCALL_RESULT_ERR);
+    }
+    c->outstanding--;
+    n = info->content_comps->n;
+    res = ccn_name_comp_get(info->content_ccnb, info->content_comps, n - 2,
+                            &data, &data_size);
+    if (res < 0 || data_size < 1 || data[0] != CCN_MARKER_SEQNUM)
+        abort();
+    for (seq = 0; --data_size > 0;)
+        seq = (seq << 8) + *++data;
+    if (seq < c->count && !c->have[seq]) {
+        c->have[seq] = 1;
+        c->received++;
+        ccn_content_get_value(info->content_ccnb, info->pco->offset[CCN_PCO_E],
+                              info->pco, &data, &data_size);
+        c->bytes += data_size;
+    }
+    while (c->outstanding < PIPELINE && c->next < c->count)
+        ask(c);
+    return(CCN_UPCALL_RESULT_OK);
+}
+
+static double
+run(const char *uri, int window, int count)
+{
+    struct ccn *hp = NULL;
+    struct ccn *hc = NULL;
+    struct ccn_seqwriter *w = NULL;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    struct consumer cons = {{0}};
+    struct consumer *c = &cons;
+    unsigned char buf[BLOCKSIZE];
+    struct timeval t0, t1;
+    double elapsed;
+    int written = 0;
+    int res;
+
+    hp = ccn_create();
+    hc = ccn_create();
+    if (ccn_connect(hp, NULL) == -1 || ccn_connect(hc, NULL) == -1) {
+        perror("Could not connect to ccnd");
+        exit(1);
+    }
+    ccn_name_from_uri(name, uri);
+    w = ccn_seqw_create(hp, name);
+    if (w == NULL || ccn_seqw_set_window(w, window) < 0) {
+        fprintf(stderr, "ccn_seqw_create failed\n");
+        exit(1);
+    }
+    ccn_seqw_set_block_limits(w, BLOCKSIZE, BLOCKSIZE);
+    memset(buf, 'x', sizeof(buf));
+    c->cl.p = &incoming_content;
+    c->cl.data = c;
+    c->h = hc;
+    c->name = ccn_charbuf_create();
+    ccn_seqw_get_name(w, c->name);
+    c->count = count;
+    c->have = calloc(count, 1);
+
+    gettimeofday(&t0, NULL);
+    while (c->outstanding < PIPELINE && c->next < c->count)
+        ask(c);
+    while (c->received < c->count) {
+        while (written < count) {
+            res = ccn_seqw_write(w, buf, sizeof(buf));
+            if (res < 0)
+                break;
+            written++;
+        }
+        if (written == count && w != NULL) {
+            ccn_seqw_close(w);
+            w = NULL;
+        }
+        ccn_run(hp, 0);
+        ccn_run(hc, 0);
+    }
+    gettimeofday(&t1, NULL);
+    elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6;
+    printf("window %2d: %d segments of %d bytes, %.3f s, %.2f MB/s, "
+           "%.0f segments/s, %d timeouts\n",
+           window, count, BLOCKSIZE, elapsed,
+           c->bytes / elapsed / 1.0e6, count / elapsed, c->timeouts);
+    ccn_destroy(&hc);
+    ccn_destroy(&hp);
+    ccn_charbuf_destroy(&c->name);
+    ccn_charbuf_destroy(&name);
+    free(c->have);
+    return(elapsed);
+}
+
+int
+main(int argc, char **argv)
+{
+    char uri[80];
+    int count = COUNT;
+    int window = WINDOW;
+    double t_on_demand, t_ahead;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+    if (argc > 2)
+        window = atoi(argv[2]);
+    if (count <= 0 || window <= 0) {
+        fprintf(stderr, "usage: %s [count [window]]\n", argv[0]);
+        exit(1);
+    }
+    /* the names are unique, so neither run is answered from the content store */
+    snprintf(uri, sizeof(uri), "ccnx:/test/seqwbench/%d/ondemand", (int)getpid());
+    t_on_demand = run(uri, 0, count);
+    snprintf(uri, sizeof(uri), "ccnx:/test/seqwbench/%d/ahead", (int)getpid());
+    t_ahead = run(uri, window, count);
+    printf("signing ahead: %.2fx the throughput of signing on demand\n",
+           t_on_demand / t_ahead);
+    exit(0);
+}
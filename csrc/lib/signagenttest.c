@@ -0,0 +1,394 @@
+/**
+ * @file signagenttest.c
+ *
+ * Tests signing through a signing agent, and compares the cost of
+ * signing with and without one.
+ *
+ * Tool latency is measured by running this program over again as a
+ * child that signs a single object, as ccnpoke would.  Throughput is
+ * measured with several children signing at once, and for batches of
+ * digests sent by a single client.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
+#include <ccn/keystore.h>
+#include <ccn/signagent.h>
+#include <ccn/signing.h>
+
+#define PASSWORD "Th1s1sn0t8g00dp8ssw0rd."
+#define INVOCATIONS 20
+#define PROCS 4
+#define PER_PROC 300
+#define DIGESTS 3000
+#define BATCH 64
+#define FORKED 50
+
+static double
+secs_since(const struct timeval *start)
+{
+    struct timeval end;
+
+    gettimeofday(&end, NULL);
+    return((end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1e6);
+}
+
+/**
+ * Sign count objects with the handle's default key.
+ * @returns the number of failures.
+ */
+static int
+sign_objects(struct ccn *h, int count, struct ccn_charbuf *last)
+{
+    struct ccn_signing_params sp = CCN_SIGNING_PARAMS_INIT;
+    struct ccn_charbuf *name = ccn_charbuf_create();
+    int errors = 0;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        ccn_name_init(name);
+        ccn_name_append_str(name, "signagenttest");
+        ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i);
+        last->length = 0;
+        if (ccn_sign_content(h, last, name, &sp, "payload", 7) != 0)
+            errors++;
+    }
+    ccn_charbuf_destroy(&name);
+    return(errors);
+}
+
+/* What each child does */
+static int
+child_main(int count)
+{
+    struct ccn *h = ccn_create();
+    struct ccn_charbuf *co = ccn_charbuf_create();
+    int errors;
+
+    errors = sign_objects(h, count, co);
+    ccn_charbuf_destroy(&co);
+    ccn_destroy(&h);
+    return(errors == 0 ? 0 : 1);
+}
+
+/**
+ * Run nproc copies of this program at once, each signing count objects.
+ * @returns seconds taken, or -1 if any failed.
+ */
+static double
+run_children(const char *self, int nproc, int count)
+{
+    struct timeval start;
+    char arg[20];
+    pid_t pid;
+    int status;
+    int failed = 0;
+    int i;
+
+    snprintf(arg, sizeof(arg), "%d", count);
+    gettimeofday(&start, NULL);
+    for (i = 0; i < nproc; i++) {
+        pid = fork();
+        if (pid == 0) {
+            execl(self, self, "-c", arg, (char *)NULL);
+            _exit(127);
+        }
+        if (pid == -1)
+            failed++;
+    }
+    for (i = 0; i < nproc; i++) {
+        if (wait(&status) == -1 || !WIFEXITED(status) ||
+              WEXITSTATUS(status) != 0)
+            failed++;
+    }
+    return(failed ? -1.0 : secs_since(&start));
+}
+
+/**
+ * Run INVOCATIONS children one after another, each signing one object.
+ * @returns total seconds, or -1 if any failed.
+ */
+static double
+run_invocations(const char *self)
+{
+    double total = 0;
+    double t;
+    int i;
+
+    for (i = 0; i < INVOCATIONS; i++) {
+        t = run_children(self, 1, 1);
+        if (t < 0)
+            return(-1.0);
+        total += t;
+    }
+    return(total);
+}
+
+static pid_t
+start_agent(const char *sockname, const char *keystore)
+{
+    struct ccn_signagent_server *server;
+    struct ccn_signagent *a = NULL;
+    pid_t pid;
+    int i;
+
+    pid = fork();
+    if (pid == 0) {
+        server = ccn_signagent_server_create(sockname);
+        if (server == NULL ||
+              ccn_signagent_server_add_key(server, keystore, PASSWORD, NULL) < 0)
+            _exit(1);
+        signal(SIGPIPE, SIG_IGN);
+        for (;;)
+            ccn_signagent_server_run(server, -1);
+    }
+    /* Wait until it answers */
+    for (i = 0; i < 500 && a == NULL; i++) {
+        a = ccn_signagent_open(sockname);
+        if (a == NULL)
+            usleep(10000);
+    }
+    if (a == NULL) {
+        kill(pid, SIGKILL);
+        waitpid(pid, NULL, 0);
+        return(-1);
+    }
+    ccn_signagent_close(&a);
+    return(pid);
+}
+
+static void
+stop_agent(pid_t pid, const char *sockname)
+{
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    unlink(sockname);
+}
+
+/**
+ * Check that an object verifies with the keystore's own public key.
+ */
+static int
+check_object(struct ccn_charbuf *co, struct ccn_keystore *ks)
+{
+    struct ccn_parsed_ContentObject pco = {0};
+
+    if (ccn_parse_ContentObject(co->buf, co->length, &pco, NULL) < 0)
+        return(-1);
+    if (ccn_verify_signature(co->buf, co->length, &pco,
+                             ccn_keystore_public_key(ks)) != 1)
+        return(-1);
+    return(0);
+}
+
+/**
+ * Sign count objects, checking each one.
+ * @returns the number of failures.
+ */
+static int
+sign_checked(struct ccn *h, int count, struct ccn_charbuf *co,
+             struct ccn_keystore *ks)
+{
+    int errors = 0;
+    int i;
+
+    for (i = 0; i < count; i++)
+        if (sign_objects(h, 1, co) != 0 || check_object(co, ks) != 0)
+            errors++;
+    return(errors);
+}
+
+int
+main(int argc, char **argv)
+{
+    char dir[] = "/tmp/signagentXXXXXX";
+    struct ccn_charbuf *keystore = ccn_charbuf_create();
+    struct ccn_charbuf *sockname = ccn_charbuf_create();
+    struct ccn_charbuf *co = ccn_charbuf_create();
+    struct ccn_charbuf *sigs = ccn_charbuf_create();
+    struct ccn_indexbuf *ends = ccn_indexbuf_create();
+    struct ccn_keystore *ks = NULL;
+    struct ccn_signagent *a = NULL;
+    struct ccn *h = NULL;
+    unsigned char digests[BATCH * CCN_SIGNAGENT_DIGEST_SIZE];
+    struct timeval start;
+    double without, with;
+    struct ccn_signagent_server *server = NULL;
+    pid_t agent;
+    int status;
+    int errors = 0;
+    int fd;
+    int i;
+
+    if (argc == 3 && strcmp(argv[1], "-c") == 0)
+        return(child_main(atoi(argv[2])));
+    if (argv[0][0] != '/' && strchr(argv[0], '/') == NULL) {
+        fprintf(stderr, "%s: run this with a path, e.g. ./signagenttest\n",
+                argv[0]);
+        exit(1);
+    }
+    if (mkdtemp(dir) == NULL) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    setenv("CCNX_DIR", dir, 1);
+    setenv("CCNX_KEYSTORE_PASSWORD", PASSWORD, 1);
+    unsetenv("CCNX_SIGNAGENT_SOCK");
+    ccn_charbuf_putf(keystore, "%s/.ccnx_keystore", dir);
+    ccn_signagent_sockname(sockname);
+    if (ccn_keystore_file_init(ccn_charbuf_as_string(keystore), PASSWORD,
+                               "signagenttest", 0, 0) != 0) {
+        fprintf(stderr, "cannot create keystore\n");
+        exit(1);
+    }
+    ks = ccn_keystore_create();
+    if (ccn_keystore_init(ks, ccn_charbuf_as_string(keystore), PASSWORD) != 0) {
+        fprintf(stderr, "cannot load keystore\n");
+        exit(1);
+    }
+
+    /* Tool latency */
+    without = run_invocations(argv[0]);
+    agent = start_agent(ccn_charbuf_as_string(sockname),
+                        ccn_charbuf_as_string(keystore));
+    if (agent == -1) {
+        fprintf(stderr, "agent did not start\n");
+        exit(1);
+    }
+    with = run_invocations(argv[0]);
+    if (without < 0 || with < 0)
+        errors++;
+    printf("Tool invocation signing one object: %7.2f ms without agent, "
+           "%7.2f ms with\n",
+           1000 * without / INVOCATIONS, 1000 * with / INVOCATIONS);
+
+    /* Content signed through the agent must verify with the real key */
+    h = ccn_create();
+    if (sign_objects(h, 1, co) != 0 || check_object(co, ks) != 0) {
+        fprintf(stderr, "signing through the agent failed\n");
+        errors++;
+    }
+
+    /* Aggregate throughput */
+    with = run_children(argv[0], PROCS, PER_PROC);
+    setenv("CCNX_SIGNAGENT_SOCK", "", 1);
+    without = run_children(argv[0], PROCS, PER_PROC);
+    unsetenv("CCNX_SIGNAGENT_SOCK");
+    if (without < 0 || with < 0)
+        errors++;
+    printf("%d processes signing %d objects each: %7.0f/sec without agent, "
+           "%7.0f/sec with\n", PROCS, PER_PROC,
+           PROCS * PER_PROC / without, PROCS * PER_PROC / with);
+
+    /* Batches of digests from one client */
+    a = ccn_signagent_open(NULL);
+    if (a == NULL) {
+        fprintf(stderr, "cannot open agent: %s\n", strerror(errno));
+        errors++;
+    }
+    else {
+        for (i = 0; i < sizeof(digests); i++)
+            digests[i] = i * 7;
+        gettimeofday(&start, NULL);
+        for (i = 0; i < DIGESTS; i += BATCH) {
+            sigs->length = 0;
+            ends->n = 0;
+            if (ccn_signagent_sign_digests(a, digests, BATCH, sigs, ends) < 0 ||
+                  ends->n != BATCH)
+                errors++;
+        }
+        with = secs_since(&start);
+        printf("Digests signed by the agent in batches of %d: %7.0f/sec\n",
+               BATCH, (DIGESTS / BATCH) * BATCH / with);
+    }
+
+    /* A restarted agent is picked up by an open handle */
+    stop_agent(agent, ccn_charbuf_as_string(sockname));
+    agent = start_agent(ccn_charbuf_as_string(sockname),
+                        ccn_charbuf_as_string(keystore));
+    if (agent == -1 || sign_objects(h, 1, co) != 0 || check_object(co, ks) != 0) {
+        fprintf(stderr, "signing after an agent restart failed\n");
+        errors++;
+    }
+
+    /* Children forked from an open handle do not share its connection */
+    for (i = 0; i < PROCS; i++) {
+        if (fork() == 0)
+            _exit(sign_checked(h, FORKED, co, ks) == 0 ? 0 : 1);
+    }
+    for (i = 0; i < PROCS; i++) {
+        if (wait(&status) == -1 || !WIFEXITED(status) ||
+              WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "signing from a forked child failed\n");
+            errors++;
+        }
+    }
+    if (sign_checked(h, FORKED, co, ks) != 0) {
+        fprintf(stderr, "signing after forking children failed\n");
+        errors++;
+    }
+
+    /* The socket of an agent that died is replaced */
+    if (agent != -1) {
+        kill(agent, SIGKILL);
+        waitpid(agent, NULL, 0);
+        agent = start_agent(ccn_charbuf_as_string(sockname),
+                            ccn_charbuf_as_string(keystore));
+        if (agent == -1) {
+            fprintf(stderr, "a stale agent socket was not replaced\n");
+            errors++;
+        }
+        else
+            stop_agent(agent, ccn_charbuf_as_string(sockname));
+    }
+
+    /* Something that is not a socket is left alone */
+    fd = open(ccn_charbuf_as_string(sockname), O_WRONLY | O_CREAT | O_EXCL, 0600);
+    if (fd != -1)
+        close(fd);
+    server = ccn_signagent_server_create(ccn_charbuf_as_string(sockname));
+    if (fd == -1 || server != NULL || errno != EEXIST ||
+          access(ccn_charbuf_as_string(sockname), F_OK) != 0) {
+        fprintf(stderr, "a file in the way of the agent socket was not left alone\n");
+        errors++;
+    }
+    ccn_signagent_server_destroy(&server);
+    unlink(ccn_charbuf_as_string(sockname));
+
+    ccn_destroy(&h);
+    ccn_signagent_close(&a);
+    ccn_keystore_destroy(&ks);
+    unlink(ccn_charbuf_as_string(keystore));
+    rmdir(dir);
+    ccn_charbuf_destroy(&keystore);
+    ccn_charbuf_destroy(&sockname);
+    ccn_charbuf_destroy(&co);
+    ccn_charbuf_destroy(&sigs);
+    ccn_indexbuf_destroy(&ends);
+    if (errors != 0)
+        printf("%d failures\n", errors);
+    return(errors == 0 ? 0 : 1);
+}
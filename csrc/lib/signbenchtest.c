@@ -1,9 +1,13 @@
 /**
  * @file signbenchtest.c
- * 
+ *
  * A simple test program to benchmark signing performance.
  *
- * Copyright (C) 2009 Palo Alto Research Center, Inc.
+ * Compares the signing and verification throughput of the key types
+ * the keystore can generate, and of a shared secret (HMAC-SHA256),
+ * using freshly made keystores.
+ *
+ * Copyright (C) 2009, 2012 Palo Alto Research Center, Inc.
  *
  * This work is free software; you can redistribute it and/or modify it under
  * the terms of the GNU General Public License version 2 as published by the
@@ -16,70 +20,100 @@
  * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
  * Boston, MA 02110-1301, USA.
  */
- #include <stdlib.h>
+#include <stdlib.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <unistd.h>
 #include <ccn/ccn.h>
 #include <ccn/charbuf.h>
+#include <ccn/indexbuf.h>
 #include <ccn/keystore.h>
+#include <ccn/signing.h>
 #include <time.h>
 #include <sys/time.h>
 
-#define FRESHNESS 10 
+#define FRESHNESS 10
 #define COUNT 3000
 #define PAYLOAD_SIZE 51
+#define PASSWORD "Th1s1sn0t8g00dp8ssw0rd."
 
-int
-main(int argc, char **argv)
+struct keytype {
+  const char *label;
+  enum ccn_keystore_key_type type;
+  int keylength;
+};
+
+static const struct keytype keytypes[] = {
+  {"RSA 1024", CCN_KEYSTORE_KEY_RSA, 1024},
+  {"RSA 2048", CCN_KEYSTORE_KEY_RSA, 2048},
+  {"EC P-256", CCN_KEYSTORE_KEY_EC, 256},
+  {"HMAC", CCN_KEYSTORE_KEY_HMAC, 256},
+};
+
+static double
+secs_since(const struct timeval *start)
 {
+  struct timeval end;
 
+  gettimeofday(&end, NULL);
+  return((end.tv_sec - start->tv_sec) + (end.tv_usec - start->tv_usec) / 1e6);
+}
+
+/**
+ * Sign COUNT objects, then verify them all.
+ * @returns the number of failures.
+ */
+static int
+bench(const struct keytype *kt, const char *dir, const char *msgbuf)
+{
   struct ccn_keystore *keystore = NULL;
-  int res = 0;
   struct ccn_charbuf *signed_info = ccn_charbuf_create();
-  int i;
-  int sec, usec;
-  char msgbuf[PAYLOAD_SIZE];
-  struct timeval start, end;
-  struct ccn_charbuf *message = ccn_charbuf_create();
+  struct ccn_charbuf *objects = ccn_charbuf_create();
+  struct ccn_indexbuf *ends = ccn_indexbuf_create();
   struct ccn_charbuf *path = ccn_charbuf_create();
   struct ccn_charbuf *seq = ccn_charbuf_create();
-
   struct ccn_charbuf *temp = ccn_charbuf_create();
+  struct ccn_parsed_ContentObject pco = {0};
+  const struct ccn_pkey *verify_key;
+  struct timeval start;
+  double sign_secs, verify_secs;
+  size_t begin;
+  int errors = 0;
+  int res;
+  int i;
+
+  ccn_charbuf_putf(temp, "%s/keystore", dir);
   keystore = ccn_keystore_create();
-  ccn_charbuf_putf(temp, "%s/.ccnx/.ccnx_keystore", getenv("HOME"));
-  res = ccn_keystore_init(keystore,
-			  ccn_charbuf_as_string(temp),
-			  "Th1s1sn0t8g00dp8ssw0rd.");
+  if (kt->type == CCN_KEYSTORE_KEY_HMAC) {
+    res = ccn_keystore_secret_file_init(ccn_charbuf_as_string(temp),
+                                        kt->keylength);
+    if (res == 0)
+      res = ccn_keystore_init_secret(keystore, ccn_charbuf_as_string(temp));
+  }
+  else {
+    res = ccn_keystore_file_init_type(ccn_charbuf_as_string(temp), PASSWORD,
+                                      "signbenchtest", kt->type,
+                                      kt->keylength, 0);
+    if (res == 0)
+      res = ccn_keystore_init(keystore, ccn_charbuf_as_string(temp), PASSWORD);
+  }
+  unlink(ccn_charbuf_as_string(temp));
   if (res != 0) {
-    printf("Failed to initialize keystore %s\n", ccn_charbuf_as_string(temp));
-    exit(1);
+    printf("%s: failed to create keystore\n", kt->label);
+    return(1);
   }
-  ccn_charbuf_destroy(&temp);
-  
   res = ccn_signed_info_create(signed_info,
-			       /* pubkeyid */ ccn_keystore_public_key_digest(keystore),
-			       /* publisher_key_id_size */ ccn_keystore_public_key_digest_length(keystore),
-			       /* datetime */ NULL,
-			       /* type */ CCN_CONTENT_DATA,
-			       /* freshness */ FRESHNESS,
+                               /* pubkeyid */ ccn_keystore_public_key_digest(keystore),
+                               /* publisher_key_id_size */ ccn_keystore_public_key_digest_length(keystore),
+                               /* datetime */ NULL,
+                               /* type */ CCN_CONTENT_DATA,
+                               /* freshness */ FRESHNESS,
                                /*finalblockid*/ NULL,
-			       /* keylocator */ NULL);
-
-  srandom(time(NULL));
-  for (i=0; i<PAYLOAD_SIZE; i++) {
-    msgbuf[i] = random();
-  }
+                               /* keylocator */ NULL);
 
-  printf("Generating %d signed ContentObjects (one . per 100)\n", COUNT);
   gettimeofday(&start, NULL);
-
   for (i=0; i<COUNT; i++) {
-    
-    if (i>0 && (i%100) == 0) {
-      printf(".");
-      fflush(stdout);
-    }
     ccn_name_init(path);
     ccn_name_append_str(path, "rtp");
     ccn_name_append_str(path, "protocol");
@@ -92,26 +126,77 @@ main(int argc, char **argv)
     ccn_charbuf_putf(seq, "%u", i);
     ccn_name_append(path, seq->buf, seq->length);
     ccn_name_append_str(path, "seq");
-  
-    res = ccn_encode_ContentObject(/* out */ message,
-				   path, signed_info, 
-				   msgbuf, PAYLOAD_SIZE,
-				   ccn_keystore_digest_algorithm(keystore), 
-				   ccn_keystore_private_key(keystore));
-
-    ccn_charbuf_reset(message);
+
+    /* Sign the way ccn_sign_content does, reusing the keystore's context */
+    res = ccn_encode_ContentObject_sigc(/* out */ objects,
+                                        path, signed_info,
+                                        msgbuf, PAYLOAD_SIZE,
+                                        ccn_keystore_digest_algorithm(keystore),
+                                        ccn_keystore_private_key(keystore),
+                                        ccn_keystore_sigc(keystore));
+    if (res != 0)
+      errors++;
+    ccn_indexbuf_append_element(ends, objects->length);
     ccn_charbuf_reset(path);
     ccn_charbuf_reset(seq);
   }
-  gettimeofday(&end, NULL);
-  sec = end.tv_sec - start.tv_sec;
-  usec = (int)end.tv_usec - (int)start.tv_usec;
-  while (usec < 0) {
-    sec--;
-    usec += 1000000;
+  sign_secs = secs_since(&start);
+
+  /* A shared secret verifies what it signs */
+  verify_key = ccn_keystore_public_key(keystore);
+  if (verify_key == NULL)
+    verify_key = ccn_keystore_private_key(keystore);
+  gettimeofday(&start, NULL);
+  for (i=0, begin=0; i<ends->n; begin=ends->buf[i++]) {
+    res = ccn_parse_ContentObject(objects->buf + begin, ends->buf[i] - begin,
+                                  &pco, NULL);
+    if (res >= 0)
+      res = ccn_verify_signature(objects->buf + begin, ends->buf[i] - begin, &pco,
+                                 verify_key);
+    if (res != 1)
+      errors++;
+  }
+  verify_secs = secs_since(&start);
+
+  printf("%-9s sign %5d in %.3f secs (%6.0f/sec)   "
+         "verify %5d in %.3f secs (%6.0f/sec)   %4d bytes/object\n",
+         kt->label, COUNT, sign_secs, COUNT / sign_secs,
+         (int)ends->n, verify_secs, ends->n / verify_secs,
+         (int)(objects->length / COUNT));
+  if (errors != 0)
+    printf("%s: %d objects failed to sign or verify\n", kt->label, errors);
+
+  ccn_keystore_destroy(&keystore);
+  ccn_charbuf_destroy(&signed_info);
+  ccn_charbuf_destroy(&objects);
+  ccn_indexbuf_destroy(&ends);
+  ccn_charbuf_destroy(&path);
+  ccn_charbuf_destroy(&seq);
+  ccn_charbuf_destroy(&temp);
+  return(errors);
+}
+
+int
+main(int argc, char **argv)
+{
+  char dir[] = "/tmp/signbenchXXXXXX";
+  char msgbuf[PAYLOAD_SIZE];
+  int errors = 0;
+  int i;
+
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    exit(1);
+  }
+  srandom(time(NULL));
+  for (i=0; i<PAYLOAD_SIZE; i++) {
+    msgbuf[i] = random();
   }
 
-  printf("\nComplete in %d.%06d secs\n", sec, usec);
+  printf("Signing and verifying %d ContentObjects with each key type\n", COUNT);
+  for (i = 0; i < sizeof(keytypes) / sizeof(keytypes[0]); i++)
+    errors += bench(&keytypes[i], dir, msgbuf);
+  rmdir(dir);
 
-  return(0);
+  return(errors == 0 ? 0 : 1);
 }
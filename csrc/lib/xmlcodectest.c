@@ -0,0 +1,240 @@
+/**
+ * @file xmlcodectest.c
+ *
+ * A test program for the streaming ccnb/XML converters.
+ *
+ * Generates a corpus of ccnb objects with nested DTAGs, binary and text
+ * BLOBs, character data that needs escaping, and a few non-dictionary
+ * tags and attributes.  The corpus is converted to XML and back, feeding
+ * the input in pieces of various sizes, and must come back unchanged.
+ * Reports the throughput of each direction with large pieces.
+ *
+ * Copyright (C) 2012 Palo Alto Research Center, Inc.
+ *
+ * This work is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License version 2 as published by the
+ * Free Software Foundation.
+ * This work is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public License
+ * for more details. You should have received a copy of the GNU General Public
+ * License along with this program; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <ccn/ccn.h>
+#include <ccn/charbuf.h>
+#include <ccn/xmlcodec.h>
+
+#define CORPUS_SIZE (16 * 1024 * 1024)
+
+static const enum ccn_dtag container_dtags[] = {
+    CCN_DTAG_ContentObject, CCN_DTAG_Name, CCN_DTAG_SignedInfo,
+    CCN_DTAG_Interest, CCN_DTAG_KeyLocator, CCN_DTAG_Collection,
+};
+
+static const enum ccn_dtag leaf_dtags[] = {
+    CCN_DTAG_Component, CCN_DTAG_Content, CCN_DTAG_SignatureBits,
+    CCN_DTAG_PublisherPublicKeyDigest, CCN_DTAG_Timestamp,
+    CCN_DTAG_FreshnessSeconds, CCN_DTAG_Nonce, CCN_DTAG_Type,
+};
+
+static void
+append_blob(struct ccn_charbuf *c)
+{
+    static const char text[] = "abcdefghijklmnopqrstuvwxyz0123456789 .-_~\"'";
+    unsigned char *p;
+    size_t n, i;
+    int kind = random() % 4;
+
+    n = (kind == 0) ? 4096 + random() % 4096 : random() % 64;
+    ccn_charbuf_append_tt(c, n, CCN_BLOB);
+    p = ccn_charbuf_reserve(c, n);
+    for (i = 0; i < n; i++)
+        p[i] = (kind == 1) ? text[random() % (sizeof(text) - 1)] : random();
+    c->length += n;
+}
+
+static void
+append_udata(struct ccn_charbuf *c)
+{
+    static const char text[] = "abcdef &<>\"'\n\txyz";
+    size_t n = 1 + random() % 40;
+    size_t i;
+
+    ccn_charbuf_append_tt(c, n, CCN_UDATA);
+    for (i = 0; i < n; i++)
+        ccn_charbuf_append_value(c, text[random() % (sizeof(text) - 1)], 1);
+}
+
+static void
+append_element(struct ccn_charbuf *c, int depth)
+{
+    char tag[16];
+    int i, n;
+
+    if (depth < 4 && random() % 3 != 0) {
+        if (random() % 16 == 0) {
+            n = snprintf(tag, sizeof(tag), "tag%d", (int)(random() % 100));
+            ccn_charbuf_append_tt(c, n - 1, CCN_TAG);
+            ccn_charbuf_append(c, tag, n);
+            ccn_charbuf_append_tt(c, 4 - 1, CCN_ATTR);
+            ccn_charbuf_append(c, "kind", 4);
+            ccn_charbuf_append_tt(c, 3, CCN_UDATA);
+            ccn_charbuf_append(c, "a&b", 3);
+        }
+        else
+            ccn_charbuf_append_tt(c, container_dtags[random() % 6], CCN_DTAG);
+        n = 1 + random() % 5;
+        for (i = 0; i < n; i++)
+            append_element(c, depth + 1);
+        ccn_charbuf_append_closer(c);
+        return;
+    }
+    ccn_charbuf_append_tt(c, leaf_dtags[random() % 8], CCN_DTAG);
+    switch (random() % 4) {
+        case 0:
+            append_udata(c);
+            break;
+        case 1:
+            break;
+        default:
+            append_blob(c);
+    }
+    ccn_charbuf_append_closer(c);
+}
+
+static int
+append_output(void *outdata, const unsigned char *p, size_t size)
+{
+    return(ccn_charbuf_append(outdata, p, size));
+}
+
+/**
+ * Choose the size of the next piece of input.
+ * piece > 0 means that size; 0 means random small pieces.
+ */
+static size_t
+next_piece(size_t piece, size_t left)
+{
+    size_t n = (piece > 0) ? piece : 1 + random() % 97;
+    return(n < left ? n : left);
+}
+
+static double
+to_xml(int flags, struct ccn_charbuf *in, struct ccn_charbuf *out, size_t piece)
+{
+    struct ccn_ccnbtoxml *d;
+    struct timeval t0, t1;
+    size_t i, n;
+
+    out->length = 0;
+    d = ccn_ccnbtoxml_create(flags, &ccn_dtag_dict, &append_output, out);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < in->length; i += n) {
+        n = ccn_ccnbtoxml_decode(d, in->buf + i,
+                                 next_piece(piece, in->length - i));
+        if (ccn_ccnbtoxml_status(d) < 0)
+            break;
+    }
+    if (ccn_ccnbtoxml_flush(d) < 0 || ccn_ccnbtoxml_status(d) != 0) {
+        fprintf(stderr, "ccnb to XML failed near byte %lu\n", (unsigned long)i);
+        exit(1);
+    }
+    gettimeofday(&t1, NULL);
+    ccn_ccnbtoxml_destroy(&d);
+    return((t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6);
+}
+
+static double
+to_ccnb(struct ccn_charbuf *in, struct ccn_charbuf *out, size_t piece)
+{
+    struct ccn_xmltoccnb *u;
+    struct timeval t0, t1;
+    size_t i, n;
+    int res = 0;
+
+    out->length = 0;
+    u = ccn_xmltoccnb_create(0, &ccn_dtag_dict, &append_output, out);
+    gettimeofday(&t0, NULL);
+    for (i = 0; i < in->length && res == 0; i += n) {
+        n = next_piece(piece, in->length - i);
+        res = ccn_xmltoccnb_encode(u, in->buf + i, n);
+    }
+    if (res < 0 || ccn_xmltoccnb_finish(u) < 0) {
+        fprintf(stderr, "XML to ccnb failed at line %d\n", ccn_xmltoccnb_line(u));
+        exit(1);
+    }
+    gettimeofday(&t1, NULL);
+    ccn_xmltoccnb_destroy(&u);
+    return((t1.tv_sec - t0.tv_sec) + (t1.tv_usec - t0.tv_usec) / 1.0e6);
+}
+
+static int
+check(const char *what, struct ccn_charbuf *a, struct ccn_charbuf *b)
+{
+    size_t i;
+
+    if (a->length == b->length && memcmp(a->buf, b->buf, a->length) == 0)
+        return(0);
+    for (i = 0; i < a->length && i < b->length && a->buf[i] == b->buf[i]; i++)
+        continue;
+    fprintf(stderr, "FAILED: %s differs at byte %lu (%lu vs %lu bytes)\n",
+            what, (unsigned long)i, (unsigned long)a->length,
+            (unsigned long)b->length);
+    return(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    static const int flags[] = {
+        0, CCN_CCNBTOXML_FORCE_BINARY, CCN_CCNBTOXML_PREFER_HEX, -1
+    };
+    static const size_t pieces[] = {1, 0, 4096, 65536};
+    struct ccn_charbuf *corpus = ccn_charbuf_create();
+    struct ccn_charbuf *xml = ccn_charbuf_create();
+    struct ccn_charbuf *xml2 = ccn_charbuf_create();
+    struct ccn_charbuf *ccnb = ccn_charbuf_create();
+    size_t corpus_size = CORPUS_SIZE;
+    double dt;
+    int objects = 0;
+    int status = 0;
+    size_t j;
+    int i;
+
+    if (argc > 1)
+        corpus_size = atol(argv[1]);
+    srandom(1);
+    while (corpus->length < corpus_size) {
+        append_element(corpus, 0);
+        objects++;
+    }
+    printf("corpus: %d objects, %lu bytes\n", objects,
+           (unsigned long)corpus->length);
+    for (i = 0; flags[i] >= 0; i++) {
+        /* the first conversion is the reference for the others */
+        to_xml(flags[i], corpus, xml, 65536);
+        for (j = 0; j < sizeof(pieces) / sizeof(pieces[0]); j++) {
+            to_xml(flags[i], corpus, xml2, pieces[j]);
+            status |= check("XML output", xml, xml2);
+            to_ccnb(xml, ccnb, pieces[j]);
+            status |= check("round trip", corpus, ccnb);
+        }
+        dt = to_xml(flags[i], corpus, xml, 65536);
+        printf("flags %d: ccnb to XML %.1f MB/s", flags[i],
+               corpus->length / dt / 1.0e6);
+        dt = to_ccnb(xml, ccnb, 65536);
+        printf(", XML to ccnb %.1f MB/s (%lu bytes of XML)\n",
+               xml->length / dt / 1.0e6, (unsigned long)xml->length);
+    }
+    ccn_charbuf_destroy(&corpus);
+    ccn_charbuf_destroy(&xml);
+    ccn_charbuf_destroy(&xml2);
+    ccn_charbuf_destroy(&ccnb);
+    exit(status);
+}
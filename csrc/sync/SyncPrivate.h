@@ -26,6 +26,7 @@
 #include "SyncUtil.h"
 
 struct SyncHashCacheEntry;              // from SyncHashCache.h
+struct SyncRootTrie;                    // private to SyncRoot.c
 
 struct SyncMethodsList {
     struct SyncMethodsList *next;
@@ -41,6 +42,7 @@ struct SyncPrivate {
     struct SyncNameAccum *topoAccum;
     struct SyncNameAccum *prefixAccum;
     struct SyncNameAccumList *filters;
+    struct SyncRootTrie *rootTrie;  /*< naming prefix dispatch for SyncAddName */
     struct ccn_charbuf *localHostPrefix;
     struct ccn_charbuf *sliceCmdPrefix;
     struct SyncHashCacheEntry *storingHead;
@@ -101,6 +101,267 @@ canonFilter(struct SyncBaseStruct *base, struct SyncNameAccum *filter) {
     return canon;
 }
 
+///////////////////////////////////////////////////////
+// Routines for dispatching names to roots
+///////////////////////////////////////////////////////
+
+/**
+ * Each root hangs off the trie node for the last component of its
+ * naming prefix, with its filter clauses split into components ahead
+ * of time, so that a new name can be checked against every root in one
+ * walk down the trie.
+ */
+struct SyncRootTrieEntry {
+    struct SyncRootTrieEntry *next;
+    struct SyncRootStruct *root;
+    int nClauses;
+    struct ccn_indexbuf **clauseComps;  /*< components of each filter clause */
+};
+
+struct SyncRootTrieNode {
+    struct SyncRootTrieNode *parent;
+    struct ccn_charbuf *comp;           /*< component value (NULL at the top) */
+    struct SyncRootTrieNode **kids;     /*< sorted by trieKidIndex order */
+    int nKids;
+    int maxKids;
+    struct SyncRootTrieEntry *entries;  /*< roots whose prefix ends here */
+};
+
+struct SyncRootTrie {
+    struct SyncRootTrieNode *top;
+    struct ccn_indexbuf *comps;         /*< scratch for splitting names */
+};
+
+/**
+ * Finds the kid of the node with the given component value.
+ * @returns the index of the kid, or -1 - (insertion point) if not found.
+ */
+static int
+trieKidIndex(struct SyncRootTrieNode *node,
+             const unsigned char *cp, size_t cs) {
+    int lo = 0;
+    int hi = node->nKids;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        struct ccn_charbuf *kc = node->kids[mid]->comp;
+        int cmp = 0;
+        if (kc->length != cs) cmp = (kc->length < cs) ? -1 : 1;
+        else if (cs > 0) cmp = memcmp(kc->buf, cp, cs);
+        if (cmp == 0) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid;
+    }
+    return -1 - lo;
+}
+
+/**
+ * Walks the trie along the naming prefix, adding nodes if make is nonzero.
+ * @returns the node for the prefix, or NULL if there is none.
+ */
+static struct SyncRootTrieNode *
+trieSeekPrefix(struct SyncRootTrie *trie,
+               const struct ccn_charbuf *prefix, int make) {
+    struct SyncRootTrieNode *node = trie->top;
+    struct ccn_indexbuf *comps = trie->comps;
+    int n = 0;
+    int i = 0;
+    if (prefix == NULL)
+        // no prefix covers everything
+        return node;
+    n = ccn_name_split(prefix, comps);
+    if (n <= 0)
+        // SyncPrefixMatch never matches an empty prefix
+        return NULL;
+    for (i = 0; i < n; i++) {
+        const unsigned char *cp = NULL;
+        size_t cs = 0;
+        ccn_name_comp_get(prefix->buf, comps, i, &cp, &cs);
+        int ix = trieKidIndex(node, cp, cs);
+        if (ix < 0) {
+            if (!make) return NULL;
+            ix = -1 - ix;
+            if (node->nKids == node->maxKids) {
+                int max = (node->maxKids == 0) ? 4 : 2 * node->maxKids;
+                struct SyncRootTrieNode **kids = NEW_ANY(max, struct SyncRootTrieNode *);
+                if (node->nKids > 0)
+                    memcpy(kids, node->kids, node->nKids * sizeof(kids[0]));
+                free(node->kids);
+                node->kids = kids;
+                node->maxKids = max;
+            }
+            struct SyncRootTrieNode *kid = NEW_STRUCT(1, SyncRootTrieNode);
+            kid->parent = node;
+            kid->comp = ccn_charbuf_create();
+            ccn_charbuf_append(kid->comp, cp, cs);
+            memmove(node->kids + ix + 1, node->kids + ix,
+                    (node->nKids - ix) * sizeof(node->kids[0]));
+            node->kids[ix] = kid;
+            node->nKids++;
+        }
+        node = node->kids[ix];
+    }
+    return node;
+}
+
+static void
+trieAddRoot(struct SyncPrivate *priv, struct SyncRootStruct *root) {
+    struct SyncRootTrie *trie = priv->rootTrie;
+    if (trie == NULL) {
+        trie = NEW_STRUCT(1, SyncRootTrie);
+        trie->top = NEW_STRUCT(1, SyncRootTrieNode);
+        trie->comps = ccn_indexbuf_create();
+        priv->rootTrie = trie;
+    }
+    struct SyncRootTrieNode *node = trieSeekPrefix(trie, root->namingPrefix, 1);
+    if (node == NULL) return;
+    struct SyncRootTrieEntry *entry = NEW_STRUCT(1, SyncRootTrieEntry);
+    struct SyncNameAccum *filter = root->filter;
+    entry->root = root;
+    if (filter != NULL && filter->len > 0) {
+        int i = 0;
+        entry->nClauses = filter->len;
+        entry->clauseComps = NEW_ANY(filter->len, struct ccn_indexbuf *);
+        for (i = 0; i < filter->len; i++) {
+            struct ccn_indexbuf *comps = ccn_indexbuf_create();
+            if (ccn_name_split(filter->ents[i].name, comps) < 0)
+                // a bad clause stops the matching, as in SyncRootLookupName
+                ccn_indexbuf_destroy(&comps);
+            entry->clauseComps[i] = comps;
+        }
+    }
+    entry->next = node->entries;
+    node->entries = entry;
+}
+
+static void
+trieRemRoot(struct SyncPrivate *priv, struct SyncRootStruct *root) {
+    struct SyncRootTrie *trie = priv->rootTrie;
+    if (trie == NULL) return;
+    struct SyncRootTrieNode *node = trieSeekPrefix(trie, root->namingPrefix, 0);
+    struct SyncRootTrieEntry **pe = (node == NULL) ? NULL : &node->entries;
+    while (pe != NULL && *pe != NULL) {
+        struct SyncRootTrieEntry *entry = *pe;
+        if (entry->root == root) {
+            int i = 0;
+            *pe = entry->next;
+            for (i = 0; i < entry->nClauses; i++)
+                ccn_indexbuf_destroy(&entry->clauseComps[i]);
+            free(entry->clauseComps);
+            free(entry);
+            break;
+        }
+        pe = &entry->next;
+    }
+    // prune the nodes that no longer lead to any root
+    while (node != NULL && node->parent != NULL
+           && node->entries == NULL && node->nKids == 0) {
+        struct SyncRootTrieNode *parent = node->parent;
+        int ix = trieKidIndex(parent, node->comp->buf, node->comp->length);
+        if (ix >= 0) {
+            parent->nKids--;
+            memmove(parent->kids + ix, parent->kids + ix + 1,
+                    (parent->nKids - ix) * sizeof(parent->kids[0]));
+        }
+        ccn_charbuf_destroy(&node->comp);
+        free(node->kids);
+        free(node);
+        node = parent;
+    }
+    if (priv->nRoots == 0) {
+        // only the top is left
+        free(trie->top->kids);
+        free(trie->top);
+        ccn_indexbuf_destroy(&trie->comps);
+        free(trie);
+        priv->rootTrie = NULL;
+    }
+}
+
+/**
+ * Tests the name, past the first skip components, against the filter
+ * clauses of the entry, with the same rules as SyncPatternMatch.
+ */
+static int
+trieEntryCovers(struct SyncRootTrieEntry *entry,
+                const struct ccn_charbuf *name,
+                struct ccn_indexbuf *comps,
+                int skip) {
+    int nc = comps->n - 1;
+    int i = 0;
+    if (entry->nClauses == 0) return 1;
+    for (i = 0; i < entry->nClauses; i++) {
+        struct ccn_indexbuf *pcomps = entry->clauseComps[i];
+        if (pcomps == NULL) break;
+        const unsigned char *pb = entry->root->filter->ents[i].name->buf;
+        int np = pcomps->n - 1;
+        int j = 0;
+        if (np == 0 || skip + np > nc) continue;
+        for (j = 0; j < np; j++) {
+            const unsigned char *xp = NULL;
+            const unsigned char *yp = NULL;
+            size_t xs = 0;
+            size_t ys = 0;
+            ccn_name_comp_get(pb, pcomps, j, &xp, &xs);
+            ccn_name_comp_get(name->buf, comps, skip + j, &yp, &ys);
+            if (xs > 0 && xp[0] == 255) {
+                // a component starting with FF may be a star-matcher
+                // if not a single byte, swallow the FF
+                xs--;
+                xp++;
+                if (xs == 0) continue;
+            }
+            if (xs != ys || (xs > 0 && memcmp(xp, yp, xs) != 0)) break;
+        }
+        if (j == np) return 1;
+    }
+    return 0;
+}
+
+static int
+cmpRootIds(const void *a, const void *b) {
+    const struct SyncRootStruct *x = *(struct SyncRootStruct * const *) a;
+    const struct SyncRootStruct *y = *(struct SyncRootStruct * const *) b;
+    if (x->rootId < y->rootId) return -1;
+    return (x->rootId > y->rootId);
+}
+
+extern int
+SyncRootsCoveringName(struct SyncBaseStruct *base,
+                      const struct ccn_charbuf *name,
+                      struct SyncRootStruct **roots,
+                      int max) {
+    struct SyncRootTrie *trie = base->priv->rootTrie;
+    if (name == NULL) return -1;
+    if (trie == NULL) return 0;
+    struct ccn_indexbuf *comps = trie->comps;
+    int n = ccn_name_split(name, comps);
+    if (n < 0) return -1;
+    struct SyncRootTrieNode *node = trie->top;
+    int depth = 0;
+    int count = 0;
+    for (;;) {
+        struct SyncRootTrieEntry *entry = node->entries;
+        for (; entry != NULL; entry = entry->next) {
+            if (trieEntryCovers(entry, name, comps, depth)) {
+                if (count < max) roots[count] = entry->root;
+                count++;
+            }
+        }
+        if (depth == n || node->nKids == 0) break;
+        const unsigned char *cp = NULL;
+        size_t cs = 0;
+        ccn_name_comp_get(name->buf, comps, depth, &cp, &cs);
+        int ix = trieKidIndex(node, cp, cs);
+        if (ix < 0) break;
+        node = node->kids[ix];
+        depth++;
+    }
+    // report in the order of the root list
+    if (count > 1)
+        qsort(roots, (count < max) ? count : max, sizeof(roots[0]), cmpRootIds);
+    return count;
+}
+
 extern struct SyncRootStruct *
 SyncAddRoot(struct SyncBaseStruct *base,
             int syncScope,
@@ -143,6 +404,7 @@ SyncAddRoot(struct SyncBaseStruct *base,
     if (lag != NULL) lag->next = root;
     else priv->rootHead = root;
     priv->nRoots++;
+    trieAddRoot(priv, root);
     struct SyncHashCacheHead *ch = SyncHashCacheCreate(root, 64);
     root->ch = ch;
     root->currentHash = ccn_charbuf_create(); // initially empty!
@@ -224,8 +486,9 @@ SyncRemRoot(struct SyncRootStruct *root) {
                 }
                 free(rp);
             }
-            free(root);
             priv->nRoots--;
+            trieRemRoot(priv, root);
+            free(root);
             break;
         }
         lag = this;
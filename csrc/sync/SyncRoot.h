@@ -127,4 +127,18 @@ enum SyncRootLookupCode
 SyncRootLookupName(struct SyncRootStruct *root,
                     const struct ccn_charbuf *name);
 
+/**
+ * Finds all of the roots in the base that cover the name, with the same
+ * result as calling SyncRootLookupName for each root, but in one pass over
+ * a trie of the naming prefixes that SyncAddRoot and SyncRemRoot maintain.
+ * Stores up to max of the roots, in the order of the root list.
+ * @returns the number of covering roots (which may exceed max),
+ * or -1 for a bad name.
+ */
+int
+SyncRootsCoveringName(struct SyncBaseStruct *base,
+                      const struct ccn_charbuf *name,
+                      struct SyncRootStruct **roots,
+                      int max);
+
 #endif
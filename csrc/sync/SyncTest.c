@@ -663,6 +663,122 @@ testRootBasic(struct SyncTestParms *parms) {
     return res;
 }
 
+// generate a root for the dispatch benchmark
+// most roots are slices of their own, some share a group prefix with filters
+static struct SyncRootStruct *
+genTestRootSlice(struct SyncTestParms *parms, int i) {
+    struct ccn_charbuf *topoPrefix = ccn_charbuf_create();
+    struct ccn_charbuf *namingPrefix = ccn_charbuf_create();
+    struct SyncNameAccum *filter = SyncAllocNameAccum(4);
+    char temp[64];
+    
+    ccn_name_from_uri(topoPrefix, "/ccn/test/sync");
+    ccn_name_from_uri(namingPrefix, "/ccn/test/slices");
+    snprintf(temp, sizeof(temp), "g%d", i % 16);
+    ccn_name_append_str(namingPrefix, temp);
+    if (i % 8 != 0) {
+        snprintf(temp, sizeof(temp), "s%d", i);
+        ccn_name_append_str(namingPrefix, temp);
+    }
+    if (i % 4 == 0) {
+        // one literal clause and one with a star-matcher
+        struct ccn_charbuf *clause = ccn_charbuf_create();
+        ccn_name_from_uri(clause, "/a");
+        SyncNameAccumAppend(filter, clause, 0);
+        clause = ccn_charbuf_create();
+        ccn_name_from_uri(clause, "/%FF/b");
+        SyncNameAccumAppend(filter, clause, 0);
+    }
+    struct SyncRootStruct *root = SyncAddRoot(parms->base,
+                                              parms->syncScope,
+                                              topoPrefix,
+                                              namingPrefix,
+                                              filter);
+    ccn_charbuf_destroy(&topoPrefix);
+    ccn_charbuf_destroy(&namingPrefix);
+    SyncFreeNameAccumAndNames(filter);
+    return root;
+}
+
+// checks SyncRootsCoveringName against SyncRootLookupName for every root,
+// and compares their speed over many roots
+static int
+testRootDispatch(struct SyncTestParms *parms, int nRoots, int nNames) {
+    struct SyncBaseStruct *base = parms->base;
+    struct SyncRootStruct **roots = NEW_ANY(nRoots + 1, struct SyncRootStruct *);
+    struct SyncRootStruct **found = NEW_ANY(nRoots + 1, struct SyncRootStruct *);
+    struct SyncNameAccum *names = SyncAllocNameAccum(nNames);
+    char temp[64];
+    int res = 0;
+    int covered = 0;
+    int i = 0;
+    
+    for (i = 0; i < nRoots; i++)
+        roots[i] = genTestRootSlice(parms, i);
+    srandom(37);
+    for (i = 0; i < nNames; i++) {
+        // some names fall outside of every root
+        int r = random() % (nRoots + nRoots / 4 + 1);
+        struct ccn_charbuf *name = ccn_charbuf_create();
+        ccn_name_from_uri(name, "/ccn/test/slices");
+        snprintf(temp, sizeof(temp), "g%d", r % 16);
+        ccn_name_append_str(name, temp);
+        snprintf(temp, sizeof(temp), "s%d", r);
+        ccn_name_append_str(name, temp);
+        ccn_name_append_str(name, (i % 3 == 0) ? "a" : (i % 3 == 1) ? "b" : "c");
+        if (i % 2 == 0) ccn_name_append_str(name, "b");
+        ccn_name_append_numeric(name, CCN_MARKER_SEQNUM, i);
+        SyncNameAccumAppend(names, name, 0);
+    }
+    
+    // the trie must agree with the root-by-root lookup
+    for (i = 0; i < nNames && res == 0; i++) {
+        struct ccn_charbuf *name = names->ents[i].name;
+        int n = SyncRootsCoveringName(base, name, found, nRoots);
+        int k = 0;
+        struct SyncRootStruct *root = base->priv->rootHead;
+        for (; root != NULL; root = root->next) {
+            if (SyncRootLookupName(root, name) != SyncRootLookupCode_covered)
+                continue;
+            if (k >= n || found[k] != root) break;
+            k++;
+        }
+        if (root != NULL || k != n)
+            res = noteErr("testRootDispatch, wrong roots for name %d", i);
+        covered += n;
+    }
+    
+    if (res == 0) {
+        int64_t t0 = SyncCurrentTime();
+        for (i = 0; i < nNames; i++) {
+            struct ccn_charbuf *name = names->ents[i].name;
+            struct SyncRootStruct *root = base->priv->rootHead;
+            for (; root != NULL; root = root->next)
+                SyncRootLookupName(root, name);
+        }
+        int64_t t1 = SyncCurrentTime();
+        for (i = 0; i < nNames; i++)
+            SyncRootsCoveringName(base, names->ents[i].name, found, nRoots);
+        int64_t t2 = SyncCurrentTime();
+        printf("%d roots, %d names, %d covered: "
+               "%.2f us/name by root, %.2f us/name by trie\n",
+               nRoots, nNames, covered,
+               (double) SyncDeltaTime(t0, t1) / nNames,
+               (double) SyncDeltaTime(t1, t2) / nNames);
+    }
+    
+    // remove every other root first, then the rest
+    for (i = 0; i < nRoots; i += 2) SyncRemRoot(roots[i]);
+    for (i = 1; i < nRoots; i += 2) SyncRemRoot(roots[i]);
+    if (res == 0 && nNames > 0
+        && SyncRootsCoveringName(base, names->ents[0].name, found, nRoots) != 0)
+        res = noteErr("testRootDispatch, removed roots still found");
+    SyncFreeNameAccumAndNames(names);
+    free(roots);
+    free(found);
+    return res;
+}
+
 static int
 localStore(struct SyncTestParms *parms,
            struct ccn *ccn, struct ccn_charbuf *nm, struct ccn_charbuf *cb) {
@@ -1647,6 +1763,19 @@ main(int argc, char **argv) {
         } else if (strcasecmp(sw, "-basic") == 0) {
             res = testRootBasic(parms);
             seen++;
+        } else if (strcasecmp(sw, "-roots") == 0) {
+            if (arg1 != NULL) {
+                int nRoots = atoi(arg1);
+                int nNames = 100000;
+                i++;
+                if (arg2 != NULL && atoi(arg2) > 0) {
+                    nNames = atoi(arg2);
+                    i++;
+                }
+                res = testRootDispatch(parms, nRoots, nNames);
+            } else
+            res = noteErr("missing number of roots");
+            seen++;
         } else if (strcasecmp(sw, "-target") == 0) {
             if (arg1 != NULL) {
                 parms->target = arg1;
@@ -1811,6 +1940,7 @@ main(int argc, char **argv) {
         printf("    -bs N           set block size for put (default 4096)\n");
         printf("    -bufs N         number of buffers for get (default 4)\n");
         printf("    -basic          some very basic tests\n");
+        printf("    -roots N [M]    check and time name dispatch to N roots (M names)\n");
         printf("    -read F         read names from file F\n");
         printf("    -sort F         read names from file F, sort them\n");
         printf("    -encode         simple encode/decode test\n");
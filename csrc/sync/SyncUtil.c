@@ -1086,41 +1086,43 @@ SyncAddName(struct SyncBaseStruct *base,
     static char *here = "Sync.SyncAddName";
     struct SyncPrivate *priv = base->priv;
     int debug = base->debug;
-    struct SyncRootStruct *root = priv->rootHead;
     int count = 0;
-    while (root != NULL) {
-        if (SyncRootLookupName(root, name) == SyncRootLookupCode_covered) {
-            // ANY matching root gets an addition
-            // add the name for later processing
-            struct SyncRootPrivate *rp = root->priv;
-            struct ccn_charbuf *prev = NULL;
-            int pos = root->namesToAdd->len;
-            if (pos > 0) prev = root->namesToAdd->ents[pos-1].name;
-            if (prev != NULL && SyncCmpNames(name, prev) == 0) {
-                // this is a duplicate, so forget it!
-                if (debug >= CCNL_FINE) {
-                    SyncNoteUri(root, here, "ignore dup", name);
-                }
-            } else {
-                // not obviously a duplicate
-                uint64_t sn = seq_num;
-                if (sn == 0) {
-                    // TBD: is there a better inference method?
-                    sn = rp->max_seq_num_stable;
-                    if (rp->max_seq_num_build > sn)
-                        sn = rp->max_seq_num_build;
-                }
-                SyncNameAccumAppend(root->namesToAdd, SyncCopyName(name), sn);
-                count++;
-                if (sn > rp->max_seq_num_seen)
-                    rp->max_seq_num_seen = sn;
-                if (debug >= CCNL_FINE) {
-                    SyncNoteUri(root, here, "added", name);
-                }
+    int i = 0;
+    if (priv->nRoots <= 0) return 0;
+    struct SyncRootStruct **roots = NEW_ANY(priv->nRoots, struct SyncRootStruct *);
+    int n = SyncRootsCoveringName(base, name, roots, priv->nRoots);
+    for (i = 0; i < n && i < priv->nRoots; i++) {
+        struct SyncRootStruct *root = roots[i];
+        // ANY matching root gets an addition
+        // add the name for later processing
+        struct SyncRootPrivate *rp = root->priv;
+        struct ccn_charbuf *prev = NULL;
+        int pos = root->namesToAdd->len;
+        if (pos > 0) prev = root->namesToAdd->ents[pos-1].name;
+        if (prev != NULL && SyncCmpNames(name, prev) == 0) {
+            // this is a duplicate, so forget it!
+            if (debug >= CCNL_FINE) {
+                SyncNoteUri(root, here, "ignore dup", name);
+            }
+        } else {
+            // not obviously a duplicate
+            uint64_t sn = seq_num;
+            if (sn == 0) {
+                // TBD: is there a better inference method?
+                sn = rp->max_seq_num_stable;
+                if (rp->max_seq_num_build > sn)
+                    sn = rp->max_seq_num_build;
+            }
+            SyncNameAccumAppend(root->namesToAdd, SyncCopyName(name), sn);
+            count++;
+            if (sn > rp->max_seq_num_seen)
+                rp->max_seq_num_seen = sn;
+            if (debug >= CCNL_FINE) {
+                SyncNoteUri(root, here, "added", name);
             }
         }
-        root = root->next;
     }
+    free(roots);
     return count;
 }
 
@@ -23,10 +23,12 @@ ALLTESTS = \
   test_coders \
   test_destroyface \
   test_child_selector \
+  test_exclude_limit \
   test_extopt \
   test_final_teardown \
   test_finished \
   test_happy_face \
+  test_interest_nack \
   test_interest_suppression \
   test_answered_interest_suppression \
   test_key_fetch \
@@ -37,6 +39,7 @@ ALLTESTS = \
   test_new_provider \
   test_newface \
   test_prefixreg \
+  test_publish_verify \
   test_selfreg \
   test_short_stuff \
   test_single_ccnd \
@@ -1,5 +1,6 @@
 ccn_ccnbtoxml.1.html: ccn_ccnbtoxml.1.txt
 ccn_xmltoccnb.1.html: ccn_xmltoccnb.1.txt
+ccn_splitccnb.1.html: ccn_splitccnb.1.txt
 ccnacl.1.html: ccnacl.1.txt
 ccngroup.1.html: ccngroup.1.txt
 ccnc.1.html: ccnc.1.txt
@@ -37,6 +38,7 @@ ccnrepoimport.1.html: ccnrepoimport.1.txt
 ccntestloop.1.html: ccntestloop.1.txt
 ccn_ccnbtoxml.1.pdf: ccn_ccnbtoxml.1.txt
 ccn_xmltoccnb.1.pdf: ccn_xmltoccnb.1.txt
+ccn_splitccnb.1.pdf: ccn_splitccnb.1.txt
 ccnacl.1.pdf: ccnacl.1.txt
 ccngroup.1.pdf: ccngroup.1.txt
 ccnc.1.pdf: ccnc.1.txt
@@ -74,6 +76,7 @@ ccnrepoimport.1.pdf: ccnrepoimport.1.txt
 ccntestloop.1.pdf: ccntestloop.1.txt
 ccn_ccnbtoxml.1: ccn_ccnbtoxml.1.txt
 ccn_xmltoccnb.1: ccn_xmltoccnb.1.txt
+ccn_splitccnb.1: ccn_splitccnb.1.txt
 ccnacl.1: ccnacl.1.txt
 ccngroup.1: ccngroup.1.txt
 ccnc.1: ccnc.1.txt